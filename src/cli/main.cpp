@@ -0,0 +1,54 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "core/knutcore.h"
+#include "core/version.h"
+
+#include <QCoreApplication>
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+
+// Same command line as knut, but there's no user interface to fall back to: a script is needed
+class KnutCli : public Core::KnutCore
+{
+public:
+    KnutCli()
+        : Core::KnutCore({}, nullptr)
+    {
+    }
+
+protected:
+    void doParse(const QCommandLineParser &parser) const override
+    {
+        std::cerr << "knut-cli: no script to run, use --run or --test\n\n" << parser.helpText().toStdString();
+        std::exit(1);
+    }
+};
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCoreApplication::setOrganizationName("KDAB");
+    // Same name as knut, to share the settings
+    QCoreApplication::setApplicationName("knut");
+    QCoreApplication::setApplicationVersion(core::knut_version());
+
+    Q_INIT_RESOURCE(core);
+
+    KnutCli knut;
+    knut.process(app.arguments());
+
+    return app.exec();
+}
@@ -12,8 +12,12 @@
 #include "codedocument.h"
 #include "codedocument_p.h"
 #include "treesitter/node.h"
+#include "treesitter/treecursor.h"
+#include "utils/log.h"
 
+#include <QJSEngine>
 #include <QPlainTextEdit>
+#include <kdalgorithms.h>
 
 namespace Core {
 
@@ -26,7 +30,7 @@ AstNode::AstNode(const treesitter::Node &node, CodeDocument *parent)
 AstNode AstNode::parentNode() const
 {
     if (auto n = node())
-        return AstNode(n->parent(), document());
+        return document()->m_treeSitterHelper->astNode(n->parent());
     return {};
 }
 
@@ -34,14 +38,84 @@ Core::AstNodeList AstNode::childrenNodes() const
 {
     QVector<AstNode> children;
     if (auto n = node()) {
-        const auto childNodes = n->children();
-        for (const auto &node : childNodes) {
-            children.append(AstNode(node, document()));
+        auto &helper = *document()->m_treeSitterHelper;
+        children.reserve(n->childCount());
+        for (const auto &node : n->childRange()) {
+            children.append(helper.astNode(node));
         }
     }
     return children;
 }
 
+/*!
+ * \qmlmethod AstNode::walk(function callback, array<string> types = [])
+ * Calls `callback` with this node and all its descendants, in depth-first pre-order. If `types` is not empty, only
+ * the nodes of one of these types are passed to the callback.
+ *
+ * If the callback returns `false`, the descendants of the node are skipped.
+ *
+ * This is a lot faster than walking the tree with `childrenNodes`, as the nodes skipped aren't wrapped at all.
+ *
+ * ```js
+ * let calls = [];
+ * node.walk(call => calls.push(call.text), ["call_expression"]);
+ * ```
+ */
+void AstNode::walk(const QJSValue &callback, const QStringList &types) const
+{
+    if (!callback.isCallable()) {
+        spdlog::error("AstNode::walk - the callback is not a function");
+        return;
+    }
+    auto root = node();
+    if (!root)
+        return;
+    auto *engine = qjsEngine(document());
+    if (!engine) {
+        spdlog::error("AstNode::walk - can't be called outside of a script");
+        return;
+    }
+
+    // Compared to the raw type of each node, so nodes are filtered without creating any string
+    const auto typeNames = kdalgorithms::transformed<QList<QByteArray>>(types, [](const QString &type) {
+        return type.toLatin1();
+    });
+    auto accept = [&typeNames](const treesitter::Node &node) {
+        return typeNames.isEmpty() || typeNames.contains(node.rawType());
+    };
+    auto &helper = *document()->m_treeSitterHelper;
+    const auto generation = helper.treeGeneration();
+    enum class Next { Children, Sibling, Stop };
+    auto visit = [&](const treesitter::Node &node) {
+        if (!accept(node))
+            return Next::Children;
+        const auto result = callback.call({engine->toScriptValue(helper.astNode(node))});
+        if (result.isError()) {
+            spdlog::error("AstNode::walk - {}", result.toString());
+            return Next::Stop;
+        }
+        // The nodes walked belong to the old tree if the callback changed the document
+        if (helper.treeGeneration() != generation) {
+            spdlog::warn("AstNode::walk - the document changed, stopping the walk");
+            return Next::Stop;
+        }
+        return result.isBool() && !result.toBool() ? Next::Sibling : Next::Children;
+    };
+
+    if (visit(*root) != Next::Children)
+        return;
+    const auto descendants = root->descendants();
+    for (auto it = descendants.begin(); it != descendants.end();) {
+        const auto next = visit(*it);
+        if (next == Next::Stop)
+            return;
+        if (next == Next::Children)
+            ++it;
+        else
+            it.skipChildren();
+    }
+}
+
 bool AstNode::isValid() const
 {
     return m_mark.isValid();
@@ -55,7 +129,14 @@ std::optional<treesitter::Node> AstNode::node() const
     }
 
     if (auto doc = document()) {
-        return doc->m_treeSitterHelper->syntaxTree()->rootNode().descendantForRange(startPos(), endPos());
+        auto &helper = *doc->m_treeSitterHelper;
+        const auto &tree = helper.syntaxTree();
+        if (!tree)
+            return std::nullopt;
+        // The node is kept as long as the tree is not edited, no need to look for it again
+        if (m_node && m_treeGeneration == helper.treeGeneration())
+            return m_node;
+        return tree->rootNode().descendantForRange(startPos(), endPos());
     }
     return std::nullopt;
 }
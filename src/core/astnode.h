@@ -11,12 +11,11 @@
 #pragma once
 
 #include "rangemark.h"
+#include "treesitter/node.h"
 
+#include <QJSValue>
 #include <QObject>
-
-namespace treesitter {
-class Node;
-}
+#include <optional>
 
 class TestCodeDocument;
 
@@ -37,6 +36,7 @@ public:
     Q_INVOKABLE Core::AstNode parentNode() const;
     Q_INVOKABLE QList<Core::AstNode> childrenNodes() const;
     Q_INVOKABLE bool isValid() const;
+    Q_INVOKABLE void walk(const QJSValue &callback, const QStringList &types = {}) const;
 
     QString type() const;
     QString text() const;
@@ -54,8 +54,12 @@ private:
 private:
     RangeMark m_mark;
     QString m_type;
+    // The wrapped node, only valid as long as the syntax tree it was created from, see TreeSitterHelper::astNode
+    std::optional<treesitter::Node> m_node;
+    size_t m_treeGeneration = 0;
 
     friend class CodeDocument;
+    friend class TreeSitterHelper;
 };
 
 using AstNodeList = QList<Core::AstNode>;
@@ -0,0 +1,247 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "classeditor.h"
+#include "cppdocument_p.h"
+#include "functionsymbol.h"
+#include "logger.h"
+#include "querymatch.h"
+#include "symbol.h"
+#include "treesitter/builtinqueries.h"
+#include "utils/log.h"
+
+#include <algorithm>
+
+namespace Core {
+
+/*!
+ * \qmltype ClassEditor
+ * \brief Batch edition of a class in a C++ document.
+ * \inqmlmodule Script
+ * \ingroup CppDocument
+ * \sa CppDocument::editClass
+ *
+ * A `ClassEditor` queues member and method additions and removals for a class, and applies them all at once with
+ * `apply`. The class and its access specifier sections are only looked up once, and the document is only parsed once
+ * after all the changes, instead of once per change.
+ *
+ * ```js
+ * let editor = document.editClass("MyObject");
+ * editor.addMember("int m_count = 0", CppDocument.Private);
+ * editor.addMethodDeclaration("int count() const", CppDocument.Public);
+ * editor.deleteMethod("sayMessage");
+ * editor.apply();
+ * ```
+ *
+ * The result of the changes is the same as calling the corresponding `CppDocument` methods one after the other.
+ */
+/*!
+ * \qmlproperty string ClassEditor::className
+ * Name of the class edited.
+ */
+
+ClassEditor::ClassEditor(CppDocument *document, const QString &className, QObject *parent)
+    : QObject(parent)
+    , m_document(document)
+    , m_className(className)
+{
+}
+
+ClassEditor::~ClassEditor() = default;
+
+const QString &ClassEditor::className() const
+{
+    return m_className;
+}
+
+/*!
+ * \qmlmethod ClassEditor::addMember(string member, AccessSpecifier specifier)
+ * Queues the addition of `member` under the access `specifier`, see `CppDocument::addMember`.
+ */
+void ClassEditor::addMember(const QString &member, CppDocument::AccessSpecifier specifier)
+{
+    LOG("ClassEditor::addMember", member, specifier);
+    m_declarations.push_back({member, specifier});
+}
+
+/*!
+ * \qmlmethod ClassEditor::addMethodDeclaration(string method, AccessSpecifier specifier)
+ * Queues the declaration of `method` under the access `specifier`, see `CppDocument::addMethodDeclaration`.
+ */
+void ClassEditor::addMethodDeclaration(const QString &method, CppDocument::AccessSpecifier specifier)
+{
+    LOG("ClassEditor::addMethodDeclaration", method, specifier);
+    m_declarations.push_back({method, specifier});
+}
+
+/*!
+ * \qmlmethod ClassEditor::addMethodDefinition(string method, string body = "")
+ * Queues the definition of `method` at the end of the document, see `CppDocument::addMethodDefinition`.
+ */
+void ClassEditor::addMethodDefinition(const QString &method, const QString &body)
+{
+    LOG("ClassEditor::addMethodDefinition", method, body);
+    m_definitions.push_back(methodDefinitionText(method, m_className, body));
+}
+
+/*!
+ * \qmlmethod ClassEditor::deleteMethod(string methodName, string signature = "")
+ * Queues the deletion of the method `methodName` with the given `signature` in the document. If `signature` is empty,
+ * all overloads are deleted. The `methodName` is relative to the class, unless it's fully qualified.
+ *
+ * Contrary to `CppDocument::deleteMethod`, only the current document is changed.
+ */
+void ClassEditor::deleteMethod(const QString &methodName, const QString &signature)
+{
+    LOG("ClassEditor::deleteMethod", methodName, signature);
+    m_deletions.push_back({methodName.contains("::") ? methodName : m_className + "::" + methodName, signature});
+}
+
+/*!
+ * \qmlmethod bool ClassEditor::apply()
+ * Applies all the pending changes in one edit, and returns true if it succeeded. The pending changes are cleared,
+ * so the editor can be used for another batch of changes.
+ */
+bool ClassEditor::apply()
+{
+    LOG("ClassEditor::apply");
+
+    if (!m_document) {
+        spdlog::error("ClassEditor::apply - the document has been deleted");
+        return false;
+    }
+
+    // All positions are computed on the current text, applyEdits takes care of applying them in the right order
+    QVector<TextEdit> edits;
+    const bool result = addDeclarations(edits);
+    if (result) {
+        addDefinitions(edits);
+        addDeletions(edits);
+    }
+
+    m_declarations.clear();
+    m_definitions.clear();
+    m_deletions.clear();
+
+    return result && m_document->applyEdits(std::move(edits));
+}
+
+// Same as CppDocument::addMemberOrMethod and CppDocument::addSpecifierSection, for all the declarations at once
+bool ClassEditor::addDeclarations(QVector<TextEdit> &edits) const
+{
+    if (m_declarations.isEmpty())
+        return true;
+
+    const auto body = m_document->queryClassDefinition(m_className).get("body");
+    if (!body.isValid()) {
+        spdlog::error("ClassEditor::apply - Can't find class '{}'", m_className);
+        return false;
+    }
+
+    // Keep the sections in the order they are first used
+    QVector<CppDocument::AccessSpecifier> specifiers;
+    for (const auto &declaration : m_declarations) {
+        if (!specifiers.contains(declaration.specifier))
+            specifiers.push_back(declaration.specifier);
+    }
+    auto declarationsText = [this](CppDocument::AccessSpecifier specifier, const QString &indent) {
+        QString text;
+        for (const auto &declaration : m_declarations) {
+            if (declaration.specifier == specifier)
+                text += "\n" + indent + declaration.text + ";";
+        }
+        return text;
+    };
+
+    // Sections that don't exist yet are all added at the end of the class, after the other declarations
+    QString newSections;
+    int newSectionsPosition = -1;
+    for (const auto specifier : std::as_const(specifiers)) {
+        const auto &specifierText = m_document->accessSpecifierMap.value(specifier);
+        const auto matches = m_document->queryInRange(body, treesitter::builtinQuery("cpp/access_specifier_fields"),
+                                                      {{"specifiers", {specifierText}}});
+        if (!matches.isEmpty()) {
+            const auto &match = matches.last();
+            const auto fields = match.getAll("field");
+            const int position = fields.isEmpty() ? match.getAll("access").last().end() : fields.last().end();
+            const auto indent = m_document->indentationAtPosition(position);
+            edits.push_back({{.start = position, .end = position}, declarationsText(specifier, indent)});
+            continue;
+        }
+
+        const auto children = m_document->queryInRange(body, treesitter::builtinQuery("cpp/class_body_children"));
+        if (children.isEmpty()) {
+            spdlog::error("ClassEditor::apply - Can't add a {} section in class '{}'", specifierText, m_className);
+            return false;
+        }
+        newSectionsPosition = children.last().get("pos").end();
+        const auto indent = m_document->indentationAtPosition(newSectionsPosition);
+        newSections += QString("\n\n%1:").arg(specifierText) + declarationsText(specifier, indent);
+    }
+    if (!newSections.isEmpty())
+        edits.push_back({{.start = newSectionsPosition, .end = newSectionsPosition}, newSections});
+    return true;
+}
+
+// Same as CppDocument::addMethodDefinition, for all the definitions at once
+void ClassEditor::addDefinitions(QVector<TextEdit> &edits) const
+{
+    if (m_definitions.isEmpty())
+        return;
+
+    // Definitions are added at the end of the line of the last closing brace
+    const auto text = m_document->text();
+    int position = text.indexOf('\n', text.lastIndexOf('}') + 1);
+    if (position == -1)
+        position = static_cast<int>(text.size());
+
+    QString definitions;
+    for (const auto &definition : m_definitions)
+        definitions += "\n\n" + definition;
+    edits.push_back({{.start = position, .end = position}, definitions});
+}
+
+// Same as CppDocument::deleteMethodLocal, for all the deletions at once
+void ClassEditor::addDeletions(QVector<TextEdit> &edits) const
+{
+    if (m_deletions.isEmpty())
+        return;
+
+    const auto text = m_document->text();
+    const auto symbols = m_document->symbols();
+
+    std::vector<TextRange> ranges;
+    for (const auto &[methodName, signature] : m_deletions) {
+        for (const auto &symbol : symbols) {
+            if (!symbol->isFunction() || symbol->name() != methodName
+                || (!signature.isEmpty() && symbol->toFunction()->signature() != signature))
+                continue;
+
+            // Same range as CodeDocument::deleteSymbol: leading whitespace, trailing semicolon and newline
+            auto range = symbol->range();
+            while (range.start > 0 && (text.at(range.start - 1) == ' ' || text.at(range.start - 1) == '\t'))
+                --range.start;
+            if (range.end < text.size() && text.at(range.end) == ';')
+                ++range.end;
+            if (range.end < text.size() && text.at(range.end) == '\n')
+                ++range.end;
+            ranges.push_back(range);
+        }
+    }
+
+    // The same method may have been queued multiple times
+    std::ranges::sort(ranges);
+    const auto [first, last] = std::ranges::unique(ranges);
+    ranges.erase(first, last);
+    for (const auto &range : ranges)
+        edits.push_back({range, {}});
+}
+
+} // namespace Core
@@ -0,0 +1,63 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include "cppdocument.h"
+
+#include <QObject>
+#include <QPointer>
+#include <QVector>
+
+namespace Core {
+
+class ClassEditor : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(QString className READ className CONSTANT)
+
+public:
+    ClassEditor(CppDocument *document, const QString &className, QObject *parent = nullptr);
+    ~ClassEditor() override;
+
+    const QString &className() const;
+
+    Q_INVOKABLE void addMember(const QString &member, Core::CppDocument::AccessSpecifier specifier);
+    Q_INVOKABLE void addMethodDeclaration(const QString &method, Core::CppDocument::AccessSpecifier specifier);
+    Q_INVOKABLE void addMethodDefinition(const QString &method, const QString &body = "");
+    Q_INVOKABLE void deleteMethod(const QString &methodName, const QString &signature = "");
+
+    Q_INVOKABLE bool apply();
+
+private:
+    struct Declaration
+    {
+        QString text;
+        CppDocument::AccessSpecifier specifier;
+    };
+    struct Deletion
+    {
+        QString methodName;
+        QString signature;
+    };
+
+    bool addDeclarations(QVector<TextEdit> &edits) const;
+    void addDefinitions(QVector<TextEdit> &edits) const;
+    void addDeletions(QVector<TextEdit> &edits) const;
+
+    QPointer<CppDocument> m_document;
+    QString m_className;
+    // Pending changes, applied in one edit block by apply
+    QVector<Declaration> m_declarations;
+    QStringList m_definitions;
+    QVector<Deletion> m_deletions;
+};
+
+} // namespace Core
@@ -12,6 +12,8 @@
 #include "codedocument.h"
 #include "utils/log.h"
 
+#include <algorithm>
+
 namespace Core {
 
 /*!
@@ -26,18 +28,23 @@ namespace Core {
  * Returns the list of members (both data and functions) of this class.
  */
 
-ClassSymbol::ClassSymbol(QObject *parent, const QueryMatch &match, Kind kind)
-    : Symbol(parent, match, kind)
+ClassSymbol::ClassSymbol(QObject *parent, const QString &name, Captures &&captures, Kind kind)
+    : Symbol(parent, name, std::move(captures), kind)
 {
 }
 
 QVector<Symbol *> ClassSymbol::findMembers() const
 {
     if (auto codeDocument = qobject_cast<Core::CodeDocument *>(parent())) {
+        // Symbols are sorted by position, so only the symbols starting inside the class need to be checked
+        const auto symbols = codeDocument->symbols();
+        auto it = std::ranges::lower_bound(symbols, m_range.start, {}, [](const Symbol *symbol) {
+            return symbol->range().start;
+        });
         QVector<Symbol *> members;
-        for (auto &symbol : codeDocument->symbols()) {
-            if (m_range.contains(symbol->range()) && m_name != symbol->name())
-                members.append(symbol);
+        for (; it != symbols.cend() && (*it)->range().start <= m_range.end; ++it) {
+            if (m_range.contains((*it)->range()) && m_name != (*it)->name())
+                members.append(*it);
         }
         return members;
     }
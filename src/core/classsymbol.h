@@ -27,7 +27,7 @@ class ClassSymbol : public Symbol
 
 protected:
     friend class Symbol;
-    ClassSymbol(QObject *parent, const QueryMatch &match, Kind kind);
+    ClassSymbol(QObject *parent, const QString &name, Captures &&captures, Kind kind);
 
     // mutable for lazy initialization
     mutable std::optional<QVector<Symbol *>> m_members;
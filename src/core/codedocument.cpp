@@ -11,12 +11,17 @@
 #include "codedocument.h"
 #include "astnode.h"
 #include "codedocument_p.h"
+#include "jspromise.h"
 #include "logger.h"
 #include "project.h"
 #include "querymatch.h"
+#include "querymatchiterator.h"
 #include "rangemark.h"
+#include "settings.h"
 #include "symbol.h"
+#include "textdocument_p.h"
 #include "textlocation.h"
+#include "treesitter/languages.h"
 #include "treesitter/predicates.h"
 #include "utils/json.h"
 #include "utils/log.h"
@@ -25,16 +30,19 @@
 #include <QFile>
 #include <QJSEngine>
 #include <QMap>
-#include <QPlainTextEdit>
 #include <QTextBlock>
 #include <QTextDocument>
 #include <QTextStream>
 #include <algorithm>
 #include <kdalgorithms.h>
 #include <memory>
+#include <utility>
 
 namespace Core {
 
+// Delay in ms before pending changes are sent to the language server, if no LSP request is made in between.
+constexpr int LspChangesDelay = 250;
+
 /*!
  * \qmltype CodeDocument
  * \brief Base document object for any code that Knut can parse.
@@ -56,17 +64,123 @@ CodeDocument::CodeDocument(Type type, QObject *parent)
     : TextDocument(type, parent)
     , m_treeSitterHelper(std::make_unique<TreeSitterHelper>(this))
 {
-    connect(textEdit()->document(), &QTextDocument::contentsChange, this, &CodeDocument::changeContent);
+    connect(qTextDocument(), &QTextDocument::contentsChange, this, &CodeDocument::changeContent);
+
+    m_lspChangesTimer.setSingleShot(true);
+    m_lspChangesTimer.setInterval(LspChangesDelay);
+    connect(&m_lspChangesTimer, &QTimer::timeout, this, &CodeDocument::flushLspChanges);
+    // Reloading the document doesn't emit contentsChange, make sure we don't keep an outdated tree around.
+    connect(this, &Document::fileUpdated, this, [this]() {
+        m_treeSitterHelper->clear();
+        m_lspText.reset();
+    });
 }
 
 void CodeDocument::setLspClient(Lsp::Client *client)
 {
+    m_lspClientProvider = {};
     m_lspClient = client;
 }
 
+void CodeDocument::setLspClientProvider(std::function<Lsp::Client *()> provider)
+{
+    m_lspClient.clear();
+    m_lspClientProvider = std::move(provider);
+}
+
+void CodeDocument::setLspPrefetchedText(QString text)
+{
+    m_lspPrefetchedText = std::move(text);
+}
+
+const TSLanguage *CodeDocument::treeSitterLanguage(Type type)
+{
+    switch (type) {
+    case Type::Cpp:
+        return tree_sitter_cpp();
+    case Type::Qml:
+        return tree_sitter_qmljs();
+    default:
+        return nullptr;
+    }
+}
+
+const TSLanguage *CodeDocument::treeSitterLanguage() const
+{
+    return treeSitterLanguage(type());
+}
+
+QVariantMap CodeDocument::memoryUsage() const
+{
+    auto usage = TextDocument::memoryUsage();
+    usage["treesitter"] = static_cast<qint64>(m_treeSitterHelper->treeBytes());
+    usage["symbols"] = static_cast<qint64>(m_treeSitterHelper->symbolBytes());
+    return usage;
+}
+
+void CodeDocument::setPrefetchedTree(treesitter::Tree &&tree, const QString &text, int64_t treeBytes)
+{
+    m_treeSitterHelper->setPrefetchedTree(std::move(tree), text, treeBytes);
+}
+
 bool CodeDocument::hasLspClient() const
 {
-    return m_lspClient != nullptr;
+    if (isLargeFile() && !m_lspEnabledForLargeFile)
+        return false;
+    // A client not started yet is considered available
+    return m_lspClient != nullptr || m_lspClientProvider != nullptr;
+}
+
+QStringList CodeDocument::degradedFeatures() const
+{
+    auto features = TextDocument::degradedFeatures();
+    if (!isLargeFile())
+        return features;
+    if (!m_lspEnabledForLargeFile && (m_lspClient || m_lspClientProvider))
+        features.push_back("lsp");
+    features.push_back("background_parsing");
+    return features;
+}
+
+/*!
+ * \qmlmethod CodeDocument::enableLsp()
+ * Uses the language server for this document, even if it's a large file (see `TextDocument::degradedFeatures`).
+ * The whole text of the document is sent to the server when it's first needed.
+ */
+void CodeDocument::enableLsp()
+{
+    LOG("CodeDocument::enableLsp");
+    if (m_lspEnabledForLargeFile)
+        return;
+    m_lspEnabledForLargeFile = true;
+    if (isLargeFile())
+        emit largeFileChanged();
+}
+
+/*!
+ * \qmlmethod bool CodeDocument::waitForLspIndexing(int timeout = -1)
+ * Waits until the language server has indexed the project, for at most `timeout` milliseconds: -1 uses the
+ * `/lsp/indexing_timeout` setting, or the `--lsp-indexing-timeout` command line option. Returns false if the project
+ * is not indexed in time, or if the server doesn't report its indexing progress.
+ *
+ * Until the project is indexed, `references` may miss the references in the files not opened yet.
+ */
+bool CodeDocument::waitForLspIndexing(int timeout) const
+{
+    LOG("CodeDocument::waitForLspIndexing", LOG_ARG("timeout", timeout));
+
+    if (!checkClient())
+        return false;
+    if (timeout < 0)
+        timeout = Project::instance()->lspIndexingTimeout();
+    return client()->waitUntilIndexed(timeout);
+}
+
+// Waits for the indexing before the requests using the index, if a timeout is set
+void CodeDocument::waitForIndexing() const
+{
+    if (const int timeout = Project::instance()->lspIndexingTimeout(); timeout > 0)
+        client()->waitUntilIndexed(timeout);
 }
 
 /**
@@ -78,14 +192,7 @@ bool CodeDocument::hasLspClient() const
  */
 Symbol *CodeDocument::currentSymbol(const std::function<bool(const Symbol &)> &filterFunc) const
 {
-    const int pos = textEdit()->textCursor().position();
-
-    const auto symbolList = symbols();
-    for (auto symbol : symbolList | std::views::reverse) {
-        if (symbol->range().contains(pos) && (!filterFunc || filterFunc(*symbol)))
-            return symbol;
-    }
-    return {};
+    return m_treeSitterHelper->symbolAt(textCursor().position(), filterFunc);
 }
 
 /**
@@ -142,6 +249,11 @@ Core::SymbolList CodeDocument::symbols() const
     return m_treeSitterHelper->symbols();
 }
 
+void CodeDocument::updateSymbolsAsync(std::function<void()> callback)
+{
+    m_treeSitterHelper->updateSymbolsAsync(std::move(callback));
+}
+
 struct RegexpTransform
 {
     QString from;
@@ -166,7 +278,7 @@ NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(Transforms, patterns);
 const Core::Symbol *CodeDocument::symbolUnderCursor() const
 {
     const auto containsCursor = [this](const Core::Symbol *symbol) {
-        return symbol->selectionRange().contains(textEdit()->textCursor().position());
+        return symbol->selectionRange().contains(textCursor().position());
     };
 
     const auto symbols = this->symbols();
@@ -178,6 +290,15 @@ const Core::Symbol *CodeDocument::symbolUnderCursor() const
     return nullptr;
 }
 
+static std::optional<QString> hoverMarkupText(const Lsp::Hover &hover)
+{
+    if (const auto *content = std::get_if<Lsp::MarkupContent>(&hover.contents))
+        return QString::fromStdString(content->value);
+    spdlog::warn("LSP returned deprecated MarkedString type which is unsupported by Knut\n - Consider updating "
+                 "your LSP server");
+    return {};
+}
+
 /*!
  * \qmlmethod string CodeDocument::hover()
  *
@@ -186,7 +307,7 @@ const Core::Symbol *CodeDocument::symbolUnderCursor() const
  */
 QString CodeDocument::hover() const
 {
-    return hover(textEdit()->textCursor().position());
+    return hover(textCursor().position());
 }
 
 QString CodeDocument::hover(int position, std::function<void(const QString &)> asyncCallback /*  = {} */) const
@@ -210,11 +331,30 @@ std::pair<QString, std::optional<TextRange>> CodeDocument::hoverWithRange(
     if (!checkClient())
         return {"", {}};
 
+    // The cache is cleared as soon as the document changes, any result in it is still valid
+    if (auto it = m_hoverCache.constFind(position); it != m_hoverCache.cend()) {
+        if (!asyncCallback)
+            return it.value();
+        // Keep the callback asynchronous, like when the request is sent to the server
+        QTimer::singleShot(0, this, [asyncCallback = std::move(asyncCallback), result = it.value()]() {
+            asyncCallback(result.first, result.second);
+        });
+        return {"", {}};
+    }
+
+    flushLspChanges();
+
     Lsp::HoverParams params;
     params.textDocument.uri = toUri();
     params.position = fromPos(position);
 
     QPointer<const CodeDocument> safeThis(this);
+    const int generation = m_hoverCacheGeneration;
+    auto cacheResult = [safeThis, generation, position](const std::pair<QString, std::optional<TextRange>> &result) {
+        // Don't cache the result if the document has been changed while waiting for the response
+        if (!safeThis.isNull() && safeThis->m_hoverCacheGeneration == generation)
+            safeThis->m_hoverCache.insert(position, result);
+    };
 
     auto convertResult = [safeThis](const auto &result) -> std::pair<QString, std::optional<TextRange>> {
         if (!std::holds_alternative<Lsp::Hover>(result)) {
@@ -228,22 +368,27 @@ std::pair<QString, std::optional<TextRange>> CodeDocument::hoverWithRange(
             range = safeThis->toRange(hover.range.value());
         }
 
-        Lsp::MarkupContent markupContent;
-        if (const auto *content = std::get_if<Lsp::MarkupContent>(&hover.contents)) {
-            return {QString::fromStdString(content->value), range};
-        } else {
-            spdlog::warn("LSP returned deprecated MarkedString type which is unsupported by Knut\n - Consider updating "
-                         "your LSP server");
-            return {"", {}};
-        }
+        if (auto text = hoverMarkupText(hover))
+            return {text.value(), range};
+        return {"", {}};
     };
 
     if (asyncCallback) {
+        // A new hover supersedes the previous one (e.g. the mouse moved before the tooltip was shown)
+        if (m_pendingHoverRequest)
+            client()->cancelRequest(m_pendingHoverRequest.value());
+        const auto previousRequestId = client()->lastRequestId();
         client()->hover(std::move(params),
-                        [convertResult, asyncCallback = std::move(asyncCallback)](const auto result) {
+                        [convertResult, cacheResult, asyncCallback = std::move(asyncCallback)](const auto result) {
                             auto hoverText = convertResult(result);
+                            cacheResult(hoverText);
                             asyncCallback(hoverText.first, hoverText.second);
                         });
+        // Nothing is sent if the server doesn't support hover
+        if (client()->lastRequestId() != previousRequestId)
+            m_pendingHoverRequest = client()->lastRequestId();
+        else
+            m_pendingHoverRequest.reset();
     } else {
         auto result = client()->hover(std::move(params));
         if (result) {
@@ -253,13 +398,261 @@ std::pair<QString, std::optional<TextRange>> CodeDocument::hoverWithRange(
             if (!std::holds_alternative<Lsp::Hover>(result.value())) {
                 spdlog::debug("LSP server returned no result for Hover");
             }
-            return convertResult(result.value());
+            auto hoverText = convertResult(result.value());
+            cacheResult(hoverText);
+            return hoverText;
         }
     }
 
     return {"", {}};
 }
 
+/*!
+ * \qmlmethod array<string> CodeDocument::hoverAll(array<int> positions)
+ *
+ * Returns information about the symbols at all the given `positions`, in the same order.
+ * The requests are sent to the LSP server in batch, which is a lot faster than calling `hover` for each position.
+ * The result for a position is an empty string if there's no information available.
+ */
+QStringList CodeDocument::hoverAll(const QList<int> &positions) const
+{
+    LOG("CodeDocument::hoverAll");
+
+    if (!checkClient())
+        return QStringList(positions.size());
+
+    flushLspChanges();
+
+    const auto uri = toUri();
+    std::vector<Lsp::HoverParams> params(positions.size());
+    for (qsizetype i = 0; i < positions.size(); ++i) {
+        params[i].textDocument.uri = uri;
+        params[i].position = fromPos(positions[i]);
+    }
+    const auto responses = client()->hoverBatch(std::move(params));
+
+    QStringList result;
+    result.reserve(positions.size());
+    for (const auto &response : responses) {
+        QString text;
+        if (response) {
+            if (const auto *hover = std::get_if<Lsp::Hover>(&response.value()))
+                text = hoverMarkupText(*hover).value_or(QString());
+        }
+        result.push_back(text);
+    }
+    return result;
+}
+
+// Resolves `promise` with the result of the LSP request `future` converted with `convert`, once the server responds.
+// Like the synchronous API, errors are logged and the promise is resolved with an empty result.
+template <typename Result, typename Convert>
+static QJSValue resolveWhenFinished(QFuture<std::optional<Result>> future, const JsPromise &promise,
+                                    const char *function, Convert convert)
+{
+    auto engine = promise.engine();
+    future
+        .then(engine,
+              [promise, function, convert](const std::optional<Result> &result) {
+                  if (!result)
+                      spdlog::warn("{}: LSP request failed", function);
+                  promise.resolve(convert(result));
+              })
+        .onCanceled(engine, [promise, function, convert]() {
+            spdlog::warn("{}: LSP request was cancelled", function);
+            promise.resolve(convert(std::optional<Result>()));
+        });
+    return promise.value();
+}
+
+// Returns a promise already resolved with `result`, when there's no request to send.
+static QJSValue resolvedPromise(const JsPromise &promise, const QJSValue &result)
+{
+    promise.resolve(result);
+    return promise.value();
+}
+
+// Returns the script engine running the script that uses `document`.
+static QJSEngine *scriptEngine(const CodeDocument *document, const char *function)
+{
+    auto engine = qjsEngine(document);
+    if (!engine)
+        spdlog::error("{} - can't be called outside of a script", function);
+    return engine;
+}
+
+/*!
+ * \qmlmethod Promise<string> CodeDocument::hoverAsync(int position)
+ *
+ * Same as `hover`, for the symbol at `position`, but returns a promise instead of waiting for the LSP server.
+ * Many requests can then be sent at once, and the script can do something else while waiting for the responses:
+ *
+ * ```js
+ * async function main() {
+ *     let texts = await Promise.all(positions.map(position => document.hoverAsync(position)));
+ * }
+ * ```
+ *
+ * The promise is resolved with an empty string if there's no information available.
+ */
+QJSValue CodeDocument::hoverAsync(int position) const
+{
+    LOG("CodeDocument::hoverAsync", position);
+
+    auto engine = scriptEngine(this, "CodeDocument::hoverAsync");
+    if (!engine)
+        return {};
+    JsPromise promise(engine);
+    if (!checkClient())
+        return resolvedPromise(promise, QString());
+
+    flushLspChanges();
+
+    Lsp::HoverParams params;
+    params.textDocument.uri = toUri();
+    params.position = fromPos(position);
+    return resolveWhenFinished(client()->hoverAsync(std::move(params)), promise, "CodeDocument::hoverAsync",
+                               [](const auto &result) {
+                                   QString text;
+                                   if (result) {
+                                       if (const auto *hover = std::get_if<Lsp::Hover>(&result.value()))
+                                           text = hoverMarkupText(*hover).value_or(QString());
+                                   }
+                                   return QJSValue(text);
+                               });
+}
+
+static QString severityName(std::optional<Lsp::DiagnosticSeverity> severity)
+{
+    switch (severity.value_or(Lsp::DiagnosticSeverity::Error)) {
+    case Lsp::DiagnosticSeverity::Error:
+        return "error";
+    case Lsp::DiagnosticSeverity::Warning:
+        return "warning";
+    case Lsp::DiagnosticSeverity::Information:
+        return "info";
+    case Lsp::DiagnosticSeverity::Hint:
+        return "hint";
+    }
+    Q_UNREACHABLE();
+    return {};
+}
+
+/*!
+ * \qmlmethod array<string> CodeDocument::diagnostics()
+ *
+ * Returns the errors and warnings reported by the LSP server for the current content of the document, one string per
+ * diagnostic formatted like compiler output: `file:line:column: severity: message`.
+ *
+ * This is a cheap way to check that the code still compiles after some edits. The diagnostics are cached until the
+ * document changes.
+ */
+QStringList CodeDocument::diagnostics() const
+{
+    LOG("CodeDocument::diagnostics");
+
+    if (!checkClient())
+        return {};
+
+    flushLspChanges();
+
+    QStringList result;
+    for (const auto &diagnostic : updateDiagnostics()) {
+        result.push_back(QString("%1:%2:%3: %4: %5")
+                             .arg(fileName())
+                             .arg(diagnostic.range.start.line + 1)
+                             .arg(diagnostic.range.start.character + 1)
+                             .arg(severityName(diagnostic.severity), QString::fromStdString(diagnostic.message)));
+    }
+    return result;
+}
+
+const std::vector<Lsp::Diagnostic> &CodeDocument::updateDiagnostics() const
+{
+    if (m_diagnostics.revision == m_revision)
+        return m_diagnostics.data;
+
+    if (client()->canSendDiagnostic()) {
+        Lsp::DocumentDiagnosticParams params;
+        params.textDocument.uri = toUri();
+        params.previousResultId = m_diagnostics.resultId;
+        const auto result = client()->diagnostic(std::move(params));
+        if (!result) {
+            m_diagnostics = {};
+            return m_diagnostics.data;
+        }
+        if (const auto *full = std::get_if<Lsp::RelatedFullDocumentDiagnosticReport>(&result.value())) {
+            m_diagnostics.data = full->items;
+            m_diagnostics.resultId = full->resultId;
+        } else {
+            // Nothing changed since the previous result
+            m_diagnostics.resultId = std::get<Lsp::RelatedUnchangedDocumentDiagnosticReport>(result.value()).resultId;
+        }
+    } else {
+        // Servers like clangd don't answer diagnostic requests, but publish the diagnostics after each change
+        const auto timeout = Settings::instance()->value<int>(Settings::LspRequestTimeout);
+        if (!client()->waitForPublishedDiagnostics(toUri(), m_revision, timeout)) {
+            spdlog::warn("CodeDocument::diagnostics - no diagnostics published by the LSP server for {}", fileName());
+            m_diagnostics = {};
+            return m_diagnostics.data;
+        }
+        m_diagnostics.data = client()->publishedDiagnostics(toUri())->diagnostics;
+    }
+    m_diagnostics.revision = m_revision;
+    return m_diagnostics.data;
+}
+
+std::vector<unsigned int> CodeDocument::semanticTokens() const
+{
+    if (!checkClient())
+        return {};
+
+    flushLspChanges();
+
+    if (m_semanticTokens.revision == m_revision)
+        return m_semanticTokens.data;
+
+    const auto uri = toUri();
+    if (m_semanticTokens.resultId && client()->canSendSemanticTokensDelta()) {
+        Lsp::SemanticTokensDeltaParams params;
+        params.textDocument.uri = uri;
+        params.previousResultId = m_semanticTokens.resultId.value();
+        const auto result = client()->semanticTokensFullDelta(std::move(params));
+        if (result && std::holds_alternative<Lsp::SemanticTokensDelta>(result.value())) {
+            auto delta = std::get<Lsp::SemanticTokensDelta>(result.value());
+            // The edits refer to the previous result, apply them from the last one to keep the offsets valid
+            std::ranges::sort(delta.edits, std::ranges::greater {}, &Lsp::SemanticTokensEdit::start);
+            auto &data = m_semanticTokens.data;
+            for (const auto &edit : delta.edits) {
+                const auto start = data.begin() + std::min<size_t>(edit.start, data.size());
+                const auto end = start + std::min<size_t>(edit.deleteCount, data.end() - start);
+                const auto position = data.erase(start, end);
+                if (edit.data)
+                    data.insert(position, edit.data->cbegin(), edit.data->cend());
+            }
+            m_semanticTokens.resultId = delta.resultId;
+            m_semanticTokens.revision = m_revision;
+            return data;
+        }
+        if (result && std::holds_alternative<Lsp::SemanticTokens>(result.value())) {
+            auto tokens = std::get<Lsp::SemanticTokens>(result.value());
+            m_semanticTokens = {m_revision, std::move(tokens.resultId), std::move(tokens.data)};
+            return m_semanticTokens.data;
+        }
+    }
+
+    Lsp::SemanticTokensParams params;
+    params.textDocument.uri = uri;
+    const auto result = client()->semanticTokensFull(std::move(params));
+    if (result && std::holds_alternative<Lsp::SemanticTokens>(result.value())) {
+        auto tokens = std::get<Lsp::SemanticTokens>(result.value());
+        m_semanticTokens = {m_revision, std::move(tokens.resultId), std::move(tokens.data)};
+    } else {
+        m_semanticTokens = {};
+    }
+    return m_semanticTokens.data;
+}
+
 Core::TextLocationList CodeDocument::references(int position) const
 {
     LOG("CodeDocument::references");
@@ -268,6 +661,9 @@ Core::TextLocationList CodeDocument::references(int position) const
         return {};
     }
 
+    flushLspChanges();
+    waitForIndexing();
+
     Lsp::ReferenceParams params;
     params.textDocument.uri = toUri();
     params.position = fromPos(position);
@@ -287,6 +683,41 @@ Core::TextLocationList CodeDocument::references(int position) const
     return textLocations;
 }
 
+/*!
+ * \qmlmethod Promise<array<TextLocation>> CodeDocument::referencesAsync(int position)
+ *
+ * Returns a promise resolved with the locations of all the references to the symbol at `position`, once the LSP
+ * server has responded. The script isn't blocked in the meantime, see `hoverAsync`.
+ */
+QJSValue CodeDocument::referencesAsync(int position) const
+{
+    LOG("CodeDocument::referencesAsync", position);
+
+    auto engine = scriptEngine(this, "CodeDocument::referencesAsync");
+    if (!engine)
+        return {};
+    JsPromise promise(engine);
+    if (!checkClient())
+        return resolvedPromise(promise, engine->toScriptValue(Core::TextLocationList()));
+
+    flushLspChanges();
+    waitForIndexing();
+
+    Lsp::ReferenceParams params;
+    params.textDocument.uri = toUri();
+    params.position = fromPos(position);
+    return resolveWhenFinished(client()->referencesAsync(std::move(params)), promise,
+                               "CodeDocument::referencesAsync", [engine](const auto &result) {
+                                   Core::TextLocationList textLocations;
+                                   if (result) {
+                                       if (const auto *locations =
+                                               std::get_if<std::vector<Lsp::Location>>(&result.value()))
+                                           textLocations = TextLocation::fromLsp(*locations);
+                                   }
+                                   return engine->toScriptValue(textLocations);
+                               });
+}
+
 /*!
  * \qmlmethod CodeDocument::followSymbol()
  * Follows the symbol under the cursor.
@@ -304,7 +735,7 @@ Document *CodeDocument::followSymbol()
     // Set the cursor position to the beginning of any selected text.
     // That way, calling followSymbol twice in a row causes Clangd
     // to switch between declaration and definition.
-    auto cursor = textEdit()->textCursor();
+    auto cursor = textCursor();
     LOG_RETURN("document", followSymbol(cursor.selectionStart()));
 }
 
@@ -314,30 +745,32 @@ Document *CodeDocument::followSymbol()
 // - Go to the definition, if the symbol under cursor is a declaration
 Document *CodeDocument::followSymbol(int pos)
 {
-    auto cursor = textEdit()->textCursor();
-    cursor.setPosition(pos);
+    flushLspChanges();
 
     Lsp::DeclarationParams params;
     params.textDocument.uri = toUri();
-    params.position.line = cursor.blockNumber();
-    params.position.character = cursor.positionInBlock();
+    params.position = fromPos(pos);
 
     auto result = client()->declaration(std::move(params));
 
     Q_ASSERT(result.has_value());
+    return openDeclaration(*result);
+}
 
+Document *CodeDocument::openDeclaration(const Lsp::TextDocumentDeclarationRequest::Result &result)
+{
     auto locations = std::vector<Lsp::Location>();
 
-    if (std::holds_alternative<Lsp::Declaration>(*result)) {
-        auto &declaration = std::get<Lsp::Declaration>(*result);
+    if (std::holds_alternative<Lsp::Declaration>(result)) {
+        auto &declaration = std::get<Lsp::Declaration>(result);
         if (std::holds_alternative<Lsp::Location>(declaration)) {
             auto location = std::get<Lsp::Location>(declaration);
             locations.push_back(location);
         } else if (std::holds_alternative<std::vector<Lsp::Location>>(declaration)) {
             locations = std::move(std::get<std::vector<Lsp::Location>>(declaration));
         }
-    } else if (std::holds_alternative<std::vector<Lsp::DeclarationLink>>(*result)) {
-        const auto locationLinks = std::get<std::vector<Lsp::DeclarationLink>>(*result);
+    } else if (std::holds_alternative<std::vector<Lsp::DeclarationLink>>(result)) {
+        const auto locationLinks = std::get<std::vector<Lsp::DeclarationLink>>(result);
         for (const auto &link : locationLinks)
             locations.push_back({link.targetUri, link.targetSelectionRange});
     }
@@ -370,6 +803,37 @@ Document *CodeDocument::followSymbol(int pos)
     return document;
 }
 
+/*!
+ * \qmlmethod Promise<Document> CodeDocument::followSymbolAsync()
+ *
+ * Same as `followSymbol`, but returns a promise resolved with the document opened, or `null` if there's no declaration,
+ * instead of waiting for the LSP server.
+ */
+QJSValue CodeDocument::followSymbolAsync()
+{
+    LOG("CodeDocument::followSymbolAsync");
+
+    auto engine = scriptEngine(this, "CodeDocument::followSymbolAsync");
+    if (!engine)
+        return {};
+    JsPromise promise(engine);
+    if (!checkClient())
+        return resolvedPromise(promise, QJSValue(QJSValue::NullValue));
+
+    flushLspChanges();
+
+    Lsp::DeclarationParams params;
+    params.textDocument.uri = toUri();
+    params.position = fromPos(textCursor().selectionStart());
+    QPointer<CodeDocument> safeThis(this);
+    return resolveWhenFinished(client()->declarationAsync(std::move(params)), promise,
+                               "CodeDocument::followSymbolAsync", [safeThis, engine](const auto &result) {
+                                   if (!result || safeThis.isNull())
+                                       return QJSValue(QJSValue::NullValue);
+                                   return engine->toScriptValue(safeThis->openDeclaration(result.value()));
+                               });
+}
+
 // Switches between the function declaration or definition.
 Document *CodeDocument::switchDeclarationDefinition()
 {
@@ -377,7 +841,7 @@ Document *CodeDocument::switchDeclarationDefinition()
     if (!checkClient())
         return {};
 
-    auto cursor = textEdit()->textCursor();
+    auto cursor = textCursor();
     auto symbolList = symbols();
 
     auto currentFunction = kdalgorithms::find_if(symbolList, [&cursor](const auto &symbol) {
@@ -426,18 +890,17 @@ Symbol *CodeDocument::findSymbol(const QString &name, int options) const
 {
     LOG("CodeDocument::findSymbol", LOG_ARG("text", name), options);
 
-    auto symbols = this->symbols();
+    const auto cs = (options & FindCaseSensitively) ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    if (options & FindWholeWords)
+        return m_treeSitterHelper->findSymbol(name, cs);
+
+    const auto &symbols = m_treeSitterHelper->symbols();
     const auto regexp = (options & FindRegexp) ? Utils::createRegularExpression(name, options) : QRegularExpression {};
-    auto byName = [name, options, regexp](Symbol *symbol) {
-        if (options & FindWholeWords)
-            return symbol->name().compare(name,
-                                          (options & FindCaseSensitively) ? Qt::CaseSensitive : Qt::CaseInsensitive)
-                == 0;
-        else if (options & FindRegexp)
+    auto byName = [&name, options, cs, &regexp](Symbol *symbol) {
+        if (options & FindRegexp)
             return regexp.match(symbol->name()).hasMatch();
         else
-            return symbol->name().endsWith(name,
-                                           (options & FindCaseSensitively) ? Qt::CaseSensitive : Qt::CaseInsensitive);
+            return symbol->name().endsWith(name, cs);
     };
     auto it = std::ranges::find_if(symbols, byName);
     if (it != symbols.end())
@@ -447,15 +910,36 @@ Symbol *CodeDocument::findSymbol(const QString &name, int options) const
 
 void CodeDocument::didOpen()
 {
-    if (!m_lspClient)
+    sendDidOpen();
+}
+
+void CodeDocument::sendDidOpen() const
+{
+    if (!m_lspClient || fileName().isEmpty())
         return;
 
+    const auto plainText = plainText();
+    if (const auto prefetchedText = std::exchange(m_lspPrefetchedText, std::nullopt)) {
+        if (*prefetchedText == plainText) {
+            if (m_lspClient->canSendDocumentChanges(Lsp::TextDocumentSyncKind::Incremental))
+                m_lspText = plainText;
+            return;
+        }
+        // The file was opened with another text, e.g. with a different encoding
+        Lsp::DidCloseTextDocumentParams params;
+        params.textDocument.uri = toUri();
+        m_lspClient->didClose(std::move(params));
+    }
+
     Lsp::DidOpenTextDocumentParams params;
     params.textDocument.uri = toUri();
     params.textDocument.version = revision();
-    params.textDocument.text = textEdit()->toPlainText().toStdString();
+    params.textDocument.text = Utils::toStdString(plainText);
     params.textDocument.languageId = m_lspClient->languageId();
 
+    if (m_lspClient->canSendDocumentChanges(Lsp::TextDocumentSyncKind::Incremental))
+        m_lspText = plainText;
+
     m_lspClient->didOpen(std::move(params));
 }
 
@@ -464,14 +948,56 @@ void CodeDocument::didClose()
     if (!m_lspClient)
         return;
 
+    // No need to send the pending changes, the server forgets about the document anyway
+    m_lspChangesTimer.stop();
+    m_pendingLspChanges.clear();
+    m_pendingLspChangesSize = 0;
+    m_pendingLspChangeEnd = -1;
+    m_pendingLspFullChange = false;
+    m_lspText.reset();
+
     Lsp::DidCloseTextDocumentParams params;
     params.textDocument.uri = toUri();
 
     m_lspClient->didClose(std::move(params));
 }
 
+void CodeDocument::doEvict()
+{
+    TextDocument::doEvict();
+    m_treeSitterHelper->clear();
+    m_hoverCache.clear();
+    ++m_hoverCacheGeneration;
+    m_queryResults.clear();
+
+    releaseLspClient();
+}
+
+void CodeDocument::releaseLspClient()
+{
+    if (!m_lspClient)
+        return;
+
+    didClose();
+    // The server forgot the results, and the document: it's opened again when the LSP is needed
+    m_diagnostics = {};
+    m_semanticTokens = {};
+    m_lspClientProvider = [client = m_lspClient]() {
+        return client.data();
+    };
+    m_lspClient.clear();
+}
+
 Lsp::Client *CodeDocument::client() const
 {
+    if (isLargeFile() && !m_lspEnabledForLargeFile)
+        return nullptr;
+    // The server is only started, and told about the document, when the LSP is really needed
+    if (m_lspClientProvider) {
+        const auto provider = std::exchange(m_lspClientProvider, {});
+        m_lspClient = provider();
+        sendDidOpen();
+    }
     return m_lspClient;
 }
 
@@ -482,26 +1008,25 @@ std::string CodeDocument::toUri() const
 
 int CodeDocument::toPos(const Lsp::Position &pos) const
 {
-    // Internally, columns are 0-based, like in LSP
-    const int blockNumber = qMin((int)pos.line, textEdit()->document()->blockCount() - 1);
-    const QTextBlock &block = textEdit()->document()->findBlockByNumber(blockNumber);
-    if (block.isValid()) {
-        QTextCursor cursor(block);
-        cursor.movePosition(QTextCursor::Right, QTextCursor::MoveAnchor, pos.character);
-        return cursor.position();
-    }
-    return 0;
+    // Internally, columns are 0-based and in UTF-16 code units, like in LSP
+    const auto &index = lineIndex();
+    const auto line = static_cast<int>(std::min<unsigned int>(pos.line, index.lineCount() - 1));
+    // Like LSP, a character past the end of the line defaults back to the end of the line
+    const auto character = static_cast<int>(std::min<unsigned int>(pos.character, index.lineLength(line)));
+    return index.lineStart(line) + character;
 }
 
 Lsp::Position CodeDocument::fromPos(int pos) const
 {
-    Lsp::Position position;
+    Lsp::Position position = {};
 
-    auto cursor = textEdit()->textCursor();
-    cursor.setPosition(pos, QTextCursor::MoveAnchor);
+    const auto &index = lineIndex();
+    const int line = index.lineAt(pos);
+    if (line == -1)
+        return position;
 
-    position.line = cursor.blockNumber();
-    position.character = cursor.positionInBlock();
+    position.line = line;
+    position.character = pos - index.lineStart(line);
     return position;
 }
 
@@ -510,7 +1035,9 @@ TextRange CodeDocument::toRange(const Lsp::Range &range) const
     return {toPos(range.start), toPos(range.end)};
 }
 
-std::optional<treesitter::QueryCursor> CodeDocument::createQueryCursor(const std::shared_ptr<treesitter::Query> &query)
+std::optional<treesitter::QueryCursor> CodeDocument::createQueryCursor(const std::shared_ptr<treesitter::Query> &query,
+                                                                       const RangeMark &range,
+                                                                       treesitter::Predicates::Parameters parameters)
 {
     const auto &tree = m_treeSitterHelper->syntaxTree();
     if (!tree || !query) {
@@ -519,53 +1046,141 @@ std::optional<treesitter::QueryCursor> CodeDocument::createQueryCursor(const std
 
     treesitter::QueryCursor cursor;
     cursor.setProgressCallback(ScriptDialogItem::updateProgress);
-    cursor.execute(query, tree->rootNode(), std::make_unique<treesitter::Predicates>(text()));
+    cursor.setMatchLimit(Settings::instance()->value<uint32_t>(Settings::TreeSitterQueryMatchLimit));
+    // Tree-sitter positions are UTF-16 bytes
+    if (range.isValid())
+        cursor.setByteRange(range.start() * sizeof(QChar), range.end() * sizeof(QChar));
+    auto predicates =
+        std::make_unique<treesitter::Predicates>(m_treeSitterHelper->syntaxTreeText(), std::move(parameters));
+    predicates->setMessageMapProvider([this]() {
+        return messageMapRange();
+    });
+    cursor.execute(query, tree->rootNode(), std::move(predicates));
     return cursor;
 }
 
+std::optional<treesitter::Predicates::MessageMapRange> CodeDocument::messageMapRange() const
+{
+    return m_treeSitterHelper->messageMap();
+}
+
 Core::QueryMatch CodeDocument::queryFirst(const std::shared_ptr<treesitter::Query> &query)
 {
+    if (const auto it = m_queryResults.constFind(query.get()); it != m_queryResults.cend()) {
+        if (it->matches)
+            return it->matches->isEmpty() ? QueryMatch() : it->matches->first();
+        if (it->first)
+            return *it->first;
+    }
+
     auto cursor = createQueryCursor(query);
     if (!cursor.has_value()) {
         return {};
     }
 
     auto match = cursor->nextMatch();
-    if (match.has_value()) {
-        return QueryMatch(*this, match.value());
-    } else {
-        return QueryMatch();
+    auto result = match.has_value() ? QueryMatch(*this, match.value()) : QueryMatch();
+    if (!cursor->didExceedMatchLimit())
+        cachedQueryResults(query).first = result;
+    return result;
+}
+
+// The results are only valid until the document changes, see changeContent.
+// The compiled query is kept alive with its results, so its address can't be reused by another query.
+CodeDocument::QueryResults &CodeDocument::cachedQueryResults(const std::shared_ptr<treesitter::Query> &query)
+{
+    auto &results = m_queryResults[query.get()];
+    results.query = query;
+    return results;
+}
+
+Core::QueryMatchList CodeDocument::allMatches(treesitter::QueryCursor &cursor, int maxMatches)
+{
+    Core::QueryMatchList result;
+    while (maxMatches < 0 || result.size() < maxMatches) {
+        const auto match = cursor.nextMatch();
+        if (!match.has_value())
+            break;
+        result.push_back(QueryMatch(*this, match.value()));
     }
+
+    if (cursor.didExceedMatchLimit())
+        spdlog::warn("CodeDocument::query: Too many matches in progress, some matches may be missing");
+    if (cursor.hasExpired())
+        spdlog::warn("CodeDocument::query: The query timed out, only {} matches were found", result.size());
+    return result;
 }
 
 Core::QueryMatchList CodeDocument::query(const std::shared_ptr<treesitter::Query> &query)
 {
+    if (const auto it = m_queryResults.constFind(query.get()); it != m_queryResults.cend() && it->matches)
+        return *it->matches;
+
     auto cursor = createQueryCursor(query);
     if (!cursor.has_value()) {
         return {};
     }
 
-    auto matches = cursor->allRemainingMatches();
+    auto result = allMatches(cursor.value());
+    // Some matches are missing, the next call may find them with a higher limit
+    if (!cursor->didExceedMatchLimit())
+        cachedQueryResults(query).matches = result;
+    return result;
+}
 
-    return kdalgorithms::transformed<Core::QueryMatchList>(matches, [this](const treesitter::QueryMatch &match) {
-        return QueryMatch(*this, match);
-    });
+std::shared_ptr<const TreeSnapshot> CodeDocument::treeSnapshot() const
+{
+    return m_treeSitterHelper->snapshot();
+}
+
+Core::QueryMatchList CodeDocument::query(const QString &query, treesitter::Predicates::Parameters parameters)
+{
+    return this->query(m_treeSitterHelper->constructQuery(query), std::move(parameters));
+}
+
+Core::QueryMatchList CodeDocument::query(const std::shared_ptr<treesitter::Query> &query,
+                                         treesitter::Predicates::Parameters parameters)
+{
+    auto cursor = createQueryCursor(query, {}, std::move(parameters));
+    if (!cursor.has_value())
+        return {};
+    return allMatches(cursor.value());
 }
 
 /*!
- * \qmlmethod array<QueryMatch> CodeDocument::query(string query)
+ * \qmlmethod array<QueryMatch> CodeDocument::query(string query, int maxMatches = -1, int timeout = -1)
  * Runs the given Tree-sitter `query` and returns the list of matches.
  *
  * The query is using [Tree-sitter
  * queries](https://tree-sitter.github.io/tree-sitter/using-parsers#pattern-matching-with-queries).
  *
+ * For exploratory queries on large files, the query can be stopped after `maxMatches` matches, or after `timeout`
+ * milliseconds. In both cases, the matches found so far are returned. Use -1 for no limit.
+ *
+ * The results are kept until the document changes: running the same query again is cheap.
+ *
  * Also see: [Tree-sitter in Knut](../../getting-started/treesitter.md)
  */
-Core::QueryMatchList CodeDocument::query(const QString &query)
+Core::QueryMatchList CodeDocument::query(const QString &query, int maxMatches, int timeout)
 {
-    LOG("CodeDocument::query", LOG_ARG("query", query));
+    LOG("CodeDocument::query", LOG_ARG("query", query), LOG_ARG("maxMatches", maxMatches),
+        LOG_ARG("timeout", timeout));
+
+    auto tsQuery = m_treeSitterHelper->constructQuery(query);
+    // Queries stopped by a timeout are not memoized, their results depend on the machine load
+    if (timeout < 0) {
+        if (maxMatches < 0)
+            return this->query(tsQuery);
+        if (const auto it = m_queryResults.constFind(tsQuery.get()); it != m_queryResults.cend() && it->matches)
+            return it->matches->first(std::min<qsizetype>(maxMatches, it->matches->size()));
+    }
 
-    return this->query(m_treeSitterHelper->constructQuery(query));
+    auto cursor = createQueryCursor(tsQuery);
+    if (!cursor.has_value())
+        return {};
+    if (timeout >= 0)
+        cursor->setDeadline(QDeadlineTimer(timeout));
+    return allMatches(cursor.value(), maxMatches);
 }
 
 /*!
@@ -588,44 +1203,150 @@ Core::QueryMatch CodeDocument::queryFirst(const QString &query)
     return this->queryFirst(m_treeSitterHelper->constructQuery(query));
 }
 
+/*!
+ * \qmlmethod QueryMatchIterator CodeDocument::queryIterator(string query)
+ * Runs the given Tree-sitter `query` and returns an iterator on the matches.
+ *
+ * Contrary to `query`, the matches are only searched for when they are requested. Use it for queries with many matches
+ * when you don't need all of them.
+ *
+ * \sa QueryMatchIterator
+ */
+Core::QueryMatchIterator *CodeDocument::queryIterator(const QString &query)
+{
+    LOG("CodeDocument::queryIterator", LOG_ARG("query", query));
+
+    auto tsQuery = m_treeSitterHelper->constructQuery(query);
+    const auto &tree = m_treeSitterHelper->syntaxTree();
+    std::optional<treesitter::Tree> treeCopy;
+    if (tree)
+        treeCopy = tree->copy();
+    // No parent, so the iterator is owned by the JavaScript engine
+    return new QueryMatchIterator(this, std::move(treeCopy), m_treeSitterHelper->syntaxTreeText(), std::move(tsQuery));
+}
+
+/*!
+ * \qmlmethod array<int> CodeDocument::queryRanges(string query, string capture, int maxMatches = -1, int timeout = -1)
+ * Runs the given Tree-sitter `query` and returns the ranges of all captures named `capture`, as a flat array of
+ * positions: `[start0, end0, start1, end1, ...]`, the end positions being exclusive.
+ *
+ * Contrary to `query`, no QueryMatch or RangeMark is created, which is a lot faster when there are many matches and
+ * only the positions are needed. Use `textRegions` to get the texts, and `applyEdits` to change them. The positions
+ * are not updated when the document changes.
+ *
+ * ```javascript
+ * let ranges = document.queryRanges("(call_expression function: (identifier) @name)", "name");
+ * let names = document.textRegions(ranges);
+ * ```
+ * \sa CodeDocument::query
+ */
+QList<int> CodeDocument::queryRanges(const QString &query, const QString &capture, int maxMatches, int timeout)
+{
+    LOG("CodeDocument::queryRanges", LOG_ARG("query", query), LOG_ARG("capture", capture),
+        LOG_ARG("maxMatches", maxMatches), LOG_ARG("timeout", timeout));
+
+    auto cursor = createQueryCursor(m_treeSitterHelper->constructQuery(query));
+    if (!cursor.has_value())
+        return {};
+    if (timeout >= 0)
+        cursor->setDeadline(QDeadlineTimer(timeout));
+
+    QList<int> result;
+    int matchCount = 0;
+    while (maxMatches < 0 || matchCount < maxMatches) {
+        const auto match = cursor->nextMatch();
+        if (!match.has_value())
+            break;
+        ++matchCount;
+        const auto captures = match->capturesNamed(capture);
+        for (const auto &matchCapture : captures) {
+            result.push_back(static_cast<int>(matchCapture.node.startPosition()));
+            result.push_back(static_cast<int>(matchCapture.node.endPosition()));
+        }
+    }
+
+    if (cursor->didExceedMatchLimit())
+        spdlog::warn("CodeDocument::queryRanges: Too many matches in progress, some matches may be missing");
+    if (cursor->hasExpired())
+        spdlog::warn("CodeDocument::queryRanges: The query timed out, only {} matches were found", matchCount);
+    return result;
+}
+
+/*!
+ * \qmlmethod bool CodeDocument::parse(int timeout = -1)
+ * Parses the document with Tree-sitter, if it's not already parsed. Returns false if parsing failed.
+ *
+ * Parsing is stopped after `timeout` milliseconds: -1 uses the `/treesitter/parse_timeout` setting, 0 means no limit.
+ * Use it to skip pathological files in batch jobs. Once parsing timed out, queries on the document return no matches,
+ * and the document isn't parsed again until it's changed or `parse` is called.
+ */
+bool CodeDocument::parse(int timeout)
+{
+    LOG("CodeDocument::parse", LOG_ARG("timeout", timeout));
+
+    if (timeout < 0)
+        return m_treeSitterHelper->parse();
+    return m_treeSitterHelper->parse(std::chrono::milliseconds(timeout));
+}
+
+void CodeDocument::cancelParse()
+{
+    m_treeSitterHelper->cancelParse();
+}
+
 /**
  * \qmlmethod array<QueryMatch> CodeDocument::queryInRange(RangeMark range, string query)
  *
  * Searches for the given `query`, but only in the provided `range`.
  *
+ * Only the matches whose captures are all inside the range are returned.
+ *
  * \sa CodeDocument::query
  */
 Core::QueryMatchList CodeDocument::queryInRange(const Core::RangeMark &range, const QString &query)
 {
     LOG("CodeDocument::queryInRange", LOG_ARG("range", range), LOG_ARG("query", query));
 
+    return queryInRange(range, query, treesitter::Predicates::Parameters {});
+}
+
+Core::QueryMatchList CodeDocument::queryInRange(const Core::RangeMark &range, const QString &query,
+                                                treesitter::Predicates::Parameters parameters)
+{
     if (!range.isValid()) {
         spdlog::warn("CodeDocument::queryInRange: Range is not valid");
         return {};
     }
+    return queryInRange(range, m_treeSitterHelper->constructQuery(query), std::move(parameters));
+}
 
-    const auto nodes = m_treeSitterHelper->nodesInRange(range);
-
-    if (nodes.isEmpty()) {
-        spdlog::warn("CodeDocument::queryInRange: No nodes in range");
+Core::QueryMatchList CodeDocument::queryInRange(const Core::RangeMark &range,
+                                                const std::shared_ptr<treesitter::Query> &query,
+                                                treesitter::Predicates::Parameters parameters)
+{
+    if (!range.isValid()) {
+        spdlog::warn("CodeDocument::queryInRange: Range is not valid");
         return {};
     }
-    spdlog::debug("CodeDocument::queryInRange: Found {} nodes in range", nodes.size());
 
-    auto tsQuery = m_treeSitterHelper->constructQuery(query);
-    if (!tsQuery)
+    auto cursor = createQueryCursor(query, range, std::move(parameters));
+    if (!cursor.has_value())
         return {};
 
-    treesitter::QueryCursor cursor;
-    Core::QueryMatchList matches;
-    for (const treesitter::Node &node : nodes) {
-        cursor.execute(tsQuery, node, std::make_unique<treesitter::Predicates>(text()));
-        matches.append(kdalgorithms::transformed<QVector<QueryMatch>>(cursor.allRemainingMatches(),
-                                                                      [this](const treesitter::QueryMatch &match) {
-                                                                          return QueryMatch(*this, match);
-                                                                      }));
-    }
-    return matches;
+    // The cursor returns all matches intersecting the range, only keep the ones fully inside
+    auto isInRange = [&range](const treesitter::QueryMatch &match) {
+        return kdalgorithms::all_of(match.captures(), [&range](const treesitter::QueryMatch::Capture &capture) {
+            return static_cast<int>(capture.node.startPosition()) >= range.start()
+                && static_cast<int>(capture.node.endPosition()) <= range.end();
+        });
+    };
+    auto matches = kdalgorithms::filtered(cursor->allRemainingMatches(), isInRange);
+    if (cursor->didExceedMatchLimit())
+        spdlog::warn("CodeDocument::queryInRange: Too many matches in progress, some matches may be missing");
+
+    return kdalgorithms::transformed<Core::QueryMatchList>(matches, [this](const treesitter::QueryMatch &match) {
+        return QueryMatch(*this, match);
+    });
 }
 
 int CodeDocument::revision() const
@@ -635,7 +1356,11 @@ int CodeDocument::revision() const
 
 bool CodeDocument::checkClient() const
 {
-    Q_ASSERT(textEdit());
+    Q_ASSERT(qTextDocument());
+    if (isLargeFile() && !m_lspEnabledForLargeFile) {
+        spdlog::error("CodeDocument {} is a large file, the LSP is disabled - call enableLsp to use it", fileName());
+        return false;
+    }
     if (!client()) {
         spdlog::error("CodeDocument {} has no LSP client - API not available", fileName());
         return false;
@@ -645,69 +1370,126 @@ bool CodeDocument::checkClient() const
 
 void CodeDocument::changeContentLsp(int position, int charsRemoved, int charsAdded)
 {
-    Q_UNUSED(position)
-    Q_UNUSED(charsRemoved)
-    Q_UNUSED(charsAdded)
-
-    // TODO: Keep copy of previous string around, so we can find the oldEndPosition.
-    // const auto document = textEdit()->document();
-    // const auto startblock = document->findBlock(position);
-    // spdlog::warn("start point: {}, {}", startblock.blockNumber(), position - startblock.position());
+    // If the client isn't started yet, the server will get the whole text when the document is opened
+    if (!m_lspClient)
+        return;
 
-    // const auto newEndPosition = position + charsAdded;
-    // const auto newEndBlock = document->findBlock(newEndPosition);
-    // spdlog::warn("new end point: {}, {}", newEndBlock.blockNumber(), newEndPosition - newEndBlock.position());
+    const bool canSendFull = client()->canSendDocumentChanges(Lsp::TextDocumentSyncKind::Full);
+    const bool canSendIncremental = client()->canSendDocumentChanges(Lsp::TextDocumentSyncKind::Incremental);
+    if (!canSendFull && !canSendIncremental) {
+        spdlog::error("LSP server does not support Document changes!");
+        return;
+    }
 
-    // const auto plain = document->toPlainText();
-    // spdlog::warn("added: {}", plain.sliced(position, charsAdded));
+    m_lspChangesTimer.start();
 
-    if (!checkClient()) {
+    // The whole document will be sent anyway, no need to compute anything.
+    if (m_pendingLspFullChange)
         return;
+
+    if (auto change = canSendIncremental ? incrementalChange(position, charsRemoved, charsAdded) : std::nullopt) {
+        m_pendingLspChangesSize += change->text.size();
+        // Typing inserts text right after the previous change: it's extended, so the server gets one change per word
+        // typed instead of one per key
+        auto last = m_pendingLspChanges.empty()
+            ? nullptr
+            : std::get_if<Lsp::TextDocumentContentChangeEventPartial>(&m_pendingLspChanges.back());
+        if (last && charsRemoved == 0 && position == m_pendingLspChangeEnd)
+            last->text += change->text;
+        else
+            m_pendingLspChanges.emplace_back(std::move(change.value()));
+        m_pendingLspChangeEnd = position + charsAdded;
+        // If the changes are bigger than the document itself, it's cheaper to send the whole document.
+        if (m_pendingLspChangesSize <= m_lspText->size())
+            return;
     }
 
-    if (client()->canSendDocumentChanges(Lsp::TextDocumentSyncKind::Full)
-        || client()->canSendDocumentChanges(Lsp::TextDocumentSyncKind::Incremental)) {
-        // TODO: We currently always send the entire document to the Language server, even
-        // if it supports incremental changes.
-        // Change this, so we also send incremental updates.
-        //
-        // This currently isn't implemented, as changeContent only gets called *after*
-        // the change has happened, but the LSP server needs the locations from *before* the change
-        // has happened, which can no longer be queried.
+    m_pendingLspChanges.clear();
+    m_pendingLspChangesSize = 0;
+    m_pendingLspChangeEnd = -1;
+    m_pendingLspFullChange = true;
+}
 
-        Lsp::VersionedTextDocumentIdentifier document;
-        document.version = ++m_revision;
-        document.uri = toUri();
+// Send all pending changes to the language server, in one didChange notification.
+void CodeDocument::flushLspChanges() const
+{
+    m_lspChangesTimer.stop();
 
-        std::vector<Lsp::TextDocumentContentChangeEvent> events;
+    if (!m_lspClient || (!m_pendingLspFullChange && m_pendingLspChanges.empty()))
+        return;
 
+    std::vector<Lsp::TextDocumentContentChangeEvent> events;
+    if (m_pendingLspFullChange) {
         // Set text
         Lsp::TextDocumentContentChangeEventFull event {};
-        event.text = text().toStdString();
-
+        const auto plainText = plainText();
+        event.text = Utils::toStdString(plainText);
         events.emplace_back(std::move(event));
 
-        Lsp::DidChangeTextDocumentParams params;
-        params.textDocument = document;
-        params.contentChanges = events;
-
-        client()->didChange(std::move(params));
+        if (client()->canSendDocumentChanges(Lsp::TextDocumentSyncKind::Incremental))
+            m_lspText = plainText;
     } else {
-        spdlog::error("LSP server does not support Document changes!");
+        events.reserve(m_pendingLspChanges.size());
+        std::ranges::move(m_pendingLspChanges, std::back_inserter(events));
+    }
+    m_pendingLspChanges.clear();
+    m_pendingLspChangesSize = 0;
+    m_pendingLspChangeEnd = -1;
+    m_pendingLspFullChange = false;
+
+    Lsp::VersionedTextDocumentIdentifier document;
+    document.version = ++m_revision;
+    document.uri = toUri();
+
+    Lsp::DidChangeTextDocumentParams params;
+    params.textDocument = document;
+    params.contentChanges = std::move(events);
+
+    client()->didChange(std::move(params));
+}
+
+// Computes the incremental change event for the language server, based on the text previously sent.
+// Returns an empty optional if this is not possible, and the full document has to be sent instead.
+std::optional<Lsp::TextDocumentContentChangeEventPartial> CodeDocument::incrementalChange(int position,
+                                                                                        int charsRemoved,
+                                                                                        int charsAdded)
+{
+    if (!m_lspText)
+        return {};
+
+    auto &lspText = m_lspText.value();
+    const auto document = qTextDocument();
+    // QTextDocument::contentsChange may report ranges including the last (implicit) paragraph separator.
+    const auto newLength = document->characterCount() - 1;
+    if (position < 0 || position + charsRemoved > lspText.size() || position + charsAdded > newLength
+        || lspText.size() - charsRemoved + charsAdded != newLength) {
+        return {};
     }
+
+    // The text before the position is unchanged, so the start position is the same before and after the change.
+    Lsp::TextDocumentContentChangeEventPartial event;
+    event.range.start = fromPos(position);
+
+    // LSP positions use UTF-16 code units by default, which are QChars.
+    const auto removed = QStringView(lspText).sliced(position, charsRemoved);
+    const auto newLines = removed.count(u'\n');
+    event.range.end.line = event.range.start.line + static_cast<unsigned int>(newLines);
+    event.range.end.character =
+        newLines == 0 ? event.range.start.character + charsRemoved
+                      : static_cast<unsigned int>(charsRemoved - removed.lastIndexOf(u'\n') - 1);
+
+    const auto added = plainTextInRange(document, position, charsAdded);
+    event.text = Utils::toStdString(added);
+    lspText.replace(position, charsRemoved, added);
+
+    return event;
 }
 
 void CodeDocument::changeContentTreeSitter(int position, int charsRemoved, int charsAdded)
 {
-    Q_UNUSED(position)
-    Q_UNUSED(charsRemoved)
-    Q_UNUSED(charsAdded)
-
     // Note: This invalidates all existing treesitter::Node instances of this tree!
     // Only use treesitter nodes as long as you're certain the document isn't edited!
-    // TODO: If we keep the old string around, we could implement incremental parsing here.
-    // If TreeSitter parsing ever becomes a performance bottleneck, this would be where to fix it.
-    m_treeSitterHelper->clear();
+    m_treeSitterHelper->edit(position, charsRemoved, charsAdded);
 }
 
 void CodeDocument::changeContent(int position, int charsRemoved, int charsAdded)
@@ -721,17 +1503,20 @@ void CodeDocument::changeContent(int position, int charsRemoved, int charsAdded)
     // As we're not quite done with updating the text at this point, we cannot redraw yet!
     LoggerDisabler disabler;
 
+    m_hoverCache.clear();
+    ++m_hoverCacheGeneration;
+    m_queryResults.clear();
+
     changeContentLsp(position, charsRemoved, charsAdded);
     changeContentTreeSitter(position, charsRemoved, charsAdded);
 }
 
 AstNode CodeDocument::astNodeAt(int pos)
 {
-    const auto root = m_treeSitterHelper->syntaxTree()->rootNode();
-    if (const auto node = root.descendantForRange(pos, pos); !node.isNull()) {
-        return AstNode(node, this);
-    }
-    return {};
+    const auto &tree = m_treeSitterHelper->syntaxTree();
+    if (!tree)
+        return {};
+    return m_treeSitterHelper->astNode(tree->rootNode().descendantForRange(pos, pos));
 }
 
 } // namespace Core
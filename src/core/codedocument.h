@@ -15,8 +15,13 @@
 #include "querymatch.h"
 #include "symbol.h"
 #include "textdocument.h"
+#include "treesitter/predicates.h"
 #include "treesitter/query.h"
+#include "treesitter/tree.h"
 
+#include <QHash>
+#include <QJSValue>
+#include <QTimer>
 #include <functional>
 #include <memory>
 
@@ -37,6 +42,17 @@ class TreeSitterHelper;
 struct RegexpTransform;
 class AstNode;
 
+class QueryMatchIterator;
+
+// Immutable copy of the syntax tree of a document and of the text it was parsed from.
+// The tree is a shallow copy (ts_tree_copy), so it can be queried from any thread, each thread using its own
+// QueryCursor, while the document is used and edited in the GUI thread.
+struct TreeSnapshot
+{
+    treesitter::Tree tree;
+    QString text;
+};
+
 class CodeDocument : public TextDocument
 {
     Q_OBJECT
@@ -45,15 +61,46 @@ public:
     ~CodeDocument() override;
 
     void setLspClient(Lsp::Client *client);
+    // The client is only created by calling the provider when the LSP is first needed
+    void setLspClientProvider(std::function<Lsp::Client *()> provider);
+    // The file is already opened on the server with `text` (see Project::prefetch): the didOpen notification is only
+    // sent if the text of the document is different.
+    void setLspPrefetchedText(QString text);
+    // Closes the document on the server, it's opened again the next time the LSP is needed
+    void releaseLspClient();
+
+    // Returns the tree-sitter grammar used for documents of the given type, or nullptr if there's none.
+    static const TSLanguage *treeSitterLanguage(Type type);
+    const TSLanguage *treeSitterLanguage() const;
+
+    QVariantMap memoryUsage() const override;
+
+    // Uses `tree`, parsed in advance from `text`, as the syntax tree if the document has no tree yet and its text
+    // is still `text` (see Project::prefetch).
+    void setPrefetchedTree(treesitter::Tree &&tree, const QString &text, int64_t treeBytes);
 
     Q_INVOKABLE Core::Symbol *findSymbol(const QString &name, int options = NoFindFlags) const;
     Q_INVOKABLE Core::SymbolList symbols() const;
     Q_INVOKABLE QString hover() const;
+    Q_INVOKABLE QStringList hoverAll(const QList<int> &positions) const;
+    Q_INVOKABLE QJSValue hoverAsync(int position) const;
+    Q_INVOKABLE QJSValue referencesAsync(int position) const;
+    Q_INVOKABLE QJSValue followSymbolAsync();
+    Q_INVOKABLE QStringList diagnostics() const;
     Q_INVOKABLE const Core::Symbol *symbolUnderCursor() const;
 
-    Q_INVOKABLE Core::QueryMatchList query(const QString &query);
+    Q_INVOKABLE Core::QueryMatchList query(const QString &query, int maxMatches = -1, int timeout = -1);
     Q_INVOKABLE Core::QueryMatch queryFirst(const QString &query);
     Q_INVOKABLE Core::QueryMatchList queryInRange(const Core::RangeMark &range, const QString &query);
+    Q_INVOKABLE Core::QueryMatchIterator *queryIterator(const QString &query);
+    Q_INVOKABLE QList<int> queryRanges(const QString &query, const QString &capture, int maxMatches = -1,
+                                       int timeout = -1);
+
+    Q_INVOKABLE bool parse(int timeout = -1);
+    Q_INVOKABLE void enableLsp();
+    Q_INVOKABLE bool waitForLspIndexing(int timeout = -1) const;
+    // Stops the Tree-sitter parse in progress, if any. Can be called from any thread.
+    void cancelParse();
 
     // This overload exists for improved performance. It's not user-facing API.
     //
@@ -62,9 +109,24 @@ public:
     // So allow this for outside users.
     QVector<Core::QueryMatch> query(const std::shared_ptr<treesitter::Query> &query);
     Core::QueryMatch queryFirst(const std::shared_ptr<treesitter::Query> &query);
+    // The strings to match are passed as parameters of the #in? and #like_in? predicates, see treesitter::builtinQuery
+    QVector<Core::QueryMatch> query(const std::shared_ptr<treesitter::Query> &query,
+                                    treesitter::Predicates::Parameters parameters);
+    QVector<Core::QueryMatch> queryInRange(const Core::RangeMark &range,
+                                           const std::shared_ptr<treesitter::Query> &query,
+                                           treesitter::Predicates::Parameters parameters = {});
+
+    // Returns a snapshot of the syntax tree, parsing the document if needed, or nullptr if there's no syntax tree.
+    // The same snapshot is returned until the document changes, and it stays valid after that.
+    std::shared_ptr<const TreeSnapshot> treeSnapshot() const;
+    // Builds the symbols in a worker thread, then calls `callback` once symbols() is up to date. The callback is
+    // called right away if there's nothing to build, and not at all if the document is destroyed before.
+    void updateSymbolsAsync(std::function<void()> callback);
 
     bool hasLspClient() const;
 
+    QStringList degradedFeatures() const override;
+
     Symbol *currentSymbol(const std::function<bool(const Symbol &)> &filterFunc) const;
     void deleteSymbol(const Symbol &symbol);
 
@@ -77,6 +139,10 @@ public:
 
     QString hover(int position, std::function<void(const QString &)> asyncCallback = {}) const;
 
+    // Semantic tokens of the document, in the LSP relative encoding. They're updated using deltas if the server
+    // supports it.
+    std::vector<unsigned int> semanticTokens() const;
+
     int toPos(const Lsp::Position &pos) const;
     TextRange toRange(const Lsp::Range &range) const;
 
@@ -90,6 +156,7 @@ protected:
 
     void didOpen() override;
     void didClose() override;
+    void doEvict() override;
 
     Lsp::Client *client() const;
     std::string toUri() const;
@@ -97,27 +164,90 @@ protected:
 
     int revision() const;
 
+    // Range of the MFC message map, shared by all queries using #in_message_map? until the document changes
+    std::optional<treesitter::Predicates::MessageMapRange> messageMapRange() const;
+
     std::pair<QString, std::optional<TextRange>>
     hoverWithRange(int position,
                    std::function<void(const QString &, std::optional<TextRange>)> asyncCallback = {}) const;
 
+    // Runs a constant query, with the strings to match passed as parameters of the #in? and #like_in? predicates.
+    // The query is only compiled once, whatever the parameters.
+    Core::QueryMatchList query(const QString &query, treesitter::Predicates::Parameters parameters);
+    Core::QueryMatchList queryInRange(const Core::RangeMark &range, const QString &query,
+                                      treesitter::Predicates::Parameters parameters);
+
 private:
     bool checkClient() const;
+    void waitForIndexing() const;
+    const std::vector<Lsp::Diagnostic> &updateDiagnostics() const;
+    void sendDidOpen() const;
     Document *followSymbol(int pos);
-
-    std::optional<treesitter::QueryCursor> createQueryCursor(const std::shared_ptr<treesitter::Query> &query);
+    Document *openDeclaration(const Lsp::TextDocumentDeclarationRequest::Result &result);
+
+    std::optional<treesitter::QueryCursor> createQueryCursor(const std::shared_ptr<treesitter::Query> &query,
+                                                             const RangeMark &range = {},
+                                                             treesitter::Predicates::Parameters parameters = {});
+    Core::QueryMatchList allMatches(treesitter::QueryCursor &cursor, int maxMatches = -1);
+
+    // Results of the queries run on the whole document, cleared each time the document changes
+    struct QueryResults
+    {
+        std::shared_ptr<treesitter::Query> query;
+        std::optional<Core::QueryMatchList> matches;
+        std::optional<Core::QueryMatch> first;
+    };
+    QueryResults &cachedQueryResults(const std::shared_ptr<treesitter::Query> &query);
 
     void changeContent(int position, int charsRemoved, int charsAdded);
     void changeContentLsp(int position, int charsRemoved, int charsAdded);
+    void flushLspChanges() const;
+    std::optional<Lsp::TextDocumentContentChangeEventPartial> incrementalChange(int position, int charsRemoved,
+                                                                                int charsAdded);
     void changeContentTreeSitter(int position, int charsRemoved, int charsAdded);
 
     // Language Server
-    QPointer<Lsp::Client> m_lspClient;
-    int m_revision = 0;
+    mutable QPointer<Lsp::Client> m_lspClient;
+    mutable std::function<Lsp::Client *()> m_lspClientProvider;
+    // The LSP is not used for large files, unless enableLsp is called
+    bool m_lspEnabledForLargeFile = false;
+    mutable int m_revision = 0;
+    // Copy of the text as known by the language server (including pending changes), needed to compute
+    // incremental changes. Only used if the server supports incremental changes.
+    mutable std::optional<QString> m_lspText;
+    // Text of the file when it was opened on the server by Project::prefetch, before the document needed the LSP
+    mutable std::optional<QString> m_lspPrefetchedText;
+
+    // Changes are not sent right away to the language server, but coalesced into one didChange notification.
+    // They are sent before the next LSP request, or once the event loop is idle.
+    mutable std::vector<Lsp::TextDocumentContentChangeEvent> m_pendingLspChanges;
+    mutable qsizetype m_pendingLspChangesSize = 0;
+    // End of the text inserted by the last pending change, -1 if there's none
+    mutable int m_pendingLspChangeEnd = -1;
+    mutable bool m_pendingLspFullChange = false;
+    mutable QTimer m_lspChangesTimer;
+    // Last asynchronous hover request sent, cancelled when a new one is sent
+    mutable std::optional<Lsp::MessageId> m_pendingHoverRequest;
+    // Hover results by position, cleared each time the document changes
+    mutable QHash<int, std::pair<QString, std::optional<TextRange>>> m_hoverCache;
+    int m_hoverCacheGeneration = 0;
+
+    // Last diagnostics and semantic tokens received, for the given revision. The result id is sent with the next
+    // request, so the server can answer with what changed instead of everything.
+    template <typename T>
+    struct LspResultCache
+    {
+        int revision = -1;
+        std::optional<std::string> resultId;
+        std::vector<T> data;
+    };
+    mutable LspResultCache<Lsp::Diagnostic> m_diagnostics;
+    mutable LspResultCache<unsigned int> m_semanticTokens;
 
     // TreeSitter
     friend TreeSitterHelper;
     std::unique_ptr<TreeSitterHelper> m_treeSitterHelper;
+    QHash<const treesitter::Query *, QueryResults> m_queryResults;
 
     friend class AstNode;
 };
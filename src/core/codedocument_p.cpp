@@ -10,13 +10,39 @@
 
 #include "codedocument_p.h"
 #include "codedocument.h"
+#include "scriptdialogitem.h"
+#include "settings.h"
+#include "symbolcache.h"
 #include "treesitter/languages.h"
+#include "treesitter/parserpool.h"
+#include "treesitter/querycache.h"
 #include "utils/log.h"
-
+#include "utils/memoryaccounting.h"
+#include "utils/metrics.h"
+#include "utils/stringpool.h"
+
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QtConcurrent/QtConcurrentRun>
+#include <algorithm>
+#include <array>
 #include <kdalgorithms.h>
 
 namespace Core {
 
+QString plainTextInRange(QTextDocument *document, int position, int length)
+{
+    QTextCursor cursor(document);
+    cursor.setPosition(position);
+    cursor.setPosition(position + length, QTextCursor::KeepAnchor);
+    // Mimic QTextDocument::toPlainText, which is what TextDocument::text() returns
+    QString text = cursor.selectedText();
+    text.replace(QChar::ParagraphSeparator, u'\n');
+    text.replace(QChar::Nbsp, u' ');
+    return text;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // TreeSitterHelper
 ///////////////////////////////////////////////////////////////////////////////
@@ -28,119 +54,409 @@ TreeSitterHelper::TreeSitterHelper(CodeDocument *document)
 void TreeSitterHelper::clear()
 {
     m_tree = {};
+    m_treeBytes = 0;
+    m_text.clear();
+    m_messageMap.reset();
+    m_snapshot.reset();
+    clearSymbols();
+    clearAstNodes();
+    m_flags &= ~(TreeOutdated | ParseAborted);
+}
+
+void TreeSitterHelper::setPrefetchedTree(treesitter::Tree &&tree, const QString &text, int64_t treeBytes)
+{
+    if (m_tree || text != m_document->text())
+        return;
+    m_tree = std::move(tree);
+    m_text = text;
+    m_treeBytes = treeBytes;
+    m_flags &= ~(TreeOutdated | ParseAborted);
+}
+
+void TreeSitterHelper::clearSymbols()
+{
     m_symbols.clear();
-    m_flags &= ~HasSymbols;
+    m_parentSymbols.clear();
+    m_symbolsByName.clear();
+    m_flags &= ~(HasSymbols | SymbolsOutdated);
+}
+
+// Sorted by position, outer symbols first
+static void sortSymbols(QVector<Core::Symbol *> &symbols)
+{
+    std::ranges::sort(symbols, [](const Symbol *lhs, const Symbol *rhs) {
+        const auto lhsRange = lhs->range();
+        const auto rhsRange = rhs->range();
+        if (lhsRange.start != rhsRange.start)
+            return lhsRange.start < rhsRange.start;
+        return lhsRange.end > rhsRange.end;
+    });
 }
 
-treesitter::Parser &TreeSitterHelper::parser()
+// Moves `range` after a change of the text, the positions inside the removed text go to the end of the added one
+static void moveRange(TextRange &range, int position, int charsRemoved, int charsAdded)
 {
-    if (!m_parser) {
-        // TODO: Make language configurable
-        m_parser = treesitter::Parser(tree_sitter_cpp());
+    auto move = [&](int pos) {
+        if (pos < position)
+            return pos;
+        if (pos >= position + charsRemoved)
+            return pos + charsAdded - charsRemoved;
+        return position + charsAdded;
+    };
+    range = {move(range.start), move(range.end)};
+}
+
+void TreeSitterHelper::editSymbols(int position, int charsRemoved, int charsAdded)
+{
+    if (!(m_flags & HasSymbols))
+        return;
+
+    // The symbols after the change are moved, the ones intersecting it are rebuilt anyway
+    for (auto *symbol : std::as_const(m_symbols)) {
+        moveRange(symbol->m_range, position, charsRemoved, charsAdded);
+        moveRange(symbol->m_selectionRange, position, charsRemoved, charsAdded);
+        for (auto &capture : symbol->m_captures)
+            moveRange(capture.range, position, charsRemoved, charsAdded);
     }
 
-    // Regarding const-ness:
-    // The TreeSitter parser can't change anything about the documents contents.
-    // Therefore it is okay to be returned by non-const reference, even in a const function.
-    return const_cast<treesitter::Parser &>(*m_parser);
+    const TextRange changed {position, position + charsAdded};
+    if (m_flags & SymbolsOutdated) {
+        moveRange(m_changedSymbolRange, position, charsRemoved, charsAdded);
+        m_changedSymbolRange = {std::min(m_changedSymbolRange.start, changed.start),
+                                std::max(m_changedSymbolRange.end, changed.end)};
+    } else {
+        m_changedSymbolRange = changed;
+    }
+    m_flags |= SymbolsOutdated;
 }
 
-std::optional<treesitter::Tree> &TreeSitterHelper::syntaxTree()
+TextRange TreeSitterHelper::outdatedSymbolRange() const
 {
-    if (!m_tree) {
-        m_tree = parser().parseString(m_document->text());
-        if (!m_tree) {
-            spdlog::warn("CodeDocument::syntaxTree: Failed to parse document {}!", m_document->fileName());
+    // Symbols are nested or disjoint: extend the range until it contains all the symbols intersecting it, so the
+    // symbols rebuilt inside it are exactly the ones removed, with their surrounding symbols
+    TextRange range = m_changedSymbolRange;
+    for (bool extended = true; extended;) {
+        extended = false;
+        for (const auto *symbol : std::as_const(m_symbols)) {
+            const auto symbolRange = symbol->range();
+            if (symbolRange.start <= range.end && symbolRange.end >= range.start && !range.contains(symbolRange)) {
+                range = {std::min(range.start, symbolRange.start), std::max(range.end, symbolRange.end)};
+                extended = true;
+            }
         }
     }
-    return m_tree;
+    return range;
 }
 
-std::shared_ptr<treesitter::Query> TreeSitterHelper::constructQuery(const QString &query)
+void TreeSitterHelper::replaceSymbols(const TextRange &range, QVector<Core::Symbol *> &&newSymbols)
 {
-    std::shared_ptr<treesitter::Query> tsQuery;
-    try {
-        tsQuery = std::make_shared<treesitter::Query>(parser().language(), query);
-    } catch (treesitter::Query::Error &error) {
-        spdlog::error("CodeDocument::constructQuery: Failed to parse query `{}` error: {} at: {}", query,
-                      error.description, error.utf8_offset);
-        return {};
+    auto symbols = kdalgorithms::filtered(m_symbols, [&range](const Symbol *symbol) {
+        const auto symbolRange = symbol->range();
+        return symbolRange.start > range.end || symbolRange.end < range.start;
+    });
+    symbols.append(newSymbols);
+    sortSymbols(symbols);
+
+    m_symbols = std::move(symbols);
+    m_parentSymbols.clear();
+    m_symbolsByName.clear();
+    const QSet<Symbol *> newSymbolSet(newSymbols.cbegin(), newSymbols.cend());
+    assignSymbolContexts(&newSymbolSet);
+}
+
+// Rebuilds the symbols intersecting the changed range, and keeps the other ones as they are
+void TreeSitterHelper::updateSymbols()
+{
+    // Parsing the tree adds its changed ranges to m_changedSymbolRange
+    const auto &tree = syntaxTree();
+    m_flags &= ~SymbolsOutdated;
+    if (!tree) {
+        clearSymbols();
+        return;
     }
-    return tsQuery;
+
+    const auto range = outdatedSymbolRange();
+    replaceSymbols(range, range.length() > 0 ? buildSymbols(range) : QVector<Symbol *> {});
 }
 
-// `nodesInRange` returns only the outermost nodes that fit entirely in the given range.
-// The subsequent children of these outermost nodes are *not* returned, even though
-// they are also technically in the range!
-// This is used by queryInRange to find on which nodes to run the query on.
-QVector<treesitter::Node> TreeSitterHelper::nodesInRange(const RangeMark &range)
+// Returns the point at the end of `text`, if `text` starts at `start`.
+// Columns are counted in bytes, as required by Tree-sitter.
+static TSPoint pointAfter(const TSPoint &start, QStringView text)
 {
-    enum RangeComparison { Overlaps, Contains, Disjoint };
+    const auto newLines = text.count(u'\n');
+    if (newLines == 0) {
+        return {start.row, start.column + static_cast<uint32_t>(text.size() * sizeof(QChar))};
+    }
+    const auto lastLineLength = text.size() - text.lastIndexOf(u'\n') - 1;
+    return {start.row + static_cast<uint32_t>(newLines), static_cast<uint32_t>(lastLineLength * sizeof(QChar))};
+}
 
-    const auto &tree = syntaxTree();
+void TreeSitterHelper::clearAstNodes()
+{
+    m_astNodes.clear();
+    ++m_treeGeneration;
+}
 
-    if (!tree) {
+AstNode TreeSitterHelper::astNode(const treesitter::Node &node)
+{
+    if (node.isNull())
         return {};
+
+    auto it = m_astNodes.find(node.m_node.id);
+    if (it == m_astNodes.end()) {
+        AstNode astNode(node, m_document);
+        astNode.m_node = node;
+        astNode.m_treeGeneration = m_treeGeneration;
+        it = m_astNodes.emplace(node.m_node.id, std::move(astNode)).first;
     }
+    return it->second;
+}
+
+size_t TreeSitterHelper::treeGeneration() const
+{
+    return m_treeGeneration;
+}
 
-    QVector<treesitter::Node> nodesToVisit;
-    QVector<treesitter::Node> nodesInRange;
-    nodesToVisit.emplace_back(tree->rootNode());
-
-    auto compareToRange = [&range](const treesitter::Node &node) {
-        if (range.contains(node.startPosition()) && range.contains(node.endPosition() - 1))
-            return RangeComparison::Contains;
-        else if (static_cast<int>(node.startPosition()) <= range.end()
-                 && static_cast<int>(node.endPosition()) >= range.start())
-            return RangeComparison::Overlaps;
-        return RangeComparison::Disjoint;
+std::optional<treesitter::Predicates::MessageMapRange> TreeSitterHelper::messageMap()
+{
+    if (!m_messageMap) {
+        const auto &tree = syntaxTree();
+        if (!tree)
+            return {};
+        m_messageMap = treesitter::Predicates::findMessageMap(tree->rootNode(), m_text);
+    }
+    return *m_messageMap;
+}
+
+int64_t TreeSitterHelper::symbolBytes() const
+{
+    // Shallow estimate: the symbols and their names, without the QObject private data
+    int64_t bytes = 0;
+    for (const auto *symbol : m_symbols)
+        bytes += sizeof(Core::Symbol) + symbol->name().size() * sizeof(QChar);
+    return bytes;
+}
+
+void TreeSitterHelper::edit(int position, int charsRemoved, int charsAdded)
+{
+    m_messageMap.reset();
+    m_snapshot.reset();
+    clearAstNodes();
+    m_flags &= ~ParseAborted;
+
+    // Without a tree, the next parse is a full one and the changed ranges are unknown
+    if (!m_tree) {
+        clearSymbols();
+        return;
+    }
+
+    const auto document = m_document->qTextDocument();
+    // QTextDocument::contentsChange may report ranges including the last (implicit) paragraph separator.
+    // In that case, or if our copy of the text is out of sync, just do a full reparse.
+    const auto newLength = document->characterCount() - 1;
+    if (position < 0 || position + charsRemoved > m_text.size() || position + charsAdded > newLength
+        || m_text.size() - charsRemoved + charsAdded != newLength) {
+        clear();
+        return;
+    }
+
+    const auto added = plainTextInRange(document, position, charsAdded);
+
+    // The text before the position is unchanged, so the block is the same before and after the edit.
+    const auto block = document->findBlock(position);
+    const TSPoint startPoint {static_cast<uint32_t>(block.blockNumber()),
+                              static_cast<uint32_t>((position - block.position()) * sizeof(QChar))};
+
+    const TSInputEdit edit {
+        .start_byte = static_cast<uint32_t>(position * sizeof(QChar)),
+        .old_end_byte = static_cast<uint32_t>((position + charsRemoved) * sizeof(QChar)),
+        .new_end_byte = static_cast<uint32_t>((position + charsAdded) * sizeof(QChar)),
+        .start_point = startPoint,
+        .old_end_point = pointAfter(startPoint, QStringView(m_text).sliced(position, charsRemoved)),
+        .new_end_point = pointAfter(startPoint, added),
     };
+    m_tree->edit(edit);
+    m_text.replace(position, charsRemoved, added);
+    m_flags |= TreeOutdated;
+    editSymbols(position, charsRemoved, charsAdded);
+}
+
+const TSLanguage *TreeSitterHelper::language() const
+{
+    return m_document->treeSitterLanguage();
+}
 
-    // Note: This could be improved performance-wise using the first_child_for_byte
-    // functions on either TSNode, or TSTreeCursor.
-    // However, these functions aren't currently wrapped and would make the search a bit more complex.
-    while (!nodesToVisit.isEmpty()) {
-        auto node = nodesToVisit.takeLast();
-        switch (compareToRange(node)) {
-        case RangeComparison::Contains:
-            nodesInRange.emplace_back(node);
-            break;
-        case RangeComparison::Overlaps:
-            nodesToVisit.append(node.children());
-            break;
-        default:
-            break;
+std::optional<treesitter::Tree> &TreeSitterHelper::syntaxTree()
+{
+    if (!(m_flags & ParseAborted))
+        parse();
+    return m_tree;
+}
+
+bool TreeSitterHelper::parse(std::optional<std::chrono::milliseconds> timeout)
+{
+    if (m_tree && !(m_flags & TreeOutdated))
+        return true;
+
+    auto parser = treesitter::ParserPool::instance().acquire(language());
+    parser->setTimeout(timeout.value_or(
+        std::chrono::milliseconds(Settings::instance()->value<int>(Settings::TreeSitterParseTimeout))));
+    m_cancelParse = 0;
+    parser->setCancellationFlag(&m_cancelParse);
+
+    static auto &parses = Utils::Metrics::counter("treesitter.parses");
+    static auto &bytesParsed = Utils::Metrics::counter("treesitter.bytes_parsed");
+    static auto &parseTime = Utils::Metrics::histogram("treesitter.parse_time_us");
+    parses.add();
+    Utils::Metrics::ScopedTimer timer(parseTime);
+    const Utils::AllocationScope allocations(Utils::MemoryAccounting::TreeSitter);
+    if (!m_tree) {
+        // The changed ranges are only known with an incremental parse
+        if (m_flags & SymbolsOutdated)
+            clearSymbols();
+        m_text = m_document->text();
+        m_tree = parser->parseString(m_text);
+    } else {
+        // Reuse the edited tree, so only the changed parts of the document are reparsed.
+        auto tree = parser->parseString(m_text, &m_tree.value());
+        if (tree && (m_flags & SymbolsOutdated)) {
+            // Tree-sitter positions are UTF-16 bytes
+            for (const auto &[startByte, endByte] : m_tree->changedRanges(*tree)) {
+                auto &range = m_changedSymbolRange;
+                range.start = std::min(range.start, static_cast<int>(startByte / sizeof(QChar)));
+                range.end = std::max(range.end, static_cast<int>(endByte / sizeof(QChar)));
+            }
         }
+        m_tree = std::move(tree);
     }
+    bytesParsed.add(m_text.size() * static_cast<int64_t>(sizeof(QChar)));
+    m_treeBytes = m_tree ? std::max<int64_t>(0, m_treeBytes + allocations.bytes()) : 0;
+    m_flags &= ~TreeOutdated;
+
+    if (m_tree) {
+        m_flags &= ~ParseAborted;
+        return true;
+    }
+
+    if (m_cancelParse || parser->timeout().count() > 0) {
+        m_flags |= ParseAborted;
+        spdlog::warn("CodeDocument::parse: Parsing of document {} timed out or was cancelled",
+                     m_document->fileName());
+    } else {
+        spdlog::warn("CodeDocument::parse: Failed to parse document {}!", m_document->fileName());
+    }
+    return false;
+}
+
+void TreeSitterHelper::cancelParse()
+{
+    m_cancelParse = 1;
+}
 
-    return nodesInRange;
+const QString &TreeSitterHelper::syntaxTreeText() const
+{
+    return m_text;
 }
 
-void TreeSitterHelper::assignSymbolContexts()
+std::shared_ptr<const TreeSnapshot> TreeSitterHelper::snapshot()
 {
-    auto contextForSymbol = [this](Symbol *symbol) {
-        auto surroundsSymbol = [&symbol](const Symbol *otherSymbol) {
-            return symbol != otherSymbol && otherSymbol->range().contains(symbol->range());
-        };
-        auto surroundingSymbols = kdalgorithms::filtered(m_symbols, surroundsSymbol);
+    if (!m_snapshot) {
+        const auto &tree = syntaxTree();
+        if (!tree)
+            return {};
+        // Tree-sitter trees are not thread-safe, but their copies are: the nodes are immutable and ref-counted.
+        m_snapshot = std::make_shared<const TreeSnapshot>(tree->copy(), m_text);
+    }
+    return m_snapshot;
+}
 
-        kdalgorithms::sort_by(
-            surroundingSymbols,
-            [](const auto &symbol) {
-                return symbol->range().length();
-            },
-            kdalgorithms::descending);
-        return surroundingSymbols;
+std::shared_ptr<treesitter::Query> TreeSitterHelper::constructQuery(const QString &query)
+{
+    std::shared_ptr<treesitter::Query> tsQuery;
+    try {
+        tsQuery = treesitter::QueryCache::instance().query(language(), query);
+    } catch (treesitter::Query::Error &error) {
+        spdlog::error("CodeDocument::constructQuery: Failed to parse query `{}` error: {} at: {}", query,
+                      error.description, error.utf8_offset);
+        return {};
+    }
+    return tsQuery;
+}
+
+void TreeSitterHelper::assignSymbolContexts(const QSet<Core::Symbol *> *newSymbols)
+{
+    // m_symbols is sorted by position, outer symbols first, and symbol ranges are either nested or disjoint.
+    // The surrounding symbols of a symbol are then the ones on the stack, once the disjoint ones are removed.
+    // The surrounding symbols of a new symbol are new as well, see updateSymbols.
+    auto isNew = [newSymbols](Symbol *symbol) {
+        return !newSymbols || newSymbols->contains(symbol);
     };
+    QVector<int> stack;
+    QVector<QVector<Symbol *>> contexts(m_symbols.size());
+    m_parentSymbols.fill(-1, m_symbols.size());
+    for (int i = 0; i < m_symbols.size(); ++i) {
+        const auto range = m_symbols.at(i)->range();
+        while (!stack.isEmpty() && !m_symbols.at(stack.last())->range().contains(range))
+            stack.removeLast();
+        if (!stack.isEmpty())
+            m_parentSymbols[i] = stack.last();
+        if (isNew(m_symbols.at(i))) {
+            contexts[i] = kdalgorithms::transformed<QVector<Symbol *>>(stack, [this](int index) {
+                return m_symbols.at(index);
+            });
+        }
+        stack.push_back(i);
+    }
 
-    for (const auto &symbol : m_symbols | std::views::reverse) {
-        symbol->assignContext(contextForSymbol(symbol));
+    // Contexts use the unqualified names, so start with the innermost symbols
+    for (int i = m_symbols.size() - 1; i >= 0; --i) {
+        if (isNew(m_symbols.at(i)))
+            m_symbols.at(i)->assignContext(contexts.at(i));
     }
+
+    for (const auto &symbol : std::as_const(m_symbols))
+        m_symbolsByName[symbol->name().toLower()].push_back(symbol);
+}
+
+namespace {
+
+struct SymbolQuery
+{
+    QString query;
+    Symbol::Kind kind;
+    // The kind of the functions depends on their captures, see functionKind
+    bool isFunction = false;
+};
+
+// Clangd also assigns the Constructor kind to Destructors, so we do the same
+Symbol::Kind functionKind(const Symbol::Captures &captures, const QString &name)
+{
+    const bool hasReturn = kdalgorithms::any_of(captures, [](const Symbol::Capture &capture) {
+        return capture.name == "return";
+    });
+    if (!hasReturn)
+        return Symbol::Kind::Constructor;
+    // This is a bit of a guesstimate, but if the function name contains "::", it's likely a method.
+    // It may also be a member of a namespace, but this information isn't really available unless we try
+    // to resolve the original declaration.
+    if (name.contains("::"))
+        return Symbol::Kind::Method;
+    return Symbol::Kind::Function;
 }
 
-QVector<Core::Symbol *> TreeSitterHelper::functionSymbols() const
+QVector<SymbolQuery> cppSymbolQueries()
 {
-    auto functionDeclarator = R"EOF(
+    const QString classes = R"EOF(
+            (class_specifier
+              name: (_) @name @selectionRange
+              body: (field_declaration_list)) @range
+
+            (struct_specifier
+              name: (_) @name @selectionRange
+              body: (field_declaration_list)) @range
+    )EOF";
+
+    const QString functionDeclarator = R"EOF(
             (function_declarator
               declarator: [
                 (identifier) @selectionRange
@@ -157,16 +473,16 @@ QVector<Core::Symbol *> TreeSitterHelper::functionSymbols() const
               (trailing_return_type (_) @return)? )
     )EOF";
 
-    auto pointerDeclarator = QString(R"EOF(
+    const auto pointerDeclarator = QString(R"EOF(
         [%1
         (_ "*"? @return "&"? @return "&&"? @return %1)
         (_ ["*" "&" "&&"]? @return
             (_ ["*" "&" "&&"]? @return %1))]
     )EOF")
-                                 .arg(functionDeclarator);
+                                       .arg(functionDeclarator);
 
     // TODO: Add support for pointers & references
-    auto functions = m_document->query(QString(R"EOF(
+    const auto functions = QString(R"EOF(
                         [; Free functions
                         (function_definition
                           type: (_)? @return
@@ -186,48 +502,9 @@ QVector<Core::Symbol *> TreeSitterHelper::functionSymbols() const
                           declarator: %2) @range
 
                         ])EOF")
-                                           .arg(functionDeclarator, pointerDeclarator));
-
-    auto function_to_symbol = [this](const QueryMatch &match) {
-        auto kind = Symbol::Kind::Function;
-        if (!match.get("return").isValid()) {
-            // No return type, this is a Constructor/Destructor
-            // Clangd also assigned the Constructor kind to Destructors, so we'll do the same
-            kind = Symbol::Kind::Constructor;
-        } else if (match.get("name").text().contains("::")) {
-            // This is a bit of a guesstimate, but if the function name contains "::", it's likely a method.
-            // It may also be a member of a namespace, but this information isn't really available unless we try
-            // to resolve the original declaration.
-            kind = Symbol::Kind::Method;
-        }
-        return Symbol::makeSymbol(m_document, match, kind);
-    };
-
-    return kdalgorithms::transformed<QVector<Symbol *>>(functions, function_to_symbol);
-}
-
-QVector<Core::Symbol *> TreeSitterHelper::classSymbols() const
-{
-    auto classesAndStructs = m_document->query(QString(R"EOF(
-            (class_specifier
-              name: (_) @name @selectionRange
-              body: (field_declaration_list)) @range
-
-            (struct_specifier
-              name: (_) @name @selectionRange
-              body: (field_declaration_list)) @range
-    )EOF"));
-    auto class_to_symbol = [this](const QueryMatch &match) {
-        return Symbol::makeSymbol(m_document, match, Symbol::Kind::Class);
-    };
-
-    return kdalgorithms::transformed<QVector<Symbol *>>(classesAndStructs, class_to_symbol);
-}
+                               .arg(functionDeclarator, pointerDeclarator);
 
-QVector<Core::Symbol *> TreeSitterHelper::memberSymbols() const
-{
-    auto fieldIdentifier = "(field_identifier) @name @selectionRange";
-    auto members = m_document->query(QString(R"EOF(
+    const auto members = QString(R"EOF(
                                         (field_declaration
                                           type: (_) @type
                                           declarator: [
@@ -238,55 +515,307 @@ QVector<Core::Symbol *> TreeSitterHelper::memberSymbols() const
                                           ; We need to filter out functions, they are already captured
                                           ; by the functionSymbols query
                                           (#not_is? @decl_type function_declarator)) @range)EOF")
-                                         .arg(fieldIdentifier));
+                             .arg("(field_identifier) @name @selectionRange");
 
-    auto member_to_symbol = [this](const QueryMatch &match) {
-        return Symbol::makeSymbol(m_document, match, Symbol::Kind::Field);
-    };
+    const QString enums = R"EOF(
+        (enum_specifier
+          name: (_) @name @selectionRange) @range
+    )EOF";
+    const QString enumerators = R"EOF(
+        (enumerator
+          name: (_) @name @selectionRange
+          value: (_)? @value) @range
+    )EOF";
 
-    return kdalgorithms::transformed<QVector<Symbol *>>(members, member_to_symbol);
+    return {
+        {classes, Symbol::Kind::Class},
+        {functions, Symbol::Kind::Function, true},
+        {members, Symbol::Kind::Field},
+        {enums, Symbol::Kind::Enum},
+        {enumerators, Symbol::Kind::Enum},
+    };
 }
 
-QVector<Core::Symbol *> TreeSitterHelper::enumSymbols() const
+// Objects, properties, signals and functions of a QML document
+QVector<SymbolQuery> qmlSymbolQueries()
 {
-    auto enums = m_document->query(R"EOF(
-        (enum_specifier
-          name: (_) @name @selectionRange) @range
-    )EOF");
-    auto enum_to_symbol = [this](const QueryMatch &match) {
-        return Symbol::makeSymbol(m_document, match, Symbol::Kind::Enum);
+    // Objects are named after their type, as their id is only one of their bindings
+    return {
+        {"(ui_object_definition type_name: (_) @name @selectionRange) @range", Symbol::Kind::Object},
+        {"(ui_property name: (_) @name @selectionRange) @range", Symbol::Kind::Property},
+        {"(ui_signal name: (_) @name @selectionRange) @range", Symbol::Kind::Event},
+        {"(function_declaration name: (_) @name @selectionRange) @range", Symbol::Kind::Function},
     };
-    auto result = kdalgorithms::transformed<QVector<Symbol *>>(enums, enum_to_symbol);
+}
 
-    auto enumerators = m_document->query(R"EOF(
-        (enumerator
-          name: (_) @name @selectionRange
-          value: (_)? @value) @range
-    )EOF");
-    result.append(kdalgorithms::transformed<QVector<Symbol *>>(enumerators, enum_to_symbol));
+} // namespace
 
+QVector<TreeSitterHelper::SymbolData>
+TreeSitterHelper::buildSymbolData(const TSLanguage *language, const TreeSnapshot &snapshot,
+                                  std::optional<TextRange> range, uint32_t matchLimit,
+                                  const std::function<void()> &progress)
+{
+    // The queries are parsed once, the cache can be used from any thread
+    static const auto cppQueries = cppSymbolQueries();
+    static const auto qmlQueries = qmlSymbolQueries();
+    const QVector<SymbolQuery> *queries = nullptr;
+    if (language == tree_sitter_cpp())
+        queries = &cppQueries;
+    else if (language == tree_sitter_qmljs())
+        queries = &qmlQueries;
+    else
+        return {};
+
+    QVector<SymbolData> result;
+    for (const auto &symbolQuery : *queries) {
+        std::shared_ptr<treesitter::Query> query;
+        try {
+            query = treesitter::QueryCache::instance().query(language, symbolQuery.query);
+        } catch (treesitter::Query::Error &error) {
+            spdlog::error("CodeDocument::symbols: Failed to parse query `{}` error: {} at: {}", symbolQuery.query,
+                          error.description, error.utf8_offset);
+            continue;
+        }
+
+        treesitter::QueryCursor cursor;
+        if (progress)
+            cursor.setProgressCallback(progress);
+        cursor.setMatchLimit(matchLimit);
+        // Tree-sitter positions are UTF-16 bytes
+        if (range)
+            cursor.setByteRange(range->start * sizeof(QChar), range->end * sizeof(QChar));
+        cursor.execute(query, snapshot.tree.rootNode(), std::make_unique<treesitter::Predicates>(snapshot.text));
+
+        while (const auto match = cursor.nextMatch()) {
+            SymbolData symbol {.kind = symbolQuery.kind};
+            bool inRange = true;
+            for (const auto &capture : match->captures()) {
+                const TextRange captureRange {.start = static_cast<int>(capture.node.startPosition()),
+                                              .end = static_cast<int>(capture.node.endPosition())};
+                // The cursor returns all matches intersecting the range, only keep the ones fully inside
+                if (range && !range->contains(captureRange)) {
+                    inRange = false;
+                    break;
+                }
+                const auto &name = query->captureAt(capture.id).name;
+                if (name == "name" && symbol.name.isNull())
+                    symbol.name = snapshot.text.sliced(captureRange.start, captureRange.length());
+                symbol.captures.push_back({.name = name, .range = captureRange});
+            }
+            if (!inRange)
+                continue;
+            if (symbolQuery.isFunction)
+                symbol.kind = functionKind(symbol.captures, symbol.name);
+            result.push_back(std::move(symbol));
+        }
+        if (cursor.didExceedMatchLimit())
+            spdlog::warn("CodeDocument::symbols: Too many matches in progress, some symbols may be missing");
+    }
     return result;
 }
 
+QVector<Core::Symbol *> TreeSitterHelper::makeSymbols(QVector<SymbolData> &&symbols) const
+{
+    QVector<Symbol *> result;
+    result.reserve(symbols.size());
+    for (auto &symbol : symbols)
+        result.push_back(Symbol::makeSymbol(m_document, symbol.name, std::move(symbol.captures), symbol.kind));
+    return result;
+}
+
+QVector<Core::Symbol *> TreeSitterHelper::buildSymbols(std::optional<TextRange> range)
+{
+    const auto treeSnapshot = snapshot();
+    if (!treeSnapshot)
+        return {};
+    const auto matchLimit = Settings::instance()->value<uint32_t>(Settings::TreeSitterQueryMatchLimit);
+    return makeSymbols(
+        buildSymbolData(language(), *treeSnapshot, range, matchLimit, ScriptDialogItem::updateProgress));
+}
+
+bool TreeSitterHelper::loadCachedSymbols(const QByteArray &hash)
+{
+    const auto cachedSymbols = SymbolCache::load(m_document->fileName(), hash);
+    if (!cachedSymbols)
+        return false;
+
+    // The cache matches the current text, so the captures can be used as is, without any RangeMark
+    const auto text = m_document->text();
+    auto toSymbol = [this, &text](const SymbolCache::Symbol &symbol) {
+        QString name;
+        auto captures = kdalgorithms::transformed<Symbol::Captures>(
+            symbol.captures, [&text, &name](const SymbolCache::Capture &capture) {
+                const TextRange range {.start = capture.start, .end = capture.end};
+                if (capture.name == "name" && name.isEmpty() && range.start >= 0 && range.end <= text.size()
+                    && range.start <= range.end)
+                    name = text.sliced(range.start, range.length());
+                return Symbol::Capture {.name = Utils::intern(capture.name), .range = range};
+            });
+        return Symbol::makeSymbol(m_document, name, std::move(captures), static_cast<Symbol::Kind>(symbol.kind));
+    };
+    m_symbols = kdalgorithms::transformed<QVector<Symbol *>>(*cachedSymbols, toSymbol);
+    return true;
+}
+
+void TreeSitterHelper::saveCachedSymbols(const QByteArray &hash) const
+{
+    auto toCachedSymbol = [](const Symbol *symbol) {
+        auto captures = kdalgorithms::transformed<std::vector<SymbolCache::Capture>>(
+            symbol->m_captures, [](const Symbol::Capture &capture) {
+                return SymbolCache::Capture {.name = capture.name,
+                                             .start = capture.range.start,
+                                             .end = capture.range.end};
+            });
+        return SymbolCache::Symbol {.kind = static_cast<int>(symbol->kind()), .captures = std::move(captures)};
+    };
+    SymbolCache::save(m_document->fileName(), hash,
+                      kdalgorithms::transformed<SymbolCache::Symbols>(m_symbols, toCachedSymbol));
+}
+
+QByteArray TreeSitterHelper::symbolCacheHash() const
+{
+    // Only cache the symbols of files saved on disk, so the cache can be used on the next run
+    if (m_document->fileName().isEmpty() || m_document->hasChanged() || !SymbolCache::isEnabled())
+        return {};
+    return SymbolCache::hash(m_document->text());
+}
+
+void TreeSitterHelper::setSymbols(QVector<Core::Symbol *> &&symbols, const QByteArray &hash)
+{
+    m_symbols = std::move(symbols);
+    sortSymbols(m_symbols);
+    m_parentSymbols.clear();
+    m_symbolsByName.clear();
+    m_flags |= HasSymbols;
+    m_flags &= ~SymbolsOutdated;
+
+    // Save before assigning the contexts, which are computed again when loading
+    if (!hash.isEmpty())
+        saveCachedSymbols(hash);
+
+    assignSymbolContexts();
+}
+
 const QVector<Core::Symbol *> &TreeSitterHelper::symbols()
 {
+    if (m_flags & SymbolsOutdated)
+        updateSymbols();
     if (m_flags & HasSymbols)
         return m_symbols;
 
     m_flags |= HasSymbols;
 
-    m_symbols = classSymbols();
-    m_symbols.append(functionSymbols());
-    m_symbols.append(memberSymbols());
-    m_symbols.append(enumSymbols());
-
-    kdalgorithms::sort_by(m_symbols, [](const auto &symbol) {
-        return symbol->range().start;
-    });
+    const bool isQml = language() == tree_sitter_qmljs();
+    if (language() != tree_sitter_cpp() && !isQml)
+        return m_symbols;
 
-    assignSymbolContexts();
+    const auto hash = symbolCacheHash();
+    if (!hash.isEmpty() && loadCachedSymbols(hash)) {
+        assignSymbolContexts();
+        return m_symbols;
+    }
 
+    setSymbols(buildSymbols(), hash);
     return m_symbols;
 }
 
+void TreeSitterHelper::updateSymbolsAsync(std::function<void()> callback)
+{
+    const bool upToDate = (m_flags & HasSymbols) && !(m_flags & SymbolsOutdated);
+    const bool hasQueries = language() == tree_sitter_cpp() || language() == tree_sitter_qmljs();
+    if (upToDate || !hasQueries) {
+        symbols();
+        callback();
+        return;
+    }
+
+    // Loading the cache is fast, and doesn't need the syntax tree
+    QByteArray hash;
+    if (!(m_flags & HasSymbols)) {
+        hash = symbolCacheHash();
+        if (!hash.isEmpty() && loadCachedSymbols(hash)) {
+            m_flags |= HasSymbols;
+            assignSymbolContexts();
+            callback();
+            return;
+        }
+    }
+
+    // Parsing adds the changed ranges of the tree to m_changedSymbolRange, before it's used for the outdated range
+    const auto treeSnapshot = snapshot();
+    if (!treeSnapshot) {
+        symbols();
+        callback();
+        return;
+    }
+
+    std::optional<TextRange> range;
+    if (m_flags & HasSymbols) {
+        range = outdatedSymbolRange();
+        if (range->length() == 0) {
+            symbols();
+            callback();
+            return;
+        }
+    }
+
+    // Settings are only read in the GUI thread
+    const auto matchLimit = Settings::instance()->value<uint32_t>(Settings::TreeSitterQueryMatchLimit);
+    const auto generation = m_treeGeneration;
+    auto build = [language = language(), treeSnapshot, range, matchLimit]() {
+        return buildSymbolData(language, *treeSnapshot, range, matchLimit);
+    };
+    auto apply = [this, generation, range, hash, callback = std::move(callback)](QVector<SymbolData> symbols) {
+        // The document changed in the meantime, the symbols are built again from the new tree
+        if (generation != m_treeGeneration) {
+            updateSymbolsAsync(callback);
+            return;
+        }
+        // Nothing to do if the symbols were already updated synchronously, by a call to symbols()
+        if (!(m_flags & HasSymbols) || (m_flags & SymbolsOutdated)) {
+            if (range) {
+                m_flags &= ~SymbolsOutdated;
+                replaceSymbols(*range, makeSymbols(std::move(symbols)));
+            } else {
+                setSymbols(makeSymbols(std::move(symbols)), hash);
+            }
+        }
+        callback();
+    };
+    // The continuation is not run if the document is destroyed, and the helper is destroyed with it
+    m_symbolFuture = QtConcurrent::run(build).then(m_document, std::move(apply));
+}
+
+Core::Symbol *TreeSitterHelper::findSymbol(const QString &name, Qt::CaseSensitivity cs)
+{
+    symbols();
+    const auto it = m_symbolsByName.constFind(name.toLower());
+    if (it == m_symbolsByName.cend())
+        return nullptr;
+    if (cs == Qt::CaseInsensitive)
+        return it->first();
+
+    auto result = kdalgorithms::find_if(*it, [&name](const Symbol *symbol) {
+        return symbol->name() == name;
+    });
+    return result ? *result : nullptr;
+}
+
+Core::Symbol *TreeSitterHelper::symbolAt(int position, const std::function<bool(const Symbol &)> &filterFunc)
+{
+    symbols();
+    // Last symbol starting before the position: any symbol containing the position is either this one, or one of
+    // its surrounding symbols
+    const auto it = std::ranges::upper_bound(m_symbols, position, {}, [](const Symbol *symbol) {
+        return symbol->range().start;
+    });
+    for (int index = static_cast<int>(std::distance(m_symbols.begin(), it)) - 1; index >= 0;
+         index = m_parentSymbols.at(index)) {
+        auto symbol = m_symbols.at(index);
+        if (symbol->range().contains(position) && (!filterFunc || filterFunc(*symbol)))
+            return symbol;
+    }
+    return nullptr;
+}
+
 } // namespace Core
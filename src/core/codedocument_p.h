@@ -10,18 +10,35 @@
 
 #pragma once
 
+#include "astnode.h"
 #include "rangemark.h"
 #include "symbol.h"
 #include "treesitter/node.h"
 #include "treesitter/parser.h"
+#include "treesitter/predicates.h"
 #include "treesitter/query.h"
 #include "treesitter/tree.h"
 
+#include <QFuture>
+#include <QHash>
+#include <QSet>
 #include <QVector>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+
+class QTextDocument;
 
 namespace Core {
 
 class CodeDocument;
+struct TreeSnapshot;
+
+// Returns the text of `document` in the given range, the same way TextDocument::text() would.
+QString plainTextInRange(QTextDocument *document, int position, int length);
 
 class TreeSitterHelper
 {
@@ -29,32 +46,116 @@ public:
     explicit TreeSitterHelper(CodeDocument *document);
 
     void clear();
-
-    treesitter::Parser &parser();
+    // Adopts a tree parsed outside of the document, ignored if there's a tree already or the text doesn't match.
+    void setPrefetchedTree(treesitter::Tree &&tree, const QString &text, int64_t treeBytes);
+    // Update the syntax tree after a change in the document, so the next parse is incremental.
+    void edit(int position, int charsRemoved, int charsAdded);
+
+    const TSLanguage *language() const;
+    // Parses the document if needed, and returns the syntax tree.
+    // If a previous parse timed out or was cancelled, the document is not parsed again until it changes.
     std::optional<treesitter::Tree> &syntaxTree();
+    // Parses the document if needed, stopping after `timeout` (the settings value if not set, 0 for no limit).
+    // Returns false if the parse failed, timed out or was cancelled.
+    bool parse(std::optional<std::chrono::milliseconds> timeout = {});
+    // Stops the parse in progress, if any. Can be called from any thread.
+    void cancelParse();
+    // The text of the syntax tree, call syntaxTree() first to make sure it's up to date.
+    const QString &syntaxTreeText() const;
+    // Returns a copy of the syntax tree and its text, shared until the tree changes.
+    std::shared_ptr<const TreeSnapshot> snapshot();
 
     std::shared_ptr<treesitter::Query> constructQuery(const QString &query);
-    QVector<treesitter::Node> nodesInRange(const RangeMark &range);
 
     const QVector<Core::Symbol *> &symbols();
+    // Updates the symbols in a worker thread, from a snapshot of the syntax tree, and calls `callback` in the GUI
+    // thread once they are up to date. The callback is not called if the document is destroyed in the meantime.
+    void updateSymbolsAsync(std::function<void()> callback);
+    // Returns the first symbol whose fully qualified name is `name`.
+    Core::Symbol *findSymbol(const QString &name, Qt::CaseSensitivity cs);
+    // Returns the innermost symbol containing `position` and accepted by `filterFunc`.
+    Core::Symbol *symbolAt(int position, const std::function<bool(const Symbol &)> &filterFunc);
+
+    // Returns the AstNode wrapping `node`, which must be a node of the current syntax tree. The wrappers are created
+    // once per syntax tree, so walking the tree from a script doesn't create new RangeMarks for each step.
+    AstNode astNode(const treesitter::Node &node);
+    // Changes each time the syntax tree is edited or cleared, the nodes of an older tree can't be used anymore.
+    size_t treeGeneration() const;
+
+    // Returns the range of the MFC message map, searched once per syntax tree
+    std::optional<treesitter::Predicates::MessageMapRange> messageMap();
+
+    // Memory used by the syntax tree, as allocated by tree-sitter during the parses, and the symbols
+    int64_t treeBytes() const { return m_treeBytes; }
+    int64_t symbolBytes() const;
 
 private:
-    void assignSymbolContexts();
-
-    QVector<Core::Symbol *> functionSymbols() const;
-    QVector<Core::Symbol *> classSymbols() const;
-    QVector<Core::Symbol *> memberSymbols() const;
-    QVector<Core::Symbol *> enumSymbols() const;
+    void clearSymbols();
+    void clearAstNodes();
+    // Only assigns the contexts of `newSymbols` if set, the other symbols already have theirs
+    void assignSymbolContexts(const QSet<Core::Symbol *> *newSymbols = nullptr);
+    bool loadCachedSymbols(const QByteArray &hash);
+    void saveCachedSymbols(const QByteArray &hash) const;
+    // Keeps the symbols up to date after a change, until updateSymbols rebuilds the ones in the changed range
+    void editSymbols(int position, int charsRemoved, int charsAdded);
+    void updateSymbols();
+    // Returns the range to rebuild after a change: the changed range, extended to the symbols intersecting it
+    TextRange outdatedSymbolRange() const;
+    // Replaces the symbols intersecting `range` by `newSymbols`, which must be inside it
+    void replaceSymbols(const TextRange &range, QVector<Core::Symbol *> &&newSymbols);
+    // Sets all the symbols, and saves them in the symbol cache if `hash` is not empty
+    void setSymbols(QVector<Core::Symbol *> &&symbols, const QByteArray &hash);
+    // Hash of the text used by the symbol cache, empty if the symbols of this document are not cached
+    QByteArray symbolCacheHash() const;
+
+    // A symbol found by the symbol queries, before the Symbol object is created in the GUI thread
+    struct SymbolData
+    {
+        Symbol::Kind kind;
+        QString name;
+        Symbol::Captures captures;
+    };
+    // Runs the symbol queries on `snapshot`, in the whole text or only in `range` if set.
+    // Can be called from any thread, `progress` is called after each match if set.
+    static QVector<SymbolData> buildSymbolData(const TSLanguage *language, const TreeSnapshot &snapshot,
+                                               std::optional<TextRange> range, uint32_t matchLimit,
+                                               const std::function<void()> &progress = {});
+    // The symbols are searched in the whole document, or only in `range` if set
+    QVector<Core::Symbol *> buildSymbols(std::optional<TextRange> range = {});
+    QVector<Core::Symbol *> makeSymbols(QVector<SymbolData> &&symbols) const;
 
     enum Flags {
         HasSymbols = 0x01,
+        TreeOutdated = 0x02,
+        ParseAborted = 0x04,
+        // The document changed since the symbols were built, see m_changedSymbolRange
+        SymbolsOutdated = 0x08,
     };
 
     CodeDocument *const m_document;
-    std::optional<treesitter::Parser> m_parser;
     std::optional<treesitter::Tree> m_tree;
+    // The text matching m_tree, including all edits applied since the last parse.
+    QString m_text;
+    // Sorted by position, outer symbols first
     QVector<Core::Symbol *> m_symbols;
+    // Index in m_symbols of the closest surrounding symbol of each symbol, -1 if there is none
+    QVector<int> m_parentSymbols;
+    // Symbols indexed by their lower-case qualified name
+    QHash<QString, QVector<Core::Symbol *>> m_symbolsByName;
+    // Range of the current text changed since the symbols were built, including the changed ranges of the tree
+    TextRange m_changedSymbolRange {0, 0};
+    // AstNode wrappers of the current syntax tree, keyed by tree-sitter node id
+    std::unordered_map<const void *, AstNode> m_astNodes;
+    size_t m_treeGeneration = 0;
+    // Set once the message map has been searched in the current tree, even if there is none
+    std::optional<std::optional<treesitter::Predicates::MessageMapRange>> m_messageMap;
+    std::shared_ptr<const TreeSnapshot> m_snapshot;
+    // Last update started by updateSymbolsAsync, building the symbols in a worker thread
+    QFuture<void> m_symbolFuture;
+    // Sum of the net tree-sitter allocations of each parse (the new tree minus the previous one)
+    int64_t m_treeBytes = 0;
     int m_flags = 0;
+    std::atomic<size_t> m_cancelParse = 0;
 };
 
 } // namespace Core
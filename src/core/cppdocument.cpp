@@ -9,17 +9,18 @@
 */
 
 #include "cppdocument.h"
+#include "classeditor.h"
 #include "cppdocument_p.h"
 #include "functionsymbol.h"
 #include "logger.h"
 #include "project.h"
 #include "settings.h"
+#include "treesitter/builtinqueries.h"
 #include "utils.h"
 #include "utils/log.h"
 
 #include <QFileInfo>
 #include <QHash>
-#include <QPlainTextEdit>
 #include <QRegularExpression>
 #include <QTextBlock>
 #include <QTextDocument>
@@ -49,12 +50,6 @@ CppDocument::CppDocument(QObject *parent)
 
 CppDocument::~CppDocument() = default;
 
-static bool isHeaderSuffix(const QString &suffix)
-{
-    // Good enough for now, headers starts with h or hpp
-    return suffix.startsWith('h');
-}
-
 bool CppDocument::isHeader() const
 {
     const QFileInfo fi(fileName());
@@ -77,53 +72,44 @@ void CppDocument::commentSelection()
 {
     LOG("CppDocument::commentSelection");
 
-    QTextCursor cursor = textEdit()->textCursor();
-    cursor.beginEditBlock();
+    QTextCursor cursor = textCursor();
+    const QTextDocument *doc = qTextDocument();
 
+    // All the comment markers are inserted with one edit, then the selection is moved to the commented text
     const int cursorPos = cursor.position();
-    int selectionOffset = 0;
+    QVector<TextEdit> edits;
 
     if (hasSelection()) {
         int selectionStartPos = cursor.selectionStart();
         const int selectionEndPos = cursor.selectionEnd();
 
         // Preparing to check if the start and end positions of the selection are before any text of the lines
-        cursor.setPosition(selectionStartPos);
-        cursor.movePosition(QTextCursor::StartOfLine, QTextCursor::KeepAnchor);
-        const QString str1 = cursor.selectedText();
-        cursor.setPosition(selectionEndPos);
-        cursor.movePosition(QTextCursor::StartOfLine, QTextCursor::KeepAnchor);
-        const QString str2 = cursor.selectedText();
+        const QTextBlock firstBlock = doc->findBlock(selectionStartPos);
+        QTextBlock lastBlock = doc->findBlock(selectionEndPos);
+        const QString str1 = firstBlock.text().left(selectionStartPos - firstBlock.position());
+        const QString str2 = lastBlock.text().left(selectionEndPos - lastBlock.position());
 
         if (str1.trimmed().isEmpty() && str2.trimmed().isEmpty()) {
             // Comment all lines in the selected region with "//"
-            cursor.setPosition(selectionStartPos);
-            cursor.movePosition(QTextCursor::StartOfLine);
-            selectionStartPos = cursor.position();
-
-            cursor.setPosition(selectionEndPos);
+            selectionStartPos = firstBlock.position();
             // If the end of selection is at the beginning of the line, don't comment out the line the cursor is in.
             if (str2.isEmpty())
-                cursor.movePosition(QTextCursor::Left);
-            cursor.movePosition(QTextCursor::StartOfLine);
-
-            do {
-                cursor.insertText("//");
-                selectionOffset += 2;
-                cursor.movePosition(QTextCursor::Up);
-                cursor.movePosition(QTextCursor::StartOfLine);
-            } while (cursor.position() >= selectionStartPos);
+                lastBlock = lastBlock.previous();
+            for (auto block = firstBlock; block.isValid(); block = block.next()) {
+                edits.push_back({{block.position(), block.position()}, "//"});
+                if (block == lastBlock)
+                    break;
+            }
         } else {
             // Comment the selected region using "/*" and "*/"
-            cursor.setPosition(selectionEndPos);
-            cursor.insertText("*/");
-            selectionOffset += 2;
-            cursor.setPosition(selectionStartPos);
-            cursor.insertText("/*");
-            selectionOffset += 2;
+            edits.push_back({{selectionStartPos, selectionStartPos}, "/*"});
+            edits.push_back({{selectionEndPos, selectionEndPos}, "*/"});
         }
+        if (!applyEdits(edits))
+            return;
 
         // Set the selection after commenting
+        const int selectionOffset = 2 * static_cast<int>(edits.size());
         if (cursorPos == selectionEndPos) {
             cursor.setPosition(selectionStartPos);
             cursor.setPosition(selectionEndPos + selectionOffset, QTextCursor::KeepAnchor);
@@ -132,55 +118,19 @@ void CppDocument::commentSelection()
             cursor.setPosition(selectionStartPos, QTextCursor::KeepAnchor);
         }
     } else {
-        cursor.select(QTextCursor::LineUnderCursor);
+        const QTextBlock block = doc->findBlock(cursorPos);
         // If the line is not empty, then comment it using "//"
-        if (!cursor.selectedText().isEmpty()) {
-            cursor.movePosition(QTextCursor::StartOfLine);
-            cursor.insertText("//");
-            selectionOffset += 2;
+        if (!block.text().isEmpty()) {
+            edits.push_back({{block.position(), block.position()}, "//"});
+            if (!applyEdits(edits))
+                return;
         }
 
         // Set the position after commenting
-        cursor.setPosition(cursorPos + selectionOffset);
+        cursor.setPosition(cursorPos + 2 * static_cast<int>(edits.size()));
     }
 
-    cursor.endEditBlock();
-    textEdit()->setTextCursor(cursor);
-}
-
-static QStringList matchingSuffixes(bool header)
-{
-    static const auto mimeTypes =
-        Settings::instance()->value<std::map<std::string, Document::Type>>(Settings::MimeTypes);
-
-    QStringList suffixes;
-    for (const auto &it : mimeTypes) {
-        if (it.second == Document::Type::Cpp) {
-            const QString suffix = QString::fromStdString(it.first);
-            if ((header && !isHeaderSuffix(suffix)) || (!header && isHeaderSuffix(suffix)))
-                suffixes.push_back(suffix);
-        }
-    }
-    return suffixes;
-}
-
-static QStringList candidateFileNames(const QString &baseName, const QStringList &suffixes)
-{
-    QStringList result;
-    result.reserve(suffixes.size());
-    for (const auto &suffix : suffixes)
-        result.push_back(baseName + '.' + suffix);
-    return result;
-}
-
-static int commonFilePathLength(const QString &s1, const QString &s2)
-{
-    const qsizetype length = qMin(s1.length(), s2.length());
-    for (qsizetype i = 0; i < length; ++i) {
-        if (s1[i].toLower() != s2[i].toLower())
-            return i;
-    }
-    return length;
+    setTextCursor(cursor);
 }
 
 /*!
@@ -190,55 +140,12 @@ static int commonFilePathLength(const QString &s1, const QString &s2)
 QString CppDocument::correspondingHeaderSource() const
 {
     LOG("CppDocument::correspondingHeaderSource");
-    static QHash<QString, QString> cache;
-
-    QString cacheData = cache.value(fileName());
-    if (!cacheData.isEmpty())
-        return cacheData;
-
-    const bool header = isHeader();
-    const QStringList suffixes = matchingSuffixes(header);
 
-    const QFileInfo fi(fileName());
-    const QStringList candidates = candidateFileNames(fi.completeBaseName(), suffixes);
-
-    // Search in the current directory
-    for (const auto &candidate : candidates) {
-        const QString testFileName = fi.absolutePath() + '/' + candidate;
-        if (QFile::exists(testFileName)) {
-            cache[fileName()] = testFileName;
-            cache[testFileName] = fileName();
-            spdlog::debug("CppDocument::correspondingHeaderSource {} => {}", fileName(), testFileName);
-            LOG_RETURN("path", testFileName);
-        }
-    }
-
-    // Search in the whole project, and find the possible files
-    QStringList fullPathNames = Project::instance()->allFilesWithExtensions(suffixes, Project::FullPath);
-    auto notCandidate = [&candidates](const QString &path) {
-        auto notInPath = [&path](const QString &candidate) {
-            return !path.endsWith(candidate, Qt::CaseInsensitive);
-        };
-        return kdalgorithms::all_of(candidates, notInPath);
-    };
-    kdalgorithms::erase_if(fullPathNames, notCandidate);
-
-    // Find the file having the most common path with fileName
-    QString bestFileName;
-    int compareValue = 0;
-    for (const auto &path : std::as_const(fullPathNames)) {
-        int value = commonFilePathLength(path, fileName());
-        if (value > compareValue) {
-            compareValue = value;
-            bestFileName = path;
-        }
-    }
-
-    if (!bestFileName.isEmpty()) {
-        cache[fileName()] = bestFileName;
-        cache[bestFileName] = fileName();
-        spdlog::debug("CppDocument::correspondingHeaderSource {} => {}", fileName(), bestFileName);
-        LOG_RETURN("path", bestFileName);
+    const QString result =
+        Project::instance()->findCorrespondingFile(fileName(), correspondingHeaderSourceCandidates(fileName()));
+    if (!result.isEmpty()) {
+        spdlog::debug("CppDocument::correspondingHeaderSource {} => {}", fileName(), result);
+        LOG_RETURN("path", result);
     }
 
     spdlog::warn("CppDocument::correspondingHeaderSource {} - not found ", fileName());
@@ -274,23 +181,8 @@ Core::QueryMatch CppDocument::queryClassDefinition(const QString &className)
 {
     LOG("CppDocument::queryClassDefinition", LOG_ARG("className", className));
 
-    // clang-format off
-    const auto classDefinitionQuery = QString(R"EOF(
-        ; query classes or structs
-        [(class_specifier
-            name: (_) @name (#like? @name "%1")
-            (base_class_clause
-                [(type_identifier) @base _]*)?
-            body: (_) @body)
-        (struct_specifier
-            name: (_) @name (#like? @name "%1")
-            (base_class_clause
-                [(type_identifier) @base _]*)?
-            body: (_) @body)]
-    )EOF").arg(className);
-    // clang-format on
-
-    auto matches = query(classDefinitionQuery);
+    static const auto classDefinitionQuery = treesitter::builtinQuery("cpp/class_definition");
+    auto matches = query(classDefinitionQuery, {{"names", {className}}});
     if (matches.isEmpty()) {
         spdlog::warn("CppDocument::queryClassDefinition: No class named `{}` found in `{}`", className, fileName());
         return {};
@@ -319,63 +211,60 @@ Core::QueryMatch CppDocument::queryClassDefinition(const QString &className)
  * - `body` - The body of the method (including curly-braces)
  *
  * Please note that the return type is not available, as TreeSitter is not able to parse it easily.
+ *
+ * \sa CppDocument::queryMethodDefinitions
  */
 Core::QueryMatchList CppDocument::queryMethodDefinition(const QString &scope, const QString &functionName)
 {
     LOG("CppDocument::queryMethodDefinition", LOG_ARG("scope", scope), LOG_ARG("functionName", functionName));
 
-    // Clang-format gets confused by the raw strings
-    // clang-format off
-    auto identifier = QString(R"EOF(
-            (identifier) @name (#eq? @name "%1")
-        )EOF").arg(functionName);
-
-    if (!scope.isEmpty()) {
-        identifier = QString(R"EOF(
-            (qualified_identifier
-                scope: (_) @scope (#like? @scope "%1")
-                %2
-            )
-        )EOF").arg(scope, identifier);
-    }
+    return internalQueryMethodDefinitions(scope, {functionName});
+}
 
-    const auto queryFunctionName = QString(R"EOF(
-        (function_declarator
-            declarator: %1
-            parameters: (parameter_list
-                (parameter_declaration)* @parameters
-            ) @parameter-list
-        )
-    )EOF").arg(identifier);
-    // handle Type, Type *, Type &, Type *&, Type &* and Type **
-    const auto queryString = QString(R"EOF(
-        (function_definition
-            type: (_)? @return-type
-            [
-                declarator: (_ (_ %1 ) )
-                declarator: (_ %1 )
-                declarator: %1
-            ]
-            body: (compound_statement) @body
-        ) @definition
-    )EOF").arg(queryFunctionName);
-    //clang-format on
-
-    return query(queryString);
+/*!
+ * \qmlmethod array<QueryMatch> CppDocument::queryMethodDefinitions(string scope, array<string> methodNames)
+ *
+ * Returns the list of methods definitions matching any of the given names in the given scope, in the order of the
+ * document. The captures are the same as for `queryMethodDefinition`.
+ *
+ * The document is only traversed once, which is a lot faster than calling `queryMethodDefinition` for each name.
+ */
+Core::QueryMatchList CppDocument::queryMethodDefinitions(const QString &scope, const QStringList &functionNames)
+{
+    LOG("CppDocument::queryMethodDefinitions", LOG_ARG("scope", scope), LOG_ARG("functionNames", functionNames));
+
+    return internalQueryMethodDefinitions(scope, functionNames);
+}
+
+Core::QueryMatchList CppDocument::internalQueryMethodDefinitions(const QString &scope,
+                                                                 const QStringList &functionNames)
+{
+    // The names looked for are passed as parameters, so the queries don't depend on them
+    static const auto unscopedQuery = treesitter::builtinQuery("cpp/method_definition");
+    static const auto scopedQuery = treesitter::builtinQuery("cpp/scoped_method_definition");
+
+    treesitter::Predicates::Parameters parameters {
+        {"names", QSet<QString>(functionNames.cbegin(), functionNames.cend())}};
+    if (scope.isEmpty())
+        return query(unscopedQuery, std::move(parameters));
+    parameters["scopes"] = {scope};
+    return query(scopedQuery, std::move(parameters));
 }
 
-QVector<QueryMatch> CppDocument::internalQueryFunctionCall(const QString& functionName, const QString& argumentsQuery)
+QVector<QueryMatch> CppDocument::internalQueryFunctionCall(const QStringList &functionNames,
+                                                           const QString &argumentsQuery)
 {
+    // The query only depends on the arguments, the names are passed as parameters
     const auto queryString = QString(R"EOF(
                 (call_expression
-                    function: (_) @name (#eq? @name "%1")
+                    function: (_) @name (#in? @name "names")
                     arguments: (argument_list
-                            %2
+                            %1
                         ) @argument-list
                 ) @call
-    )EOF").arg(functionName, argumentsQuery);
+    )EOF").arg(argumentsQuery);
 
-    return query(queryString);
+    return query(queryString, {{"names", QSet<QString>(functionNames.cbegin(), functionNames.cend())}});
 }
 
 /*!
@@ -411,7 +300,7 @@ Core::QueryMatchList CppDocument::queryFunctionCall(const QString &functionName,
     const auto argumentsQuery = arguments.join(" \",\"\n");
 
 
-    return internalQueryFunctionCall(functionName, QString(R"EOF(
+    return internalQueryFunctionCall({functionName}, QString(R"EOF(
         . "("
         %1
         . ")" .
@@ -429,13 +318,29 @@ Core::QueryMatchList CppDocument::queryFunctionCall(const QString &functionName,
  * - `name` - The name of the function (the text will be equal to functionName)
  * - `argument-list` - The entire list of arguments, including the surroundg parentheses `()`
  * - `arguments` - Each argument provided to the function call, in order, excluding any comments
+ *
+ * \sa CppDocument::queryFunctionCalls
  */
 Core::QueryMatchList CppDocument::queryFunctionCall(const QString& functionName)
 {
     LOG("queryFunctionCall", LOG_ARG("functionName", functionName));
-    return internalQueryFunctionCall(
-            functionName,
-            R"EOF([(_) @arguments ","]* (#exclude! @arguments comment))EOF");
+    static const auto functionCallQuery = treesitter::builtinQuery("cpp/function_call");
+    return query(functionCallQuery, {{"names", {functionName}}});
+}
+
+/*!
+ * \qmlmethod array<QueryMatch> CppDocument::queryFunctionCalls(array<string> functionNames)
+ *
+ * Returns the list of function calls to any of the functions in `functionNames`, in the order of the document, no
+ * matter how many arguments they were called with. The captures are the same as for `queryFunctionCall(functionName)`.
+ *
+ * The document is only traversed once, which is a lot faster than calling `queryFunctionCall` for each name.
+ */
+Core::QueryMatchList CppDocument::queryFunctionCalls(const QStringList &functionNames)
+{
+    LOG("CppDocument::queryFunctionCalls", LOG_ARG("functionNames", functionNames));
+    static const auto functionCallQuery = treesitter::builtinQuery("cpp/function_call");
+    return query(functionCallQuery, {{"names", QSet<QString>(functionNames.cbegin(), functionNames.cend())}});
 }
 
 /*!
@@ -464,7 +369,7 @@ bool CppDocument::insertCodeInMethod(const QString &methodName, QString code, Po
         return false;
     }
 
-    QTextCursor cursor = textEdit()->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.setPosition(symbol->range().end);
     cursor.movePosition(QTextCursor::Left, QTextCursor::KeepAnchor);
     if (cursor.selectedText() != "}") {
@@ -480,7 +385,7 @@ bool CppDocument::insertCodeInMethod(const QString &methodName, QString code, Po
     const QString strTab = tab();
     if (insertAt == StartOfMethod) {
         // Goto the start of the block
-        textEdit()->setTextCursor(cursor);
+        setTextCursor(cursor);
         cursor.setPosition(gotoBlockStart());
         // Move forward one character
         cursor.movePosition(QTextCursor::NextCharacter);
@@ -504,7 +409,7 @@ bool CppDocument::insertCodeInMethod(const QString &methodName, QString code, Po
     cursor.insertText(code);
     cursor.endEditBlock();
 
-    textEdit()->setTextCursor(cursor);
+    setTextCursor(cursor);
 
     return true;
 }
@@ -547,7 +452,7 @@ bool CppDocument::insertForwardDeclaration(const QString &forwardDeclaration)
     qualifierList.pop_front();
 
     // Check if the declaration already exists
-    QTextDocument *doc = textEdit()->document();
+    QTextDocument *doc = qTextDocument();
     QTextCursor cursor(doc);
     cursor = doc->find(result, cursor, QTextDocument::FindWholeWords);
     if (!cursor.isNull()) {
@@ -559,21 +464,21 @@ bool CppDocument::insertForwardDeclaration(const QString &forwardDeclaration)
         result = QString("namespace %1 {\n%2\n}").arg(qualifier, result);
 
     int pos = -1;
-    if (const auto inc = query(Queries::findInclude); !inc.isEmpty()) {
+    if (const auto inc = query(treesitter::builtinQuery("cpp/find_include")); !inc.isEmpty()) {
         const auto def = inc.last().get("path");
         pos = def.end();
-    } else if (const auto pragma = query(Queries::findPragma); !pragma.isEmpty()) {
+    } else if (const auto pragma = query(treesitter::builtinQuery("cpp/find_pragma")); !pragma.isEmpty()) {
         const auto def = pragma.at(0).get("value");
         pos = def.end();
-    } else if (const auto guard = query(Queries::findHeaderGuard); !guard.isEmpty()) {
+    } else if (const auto guard = query(treesitter::builtinQuery("cpp/find_header_guard")); !guard.isEmpty()) {
         const auto def = guard.at(0).get("value");
         pos = def.end();
     }
 
     if (pos != -1) {
-        auto cur = textEdit()->textCursor();
+        auto cur = textCursor();
         cur.setPosition(pos);
-        textEdit()->setTextCursor(cur);
+        setTextCursor(cur);
         cur.beginEditBlock();
         cur.movePosition(QTextCursor::EndOfLine, QTextCursor::MoveAnchor);
         cur.insertText("\n\n" + result);
@@ -620,57 +525,22 @@ DataExchange CppDocument::mfcExtractDDX(const QString &className)
  */
 MessageMap CppDocument::mfcExtractMessageMap(const QString &className /* = ""*/)
 {
-    auto checkClassName = className.isEmpty() ? "" : QString("(#eq? @class \"%1\")").arg(className);
-
-    // clang-format off
-    const auto messageMapQueryString = QString(R"EOF(
-        ; Search for BEGIN_MESSAGE_MAP
-        (expression_statement
-            (call_expression
-                function: (identifier) @begin_ident
-                (#eq? @begin_ident "BEGIN_MESSAGE_MAP")
-                arguments: (argument_list
-                        (identifier) @class
-                        %1 ; If a class name is given, check if the captured class name matches
-                        (identifier) @superclass)) @begin)
-
-        ; Followed by one or more entries
-        [
-        (expression_statement
-            (call_expression
-                function: (identifier) @message-name
-                arguments: (argument_list
-                    [(_)* @parameter ","]*
-                    (#exclude! @parameter comment))
-        ))@message
-        (_)
-        ]*
-
-        ; Ending with END_MESSAGE_MAP
-        (expression_statement
-            (call_expression
-                function: (identifier) @end_ident
-                (#eq? @end_ident "END_MESSAGE_MAP")) @end)
-    )EOF").arg(checkClassName);
-    // clang-format on
-
-    // clang-format off
-    // Assumption: the MESSAGE_MAP is either top-level or in a namespace
-    // Parenthesis (around %1) are used to make sure nodes are siblings
-    const auto queryString = QString(R"EOF(
-        (translation_unit
-            [
-                (namespace_definition (_ ( %1 ) ) )
-                ( %1 )
-            ]
-        )
-    )EOF").arg(messageMapQueryString);
-    // clang-format on
+    static const auto messageMapQuery = treesitter::builtinQuery("cpp/message_map");
 
     // We assume there is at most one MessageMap per file.
     // This allows us to return immediately after the message map is found.
     // As the MessageMap query is quite complicated, this can significantly improve performance.
-    auto match = queryFirst(queryString);
+    QueryMatch match;
+    if (className.isEmpty()) {
+        match = queryFirst(messageMapQuery);
+    } else {
+        const auto matches = query(messageMapQuery);
+        const auto it = std::ranges::find_if(matches, [&className](const QueryMatch &match) {
+            return match.get("class").text() == className;
+        });
+        if (it != matches.cend())
+            match = *it;
+    }
     if (match.isEmpty()) {
         spdlog::warn("CppDocument::mfcExtractMessageMap: No message map found in `{}`", fileName());
         return {};
@@ -697,31 +567,17 @@ Core::QueryMatchList CppDocument::queryMethodDeclaration(const QString &classNam
 {
     LOG("CppDocument::queryMethodDeclaration", LOG_ARG("className", className), LOG_ARG("functionName", functionName));
 
-    auto classQuery = queryClassDefinition(className);
+    const auto body = queryClassDefinition(className).get("body");
 
     // TODO: extract parameters
     // TODO: make it works with constructors and destructors
 
-    // clang-format off
-    auto queryFunctionName = QString(R"EOF(
-        (function_declarator
-            declarator:(field_identifier) @name (#eq? @name "%1")
-        )
-    )EOF").arg(functionName);
-    // handle Type, Type *, Type &, Type *&, Type &* and Type **
-    auto queryString = QString(R"EOF(
-        (field_declaration
-            type: (_)? @return-type
-            [
-                declarator: (_ (_ %1 ) )
-                declarator: (_ %1 )
-                declarator: %1
-            ]
-        ) @declaration
-    )EOF").arg(queryFunctionName);
-    // clang-format on
-
-    auto matches = classQuery.queryIn("body", queryString);
+    // The name is passed as a parameter, so the query is only compiled once
+    static const auto queryString = treesitter::builtinQuery("cpp/method_declaration");
+
+    Core::QueryMatchList matches;
+    if (body.isValid())
+        matches = queryInRange(body, queryString, {{"names", {functionName}}});
     if (matches.isEmpty()) {
         spdlog::warn("CppDocument::queryMethodDeclaration: No method named `{}` found in `{}`", functionName,
                      fileName());
@@ -746,25 +602,14 @@ Core::QueryMatch CppDocument::queryMember(const QString &className, const QStrin
 {
     LOG("CppDocument::queryMember", LOG_ARG("className", className), LOG_ARG("memberName", memberName));
 
-    auto classQuery = queryClassDefinition(className);
-
-    // clang-format off
-    auto queryMemberName = QString("(field_identifier) @name");
-    // handle Type, Type *, Type &, Type *&, Type &* and Type **
-    auto queryString = QString(R"EOF(
-        (field_declaration
-            type: (_) @type
-            [
-                declarator: (_ (_ %1 ) )
-                declarator: (_ %1 )
-                declarator: %1
-            ]
-            (#eq? @name "%2")
-        ) @member
-    )EOF").arg(queryMemberName, memberName);
-    // clang-format on
-
-    auto matches = classQuery.queryIn("body", queryString);
+    const auto body = queryClassDefinition(className).get("body");
+
+    // The name is passed as a parameter, so the query is only compiled once
+    static const auto queryString = treesitter::builtinQuery("cpp/member");
+
+    Core::QueryMatchList matches;
+    if (body.isValid())
+        matches = queryInRange(body, queryString, {{"names", {memberName}}});
     if (matches.isEmpty()) {
         spdlog::warn("CppDocument::queryMember: No member named `{}` found in `{}`", memberName, fileName());
         return {};
@@ -786,12 +631,12 @@ int CppDocument::gotoBlockStart(int count)
 {
     LOG_AND_MERGE("CppDocument::gotoBlockStart", count);
 
-    QTextCursor cursor = textEdit()->textCursor();
+    QTextCursor cursor = textCursor();
     while (count != 0) {
         cursor.setPosition(moveBlock(cursor.position(), QTextCursor::PreviousCharacter));
         --count;
     }
-    textEdit()->setTextCursor(cursor);
+    setTextCursor(cursor);
     return cursor.position();
 }
 
@@ -805,12 +650,12 @@ int CppDocument::gotoBlockEnd(int count)
 {
     LOG_AND_MERGE("CppDocument::gotoBlockEnd", count);
 
-    QTextCursor cursor = textEdit()->textCursor();
+    QTextCursor cursor = textCursor();
     while (count != 0) {
         cursor.setPosition(moveBlock(cursor.position(), QTextCursor::NextCharacter));
         --count;
     }
-    textEdit()->setTextCursor(cursor);
+    setTextCursor(cursor);
     return cursor.position();
 }
 
@@ -824,7 +669,7 @@ int CppDocument::selectBlockStart(int count)
 {
     LOG_AND_MERGE("CppDocument::selectBlockStart", count);
 
-    QTextCursor cursor = textEdit()->textCursor();
+    QTextCursor cursor = textCursor();
     const int selectionStart = std::max(cursor.selectionStart(), cursor.selectionEnd());
     while (count != 0) {
         cursor.setPosition(moveBlock(cursor.position(), QTextCursor::PreviousCharacter));
@@ -835,7 +680,7 @@ int CppDocument::selectBlockStart(int count)
     cursor.setPosition(selectionStart, QTextCursor::MoveAnchor);
     cursor.setPosition(blockStartPos, QTextCursor::KeepAnchor);
 
-    textEdit()->setTextCursor(cursor);
+    setTextCursor(cursor);
     return blockStartPos;
 }
 
@@ -849,7 +694,7 @@ int CppDocument::selectBlockEnd(int count)
 {
     LOG_AND_MERGE("CppDocument::selectBlockEnd", count);
 
-    QTextCursor cursor = textEdit()->textCursor();
+    QTextCursor cursor = textCursor();
     const int selectionStart = std::min(cursor.selectionStart(), cursor.selectionEnd());
     while (count != 0) {
         cursor.setPosition(moveBlock(cursor.position(), QTextCursor::NextCharacter));
@@ -860,7 +705,7 @@ int CppDocument::selectBlockEnd(int count)
     cursor.setPosition(selectionStart, QTextCursor::MoveAnchor);
     cursor.setPosition(blockEndPos, QTextCursor::KeepAnchor);
 
-    textEdit()->setTextCursor(cursor);
+    setTextCursor(cursor);
     return blockEndPos;
 }
 
@@ -874,7 +719,7 @@ int CppDocument::selectBlockUp(int count)
 {
     LOG_AND_MERGE("CppDocument::selectBlockUp", count);
 
-    QTextCursor cursor = textEdit()->textCursor();
+    QTextCursor cursor = textCursor();
     while (count != 0) {
         cursor.setPosition(moveBlock(cursor.position(), QTextCursor::NextCharacter));
         --count;
@@ -884,7 +729,7 @@ int CppDocument::selectBlockUp(int count)
     cursor.setPosition(blockStartPos, QTextCursor::MoveAnchor);
     cursor.setPosition(blockEndPos, QTextCursor::KeepAnchor);
 
-    textEdit()->setTextCursor(cursor);
+    setTextCursor(cursor);
     return blockEndPos;
 }
 
@@ -898,50 +743,37 @@ int CppDocument::moveBlock(int startPos, QTextCursor::MoveOperation direction)
 {
     Q_ASSERT(direction == QTextCursor::NextCharacter || direction == QTextCursor::PreviousCharacter);
 
-    QTextDocument *doc = textEdit()->document();
+    QTextDocument *doc = qTextDocument();
     Q_ASSERT(doc);
 
     const int inc = direction == QTextCursor::NextCharacter ? 1 : -1;
-    const int lastPos = direction == QTextCursor::NextCharacter ? textEdit()->document()->characterCount() - 1 : 0;
+    const int lastPos = direction == QTextCursor::NextCharacter ? qTextDocument()->characterCount() - 1 : 0;
     if (startPos == lastPos)
         return startPos;
     int pos = startPos + inc;
-    QChar currentChar = doc->characterAt(pos);
-
-    // Set the characters delimiter that increment or decrement the counter when iterating
-    auto incCounterChar =
-        direction == QTextCursor::NextCharacter ? QVector<QChar> {'(', '{', '['} : QVector<QChar> {')', '}', ']'};
-    auto decCounterChar =
-        direction == QTextCursor::PreviousCharacter ? QVector<QChar> {'(', '{', '['} : QVector<QChar> {')', '}', ']'};
+    const QChar currentChar = doc->characterAt(pos);
 
     // If the character next is a special one, go inside the block
-    if (incCounterChar.contains(currentChar))
+    const bool next = direction == QTextCursor::NextCharacter;
+    if ((next && (currentChar == '(' || currentChar == '{' || currentChar == '['))
+        || (!next && (currentChar == ')' || currentChar == '}' || currentChar == ']')))
         pos += inc;
-
-    // Iterate to find the other side of the block
-    int counter = 0;
     pos += inc;
 
-    auto hitLastChar = [direction, lastPos](int pos) {
-        return direction == QTextCursor::NextCharacter ? pos >= lastPos : pos <= lastPos;
-    };
-
-    while (!hitLastChar(pos)) {
-        currentChar = doc->characterAt(pos);
-
-        if (incCounterChar.contains(currentChar)) {
-            counter++;
-
-        } else if (decCounterChar.contains(currentChar)) {
-            counter--;
+    // Find the other side of the block, using the brackets of the current text
+    const auto &helper = blockHelper();
+    const int result = next ? helper.blockEnd(pos) : helper.blockStart(pos);
+    return result == -1 ? startPos : result;
+}
 
-            // When counter is negative, we have found the other side of the block
-            if (counter < 0)
-                return pos + std::max(inc, 0);
-        }
-        pos += inc;
+const BlockHelper &CppDocument::blockHelper()
+{
+    if (!m_blockHelper || m_blockHelperRevision != contentRevision()) {
+        // Use the text of the QTextDocument, the cached text is not updated inside an edit block
+        m_blockHelper = std::make_unique<BlockHelper>(qTextDocument()->toPlainText());
+        m_blockHelperRevision = contentRevision();
     }
-    return startPos;
+    return *m_blockHelper;
 }
 
 /*!
@@ -971,21 +803,20 @@ void CppDocument::toggleSection()
     const auto elseString = QStringLiteral("#else // ") + sectionSettings.tag;
     const auto newLine = QStringLiteral("\n");
 
-    QTextCursor cursor = textEdit()->textCursor();
+    // All the positions are computed on the current text, then the lines are added or removed with one edit
+    QTextCursor cursor = textCursor();
     if (cursor.hasSelection()) {
         // If there's a selection, just add #ifdef/#endif
-        cursor.beginEditBlock();
         auto [min, max] = std::minmax({cursor.selectionStart(), cursor.selectionEnd()});
         int line, col;
         convertPosition(max, &line, &col);
-        // Add #endif / #ifdef, starts to the end or min/max won't be right
-        cursor.setPosition(position(QTextCursor::EndOfLine, col == 1 ? max - 1 : max));
-        cursor.insertText(newLine + endifString);
-        cursor.setPosition(position(QTextCursor::StartOfLine, min));
-        cursor.insertText(ifdefString + newLine);
+        const int ifdefPos = position(QTextCursor::StartOfLine, min);
+        const int endifPos = position(QTextCursor::EndOfLine, col == 1 ? max - 1 : max);
+        const QVector<TextEdit> edits {{{ifdefPos, ifdefPos}, ifdefString + newLine},
+                                       {{endifPos, endifPos}, newLine + endifString}};
+        if (!applyEdits(edits))
+            return;
         // Move after the #endif
-        cursor.endEditBlock();
-        textEdit()->setTextCursor(cursor);
         gotoLine(line + 3);
 
     } else {
@@ -998,29 +829,28 @@ void CppDocument::toggleSection()
             return;
 
         auto cursorPos = cursor.position();
+        const QTextDocument *doc = qTextDocument();
+        QVector<TextEdit> edits;
 
-        cursor.beginEditBlock();
         // Start from the end
         cursor.setPosition(symbol->range().end);
         cursor.movePosition(QTextCursor::StartOfLine);
+        const int closingLinePos = cursor.position();
         cursor.movePosition(QTextCursor::Up, QTextCursor::KeepAnchor);
 
         if (cursor.selectedText().startsWith(endifString)) {
             // The function is already commented out, remove the comments
-            int start = textEdit()->document()->find(elseString, cursor, QTextDocument::FindBackward).selectionStart();
-            if (start > symbol->range().start)
-                cursor.setPosition(start, QTextCursor::KeepAnchor);
-            cursor.removeSelectedText();
-            cursor.setPosition(moveBlock(cursor.position(), QTextCursor::PreviousCharacter));
-            cursor.movePosition(QTextCursor::Down);
-            cursor.movePosition(QTextCursor::StartOfLine);
-            cursor.movePosition(QTextCursor::Down, QTextCursor::KeepAnchor);
-            cursor.removeSelectedText();
+            int start = doc->find(elseString, cursor, QTextDocument::FindBackward).selectionStart();
+            if (start <= symbol->range().start)
+                start = cursor.position();
+            edits.push_back({{start, closingLinePos}, {}});
+            // Remove the #ifdef line, after the line of the opening bracket
+            const QTextBlock ifdefBlock = doc->findBlock(moveBlock(start, QTextCursor::PreviousCharacter)).next();
+            edits.push_back({{ifdefBlock.position(), ifdefBlock.position() + ifdefBlock.length()}, {}});
             cursorPos -= ifdefString.length() + 1;
         } else {
             // Comment out the function with #if/#def, make sure to return something if needed
-            cursor.setPosition(symbol->range().end);
-            cursor.movePosition(QTextCursor::PreviousCharacter);
+            const int closingPos = symbol->range().end - 1;
 
             QString text = elseString + newLine;
             if (!sectionSettings.debug.isEmpty())
@@ -1036,15 +866,14 @@ void CppDocument::toggleSection()
             else
                 text += tab() + "return {};\n";
             text += endifString + newLine;
-            cursor.insertText(text);
 
-            cursor.setPosition(moveBlock(cursor.position(), QTextCursor::PreviousCharacter));
-            cursor.movePosition(QTextCursor::NextCharacter);
-            cursor.insertText(newLine + ifdefString);
+            const int ifdefPos = moveBlock(closingPos, QTextCursor::PreviousCharacter) + 1;
+            edits.push_back({{ifdefPos, ifdefPos}, newLine + ifdefString});
+            edits.push_back({{closingPos, closingPos}, text});
             cursorPos += ifdefString.length() + 1;
         }
-        cursor.endEditBlock();
-        textEdit()->setTextCursor(cursor);
+        if (!applyEdits(edits))
+            return;
         setPosition(cursorPos);
     }
 }
@@ -1062,23 +891,67 @@ void CppDocument::toggleSection()
 bool CppDocument::insertInclude(const QString &include, bool newGroup)
 {
     LOG("CppDocument::insertInclude", LOG_ARG("text", include), newGroup);
+    return doInsertInclude(include, newGroup) != InsertIncludeResult::Malformed;
+}
 
-    IncludeHelper includeHelper(this);
-    auto includePos = includeHelper.includePositionForInsertion(include, newGroup);
+/*!
+ * \qmlmethod CppDocument::insertIncludes(array<string> includes, bool newGroup = false)
+ * Inserts multiple include lines in the file, returns false if one of the includes is malformed.
+ *
+ * This is the same as calling `insertInclude` for each include, but the includes of the file are only parsed once.
+ * If `newGroup` is true, all the includes are added in a new group at the end.
+ */
+bool CppDocument::insertIncludes(const QStringList &includes, bool newGroup)
+{
+    LOG("CppDocument::insertIncludes", includes, newGroup);
+
+    bool result = true;
+    bool groupCreated = false;
+    for (const auto &include : includes) {
+        // Once the new group is created, the next includes are appended to it
+        const auto inserted = doInsertInclude(include, newGroup && !groupCreated, groupCreated);
+        result &= inserted != InsertIncludeResult::Malformed;
+        groupCreated |= newGroup && inserted == InsertIncludeResult::Inserted;
+    }
+    return result;
+}
+
+IncludeHelper &CppDocument::includeHelper()
+{
+    if (!m_includeHelper || m_includeHelperRevision != contentRevision()) {
+        m_includeHelper = std::make_unique<IncludeHelper>(this);
+        m_includeHelperRevision = contentRevision();
+    }
+    return *m_includeHelper;
+}
+
+CppDocument::InsertIncludeResult CppDocument::doInsertInclude(const QString &include, bool newGroup,
+                                                              bool appendToLastGroup)
+{
+    auto &helper = includeHelper();
+    auto includePos = appendToLastGroup ? helper.includePositionForAppend(include)
+                                        : helper.includePositionForInsertion(include, newGroup);
     if (!includePos) {
         spdlog::error(R"(CppDocument::insertInclude - the include '{}' is malformed, should be '<foo.h>' or '"foo.h"')",
                       include);
-        return false;
+        return InsertIncludeResult::Malformed;
     }
 
     if (includePos->alreadyExists()) {
         spdlog::info("CppDocument::insertInclude - the include '{}' is already included.", include);
-        return true;
+        return InsertIncludeResult::AlreadyIncluded;
     }
 
+    // insertAtLine inserts in the last line if the line is after the end of the document: let the includes be parsed
+    // again in that case
+    const bool canUpdateIncludes = includePos->line <= qTextDocument()->blockCount();
     const QString text = (includePos->newGroup ? "\n#include " : "#include ") + include + '\n';
     insertAtLine(text, includePos->line);
-    return true;
+    if (canUpdateIncludes) {
+        helper.includeInserted(include, *includePos);
+        m_includeHelperRevision = contentRevision();
+    }
+    return InsertIncludeResult::Inserted;
 }
 
 CppDocument::MemberOrMethodAdditionResult
@@ -1086,21 +959,15 @@ CppDocument::addMemberOrMethod(const QString &memberInfo, const QString &classNa
 {
 
     QString memberText = memberInfo + ";";
-    // clang-format off
-    const auto queryString = QString(R"EOF(
-        (field_declaration_list
-            (access_specifier "%1") @access
-            . [(declaration) (comment) (field_declaration)]* @field
-        )
-    )EOF").arg(accessSpecifierMap.value(specifier));
-    // clang-format on
+    static const auto accessSpecifierFieldsQuery = treesitter::builtinQuery("cpp/access_specifier_fields");
 
     const auto range = queryClassDefinition(className).get("body");
     if (!range.isValid()) {
         return MemberOrMethodAdditionResult::ClassNotFound;
     }
 
-    auto result = queryInRange(range, queryString);
+    auto result =
+        queryInRange(range, accessSpecifierFieldsQuery, {{"specifiers", {accessSpecifierMap.value(specifier)}}});
     if (!result.isEmpty()) {
         const auto &match = result.last();
         const auto fields = match.getAll("field");
@@ -1188,33 +1055,13 @@ bool CppDocument::addMethodDefinition(const QString &method, const QString &clas
 {
     LOG("CppDocument::addMethodDefinition", method, className);
 
-    QString definition = method;
-
-    // Remove declaration specific modifiers to make the parameter compatible with addMethodDeclaration
-    const static QStringList modifiers = {"override",    "final",  "virtual", "static",
-                                          "Q_INVOKABLE", "Q_SLOT", "Q_SIGNAL"};
-    for (const auto &modifier : modifiers) {
-        definition.remove(modifier);
-    }
-    definition = definition.simplified();
-
-    // Extract the return type and method name
-    int openParenIdx = definition.indexOf('(');
-    int spaceIdx = definition.lastIndexOf(' ', openParenIdx);
-
-    QString returnType = definition.left(spaceIdx);
-    QString methodName = definition.mid(spaceIdx + 1, openParenIdx - spaceIdx - 1);
-
-    // Construct the method definition
-    QString methodDef = QString("%1 %2::%3").arg(returnType, className, methodName);
-    QString fullBody = body.isEmpty() ? " {}" : QString(" {\n%1\n}").arg(body);
-    methodDef += definition.mid(openParenIdx) + fullBody;
+    const auto methodDef = methodDefinitionText(method, className, body);
 
     QString indent = "\n\n";
 
-    auto lastBracePos = textEdit()->toPlainText().lastIndexOf('}');
+    auto lastBracePos = plainText().lastIndexOf('}');
 
-    QTextCursor cursor = textEdit()->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.beginEditBlock();
 
     cursor.setPosition(lastBracePos + 1);
@@ -1222,11 +1069,11 @@ bool CppDocument::addMethodDefinition(const QString &method, const QString &clas
 
     // Add the method definition
     cursor.insertText(indent + methodDef);
-    auto methodStartPos = textEdit()->toPlainText().lastIndexOf('{');
+    auto methodStartPos = qTextDocument()->toPlainText().lastIndexOf('{');
     cursor.setPosition(methodStartPos + 1); // move to position after opening brace
     cursor.endEditBlock();
 
-    textEdit()->setTextCursor(cursor);
+    setTextCursor(cursor);
     return true;
 }
 
@@ -1271,17 +1118,8 @@ bool CppDocument::addMethod(const QString &declaration, const QString &className
 
 bool CppDocument::addSpecifierSection(const QString &memberText, const QString &className, AccessSpecifier specifier)
 {
-
-    // clang-format off
-    const auto queryString = QString(R"EOF(
-        (field_declaration_list
-            (_)@pos
-        )
-    )EOF");
-    // clang-format on
-
     auto range = queryClassDefinition(className).get("body");
-    auto result = queryInRange(range, queryString);
+    auto result = queryInRange(range, treesitter::builtinQuery("cpp/class_body_children"));
 
     if (!result.isEmpty()) {
         const auto &match = result.last();
@@ -1308,8 +1146,8 @@ bool CppDocument::removeInclude(const QString &include)
 {
     LOG("CppDocument::removeInclude", LOG_ARG("text", include));
 
-    IncludeHelper includeHelper(this);
-    auto line = includeHelper.includePositionForRemoval(include);
+    auto &helper = includeHelper();
+    auto line = helper.includePositionForRemoval(include);
     if (!line) {
         spdlog::error(R"(CppDocument::removeInclude - the include '{}' is malformed, should be '<foo.h>' or '"foo.h"')",
                       include);
@@ -1322,6 +1160,8 @@ bool CppDocument::removeInclude(const QString &include)
     }
 
     deleteLine(line.value());
+    helper.includeRemoved(line.value());
+    m_includeHelperRevision = contentRevision();
     return true;
 }
 
@@ -1545,4 +1385,18 @@ QStringList CppDocument::primitiveTypes() const
     return Utils::cppPrimitiveTypes();
 }
 
+/*!
+ * \qmlmethod ClassEditor CppDocument::editClass(string className)
+ * Returns a `ClassEditor` to add or remove members and methods of the class `className` in one edit.
+ *
+ * Use it instead of multiple calls to `addMember`, `addMethodDeclaration`, `addMethodDefinition` or `deleteMethod`:
+ * the class is looked up once, and the document is only parsed again once all the changes are applied.
+ */
+Core::ClassEditor *CppDocument::editClass(const QString &className)
+{
+    LOG("CppDocument::editClass", className);
+    // No parent, so the JS engine takes the ownership of the editor
+    return new ClassEditor(this, className);
+}
+
 } // namespace Core
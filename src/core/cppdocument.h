@@ -20,6 +20,10 @@
 
 namespace Core {
 
+class BlockHelper;
+class ClassEditor;
+class IncludeHelper;
+
 class CppDocument : public CodeDocument
 {
     Q_OBJECT
@@ -47,9 +51,11 @@ public:
     Q_INVOKABLE Core::QueryMatchList queryMethodDeclaration(const QString &className, const QString &functionName);
     Q_INVOKABLE Core::QueryMatch queryMember(const QString &className, const QString &memberName);
     Q_INVOKABLE Core::QueryMatchList queryMethodDefinition(const QString &scope, const QString &functionName);
+    Q_INVOKABLE Core::QueryMatchList queryMethodDefinitions(const QString &scope, const QStringList &functionNames);
     Q_INVOKABLE Core::QueryMatchList queryFunctionCall(const QString &functionName,
                                                        const QStringList &argumentCaptures);
     Q_INVOKABLE Core::QueryMatchList queryFunctionCall(const QString &functionName);
+    Q_INVOKABLE Core::QueryMatchList queryFunctionCalls(const QStringList &functionNames);
 
     Q_INVOKABLE Core::DataExchange mfcExtractDDX(const QString &className);
     Q_INVOKABLE Core::MessageMap mfcExtractMessageMap(const QString &className = "");
@@ -57,6 +63,8 @@ public:
     Q_INVOKABLE QStringList keywords() const;
     Q_INVOKABLE QStringList primitiveTypes() const;
 
+    Q_INVOKABLE Core::ClassEditor *editClass(const QString &className);
+
     bool changeBaseClass(CppDocument *header, CppDocument *source, const QString &className,
                          const QString &newClassBaseName);
 
@@ -85,6 +93,7 @@ public slots:
     bool addMethod(const QString &declaration, const QString &className, Core::CppDocument::AccessSpecifier specifier,
                    const QString &body = "");
     API_EXECUTOR bool insertInclude(const QString &include, bool newGroup = false);
+    bool insertIncludes(const QStringList &includes, bool newGroup = false);
     API_EXECUTOR bool removeInclude(const QString &include);
     void deleteMethod();
     API_EXECUTOR void deleteMethod(const QString &method, const QString &signature);
@@ -93,7 +102,13 @@ public slots:
     bool changeBaseClass(const QString &className, const QString &newClassBaseName);
 
 private:
-    QVector<Core::QueryMatch> internalQueryFunctionCall(const QString &functionName, const QString &argumentsQuery);
+    IncludeHelper &includeHelper();
+    enum class InsertIncludeResult { Malformed, AlreadyIncluded, Inserted };
+    InsertIncludeResult doInsertInclude(const QString &include, bool newGroup, bool appendToLastGroup = false);
+
+    Core::QueryMatchList internalQueryMethodDefinitions(const QString &scope, const QStringList &functionNames);
+    QVector<Core::QueryMatch> internalQueryFunctionCall(const QStringList &functionNames,
+                                                        const QString &argumentsQuery);
 
     enum class MemberOrMethodAdditionResult { Success, ClassNotFound };
     MemberOrMethodAdditionResult addMemberOrMethod(const QString &memberInfo, const QString &className,
@@ -102,6 +117,7 @@ private:
     void deleteMethodLocal(const QString &methodName, const QString &signature = "");
 
     int moveBlock(int startPos, QTextCursor::MoveOperation direction);
+    const BlockHelper &blockHelper();
 
     bool addSpecifierSection(const QString &memberInfoText, const QString &className,
                              Core::CppDocument::AccessSpecifier specifier);
@@ -112,6 +128,13 @@ private:
     void changeBaseClassForwardInclude(const QString &originalClassBaseName, const QString &newClassBaseName);
 
     friend class IncludeHelper;
+
+    // Includes of the document, up to date as long as m_includeHelperRevision is the current content revision
+    std::unique_ptr<IncludeHelper> m_includeHelper;
+    int m_includeHelperRevision = -1;
+    // Brackets of the document, for the block navigation
+    std::unique_ptr<BlockHelper> m_blockHelper;
+    int m_blockHelperRevision = -1;
 };
 
 } // namespace Core
@@ -10,9 +10,76 @@
 
 #include "cppdocument_p.h"
 #include "cppdocument.h"
+#include "settings.h"
+#include "treesitter/builtinqueries.h"
+
+#include <QFileInfo>
+#include <algorithm>
 
 namespace Core {
 
+bool isHeaderSuffix(const QString &suffix)
+{
+    // Good enough for now, headers starts with h or hpp
+    return suffix.startsWith('h');
+}
+
+static QStringList matchingSuffixes(bool header)
+{
+    const auto mimeTypes = Settings::instance()->value<std::map<std::string, Document::Type>>(Settings::MimeTypes);
+
+    QStringList suffixes;
+    for (const auto &it : mimeTypes) {
+        if (it.second == Document::Type::Cpp) {
+            const QString suffix = QString::fromStdString(it.first);
+            if ((header && !isHeaderSuffix(suffix)) || (!header && isHeaderSuffix(suffix)))
+                suffixes.push_back(suffix);
+        }
+    }
+    return suffixes;
+}
+
+static QStringList candidateFileNames(const QString &baseName, const QStringList &suffixes)
+{
+    QStringList result;
+    result.reserve(suffixes.size());
+    for (const auto &suffix : suffixes)
+        result.push_back(baseName + '.' + suffix);
+    return result;
+}
+
+QStringList correspondingHeaderSourceCandidates(const QString &fileName)
+{
+    const QFileInfo fi(fileName);
+    return candidateFileNames(fi.completeBaseName(), matchingSuffixes(isHeaderSuffix(fi.suffix())));
+}
+
+QString methodDefinitionText(const QString &method, const QString &className, const QString &body)
+{
+    QString definition = method;
+
+    // Remove declaration specific modifiers to make the parameter compatible with addMethodDeclaration
+    const static QStringList modifiers = {"override",    "final",  "virtual", "static",
+                                          "Q_INVOKABLE", "Q_SLOT", "Q_SIGNAL"};
+    for (const auto &modifier : modifiers) {
+        definition.remove(modifier);
+    }
+    definition = definition.simplified();
+
+    // Extract the return type and method name
+    int openParenIdx = definition.indexOf('(');
+    int spaceIdx = definition.lastIndexOf(' ', openParenIdx);
+
+    QString returnType = definition.left(spaceIdx);
+    QString methodName = definition.mid(spaceIdx + 1, openParenIdx - spaceIdx - 1);
+
+    // Construct the method definition
+    QString methodDef = QString("%1 %2::%3").arg(returnType, className, methodName);
+    QString fullBody = body.isEmpty() ? " {}" : QString(" {\n%1\n}").arg(body);
+    methodDef += definition.mid(openParenIdx) + fullBody;
+    return methodDef;
+}
+
 bool IncludeHelper::Include::operator==(const Include &other) const
 {
     return name == other.name && scope == other.scope;
@@ -40,7 +107,6 @@ std::optional<IncludeHelper::IncludePosition> IncludeHelper::includePositionForI
         return {};
 
     // If there are no includes, return the first line
-    computeIncludes();
     if (m_includes.empty())
         return findBestFirstIncludeLine();
 
@@ -53,6 +119,19 @@ std::optional<IncludeHelper::IncludePosition> IncludeHelper::includePositionForI
     return IncludePosition {it->lastLine + 1, false};
 }
 
+std::optional<IncludeHelper::IncludePosition> IncludeHelper::includePositionForAppend(const QString &text)
+{
+    auto include = includeForText(text);
+    if (include.isNull())
+        return {};
+
+    if (m_includes.empty())
+        return findBestFirstIncludeLine();
+    if (findInclude(include) != m_includes.end())
+        return IncludePosition {};
+    return IncludePosition {m_includes.back().line + 1, false};
+}
+
 std::optional<int> IncludeHelper::includePositionForRemoval(const QString &text)
 {
     // Not a well formed include => error
@@ -60,13 +139,84 @@ std::optional<int> IncludeHelper::includePositionForRemoval(const QString &text)
     if (include.isNull())
         return {};
 
-    computeIncludes();
     auto it = findInclude(include);
     if (it == m_includes.end())
         return -1;
     return it->line;
 }
 
+void IncludeHelper::includeInserted(const QString &text, const IncludePosition &position)
+{
+    auto include = includeForText(text);
+    // A new group is separated from the previous one by an empty line
+    const int insertedLines = position.newGroup ? 2 : 1;
+    include.line = position.line + insertedLines - 1;
+
+    auto it = std::ranges::find_if(m_includes, [&position](const auto &include) {
+        return include.line >= position.line;
+    });
+    const auto index = static_cast<int>(std::distance(m_includes.begin(), it));
+    for (auto shiftIt = it; shiftIt != m_includes.end(); ++shiftIt)
+        shiftIt->line += insertedLines;
+    m_includes.insert(it, include);
+
+    bool inserted = false;
+    for (auto groupIt = m_includeGroups.begin(); groupIt != m_includeGroups.end(); ++groupIt) {
+        if (!position.newGroup && groupIt->lastLine == position.line - 1) {
+            groupIt->last = index;
+            inserted = true;
+        } else if (groupIt->first >= index) {
+            if (position.newGroup && !inserted) {
+                groupIt = m_includeGroups.insert(groupIt, IncludeGroup {.first = index, .last = index});
+                updateGroup(*groupIt);
+                inserted = true;
+                continue;
+            }
+            ++groupIt->first;
+            ++groupIt->last;
+        }
+        updateGroup(*groupIt);
+    }
+    if (!inserted && position.newGroup) {
+        m_includeGroups.push_back(IncludeGroup {.first = index, .last = index});
+        updateGroup(m_includeGroups.back());
+        inserted = true;
+    }
+
+    // Should not happen, but the document has already been updated, so it's always possible to start from scratch
+    if (!inserted)
+        computeIncludes();
+}
+
+void IncludeHelper::includeRemoved(int line)
+{
+    auto it = std::ranges::find(m_includes, line, &Include::line);
+    if (it == m_includes.end()) {
+        computeIncludes();
+        return;
+    }
+
+    const auto index = static_cast<int>(std::distance(m_includes.begin(), it));
+    it = m_includes.erase(it);
+    for (; it != m_includes.end(); ++it)
+        --it->line;
+
+    for (auto groupIt = m_includeGroups.begin(); groupIt != m_includeGroups.end();) {
+        if (groupIt->first > index) {
+            --groupIt->first;
+            --groupIt->last;
+        } else if (groupIt->last >= index) {
+            --groupIt->last;
+            if (groupIt->last < groupIt->first) {
+                groupIt = m_includeGroups.erase(groupIt);
+                continue;
+            }
+        }
+        updateGroup(*groupIt);
+        ++groupIt;
+    }
+}
+
 IncludeHelper::Include IncludeHelper::includeForText(const QString &text) const
 {
     if ((!text.startsWith('<') || !text.endsWith('>')) && (!text.startsWith('"') || !text.endsWith('"')))
@@ -103,10 +253,10 @@ IncludeHelper::IncludePosition IncludeHelper::findBestFirstIncludeLine() const
         return IncludePosition {1, false};
 
     // Find `#pragma once`
-    auto result = m_document->query(Queries::findPragma);
+    auto result = m_document->query(treesitter::builtinQuery("cpp/find_pragma"));
     if (result.isEmpty()) {
         // Find `#ifndef / #define`
-        result = m_document->query(Queries::findHeaderGuard);
+        result = m_document->query(treesitter::builtinQuery("cpp/find_header_guard"));
         if (result.isEmpty())
             return IncludePosition {1, false};
     }
@@ -123,7 +273,10 @@ IncludeHelper::IncludePosition IncludeHelper::findBestFirstIncludeLine() const
 
 void IncludeHelper::computeIncludes()
 {
-    const auto results = m_document->query(Queries::findInclude);
+    m_includes.clear();
+    m_includeGroups.clear();
+
+    const auto results = m_document->query(treesitter::builtinQuery("cpp/find_include"));
 
     // Extract all includes
     int lastLine = -1;
@@ -147,17 +300,77 @@ void IncludeHelper::computeIncludes()
         lastLine = line;
     }
 
-    // Find common denominator in groups
-    auto processGroup = [this](IncludeGroup &group) {
-        group.prefix = m_includes.at(group.first).name;
-        for (int i = group.first; i <= group.last; ++i) {
-            const auto &[name, scope, line] = m_includes.at(i);
-            group.scope |= scope;
-            group.prefix = getCommonPrefix(group.prefix, name).toString();
-        }
-    };
     for (auto &group : m_includeGroups)
-        processGroup(group);
+        updateGroup(group);
+}
+
+// Find common denominator in the group
+void IncludeHelper::updateGroup(IncludeGroup &group) const
+{
+    group.lastLine = m_includes.at(group.last).line;
+    group.prefix = m_includes.at(group.first).name;
+    group.scope = 0;
+    for (int i = group.first; i <= group.last; ++i) {
+        const auto &[name, scope, line] = m_includes.at(i);
+        group.scope |= scope;
+        group.prefix = getCommonPrefix(group.prefix, name).toString();
+    }
+}
+
+BlockHelper::BlockHelper(const QString &text)
+    : m_size(static_cast<int>(text.size()))
+{
+    int depth = 0;
+    for (int i = 0; i < m_size; ++i) {
+        const auto c = text.at(i);
+        if (c == '(' || c == '{' || c == '[') {
+            m_openings[depth].push_back(i);
+            ++depth;
+        } else if (c == ')' || c == '}' || c == ']') {
+            m_closings[depth].push_back(i);
+            --depth;
+        } else {
+            continue;
+        }
+        m_brackets.push_back(i);
+        m_depths.push_back(depth);
+    }
+}
+
+int BlockHelper::depthAt(int position) const
+{
+    const auto it = std::ranges::lower_bound(m_brackets, position);
+    if (it == m_brackets.begin())
+        return 0;
+    return m_depths.at(std::distance(m_brackets.begin(), it) - 1);
+}
+
+int BlockHelper::blockEnd(int from) const
+{
+    if (from < 0 || from >= m_size)
+        return -1;
+    // The end of the block is the first closing bracket after `from` going back to the depth of `from`
+    const auto it = m_closings.find(depthAt(from));
+    if (it == m_closings.end())
+        return -1;
+    const auto closing = std::ranges::lower_bound(it->second, from);
+    return closing == it->second.end() ? -1 : *closing + 1;
+}
+
+int BlockHelper::blockStart(int from) const
+{
+    if (from <= 0 || from >= m_size)
+        return -1;
+    // The start of the block is the last opening bracket before `from` leaving the depth of `from`
+    const auto it = m_openings.find(depthAt(from + 1) - 1);
+    if (it == m_openings.end())
+        return -1;
+    auto opening = std::ranges::upper_bound(it->second, from);
+    if (opening == it->second.begin())
+        return -1;
+    --opening;
+    // The first character of the text is never checked, see CppDocument::moveBlock
+    return *opening > 0 ? *opening : -1;
 }
 
 }
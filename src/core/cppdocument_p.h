@@ -14,6 +14,7 @@
 
 #include <map>
 #include <optional>
+#include <unordered_map>
 #include <vector>
 
 namespace Core {
@@ -28,36 +29,19 @@ struct ToggleSectionSettings
     std::map<std::string, std::string> return_values;
 };
 
-namespace Queries {
-    constexpr char findInclude[] = R"EOF(
-        (preproc_include
-            path: (_) @path
-        )
-    )EOF";
-
-    constexpr char findPragma[] = R"EOF(
-        (translation_unit
-            (preproc_call
-                argument: (_) @value (#match? "once" @value)
-            )
-        )
-    )EOF";
-
-    constexpr char findHeaderGuard[] = R"EOF(
-        (translation_unit
-            (preproc_ifdef
-                "#ifndef"
-                name: (_) @name
-                (preproc_def
-                    name: (_) @value (#eq? @name @value)
-                )
-            )
-        )
-    )EOF";
-};
-
 NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(ToggleSectionSettings, tag, debug, return_values);
 
+/**
+ * Returns the text of the definition of `method` in the class `className`, as used by addMethodDefinition.
+ * The `method` is the declaration, without the modifiers specific to the declaration.
+ */
+QString methodDefinitionText(const QString &method, const QString &className, const QString &body);
+
+// Returns true if `suffix` is the suffix of a C++ header file
+bool isHeaderSuffix(const QString &suffix);
+// Returns the file names of the possible header or source file corresponding to `fileName`, without their paths
+QStringList correspondingHeaderSourceCandidates(const QString &fileName);
+
 class IncludeHelper
 {
 public:
@@ -75,12 +59,26 @@ public:
      * If addNewGroup is true when calling the method, it will add the include at the end
      */
     std::optional<IncludePosition> includePositionForInsertion(const QString &text, bool addNewGroup);
+    /**
+     * Returns the line the new include should be inserted to be added at the end of the last group.
+     */
+    std::optional<IncludePosition> includePositionForAppend(const QString &text);
 
     /**
      * Returns the line (1-based) the include should be removed.
      */
     std::optional<int> includePositionForRemoval(const QString &text);
 
+    /**
+     * Updates the includes after `text` has been inserted at `position`, as returned by includePositionForInsertion.
+     * This avoids parsing the includes again when inserting multiple includes.
+     */
+    void includeInserted(const QString &text, const IncludePosition &position);
+    /**
+     * Updates the includes after the include at `line` (1-based) has been removed.
+     */
+    void includeRemoved(int line);
+
 private:
     struct Include
     {
@@ -128,10 +126,43 @@ private:
      * Compute all includes and include groups in the file
      */
     void computeIncludes();
+    /**
+     * Update the line, prefix and scope of the group, based on its includes
+     */
+    void updateGroup(IncludeGroup &group) const;
 
     CppDocument *const m_document;
     Includes m_includes;
     IncludeGroups m_includeGroups;
 };
 
+/**
+ * \brief Brackets of a text, to find the start or end of a block without scanning the text
+ *
+ * A block is defined by {} or () or [], the kind of bracket is not checked. The brackets are grouped by nesting depth,
+ * so finding the other side of a block is a binary search.
+ */
+class BlockHelper
+{
+public:
+    explicit BlockHelper(const QString &text);
+
+    // Returns the position after the closing bracket of the block containing `from`, or -1 if there is none
+    int blockEnd(int from) const;
+    // Returns the position of the opening bracket of the block containing `from`, or -1 if there is none
+    int blockStart(int from) const;
+
+private:
+    // Nesting depth at `position`, before the character at this position
+    int depthAt(int position) const;
+
+    int m_size = 0;
+    // Positions of all the brackets, with the nesting depth after each of them
+    std::vector<int> m_brackets;
+    std::vector<int> m_depths;
+    // Positions of the opening and closing brackets, by nesting depth before the bracket
+    std::unordered_map<int, std::vector<int>> m_openings;
+    std::unordered_map<int, std::vector<int>> m_closings;
+};
+
 } // namespace Core
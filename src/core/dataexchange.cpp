@@ -10,6 +10,7 @@
 
 #include "dataexchange.h"
 #include "querymatch.h"
+#include "treesitter/builtinqueries.h"
 
 #include <kdalgorithms.h>
 
@@ -60,16 +61,7 @@ static DataExchangeEntry fromDDX(const QueryMatch &ddxCall)
 
 static QVector<DataExchangeEntry> queryDDXCalls(const QueryMatch &ddxFunction)
 {
-    const auto ddxCalls = ddxFunction.queryIn("body", R"EOF(
-                (expression_statement
-                    (call_expression
-                        function: (identifier) @ddx-function(#match? "^DDX_" @ddx-function)
-                        arguments: (argument_list
-                            (_)* "," ; The CDataExchange* pDX argument
-                            (_)* @ddx-idc ","
-                            (_)* @ddx-member
-                            (#exclude! @ddx-idc @ddx-member comment)))) @ddx
-    )EOF");
+    const auto ddxCalls = ddxFunction.queryIn("body", treesitter::builtinQuery("cpp/ddx_calls"));
 
     return kdalgorithms::transformed(ddxCalls, fromDDX);
 }
@@ -85,16 +77,7 @@ static DataValidationEntry fromDDV(const QueryMatch &ddvCall)
 
 static QVector<DataValidationEntry> queryDDVCalls(const QueryMatch &ddxFunction)
 {
-    const auto ddvCalls = ddxFunction.queryIn("body", R"EOF(
-                (expression_statement
-                    (call_expression
-                        function: (identifier) @ddv-function(#match? "^DDV_" @ddv-function)
-                        arguments: (argument_list
-                            (_)* ","
-                            (_)* @ddv-member ","
-                            ((_) ","?)* @ddv-arguments
-                            (#exclude! @ddv-arguments @ddv-member comment)))) @ddv
-    )EOF");
+    const auto ddvCalls = ddxFunction.queryIn("body", treesitter::builtinQuery("cpp/ddv_calls"));
 
     return kdalgorithms::transformed(ddvCalls, fromDDV);
 }
@@ -170,6 +170,17 @@ QString Dir::cleanPath(const QString &path)
     return QDir::cleanPath(path);
 }
 
+/*!
+ * \qmlmethod array<string> Dir::glob(string pattern)
+ * Returns all files and directories matching the glob `pattern`, relative to the current path if the pattern is
+ * relative. See `QDirValueType::glob` for the syntax.
+ */
+QStringList Dir::glob(const QString &pattern)
+{
+    LOG("Dir::glob", pattern);
+    return QDirValueType(QDir::currentPath()).glob(pattern);
+}
+
 /*!
  * \qmlmethod QDirValueType Dir::create(string path)
  */
@@ -31,6 +31,9 @@ public:
     explicit Dir(QString currentScriptPath, QObject *parent = nullptr);
     ~Dir() override;
 
+    // Used when the script engine is reused for another script
+    void setCurrentScriptPath(const QString &path) { m_currentScriptPath = path; }
+
     enum Filter {
         Dirs = QDir::Dirs,
         Files = QDir::Files,
@@ -102,6 +105,8 @@ public slots:
 
     static QString cleanPath(const QString &path);
 
+    static QStringList glob(const QString &pattern);
+
     static Core::QDirValueType create(const QString &path);
 
 signals:
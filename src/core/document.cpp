@@ -11,6 +11,7 @@
 #include "document.h"
 #include "logger.h"
 #include "utils/log.h"
+#include "utils/tracing.h"
 
 #include <QApplication>
 #include <QFileInfo>
@@ -105,6 +106,12 @@ void Document::setErrorString(const QString &error)
 Document::ConflictResolution Document::resolveConflictsOnSave() const
 {
     const QFileInfo fi(m_fileName);
+    if (!qobject_cast<QApplication *>(QCoreApplication::instance())) {
+        // Nobody can be asked with knut-cli, don't lose the changes done outside of Knut
+        spdlog::warn("Document::save - {} has been changed externally, keeping the changes on the disk",
+                     m_fileName);
+        return Core::Document::KeepDiskChanges;
+    }
     const auto result = QMessageBox::question(
         QApplication::activeWindow(), tr("File changed externally"),
         tr("%1\n\nThe file has unsaved changes inside this editor and has been changed externally.\n"
@@ -124,17 +131,57 @@ bool Document::hasChangedOnDisk() const
         return false;
 
     // Don't update if it was saved by Knut
-    if (const QFileInfo fi(m_fileName); fi.lastModified() == m_lastModified)
+    if (const QFileInfo fi(m_fileName); fi.lastModified() == m_lastModified && fi.size() == m_fileSize)
         return false;
     return true;
 }
 
-void Document::reload()
+void Document::updateDiskInfo()
 {
-    doLoad(m_fileName);
     const QFileInfo fi(m_fileName);
     m_lastModified = fi.lastModified();
+    m_fileSize = fi.size();
+}
+
+QVariantMap Document::memoryUsage() const
+{
+    return {};
+}
+
+void Document::evict()
+{
+    if (m_fileName.isEmpty() || m_hasChanged)
+        return;
+    doEvict();
+}
+
+void Document::reload()
+{
+    // Not an API call, so there is no LOG zone for it
+    KNUT_TRACE_SCOPE("Document::reload");
+    doLoad(m_fileName);
+    updateDiskInfo();
+    emit fileUpdated();
+}
+
+// The size and modification time are checked first, the content is only read if one of them has changed.
+// Documents with unsaved changes are not refreshed.
+bool Document::refresh()
+{
+    if (m_hasChanged || !hasChangedOnDisk())
+        return false;
+
+    KNUT_TRACE_SCOPE("Document::refresh");
+    const bool contentChanged = doRefresh();
+    updateDiskInfo();
+    return contentChanged;
+}
+
+bool Document::doRefresh()
+{
+    doLoad(m_fileName);
     emit fileUpdated();
+    return true;
 }
 
 /*!
@@ -155,8 +202,7 @@ bool Document::load(const QString &fileName)
     close();
     const bool loadDone = doLoad(fileName);
     m_fileName = fileName;
-    const QFileInfo fi(m_fileName);
-    m_lastModified = fi.lastModified();
+    updateDiskInfo();
 
     didOpen();
     emit fileNameChanged();
@@ -204,8 +250,8 @@ bool Document::saveAs(const QString &fileName)
         setHasChanged(false);
         if (isNewName)
             didOpen();
-        const QFileInfo fi(m_fileName);
-        m_lastModified = fi.lastModified();
+        updateDiskInfo();
+        emit saved();
     }
     return saveDone;
 }
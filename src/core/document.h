@@ -14,6 +14,7 @@
 
 #include <QDateTime>
 #include <QObject>
+#include <QVariantMap>
 
 namespace Core {
 
@@ -56,6 +57,17 @@ public:
 
     bool hasChangedOnDisk() const;
     void reload();
+    // Reloads the document if its content has changed on disk, returns true if it has
+    bool refresh();
+
+    // Returns the memory used by the document in bytes, per part (text, marks, tree...), used by
+    // Project::memoryReport. Most values are estimates, only the tree-sitter and pugixml ones are measured.
+    virtual QVariantMap memoryUsage() const;
+
+    // Drops what can be computed again from the text (syntax tree, symbols, hidden editor...), and closes the document
+    // on the language server. Used by the project to limit the memory used by the documents not modified.
+    // The document stays usable, everything is computed again when needed. Does nothing if the document has changed.
+    void evict();
 
 public slots:
     bool load(const QString &fileName);
@@ -69,6 +81,8 @@ signals:
     void errorStringChanged();
     void hasChangedChanged();
     void fileUpdated();
+    // Emitted each time the document is written to disk
+    void saved();
 
 protected:
     virtual bool doSave(const QString &fileName) = 0;
@@ -76,6 +90,9 @@ protected:
 
     virtual void didOpen() { }
     virtual void didClose() { }
+    virtual void doEvict() { }
+    // Loads the new content of the file, returns false if it's the same as the document. Default is a full reload.
+    virtual bool doRefresh();
 
     void setHasChanged(bool newHasChanged);
     void setErrorString(const QString &error);
@@ -89,8 +106,11 @@ private:
     QString m_errorString;
     bool m_hasChanged = false;
 
+    void updateDiskInfo();
+
     // Members used for refreshing file after external changes
     QDateTime m_lastModified;
+    qint64 m_fileSize = -1;
 };
 
 NLOHMANN_JSON_SERIALIZE_ENUM(Document::Type,
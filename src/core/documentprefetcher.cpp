@@ -0,0 +1,97 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+
+#include "documentprefetcher.h"
+#include "treesitter/parserpool.h"
+#include "utils/memoryaccounting.h"
+#include "utils/metrics.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QStringDecoder>
+#include <QtConcurrent/QtConcurrentRun>
+#include <algorithm>
+#include <ranges>
+#include <spdlog/spdlog.h>
+
+namespace Core {
+
+// Runs on a worker thread, must not access any document or the settings
+static DocumentPrefetcher::File loadFile(const QString &fileName, const TSLanguage *language, int parseTimeout)
+{
+    DocumentPrefetcher::File result;
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        spdlog::warn("Project::prefetch - can't read file {}: {}", fileName, file.errorString());
+        return result;
+    }
+    result.lastModified = QFileInfo(file).lastModified();
+    result.data = file.readAll();
+    if (!language)
+        return result;
+
+    // Same decoding and normalization as TextDocument::doLoad, so the tree matches the text of the document
+    QStringDecoder decoder(QStringDecoder::encodingForData(result.data).value_or(QStringDecoder::Utf8));
+    result.text = decoder.decode(result.data);
+    result.text.replace("\r\n", "\n");
+    result.text.replace('\r', '\n');
+    result.text.replace(QChar::Nbsp, ' ');
+
+    auto parser = treesitter::ParserPool::instance().acquire(language);
+    parser->setTimeout(std::chrono::milliseconds(parseTimeout));
+    const Utils::AllocationScope allocations(Utils::MemoryAccounting::TreeSitter);
+    result.tree = parser->parseString(result.text);
+    result.treeBytes = result.tree ? std::max<int64_t>(0, allocations.bytes()) : 0;
+    return result;
+}
+
+DocumentPrefetcher::~DocumentPrefetcher()
+{
+    clear();
+}
+
+void DocumentPrefetcher::prefetch(const QString &key, const QString &fileName, const TSLanguage *language,
+                                  int parseTimeout)
+{
+    if (m_files.contains(key))
+        return;
+    m_files.emplace(key, QtConcurrent::run(loadFile, fileName, language, parseTimeout));
+}
+
+bool DocumentPrefetcher::contains(const QString &key) const
+{
+    return m_files.contains(key);
+}
+
+std::optional<DocumentPrefetcher::File> DocumentPrefetcher::take(const QString &key, const QString &fileName)
+{
+    auto it = m_files.find(key);
+    if (it == m_files.end())
+        return {};
+
+    static auto &hits = Utils::Metrics::counter("project.prefetch_hits");
+    auto future = std::move(it->second);
+    m_files.erase(it);
+    auto file = future.takeResult();
+    if (file.lastModified.isNull() || file.lastModified != QFileInfo(fileName).lastModified())
+        return {};
+    hits.add();
+    return file;
+}
+
+void DocumentPrefetcher::clear()
+{
+    for (auto &future : m_files | std::views::values)
+        future.waitForFinished();
+    m_files.clear();
+}
+
+} // namespace Core
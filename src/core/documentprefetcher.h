@@ -0,0 +1,65 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+
+#pragma once
+
+#include "treesitter/tree.h"
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QFuture>
+#include <QString>
+#include <optional>
+#include <unordered_map>
+
+struct TSLanguage;
+
+namespace Core {
+
+/**
+ * \brief Loads files in the background, before their documents are opened
+ *
+ * Each file is read, decoded and parsed with tree-sitter (if it has a grammar) on a thread of the global thread pool.
+ * The result is taken by the project when the document is opened, so it doesn't have to read or parse it itself.
+ */
+class DocumentPrefetcher
+{
+public:
+    struct File
+    {
+        // Content of the file, as read from the disk
+        QByteArray data;
+        // Decoded text, normalized like the text of a TextDocument
+        QString text;
+        QDateTime lastModified;
+        // Syntax tree of `text`, if the file has a grammar and the parse succeeded
+        std::optional<treesitter::Tree> tree;
+        // Memory allocated by tree-sitter for the tree
+        int64_t treeBytes = 0;
+    };
+
+    ~DocumentPrefetcher();
+
+    // Starts loading `fileName` in the background, `language` may be nullptr to skip the parse.
+    // The parse timeout is in milliseconds, 0 means no limit.
+    void prefetch(const QString &key, const QString &fileName, const TSLanguage *language, int parseTimeout);
+    bool contains(const QString &key) const;
+    // Returns the prefetched file, waiting for it if it's still loading. Returns nullopt if the file wasn't prefetched,
+    // or if it changed on the disk since.
+    std::optional<File> take(const QString &key, const QString &fileName);
+    // Waits for the pending loads, and discards all prefetched files
+    void clear();
+
+private:
+    std::unordered_map<QString, QFuture<File>> m_files;
+};
+
+} // namespace Core
@@ -12,7 +12,10 @@
 #include "logger.h"
 
 #include <QFile>
+#include <QRegularExpression>
 #include <QTextStream>
+#include <QtConcurrent/QtConcurrentMap>
+#include <spdlog/spdlog.h>
 
 namespace Core {
 
@@ -79,12 +82,8 @@ bool File::touch(const QString &fileName)
     return file.open(QFile::Append);
 }
 
-/*!
- * \qmlmethod string File::readAll(string fileName)
- */
-QString File::readAll(const QString &fileName)
+static QString readFile(const QString &fileName)
 {
-    LOG("File::readAll", fileName);
     QFile file(fileName);
     if (file.open(QFile::ReadOnly | QIODevice::Text)) {
         QTextStream stream(&file);
@@ -93,4 +92,111 @@ QString File::readAll(const QString &fileName)
     return {};
 }
 
+/*!
+ * \qmlmethod string File::readAll(string fileName)
+ */
+QString File::readAll(const QString &fileName)
+{
+    LOG("File::readAll", fileName);
+    return readFile(fileName);
+}
+
+/*!
+ * \qmlmethod array<string> File::readAllBatch(array<string> fileNames)
+ * Returns the content of all files in `fileNames`, in the same order. The files are read in parallel, a file that
+ * can't be read returns an empty string.
+ */
+QStringList File::readAllBatch(const QStringList &fileNames)
+{
+    LOG("File::readAllBatch", fileNames);
+    return QtConcurrent::blockingMapped<QStringList>(fileNames, readFile);
+}
+
+/*!
+ * \qmlmethod LineIterator File::readLines(string fileName)
+ * Returns an iterator on the lines of the file `fileName`, reading the file as the lines are requested.
+ * \sa LineIterator
+ */
+Core::LineIterator *File::readLines(const QString &fileName)
+{
+    LOG("File::readLines", fileName);
+    return new LineIterator(fileName);
+}
+
+namespace {
+
+struct GrepHit
+{
+    int line;
+    int column;
+    QString text;
+};
+
+// Returns the lines of `text` matching `regexp`, only the first match of each line is returned
+QList<GrepHit> grepText(const QString &text, const QRegularExpression &regexp)
+{
+    QList<GrepHit> hits;
+    qsizetype lineStart = 0;
+    int line = 1;
+    while (lineStart <= text.size()) {
+        const auto match = regexp.match(text, lineStart);
+        if (!match.hasMatch())
+            break;
+        const auto start = match.capturedStart();
+        for (auto i = lineStart; i < start; ++i) {
+            if (text.at(i) == '\n') {
+                ++line;
+                lineStart = i + 1;
+            }
+        }
+        auto lineEnd = text.indexOf('\n', start);
+        if (lineEnd == -1)
+            lineEnd = text.size();
+        hits.push_back({line, static_cast<int>(start - lineStart + 1), text.mid(lineStart, lineEnd - lineStart)});
+        ++line;
+        lineStart = lineEnd + 1;
+    }
+    return hits;
+}
+
+} // namespace
+
+/*!
+ * \qmlmethod array<object> File::grep(array<string> fileNames, string pattern)
+ * Returns the lines matching the regular expression `pattern` in all files of `fileNames`. Each hit is an object with
+ * the `file`, `line` and `column` (both starting at 1) of the match, and the `text` of the line. Only the first match
+ * of each line is returned.
+ *
+ * The files are read and searched in parallel, only the hits are returned to the script:
+ *
+ * ```js
+ * for (const hit of File.grep(Project.allFilesWithExtensions(["h", "cpp"], Project.FullPath), "\\bCString\\b"))
+ *     Message.log(`${hit.file}:${hit.line}: ${hit.text}`)
+ * ```
+ */
+QVariantList File::grep(const QStringList &fileNames, const QString &pattern)
+{
+    LOG("File::grep", fileNames, pattern);
+
+    const QRegularExpression regexp(pattern, QRegularExpression::MultilineOption);
+    if (!regexp.isValid()) {
+        spdlog::error("File::grep - invalid regular expression {}: {}", pattern, regexp.errorString());
+        return {};
+    }
+
+    const auto hitsPerFile =
+        QtConcurrent::blockingMapped<QList<QList<GrepHit>>>(fileNames, [&regexp](const QString &fileName) {
+            return grepText(readFile(fileName), regexp);
+        });
+
+    QVariantList result;
+    for (int i = 0; i < fileNames.size(); ++i) {
+        for (const auto &hit : hitsPerFile.at(i)) {
+            result.push_back(QVariantMap {
+                {"file", fileNames.at(i)}, {"line", hit.line}, {"column", hit.column}, {"text", hit.text}});
+        }
+    }
+    return result;
+}
+
 } // namespace Core
@@ -10,7 +10,10 @@
 
 #pragma once
 
+#include "lineiterator.h"
+
 #include <QObject>
+#include <QVariant>
 
 namespace Core {
 
@@ -31,6 +34,10 @@ public slots:
     static bool touch(const QString &fileName);
 
     static QString readAll(const QString &fileName);
+    static QStringList readAllBatch(const QStringList &fileNames);
+    static Core::LineIterator *readLines(const QString &fileName);
+
+    static QVariantList grep(const QStringList &fileNames, const QString &pattern);
 };
 
 } // namespace Core
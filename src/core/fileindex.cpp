@@ -0,0 +1,316 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "fileindex.h"
+#include "parallelscriptrunner.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QProcess>
+#include <QtConcurrent/QtConcurrentFilter>
+#include <QtConcurrent/QtConcurrentMap>
+#include <algorithm>
+#include <spdlog/spdlog.h>
+
+namespace Core {
+
+// Delay after a modification during which a directory may still change without any change to its modification time
+constexpr int ModificationTimeResolution = 1000;
+// Maximum duration of the git command listing the ignored files
+constexpr int GitTimeout = 30000;
+
+void FileIndex::setRoot(const QString &root)
+{
+    if (m_root == root)
+        return;
+    m_root = root;
+    m_gitIgnored.clear();
+    m_directories.clear();
+    m_listsOutdated = true;
+}
+
+const QString &FileIndex::root() const
+{
+    return m_root;
+}
+
+void FileIndex::setExcludes(const QStringList &patterns)
+{
+    if (m_excludePatterns == patterns)
+        return;
+    m_excludePatterns = patterns;
+
+    m_excludes.clear();
+    for (auto pattern : patterns) {
+        pattern = QDir::fromNativeSeparators(pattern.trimmed());
+        if (pattern.isEmpty())
+            continue;
+        Exclude exclude;
+        if (pattern.endsWith('/')) {
+            exclude.directoryOnly = true;
+            pattern.chop(1);
+        }
+        exclude.matchPath = pattern.contains('/');
+        if (pattern.startsWith('/'))
+            pattern.remove(0, 1);
+        exclude.regexp = ParallelScriptRunner::globToRegularExpression(pattern);
+        m_excludes.push_back(exclude);
+    }
+    m_directories.clear();
+    m_listsOutdated = true;
+}
+
+void FileIndex::setUseGitIgnore(bool useGitIgnore)
+{
+    if (m_useGitIgnore == useGitIgnore)
+        return;
+    m_useGitIgnore = useGitIgnore;
+    m_gitIgnored.clear();
+    m_directories.clear();
+    m_listsOutdated = true;
+}
+
+// `path` is relative to the root
+bool FileIndex::isExcluded(const QString &path, const QString &fileName, bool isDirectory) const
+{
+    if (m_gitIgnored.contains(path))
+        return true;
+    return std::ranges::any_of(m_excludes, [&](const Exclude &exclude) {
+        if (exclude.directoryOnly && !isDirectory)
+            return false;
+        return exclude.regexp.match(exclude.matchPath ? path : fileName).hasMatch();
+    });
+}
+
+// Git lists the ignored directories without their content, so it's fast even with large build directories
+void FileIndex::updateGitIgnored()
+{
+    m_gitIgnored.clear();
+    if (!m_useGitIgnore)
+        return;
+
+    QProcess git;
+    git.setWorkingDirectory(m_root);
+    git.start("git", {"ls-files", "--others", "--ignored", "--exclude-standard", "--directory", "-z"});
+    if (!git.waitForFinished(GitTimeout) || git.exitStatus() != QProcess::NormalExit || git.exitCode() != 0) {
+        spdlog::warn("FileIndex::updateGitIgnored - can't get the files ignored by git in {}", m_root);
+        // Don't try again on each update, the root is most likely not in a git work tree
+        m_useGitIgnore = false;
+        return;
+    }
+
+    // Paths are relative to the working directory, and directories end with a slash
+    const auto paths = git.readAllStandardOutput().split('\0');
+    for (const auto &path : paths) {
+        if (path.isEmpty())
+            continue;
+        QString ignored = QString::fromUtf8(path);
+        if (ignored.endsWith('/'))
+            ignored.chop(1);
+        m_gitIgnored.insert(ignored);
+    }
+}
+
+FileIndex::Directory FileIndex::scanDirectory(const QString &path) const
+{
+    Directory directory;
+    const QFileInfo dirInfo(path);
+    directory.lastModified = dirInfo.lastModified();
+
+    directory.mayBeOutdated =
+        directory.lastModified.msecsTo(QDateTime::currentDateTime()) < ModificationTimeResolution;
+
+    const QString prefix = path.size() > m_root.size() ? path.mid(m_root.size() + 1) + '/' : QString();
+    // Hidden files and directories are not listed, as QDir::Hidden is not set
+    const auto entries = QDir(path).entryInfoList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const auto &fi : entries) {
+        if (isExcluded(prefix + fi.fileName(), fi.fileName(), fi.isDir()))
+            continue;
+        if (fi.isDir()) {
+            if (!fi.isSymLink())
+                directory.subdirectories.push_back(fi.fileName());
+        } else {
+            directory.files.push_back(fi.fileName());
+        }
+    }
+    return directory;
+}
+
+FileIndex::Directories FileIndex::scanTree(const QString &path) const
+{
+    Directories directories;
+    QStringList toScan {path};
+    while (!toScan.isEmpty()) {
+        const QString current = toScan.takeLast();
+        auto directory = scanDirectory(current);
+        for (const auto &subdirectory : std::as_const(directory.subdirectories))
+            toScan.push_back(current + '/' + subdirectory);
+        directories.emplace(current, std::move(directory));
+    }
+    return directories;
+}
+
+void FileIndex::removeTree(const QString &path)
+{
+    auto it = m_directories.find(path);
+    if (it == m_directories.end())
+        return;
+    const auto subdirectories = it->second.subdirectories;
+    m_directories.erase(it);
+    for (const auto &subdirectory : subdirectories)
+        removeTree(path + '/' + subdirectory);
+}
+
+void FileIndex::update()
+{
+    if (m_root.isEmpty())
+        return;
+
+    if (m_directories.empty()) {
+        updateGitIgnored();
+        // Initial scan, done in parallel for each top-level directory
+        auto rootDirectory = scanDirectory(m_root);
+        QStringList paths;
+        for (const auto &subdirectory : std::as_const(rootDirectory.subdirectories))
+            paths.push_back(m_root + '/' + subdirectory);
+        const auto trees = QtConcurrent::blockingMapped<QVector<Directories>>(paths, [this](const QString &path) {
+            return scanTree(path);
+        });
+        m_directories.emplace(m_root, std::move(rootDirectory));
+        for (const auto &tree : trees)
+            m_directories.insert(tree.cbegin(), tree.cend());
+        m_listsOutdated = true;
+        return;
+    }
+
+    // Adding or removing a directory entry changes the modification time of the directory
+    QStringList paths;
+    paths.reserve(m_directories.size());
+    for (const auto &[path, directory] : m_directories)
+        paths.push_back(path);
+    const auto changedPaths = QtConcurrent::blockingFiltered(paths, [this](const QString &path) {
+        const auto &directory = m_directories.at(path);
+        return directory.mayBeOutdated || QFileInfo(path).lastModified() != directory.lastModified;
+    });
+    // New files or directories may be ignored
+    if (!changedPaths.isEmpty() && m_useGitIgnore)
+        updateGitIgnored();
+
+    for (const auto &path : changedPaths) {
+        auto it = m_directories.find(path);
+        // May have been removed with its parent
+        if (it == m_directories.end())
+            continue;
+        if (!QFileInfo(path).isDir()) {
+            removeTree(path);
+            m_listsOutdated = true;
+            continue;
+        }
+
+        auto directory = scanDirectory(path);
+        if (directory.files == it->second.files && directory.subdirectories == it->second.subdirectories) {
+            it->second = std::move(directory);
+            continue;
+        }
+        m_listsOutdated = true;
+
+        const auto oldSubdirectories = it->second.subdirectories;
+        for (const auto &subdirectory : oldSubdirectories) {
+            if (!directory.subdirectories.contains(subdirectory))
+                removeTree(path + '/' + subdirectory);
+        }
+        for (const auto &subdirectory : std::as_const(directory.subdirectories)) {
+            if (!oldSubdirectories.contains(subdirectory))
+                m_directories.merge(scanTree(path + '/' + subdirectory));
+        }
+        m_directories[path] = std::move(directory);
+    }
+}
+
+void FileIndex::rebuildLists()
+{
+    m_files.clear();
+    m_filesBySuffix.clear();
+    m_filesByName.clear();
+
+    for (const auto &[path, directory] : m_directories) {
+        for (const auto &fileName : directory.files) {
+            const QString filePath = path + '/' + fileName;
+            m_files.push_back(filePath);
+            m_filesBySuffix[QFileInfo(fileName).suffix().toLower()].push_back(filePath);
+            m_filesByName[fileName.toLower()].push_back(filePath);
+        }
+    }
+    std::ranges::sort(m_files);
+    for (auto &files : m_filesBySuffix | std::views::values)
+        std::ranges::sort(files);
+    for (auto &files : m_filesByName | std::views::values)
+        std::ranges::sort(files);
+
+    m_listsOutdated = false;
+}
+
+const QStringList &FileIndex::files()
+{
+    update();
+    if (m_listsOutdated)
+        rebuildLists();
+    return m_files;
+}
+
+QStringList FileIndex::filesWithSuffix(const QString &suffix, Qt::CaseSensitivity cs)
+{
+    return filesWithSuffixes({suffix}, cs);
+}
+
+QStringList FileIndex::filesWithSuffixes(const QStringList &suffixes, Qt::CaseSensitivity cs)
+{
+    update();
+    if (m_listsOutdated)
+        rebuildLists();
+
+    QStringList result;
+    QStringList lowerSuffixes;
+    for (const auto &suffix : suffixes) {
+        const QString lowerSuffix = suffix.toLower();
+        if (lowerSuffixes.contains(lowerSuffix))
+            continue;
+        lowerSuffixes.push_back(lowerSuffix);
+
+        auto it = m_filesBySuffix.find(lowerSuffix);
+        if (it == m_filesBySuffix.end())
+            continue;
+        result.append(it->second);
+    }
+
+    if (cs == Qt::CaseSensitive) {
+        result.removeIf([&suffixes](const QString &filePath) {
+            return !suffixes.contains(QFileInfo(filePath).suffix());
+        });
+    }
+
+    if (lowerSuffixes.size() > 1)
+        std::ranges::sort(result);
+    return result;
+}
+
+QStringList FileIndex::filesWithName(const QString &fileName)
+{
+    update();
+    if (m_listsOutdated)
+        rebuildLists();
+
+    auto it = m_filesByName.find(fileName.toLower());
+    if (it == m_filesByName.end())
+        return {};
+    return it->second;
+}
+
+} // namespace Core
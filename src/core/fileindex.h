@@ -0,0 +1,98 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QDateTime>
+#include <QRegularExpression>
+#include <QSet>
+#include <QStringList>
+#include <unordered_map>
+
+namespace Core {
+
+/**
+ * \brief Index of all the files in a directory tree
+ *
+ * The index is built once, and then kept up-to-date by checking the modification time of each directory: only the
+ * directories that have changed since the last call are scanned again.
+ * Hidden files and directories are not indexed, and symbolic links to directories are not followed.
+ *
+ * Files and directories can also be excluded with glob patterns, or because git ignores them: an excluded directory
+ * is not scanned at all.
+ */
+class FileIndex
+{
+public:
+    void setRoot(const QString &root);
+    const QString &root() const;
+
+    // Excludes the entries matching one of the patterns, using the .gitignore syntax without negation: a pattern
+    // without a slash matches the file name at any level, otherwise the path relative to the root. A pattern ending
+    // with a slash only matches directories.
+    void setExcludes(const QStringList &patterns);
+    // Excludes the entries ignored by git, if the root is inside a git work tree
+    void setUseGitIgnore(bool useGitIgnore);
+
+    // Returns the full path of all files in the tree, sorted
+    const QStringList &files();
+    // Returns the full path of all files with the given suffix, sorted
+    QStringList filesWithSuffix(const QString &suffix, Qt::CaseSensitivity cs = Qt::CaseSensitive);
+    QStringList filesWithSuffixes(const QStringList &suffixes, Qt::CaseSensitivity cs = Qt::CaseSensitive);
+    // Returns the full path of all files named `fileName`, case insensitively, sorted
+    QStringList filesWithName(const QString &fileName);
+
+private:
+    struct Directory
+    {
+        QDateTime lastModified;
+        // The directory was modified right before being scanned: another change in the same file system tick won't
+        // change its modification time, so it needs to be scanned again
+        bool mayBeOutdated = false;
+        QStringList files;
+        QStringList subdirectories;
+    };
+    using Directories = std::unordered_map<QString, Directory>;
+
+    struct Exclude
+    {
+        QRegularExpression regexp;
+        bool matchPath = false;
+        bool directoryOnly = false;
+    };
+
+    // Those are called from several threads during the initial scan
+    Directory scanDirectory(const QString &path) const;
+    Directories scanTree(const QString &path) const;
+    bool isExcluded(const QString &path, const QString &fileName, bool isDirectory) const;
+
+    void updateGitIgnored();
+    void update();
+    void removeTree(const QString &path);
+    void rebuildLists();
+
+    QString m_root;
+    Directories m_directories;
+    bool m_listsOutdated = true;
+
+    QStringList m_excludePatterns;
+    QList<Exclude> m_excludes;
+    bool m_useGitIgnore = false;
+    // Paths relative to the root of the files and directories ignored by git
+    QSet<QString> m_gitIgnored;
+
+    QStringList m_files;
+    // Files stored by lower case suffix
+    std::unordered_map<QString, QStringList> m_filesBySuffix;
+    // Files stored by lower case file name
+    std::unordered_map<QString, QStringList> m_filesByName;
+};
+
+} // namespace Core
@@ -0,0 +1,120 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "filequerymatch.h"
+
+#include <kdalgorithms.h>
+#include <treesitter/query.h>
+
+namespace Core {
+
+/*!
+ * \qmltype FileQueryCapture
+ * \brief Defines a capture made by a query on a file.
+ * \inqmlmodule Script
+ * \ingroup CodeDocument
+ * \sa FileQueryMatch
+ *
+ * Contrary to a `QueryCapture`, the capture is not linked to any document: its range won't be updated if the
+ * file changes.
+ */
+/*!
+ * \qmlproperty string FileQueryCapture::name
+ * Name of the capture inside the query.
+ */
+/*!
+ * \qmlproperty TextRange FileQueryCapture::range
+ * Range of the capture in the file.
+ */
+/*!
+ * \qmlproperty string FileQueryCapture::text
+ * Text of the capture.
+ */
+
+QString FileQueryCapture::toString() const
+{
+    return QString("FileQueryCapture{'%1', %2}").arg(name, range.toString());
+}
+
+/*!
+ * \qmltype FileQueryMatch
+ * \brief Contains all captures for a query match in a file.
+ * \inqmlmodule Script
+ * \ingroup CodeDocument
+ * \sa Project::queryAll
+ *
+ * A `FileQueryMatch` is returned when running a query on files without opening them, see `Project::queryAll`.
+ * If you need to edit the file, open the document using `Project.open(match.fileName)` and use the ranges
+ * of the captures, as long as the document has not been modified.
+ */
+/*!
+ * \qmlproperty string FileQueryMatch::fileName
+ * Full path of the file containing the match.
+ */
+/*!
+ * \qmlproperty array<FileQueryCapture> FileQueryMatch::captures
+ * List of all the captures in the match.
+ */
+
+FileQueryMatch::FileQueryMatch(const QString &fileName, const QString &source, const treesitter::QueryMatch &match)
+    : m_fileName(fileName)
+{
+    const auto captures = match.captures();
+    m_captures.reserve(captures.size());
+    for (const treesitter::QueryMatch::Capture &capture : captures) {
+        const auto start = static_cast<int>(capture.node.startPosition());
+        const auto end = static_cast<int>(capture.node.endPosition());
+        m_captures.emplace_back(FileQueryCapture {.name = match.query()->captureAt(capture.id).name,
+                                                  .range = {.start = start, .end = end},
+                                                  .text = capture.node.textIn(source)});
+    }
+}
+
+const QString &FileQueryMatch::fileName() const
+{
+    return m_fileName;
+}
+
+const QVector<FileQueryCapture> &FileQueryMatch::captures() const
+{
+    return m_captures;
+}
+
+/*!
+ * \qmlmethod FileQueryCapture FileQueryMatch::get(string name)
+ * Returns the first capture with the given `name`, or an empty capture if none is found.
+ */
+FileQueryCapture FileQueryMatch::get(const QString &name) const
+{
+    if (const auto capture = kdalgorithms::find_if(m_captures, [&name](const auto &capture) {
+            return capture.name == name;
+        })) {
+        return *capture;
+    }
+    return {};
+}
+
+/*!
+ * \qmlmethod array<FileQueryCapture> FileQueryMatch::getAll(string name)
+ * Returns all captures with the given `name`.
+ */
+QVector<FileQueryCapture> FileQueryMatch::getAll(const QString &name) const
+{
+    return kdalgorithms::filtered(m_captures, [&name](const auto &capture) {
+        return capture.name == name;
+    });
+}
+
+QString FileQueryMatch::toString() const
+{
+    return QString("FileQueryMatch{'%1', %2}").arg(m_fileName).arg(m_captures.size());
+}
+
+} // namespace Core
@@ -0,0 +1,71 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include "textrange.h"
+
+#include <QObject>
+#include <QVector>
+
+namespace treesitter {
+class QueryMatch;
+}
+
+namespace Core {
+
+// Lightweight version of QueryCapture, not backed by any document.
+struct FileQueryCapture
+{
+    Q_GADGET
+    Q_PROPERTY(QString name MEMBER name CONSTANT)
+    Q_PROPERTY(Core::TextRange range MEMBER range CONSTANT)
+    Q_PROPERTY(QString text MEMBER text CONSTANT)
+
+public:
+    QString name;
+    TextRange range;
+    QString text;
+
+    Q_INVOKABLE QString toString() const;
+};
+
+// Lightweight version of QueryMatch, not backed by any document.
+// This is used to return the results of queries run on files that are not opened in Knut.
+class FileQueryMatch
+{
+    Q_GADGET
+    Q_PROPERTY(QString fileName MEMBER m_fileName CONSTANT)
+    Q_PROPERTY(QVector<Core::FileQueryCapture> captures MEMBER m_captures CONSTANT)
+
+public:
+    // Default constructor is required for Q_DECLARE_METATYPE
+    FileQueryMatch() = default;
+    FileQueryMatch(const QString &fileName, const QString &source, const treesitter::QueryMatch &match);
+
+    const QString &fileName() const;
+    const QVector<FileQueryCapture> &captures() const;
+
+    Q_INVOKABLE Core::FileQueryCapture get(const QString &name) const;
+    Q_INVOKABLE QVector<Core::FileQueryCapture> getAll(const QString &name) const;
+
+    Q_INVOKABLE QString toString() const;
+
+private:
+    QString m_fileName;
+    QVector<FileQueryCapture> m_captures;
+};
+
+using FileQueryMatchList = QVector<Core::FileQueryMatch>;
+
+} // namespace Core
+
+Q_DECLARE_METATYPE(Core::FileQueryCapture)
+Q_DECLARE_METATYPE(Core::FileQueryMatch)
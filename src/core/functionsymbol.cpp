@@ -12,6 +12,7 @@
 #include "codedocument.h"
 
 #include <QRegularExpression>
+#include <algorithm>
 #include <kdalgorithms.h>
 
 namespace Core {
@@ -56,8 +57,8 @@ namespace Core {
  * whitespace but everything else like comments.
  */
 
-FunctionSymbol::FunctionSymbol(QObject *parent, const QueryMatch &match, Kind kind)
-    : Symbol(parent, match, kind)
+FunctionSymbol::FunctionSymbol(QObject *parent, const QString &name, Captures &&captures, Kind kind)
+    : Symbol(parent, name, std::move(captures), kind)
 {
 }
 
@@ -79,7 +80,17 @@ QString FunctionSymbol::signature() const
 
 QString FunctionSymbol::returnTypeFromQueryMatch() const
 {
-    return m_queryMatch.getAllJoined("return").text();
+    const auto ranges = captureRanges("return");
+    if (ranges.isEmpty())
+        return {};
+
+    // Smallest range containing all the captures, like QueryMatch::getAllJoined
+    TextRange joined = ranges.first();
+    for (const auto &range : ranges) {
+        joined.start = std::min(joined.start, range.start);
+        joined.end = std::max(joined.end, range.end);
+    }
+    return textAt(joined);
 }
 
 QString FunctionSymbol::returnType() const
@@ -101,9 +112,15 @@ const QVector<FunctionArgument> &FunctionSymbol::arguments() const
 
 QVector<FunctionArgument> FunctionSymbol::argumentsFromQueryMatch() const
 {
-    auto arguments = m_queryMatch.getAll("parameter");
-    auto to_function_arg = [this](const RangeMark &argument) {
-        auto result = document()->queryInRange(argument, "(identifier) @name");
+    auto codeDocument = document();
+    if (!codeDocument)
+        return {};
+
+    const auto arguments = captureRanges("parameter");
+    auto to_function_arg = [codeDocument](const TextRange &range) {
+        // The RangeMark is only needed while computing the argument
+        const auto argument = codeDocument->createRangeMark(range.start, range.end);
+        auto result = codeDocument->queryInRange(argument, "(identifier) @name");
         auto nameRange = result.isEmpty() ? RangeMark() : result.first().get("name");
         auto name = nameRange.text().simplified();
         auto type = argument.textExcept(nameRange).simplified();
@@ -44,7 +44,7 @@ protected:
     // necessary so the constructor can be accessed from the Symbol class.
     friend class Symbol;
 
-    FunctionSymbol(QObject *parent, const QueryMatch &match, Kind kind);
+    FunctionSymbol(QObject *parent, const QString &name, Captures &&captures, Kind kind);
 
     mutable std::optional<QString> m_returnType;
     mutable std::optional<QVector<FunctionArgument>> m_arguments;
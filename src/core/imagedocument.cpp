@@ -11,18 +11,72 @@
 #include "imagedocument.h"
 #include "utils/log.h"
 
+#include <QCache>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QImageReader>
+#include <QtConcurrent>
+
 namespace Core {
 
+// Maximum width and height of the previews, larger images are downscaled while decoding
+constexpr int PreviewSize = 1024;
+// Maximum size in bytes of all the previews kept in the thumbnail cache
+constexpr qsizetype PreviewCacheCost = 64 * 1024 * 1024;
+
+// Least recently used previews, shared by all documents, so reopening an image doesn't decode it again.
+// Only accessed from the main thread.
+static QCache<QString, QImage> &previewCache()
+{
+    static QCache<QString, QImage> cache(PreviewCacheCost);
+    return cache;
+}
+
 ImageDocument::ImageDocument(QObject *parent)
     : Document(Type::Image, parent)
+    , m_previewWatcher(new QFutureWatcher<QImage>(this))
 {
+    connect(m_previewWatcher, &QFutureWatcherBase::finished, this, [this]() {
+        const auto preview = m_previewWatcher->result();
+        if (preview.isNull()) {
+            spdlog::warn("ImageDocument::doLoad - can't decode image {}", fileName());
+            return;
+        }
+        previewCache().insert(m_cacheKey, new QImage(preview), preview.sizeInBytes());
+        setPreview(preview);
+    });
 }
 
 QImage ImageDocument::image() const
 {
+    if (m_image.isNull() && !fileName().isEmpty())
+        m_image.load(fileName());
     return m_image;
 }
 
+QImage ImageDocument::preview() const
+{
+    return m_preview;
+}
+
+QSize ImageDocument::imageSize() const
+{
+    return m_imageSize;
+}
+
+void ImageDocument::setPreview(const QImage &preview)
+{
+    m_preview = preview;
+    // Some formats don't store the size in their header
+    if (!m_imageSize.isValid())
+        m_imageSize = preview.size();
+    // Small images are decoded at full resolution for the preview
+    if (preview.size() == m_imageSize)
+        m_image = preview;
+    emit previewChanged();
+}
+
 bool ImageDocument::doSave(const QString &fileName)
 {
     Q_UNUSED(fileName)
@@ -30,9 +84,34 @@ bool ImageDocument::doSave(const QString &fileName)
     return false;
 }
 
+// Only the header of the image is read here, the preview is decoded on a worker thread
 bool ImageDocument::doLoad(const QString &fileName)
 {
-    return m_image.load(fileName);
+    m_image = {};
+    m_preview = {};
+
+    QImageReader reader(fileName);
+    if (!reader.canRead())
+        return false;
+    m_imageSize = reader.size();
+
+    m_cacheKey = fileName + '|' + QString::number(QFileInfo(fileName).lastModified().toMSecsSinceEpoch());
+    if (const auto cached = previewCache().object(m_cacheKey)) {
+        setPreview(*cached);
+        return true;
+    }
+
+    QSize scaledSize;
+    if (m_imageSize.width() > PreviewSize || m_imageSize.height() > PreviewSize)
+        scaledSize = m_imageSize.scaled(PreviewSize, PreviewSize, Qt::KeepAspectRatio);
+    m_previewWatcher->setFuture(QtConcurrent::run([fileName, scaledSize]() {
+        QImageReader reader(fileName);
+        // Formats not supporting it natively are scaled after being decoded, still on the worker thread
+        if (scaledSize.isValid())
+            reader.setScaledSize(scaledSize);
+        return reader.read();
+    }));
+    return true;
 }
 
 } // namespace Core
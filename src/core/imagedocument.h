@@ -13,6 +13,10 @@
 #include "document.h"
 
 #include <QImage>
+#include <QSize>
+
+template <typename T>
+class QFutureWatcher;
 
 namespace Core {
 
@@ -23,14 +27,30 @@ class ImageDocument : public Document
 public:
     explicit ImageDocument(QObject *parent = nullptr);
 
+    // Full resolution image, decoded on the first call
     QImage image() const;
+    // Downscaled image, decoded on a worker thread when the document is loaded. It's null until previewChanged is
+    // emitted, and is the full image if it's small enough.
+    QImage preview() const;
+    // Size of the full image, read from the file header
+    QSize imageSize() const;
+
+signals:
+    void previewChanged();
 
 protected:
     bool doSave(const QString &fileName) override;
     bool doLoad(const QString &fileName) override;
 
 private:
-    QImage m_image;
+    void setPreview(const QImage &preview);
+
+    QSize m_imageSize;
+    QImage m_preview;
+    mutable QImage m_image;
+    // Key of the preview in the thumbnail cache, changes with the modification time of the file
+    QString m_cacheKey;
+    QFutureWatcher<QImage> *const m_previewWatcher;
 };
 
 } // namespace Core
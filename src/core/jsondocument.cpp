@@ -9,12 +9,538 @@
 */
 
 #include "jsondocument.h"
+#include "logger.h"
+#include "utils/log.h"
+
+#include <QJSValue>
+#include <QTextCursor>
+#include <cmath>
 
 namespace Core {
 
+/*!
+ * \qmltype JsonDocument
+ * \brief Provides access to the content of a json file.
+ * \inqmlmodule Script
+ * \ingroup JsonDocument
+ *
+ * The document keeps a parsed model of its content, so values can be read without parsing the json in the script.
+ * Values are addressed with [json pointers](https://datatracker.ietf.org/doc/html/rfc6901), like `/0/file` or
+ * `/compilerOptions/paths`, the empty pointer being the whole document.
+ *
+ * Modifications are done in place: only the spans of text of the modified values are changed, the rest of the
+ * document keeps its formatting.
+ */
+
 JsonDocument::JsonDocument(QObject *parent)
     : TextDocument(Type::Json, parent)
 {
+    connect(this, &TextDocument::textChanged, this, [this]() {
+        m_json.reset();
+    });
+}
+
+//=============================================================================
+// Conversions between QVariant and json
+//=============================================================================
+QVariant JsonDocument::toVariant(const nlohmann::json &json)
+{
+    switch (json.type()) {
+    case nlohmann::json::value_t::null:
+        return QVariant::fromValue(nullptr);
+    case nlohmann::json::value_t::boolean:
+        return json.get<bool>();
+    case nlohmann::json::value_t::number_integer:
+        return json.get<qint64>();
+    case nlohmann::json::value_t::number_unsigned:
+        return json.get<quint64>();
+    case nlohmann::json::value_t::number_float:
+        return json.get<double>();
+    case nlohmann::json::value_t::string:
+        return QString::fromStdString(json.get<std::string>());
+    case nlohmann::json::value_t::array: {
+        QVariantList list;
+        list.reserve(static_cast<qsizetype>(json.size()));
+        for (const auto &item : json)
+            list.push_back(toVariant(item));
+        return list;
+    }
+    case nlohmann::json::value_t::object: {
+        QVariantMap map;
+        for (auto it = json.begin(); it != json.end(); ++it)
+            map.insert(QString::fromStdString(it.key()), toVariant(it.value()));
+        return map;
+    }
+    default:
+        return {};
+    }
+}
+
+nlohmann::json JsonDocument::toJson(const QVariant &value)
+{
+    if (value.metaType() == QMetaType::fromType<QJSValue>())
+        return toJson(value.value<QJSValue>().toVariant());
+
+    switch (value.typeId()) {
+    case QMetaType::UnknownType:
+    case QMetaType::Nullptr:
+        return nullptr;
+    case QMetaType::Bool:
+        return value.toBool();
+    case QMetaType::Int:
+    case QMetaType::LongLong:
+        return value.toLongLong();
+    case QMetaType::UInt:
+    case QMetaType::ULongLong:
+        return value.toULongLong();
+    case QMetaType::Float:
+    case QMetaType::Double: {
+        // Numbers coming from scripts are doubles, keep integers as integers in the document
+        const double number = value.toDouble();
+        if (std::trunc(number) == number && std::abs(number) < 1e15)
+            return static_cast<qint64>(number);
+        return number;
+    }
+    case QMetaType::QString:
+        return value.toString().toStdString();
+    case QMetaType::QStringList:
+    case QMetaType::QVariantList: {
+        auto json = nlohmann::json::array();
+        const auto list = value.toList();
+        for (const auto &item : list)
+            json.push_back(toJson(item));
+        return json;
+    }
+    case QMetaType::QVariantMap: {
+        auto json = nlohmann::json::object();
+        const auto map = value.toMap();
+        for (auto it = map.cbegin(); it != map.cend(); ++it)
+            json[it.key().toStdString()] = toJson(it.value());
+        return json;
+    }
+    default:
+        return value.toString().toStdString();
+    }
+}
+
+//=============================================================================
+// Location of values in the text
+//=============================================================================
+namespace {
+
+// Object member or array element, as positions in the text
+struct JsonMember
+{
+    // Empty for array elements
+    QString key;
+    // Start of the key for object members, of the value for array elements
+    int start = 0;
+    int valueStart = 0;
+    int end = 0;
+};
+
+struct JsonContainer
+{
+    // Positions of the opening and after the closing bracket
+    int start = -1;
+    int end = -1;
+    bool isObject = false;
+    QVector<JsonMember> members;
+
+    bool isValid() const { return start != -1; }
+};
+
+} // namespace
+
+static int skipWhitespace(const QString &text, int pos)
+{
+    while (pos < text.size() && text.at(pos).isSpace())
+        ++pos;
+    return pos;
+}
+
+// Returns the position after the string starting at `pos`, or -1
+static int skipString(const QString &text, int pos)
+{
+    for (++pos; pos < text.size(); ++pos) {
+        const auto c = text.at(pos);
+        if (c == '\\')
+            ++pos;
+        else if (c == '"')
+            return pos + 1;
+    }
+    return -1;
+}
+
+// Returns the position after the value starting at `pos`, or -1
+// The text has already been validated by the parser, so only strings and brackets matter here.
+static int skipValue(const QString &text, int pos)
+{
+    if (pos >= text.size())
+        return -1;
+
+    const auto c = text.at(pos);
+    if (c == '"')
+        return skipString(text, pos);
+
+    if (c == '{' || c == '[') {
+        int depth = 0;
+        for (; pos < text.size(); ++pos) {
+            const auto current = text.at(pos);
+            if (current == '"') {
+                pos = skipString(text, pos);
+                if (pos == -1)
+                    return -1;
+                --pos;
+            } else if (current == '{' || current == '[') {
+                ++depth;
+            } else if ((current == '}' || current == ']') && --depth == 0) {
+                return pos + 1;
+            }
+        }
+        return -1;
+    }
+
+    // Numbers and literals
+    while (pos < text.size() && !text.at(pos).isSpace() && text.at(pos) != ',' && text.at(pos) != '}'
+           && text.at(pos) != ']')
+        ++pos;
+    return pos;
+}
+
+static QString decodeKey(const QString &token)
+{
+    if (!token.contains('\\'))
+        return token.mid(1, token.size() - 2);
+    return QString::fromStdString(nlohmann::json::parse(token.toStdString()).get<std::string>());
+}
+
+// Returns the members of the object or array starting at `pos`
+static JsonContainer readContainer(const QString &text, int pos)
+{
+    if (pos >= text.size() || (text.at(pos) != '{' && text.at(pos) != '['))
+        return {};
+
+    JsonContainer container {.start = pos, .isObject = text.at(pos) == '{'};
+    const QChar close = container.isObject ? '}' : ']';
+    pos = skipWhitespace(text, pos + 1);
+    while (pos < text.size() && text.at(pos) != close) {
+        JsonMember member {.start = pos};
+        if (container.isObject) {
+            const int keyEnd = skipString(text, pos);
+            if (keyEnd == -1)
+                return {};
+            member.key = decodeKey(text.mid(pos, keyEnd - pos));
+            pos = skipWhitespace(text, keyEnd);
+            if (pos >= text.size() || text.at(pos) != ':')
+                return {};
+            pos = skipWhitespace(text, pos + 1);
+        }
+        member.valueStart = pos;
+        member.end = skipValue(text, pos);
+        if (member.end == -1)
+            return {};
+        container.members.push_back(member);
+        pos = skipWhitespace(text, member.end);
+        if (pos < text.size() && text.at(pos) == ',')
+            pos = skipWhitespace(text, pos + 1);
+    }
+    if (pos >= text.size())
+        return {};
+    container.end = pos + 1;
+    return container;
+}
+
+// Splits a json pointer into its unescaped reference tokens
+static QStringList pointerTokens(const std::string &pointer)
+{
+    if (pointer.empty())
+        return {};
+    auto tokens = QString::fromStdString(pointer).mid(1).split('/');
+    for (auto &token : tokens)
+        token.replace("~1", "/").replace("~0", "~");
+    return tokens;
+}
+
+// Returns the index of the member `token` in the container, or -1
+static int memberIndex(const JsonContainer &container, const QString &token)
+{
+    if (container.isObject) {
+        // With duplicated keys the parser keeps the last one
+        for (auto i = container.members.size() - 1; i >= 0; --i) {
+            if (container.members.at(i).key == token)
+                return static_cast<int>(i);
+        }
+        return -1;
+    }
+    bool ok = false;
+    const int index = token.toInt(&ok);
+    return ok && index >= 0 && index < container.members.size() ? index : -1;
+}
+
+// Returns the container holding the value referenced by `tokens`, which can't be empty
+static JsonContainer parentContainer(const QString &text, const QStringList &tokens)
+{
+    auto container = readContainer(text, skipWhitespace(text, 0));
+    for (int i = 0; i < tokens.size() - 1 && container.isValid(); ++i) {
+        const int index = memberIndex(container, tokens.at(i));
+        if (index == -1)
+            return {};
+        container = readContainer(text, container.members.at(index).valueStart);
+    }
+    return container;
+}
+
+// Returns the range of the value referenced by `tokens`, or an invalid range
+static TextRange valueRange(const QString &text, const QStringList &tokens)
+{
+    if (tokens.isEmpty()) {
+        const int start = skipWhitespace(text, 0);
+        return {start, skipValue(text, start)};
+    }
+    const auto container = parentContainer(text, tokens);
+    const int index = container.isValid() ? memberIndex(container, tokens.last()) : -1;
+    if (index == -1)
+        return {-1, -1};
+    return {container.members.at(index).valueStart, container.members.at(index).end};
+}
+
+// Returns the edit inserting `member` at `index` in the container, reusing the existing separators
+static TextEdit insertMemberEdit(const QString &text, const JsonContainer &container, int index, const QString &member)
+{
+    const auto &members = container.members;
+    if (members.isEmpty())
+        return {{container.start + 1, container.start + 1}, member};
+
+    QString separator = ", ";
+    if (members.size() > 1) {
+        separator = text.mid(members.at(0).end, members.at(1).start - members.at(0).end);
+    } else if (const auto indent = text.mid(container.start + 1, members.at(0).start - container.start - 1);
+               !indent.isEmpty()) {
+        separator = ',' + indent;
+    }
+
+    if (index < members.size())
+        return {{members.at(index).start, members.at(index).start}, member + separator};
+    return {{members.last().end, members.last().end}, separator + member};
+}
+
+// Returns the edit removing the member at `index` in the container, with its separator
+static TextEdit removeMemberEdit(const JsonContainer &container, int index)
+{
+    const auto &members = container.members;
+    if (index + 1 < members.size())
+        return {{members.at(index).start, members.at(index + 1).start}, {}};
+    if (index > 0)
+        return {{members.at(index - 1).end, members.at(index).end}, {}};
+    return {{members.at(index).start, members.at(index).end}, {}};
+}
+
+static std::optional<TextEdit> addEdit(const QString &text, const QStringList &tokens, const QString &value)
+{
+    if (tokens.isEmpty())
+        return TextEdit {valueRange(text, tokens), value};
+
+    const auto container = parentContainer(text, tokens);
+    if (!container.isValid())
+        return {};
+
+    const auto &token = tokens.last();
+    if (container.isObject) {
+        // Adding an existing member replaces its value
+        if (const int index = memberIndex(container, token); index != -1) {
+            const auto &member = container.members.at(index);
+            return TextEdit {{member.valueStart, member.end}, value};
+        }
+        const auto key = QString::fromStdString(nlohmann::json(token.toStdString()).dump());
+        return insertMemberEdit(text, container, static_cast<int>(container.members.size()), key + ": " + value);
+    }
+
+    bool ok = true;
+    const int index = token == "-" ? static_cast<int>(container.members.size()) : token.toInt(&ok);
+    if (!ok || index < 0 || index > container.members.size())
+        return {};
+    return insertMemberEdit(text, container, index, value);
+}
+
+static std::optional<TextEdit> removeEdit(const QString &text, const QStringList &tokens)
+{
+    if (tokens.isEmpty())
+        return {};
+    const auto container = parentContainer(text, tokens);
+    const int index = container.isValid() ? memberIndex(container, tokens.last()) : -1;
+    if (index == -1)
+        return {};
+    return removeMemberEdit(container, index);
+}
+
+static std::optional<TextEdit> replaceEdit(const QString &text, const QStringList &tokens, const QString &value)
+{
+    const auto range = valueRange(text, tokens);
+    if (range.start == -1 || range.end == -1)
+        return {};
+    return TextEdit {range, value};
+}
+
+// Computes the edits of one patch operation, and applies them to `text`
+// The operation has already been validated by nlohmann::json::patch.
+static bool operationEdits(QString &text, const nlohmann::json &operation, QVector<TextEdit> &edits)
+{
+    auto apply = [&](const std::optional<TextEdit> &edit) {
+        if (!edit)
+            return false;
+        text.replace(edit->range.start, edit->range.length(), edit->text);
+        edits.push_back(*edit);
+        return true;
+    };
+    auto serialized = [](const nlohmann::json &value) {
+        return QString::fromStdString(value.dump());
+    };
+
+    const auto op = operation.at("op").get<std::string>();
+    const auto path = pointerTokens(operation.at("path").get<std::string>());
+    if (op == "add")
+        return apply(addEdit(text, path, serialized(operation.at("value"))));
+    if (op == "remove")
+        return apply(removeEdit(text, path));
+    if (op == "replace")
+        return apply(replaceEdit(text, path, serialized(operation.at("value"))));
+    if (op == "test")
+        return true;
+
+    // Moved and copied values keep their original formatting
+    const auto from = pointerTokens(operation.at("from").get<std::string>());
+    const auto fromRange = valueRange(text, from);
+    if (fromRange.start == -1 || fromRange.end == -1)
+        return false;
+    const auto value = text.mid(fromRange.start, fromRange.length());
+    if (op == "move") {
+        if (from == path)
+            return true;
+        return apply(removeEdit(text, from)) && apply(addEdit(text, path, value));
+    }
+    if (op == "copy")
+        return apply(addEdit(text, path, value));
+    return false;
+}
+
+//=============================================================================
+// JsonDocument
+//=============================================================================
+// Returns the parsed content of the document, or nullptr if it's not valid json
+const nlohmann::json *JsonDocument::json() const
+{
+    if (!m_json)
+        m_json = nlohmann::json::parse(text().toStdString(), nullptr, false);
+    return m_json->is_discarded() ? nullptr : &m_json.value();
+}
+
+/*!
+ * \qmlmethod var JsonDocument::value(string pointer)
+ * Returns the value at the json `pointer`, or `undefined` if there's none.
+ *
+ * Objects are returned as JavaScript objects and arrays as JavaScript arrays.
+ */
+QVariant JsonDocument::value(const QString &pointer) const
+{
+    LOG("JsonDocument::value", pointer);
+
+    const auto document = json();
+    if (!document) {
+        spdlog::warn("JsonDocument::value - {} is not a valid json document", fileName());
+        return {};
+    }
+    try {
+        return toVariant(document->at(nlohmann::json::json_pointer(pointer.toStdString())));
+    } catch (const nlohmann::json::exception &) {
+        spdlog::warn("JsonDocument::value - no value at {}", pointer);
+    }
+    return {};
+}
+
+/*!
+ * \qmlmethod bool JsonDocument::hasValue(string pointer)
+ * Returns true if there's a value at the json `pointer`.
+ */
+bool JsonDocument::hasValue(const QString &pointer) const
+{
+    LOG("JsonDocument::hasValue", pointer);
+
+    const auto document = json();
+    if (!document)
+        return false;
+    try {
+        return document->contains(nlohmann::json::json_pointer(pointer.toStdString()));
+    } catch (const nlohmann::json::exception &) {
+        spdlog::warn("JsonDocument::hasValue - invalid pointer {}", pointer);
+    }
+    return false;
+}
+
+/*!
+ * \qmlmethod bool JsonDocument::setValue(string pointer, var value)
+ * Sets the `value` at the json `pointer`, replacing the existing value or adding a new one. Returns true on success.
+ */
+bool JsonDocument::setValue(const QString &pointer, const QVariant &value)
+{
+    LOG("JsonDocument::setValue", pointer, value);
+
+    const QVariantMap operation {
+        {"op", hasValue(pointer) ? "replace" : "add"}, {"path", pointer}, {"value", value}};
+    return patch({operation});
+}
+
+/*!
+ * \qmlmethod bool JsonDocument::patch(array<object> operations)
+ * Applies a [json patch](https://datatracker.ietf.org/doc/html/rfc6902) to the document. Returns true on success.
+ *
+ * Each operation is an object like `{op: "replace", path: "/version", value: 2}`, the supported operations being
+ * `add`, `remove`, `replace`, `move`, `copy` and `test`. The patch is atomic: if one operation fails, the document is
+ * left unchanged.
+ *
+ * Only the modified values are written back in the text, new values being serialized without indentation.
+ */
+bool JsonDocument::patch(const QVariantList &operations)
+{
+    LOG("JsonDocument::patch", LOG_ARG("count", operations.size()));
+
+    const auto document = json();
+    if (!document) {
+        spdlog::error("JsonDocument::patch - {} is not a valid json document", fileName());
+        return false;
+    }
+
+    const auto patchJson = toJson(operations);
+    nlohmann::json result;
+    try {
+        result = document->patch(patchJson);
+    } catch (const nlohmann::json::exception &e) {
+        spdlog::error("JsonDocument::patch - {}", e.what());
+        return false;
+    }
+
+    // Compute all the edits first, so nothing is changed if the text can't be edited
+    auto content = text();
+    QVector<TextEdit> edits;
+    for (const auto &operation : patchJson) {
+        if (!operationEdits(content, operation, edits)) {
+            spdlog::error("JsonDocument::patch - can't apply {}", operation.dump());
+            return false;
+        }
+    }
+
+    QTextCursor cursor(qTextDocument());
+    cursor.beginEditBlock();
+    for (const auto &edit : std::as_const(edits)) {
+        cursor.setPosition(edit.range.start);
+        cursor.setPosition(edit.range.end, QTextCursor::KeepAnchor);
+        cursor.insertText(edit.text);
+    }
+    cursor.endEditBlock();
+
+    // The patched model is the parsed content of the new text, no need to parse it again
+    m_json = std::move(result);
+    return true;
 }
 
 } // namespace Core
@@ -12,6 +12,10 @@
 
 #include "textdocument.h"
 
+#include <QVariant>
+#include <nlohmann/json.hpp>
+#include <optional>
+
 namespace Core {
 
 class JsonDocument : public TextDocument
@@ -20,6 +24,22 @@ class JsonDocument : public TextDocument
 
 public:
     explicit JsonDocument(QObject *parent = nullptr);
+
+    // Conversions between json and the values used by the scripts
+    static QVariant toVariant(const nlohmann::json &json);
+    static nlohmann::json toJson(const QVariant &value);
+
+public slots:
+    QVariant value(const QString &pointer) const;
+    bool hasValue(const QString &pointer) const;
+    bool setValue(const QString &pointer, const QVariant &value);
+    bool patch(const QVariantList &operations);
+
+private:
+    const nlohmann::json *json() const;
+
+    // Parsed content of the document, reset on each change
+    mutable std::optional<nlohmann::json> m_json;
 };
 
 }
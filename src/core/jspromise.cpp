@@ -0,0 +1,47 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "jspromise.h"
+
+#include <QJSEngine>
+
+namespace Core {
+
+JsPromise::JsPromise(QJSEngine *engine)
+    : m_engine(engine)
+{
+    // There's no C++ API to create a promise, the resolve and reject functions are exported by the executor
+    const auto deferred = engine->evaluate(R"js(
+        (function() {
+            let deferred = {};
+            deferred.promise = new Promise((resolve, reject) => {
+                deferred.resolve = resolve;
+                deferred.reject = reject;
+            });
+            return deferred;
+        })())js");
+    m_promise = deferred.property("promise");
+    m_resolve = deferred.property("resolve");
+    m_reject = deferred.property("reject");
+}
+
+void JsPromise::resolve(const QJSValue &result) const
+{
+    if (m_engine)
+        m_resolve.call({result});
+}
+
+void JsPromise::reject(const QString &message) const
+{
+    if (m_engine)
+        m_reject.call({m_engine->newErrorObject(QJSValue::GenericError, message)});
+}
+
+} // namespace Core
@@ -0,0 +1,46 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QJSValue>
+#include <QPointer>
+
+class QJSEngine;
+
+namespace Core {
+
+/**
+ * \brief JavaScript promise resolved from C++
+ *
+ * Used by the asynchronous script APIs: the promise is returned to the script right away, and resolved later, for
+ * example once the LSP server has responded. Resolving the promise does nothing if the engine has been destroyed in
+ * the meantime.
+ */
+class JsPromise
+{
+public:
+    explicit JsPromise(QJSEngine *engine);
+
+    QJSEngine *engine() const { return m_engine; }
+    // The promise to return to the script
+    QJSValue value() const { return m_promise; }
+
+    void resolve(const QJSValue &result) const;
+    void reject(const QString &message) const;
+
+private:
+    QPointer<QJSEngine> m_engine;
+    QJSValue m_promise;
+    QJSValue m_resolve;
+    QJSValue m_reject;
+};
+
+} // namespace Core
@@ -9,23 +9,44 @@
 */
 
 #include "knutcore.h"
+#include "logger.h"
+#include "parallelscriptrunner.h"
+#include "profiler.h"
 #include "project.h"
 #include "scriptmanager.h"
+#include "scriptserver.h"
+#include "shardedscriptrunner.h"
+#include "testscriptrunner.h"
 #include "textdocument.h"
+#include "treesitter/parser.h"
+#include "treesitter/queryprofile.h"
+#include "utils/log.h"
+#include "utils/memoryaccounting.h"
+#include "utils/metrics.h"
+#include "utils/resultwriter.h"
 
 #include <QAbstractItemModel>
-#include <QApplication>
+#include <QCoreApplication>
 #include <QDir>
+#include <QFile>
+#include <QJsonDocument>
 #include <QTimer>
+#include <algorithm>
 #include <iostream>
 #include <nlohmann/json.hpp>
+#include <spdlog/async.h>
 #include <spdlog/cfg/env.h>
+#include <spdlog/sinks/dist_sink.h>
 #include <spdlog/sinks/rotating_file_sink.h>
 
 using json = nlohmann::json;
 
 namespace Core {
 
+// Set when the logger is asynchronous: the sinks can't be changed directly, as they are used in the logging thread
+static std::shared_ptr<spdlog::sinks::dist_sink_mt> asyncSinks;
+static std::shared_ptr<spdlog::details::thread_pool> asyncThreadPool;
+
 KnutCore::KnutCore(QObject *parent)
     : KnutCore({}, parent)
 {
@@ -37,6 +58,10 @@ KnutCore::KnutCore(QObject *parent)
 KnutCore::KnutCore(InternalTag, QObject *parent)
     : QObject(parent)
 {
+    // As early as possible, so most of the tree-sitter and pugixml memory is accounted
+    treesitter::installAllocator();
+    Utils::MemoryAccounting::installPugixml();
+
 #ifdef QT_DEBUG
     spdlog::set_level(spdlog::level::trace);
 #endif
@@ -51,9 +76,55 @@ void KnutCore::process(const QStringList &arguments)
     initParser(parser);
     parser.process(arguments);
 
+    const QString profileFile = parser.value("profile");
+    if (!profileFile.isEmpty()) {
+        Profiler::start(profileFile);
+        connect(qApp, &QCoreApplication::aboutToQuit, qApp, &Profiler::stop);
+    }
+
+    const QString metricsFile = parser.value("metrics");
+    if (!metricsFile.isEmpty()) {
+        connect(qApp, &QCoreApplication::aboutToQuit, qApp, [metricsFile]() {
+            if (!Utils::Metrics::save(metricsFile))
+                spdlog::error("KnutCore::process - can't save the metrics in {}", metricsFile);
+        });
+    }
+
+    const QString queryProfileFile = parser.value("query-profile");
+    if (!queryProfileFile.isEmpty()) {
+        treesitter::QueryProfiler::setEnabled(true);
+        connect(qApp, &QCoreApplication::aboutToQuit, qApp, [queryProfileFile]() {
+            if (!treesitter::QueryProfiler::save(queryProfileFile))
+                spdlog::error("KnutCore::process - can't save the query profile in {}", queryProfileFile);
+        });
+    }
+
+    const QString resultsFile = parser.value("results");
+    if (!resultsFile.isEmpty()) {
+        if (!Utils::ResultWriter::open(resultsFile))
+            spdlog::error("KnutCore::process - can't write the results in {}", resultsFile);
+        connect(qApp, &QCoreApplication::aboutToQuit, qApp, &Utils::ResultWriter::close);
+    }
+
+    const QString memoryReportFile = parser.value("memory-report");
+    if (!memoryReportFile.isEmpty()) {
+        connect(qApp, &QCoreApplication::aboutToQuit, this, [this, memoryReportFile]() {
+            // No project without initialization
+            if (!m_initialized)
+                return;
+            QFile file(memoryReportFile);
+            if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+                spdlog::error("KnutCore::process - can't save the memory report in {}", memoryReportFile);
+                return;
+            }
+            file.write(QJsonDocument::fromVariant(Project::instance()->memoryReport()).toJson());
+        });
+    }
+
     const bool jsonList = parser.isSet("json-list");
     if (jsonList) {
         initialize(Settings::Mode::Cli);
+        Core::ScriptManager::instance()->waitForDescriptions();
         auto model = Core::ScriptManager::model();
         if (model->rowCount() == 0) {
             std::cout << "[]\n";
@@ -79,9 +150,9 @@ void KnutCore::process(const QStringList &arguments)
     }
 
     Settings::Mode mode;
-    if (parser.isSet("test"))
+    if (parser.isSet("test") || parser.isSet("test-dir"))
         mode = Settings::Mode::Test;
-    else if (parser.isSet("run"))
+    else if (parser.isSet("run") || parser.isSet("serve"))
         mode = Settings::Mode::Cli;
     else
         mode = Settings::Mode::Gui;
@@ -101,6 +172,71 @@ void KnutCore::process(const QStringList &arguments)
         }
     }
 
+    // The documents saved are not written, their changes are saved in one patch on exit
+    const QString patchFile = parser.value("patch");
+    if (!patchFile.isEmpty()) {
+        Project::instance()->setPatchOutput(true);
+        connect(qApp, &QCoreApplication::aboutToQuit, this, [patchFile]() {
+            Project::instance()->savePatch(patchFile);
+        });
+    }
+
+    if (parser.isSet("lsp-indexing-timeout"))
+        Project::instance()->setLspIndexingTimeout(parser.value("lsp-indexing-timeout").toInt());
+
+    // Run all test scripts of the directory, each test in its own process
+    const QString testDir = parser.value("test-dir");
+    if (!testDir.isEmpty()) {
+        auto runner = new TestScriptRunner(this);
+        runner->setJobs(parser.value("jobs").toInt());
+        const QString junitFile = parser.value("junit");
+        connect(runner, &TestScriptRunner::finished, this, [runner, junitFile](int exitCode) {
+            if (!junitFile.isEmpty() && !TestScriptRunner::saveJUnit(junitFile, runner->results()))
+                exitCode = std::max(exitCode, 1);
+            qApp->exit(exitCode);
+        });
+        QTimer::singleShot(0, runner, [runner, testDir]() {
+            runner->run(TestScriptRunner::testScripts(testDir));
+        });
+        return;
+    }
+
+    // Run the script on each file matching the pattern, each file in its own process
+    const QString eachPattern = parser.value("each");
+    if (!eachPattern.isEmpty() && parser.isSet("run")) {
+        if (Project::instance()->root().isEmpty())
+            Project::instance()->setRoot(QDir::currentPath());
+        // Or sharded across the script servers of several nodes
+        if (parser.isSet("nodes")) {
+            auto runner = new ShardedScriptRunner(this);
+            runner->setNodes(parser.value("nodes").split(','));
+            runner->setShardSize(parser.value("shard-size").toInt());
+            connect(runner, &ShardedScriptRunner::finished, qApp, &QCoreApplication::exit, Qt::QueuedConnection);
+            const QString scriptName = parser.value("run");
+            QTimer::singleShot(0, runner, [runner, scriptName, eachPattern]() {
+                runner->run(scriptName, ParallelScriptRunner::matchingFiles(eachPattern));
+            });
+            return;
+        }
+        auto runner = new ParallelScriptRunner(this);
+        runner->setJobs(parser.value("jobs").toInt());
+        connect(runner, &ParallelScriptRunner::finished, qApp, &QCoreApplication::exit, Qt::QueuedConnection);
+        const QString scriptName = parser.value("run");
+        QTimer::singleShot(0, runner, [runner, scriptName, eachPattern]() {
+            runner->run(scriptName, ParallelScriptRunner::matchingFiles(eachPattern));
+        });
+        return;
+    }
+
+    // Keep running, the scripts are submitted on a local socket
+    const QString serverName = parser.value("serve");
+    if (!serverName.isEmpty()) {
+        auto server = new ScriptServer(this);
+        if (!server->listen(serverName))
+            exit(1);
+        return;
+    }
+
     // Open document on startup
     const QString fileName = parser.value("input");
     if (!fileName.isEmpty()) {
@@ -154,6 +290,24 @@ void KnutCore::initParser(QCommandLineParser &parser) const
                        {{"i", "input"}, "Opens document <file> on startup.", "file"},
                        {{"l", "line"}, "Line in the current file, if any.", "line"},
                        {{"c", "column"}, "Column in the current file, if any.", "column"},
+                       {"each", "Runs the script on each project file matching the glob <pattern>.", "pattern"},
+                       {"test-dir", "Tests all scripts tst_*.qml and tst_*.js in <dir> then exit.", "dir"},
+                       {"jobs", "Number of files or tests processed in parallel with --each or --test-dir.", "jobs"},
+                       {"junit", "Saves the results of --test-dir as a JUnit XML <file>.", "file"},
+                       {"serve", "Keeps running and runs the scripts submitted on the local socket <name>.", "name"},
+                       {"nodes", "Runs --each on the comma-separated script servers <names> instead.", "names"},
+                       {"shard-size", "Number of files sent to a node at once with --nodes.", "count"},
+                       {"profile", "Records the time spent in each API call, saved as a Chrome trace <file>.", "file"},
+                       {"metrics", "Saves the counters and latencies of the run as a JSON <file> on exit.", "file"},
+                       {"query-profile", "Saves the matches and time spent per query pattern as a JSON <file> on exit.",
+                        "file"},
+                       {"results", "Writes the records of Utils.writeResult in the JSON Lines <file>, - for stdout.",
+                        "file"},
+                       {"memory-report", "Saves the memory used per document as a JSON <file> on exit.", "file"},
+                       {"lsp-indexing-timeout",
+                        "Waits at most <msecs> for the LSP server to index the project before finding references.",
+                        "msecs"},
+                       {"patch", "Saves the changes as a patch <file> on exit, instead of writing the files.", "file"},
                        {"json-list", "Returns the list of all available scripts as a JSON file"},
                        {"json-settings", "Returns the settings as a JSON file"}});
 }
@@ -170,10 +324,20 @@ void KnutCore::initialize(Settings::Mode mode)
     if (m_initialized)
         return;
     new Settings(mode, this);
+    // Nobody can undo anything on headless runs, but scripts may still rely on undo
+    if (mode == Settings::Mode::Cli && !Settings::instance()->value<bool>(Settings::UndoInCli))
+        TextDocument::setUndoRedoEnabledForNewDocuments(false);
+    // The undo stack of a large file takes a lot of memory, and is even less likely to be used
+    if (mode == Settings::Mode::Cli)
+        TextDocument::setUndoRedoEnabledForLargeFiles(false);
+    // API calls are logged for the history panel and the trace logs, batch runs can disable it completely
+    LoggerObject::setEnabled(Settings::instance()->value<bool>(Settings::LogApiCalls));
     new Project(this);
     new ScriptManager(this);
     if (Core::Settings::instance()->value<bool>(Core::Settings::SaveLogsToFile))
         initializeMultiSinkLogger();
+    if (Core::Settings::instance()->value<bool>(Core::Settings::LogAsync))
+        initializeAsyncLogger();
     m_initialized = true;
 }
 
@@ -192,4 +356,61 @@ void KnutCore::initializeMultiSinkLogger()
     spdlog::flush_on(spdlog::level::info);
 }
 
+void KnutCore::initializeAsyncLogger()
+{
+    if (asyncSinks)
+        return;
+
+    const auto settings = Core::Settings::instance();
+    const auto queueSize = std::max(settings->value<int>(Settings::LogAsyncQueueSize), 1);
+    const auto policy = settings->value<QString>(Settings::LogAsyncOverflow) == "overrun_oldest"
+        ? spdlog::async_overflow_policy::overrun_oldest
+        : spdlog::async_overflow_policy::block;
+
+    // The async logger dispatches to the same sinks as the current default logger, from one logging thread
+    auto defaultLogger = spdlog::default_logger();
+    asyncSinks = std::make_shared<spdlog::sinks::dist_sink_mt>(defaultLogger->sinks());
+    asyncThreadPool = std::make_shared<spdlog::details::thread_pool>(queueSize, 1);
+    auto logger = std::make_shared<spdlog::async_logger>(defaultLogger->name(), asyncSinks, asyncThreadPool, policy);
+    logger->set_level(defaultLogger->level());
+    logger->flush_on(defaultLogger->flush_level());
+    spdlog::set_default_logger(logger);
+
+    const int flushInterval = settings->value<int>(Settings::LogFlushInterval);
+    if (flushInterval > 0)
+        spdlog::flush_every(std::chrono::seconds(flushInterval));
+
+    // Go back to a synchronous logger on exit, so the queued messages are written and the logs done during the
+    // destruction of the application are not lost
+    connect(qApp, &QCoreApplication::aboutToQuit, qApp, []() {
+        auto current = spdlog::default_logger();
+        auto logger = std::make_shared<spdlog::logger>(current->name(), asyncSinks);
+        logger->set_level(current->level());
+        logger->flush_on(current->flush_level());
+        spdlog::set_default_logger(logger);
+        current.reset();
+        // Waits for the logging thread to process the remaining messages
+        asyncThreadPool.reset();
+        logger->flush();
+    });
+}
+
+void KnutCore::addLogSink(const spdlog::sink_ptr &sink)
+{
+    if (asyncSinks)
+        asyncSinks->add_sink(sink);
+    else
+        spdlog::default_logger()->sinks().push_back(sink);
+}
+
+void KnutCore::removeLogSink(const spdlog::sink_ptr &sink)
+{
+    if (asyncSinks) {
+        asyncSinks->remove_sink(sink);
+    } else {
+        auto &sinks = spdlog::default_logger()->sinks();
+        sinks.erase(std::remove(sinks.begin(), sinks.end(), sink), sinks.end());
+    }
+}
+
 } // namespace Core
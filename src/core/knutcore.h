@@ -14,6 +14,7 @@
 
 #include <QCommandLineParser>
 #include <QObject>
+#include <spdlog/common.h>
 
 class QCoreApplication;
 
@@ -28,6 +29,11 @@ public:
 
     void process(const QStringList &arguments);
 
+    // Adds or removes a sink to the default logger, use it instead of changing the sinks of the logger directly, as
+    // the logger may be asynchronous
+    static void addLogSink(const spdlog::sink_ptr &sink);
+    static void removeLogSink(const spdlog::sink_ptr &sink);
+
 protected:
     // Used to disambiguate the internal constructor
     struct InternalTag
@@ -41,6 +47,7 @@ protected:
 private:
     void initialize(Settings::Mode mode);
     void initializeMultiSinkLogger();
+    void initializeAsyncLogger();
 
     bool m_initialized = false;
 };
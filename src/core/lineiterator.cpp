@@ -0,0 +1,85 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "lineiterator.h"
+
+#include <spdlog/spdlog.h>
+
+namespace Core {
+
+/*!
+ * \qmltype LineIterator
+ * \brief Reads a text file line by line.
+ * \inqmlmodule Script
+ * \ingroup Utilities
+ * \sa File::readLines
+ *
+ * The LineIterator only keeps a small buffer of the file in memory, so it can read files too large for
+ * `File::readAll`:
+ *
+ * ``` javascript
+ * let it = File.readLines(fileName);
+ * while (it.hasNext()) {
+ *     for (const line of it.nextLines(1000))
+ *         process(line);
+ * }
+ * ```
+ *
+ * Reading the lines in chunks with `nextLines` is faster than calling `next` for each line.
+ */
+
+LineIterator::LineIterator(const QString &fileName, QObject *parent)
+    : QObject(parent)
+    , m_file(fileName)
+{
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        spdlog::error("LineIterator - can't open {}: {}", fileName, m_file.errorString());
+        return;
+    }
+    m_stream.setDevice(&m_file);
+}
+
+LineIterator::~LineIterator() = default;
+
+/*!
+ * \qmlmethod bool LineIterator::hasNext()
+ * Returns true if there are more lines.
+ */
+bool LineIterator::hasNext() const
+{
+    return m_stream.device() && !m_stream.atEnd();
+}
+
+/*!
+ * \qmlmethod string LineIterator::next()
+ * Returns the next line, without its end-of-line characters, or an empty string at the end of the file.
+ */
+QString LineIterator::next()
+{
+    if (!hasNext())
+        return {};
+    return m_stream.readLine();
+}
+
+/*!
+ * \qmlmethod array<string> LineIterator::nextLines(int count)
+ * Returns the next `count` lines, or less at the end of the file.
+ */
+QStringList LineIterator::nextLines(int count)
+{
+    QStringList lines;
+    lines.reserve(count);
+    QString line;
+    while (lines.size() < count && hasNext() && m_stream.readLineInto(&line))
+        lines.push_back(line);
+    return lines;
+}
+
+} // namespace Core
@@ -0,0 +1,36 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QFile>
+#include <QObject>
+#include <QTextStream>
+
+namespace Core {
+
+class LineIterator : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit LineIterator(const QString &fileName, QObject *parent = nullptr);
+    ~LineIterator() override;
+
+    Q_INVOKABLE bool hasNext() const;
+    Q_INVOKABLE QString next();
+    Q_INVOKABLE QStringList nextLines(int count);
+
+private:
+    QFile m_file;
+    QTextStream m_stream;
+};
+
+} // namespace Core
@@ -14,6 +14,7 @@
 #include "textdocument_p.h"
 
 #include <QHash>
+#include <QTimer>
 
 namespace Core {
 
@@ -24,10 +25,19 @@ LoggerObject::LoggerObject()
 
 LoggerObject::~LoggerObject()
 {
+    if (m_profileIndex >= 0)
+        Profiler::exit(m_profileIndex);
     if (m_firstLogger)
         m_canLog = true;
 }
 
+void LoggerObject::setEnabled(bool enabled)
+{
+    m_enabled = enabled;
+    // When disabled, all calls take the same early return as the nested calls
+    m_canLog = enabled;
+}
+
 void LoggerObject::log(QString &&string)
 {
     spdlog::trace(string);
@@ -36,7 +46,11 @@ void LoggerObject::log(QString &&string)
 
 HistoryModel::HistoryModel(QObject *parent)
     : QAbstractTableModel(parent)
+    , m_flushTimer(new QTimer(this))
 {
+    m_flushTimer->setSingleShot(true);
+    m_flushTimer->setInterval(100);
+    connect(m_flushTimer, &QTimer::timeout, this, &HistoryModel::flush);
     LoggerObject::m_model = this;
 }
 
@@ -48,7 +62,7 @@ HistoryModel::~HistoryModel()
 int Core::HistoryModel::rowCount(const QModelIndex &parent) const
 {
     Q_UNUSED(parent)
-    return static_cast<int>(m_data.size());
+    return m_rowCount;
 }
 
 int HistoryModel::columnCount(const QModelIndex &parent) const
@@ -118,16 +132,48 @@ void HistoryModel::clear()
 {
     beginResetModel();
     m_data.clear();
+    m_rowCount = 0;
     endResetModel();
 }
 
+void HistoryModel::setCapacity(int capacity)
+{
+    m_capacity = std::max(capacity, 1);
+    flush();
+}
+
+void HistoryModel::flush()
+{
+    m_flushTimer->stop();
+
+    // Remove the oldest calls first, the ones in the model and then the pending ones
+    const int overflow = static_cast<int>(m_data.size()) - m_capacity;
+    if (overflow > 0) {
+        const int removedRows = std::min(overflow, m_rowCount);
+        if (removedRows > 0) {
+            beginRemoveRows({}, 0, removedRows - 1);
+            m_data.erase(m_data.begin(), m_data.begin() + removedRows);
+            m_rowCount -= removedRows;
+            endRemoveRows();
+        }
+        m_data.erase(m_data.begin(), m_data.begin() + (overflow - removedRows));
+    }
+
+    const int size = static_cast<int>(m_data.size());
+    if (size > m_rowCount) {
+        beginInsertRows({}, m_rowCount, size - 1);
+        m_rowCount = size;
+        endInsertRows();
+    }
+}
+
 QString HistoryModel::createScript(int start, int end)
 {
     const auto settings = Core::Settings::instance()->value<Core::TabSettings>(Core::Settings::Tab);
     const auto tab = settings.insertSpaces ? QString(settings.tabSize, ' ') : QString('\t');
 
     std::tie(start, end) = std::minmax(start, end);
-    Q_ASSERT(start >= 0 && start <= end && end < static_cast<int>(m_data.size()));
+    Q_ASSERT(start >= 0 && start <= end && end < m_rowCount);
 
     QString scriptText = "// Description of the script\n\nfunction main() {\n";
 
@@ -197,9 +243,13 @@ void HistoryModel::logData(const QString &name)
 void HistoryModel::addData(LogData &&data, bool merge)
 {
     if (!merge || m_data.empty() || m_data.back().name != data.name) {
-        beginInsertRows({}, static_cast<int>(m_data.size()), static_cast<int>(m_data.size()));
         m_data.push_back(std::move(data));
-        endInsertRows();
+        // Scripts run on the GUI thread, so the timer can't fire while they are running: flush regularly to keep the
+        // memory bounded
+        if (static_cast<int>(m_data.size()) >= 2 * m_capacity)
+            flush();
+        else if (!m_flushTimer->isActive())
+            m_flushTimer->start();
         return;
     }
 
@@ -222,8 +272,11 @@ void HistoryModel::addData(LogData &&data, bool merge)
             Q_UNREACHABLE();
         }
     }
-    auto lastIndex = index(static_cast<int>(m_data.size()) - 1, ParamCol);
-    emit dataChanged(lastIndex, lastIndex);
+    // Pending calls are not in the model yet
+    if (static_cast<int>(m_data.size()) == m_rowCount) {
+        auto lastIndex = index(m_rowCount - 1, ParamCol);
+        emit dataChanged(lastIndex, lastIndex);
+    }
 }
 
 LoggerDisabler::LoggerDisabler(bool silenceAll)
@@ -10,8 +10,10 @@
 
 #pragma once
 
+#include "profiler.h"
 #include "scriptdialogitem.h"
 #include "utils/log.h"
+#include "utils/tracing.h"
 
 #include <QAbstractItemModel>
 #include <QCoreApplication>
@@ -19,8 +21,12 @@
 #include <QString>
 #include <QVariantList>
 #include <concepts>
+#include <deque>
+#include <optional>
 #include <vector>
 
+class QTimer;
+
 /**
  * Create a return value, the name will depend on the type returned.
  */
@@ -28,14 +34,15 @@
 
 /**
  * Log a method, with all its parameters.
+ * The name must be a string literal, so no string is allocated when nothing is logged.
  */
-#define LOG(name, ...) Core::LoggerObject __loggerObject(name, false, ##__VA_ARGS__)
+#define LOG(name, ...) Core::LoggerObject __loggerObject(QStringLiteral(name), false, ##__VA_ARGS__)
 
 /**
  * Log a method, with all its parameters. If the previous log is also the same method, it will be merged into one
  * operation
  */
-#define LOG_AND_MERGE(name, ...) Core::LoggerObject __loggerObject(name, true, ##__VA_ARGS__)
+#define LOG_AND_MERGE(name, ...) Core::LoggerObject __loggerObject(QStringLiteral(name), true, ##__VA_ARGS__)
 
 /**
  * Macro to save the returned value in the historymodel
@@ -144,6 +151,20 @@ public:
 
     void clear();
 
+    /**
+     * @brief Maximum number of calls kept in the history
+     * The oldest calls are removed once the capacity is reached.
+     */
+    void setCapacity(int capacity);
+    int capacity() const { return m_capacity; }
+
+    /**
+     * @brief Inserts the pending calls in the model
+     * New calls are only inserted into the model on a timer, so a script doing many calls doesn't update the views for
+     * each of them. Call this method before accessing the last calls.
+     */
+    void flush();
+
     /**
      * @brief Create a script from 2 points in the history
      * The script is created using 2 rows in the history model. It will create a javascript script.
@@ -199,7 +220,13 @@ private:
 
     void addData(LogData &&data, bool merge);
 
-    std::vector<LogData> m_data;
+    static constexpr int DefaultCapacity = 10000;
+
+    // All calls, the first m_rowCount ones are in the model, and the other ones are pending
+    std::deque<LogData> m_data;
+    int m_rowCount = 0;
+    int m_capacity = DefaultCapacity;
+    QTimer *m_flushTimer = nullptr;
 };
 
 /**
@@ -214,6 +241,12 @@ public:
     explicit LoggerObject(QString name, bool /*unused*/)
         : LoggerObject()
     {
+        // Nested calls are not logged, but they are profiled
+        if (Profiler::isActive())
+            m_profileIndex = Profiler::enter(name);
+#ifdef KNUT_TRACING
+        m_traceScope.emplace(name);
+#endif
         if (!m_canLog)
             return;
 
@@ -234,26 +267,41 @@ public:
     explicit LoggerObject(QString name, bool merge, Ts... params)
         : LoggerObject()
     {
+        if (Profiler::isActive())
+            m_profileIndex = Profiler::enter(name);
+#ifdef KNUT_TRACING
+        m_traceScope.emplace(name);
+#endif
         if (!m_canLog)
             return;
         if (m_model)
             m_model->logData(name, merge, params...);
 
-        QStringList paramList;
-        (paramList.push_back(valueToString(params)), ...);
-        QString result = name + " - " + paramList.join(", ");
-        log(std::move(result));
+        // Only stringify the parameters if the trace is actually written
+        if (spdlog::should_log(spdlog::level::trace)) {
+            QStringList paramList;
+            (paramList.push_back(valueToString(params)), ...);
+            QString result = name + " - " + paramList.join(", ");
+            log(std::move(result));
+        } else {
+            m_canLog = false;
+        }
     }
 
     ~LoggerObject();
 
     template <typename T>
-    void setReturnValue(QString &&name, const T &value)
+    void setReturnValue(const char *name, const T &value)
     {
         if (m_firstLogger && m_model)
-            m_model->setReturnValue(std::move(name), value);
+            m_model->setReturnValue(QString::fromLatin1(name), value);
     }
 
+    // Hard toggle for the API call logging (history and trace), for batch runs. The profiler is not affected.
+    // Must not be called during an API call.
+    static void setEnabled(bool enabled);
+    static bool isEnabled() { return m_enabled; }
+
 private:
     friend HistoryModel;
     friend LoggerDisabler;
@@ -262,7 +310,12 @@ private:
     void log(QString &&string);
 
     inline static bool m_canLog = true;
+    inline static bool m_enabled = true;
     bool m_firstLogger = false;
+    int m_profileIndex = -1;
+#ifdef KNUT_TRACING
+    std::optional<Utils::TraceScope> m_traceScope;
+#endif
 
     inline static HistoryModel *m_model = nullptr;
 };
@@ -13,9 +13,7 @@
 #include "mark_p.h"
 #include "textdocument.h"
 #include "utils/log.h"
-
-#include <QPlainTextEdit>
-#include <QTextDocument>
+#include "utils/metrics.h"
 
 namespace Core {
 
@@ -49,6 +47,46 @@ namespace Core {
  * This read-only property returns the document the mark is coming from.
  */
 
+///////////////////////////////////////////////////////////////////////////////
+// MarkTracker
+///////////////////////////////////////////////////////////////////////////////
+MarkTracker::~MarkTracker()
+{
+    // Marks can outlive their document, they keep their last position
+    for (auto *position : m_positions)
+        position->index = -1;
+}
+
+void MarkTracker::add(TrackedPosition *position)
+{
+    Q_ASSERT(position->index == -1);
+    position->index = static_cast<int>(m_positions.size());
+    m_positions.push_back(position);
+}
+
+void MarkTracker::remove(TrackedPosition *position)
+{
+    if (position->index == -1)
+        return;
+    Q_ASSERT(m_positions.at(position->index) == position);
+
+    // Move the last position in place of the removed one
+    auto *last = m_positions.back();
+    m_positions[position->index] = last;
+    last->index = position->index;
+    m_positions.pop_back();
+    position->index = -1;
+}
+
+void MarkTracker::update(int from, int charsRemoved, int charsAdded)
+{
+    for (auto *position : m_positions)
+        Mark::updateMark(position->value, from, charsRemoved, charsAdded);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// MarkPrivate
+///////////////////////////////////////////////////////////////////////////////
 bool MarkPrivate::checkEditor() const
 {
     if (!m_editor) {
@@ -60,7 +98,7 @@ bool MarkPrivate::checkEditor() const
 
 bool MarkPrivate::isValid() const
 {
-    return m_editor && m_pos >= 0;
+    return m_editor && m_pos.value >= 0;
 }
 
 int MarkPrivate::line() const
@@ -68,9 +106,8 @@ int MarkPrivate::line() const
     if (!checkEditor())
         return -1;
 
-    int line, column;
-    m_editor->convertPosition(m_pos, &line, &column);
-    return line;
+    updateLineColumn();
+    return m_line;
 }
 
 int MarkPrivate::column() const
@@ -78,25 +115,43 @@ int MarkPrivate::column() const
     if (!checkEditor())
         return -1;
 
-    int line, column;
-    m_editor->convertPosition(m_pos, &line, &column);
-    return column;
+    updateLineColumn();
+    return m_column;
 }
 
-void MarkPrivate::update(int from, int charsRemoved, int charsAdded)
+// Scripts reporting a location usually read both the line and the column, the position is only converted once per
+// revision of the document. The position is checked too, as the marks are only updated after a batch of edits.
+void MarkPrivate::updateLineColumn() const
 {
-    Mark::updateMark(m_pos, from, charsRemoved, charsAdded);
+    const int revision = m_editor->contentRevision();
+    if (revision == m_lineColumnRevision && m_pos.value == m_lineColumnPos)
+        return;
+    m_editor->convertPosition(m_pos.value, &m_line, &m_column);
+    m_lineColumnRevision = revision;
+    m_lineColumnPos = m_pos.value;
+}
+
+// MarkPrivate is managed by shared_ptrs in Mark, and can deal with the editor being deleted.
+static Utils::Metrics::Counter &marksAlive()
+{
+    static auto &counter = Utils::Metrics::counter("textdocument.marks_alive");
+    return counter;
 }
 
 MarkPrivate::MarkPrivate(TextDocument *editor, int pos)
-    : QObject(nullptr) // Important to have nullptr here, MarkPrivate is managed by shared_ptrs in Mark, MarkPrivate can
-                       // deal with the editor being deleted.
-    , m_editor(editor)
-    , m_pos(pos)
+    : m_editor(editor)
+    , m_pos {.value = pos}
 {
     Q_ASSERT(editor);
-    auto document = editor->textEdit()->document();
-    connect(document, &QTextDocument::contentsChange, this, &MarkPrivate::update);
+    editor->m_markTracker->add(&m_pos);
+    marksAlive().add();
+}
+
+MarkPrivate::~MarkPrivate()
+{
+    if (m_editor)
+        m_editor->m_markTracker->remove(&m_pos);
+    marksAlive().add(-1);
 }
 
 Mark::Mark(TextDocument *editor, int pos)
@@ -111,7 +166,7 @@ bool Mark::isValid() const
 
 int Mark::position() const
 {
-    return d ? d->m_pos : -1;
+    return d ? d->m_pos.value : -1;
 }
 
 int Mark::line() const
@@ -10,33 +10,73 @@
 
 #pragma once
 
-#include <QObject>
 #include <QPointer>
+#include <vector>
 
 namespace Core {
 
 class TextDocument;
 
-class MarkPrivate : public QObject
+// A position in a text document, kept up to date by the MarkTracker of the document.
+struct TrackedPosition
 {
-    Q_OBJECT
+    int value = -1;
+    // Index in the tracker, -1 if not tracked
+    int index = -1;
+};
+
+// Keeps all the marks and range marks of a TextDocument up to date.
+//
+// The document forwards each change to the tracker, which updates all the positions in one pass. This is a lot
+// cheaper than having each mark connected to QTextDocument::contentsChange: a big query creates a range mark for
+// each capture, and a single edit would then call tens of thousands of slots.
+class MarkTracker
+{
+public:
+    MarkTracker() = default;
+    ~MarkTracker();
+
+    MarkTracker(const MarkTracker &) = delete;
+    MarkTracker &operator=(const MarkTracker &) = delete;
+
+    void add(TrackedPosition *position);
+    void remove(TrackedPosition *position);
+
+    void update(int from, int charsRemoved, int charsAdded);
 
+    qsizetype count() const { return static_cast<qsizetype>(m_positions.size()); }
+
+private:
+    // Unsorted, so adding and removing a position is constant-time
+    std::vector<TrackedPosition *> m_positions;
+};
+
+class MarkPrivate
+{
 public:
     // Unfortunately this needs to be public, as otherwise std::make_shared can't access it
     explicit MarkPrivate(TextDocument *editor, int pos);
+    ~MarkPrivate();
+
+    MarkPrivate(const MarkPrivate &) = delete;
+    MarkPrivate &operator=(const MarkPrivate &) = delete;
 
 private:
     bool isValid() const;
 
     int line() const;
     int column() const;
+    void updateLineColumn() const;
 
     bool checkEditor() const;
 
-    void update(int from, int charsRemoved, int charsAdded);
-
     QPointer<TextDocument> m_editor;
-    int m_pos = -1;
+    TrackedPosition m_pos;
+    // Line and column of the position, computed for the given content revision and position of the document
+    mutable int m_lineColumnRevision = -1;
+    mutable int m_lineColumnPos = -1;
+    mutable int m_line = -1;
+    mutable int m_column = -1;
     friend class Mark;
 };
 
@@ -0,0 +1,309 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "mfcinfo.h"
+#include "treesitter/builtinqueries.h"
+#include "utils/log.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <algorithm>
+#include <kdalgorithms.h>
+
+namespace Core {
+
+// Increment when the way the information is extracted changes, to invalidate existing caches
+constexpr int MfcCacheVersion = 1;
+
+/*!
+ * \qmltype MfcClass
+ * \brief Class or struct found in a file by `Project::mfcExtractAll`.
+ * \inqmlmodule Script
+ * \ingroup CppDocument
+ * \sa MfcFileInfo
+ */
+/*!
+ * \qmlproperty string MfcClass::name
+ * Name of the class.
+ */
+/*!
+ * \qmlproperty array<string> MfcClass::bases
+ * Names of the base classes, if any.
+ */
+/*!
+ * \qmlproperty TextRange MfcClass::range
+ * Range of the class definition in the file.
+ */
+
+QString MfcClass::toString() const
+{
+    return QString("MfcClass{'%1', %2}").arg(name, range.toString());
+}
+
+/*!
+ * \qmltype MfcMessageMapEntry
+ * \brief Entry of a message map found by `Project::mfcExtractAll`.
+ * \inqmlmodule Script
+ * \ingroup CppDocument
+ * \sa MfcMessageMap
+ */
+/*!
+ * \qmlproperty string MfcMessageMapEntry::name
+ * Name of the entry, like `ON_BN_CLICKED`.
+ */
+/*!
+ * \qmlproperty array<string> MfcMessageMapEntry::parameters
+ * Text of each parameter of the entry.
+ */
+/*!
+ * \qmlproperty TextRange MfcMessageMapEntry::range
+ * Range of the entire entry, including parameters.
+ */
+
+QString MfcMessageMapEntry::toString() const
+{
+    return QString("%1(%2)").arg(name, parameters.join(", "));
+}
+
+/*!
+ * \qmltype MfcMessageMap
+ * \brief Message map found by `Project::mfcExtractAll`.
+ * \inqmlmodule Script
+ * \ingroup CppDocument
+ * \sa MfcFileInfo
+ *
+ * Contrary to a `MessageMap`, the message map is not linked to any document: its ranges won't be updated if the
+ * file changes.
+ */
+/*!
+ * \qmlproperty string MfcMessageMap::className
+ * The name of the class this message map belongs to.
+ */
+/*!
+ * \qmlproperty string MfcMessageMap::superClass
+ * The name of the super class this class inherits from.
+ */
+/*!
+ * \qmlproperty array<MfcMessageMapEntry> MfcMessageMap::entries
+ * All entries found in the message map.
+ */
+/*!
+ * \qmlproperty TextRange MfcMessageMap::range
+ * The entire range of the message map, from `BEGIN_MESSAGE_MAP` to `END_MESSAGE_MAP`.
+ */
+
+QString MfcMessageMap::toString() const
+{
+    return QString("MfcMessageMap{'%1', %2}").arg(className).arg(entries.size());
+}
+
+/*!
+ * \qmltype MfcDataExchange
+ * \brief `DoDataExchange` method found by `Project::mfcExtractAll`.
+ * \inqmlmodule Script
+ * \ingroup CppDocument
+ * \sa MfcFileInfo
+ *
+ * Contrary to a `DataExchange`, the data exchange is not linked to any document: its range won't be updated if the
+ * file changes.
+ */
+/*!
+ * \qmlproperty string MfcDataExchange::className
+ * The name of the class this data exchange belongs to.
+ */
+/*!
+ * \qmlproperty array<DataExchangeEntry> MfcDataExchange::entries
+ * All DDX entries found in the method.
+ */
+/*!
+ * \qmlproperty array<DataValidationEntry> MfcDataExchange::validators
+ * All DDV entries found in the method.
+ */
+/*!
+ * \qmlproperty TextRange MfcDataExchange::range
+ * Range of the `DoDataExchange` method definition.
+ */
+
+QString MfcDataExchange::toString() const
+{
+    return QString("MfcDataExchange{'%1', %2, %3}").arg(className).arg(entries.size()).arg(validators.size());
+}
+
+/*!
+ * \qmltype MfcFileInfo
+ * \brief MFC information extracted from a file by `Project::mfcExtractAll`.
+ * \inqmlmodule Script
+ * \ingroup CppDocument
+ * \sa Project::mfcExtractAll
+ */
+/*!
+ * \qmlproperty string MfcFileInfo::fileName
+ * Full path of the file.
+ */
+/*!
+ * \qmlproperty array<MfcClass> MfcFileInfo::classes
+ * All classes and structs defined in the file.
+ */
+/*!
+ * \qmlproperty array<MfcMessageMap> MfcFileInfo::messageMaps
+ * All message maps defined in the file.
+ */
+/*!
+ * \qmlproperty array<MfcDataExchange> MfcFileInfo::dataExchanges
+ * All `DoDataExchange` methods defined in the file.
+ */
+
+QString MfcFileInfo::toString() const
+{
+    return QString("MfcFileInfo{'%1', %2, %3, %4}")
+        .arg(fileName)
+        .arg(classes.size())
+        .arg(messageMaps.size())
+        .arg(dataExchanges.size());
+}
+
+QString MfcFileInfo::query()
+{
+    // All patterns are merged in one query, so each file is only traversed once. The patterns are recognized using
+    // their captures in fromMatches.
+    static const QString queryString = treesitter::builtinQueryText("cpp/mfc_classes")
+        + treesitter::builtinQueryText("cpp/ddx_calls") + treesitter::builtinQueryText("cpp/ddv_calls")
+        + treesitter::builtinQueryText("cpp/message_map");
+    return queryString;
+}
+
+static MfcMessageMap toMessageMap(const FileQueryMatch &match)
+{
+    MfcMessageMap messageMap {.className = match.get("class").text,
+                              .superClass = match.get("superclass").text,
+                              .range = {.start = match.get("begin").range.start, .end = match.get("end").range.end}};
+
+    const auto names = match.getAll("message-name");
+    const auto parameters = match.getAll("parameter");
+    const auto messages = match.getAll("message");
+    for (const auto &message : messages) {
+        MfcMessageMapEntry entry {.range = message.range};
+        if (auto name = kdalgorithms::find_if(names, [&message](const auto &capture) {
+                return message.range.contains(capture.range);
+            }))
+            entry.name = name->text;
+        for (const auto &parameter : parameters) {
+            if (message.range.contains(parameter.range))
+                entry.parameters.push_back(parameter.text);
+        }
+        messageMap.entries.push_back(std::move(entry));
+    }
+    return messageMap;
+}
+
+/**
+ * Creates the MFC information from the matches of the `query()` in the file `fileName`.
+ *
+ * The DDX and DDV calls are matched everywhere in the file, and then assigned to the `DoDataExchange` method
+ * containing them.
+ */
+MfcFileInfo MfcFileInfo::fromMatches(const QString &fileName, const FileQueryMatchList &matches)
+{
+    MfcFileInfo info {.fileName = fileName};
+
+    std::vector<std::pair<TextRange, DataExchangeEntry>> ddxCalls;
+    std::vector<std::pair<TextRange, DataValidationEntry>> ddvCalls;
+
+    for (const auto &match : matches) {
+        if (const auto begin = match.get("begin"); !begin.name.isEmpty()) {
+            auto messageMap = toMessageMap(match);
+            // The message map pattern may match the same map multiple times, keep the most complete one
+            auto existing = std::ranges::find(info.messageMaps, messageMap.range.start, [](const auto &map) {
+                return map.range.start;
+            });
+            if (existing == info.messageMaps.end())
+                info.messageMaps.push_back(std::move(messageMap));
+            else if (existing->entries.size() < messageMap.entries.size())
+                *existing = std::move(messageMap);
+        } else if (const auto classDefinition = match.get("class-definition"); !classDefinition.name.isEmpty()) {
+            auto bases = kdalgorithms::transformed(match.getAll("class-base"), &FileQueryCapture::text);
+            info.classes.push_back(
+                {.name = match.get("class-name").text, .bases = std::move(bases), .range = classDefinition.range});
+        } else if (const auto ddxDefinition = match.get("ddx-definition"); !ddxDefinition.name.isEmpty()) {
+            info.dataExchanges.push_back({.className = match.get("ddx-class").text, .range = ddxDefinition.range});
+        } else if (const auto ddx = match.get("ddx"); !ddx.name.isEmpty()) {
+            ddxCalls.emplace_back(ddx.range,
+                                  DataExchangeEntry {.function = match.get("ddx-function").text,
+                                                     .idc = match.get("ddx-idc").text,
+                                                     .member = match.get("ddx-member").text});
+        } else if (const auto ddv = match.get("ddv"); !ddv.name.isEmpty()) {
+            ddvCalls.emplace_back(
+                ddv.range,
+                DataValidationEntry {.function = match.get("ddv-function").text,
+                                     .member = match.get("ddv-member").text,
+                                     .arguments = kdalgorithms::transformed(match.getAll("ddv-arguments"),
+                                                                            &FileQueryCapture::text)});
+        }
+    }
+
+    for (auto &dataExchange : info.dataExchanges) {
+        for (const auto &[range, entry] : ddxCalls) {
+            if (dataExchange.range.contains(range))
+                dataExchange.entries.push_back(entry);
+        }
+        for (const auto &[range, entry] : ddvCalls) {
+            if (dataExchange.range.contains(range))
+                dataExchange.validators.push_back(entry);
+        }
+    }
+
+    return info;
+}
+
+QHash<QString, MfcFileInfo> MfcFileInfo::loadCache(const QString &cacheFile)
+{
+    QFile file(cacheFile);
+    if (!file.open(QIODevice::ReadOnly))
+        return {};
+
+    QHash<QString, MfcFileInfo> cache;
+    try {
+        const auto json = nlohmann::json::parse(file.readAll().constData());
+        if (json.at("version").get<int>() != MfcCacheVersion)
+            return {};
+        auto infos = json.at("files").get<std::vector<MfcFileInfo>>();
+        for (auto &info : infos)
+            cache.insert(info.fileName, std::move(info));
+    } catch (...) {
+        spdlog::warn("MfcFileInfo::loadCache - invalid cache file {}", cacheFile);
+        return {};
+    }
+    return cache;
+}
+
+void MfcFileInfo::saveCache(const QString &cacheFile, const QVector<MfcFileInfo> &infos)
+{
+    const auto directory = QFileInfo(cacheFile).absolutePath();
+    if (!QDir().mkpath(directory)) {
+        spdlog::warn("MfcFileInfo::saveCache - can't create cache directory {}", directory);
+        return;
+    }
+
+    const nlohmann::json json = {{"version", MfcCacheVersion}, {"files", infos}};
+
+    // Use a QSaveFile, so another Knut instance never reads a partial file
+    QSaveFile file(cacheFile);
+    if (!file.open(QIODevice::WriteOnly)) {
+        spdlog::warn("MfcFileInfo::saveCache - can't write cache file {}", cacheFile);
+        return;
+    }
+    file.write(QByteArray::fromStdString(json.dump()));
+    if (!file.commit())
+        spdlog::warn("MfcFileInfo::saveCache - can't write cache file {}", cacheFile);
+}
+
+} // namespace Core
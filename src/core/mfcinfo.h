@@ -0,0 +1,131 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include "dataexchange.h"
+#include "filequerymatch.h"
+#include "textrange.h"
+#include "utils/json.h"
+
+#include <QHash>
+#include <QObject>
+#include <QVector>
+
+namespace Core {
+
+// Lightweight versions of the MFC structs (MessageMap, DataExchange...), not backed by any document.
+// They are returned by Project::mfcExtractAll, used to analyze a whole project without opening all files.
+
+struct MfcClass
+{
+    Q_GADGET
+    Q_PROPERTY(QString name MEMBER name CONSTANT)
+    Q_PROPERTY(QStringList bases MEMBER bases CONSTANT)
+    Q_PROPERTY(Core::TextRange range MEMBER range CONSTANT)
+
+public:
+    QString name;
+    QStringList bases;
+    TextRange range {};
+
+    Q_INVOKABLE QString toString() const;
+};
+
+struct MfcMessageMapEntry
+{
+    Q_GADGET
+    Q_PROPERTY(QString name MEMBER name CONSTANT)
+    Q_PROPERTY(QStringList parameters MEMBER parameters CONSTANT)
+    Q_PROPERTY(Core::TextRange range MEMBER range CONSTANT)
+
+public:
+    QString name;
+    QStringList parameters;
+    TextRange range {};
+
+    Q_INVOKABLE QString toString() const;
+};
+
+struct MfcMessageMap
+{
+    Q_GADGET
+    Q_PROPERTY(QString className MEMBER className CONSTANT)
+    Q_PROPERTY(QString superClass MEMBER superClass CONSTANT)
+    Q_PROPERTY(QVector<Core::MfcMessageMapEntry> entries MEMBER entries CONSTANT)
+    Q_PROPERTY(Core::TextRange range MEMBER range CONSTANT)
+
+public:
+    QString className;
+    QString superClass;
+    QVector<MfcMessageMapEntry> entries;
+    TextRange range {};
+
+    Q_INVOKABLE QString toString() const;
+};
+
+struct MfcDataExchange
+{
+    Q_GADGET
+    Q_PROPERTY(QString className MEMBER className CONSTANT)
+    Q_PROPERTY(QVector<Core::DataExchangeEntry> entries MEMBER entries CONSTANT)
+    Q_PROPERTY(QVector<Core::DataValidationEntry> validators MEMBER validators CONSTANT)
+    Q_PROPERTY(Core::TextRange range MEMBER range CONSTANT)
+
+public:
+    QString className;
+    QVector<DataExchangeEntry> entries;
+    QVector<DataValidationEntry> validators;
+    TextRange range {};
+
+    Q_INVOKABLE QString toString() const;
+};
+
+struct MfcFileInfo
+{
+    Q_GADGET
+    Q_PROPERTY(QString fileName MEMBER fileName CONSTANT)
+    Q_PROPERTY(QVector<Core::MfcClass> classes MEMBER classes CONSTANT)
+    Q_PROPERTY(QVector<Core::MfcMessageMap> messageMaps MEMBER messageMaps CONSTANT)
+    Q_PROPERTY(QVector<Core::MfcDataExchange> dataExchanges MEMBER dataExchanges CONSTANT)
+
+public:
+    QString fileName;
+    // Modification time of the file (in ms since epoch) when the information was extracted, used by the cache
+    qint64 lastModified = 0;
+    QVector<MfcClass> classes;
+    QVector<MfcMessageMap> messageMaps;
+    QVector<MfcDataExchange> dataExchanges;
+
+    Q_INVOKABLE QString toString() const;
+
+    // Query extracting all the MFC information from a C++ file in one pass, see fromMatches
+    static QString query();
+    static MfcFileInfo fromMatches(const QString &fileName, const FileQueryMatchList &matches);
+
+    static QHash<QString, MfcFileInfo> loadCache(const QString &cacheFile);
+    static void saveCache(const QString &cacheFile, const QVector<MfcFileInfo> &infos);
+};
+
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(DataExchangeEntry, function, idc, member);
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(DataValidationEntry, function, member, arguments);
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(MfcClass, name, bases, range);
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(MfcMessageMapEntry, name, parameters, range);
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(MfcMessageMap, className, superClass, entries, range);
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(MfcDataExchange, className, entries, validators, range);
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(MfcFileInfo, fileName, lastModified, classes, messageMaps, dataExchanges);
+
+} // namespace Core
+
+Q_DECLARE_METATYPE(Core::MfcClass)
+Q_DECLARE_METATYPE(Core::MfcMessageMapEntry)
+Q_DECLARE_METATYPE(Core::MfcMessageMap)
+Q_DECLARE_METATYPE(Core::MfcDataExchange)
+Q_DECLARE_METATYPE(Core::MfcFileInfo)
@@ -0,0 +1,201 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "parallelscriptrunner.h"
+#include "project.h"
+#include "utils/log.h"
+#include "utils/resultwriter.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QProcess>
+#include <QTemporaryDir>
+#include <QThread>
+#include <algorithm>
+#include <iostream>
+
+namespace Core {
+
+ParallelScriptRunner::ParallelScriptRunner(QObject *parent)
+    : QObject(parent)
+    , m_jobs(QThread::idealThreadCount())
+{
+}
+
+ParallelScriptRunner::~ParallelScriptRunner() = default;
+
+QRegularExpression ParallelScriptRunner::globToRegularExpression(const QString &pattern)
+{
+    QString regexp;
+    regexp.reserve(pattern.size() * 2);
+    int braces = 0;
+    for (int i = 0; i < pattern.size(); ++i) {
+        const QChar ch = pattern.at(i);
+        if (ch == '*' && i + 1 < pattern.size() && pattern.at(i + 1) == '*') {
+            // `**/` matches zero or more directories, a trailing `**` matches everything
+            if (i + 2 < pattern.size() && pattern.at(i + 2) == '/') {
+                regexp += "(?:.*/)?";
+                i += 2;
+            } else {
+                regexp += ".*";
+                ++i;
+            }
+        } else if (ch == '*') {
+            regexp += "[^/]*";
+        } else if (ch == '?') {
+            regexp += "[^/]";
+        } else if (ch == '{' && pattern.indexOf('}', i + 1) != -1) {
+            // `{h,cpp}` matches one of the alternatives
+            regexp += "(?:";
+            ++braces;
+        } else if (ch == '}' && braces > 0) {
+            regexp += ')';
+            --braces;
+        } else if (ch == ',' && braces > 0) {
+            regexp += '|';
+        } else {
+            regexp += QRegularExpression::escape(QString(ch));
+        }
+    }
+    return QRegularExpression(QRegularExpression::anchoredPattern(regexp));
+}
+
+QStringList ParallelScriptRunner::matchingFiles(const QString &pattern)
+{
+    const auto regexp = globToRegularExpression(QDir::fromNativeSeparators(pattern));
+    QStringList files = Project::instance()->allFiles(Project::RelativeToRoot);
+    files.removeIf([&regexp](const QString &file) {
+        return !regexp.match(file).hasMatch();
+    });
+    files.sort();
+    return files;
+}
+
+void ParallelScriptRunner::setJobs(int jobs)
+{
+    m_jobs = jobs > 0 ? jobs : QThread::idealThreadCount();
+}
+
+void ParallelScriptRunner::run(const QString &script, const QStringList &files)
+{
+    m_script = QFileInfo(script).absoluteFilePath();
+    m_files = files;
+    m_next = 0;
+    m_running = 0;
+    m_exitCode = 0;
+    m_failedFiles.clear();
+    m_resultsDir.reset();
+    m_resultsFiles.clear();
+    if (::Utils::ResultWriter::isOpen()) {
+        m_resultsDir = std::make_unique<QTemporaryDir>();
+        if (!m_resultsDir->isValid()) {
+            spdlog::error("ParallelScriptRunner::run - can't create a directory for the results: {}",
+                          m_resultsDir->errorString());
+            m_resultsDir.reset();
+        }
+    }
+
+    if (m_files.isEmpty()) {
+        spdlog::warn("ParallelScriptRunner::run - no files to process with {}", m_script);
+        emit finished(0);
+        return;
+    }
+
+    spdlog::info("ParallelScriptRunner::run - running {} on {} files with {} jobs", m_script, m_files.size(),
+                 std::min<int>(m_jobs, m_files.size()));
+    for (int i = 0; i < m_jobs && m_next < m_files.size(); ++i)
+        startNext();
+}
+
+void ParallelScriptRunner::startNext()
+{
+    const int index = m_next++;
+    const QString fileName = m_files.at(index);
+    auto process = new QProcess(this);
+    process->setProcessChannelMode(QProcess::MergedChannels);
+    connect(process, &QProcess::readyReadStandardOutput, this, [this, process, fileName]() {
+        forwardOutput(process, fileName);
+    });
+    connect(process, &QProcess::finished, this, [this, process, fileName](int exitCode, QProcess::ExitStatus status) {
+        handleFinished(process, fileName, exitCode, status == QProcess::CrashExit);
+    });
+    connect(process, &QProcess::errorOccurred, this, [this, process, fileName](QProcess::ProcessError error) {
+        // Other errors are followed by the finished signal
+        if (error == QProcess::FailedToStart)
+            handleFinished(process, fileName, 1, true);
+    });
+
+    QStringList arguments {Project::instance()->root(), "--run", m_script, "--input", fileName};
+    // Each worker has its own results file, the processes can't share the results file
+    if (m_resultsDir) {
+        const QString results = m_resultsDir->filePath(QString::number(index) + ".jsonl");
+        m_resultsFiles.insert(process, results);
+        arguments.append({"--results", results});
+    }
+    ++m_running;
+    process->start(QCoreApplication::applicationFilePath(), arguments);
+}
+
+void ParallelScriptRunner::forwardOutput(QProcess *process, const QString &fileName, bool flush)
+{
+    const std::string prefix = "[" + fileName.toStdString() + "] ";
+    while (process->canReadLine())
+        std::cout << prefix << process->readLine().toStdString();
+    if (flush) {
+        const QByteArray rest = process->readAll();
+        if (!rest.isEmpty())
+            std::cout << prefix << rest.toStdString() << '\n';
+    }
+    std::cout.flush();
+}
+
+void ParallelScriptRunner::handleFinished(QProcess *process, const QString &fileName, int exitCode, bool crashed)
+{
+    forwardOutput(process, fileName, true);
+    process->deleteLater();
+    --m_running;
+
+    // The results of a failed worker are kept, they may still be useful
+    if (m_resultsDir) {
+        const QString results = m_resultsFiles.take(process);
+        if (QFile::exists(results) && !::Utils::ResultWriter::append(results))
+            spdlog::error("ParallelScriptRunner - can't read the results of {}", fileName);
+        QFile::remove(results);
+    }
+
+    if (crashed || exitCode != 0) {
+        spdlog::error("ParallelScriptRunner - {} failed on {}: {}", m_script, fileName,
+                      crashed ? process->errorString() : QString("exit code %1").arg(exitCode));
+        m_failedFiles.push_back(fileName);
+        if (m_exitCode == 0)
+            m_exitCode = crashed ? 1 : exitCode;
+    }
+
+    if (m_next < m_files.size()) {
+        startNext();
+        return;
+    }
+    if (m_running > 0)
+        return;
+
+    const auto processed = m_files.size() - m_failedFiles.size();
+    if (m_failedFiles.isEmpty()) {
+        spdlog::info("ParallelScriptRunner - {} files processed", processed);
+    } else {
+        m_failedFiles.sort();
+        spdlog::error("ParallelScriptRunner - {} files processed, {} failed: {}", processed, m_failedFiles.size(),
+                      m_failedFiles.join(", "));
+    }
+    emit finished(m_exitCode);
+}
+
+} // namespace Core
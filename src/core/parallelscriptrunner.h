@@ -0,0 +1,78 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QHash>
+#include <QObject>
+#include <QRegularExpression>
+#include <QStringList>
+#include <memory>
+
+class QProcess;
+class QTemporaryDir;
+
+namespace Core {
+
+/**
+ * \brief Runs one script on many files in parallel
+ *
+ * Each file is processed by its own Knut process (`knut <root> --run <script> --input <file>`), so each worker has
+ * its own script engine, project and documents: none of the singletons are shared between workers. The output of
+ * each worker is forwarded line by line, prefixed with the file name, and the exit codes are aggregated.
+ *
+ * If a results file is opened (see Utils::ResultWriter), each worker writes its results in its own temporary file,
+ * appended to the results file once the worker is done.
+ */
+class ParallelScriptRunner : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ParallelScriptRunner(QObject *parent = nullptr);
+    ~ParallelScriptRunner() override;
+
+    // Returns a regular expression matching the same paths as the glob `pattern`
+    // `**/` matches any number of directories, `*` and `?` don't match across directories, `{h,cpp}` matches one of the
+    // alternatives.
+    static QRegularExpression globToRegularExpression(const QString &pattern);
+    // Returns all files of the current project, relative to its root, matching the glob `pattern`
+    static QStringList matchingFiles(const QString &pattern);
+
+    void setJobs(int jobs);
+    int jobs() const { return m_jobs; }
+
+    // Runs `script` on all `files`, the files are relative to the project root
+    void run(const QString &script, const QStringList &files);
+
+    QStringList failedFiles() const { return m_failedFiles; }
+
+signals:
+    // Emitted once all files are processed, the exit code is the exit code of the first failure, 0 otherwise
+    void finished(int exitCode);
+
+private:
+    void startNext();
+    void forwardOutput(QProcess *process, const QString &fileName, bool flush = false);
+    void handleFinished(QProcess *process, const QString &fileName, int exitCode, bool crashed);
+
+    QString m_script;
+    QStringList m_files;
+    int m_jobs = 0;
+    int m_next = 0;
+    int m_running = 0;
+    int m_exitCode = 0;
+    QStringList m_failedFiles;
+    // Results files of the workers, if a results file is opened
+    std::unique_ptr<QTemporaryDir> m_resultsDir;
+    QHash<QProcess *, QString> m_resultsFiles;
+};
+
+} // namespace Core
@@ -0,0 +1,107 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "profiler.h"
+#include "utils/log.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QThread>
+#include <nlohmann/json.hpp>
+#include <vector>
+
+namespace Core {
+
+struct ProfileEvent
+{
+    QString name;
+    qint64 start = 0;
+    // -1 while the event is not finished
+    qint64 duration = -1;
+};
+
+struct ProfileData
+{
+    QString fileName;
+    QElapsedTimer timer;
+    std::vector<ProfileEvent> events;
+};
+
+static ProfileData &profileData()
+{
+    static ProfileData data;
+    return data;
+}
+
+void Profiler::start(const QString &fileName)
+{
+    auto &data = profileData();
+    data.fileName = fileName;
+    data.events.clear();
+    data.events.reserve(64 * 1024);
+    data.timer.start();
+    m_active = true;
+}
+
+int Profiler::enter(const QString &name)
+{
+    if (!m_active || QThread::currentThread() != qApp->thread())
+        return -1;
+
+    auto &data = profileData();
+    data.events.push_back({name, data.timer.nsecsElapsed()});
+    return static_cast<int>(data.events.size() - 1);
+}
+
+void Profiler::exit(int index)
+{
+    auto &data = profileData();
+    if (index < 0 || index >= static_cast<int>(data.events.size()))
+        return;
+    auto &event = data.events[index];
+    event.duration = data.timer.nsecsElapsed() - event.start;
+}
+
+bool Profiler::stop()
+{
+    if (!m_active)
+        return true;
+    m_active = false;
+
+    auto &data = profileData();
+    const qint64 end = data.timer.nsecsElapsed();
+
+    // Chrome trace event format, using complete events (ph: X), with timestamps in microseconds
+    nlohmann::json events = nlohmann::json::array();
+    const auto pid = QCoreApplication::applicationPid();
+    for (const auto &event : data.events) {
+        const qint64 duration = event.duration < 0 ? end - event.start : event.duration;
+        events.push_back({{"name", event.name.toStdString()},
+                          {"ph", "X"},
+                          {"ts", event.start / 1000.0},
+                          {"dur", duration / 1000.0},
+                          {"pid", pid},
+                          {"tid", 1}});
+    }
+    const nlohmann::json trace = {{"traceEvents", std::move(events)}, {"displayTimeUnit", "ms"}};
+    data.events.clear();
+
+    QFile file(data.fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        spdlog::error("Profiler::stop - can't write the profile to {}: {}", data.fileName, file.errorString());
+        return false;
+    }
+    file.write(QByteArray::fromStdString(trace.dump()));
+    spdlog::info("Profiler::stop - profile saved to {}", data.fileName);
+    return true;
+}
+
+} // namespace Core
@@ -0,0 +1,67 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QString>
+
+namespace Core {
+
+/**
+ * \brief Records the time spent in each API call and script
+ *
+ * The profiler is disabled by default, and enabled with `knut --profile <file>`. Once enabled, all API calls logged
+ * with LOG or LOG_AND_MERGE, nested calls included, are recorded with their start time and duration. The time spent in
+ * the javascript code itself is what remains in the script event once its API calls are removed.
+ *
+ * The trace is saved in the Chrome trace event format, which can be opened with chrome://tracing, Perfetto or
+ * speedscope.
+ *
+ * Only the calls done from the main thread are recorded.
+ */
+class Profiler
+{
+public:
+    // RAII helper to record a scope
+    class Scope
+    {
+    public:
+        explicit Scope(const QString &name)
+            : m_index(Profiler::isActive() ? Profiler::enter(name) : -1)
+        {
+        }
+        ~Scope()
+        {
+            if (m_index >= 0)
+                Profiler::exit(m_index);
+        }
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        int m_index;
+    };
+
+    // Starts recording, the trace will be saved in `fileName`
+    static void start(const QString &fileName);
+    // Stops recording and saves the trace, returns false if the file can't be written
+    static bool stop();
+
+    static bool isActive() { return m_active; }
+
+    // Returns the index of the event, to pass to exit, or -1 if the event is not recorded
+    static int enter(const QString &name);
+    static void exit(int index);
+
+private:
+    inline static bool m_active = false;
+};
+
+} // namespace Core
@@ -10,10 +10,12 @@
 
 #include "project.h"
 #include "cppdocument.h"
+#include "cppdocument_p.h"
 #include "imagedocument.h"
 #include "jsondocument.h"
 #include "logger.h"
 #include "lsp/client.h"
+#include "parallelscriptrunner.h"
 #include "project_p.h"
 #include "qmldocument.h"
 #include "qttsdocument.h"
@@ -22,15 +24,34 @@
 #include "settings.h"
 #include "slintdocument.h"
 #include "textdocument.h"
+#include "textlocation.h"
+#include "treesitter/builtinqueries.h"
+#include "treesitter/parserpool.h"
+#include "treesitter/predicates.h"
+#include "treesitter/query.h"
+#include "treesitter/querycache.h"
+#include "treesitter/transformation.h"
+#include "treesitter/tree.h"
 #include "utils/log.h"
+#include "utils/memoryaccounting.h"
+#include "utils/qtuiwriter.h"
+#include "utils/string_helper.h"
+#include "utils/xml_helper.h"
 
+#include <QDateTime>
 #include <QDir>
-#include <QDirIterator>
+#include <QFile>
 #include <QFileInfo>
 #include <QMetaEnum>
+#include <QRegularExpression>
+#include <QSet>
+#include <QTextStream>
+#include <QUrl>
+#include <QtConcurrent/QtConcurrentMap>
 #include <algorithm>
 #include <kdalgorithms.h>
 #include <map>
+#include <unordered_map>
 #include <unordered_set>
 
 namespace Core {
@@ -70,6 +91,9 @@ Project::~Project()
 
     closeAll();
 
+    if (m_scriptCache.hasChanged() && !m_scriptCacheFile.isEmpty())
+        m_scriptCache.save(m_scriptCacheFile);
+
     for (auto client : m_lspClients | std::views::values)
         client->shutdown();
 }
@@ -100,17 +124,51 @@ bool Project::setRoot(const QString &newRoot)
     }
 
     m_root = dir.absolutePath();
+    m_fileIndex.setRoot(m_root);
+    m_correspondingFiles.clear();
+    m_prefetcher.clear();
+    m_readAheadFiles.clear();
     Settings::instance()->loadProjectSettings(m_root);
-    for (auto client : m_lspClients | std::views::values)
-        client->openProject(m_root);
+    updateFileIndexSettings();
+    // The project settings may be changed by a script, or by editing knut.json
+    connect(Settings::instance(), &Settings::settingsLoaded, this, &Project::updateFileIndexSettings,
+            Qt::UniqueConnection);
+    connect(Settings::instance(), &Settings::settingsChanged, this, &Project::updateFileIndexSettings,
+            Qt::UniqueConnection);
+    // Servers of a subtree are already opened on their own root
+    for (const auto &[key, client] : m_lspClients) {
+        if (key.second.isEmpty())
+            client->openProject(m_root);
+    }
 
     emit rootChanged();
     return true;
 }
 
+void Project::updateFileIndexSettings()
+{
+    m_fileIndex.setExcludes(Settings::instance()->value<QStringList>(Settings::ProjectExcludes));
+    m_fileIndex.setUseGitIgnore(Settings::instance()->value<bool>(Settings::ProjectUseGitIgnore));
+}
+
+// Files in the index are full paths, all inside the root directory
+static QStringList toPathType(QStringList files, Project::PathType type, const QString &root)
+{
+    if (type == Project::RelativeToRoot) {
+        const auto rootSize = root.size() + 1;
+        for (auto &file : files)
+            file.remove(0, rootSize);
+    }
+    return files;
+}
+
 /*!
  * \qmlmethod array<string> Project::allFiles(PathType type = RelativeToRoot)
  * Returns all files in the current project.
+ *
+ * Hidden files, files matching one of the `/project/excludes` globs and, if `/project/use_gitignore` is true, files
+ * ignored by git are not part of the project. Excluded directories are not even scanned.
+ *
  * `type` defines the type of path, and can be one of those values:
  *
  * - `Project.FullPath`
@@ -123,17 +181,8 @@ QStringList Project::allFiles(PathType type) const
 
     LOG("Project::allFiles", type);
 
-    QDir dir(m_root);
-    QDirIterator it(m_root, QDirIterator::Subdirectories);
-    QStringList result;
-    while (it.hasNext()) {
-        it.next();
-        auto fi = it.fileInfo();
-        if (fi.isFile())
-            result.push_back(type == FullPath ? fi.absoluteFilePath() : dir.relativeFilePath(fi.absoluteFilePath()));
-    }
-    std::ranges::sort(result);
-    return result;
+    m_readAheadFiles = m_fileIndex.files();
+    return toPathType(m_readAheadFiles, type, m_root);
 }
 
 /*!
@@ -151,17 +200,8 @@ QStringList Project::allFilesWithExtension(const QString &extension, PathType ty
 
     LOG("Project::allFilesWithExtension", extension, type);
 
-    QDir dir(m_root);
-    QDirIterator it(m_root, QDirIterator::Subdirectories);
-    QStringList result;
-    while (it.hasNext()) {
-        it.next();
-        auto fi = it.fileInfo();
-        if (fi.isFile() && fi.suffix() == extension)
-            result.push_back(type == FullPath ? fi.absoluteFilePath() : dir.relativeFilePath(fi.absoluteFilePath()));
-    }
-    std::ranges::sort(result);
-    return result;
+    m_readAheadFiles = m_fileIndex.filesWithSuffix(extension);
+    return toPathType(m_readAheadFiles, type, m_root);
 }
 
 /*!
@@ -179,31 +219,28 @@ QStringList Project::allFilesWithExtensions(const QStringList &extensions, PathT
 
     LOG("Project::allFilesWithExtensions", extensions, type);
 
-    QDir dir(m_root);
-    QDirIterator it(m_root, QDirIterator::Subdirectories);
-    QStringList result;
-    while (it.hasNext()) {
-        it.next();
-        auto fi = it.fileInfo();
-        if (fi.isFile() && extensions.contains(fi.suffix(), Qt::CaseInsensitive))
-            result.push_back(type == FullPath ? fi.absoluteFilePath() : dir.relativeFilePath(fi.absoluteFilePath()));
-    }
-    std::ranges::sort(result);
-    return result;
+    m_readAheadFiles = m_fileIndex.filesWithSuffixes(extensions, Qt::CaseInsensitive);
+    return toPathType(m_readAheadFiles, type, m_root);
 }
 
-static Document *createDocument(const QString &suffix)
+static Document::Type documentType(const QString &suffix)
 {
-    static const auto mimeTypes =
-        Settings::instance()->value<std::map<std::string, Document::Type>>(Settings::MimeTypes);
+    const auto mimeTypes =
+        Settings::instance()->valuePtr<std::map<std::string, Document::Type>>(Settings::MimeTypes);
+    if (!mimeTypes)
+        return Document::Type::Text;
 
-    auto it = mimeTypes.find(suffix.toStdString());
-    if (it == mimeTypes.end()) {
+    auto it = mimeTypes->find(suffix.toStdString());
+    if (it == mimeTypes->end()) {
         // No mime found, so, just open it as text
-        return new TextDocument();
+        return Document::Type::Text;
     }
+    return it->second;
+}
 
-    switch (it->second) {
+static Document *createDocument(const QString &suffix)
+{
+    switch (documentType(suffix)) {
     case Document::Type::Cpp:
         return new CppDocument();
     case Document::Type::Text:
@@ -229,35 +266,1047 @@ static Document *createDocument(const QString &suffix)
     return nullptr;
 }
 
-Lsp::Client *Project::getClient(Document::Type type)
+struct FileQueryInput
+{
+    QString fileName;
+    // Text of the document if already opened, otherwise the file is read by the worker
+    std::optional<QString> text;
+    const TSLanguage *language;
+    // The query, compiled for the language of the file
+    std::shared_ptr<treesitter::Query> query;
+    // Parse timeout in milliseconds, 0 means no limit
+    int parseTimeout = 0;
+};
+
+static QString readFileText(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        spdlog::warn("Project::queryAll - can't read file {}: {}", fileName, file.errorString());
+        return {};
+    }
+    QTextStream stream(&file);
+    QString text = stream.readAll();
+    // Match the text of a TextDocument, so the ranges are the same as if the file was opened
+    text.replace("\r\n", "\n");
+    text.replace('\r', '\n');
+    text.replace(QChar::Nbsp, ' ');
+    return text;
+}
+
+static FileQueryMatchList queryFile(const FileQueryInput &input)
+{
+    const QString text = input.text ? *input.text : readFileText(input.fileName);
+    if (text.isEmpty())
+        return {};
+
+    auto parser = treesitter::ParserPool::instance().acquire(input.language);
+    parser->setTimeout(std::chrono::milliseconds(input.parseTimeout));
+    const auto tree = parser->parseString(text);
+    if (!tree) {
+        spdlog::warn("Project::queryAll - failed to parse file {}, or parsing timed out", input.fileName);
+        return {};
+    }
+
+    treesitter::QueryCursor cursor;
+    cursor.execute(input.query, tree->rootNode(), std::make_unique<treesitter::Predicates>(text));
+    const auto matches = cursor.allRemainingMatches();
+
+    FileQueryMatchList result;
+    result.reserve(matches.size());
+    for (const auto &match : matches)
+        result.emplace_back(input.fileName, text, match);
+    return result;
+}
+
+/*!
+ * \qmlmethod array<FileQueryMatch> Project::queryAll(array<string> extensions, string query)
+ * Runs the [Tree-sitter query](https://tree-sitter.github.io/tree-sitter/using-parsers#pattern-matching-with-queries)
+ * `query` on all files with an extension from `extensions` in the current project, and returns all matches. Only
+ * files with a Tree-sitter grammar (C++ and QML) are queried, the query is compiled for the grammar of each file.
+ *
+ * Files are parsed and queried in parallel, without opening them in Knut. Documents already opened are queried
+ * using their current text. Files taking longer to parse than the `/treesitter/parse_timeout` setting are skipped.
+ *
+ * ```js
+ * let matches = Project.queryAll(["cpp", "h"], "(function_definition declarator: (_) @declarator)");
+ * for (let match of matches)
+ *     Message.log(match.fileName + ": " + match.get("declarator").text);
+ * ```
+ */
+FileQueryMatchList Project::queryAll(const QStringList &extensions, const QString &query)
+{
+    LOG("Project::queryAll", extensions, query);
+
+    // The query is compiled once per language, a failed compilation is stored as nullptr
+    std::unordered_map<const TSLanguage *, std::shared_ptr<treesitter::Query>> queries;
+    auto queryForLanguage = [&](const TSLanguage *language) {
+        auto it = queries.find(language);
+        if (it != queries.end())
+            return it->second;
+        std::shared_ptr<treesitter::Query> tsQuery;
+        try {
+            tsQuery = treesitter::QueryCache::instance().query(language, query);
+        } catch (treesitter::Query::Error &error) {
+            spdlog::error("Project::queryAll: Failed to parse query `{}` error: {} at: {}", query, error.description,
+                          error.utf8_offset);
+        }
+        queries[language] = tsQuery;
+        return tsQuery;
+    };
+
+    // Documents can only be accessed from the main thread, gather their text before dispatching the work
+    // Settings can't be read from the worker threads
+    const auto parseTimeout = Settings::instance()->value<int>(Settings::TreeSitterParseTimeout);
+    QVector<FileQueryInput> inputs;
+    const auto files = allFilesWithExtensions(extensions, FullPath);
+    for (const auto &fileName : files) {
+        const auto language = CodeDocument::treeSitterLanguage(documentType(QFileInfo(fileName).suffix()));
+        if (!language)
+            continue;
+        auto tsQuery = queryForLanguage(language);
+        if (!tsQuery)
+            continue;
+        auto textDocument = qobject_cast<TextDocument *>(findDocument(fileName));
+        inputs.push_back({fileName, textDocument ? std::optional<QString>(textDocument->text()) : std::nullopt,
+                          language, std::move(tsQuery), parseTimeout});
+    }
+
+    const auto results = QtConcurrent::blockingMapped<QVector<FileQueryMatchList>>(inputs, queryFile);
+
+    FileQueryMatchList matches;
+    for (const auto &result : results)
+        matches.append(result);
+    return matches;
+}
+
+static MfcFileInfo extractMfcInfo(const FileQueryInput &input)
+{
+    return MfcFileInfo::fromMatches(input.fileName, queryFile(input));
+}
+
+/*!
+ * \qmlmethod array<MfcFileInfo> Project::mfcExtractAll(string cacheFile = "")
+ * Extracts the MFC information (classes, message maps and `DoDataExchange` methods) of all C++ files in the current
+ * project, and returns one `MfcFileInfo` per file.
+ *
+ * All the information is extracted with a single query per file, and the files are parsed in parallel without
+ * opening them in Knut. Documents already opened are extracted using their current text.
+ *
+ * If `cacheFile` is set, the result is stored in this file, and files that have not been modified since the last
+ * extraction are not parsed again. If the path is relative, it's relative to the project root directory.
+ *
+ * ```js
+ * for (let info of Project.mfcExtractAll(".knut/mfc.json")) {
+ *     for (let map of info.messageMaps)
+ *         Message.log(map.className + ": " + map.entries.length + " messages");
+ * }
+ * ```
+ */
+QVector<MfcFileInfo> Project::mfcExtractAll(const QString &cacheFile)
+{
+    LOG("Project::mfcExtractAll", cacheFile);
+
+    const auto language = CodeDocument::treeSitterLanguage(Document::Type::Cpp);
+    std::shared_ptr<treesitter::Query> tsQuery;
+    try {
+        tsQuery = treesitter::QueryCache::instance().query(language, MfcFileInfo::query());
+    } catch (treesitter::Query::Error &error) {
+        spdlog::error("Project::mfcExtractAll: Failed to parse query error: {} at: {}", error.description,
+                      error.utf8_offset);
+        return {};
+    }
+
+    const auto cachePath = cacheFile.isEmpty() ? cacheFile : QDir(m_root).absoluteFilePath(cacheFile);
+    auto cache = cachePath.isEmpty() ? QHash<QString, MfcFileInfo>() : MfcFileInfo::loadCache(cachePath);
+
+    // Same as queryAll, documents and settings can only be accessed from the main thread
+    const auto parseTimeout = Settings::instance()->value<int>(Settings::TreeSitterParseTimeout);
+    QVector<MfcFileInfo> infos;
+    QVector<FileQueryInput> inputs;
+    QVector<qsizetype> inputIndexes;
+    const auto files = allFiles(FullPath);
+    for (const auto &fileName : files) {
+        if (documentType(QFileInfo(fileName).suffix()) != Document::Type::Cpp)
+            continue;
+        // Opened documents may have been modified, they are always extracted again, and never reused from the cache
+        auto textDocument = qobject_cast<TextDocument *>(findDocument(fileName));
+        const auto lastModified = textDocument ? 0 : QFileInfo(fileName).lastModified().toMSecsSinceEpoch();
+        if (!textDocument) {
+            auto it = cache.find(fileName);
+            if (it != cache.end() && it->lastModified == lastModified) {
+                infos.push_back(std::move(*it));
+                continue;
+            }
+        }
+        inputIndexes.push_back(infos.size());
+        infos.push_back({.fileName = fileName, .lastModified = lastModified});
+        inputs.push_back({fileName, textDocument ? std::optional<QString>(textDocument->text()) : std::nullopt,
+                          language, tsQuery, parseTimeout});
+    }
+
+    const auto results = QtConcurrent::blockingMapped<QVector<MfcFileInfo>>(inputs, extractMfcInfo);
+    for (int i = 0; i < results.size(); ++i) {
+        auto &info = infos[inputIndexes.at(i)];
+        const auto lastModified = info.lastModified;
+        info = results.at(i);
+        info.lastModified = lastModified;
+    }
+
+    if (!cachePath.isEmpty() && !inputs.isEmpty())
+        MfcFileInfo::saveCache(cachePath, infos);
+    return infos;
+}
+
+static SymbolIndex::FileSymbols indexFile(const FileQueryInput &input)
+{
+    return SymbolIndex::fromMatches(input.fileName, queryFile(input));
+}
+
+// Index the C++ files added or modified since the last update, in parallel
+void Project::updateSymbolIndex()
+{
+    const auto cacheSetting = Settings::instance()->value<QString>(Settings::SymbolIndexCache);
+    const auto cacheFile = cacheSetting.isEmpty() ? cacheSetting : QDir(m_root).absoluteFilePath(cacheSetting);
+    if (!m_symbolIndexLoaded) {
+        m_symbolIndexLoaded = true;
+        if (!cacheFile.isEmpty())
+            m_symbolIndex.load(cacheFile);
+    }
+
+    const auto language = CodeDocument::treeSitterLanguage(Document::Type::Cpp);
+    std::shared_ptr<treesitter::Query> tsQuery;
+    try {
+        tsQuery = treesitter::QueryCache::instance().query(language, SymbolIndex::query());
+    } catch (treesitter::Query::Error &error) {
+        spdlog::error("Project::updateSymbolIndex: Failed to parse query error: {} at: {}", error.description,
+                      error.utf8_offset);
+        return;
+    }
+
+    // Same as queryAll, documents and settings can only be accessed from the main thread
+    const auto parseTimeout = Settings::instance()->value<int>(Settings::TreeSitterParseTimeout);
+    QVector<FileQueryInput> inputs;
+    QVector<qint64> lastModifiedTimes;
+    QSet<QString> cppFiles;
+    const auto files = allFiles(FullPath);
+    for (const auto &fileName : files) {
+        if (documentType(QFileInfo(fileName).suffix()) != Document::Type::Cpp)
+            continue;
+        cppFiles.insert(fileName);
+        // Modified documents are indexed using their current text, and never reused from the index afterward
+        auto textDocument = qobject_cast<TextDocument *>(findDocument(fileName));
+        const bool hasChanged = textDocument && textDocument->hasChanged();
+        const auto lastModified = hasChanged ? 0 : QFileInfo(fileName).lastModified().toMSecsSinceEpoch();
+        if (!hasChanged) {
+            auto it = m_symbolIndex.files().find(fileName);
+            if (it != m_symbolIndex.files().end() && it->lastModified == lastModified)
+                continue;
+        }
+        lastModifiedTimes.push_back(lastModified);
+        inputs.push_back({fileName, hasChanged ? std::optional<QString>(textDocument->text()) : std::nullopt,
+                          language, tsQuery, parseTimeout});
+    }
+
+    const auto removedFiles = kdalgorithms::filtered(m_symbolIndex.files().keys(), [&cppFiles](const auto &fileName) {
+        return !cppFiles.contains(fileName);
+    });
+    for (const auto &fileName : removedFiles)
+        m_symbolIndex.remove(fileName);
+
+    if (inputs.isEmpty() && removedFiles.isEmpty())
+        return;
+
+    auto results = QtConcurrent::blockingMapped<QVector<SymbolIndex::FileSymbols>>(inputs, indexFile);
+    for (int i = 0; i < results.size(); ++i) {
+        results[i].lastModified = lastModifiedTimes.at(i);
+        m_symbolIndex.insert(std::move(results[i]));
+    }
+
+    if (!cacheFile.isEmpty())
+        m_symbolIndex.save(cacheFile);
+}
+
+/*!
+ * \qmlmethod object Project::memoryReport()
+ * Returns the memory used by Knut, in bytes, to find out what takes the memory in a big batch job. The report has:
+ *
+ * - `subsystems`: the memory currently allocated (`allocated`) and its maximum (`peak`) by tree-sitter (`treesitter`)
+ * and pugixml (`pugixml`), for all documents and caches,
+ * - `documents`: the memory used by each opened document (`fileName`, `type` and `total`), broken down per part:
+ * `text`, `marks`, `treesitter`, `symbols`, `xml` or `rc`, depending on the type of the document. The documents are
+ * sorted from the biggest to the smallest,
+ * - `total`: the sum of all documents.
+ *
+ * The tree-sitter and pugixml numbers are measured using custom allocators, the other ones are estimates from the
+ * size of the data: they give the order of magnitude, not the exact usage.
+ *
+ * ```js
+ * let report = Project.memoryReport();
+ * for (let document of report.documents.slice(0, 10))
+ *     Message.log(document.fileName + ": " + document.total);
+ * ```
+ */
+QVariantMap Project::memoryReport() const
+{
+    LOG("Project::memoryReport");
+
+    QVariantMap subsystems;
+    for (int i = 0; i < Utils::MemoryAccounting::SubsystemCount; ++i) {
+        const auto subsystem = static_cast<Utils::MemoryAccounting::Subsystem>(i);
+        subsystems[Utils::MemoryAccounting::name(subsystem)] =
+            QVariantMap {{"allocated", static_cast<qint64>(Utils::MemoryAccounting::allocatedBytes(subsystem))},
+                         {"peak", static_cast<qint64>(Utils::MemoryAccounting::peakBytes(subsystem))}};
+    }
+
+    std::vector<std::pair<qint64, QVariantMap>> documents;
+    qint64 total = 0;
+    const auto typeEnum = QMetaEnum::fromType<Document::Type>();
+    for (const auto *document : m_documents) {
+        auto usage = document->memoryUsage();
+        qint64 documentTotal = 0;
+        for (const auto &value : std::as_const(usage))
+            documentTotal += value.toLongLong();
+        usage["fileName"] = document->fileName();
+        usage["type"] = QString::fromLatin1(typeEnum.valueToKey(static_cast<int>(document->type())));
+        usage["total"] = documentTotal;
+        total += documentTotal;
+        documents.emplace_back(documentTotal, std::move(usage));
+    }
+    std::ranges::stable_sort(documents, std::greater {}, &std::pair<qint64, QVariantMap>::first);
+
+    QVariantList documentList;
+    documentList.reserve(static_cast<qsizetype>(documents.size()));
+    for (auto &document : documents)
+        documentList.push_back(std::move(document.second));
+    return {{"subsystems", subsystems}, {"documents", documentList}, {"total", total}};
+}
+
+/*!
+ * \qmlmethod array<IndexedSymbol> Project::findClass(string name)
+ * Returns the definitions of the classes and structs named `name` in all C++ files of the project. The name can be
+ * qualified with its scope, like `Foo::Bar`.
+ *
+ * The lookup uses a project-wide index built with Tree-sitter, without opening the files or using a language server.
+ * Only the files modified since the last lookup are parsed again. The index is stored in the file set in the
+ * `/cache/symbol_index` setting, if any, so it can be reused between two runs.
+ */
+QVector<IndexedSymbol> Project::findClass(const QString &name)
+{
+    LOG("Project::findClass", name);
+    updateSymbolIndex();
+    return m_symbolIndex.find(IndexedSymbol::Class, name);
+}
+
+/*!
+ * \qmlmethod array<IndexedSymbol> Project::findFunction(string name)
+ * Returns the definitions of the functions and methods named `name` in all C++ files of the project. The name can be
+ * qualified with its scope, like `Foo::bar`.
+ *
+ * See `findClass` for details on the index used for the lookup.
+ */
+QVector<IndexedSymbol> Project::findFunction(const QString &name)
+{
+    LOG("Project::findFunction", name);
+    updateSymbolIndex();
+    return m_symbolIndex.find(IndexedSymbol::Function, name);
+}
+
+/*!
+ * \qmlmethod array<IndexedSymbol> Project::findCallers(string name)
+ * Returns all the calls to the function named `name` in all C++ files of the project. The `function` property of each
+ * result gives the function containing the call.
+ *
+ * ```js
+ * for (let call of Project.findCallers("UpdateData"))
+ *     Message.log(call.fileName + ": called from " + call.function);
+ * ```
+ *
+ * See `findClass` for details on the index used for the lookup.
+ */
+QVector<IndexedSymbol> Project::findCallers(const QString &name)
+{
+    LOG("Project::findCallers", name);
+    updateSymbolIndex();
+    return m_symbolIndex.find(IndexedSymbol::Call, name);
+}
+
+// Converts the classes and functions found by workspace/symbol, the other symbols are skipped
+static void addWorkspaceSymbols(QVector<IndexedSymbol> &symbols, const Lsp::WorkspaceSymbolRequest::Result &result)
+{
+    struct LspSymbol
+    {
+        IndexedSymbol::Kind kind;
+        const Lsp::BaseSymbolInformation *information;
+        Lsp::Location location;
+    };
+    // Grouped by file, so each file is only read once to convert the positions
+    std::map<std::string, std::vector<LspSymbol>> lspSymbols;
+    auto addSymbol = [&lspSymbols](const Lsp::BaseSymbolInformation &information, Lsp::Location location) {
+        IndexedSymbol::Kind kind;
+        switch (information.kind) {
+        case Lsp::SymbolKind::Class:
+        case Lsp::SymbolKind::Struct:
+        case Lsp::SymbolKind::Interface:
+            kind = IndexedSymbol::Class;
+            break;
+        case Lsp::SymbolKind::Function:
+        case Lsp::SymbolKind::Method:
+        case Lsp::SymbolKind::Constructor:
+            kind = IndexedSymbol::Function;
+            break;
+        default:
+            return;
+        }
+        lspSymbols[location.uri].push_back({kind, &information, std::move(location)});
+    };
+
+    if (const auto *information = std::get_if<std::vector<Lsp::SymbolInformation>>(&result)) {
+        for (const auto &symbol : *information)
+            addSymbol(symbol, symbol.location);
+    } else if (const auto *workspaceSymbols = std::get_if<std::vector<Lsp::WorkspaceSymbol>>(&result)) {
+        for (const auto &symbol : *workspaceSymbols) {
+            // Without a range, the symbol is at the start of the file
+            if (const auto *location = std::get_if<Lsp::Location>(&symbol.location))
+                addSymbol(symbol, *location);
+            else
+                addSymbol(symbol, {std::get<Lsp::WorkspaceSymbol::LocationType>(symbol.location).uri, {}});
+        }
+    }
+
+    for (const auto &[uri, fileSymbols] : lspSymbols) {
+        std::vector<Lsp::Location> locations;
+        locations.reserve(fileSymbols.size());
+        for (const auto &symbol : fileSymbols)
+            locations.push_back(symbol.location);
+        // Nothing is returned for a file which can't be read
+        const auto textLocations = TextLocation::fromLsp(locations);
+        if (textLocations.size() != static_cast<qsizetype>(fileSymbols.size()))
+            continue;
+        for (size_t i = 0; i < fileSymbols.size(); ++i) {
+            IndexedSymbol symbol;
+            symbol.kind = fileSymbols[i].kind;
+            symbol.name = QString::fromStdString(fileSymbols[i].information->name);
+            symbol.scope = QString::fromStdString(fileSymbols[i].information->containerName.value_or(""));
+            symbol.fileName = textLocations[i].fileName;
+            symbol.range = textLocations[i].range;
+            symbols.push_back(std::move(symbol));
+        }
+    }
+}
+
+/*!
+ * \qmlmethod array<IndexedSymbol> Project::findSymbols(string query)
+ * Returns the classes and functions matching `query` in the whole project, found by the C++ language servers with
+ * the `workspace/symbol` request. The matching is done by the server: clangd does a fuzzy match on the name, which
+ * can be qualified with its scope, like `Foo::Bar`.
+ *
+ * Unlike `findClass` and `findFunction`, the results depend on the index of the server, see
+ * `CodeDocument::waitForLspIndexing`. The servers supporting it stream the results, which are converted while the
+ * next ones arrive.
+ */
+QVector<IndexedSymbol> Project::findSymbols(const QString &query)
+{
+    LOG("Project::findSymbols", query);
+
+    const auto lspServers = Settings::instance()->hasLsp()
+        ? Settings::instance()->valuePtr<std::vector<LspServer>>(Settings::LspServers)
+        : nullptr;
+    if (!lspServers)
+        return {};
+
+    // Each server of a subtree only knows about its subtree
+    QVector<IndexedSymbol> symbols;
+    std::unordered_set<Lsp::Client *> clients;
+    for (const auto &server : *lspServers) {
+        if (server.type != Document::Type::Cpp)
+            continue;
+        const auto path = lspServerPath(server, m_root);
+        auto client = getClient(Document::Type::Cpp, (path.isEmpty() ? m_root : path) + '/');
+        if (!client || !clients.insert(client).second)
+            continue;
+
+        Lsp::WorkspaceSymbolParams params;
+        params.query = query.toStdString();
+        auto result = client->workspaceSymbol(std::move(params), [&symbols](const auto &partialResult) {
+            addWorkspaceSymbols(symbols, partialResult);
+        });
+        if (result)
+            addWorkspaceSymbols(symbols, *result);
+    }
+    return symbols;
+}
+
+// Change of the base class of a class in one file, see Project::changeBaseClasses
+struct BaseClassChange
+{
+    QString className;
+    QString oldBase;
+    QString newBase;
+    // Change the class definition (header), the method definitions (source), or both
+    bool header = false;
+    bool source = false;
+};
+
+struct BaseClassInput
+{
+    FileQueryInput file;
+    QVector<BaseClassChange> changes;
+};
+
+// Same changes as CppDocument::changeBaseClassHeader and CppDocument::changeBaseClassSource, computed on the file text
+static QVector<TextEdit> baseClassEdits(const BaseClassInput &input)
+{
+    auto file = input.file;
+    if (!file.text)
+        file.text = readFileText(file.fileName);
+    const QString &text = *file.text;
+    const auto matches = queryFile(file);
+
+    // All edits rename an occurrence of a base class, keyed by position so an occurrence is only renamed once
+    std::map<int, TextEdit> edits;
+    auto renameAll = [&](const QString &pattern, const QString &newBase, int from = 0, int to = -1) {
+        const QRegularExpression regexp(pattern);
+        auto it = regexp.globalMatch(text, from);
+        while (it.hasNext()) {
+            const auto match = it.next();
+            if (to != -1 && match.capturedEnd(1) > to)
+                break;
+            const auto start = static_cast<int>(match.capturedStart(1));
+            edits.try_emplace(start, TextEdit {{start, static_cast<int>(match.capturedEnd(1))}, newBase});
+        }
+    };
+
+    for (const auto &change : input.changes) {
+        const auto oldBase = QRegularExpression::escape(change.oldBase);
+        renameAll(QString(R"(#include\s*<(%1)(\.h)?>)").arg(oldBase), change.newBase);
+        renameAll(QString(R"(\bclass\s+(%1)\s*;)").arg(oldBase), change.newBase);
+
+        for (const auto &match : matches) {
+            if (change.header && match.get("class-name").text == change.className) {
+                for (const auto &base : match.getAll("base")) {
+                    if (base.text == change.oldBase)
+                        edits.try_emplace(base.range.start, TextEdit {base.range, change.newBase});
+                }
+            } else if (change.source && match.get("scope").text == change.className
+                       && match.get("name").text == change.className) {
+                // Base class constructor calls in the initializer list of the constructors
+                renameAll(QString(R"(\b(%1)\b)").arg(oldBase), change.newBase, match.get("definition").range.start,
+                          match.get("body").range.start);
+            }
+        }
+        if (change.source)
+            renameAll(QString(R"(\b(%1)::)").arg(oldBase), change.newBase);
+    }
+
+    QVector<TextEdit> result;
+    result.reserve(static_cast<qsizetype>(edits.size()));
+    for (auto &[start, edit] : edits)
+        result.push_back(std::move(edit));
+    return result;
+}
+
+/*!
+ * \qmlmethod int Project::changeBaseClasses(object baseClasses)
+ * Changes the base class of all the classes of the project deriving from one of the keys of `baseClasses` to the
+ * corresponding value, and returns the number of classes changed.
+ *
+ * ```js
+ * Project.changeBaseClasses({"CDialog": "QDialog", "CWnd": "QWidget"});
+ * Project.saveAllDocuments();
+ * ```
+ *
+ * This is the same as calling `CppDocument::changeBaseClass` on each class, but the classes are found using the
+ * project symbol index (see `findClass`), and the files are processed in parallel, each one being changed in one
+ * edit. The documents changed are opened in Knut, but not saved.
+ */
+int Project::changeBaseClasses(const QVariantMap &baseClasses)
+{
+    LOG("Project::changeBaseClasses", LOG_ARG("baseClasses", baseClasses.keys()));
+
+    updateSymbolIndex();
+
+    // Group the changes per file, a class can be defined in a header or in a source file
+    std::map<QString, QVector<BaseClassChange>> changesByFile;
+    int count = 0;
+    for (const auto &fileSymbols : m_symbolIndex.files()) {
+        for (const auto &symbol : fileSymbols.symbols) {
+            if (symbol.kind != IndexedSymbol::Class)
+                continue;
+            for (const auto &base : symbol.bases) {
+                const auto it = baseClasses.constFind(base);
+                if (it == baseClasses.cend())
+                    continue;
+                ++count;
+                const auto newBase = it->toString();
+                const bool isHeader = isHeaderSuffix(QFileInfo(symbol.fileName).suffix());
+                changesByFile[symbol.fileName].push_back({symbol.name, base, newBase, true, !isHeader});
+                if (!isHeader)
+                    continue;
+                const auto source =
+                    findCorrespondingFile(symbol.fileName, correspondingHeaderSourceCandidates(symbol.fileName));
+                if (source.isEmpty())
+                    spdlog::warn("Project::changeBaseClasses - Can't find source file for '{}'", symbol.name);
+                else
+                    changesByFile[source].push_back({symbol.name, base, newBase, false, true});
+            }
+        }
+    }
+    if (changesByFile.empty())
+        return 0;
+
+    const auto language = CodeDocument::treeSitterLanguage(Document::Type::Cpp);
+    const auto tsQuery = treesitter::builtinQuery("cpp/base_class_changes");
+    if (!tsQuery)
+        return 0;
+
+    // Same as queryAll, documents and settings can only be accessed from the main thread
+    const auto parseTimeout = Settings::instance()->value<int>(Settings::TreeSitterParseTimeout);
+    QVector<BaseClassInput> inputs;
+    inputs.reserve(static_cast<qsizetype>(changesByFile.size()));
+    for (auto &[fileName, changes] : changesByFile) {
+        auto textDocument = qobject_cast<TextDocument *>(findDocument(fileName));
+        inputs.push_back({{fileName, textDocument ? std::optional<QString>(textDocument->text()) : std::nullopt,
+                           language, tsQuery, parseTimeout},
+                          std::move(changes)});
+    }
+
+    auto results = QtConcurrent::blockingMapped<QVector<QVector<TextEdit>>>(inputs, baseClassEdits);
+    for (int i = 0; i < results.size(); ++i) {
+        if (results.at(i).isEmpty())
+            continue;
+        const auto &fileName = inputs.at(i).file.fileName;
+        auto document = qobject_cast<TextDocument *>(get(fileName));
+        if (!document || !document->applyEdits(std::move(results[i])))
+            spdlog::warn("Project::changeBaseClasses - Can't change the base classes in {}", fileName);
+    }
+    return count;
+}
+
+struct RuleSetInput
+{
+    FileQueryInput file;
+    const treesitter::RuleSetTransformation *transformation = nullptr;
+};
+
+static treesitter::RuleSetTransformation::Result ruleSetReplacements(const RuleSetInput &input)
+{
+    const QString text = input.file.text ? *input.file.text : readFileText(input.file.fileName);
+    if (text.isEmpty())
+        return {};
+
+    auto parser = treesitter::ParserPool::instance().acquire(input.file.language);
+    parser->setTimeout(std::chrono::milliseconds(input.file.parseTimeout));
+    const auto tree = parser->parseString(text);
+    if (!tree) {
+        spdlog::warn("Project::transformAll - failed to parse file {}, or parsing timed out", input.file.fileName);
+        return {};
+    }
+    return input.transformation->findReplacements(text, *tree);
+}
+
+/*!
+ * \qmlmethod array<object> Project::transformAll(array<string> extensions, array<object> rules)
+ * Applies the rewrite `rules` to all files with an extension from `extensions` in the current project, and returns the
+ * result of each file changed.
+ *
+ * Each rule is an object with a Tree-sitter `query` and a `to` text, like the transformations of the Tree-sitter
+ * inspector: `to` replaces the `@from` capture, and `@name` in `to` is replaced by the text of the capture `name`.
+ * The queries of all rules are combined in one query, so each file is parsed and queried only once, whatever the
+ * number of rules. The files are processed in parallel, without opening them in Knut.
+ *
+ * All the replacements are found on the original text: when two of them overlap, the one of the first rule in `rules`
+ * is applied, the other one is a conflict. Call `transformAll` again to apply the rules on the result of other rules.
+ *
+ * Each result has the `fileName`, the number of `replacements` made, and the `conflicts`: for each one the `rule`
+ * index and the `start` and `end` positions of the replacement not applied, and the `otherRule` applied instead. The
+ * documents changed are opened in Knut, but not saved.
+ *
+ * ```js
+ * let results = Project.transformAll(["cpp", "h"], [
+ *     {query: '((type_identifier) @from (#eq? @from "BOOL"))', to: "bool"},
+ *     {query: '((identifier) @from (#eq? @from "NULL"))', to: "nullptr"}
+ * ]);
+ * Project.saveAllDocuments();
+ * ```
+ */
+QVariantList Project::transformAll(const QStringList &extensions, const QVariantList &rules)
+{
+    LOG("Project::transformAll", extensions, LOG_ARG("rules", static_cast<int>(rules.size())));
+
+    QVector<treesitter::RuleSetTransformation::Rule> ruleSet;
+    ruleSet.reserve(rules.size());
+    for (const auto &rule : rules) {
+        const auto map = rule.toMap();
+        ruleSet.push_back({map.value("query").toString(), map.value("to").toString()});
+    }
+    if (ruleSet.isEmpty())
+        return {};
+
+    // Same as queryAll, the rules are compiled once per language, a failed compilation is stored as nullptr
+    std::unordered_map<const TSLanguage *, std::unique_ptr<treesitter::RuleSetTransformation>> transformations;
+    auto transformationForLanguage = [&](const TSLanguage *language) {
+        auto it = transformations.find(language);
+        if (it != transformations.end())
+            return it->second.get();
+        auto &transformation = transformations[language];
+        try {
+            transformation = std::make_unique<treesitter::RuleSetTransformation>(language, ruleSet);
+        } catch (treesitter::Query::Error &error) {
+            spdlog::error("Project::transformAll: Failed to parse query error: {} at: {}", error.description,
+                          error.utf8_offset);
+        }
+        return transformation.get();
+    };
+
+    // Documents and settings can only be accessed from the main thread
+    const auto parseTimeout = Settings::instance()->value<int>(Settings::TreeSitterParseTimeout);
+    QVector<RuleSetInput> inputs;
+    const auto files = allFilesWithExtensions(extensions, FullPath);
+    for (const auto &fileName : files) {
+        const auto language = CodeDocument::treeSitterLanguage(documentType(QFileInfo(fileName).suffix()));
+        if (!language)
+            continue;
+        const auto transformation = transformationForLanguage(language);
+        if (!transformation)
+            continue;
+        auto textDocument = qobject_cast<TextDocument *>(findDocument(fileName));
+        inputs.push_back({{fileName, textDocument ? std::optional<QString>(textDocument->text()) : std::nullopt,
+                           language, transformation->query(), parseTimeout},
+                          transformation});
+    }
+
+    const auto results =
+        QtConcurrent::blockingMapped<QVector<treesitter::RuleSetTransformation::Result>>(inputs, ruleSetReplacements);
+
+    QVariantList fileResults;
+    for (int i = 0; i < results.size(); ++i) {
+        const auto &result = results.at(i);
+        if (result.replacements.isEmpty() && result.conflicts.isEmpty())
+            continue;
+
+        const auto &fileName = inputs.at(i).file.fileName;
+        if (!result.replacements.isEmpty()) {
+            auto edits = kdalgorithms::transformed<QVector<TextEdit>>(result.replacements, [](const auto &replacement) {
+                return TextEdit {{replacement.start, replacement.end}, replacement.text};
+            });
+            auto document = qobject_cast<TextDocument *>(get(fileName));
+            if (!document || !document->applyEdits(std::move(edits))) {
+                spdlog::warn("Project::transformAll - Can't apply the replacements in {}", fileName);
+                continue;
+            }
+        }
+
+        QVariantList conflicts;
+        for (const auto &conflict : result.conflicts) {
+            spdlog::warn("Project::transformAll - {}: replacement of rule {} at {} overlaps with rule {}", fileName,
+                         conflict.rule, conflict.start, conflict.otherRule);
+            conflicts.push_back(QVariantMap {{"rule", conflict.rule},
+                                             {"start", conflict.start},
+                                             {"end", conflict.end},
+                                             {"otherRule", conflict.otherRule}});
+        }
+        fileResults.push_back(QVariantMap {{"fileName", fileName},
+                                           {"replacements", static_cast<int>(result.replacements.size())},
+                                           {"conflicts", conflicts}});
+    }
+    return fileResults;
+}
+
+// Changes applied to all the ui files by Project::transformUiFiles
+struct UiTransform
+{
+    struct CustomWidget
+    {
+        QString className;
+        QString baseClassName;
+        QString header;
+        bool isContainer = false;
+    };
+
+    QHash<QString, QString> classNames;
+    // Properties added to the widgets of a given class, if they don't already have them
+    QHash<QString, QVariantMap> properties;
+    // Custom widgets declared in the files using them, if they are not already declared
+    QVector<CustomWidget> customWidgets;
+};
+
+struct UiTransformInput
+{
+    QString fileName;
+    const UiTransform *transform = nullptr;
+};
+
+// Applies the transform on the file, and saves it if it changed. Returns true if the file was changed.
+static bool transformUiFile(const UiTransformInput &input)
+{
+    // Same flags as QtUiDocument, so the file is saved the same way
+    pugi::xml_document document;
+    const auto result = Utils::loadXmlFile(document, input.fileName, pugi::parse_default | pugi::parse_declaration);
+    if (!result) {
+        spdlog::error("Project::transformUiFiles - {}({}): {}", input.fileName, result.offset, result.description());
+        return false;
+    }
+
+    const auto &transform = *input.transform;
+    Utils::QtUiWriter writer(document);
+    bool changed = false;
+    QSet<QString> usedClassNames;
+    const auto widgets = document.select_nodes("//widget");
+    for (const auto &node : widgets) {
+        auto widget = node.node();
+        auto className = QString::fromLatin1(widget.attribute("class").value());
+        if (const auto it = transform.classNames.constFind(className); it != transform.classNames.cend()) {
+            className = *it;
+            writer.setWidgetClassName(widget, className);
+            changed = true;
+        }
+        usedClassNames.insert(className);
+
+        const auto properties = transform.properties.constFind(className);
+        if (properties == transform.properties.cend())
+            continue;
+        for (const auto &[name, value] : properties->asKeyValueRange()) {
+            const auto nameText = name.toLatin1();
+            if (widget.find_child_by_attribute("property", "name", nameText.constData()))
+                continue;
+            if (writer.addWidgetProperty(widget, name, value) == Utils::QtUiWriter::Success)
+                changed = true;
+            else
+                spdlog::error("Project::transformUiFiles - unknown {} type for property {}", value.typeName(), name);
+        }
+    }
+
+    for (const auto &customWidget : transform.customWidgets) {
+        if (!usedClassNames.contains(customWidget.className))
+            continue;
+        const QString customPath = "ui/customwidgets/customwidget[class='" % customWidget.className % "']";
+        if (document.select_node(customPath.toLatin1().constData()))
+            continue;
+        const auto status = writer.addCustomWidget(customWidget.className, customWidget.baseClassName,
+                                                   customWidget.header, customWidget.isContainer);
+        if (status == Utils::QtUiWriter::Success)
+            changed = true;
+        else if (status == Utils::QtUiWriter::InvalidHeader)
+            spdlog::error("Project::transformUiFiles - the include '{}' is malformed", customWidget.header);
+    }
+
+    if (changed && !document.save_file(input.fileName.toLatin1().constData(), "    ")) {
+        spdlog::error("Project::transformUiFiles - can't save {}", input.fileName);
+        return false;
+    }
+    return changed;
+}
+
+/*!
+ * \qmlmethod int Project::transformUiFiles(string pattern, object transform)
+ * Applies `transform` to all the ui files of the project matching the glob `pattern`, and returns the number of files
+ * changed. The pattern is relative to the project root, `**` matching any number of directories.
+ *
+ * The `transform` object can have the following keys:
+ *
+ * - `classNames`: an object mapping old widget class names to new ones
+ * - `properties`: an object mapping a widget class name to the properties to add to all the widgets of this class,
+ *   see `QtUiWidget::addProperty`. Properties already set on a widget are left as is.
+ * - `customWidgets`: an array of custom widgets, with the `className`, `baseClassName`, `header` and `isContainer`
+ *   keys, see `QtUiDocument::addCustomWidget`. They are only declared in the files using them.
+ *
+ * ```js
+ * Project.transformUiFiles("dialogs/*.ui", {
+ *     classNames: {"CButton": "MyPushButton"},
+ *     properties: {"MyPushButton": {"flat": true}},
+ *     customWidgets: [{className: "MyPushButton", baseClassName: "QPushButton", header: "<MyPushButton.h>"}]
+ * });
+ * ```
+ *
+ * Contrary to opening each file with `Project::open`, the files are processed in parallel without creating any
+ * document, and they are only saved if they changed. Files already opened in Knut are skipped.
+ */
+int Project::transformUiFiles(const QString &pattern, const QVariantMap &transform)
+{
+    LOG("Project::transformUiFiles", pattern, LOG_ARG("transform", transform.keys()));
+
+    UiTransform uiTransform;
+    const auto classNames = transform.value("classNames").toMap();
+    for (const auto &[oldName, newName] : classNames.asKeyValueRange())
+        uiTransform.classNames.insert(oldName, newName.toString());
+    const auto properties = transform.value("properties").toMap();
+    for (const auto &[className, classProperties] : properties.asKeyValueRange()) {
+        auto values = classProperties.toMap();
+        // Numbers coming from JavaScript are doubles, but only integers are supported in ui files
+        for (auto &value : values) {
+            if (value.typeId() == QMetaType::Double && value.toDouble() == static_cast<int>(value.toDouble()))
+                value = static_cast<int>(value.toDouble());
+        }
+        uiTransform.properties.insert(className, std::move(values));
+    }
+    const auto customWidgets = transform.value("customWidgets").toList();
+    for (const auto &customWidget : customWidgets) {
+        const auto map = customWidget.toMap();
+        uiTransform.customWidgets.push_back({map.value("className").toString(), map.value("baseClassName").toString(),
+                                             map.value("header").toString(), map.value("isContainer").toBool()});
+    }
+
+    // Documents can only be accessed from the main thread, and saving the file would lose their changes
+    const auto regexp = ParallelScriptRunner::globToRegularExpression(QDir::fromNativeSeparators(pattern));
+    QVector<UiTransformInput> inputs;
+    const auto files = allFiles(RelativeToRoot);
+    for (const auto &file : files) {
+        if (documentType(QFileInfo(file).suffix()) != Document::Type::QtUi || !regexp.match(file).hasMatch())
+            continue;
+        const auto fileName = QDir(m_root).absoluteFilePath(file);
+        if (findDocument(fileName)) {
+            spdlog::warn("Project::transformUiFiles - {} is opened, it's not transformed", fileName);
+            continue;
+        }
+        inputs.push_back({fileName, &uiTransform});
+    }
+
+    const auto results = QtConcurrent::blockingMapped<QVector<bool>>(inputs, transformUiFile);
+    return static_cast<int>(std::ranges::count(results, true));
+}
+
+static int commonFilePathLength(const QString &s1, const QString &s2)
+{
+    const qsizetype length = qMin(s1.length(), s2.length());
+    for (qsizetype i = 0; i < length; ++i) {
+        if (s1[i].toLower() != s2[i].toLower())
+            return i;
+    }
+    return length;
+}
+
+QString Project::findCorrespondingFile(const QString &fileName, const QStringList &candidates)
+{
+    // The file may have been removed since it was cached
+    const auto cached = m_correspondingFiles.constFind(fileName);
+    if (cached != m_correspondingFiles.cend() && QFileInfo::exists(*cached))
+        return *cached;
+
+    QString result;
+
+    // Search in the same directory first
+    const QString path = QFileInfo(fileName).absolutePath();
+    for (const auto &candidate : candidates) {
+        const QString testFileName = path + '/' + candidate;
+        if (QFileInfo::exists(testFileName)) {
+            result = testFileName;
+            break;
+        }
+    }
+
+    // Then in the whole project, using the file index: find the file having the most common path with fileName
+    if (result.isEmpty()) {
+        int compareValue = 0;
+        for (const auto &candidate : candidates) {
+            const auto files = m_fileIndex.filesWithName(candidate);
+            for (const auto &file : files) {
+                const int value = commonFilePathLength(file, fileName);
+                if (value > compareValue) {
+                    compareValue = value;
+                    result = file;
+                }
+            }
+        }
+    }
+
+    if (!result.isEmpty()) {
+        m_correspondingFiles[fileName] = result;
+        m_correspondingFiles[result] = fileName;
+    }
+    return result;
+}
+
+QString lspServerPath(const LspServer &server, const QString &root)
+{
+    if (server.path.isEmpty())
+        return {};
+    return QDir::cleanPath(QDir(root).absoluteFilePath(server.path));
+}
+
+const LspServer *findLspServer(const std::vector<LspServer> &servers, Document::Type type, const QString &fileName,
+                               const QString &root)
+{
+    const QString filePath = QDir::cleanPath(QFileInfo(fileName).absoluteFilePath());
+    const LspServer *result = nullptr;
+    qsizetype resultLength = -1;
+    for (const auto &server : servers) {
+        if (server.type != type)
+            continue;
+        const auto path = lspServerPath(server, root);
+        if (!path.isEmpty() && filePath != path && !filePath.startsWith(path + '/'))
+            continue;
+        if (path.size() > resultLength) {
+            result = &server;
+            resultLength = path.size();
+        }
+    }
+    return result;
+}
+
+Lsp::Client *Project::getClient(Document::Type type, const QString &fileName)
 {
     // Check if we use LSP
     if (!Settings::instance()->hasLsp())
         return nullptr;
 
-    static auto lspServers = Settings::instance()->value<std::vector<LspServer>>(Settings::LspServers);
+    const auto lspServers = Settings::instance()->valuePtr<std::vector<LspServer>>(Settings::LspServers);
+    if (!lspServers)
+        return nullptr;
 
-    auto cit = m_lspClients.find(type);
+    const auto server = findLspServer(*lspServers, type, fileName, m_root);
+    if (!server)
+        return nullptr;
+    const auto path = lspServerPath(*server, m_root);
+    const auto key = std::make_pair(type, path);
+    auto cit = m_lspClients.find(key);
     if (cit != m_lspClients.end())
         return cit->second;
 
-    auto sit = kdalgorithms::find_if(lspServers, [type](const LspServer &server) {
-        return server.type == type;
-    });
-    if (!sit)
-        return nullptr;
     QString language(QMetaEnum::fromType<Document::Type>().key(static_cast<int>(type)));
-    auto client = new Lsp::Client(language.toLower().toStdString(), sit->program, sit->arguments, this);
-    if (client->initialize(m_root)) {
-        m_lspClients[type] = client;
+    auto client = new Lsp::Client(language.toLower().toStdString(), server->program, server->arguments, this);
+    client->setRequestTimeout(Settings::instance()->value<int>(Settings::LspRequestTimeout));
+    if (!server->socket.isEmpty())
+        client->setServerSocket(server->socket);
+    // A server of a subtree is rooted there, so its index only contains the subtree
+    if (!path.isEmpty())
+        spdlog::info("Project::getClient - starting {} for {}", server->program, path);
+    if (client->initialize(path.isEmpty() ? m_root : path)) {
+        m_lspClients[key] = client;
         return client;
     }
     return nullptr;
 }
 
-const QVector<Document *> &Project::documents() const
+QVector<Document *> Project::documents() const
+{
+    return QVector<Document *>(m_documents.cbegin(), m_documents.cend());
+}
+
+// Documents are indexed using the canonical path of their directory, so different paths to the same file return the
+// same document. Only the directory is used, as the file itself may not exist yet.
+static QString documentKey(const QString &fileName)
+{
+    const QFileInfo fi(fileName);
+    const QString canonicalPath = fi.dir().canonicalPath();
+    return canonicalPath.isEmpty() ? fi.absoluteFilePath() : canonicalPath + '/' + fi.fileName();
+}
+
+Document *Project::findDocument(const QString &fileName) const
 {
-    return m_documents;
+    auto it = m_documentsByFileName.find(documentKey(fileName));
+    return it == m_documentsByFileName.end() ? nullptr : *it->second;
+}
+
+void Project::updateDocumentFileName(Document *document)
+{
+    auto it = std::ranges::find_if(m_documentsByFileName, [document](const auto &value) {
+        return *value.second == document;
+    });
+    Q_ASSERT(it != m_documentsByFileName.end());
+    auto documentIt = it->second;
+    m_documentsByFileName.erase(it);
+    m_documentsByFileName[documentKey(document->fileName())] = documentIt;
 }
 
 Document *Project::getDocument(QString fileName, bool moveToBack)
@@ -268,25 +1317,55 @@ Document *Project::getDocument(QString fileName, bool moveToBack)
     else
         fileName = fi.absoluteFilePath();
 
-    auto findIt = std::ranges::find_if(m_documents, [fileName](auto document) {
-        return document->fileName() == fileName;
-    });
+    auto findIt = m_documentsByFileName.find(documentKey(fileName));
 
     Document *doc = nullptr;
 
-    if (findIt != m_documents.end()) {
-        doc = *findIt;
+    if (findIt != m_documentsByFileName.end()) {
+        doc = *findIt->second;
         if (moveToBack)
-            std::rotate(findIt, findIt + 1, m_documents.end());
+            m_documents.splice(m_documents.end(), m_documents, findIt->second);
+        useDocument(doc);
     } else {
         doc = createDocument(fi.suffix());
         if (doc) {
-            if (auto codeDocument = qobject_cast<CodeDocument *>(doc))
-                codeDocument->setLspClient(getClient(doc->type()));
+            if (auto codeDocument = qobject_cast<CodeDocument *>(doc)) {
+                // Don't start the LSP server for documents only using tree-sitter
+                // The document owns the provider, and the server depends on the file name of the document
+                codeDocument->setLspClientProvider([this, codeDocument]() {
+                    auto client = getClient(codeDocument->type(), codeDocument->fileName());
+                    adoptLspPrefetch(codeDocument, client);
+                    return client;
+                });
+            }
             doc->setParent(this);
+            if (auto textDocument = qobject_cast<TextDocument *>(doc)) {
+                textDocument->setLargeFileThresholds(Settings::instance()->value<int>(Settings::LargeFileSize),
+                                                     Settings::instance()->value<int>(Settings::LargeFileLines));
+            }
+            auto prefetched = m_prefetcher.take(documentKey(fileName), fileName);
+            if (prefetched) {
+                if (auto textDocument = qobject_cast<TextDocument *>(doc))
+                    textDocument->setPrefetchedData(std::move(prefetched->data));
+            }
             doc->load(fileName);
+            if (prefetched && prefetched->tree) {
+                if (auto codeDocument = qobject_cast<CodeDocument *>(doc))
+                    codeDocument->setPrefetchedTree(std::move(*prefetched->tree), prefetched->text,
+                                                    prefetched->treeBytes);
+            }
             m_documents.push_back(doc);
-            emit documentsChanged();
+            m_documentsByFileName[documentKey(fileName)] = std::prev(m_documents.end());
+            connect(doc, &Document::fileNameChanged, this, [this, doc]() {
+                updateDocumentFileName(doc);
+            });
+            useDocument(doc);
+            readAhead(fileName);
+            lspReadAhead(fileName);
+            if (m_batchDepth > 0)
+                m_documentsChangedInBatch = true;
+            else
+                emit documentsChanged();
         } else {
             spdlog::error("Project::open {} - unknown document type", fi.suffix());
             return nullptr;
@@ -295,6 +1374,323 @@ Document *Project::getDocument(QString fileName, bool moveToBack)
     return doc;
 }
 
+// Moves the document at the end of the LRU list, and evicts the least recently used ones above the limit
+void Project::useDocument(Document *document)
+{
+    if (auto it = m_loadedDocumentsIndex.find(document); it != m_loadedDocumentsIndex.end()) {
+        m_loadedDocuments.splice(m_loadedDocuments.end(), m_loadedDocuments, it->second);
+        return;
+    }
+    m_loadedDocuments.push_back(document);
+    m_loadedDocumentsIndex[document] = std::prev(m_loadedDocuments.end());
+    evictDocuments();
+}
+
+// Evicts the least recently used documents, until there are at most `/project/max_loaded_documents` loaded.
+// The modified documents and the current one are kept, there may be more documents loaded than the limit.
+void Project::evictDocuments()
+{
+    const auto maxDocuments = Settings::instance()->value<int>(Settings::MaxLoadedDocuments);
+    if (maxDocuments <= 0)
+        return;
+
+    auto it = m_loadedDocuments.begin();
+    while (std::ssize(m_loadedDocuments) > maxDocuments && it != std::prev(m_loadedDocuments.end())) {
+        auto document = *it;
+        if (document == m_current || document->hasChanged()) {
+            ++it;
+            continue;
+        }
+        document->evict();
+        m_loadedDocumentsIndex.erase(document);
+        it = m_loadedDocuments.erase(it);
+    }
+}
+
+// Only the documents based on TextDocument can use the prefetched content
+static bool canPrefetch(Document::Type type)
+{
+    switch (type) {
+    case Document::Type::Cpp:
+    case Document::Type::Text:
+    case Document::Type::Slint:
+    case Document::Type::Qml:
+    case Document::Type::Json:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static void closeLspFile(Lsp::Client *client, const QString &fileName)
+{
+    Lsp::DidCloseTextDocumentParams params;
+    params.textDocument.uri = QUrl::fromLocalFile(fileName).toString().toStdString();
+    client->didClose(std::move(params));
+}
+
+/*!
+ * \qmlmethod Project::prefetch(array<string> fileNames, object options = {})
+ * Loads the files `fileNames` in the background: the files are read, and parsed with Tree-sitter if they have a
+ * grammar, in parallel. Opening one of them later with `get` or `open` reuses the result, instead of loading it
+ * again. If the fileName is relative, use the root path as the base.
+ *
+ * Files already opened are skipped, as well as the files not opened as text documents (`.rc`, `.ui`, images, `.ts`).
+ * A prefetched file changed on the disk before being opened is loaded again.
+ *
+ * Prefetching is also done automatically: after opening a file from the last list returned by `allFiles`,
+ * `allFilesWithExtension` or `allFilesWithExtensions`, the next `/project/read_ahead` files of the list are
+ * prefetched. Set it to 0 to disable the read-ahead.
+ *
+ * ```js
+ * let files = Project.allFilesWithExtension("cpp");
+ * Project.prefetch(files.slice(0, 10));
+ * ```
+ *
+ * With the `lsp` option, `fileNames` is the list of files the script is going to work on, in this order. The files
+ * are then loaded, and opened on the language server so it builds their AST, in a sliding window of
+ * `/lsp/prefetch_window` files: each time a file of the list is opened, the next files are opened on the server, and
+ * the previous ones are closed. With several files in the window, the server works on the next files while the script
+ * works on the current one.
+ *
+ * ```js
+ * let files = Project.allFilesWithExtension("cpp");
+ * Project.prefetch(files, {lsp: true});
+ * for (const fileName of files) {
+ *     let document = Project.open(fileName);
+ *     // ... use the LSP on the document
+ * }
+ * ```
+ */
+void Project::prefetch(const QStringList &fileNames, const QVariantMap &options)
+{
+    LOG("Project::prefetch", fileNames, LOG_ARG("options", options.keys()));
+
+    QStringList fullPaths;
+    fullPaths.reserve(fileNames.size());
+    for (const auto &fileName : fileNames) {
+        QFileInfo fi(fileName);
+        fullPaths.push_back(!fi.exists() && fi.isRelative() ? m_root + '/' + fileName : fi.absoluteFilePath());
+    }
+    if (!options.value("lsp").toBool()) {
+        prefetchFiles(fullPaths);
+        return;
+    }
+
+    QHash<QString, qsizetype> indexes;
+    indexes.reserve(fullPaths.size());
+    for (qsizetype i = 0; i < fullPaths.size(); ++i)
+        indexes.insert(documentKey(fullPaths.at(i)), i);
+    // The files of the previous list not in the new one are not needed anymore
+    for (auto it = m_lspPrefetchedFiles.begin(); it != m_lspPrefetchedFiles.end();) {
+        if (indexes.contains(it->first)) {
+            ++it;
+            continue;
+        }
+        closeLspFile(it->second.client, it->second.fileName);
+        it = m_lspPrefetchedFiles.erase(it);
+    }
+
+    m_lspWorkFiles = std::move(fullPaths);
+    m_lspWorkIndexes = std::move(indexes);
+    m_lspWorkPosition = -1;
+    const auto window = Settings::instance()->value<int>(Settings::LspPrefetchWindow);
+    const auto last = std::min<qsizetype>(window, m_lspWorkFiles.size());
+    prefetchFiles(m_lspWorkFiles.mid(0, last));
+    for (qsizetype i = 0; i < last; ++i)
+        openLspPrefetch(m_lspWorkFiles.at(i));
+}
+
+/*!
+ * \qmlmethod variant Project::cacheValue(string key, string fileName = "")
+ * Returns the value stored with `setCacheValue` for `key`, or `undefined` if there's none.
+ *
+ * If `fileName` is set, the value is attached to this file: it's only returned if the file still has the same content
+ * as when the value was set. If the fileName is relative, use the root path as the base.
+ *
+ * The cache is kept between runs if `/cache/script` is set to the path of the cache file, relative to the project
+ * root. This way, data expensive to compute is only computed once, or only for the files that changed:
+ *
+ * ```js
+ * let classes = Project.cacheValue("classes", fileName);
+ * if (classes === undefined) {
+ *     classes = computeClasses(fileName);
+ *     Project.setCacheValue("classes", classes, fileName);
+ * }
+ * ```
+ */
+QVariant Project::cacheValue(const QString &key, const QString &fileName)
+{
+    LOG("Project::cacheValue", key, fileName);
+
+    const auto fullPath = fileName.isEmpty() ? fileName : QDir(m_root).absoluteFilePath(fileName);
+    const auto value = scriptCache().value(key, fullPath);
+    if (!value)
+        return {};
+    return JsonDocument::toVariant(*value);
+}
+
+/*!
+ * \qmlmethod Project::setCacheValue(string key, variant value, string fileName = "")
+ * Stores `value` for `key` in the cache, see `cacheValue`. The value is stored as json: it can be a string, a number,
+ * a boolean, or an array or object of those.
+ */
+void Project::setCacheValue(const QString &key, const QVariant &value, const QString &fileName)
+{
+    LOG("Project::setCacheValue", key, value, fileName);
+
+    scriptCache().setValue(key, JsonDocument::toJson(value),
+                           fileName.isEmpty() ? fileName : QDir(m_root).absoluteFilePath(fileName));
+}
+
+/*!
+ * \qmlmethod Project::clearCache()
+ * Removes all the values stored in the cache, see `cacheValue`.
+ */
+void Project::clearCache()
+{
+    LOG("Project::clearCache");
+
+    scriptCache().clear();
+}
+
+ScriptCache &Project::scriptCache()
+{
+    if (!m_scriptCacheLoaded) {
+        m_scriptCacheLoaded = true;
+        // The settings are destroyed before the project, the file is kept for the save
+        const auto cacheSetting = Settings::instance()->value<QString>(Settings::ScriptCache);
+        m_scriptCacheFile = cacheSetting.isEmpty() ? cacheSetting : QDir(m_root).absoluteFilePath(cacheSetting);
+        if (!m_scriptCacheFile.isEmpty())
+            m_scriptCache.load(m_scriptCacheFile);
+    }
+    return m_scriptCache;
+}
+
+void Project::prefetchFiles(const QStringList &fileNames)
+{
+    // Settings can't be read from the worker threads
+    const auto parseTimeout = Settings::instance()->value<int>(Settings::TreeSitterParseTimeout);
+    const auto largeFileSize = Settings::instance()->value<int>(Settings::LargeFileSize);
+    for (const auto &fileName : fileNames) {
+        const auto key = documentKey(fileName);
+        if (m_documentsByFileName.contains(key) || m_prefetcher.contains(key))
+            continue;
+        const QFileInfo fi(fileName);
+        const auto type = documentType(fi.suffix());
+        if (!canPrefetch(type))
+            continue;
+        // Large files are only parsed when needed, the file size can only be larger than the number of characters
+        const bool largeFile = largeFileSize > 0 && fi.size() > largeFileSize;
+        const auto language = largeFile ? nullptr : CodeDocument::treeSitterLanguage(type);
+        m_prefetcher.prefetch(key, fileName, language, parseTimeout);
+    }
+}
+
+// Prefetches the files following `fileName` in the last list of files returned to the script, as they are likely
+// to be opened next
+void Project::readAhead(const QString &fileName)
+{
+    const auto count = Settings::instance()->value<int>(Settings::ReadAhead);
+    if (count <= 0 || m_readAheadFiles.isEmpty())
+        return;
+
+    auto it = std::lower_bound(m_readAheadFiles.cbegin(), m_readAheadFiles.cend(), fileName);
+    if (it == m_readAheadFiles.cend() || *it != fileName)
+        return;
+    ++it;
+    const auto last = it + std::min<qsizetype>(count, std::distance(it, m_readAheadFiles.cend()));
+    prefetchFiles(QStringList(it, last));
+}
+
+// Moves the window of the `lsp` prefetch after `fileName`, if it's one of the next files of the list: the files
+// before, used or skipped by the script, are closed on the server, and the next ones opened
+void Project::lspReadAhead(const QString &fileName)
+{
+    if (m_lspWorkFiles.isEmpty())
+        return;
+
+    const auto it = m_lspWorkIndexes.constFind(documentKey(fileName));
+    if (it == m_lspWorkIndexes.cend() || *it <= m_lspWorkPosition)
+        return;
+
+    for (auto i = std::max<qsizetype>(m_lspWorkPosition, 0); i < *it; ++i)
+        closeLspWorkFile(m_lspWorkFiles.at(i));
+    m_lspWorkPosition = *it;
+
+    const auto window = Settings::instance()->value<int>(Settings::LspPrefetchWindow);
+    const auto first = m_lspWorkPosition + 1;
+    const auto last = std::min<qsizetype>(first + window, m_lspWorkFiles.size());
+    if (first >= last)
+        return;
+    prefetchFiles(m_lspWorkFiles.mid(first, last - first));
+    for (auto i = first; i < last; ++i)
+        openLspPrefetch(m_lspWorkFiles.at(i));
+}
+
+// Opens `fileName` on its language server, before its document is opened
+void Project::openLspPrefetch(const QString &fileName)
+{
+    const auto key = documentKey(fileName);
+    if (m_documentsByFileName.contains(key) || m_lspPrefetchedFiles.contains(key))
+        return;
+
+    const QFileInfo fi(fileName);
+    // The LSP is not used for large files, see CodeDocument::client
+    const auto largeFileSize = Settings::instance()->value<int>(Settings::LargeFileSize);
+    if (largeFileSize > 0 && fi.size() > largeFileSize)
+        return;
+    auto client = getClient(documentType(fi.suffix()), fileName);
+    if (!client)
+        return;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        spdlog::warn("Project::prefetch - can't read file {}: {}", fileName, file.errorString());
+        return;
+    }
+    // Same line endings as the text of the document, the document checks the text is the same when it's opened
+    auto text = QString::fromUtf8(file.readAll()).replace("\r\n", "\n");
+
+    Lsp::DidOpenTextDocumentParams params;
+    params.textDocument.uri = QUrl::fromLocalFile(fileName).toString().toStdString();
+    params.textDocument.version = 0;
+    params.textDocument.text = Utils::toStdString(text);
+    params.textDocument.languageId = client->languageId();
+    client->didOpen(std::move(params));
+    m_lspPrefetchedFiles[key] = {fileName, client, std::move(text)};
+}
+
+// Closes a file of the `lsp` prefetch on the server, whether its document was opened or not
+void Project::closeLspWorkFile(const QString &fileName)
+{
+    const auto key = documentKey(fileName);
+    if (auto it = m_lspPrefetchedFiles.find(key); it != m_lspPrefetchedFiles.end()) {
+        closeLspFile(it->second.client, it->second.fileName);
+        m_lspPrefetchedFiles.erase(it);
+    }
+    if (auto it = m_documentsByFileName.find(key); it != m_documentsByFileName.end()) {
+        if (auto codeDocument = qobject_cast<CodeDocument *>(*it->second))
+            codeDocument->releaseLspClient();
+    }
+}
+
+// Gives the file opened in advance on the server to its document, when the document first needs the LSP
+void Project::adoptLspPrefetch(CodeDocument *document, Lsp::Client *client)
+{
+    auto it = m_lspPrefetchedFiles.find(documentKey(document->fileName()));
+    if (it == m_lspPrefetchedFiles.end())
+        return;
+
+    auto prefetched = std::move(it->second);
+    m_lspPrefetchedFiles.erase(it);
+    // The document may use another server or file name (e.g. through a symlink), the server can't know it's the same
+    if (client && prefetched.client == client && prefetched.fileName == document->fileName())
+        document->setLspPrefetchedText(std::move(prefetched.text));
+    else
+        closeLspFile(prefetched.client, prefetched.fileName);
+}
+
 /*!
  * \qmlmethod Document Project::get(string fileName)
  * Get the document for the given `fileName`. If the document is not opened yet, open it. If the document already
@@ -302,6 +1698,10 @@ Document *Project::getDocument(QString fileName, bool moveToBack)
  * the base.
  *
  * *Note:* this command does not change the current document.
+ *
+ * To limit the memory used when working on many files, only the `/project/max_loaded_documents` most recently used
+ * documents are fully loaded: the syntax tree, symbols and language server state of the least recently used ones are
+ * dropped, if they are not modified. This is transparent, they are computed again when needed.
  */
 Document *Project::get(const QString &fileName)
 {
@@ -323,7 +1723,8 @@ Document *Project::open(const QString &fileName)
     LOG("Project::open", LOG_ARG("path", fileName));
 
     m_current = getDocument(fileName, true);
-    emit currentDocumentChanged(m_current);
+    if (m_batchDepth == 0)
+        emit currentDocumentChanged(m_current);
 
     LOG_RETURN("document", m_current);
 }
@@ -337,6 +1738,12 @@ void Project::closeAll()
     LOG("Project::closeAll");
     for (auto d : std::as_const(m_documents))
         d->close();
+    for (const auto &[key, prefetched] : m_lspPrefetchedFiles)
+        closeLspFile(prefetched.client, prefetched.fileName);
+    m_lspPrefetchedFiles.clear();
+    m_lspWorkFiles.clear();
+    m_lspWorkIndexes.clear();
+    m_lspWorkPosition = -1;
 }
 
 Core::Document *Project::currentDocument() const
@@ -344,6 +1751,31 @@ Core::Document *Project::currentDocument() const
     return m_current;
 }
 
+/*!
+ * \qmlmethod array<string> Project::refreshChanged()
+ * Reloads the open documents whose file has changed on disk, for example after a `git checkout`, and returns their
+ * file names.
+ *
+ * Only the documents whose content is different are reloaded: the size and modification time of the file are checked
+ * first, then its content. When only a small part of a text document has changed, only that part is replaced, so the
+ * syntax tree is updated incrementally. Documents with unsaved changes are not reloaded.
+ */
+QStringList Project::refreshChanged()
+{
+    LOG("Project::refreshChanged");
+
+    QStringList refreshed;
+    for (auto d : std::as_const(m_documents)) {
+        if (d->hasChanged() && d->hasChangedOnDisk()) {
+            spdlog::warn("Project::refreshChanged - {} has unsaved changes, it's not reloaded", d->fileName());
+            continue;
+        }
+        if (d->refresh())
+            refreshed.push_back(d->fileName());
+    }
+    return refreshed;
+}
+
 /*!
  * \qmlmethod Project::saveAllDocuments()
  * Save all Documents opened in project.
@@ -359,6 +1791,95 @@ void Project::saveAllDocuments()
     }
 }
 
+void Project::beginBatch()
+{
+    if (m_batchDepth++ == 0) {
+        m_documentsChangedInBatch = false;
+        m_currentBeforeBatch = m_current;
+    }
+}
+
+void Project::endBatch()
+{
+    Q_ASSERT(m_batchDepth > 0);
+    if (--m_batchDepth > 0)
+        return;
+    if (m_documentsChangedInBatch)
+        emit documentsChanged();
+    // Only the last document opened is shown
+    if (m_current != m_currentBeforeBatch)
+        emit currentDocumentChanged(m_current);
+}
+
+void Project::setPatchOutput(bool enabled)
+{
+    m_patchOutput = enabled;
+}
+
+void Project::setLspIndexingTimeout(int msecs)
+{
+    m_lspIndexingTimeout = msecs;
+}
+
+int Project::lspIndexingTimeout() const
+{
+    return m_lspIndexingTimeout.value_or(Settings::instance()->value<int>(Settings::LspIndexingTimeout));
+}
+
+bool Project::recordPatch(const QString &fileName, const QByteArray &data)
+{
+    if (!m_instance || !m_instance->m_patchOutput)
+        return false;
+    const QString relativeName = QDir(m_instance->m_root).relativeFilePath(fileName);
+    if (relativeName.startsWith("..") || QDir::isAbsolutePath(relativeName))
+        return false;
+
+    // The file isn't written, so the patch is always against the content on disk
+    std::optional<QString> before;
+    QFile file(fileName);
+    if (file.open(QIODevice::ReadOnly))
+        before = QString::fromUtf8(file.readAll());
+    m_instance->setFilePatch(relativeName, Utils::gitPatch(relativeName, before, QString::fromUtf8(data)));
+    return true;
+}
+
+void Project::setFilePatch(const QString &fileName, const QString &patch)
+{
+    if (patch.isEmpty())
+        m_filePatches.remove(fileName);
+    else
+        m_filePatches.insert(fileName, patch);
+}
+
+QString Project::takeFilePatch(const QString &fileName)
+{
+    return m_filePatches.take(fileName);
+}
+
+/*!
+ * \qmlmethod string Project::patch()
+ * Returns the changes of all the documents saved, in a patch `git apply` accepts, if Knut was started with
+ * `--patch <file>`. The documents are not written in that case, the patch is saved in `<file>` on exit.
+ */
+QString Project::patch() const
+{
+    QString result;
+    for (const auto &patch : m_filePatches)
+        result += patch;
+    return result;
+}
+
+bool Project::savePatch(const QString &fileName) const
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        spdlog::error("Project::savePatch - can't write {}: {}", fileName, file.errorString());
+        return false;
+    }
+    file.write(patch().toUtf8());
+    return true;
+}
+
 /*!
  * \qmlmethod Project::openPrevious(int index)
  * Open a previously opened document. `index` is the position of this document in the last opened document.
@@ -369,9 +1890,8 @@ Document *Project::openPrevious(int index)
 {
     LOG("Project::openPrevious", index);
 
-    Q_ASSERT(index < m_documents.size());
-    index = m_documents.size() - index - 1;
-    const QString &fileName = m_documents.at(index)->fileName();
+    Q_ASSERT(index < static_cast<int>(m_documents.size()));
+    const QString &fileName = (*std::prev(m_documents.end(), index + 1))->fileName();
 
     LOG_RETURN("document", open(fileName));
 }
@@ -11,8 +11,18 @@
 #pragma once
 
 #include "document.h"
-
+#include "documentprefetcher.h"
+#include "fileindex.h"
+#include "filequerymatch.h"
+#include "mfcinfo.h"
+#include "scriptcache.h"
+#include "symbolindex.h"
+
+#include <QMap>
 #include <QObject>
+#include <QVariantMap>
+#include <list>
+#include <optional>
 #include <unordered_map>
 
 namespace Lsp {
@@ -21,6 +31,8 @@ class Client;
 
 namespace Core {
 
+class CodeDocument;
+
 class Project : public QObject
 {
     Q_OBJECT
@@ -46,7 +58,7 @@ public:
 
     Core::Document *currentDocument() const;
 
-    const QVector<Document *> &documents() const;
+    QVector<Document *> documents() const;
 
     Q_INVOKABLE QStringList allFiles(Core::Project::PathType type = RelativeToRoot) const;
     Q_INVOKABLE QStringList allFilesWithExtension(const QString &extension,
@@ -54,6 +66,55 @@ public:
     Q_INVOKABLE QStringList allFilesWithExtensions(const QStringList &extensions,
                                                    Core::Project::PathType type = RelativeToRoot);
 
+    Q_INVOKABLE Core::FileQueryMatchList queryAll(const QStringList &extensions, const QString &query);
+    Q_INVOKABLE QVector<Core::MfcFileInfo> mfcExtractAll(const QString &cacheFile = {});
+
+    Q_INVOKABLE QVector<Core::IndexedSymbol> findClass(const QString &name);
+    Q_INVOKABLE QVector<Core::IndexedSymbol> findFunction(const QString &name);
+    Q_INVOKABLE QVector<Core::IndexedSymbol> findCallers(const QString &name);
+    Q_INVOKABLE QVector<Core::IndexedSymbol> findSymbols(const QString &query);
+
+    Q_INVOKABLE QVariantMap memoryReport() const;
+    Q_INVOKABLE QString patch() const;
+
+    Q_INVOKABLE QStringList refreshChanged();
+
+    Q_INVOKABLE void prefetch(const QStringList &fileNames, const QVariantMap &options = {});
+
+    Q_INVOKABLE QVariant cacheValue(const QString &key, const QString &fileName = {});
+    Q_INVOKABLE void setCacheValue(const QString &key, const QVariant &value, const QString &fileName = {});
+    Q_INVOKABLE void clearCache();
+
+    Q_INVOKABLE int changeBaseClasses(const QVariantMap &baseClasses);
+    Q_INVOKABLE QVariantList transformAll(const QStringList &extensions, const QVariantList &rules);
+    Q_INVOKABLE int transformUiFiles(const QString &pattern, const QVariantMap &transform);
+
+    // Returns the file matching one of the `candidates` file names closest to `fileName`: in the same directory if
+    // possible, or the one having the longest common path otherwise. The result is cached for both files.
+    QString findCorrespondingFile(const QString &fileName, const QStringList &candidates);
+
+    // With the patch output, the text documents saved are not written: their changes are collected instead, and can
+    // be saved as one patch with savePatch.
+    void setPatchOutput(bool enabled);
+    bool hasPatchOutput() const { return m_patchOutput; }
+    // Maximum time to wait for the LSP server to index the project before the requests needing the index, like
+    // references. Overrides the `lsp/indexing_timeout` setting, 0 doesn't wait.
+    void setLspIndexingTimeout(int msecs);
+    int lspIndexingTimeout() const;
+    // Records the change of `data` to the file `fileName` if the patch output is used, returns false otherwise, or if
+    // the file is outside of the project
+    static bool recordPatch(const QString &fileName, const QByteArray &data);
+    // Patches of each file, relative to the root. Setting an empty patch removes it.
+    const QMap<QString, QString> &filePatches() const { return m_filePatches; }
+    void setFilePatch(const QString &fileName, const QString &patch);
+    QString takeFilePatch(const QString &fileName);
+    bool savePatch(const QString &fileName) const;
+
+    // In batch mode, documentsChanged and currentDocumentChanged are emitted once when the batch ends, instead of once
+    // per document opened, so the GUI doesn't create a view for each of them. Used while a script runs, can be nested.
+    void beginBatch();
+    void endBatch();
+
 public slots:
     Core::Document *get(const QString &fileName);
     Core::Document *open(const QString &fileName);
@@ -68,18 +129,74 @@ signals:
 
 private:
     friend class KnutCore;
+    friend struct TextLocation;
     explicit Project(QObject *parent = nullptr);
 
     Core::Document *getDocument(QString fileName, bool moveToBack = false);
-    Lsp::Client *getClient(Document::Type type);
+    Core::Document *findDocument(const QString &fileName) const;
+    void updateDocumentFileName(Core::Document *document);
+    void useDocument(Core::Document *document);
+    void evictDocuments();
+    void prefetchFiles(const QStringList &fileNames);
+    void readAhead(const QString &fileName);
+    void lspReadAhead(const QString &fileName);
+    void openLspPrefetch(const QString &fileName);
+    void closeLspWorkFile(const QString &fileName);
+    void adoptLspPrefetch(CodeDocument *document, Lsp::Client *client);
+    Lsp::Client *getClient(Document::Type type, const QString &fileName);
+    void updateFileIndexSettings();
+    void updateSymbolIndex();
+    ScriptCache &scriptCache();
 
 private:
     inline static Project *m_instance = nullptr;
 
     QString m_root;
-    QVector<Document *> m_documents;
+    mutable FileIndex m_fileIndex;
+    // Opened documents, sorted from the least recently opened to the most recently opened
+    std::list<Document *> m_documents;
+    // Map a canonical file name to its document in m_documents
+    std::unordered_map<QString, std::list<Document *>::iterator> m_documentsByFileName;
+    // Documents not evicted, sorted from the least recently used to the most recently used
+    std::list<Document *> m_loadedDocuments;
+    std::unordered_map<Document *, std::list<Document *>::iterator> m_loadedDocumentsIndex;
     Core::Document *m_current = nullptr;
-    std::unordered_map<Core::Document::Type, Lsp::Client *> m_lspClients;
+    // Files loaded in the background, keyed like m_documentsByFileName
+    DocumentPrefetcher m_prefetcher;
+    // Last list of files returned by allFiles or allFilesWithExtension(s), full paths sorted, used for the read-ahead
+    mutable QStringList m_readAheadFiles;
+    // Files given to prefetch with the `lsp` option, opened on the LSP server in a sliding window, full paths in the
+    // order of the script. The index is keyed like m_documentsByFileName.
+    QStringList m_lspWorkFiles;
+    QHash<QString, qsizetype> m_lspWorkIndexes;
+    // Position in m_lspWorkFiles of the last file opened by the script
+    qsizetype m_lspWorkPosition = -1;
+    // Files opened on a LSP server before their document, keyed like m_documentsByFileName
+    struct LspPrefetchedFile
+    {
+        QString fileName;
+        Lsp::Client *client = nullptr;
+        QString text;
+    };
+    std::unordered_map<QString, LspPrefetchedFile> m_lspPrefetchedFiles;
+    // Keyed by type and path of the server, see LspServer::path
+    std::map<std::pair<Core::Document::Type, QString>, Lsp::Client *> m_lspClients;
+    // Pairs found by findCorrespondingFile, in both directions
+    QHash<QString, QString> m_correspondingFiles;
+    // Loaded from the `/cache/symbol_index` file on first use, and updated before each lookup
+    SymbolIndex m_symbolIndex;
+    bool m_symbolIndexLoaded = false;
+    // Loaded from the `/cache/script` file on first use, and saved when the project is destroyed
+    ScriptCache m_scriptCache;
+    QString m_scriptCacheFile;
+    bool m_scriptCacheLoaded = false;
+    bool m_patchOutput = false;
+    std::optional<int> m_lspIndexingTimeout;
+    int m_batchDepth = 0;
+    bool m_documentsChangedInBatch = false;
+    Core::Document *m_currentBeforeBatch = nullptr;
+    // Sorted, so the patch is the same whatever the order the files were saved in
+    QMap<QString, QString> m_filePatches;
 };
 
 } // namespace Core
@@ -21,8 +21,21 @@ struct LspServer
     Document::Type type;
     QString program;
     QStringList arguments;
+    // Local socket of an already running server (e.g. behind a multiplexer), used instead of starting the program
+    QString socket;
+    // Subtree handled by this server, relative to the project root or absolute, empty for the whole project.
+    // Several servers for the same type can split a large project: each one is a separate process, with its own
+    // index of its subtree (usually the directory of a compilation database).
+    QString path;
 };
 
-NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(LspServer, type, program, arguments);
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(LspServer, type, program, arguments, socket, path);
+
+// Returns the absolute path of the subtree handled by `server`, empty if it handles the whole project
+QString lspServerPath(const LspServer &server, const QString &root);
+// Returns the server of `type` handling `fileName`: the one with the longest path containing the file, or else the
+// one without a path. Returns nullptr if there's none.
+const LspServer *findLspServer(const std::vector<LspServer> &servers, Document::Type type, const QString &fileName,
+                               const QString &root);
 
 } // namespace Core
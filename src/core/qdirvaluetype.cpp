@@ -9,9 +9,86 @@
 */
 
 #include "qdirvaluetype.h"
+#include "parallelscriptrunner.h"
+
+#include <QDirIterator>
+#include <QRegularExpression>
+#include <QtConcurrent/QtConcurrentMap>
+#include <algorithm>
 
 namespace Core {
 
+namespace {
+
+struct WalkOptions
+{
+    QDir::Filters filters;
+    QList<QRegularExpression> nameFilters;
+    // Number of levels listed below the start directory, -1 for no limit
+    int maxDepth = -1;
+};
+
+// Path relative to the start directory, and its depth
+using WalkEntry = std::pair<QString, int>;
+
+bool matchEntry(const QFileInfo &fi, const WalkOptions &options)
+{
+    if ((options.filters & QDir::NoSymLinks) && fi.isSymLink())
+        return false;
+    const bool allTypes = !(options.filters & (QDir::Dirs | QDir::Files));
+    if (!allTypes && !(options.filters & (fi.isDir() ? QDir::Dirs : QDir::Files)))
+        return false;
+    if (options.nameFilters.isEmpty())
+        return true;
+    return std::ranges::any_of(options.nameFilters, [&fi](const QRegularExpression &regexp) {
+        return regexp.match(fi.fileName()).hasMatch();
+    });
+}
+
+// Lists the directory `entry`, appending the matching entries to `result` and the directories to walk to `toWalk`
+void walkDirectory(const QString &root, const WalkEntry &entry, const WalkOptions &options, QStringList &result,
+                   QList<WalkEntry> &toWalk)
+{
+    const auto &[path, depth] = entry;
+    const QString prefix = path.isEmpty() ? QString() : path + '/';
+    // QDirIterator reads the directory entries in batches, without an extra stat for each of them
+    QDirIterator it(path.isEmpty() ? root : root + '/' + path,
+                    QDir::AllEntries | QDir::NoDotAndDotDot | (options.filters & (QDir::Hidden | QDir::System)));
+    while (it.hasNext()) {
+        const auto fi = it.nextFileInfo();
+        const QString entryPath = prefix + fi.fileName();
+        if (matchEntry(fi, options))
+            result.push_back(entryPath);
+        // Symbolic links to directories are not followed, they could create cycles
+        if (fi.isDir() && !fi.isSymLink() && (options.maxDepth < 0 || depth + 1 < options.maxDepth))
+            toWalk.push_back({entryPath, depth + 1});
+    }
+}
+
+// Returns the path relative to `root` of all entries matching `options` in the tree, sorted
+// The top-level directories are walked in parallel.
+QStringList walkTree(const QString &root, const WalkOptions &options)
+{
+    QStringList result;
+    QList<WalkEntry> subdirectories;
+    walkDirectory(root, {QString(), 0}, options, result, subdirectories);
+
+    const auto trees =
+        QtConcurrent::blockingMapped<QList<QStringList>>(subdirectories, [&](const WalkEntry &subdirectory) {
+            QStringList entries;
+            QList<WalkEntry> toWalk {subdirectory};
+            while (!toWalk.isEmpty())
+                walkDirectory(root, toWalk.takeLast(), options, entries, toWalk);
+            return entries;
+        });
+    for (const auto &entries : trees)
+        result.append(entries);
+    std::ranges::sort(result);
+    return result;
+}
+
+} // namespace
+
 /*!
  * \qmltype QDirValueType
  * \brief Wrapper around the `QDir` class.
@@ -208,6 +285,84 @@ QStringList QDirValueType::entryList(const QStringList &nameFilters, int filters
     return m_dirValue.entryList(nameFilters, static_cast<QDir::Filters>(filters), static_cast<QDir::SortFlags>(sort));
 }
 
+/*!
+ * \qmlmethod array<string> QDirValueType::walk(int filters)
+ * \qmlmethod array<string> QDirValueType::walk(array<string> nameFilters, int filters)
+ * Returns all entries of the directory tree matching `nameFilters` and `filters`, as paths relative to this directory,
+ * sorted.
+ *
+ * `filters` is the same as for `entryList`, only `Dir.Dirs`, `Dir.Files`, `Dir.NoSymLinks`, `Dir.Hidden`,
+ * `Dir.System` and `Dir.CaseSensitive` are used (default is all files and directories). The name filters only apply
+ * to the entries returned: all non-hidden subdirectories are walked, except symbolic links.
+ *
+ * The tree is walked in parallel, and the list is returned at once:
+ *
+ * ```js
+ * let headers = Dir.create(Project.root).walk(["*.h", "*.hpp"], Dir.Files)
+ * ```
+ */
+QStringList QDirValueType::walk(int filters) const
+{
+    return walk(QStringList(), filters);
+}
+
+QStringList QDirValueType::walk(const QStringList &nameFilters, int filters) const
+{
+    WalkOptions options;
+    options.filters = filters == QDir::NoFilter ? QDir::AllEntries : static_cast<QDir::Filters>(filters);
+    const auto cs = (options.filters & QDir::CaseSensitive) ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    for (const auto &nameFilter : nameFilters)
+        options.nameFilters.push_back(QRegularExpression::fromWildcard(nameFilter, cs));
+    return walkTree(m_dirValue.path(), options);
+}
+
+/*!
+ * \qmlmethod array<string> QDirValueType::glob(string pattern)
+ * Returns all files and directories matching the glob `pattern`, sorted. Relative patterns and paths returned are
+ * relative to this directory.
+ *
+ * `**` matches any number of directories, `*` and `?` don't match across directories, and `{h,cpp}` matches one of
+ * the alternatives. Hidden files and directories are not matched.
+ *
+ * Only the directories which may match are walked, in parallel:
+ *
+ * ```js
+ * let files = Dir.create(Project.root).glob("*.{h,cpp,ui}")
+ * ```
+ */
+QStringList QDirValueType::glob(const QString &pattern) const
+{
+    static const QRegularExpression wildcards(R"([*?{])");
+
+    // The walk starts from the last directory without wildcards
+    const auto components = QDir::fromNativeSeparators(pattern).split('/');
+    qsizetype fixed = 0;
+    while (fixed < components.size() - 1 && !components.at(fixed).contains(wildcards))
+        ++fixed;
+    QString prefix = components.first(fixed).join('/');
+    if (fixed > 0 && prefix.isEmpty())
+        prefix = "/";
+    const QString rest = components.sliced(fixed).join('/');
+    if (!rest.contains(wildcards))
+        return m_dirValue.exists(pattern) ? QStringList {pattern} : QStringList();
+
+    WalkOptions options;
+    options.filters = QDir::AllEntries | QDir::System;
+    options.maxDepth = rest.contains("**") ? -1 : static_cast<int>(components.size() - fixed);
+    const auto regexp = ParallelScriptRunner::globToRegularExpression(rest);
+
+    QStringList result = walkTree(prefix.isEmpty() ? m_dirValue.path() : m_dirValue.filePath(prefix), options);
+    result.removeIf([&regexp](const QString &path) {
+        return !regexp.match(path).hasMatch();
+    });
+    if (!prefix.isEmpty()) {
+        const QString start = prefix.endsWith('/') ? prefix : prefix + '/';
+        for (auto &path : result)
+            path.prepend(start);
+    }
+    return result;
+}
+
 /*!
  * \qmlmethod bool QDirValueType::mkdir(string dirName)
  */
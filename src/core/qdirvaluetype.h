@@ -60,6 +60,10 @@ public:
     Q_INVOKABLE QStringList entryList(const QStringList &nameFilters, int filters = QDir::NoFilter,
                                       int sort = QDir::NoSort) const;
 
+    Q_INVOKABLE QStringList walk(int filters = QDir::NoFilter) const;
+    Q_INVOKABLE QStringList walk(const QStringList &nameFilters, int filters = QDir::NoFilter) const;
+    Q_INVOKABLE QStringList glob(const QString &pattern) const;
+
     Q_INVOKABLE bool mkdir(const QString &dirName) const;
     Q_INVOKABLE bool rmdir(const QString &dirName) const;
     Q_INVOKABLE bool mkpath(const QString &dirPath) const;
@@ -13,7 +13,7 @@
 namespace Core {
 
 QmlDocument::QmlDocument(QObject *parent)
-    : TextDocument(Type::Qml, parent)
+    : CodeDocument(Type::Qml, parent)
 {
 }
 
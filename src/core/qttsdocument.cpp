@@ -11,6 +11,7 @@
 #include "qttsdocument.h"
 #include "logger.h"
 #include "utils/log.h"
+#include "utils/xml_helper.h"
 
 #include <QFile>
 #include <QUiLoader>
@@ -96,6 +97,12 @@ void QtTsDocument::setSourceLanguage(const QString &lang)
     Q_EMIT fileUpdated();
 }
 
+// A message is identified by its context, source and comment, which can't contain the separator
+static QString messageKey(const QString &context, const QString &source, const QString &comment)
+{
+    return context + QChar(0) + source + QChar(0) + comment;
+}
+
 void QtTsDocument::addMessage(pugi::xml_node contextChild, const QString &context, const QString &location,
                               const QString &source, const QString &translation, const QString &comment)
 {
@@ -115,51 +122,89 @@ void QtTsDocument::addMessage(pugi::xml_node contextChild, const QString &contex
     pugi::xml_node translationChild = messageChild.append_child("translation"); // add translation
     translationChild.append_child(pugi::node_pcdata).set_value(translation.toUtf8().constData());
 
-    m_messages.push_back(new QtTsMessage(context, messageChild, this));
+    auto message = new QtTsMessage(context, messageChild, this);
+    m_messages.push_back(message);
+    m_messageIndex.insert(messageKey(context, source, comment), message);
+}
+
+// Returns the <context> node named `context`, creating it if needed
+pugi::xml_node QtTsDocument::contextNode(const QString &context)
+{
+    if (const auto it = m_contexts.constFind(context); it != m_contexts.cend())
+        return *it;
+
+    initializeXml();
+    const auto ts = m_document.select_node("TS");
+    pugi::xml_node contextChild = ts.node().append_child("context");
+
+    pugi::xml_node nameChild = contextChild.append_child("name"); // add name
+    nameChild.append_child(pugi::node_pcdata).set_value(context.toLatin1().constData());
+    m_contexts.insert(context, contextChild);
+    return contextChild;
+}
+
+void QtTsDocument::insertMessage(const QString &context, const QString &fileName, const QString &source,
+                                 const QString &translation, const QString &comment)
+{
+    if (fileName.isEmpty() || source.isEmpty() || context.isEmpty()) {
+        spdlog::error(R"(Location or context or source is empty)");
+    }
+
+    // The same message is only translated once
+    if (const auto it = m_messageIndex.constFind(messageKey(context, source, comment)); it != m_messageIndex.cend()) {
+        (*it)->m_message.child("translation").text().set(translation.toUtf8().constData());
+        return;
+    }
+    addMessage(contextNode(context), context, fileName, source, translation, comment);
 }
 
 /*!
  * \qmlmethod QtTsDocument::addMessage(string context, string location, string source, string translation)
  * Add a new source text, its translation located in location within the given context.
+ *
+ * If the context already has a message with the same source and comment, only its translation is changed.
  */
 
 void QtTsDocument::addMessage(const QString &context, const QString &fileName, const QString &source,
                               const QString &translation, const QString &comment)
 {
     LOG("QtTsDocument::addMessage", context, fileName, source, translation, comment);
-    if (fileName.isEmpty() || source.isEmpty() || context.isEmpty()) {
-        spdlog::error(R"(Location or context or source is empty)");
-    }
 
-    initializeXml();
-    auto isContext = [context](const auto &data) {
-        return context == data->context();
-    };
-    auto contextNode = std::ranges::find_if(m_messages, isContext);
-
-    if (contextNode == m_messages.end()) {
-        const auto ts = m_document.select_node("TS");
-        pugi::xml_node contextChild = ts.node().append_child("context");
-
-        pugi::xml_node nameChild = contextChild.append_child("name"); // add name
-        nameChild.append_child(pugi::node_pcdata).set_value(context.toLatin1().constData());
-        addMessage(contextChild, context, fileName, source, translation, comment);
-    } else {
-        const auto contexts = m_document.select_nodes("//context");
-        for (const auto &node : contexts) {
-            Q_ASSERT(!node.node().empty());
-            const QString contextName = QString::fromLatin1(node.node().child("name").text().as_string());
-            if (contextName == context) {
-                addMessage(node.node(), context, fileName, source, translation, comment);
-                break;
-            }
-        }
-    }
+    insertMessage(context, fileName, source, translation, comment);
     // m_document.save_file("foo.xml"); // Debug create foo.xml
     Q_EMIT messagesChanged();
     Q_EMIT fileUpdated();
 }
 
+/*!
+ * \qmlmethod QtTsDocument::addMessages(array<object> messages)
+ * Adds all the `messages`, each one being an object with the `context`, `fileName`, `source`, `translation` and
+ * optional `comment` keys. This is the same as calling `addMessage` for each message, but a lot faster for a large
+ * number of messages.
+ *
+ * ```js
+ * document.addMessages([
+ *     {context: "MainWindow", fileName: "mainwindow.cpp", source: "Open", translation: "Ouvrir"},
+ *     {context: "MainWindow", fileName: "mainwindow.cpp", source: "Close", translation: "Fermer"},
+ * ]);
+ * ```
+ */
+void QtTsDocument::addMessages(const QVariantList &messages)
+{
+    LOG("QtTsDocument::addMessages", LOG_ARG("count", messages.size()));
+
+    m_messages.reserve(m_messages.size() + messages.size());
+    m_messageIndex.reserve(m_messageIndex.size() + messages.size());
+    for (const auto &message : messages) {
+        const auto map = message.toMap();
+        insertMessage(map.value("context").toString(), map.value("fileName").toString(),
+                      map.value("source").toString(), map.value("translation").toString(),
+                      map.value("comment").toString());
+    }
+    Q_EMIT messagesChanged();
+    Q_EMIT fileUpdated();
+}
+
 bool QtTsDocument::doSave(const QString &fileName)
 {
     return m_document.save_file(fileName.toLatin1().constData(), "    ");
@@ -168,8 +213,11 @@ bool QtTsDocument::doSave(const QString &fileName)
 bool QtTsDocument::doLoad(const QString &fileName)
 {
     m_messages.clear();
+    m_contexts.clear();
+    m_messageIndex.clear();
+    // Parsed in place, the document owns the content of the file instead of a copy
     pugi::xml_parse_result result =
-        m_document.load_file(fileName.toLatin1().constData(), pugi::parse_default | pugi::parse_declaration);
+        Utils::loadXmlFile(m_document, fileName, pugi::parse_default | pugi::parse_declaration);
 
     if (!result) {
         spdlog::critical("{}({}): {}", fileName, result.offset, result.description());
@@ -186,11 +234,19 @@ bool QtTsDocument::doLoad(const QString &fileName)
     for (const auto &node : contexts) {
         Q_ASSERT(!node.node().empty());
         const QString contextName = QString::fromLatin1(node.node().child("name").text().as_string());
+        if (!m_contexts.contains(contextName))
+            m_contexts.insert(contextName, node.node());
 
         const auto messages = node.node().select_nodes("message");
         for (const auto &message : messages) {
-
-            m_messages.push_back(new QtTsMessage(contextName, message.node(), this));
+            auto tsMessage = new QtTsMessage(contextName, message.node(), this);
+            m_messages.push_back(tsMessage);
+            // Texts are stored in UTF-8, same as in addMessage
+            const auto source = QString::fromUtf8(message.node().child("source").text().as_string());
+            const auto comment = QString::fromUtf8(message.node().child("comment").text().as_string());
+            const auto key = messageKey(contextName, source, comment);
+            if (!m_messageIndex.contains(key))
+                m_messageIndex.insert(key, tsMessage);
         }
     }
     return true;
@@ -12,6 +12,7 @@
 
 #include "textdocument.h"
 
+#include <QHash>
 #include <pugixml.hpp>
 
 namespace Core {
@@ -68,6 +69,7 @@ public:
     Q_INVOKABLE void setLanguage(const QString &lang);
     Q_INVOKABLE void addMessage(const QString &context, const QString &fileName, const QString &source,
                                 const QString &translation, const QString &comment = QString());
+    Q_INVOKABLE void addMessages(const QVariantList &messages);
 
     QString language() const;
     QString sourceLanguage() const;
@@ -84,12 +86,19 @@ signals:
 
 private:
     friend QtTsMessage;
+    void insertMessage(const QString &context, const QString &fileName, const QString &source,
+                       const QString &translation, const QString &comment);
     void addMessage(pugi::xml_node contextChild, const QString &context, const QString &location, const QString &source,
                     const QString &translation, const QString &comment = QString());
+    pugi::xml_node contextNode(const QString &context);
     void initializeXml();
     pugi::xml_document m_document;
 
     QVector<QtTsMessage *> m_messages;
+    // <context> nodes by name
+    QHash<QString, pugi::xml_node> m_contexts;
+    // Messages by context, source and comment, see messageKey
+    QHash<QString, QtTsMessage *> m_messageIndex;
 };
 
 } // namespace Core
@@ -11,12 +11,14 @@
 #include "qtuidocument.h"
 #include "logger.h"
 #include "utils/log.h"
+#include "utils/memoryaccounting.h"
 #include "utils/qtuiwriter.h"
+#include "utils/xml_helper.h"
 
 #include <QFile>
 #include <QUiLoader>
 #include <QWidget>
-#include <kdalgorithms.h>
+#include <algorithm>
 
 namespace Core {
 
@@ -32,6 +34,21 @@ namespace Core {
  * List of all widgets in the ui file.
  */
 
+/*!
+ * \qmlsignal QtUiDocument::widgetAdded(QtUiWidget widget)
+ * This handler is called when `widget` is added to the document, it's always the last one in `widgets`.
+ */
+
+/*!
+ * \qmlsignal QtUiDocument::widgetChanged(QtUiWidget widget)
+ * This handler is called when the name or the class name of `widget` is changed.
+ */
+
+/*!
+ * \qmlsignal QtUiDocument::widgetPropertyChanged(QtUiWidget widget, string name)
+ * This handler is called when the property `name` is added to `widget`.
+ */
+
 QtUiDocument::QtUiDocument(QObject *parent)
     : Document(Type::QtUi, parent)
 {
@@ -39,6 +56,24 @@ QtUiDocument::QtUiDocument(QObject *parent)
 
 QtUiDocument::~QtUiDocument() = default;
 
+QVector<QtUiWidget *> QtUiDocument::widgets() const
+{
+    if (!m_allWidgetsCreated) {
+        for (int i = 0; i < m_widgets.size(); ++i)
+            widgetAt(i);
+        m_allWidgetsCreated = true;
+    }
+    return m_widgets;
+}
+
+QtUiWidget *QtUiDocument::widgetAt(int index) const
+{
+    auto &widget = m_widgets[index];
+    if (!widget)
+        widget = new QtUiWidget(m_widgetNodes.at(index), index == 0, const_cast<QtUiDocument *>(this));
+    return widget;
+}
+
 /*!
  * \qmlmethod QtUiWidget QtUiDocument::findWidget(string name)
  * Returns the widget for the given `name`.
@@ -47,12 +82,40 @@ QtUiWidget *QtUiDocument::findWidget(const QString &name) const
 {
     LOG("QtUiDocument::findWidget", name);
 
-    auto result = kdalgorithms::find_if(m_widgets, [name](QtUiWidget *widget) {
-        return widget->name() == name;
-    });
-    if (!result)
+    const auto index = m_widgetIndex.value(name, -1);
+    if (index == -1)
         return nullptr;
-    return *result;
+    return widgetAt(index);
+}
+
+// Returns the index of the widget `node` in m_widgetNodes, or -1 if it's not a widget of this document
+int QtUiDocument::indexOf(pugi::xml_node node) const
+{
+    const auto it = std::ranges::find(m_widgetNodes, node);
+    return it == m_widgetNodes.end() ? -1 : static_cast<int>(it - m_widgetNodes.begin());
+}
+
+// Keeps m_widgetIndex up to date when the widget `node` is renamed from `oldName` to `newName`
+void QtUiDocument::updateWidgetIndex(pugi::xml_node node, const QString &oldName, const QString &newName)
+{
+    const auto index = indexOf(node);
+    if (index == -1)
+        return;
+
+    if (m_widgetIndex.value(oldName, -1) == index) {
+        m_widgetIndex.remove(oldName);
+        // Another widget may have the same name
+        for (int i = index + 1; i < static_cast<int>(m_widgetNodes.size()); ++i) {
+            if (oldName == QLatin1String(m_widgetNodes[i].attribute("name").value())) {
+                m_widgetIndex.insert(oldName, i);
+                break;
+            }
+        }
+    }
+
+    const auto it = m_widgetIndex.constFind(newName);
+    if (it == m_widgetIndex.cend() || it.value() > index)
+        m_widgetIndex.insert(newName, index);
 }
 
 /*!
@@ -65,7 +128,7 @@ Core::QtUiWidget *QtUiDocument::addWidget(const QString &className, const QStrin
 {
     LOG("QtUiDocument::addWidget", className, name);
 
-    if (m_widgets.empty() && parent) {
+    if (m_widgetNodes.empty() && parent) {
         spdlog::error("QtUiDocument::addWidget - adding a widget to a non-root widget is not supported yet.");
         return nullptr;
     }
@@ -73,8 +136,12 @@ Core::QtUiWidget *QtUiDocument::addWidget(const QString &className, const QStrin
     const auto node = uiWriter()->addWidget(className, name, parent ? parent->xmlNode() : pugi::xml_node {});
 
     QtUiWidget *newWidget = new QtUiWidget(node, parent == nullptr, this);
+    if (!m_widgetIndex.contains(name))
+        m_widgetIndex.insert(name, static_cast<int>(m_widgetNodes.size()));
+    m_widgetNodes.push_back(node);
     m_widgets.push_back(newWidget);
     setHasChanged(true);
+    emit widgetAdded(newWidget);
     emit widgetsChanged();
     return newWidget;
 }
@@ -139,26 +206,60 @@ bool QtUiDocument::doSave(const QString &fileName)
 
 bool QtUiDocument::doLoad(const QString &fileName)
 {
-    m_widgets.clear();
+    const Utils::AllocationScope allocations(Utils::MemoryAccounting::Pugixml);
+    // Whitespace-only text is not kept (no parse_ws_pcdata), the document is indented again when saved
     pugi::xml_parse_result result =
-        m_document.load_file(fileName.toLatin1().constData(), pugi::parse_default | pugi::parse_declaration);
+        Utils::loadXmlFile(m_document, fileName, pugi::parse_default | pugi::parse_declaration);
+    // The previous content is freed by loadXmlFile
+    m_documentBytes = std::max<int64_t>(0, m_documentBytes + allocations.bytes());
+
+    // On failure the document is empty, so is the index
+    indexWidgets();
 
     if (!result) {
         spdlog::critical("{}({}): {}", fileName, result.offset, result.description());
         return false;
     }
+    return true;
+}
 
-    const auto widgets = m_document.select_nodes("//widget");
+/**
+ * Takes the content of `document`, without serializing and parsing it again.
+ *
+ * Used to create a ui file in memory, like for the RC to UI conversion. The document is not saved to disk until
+ * `saveAs` is called.
+ */
+void QtUiDocument::setXmlDocument(pugi::xml_document &&document)
+{
+    m_document = std::move(document);
+    indexWidgets();
+    setHasChanged(true);
+}
+
+QVariantMap QtUiDocument::memoryUsage() const
+{
+    return {{"xml", static_cast<qint64>(m_documentBytes)}};
+}
 
-    bool isRoot = true;
+void QtUiDocument::indexWidgets()
+{
+    m_widgetNodes.clear();
+    m_widgets.clear();
+    m_allWidgetsCreated = false;
+    m_widgetIndex.clear();
+
+    // The QtUiWidget wrappers are only created when needed, see widgetAt
+    const auto widgets = m_document.select_nodes("//widget");
+    m_widgetNodes.reserve(widgets.size());
     for (const auto &node : widgets) {
         Q_ASSERT(!node.node().empty());
-        m_widgets.push_back(new QtUiWidget(node.node(), isRoot, this));
-        isRoot = false;
+        const auto name = QString::fromLatin1(node.node().attribute("name").value());
+        if (!m_widgetIndex.contains(name))
+            m_widgetIndex.insert(name, static_cast<int>(m_widgetNodes.size()));
+        m_widgetNodes.push_back(node.node());
     }
+    m_widgets.resize(m_widgetNodes.size(), nullptr);
     emit widgetsChanged();
-
-    return true;
 }
 
 Utils::QtUiWriter *QtUiDocument::uiWriter()
@@ -205,12 +306,16 @@ void QtUiWidget::setName(const QString &newName)
 {
     LOG("QtUiWidget::setName", newName);
 
-    if (newName == name())
+    const auto oldName = name();
+    if (newName == oldName)
         return;
 
-    qobject_cast<QtUiDocument *>(parent())->uiWriter()->setWidgetName(m_widget, newName, m_isRoot);
-    qobject_cast<QtUiDocument *>(parent())->setHasChanged(true);
+    auto document = qobject_cast<QtUiDocument *>(parent());
+    document->uiWriter()->setWidgetName(m_widget, newName, m_isRoot);
+    document->updateWidgetIndex(m_widget, oldName, newName);
+    document->setHasChanged(true);
     emit nameChanged(newName);
+    emit document->widgetChanged(this);
 }
 
 QString QtUiWidget::className() const
@@ -225,9 +330,11 @@ void QtUiWidget::setClassName(const QString &newClassName)
     if (newClassName == className())
         return;
 
-    qobject_cast<QtUiDocument *>(parent())->uiWriter()->setWidgetClassName(m_widget, newClassName);
-    qobject_cast<QtUiDocument *>(parent())->setHasChanged(true);
+    auto document = qobject_cast<QtUiDocument *>(parent());
+    document->uiWriter()->setWidgetClassName(m_widget, newClassName);
+    document->setHasChanged(true);
     emit classNameChanged(newClassName);
+    emit document->widgetChanged(this);
 }
 
 /*!
@@ -277,12 +384,13 @@ void QtUiWidget::addProperty(const QString &name, const QVariant &value, const Q
 {
     LOG("QtUiWidget::addProperty", name, value);
 
-    const auto result =
-        qobject_cast<QtUiDocument *>(parent())->uiWriter()->addWidgetProperty(m_widget, name, value, attributes);
+    auto document = qobject_cast<QtUiDocument *>(parent());
+    const auto result = document->uiWriter()->addWidgetProperty(m_widget, name, value, attributes);
 
     switch (result) {
     case Utils::QtUiWriter::Success:
-        qobject_cast<QtUiDocument *>(parent())->setHasChanged(true);
+        document->setHasChanged(true);
+        emit document->widgetPropertyChanged(this, name);
         return;
     case Utils::QtUiWriter::InvalidProperty:
         spdlog::error(R"(QtUiWidget::addProperty - unknown {} type)", value.typeName());
@@ -12,7 +12,9 @@
 
 #include "document.h"
 
+#include <QHash>
 #include <pugixml.hpp>
+#include <vector>
 
 namespace Utils {
 class QtUiWriter;
@@ -68,7 +70,7 @@ public:
     explicit QtUiDocument(QObject *parent = nullptr);
     ~QtUiDocument() override;
 
-    QVector<Core::QtUiWidget *> widgets() const { return m_widgets; }
+    QVector<Core::QtUiWidget *> widgets() const;
     Q_INVOKABLE Core::QtUiWidget *findWidget(const QString &name) const;
 
     Q_INVOKABLE Core::QtUiWidget *addWidget(const QString &className, const QString &name,
@@ -76,11 +78,18 @@ public:
     Q_INVOKABLE void addCustomWidget(const QString &className, const QString &baseClassName, const QString &header,
                                      bool isContainer = false);
 
+    void setXmlDocument(pugi::xml_document &&document);
+
+    QVariantMap memoryUsage() const override;
+
 public slots:
     void preview() const;
 
 signals:
     void widgetsChanged();
+    void widgetAdded(Core::QtUiWidget *widget);
+    void widgetChanged(Core::QtUiWidget *widget);
+    void widgetPropertyChanged(Core::QtUiWidget *widget, const QString &name);
 
 protected:
     bool doSave(const QString &fileName) override;
@@ -88,11 +97,24 @@ protected:
 
 private:
     Utils::QtUiWriter *uiWriter();
+    void indexWidgets();
+
+    QtUiWidget *widgetAt(int index) const;
+    int indexOf(pugi::xml_node node) const;
+    void updateWidgetIndex(pugi::xml_node node, const QString &oldName, const QString &newName);
 
     friend QtUiWidget;
     pugi::xml_document m_document;
+    // Memory allocated by pugixml for m_document when it was loaded
+    int64_t m_documentBytes = 0;
     std::unique_ptr<Utils::QtUiWriter> m_writer;
-    QVector<QtUiWidget *> m_widgets;
+    // All widget nodes, in the order of the file, the first one being the root widget
+    std::vector<pugi::xml_node> m_widgetNodes;
+    // Wrappers of m_widgetNodes, created when first needed (nullptr until then)
+    mutable QVector<QtUiWidget *> m_widgets;
+    mutable bool m_allWidgetsCreated = false;
+    // Index in m_widgetNodes of the first widget with a given name
+    QHash<QString, int> m_widgetIndex;
 };
 
 } // namespace Core
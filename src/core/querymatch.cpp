@@ -85,16 +85,33 @@ QString QueryCapture::toString() const
  */
 
 QueryMatch::QueryMatch(TextDocument &document, const treesitter::QueryMatch &match)
+    : m_idsByName(match.query()->captureIds())
 {
-    const auto captures = match.captures();
+    const auto &captures = match.captures();
+    m_captures.reserve(captures.size());
+    m_ids.reserve(captures.size());
     for (const auto &capture : captures) {
-        const auto name = match.query()->captureAt(capture.id).name;
-
         const auto &node = capture.node;
         const auto range = document.createRangeMark(node.startPosition(), node.endPosition());
 
-        m_captures.emplace_back(QueryCapture {.name = name, .range = range});
+        m_captures.emplace_back(QueryCapture {.name = match.query()->captureAt(capture.id).name, .range = range});
+        m_ids.push_back(static_cast<int>(capture.id));
+    }
+}
+
+QueryMatch::QueryMatch(QVector<QueryCapture> &&captures)
+    : m_captures(std::move(captures))
+{
+    // No query here, the ids are given in the order of the names
+    QHash<QString, uint32_t> idsByName;
+    m_ids.reserve(m_captures.size());
+    for (const auto &capture : std::as_const(m_captures)) {
+        auto it = idsByName.constFind(capture.name);
+        if (it == idsByName.cend())
+            it = idsByName.insert(capture.name, static_cast<uint32_t>(idsByName.size()));
+        m_ids.push_back(static_cast<int>(*it));
     }
+    m_idsByName = std::make_shared<const QHash<QString, uint32_t>>(std::move(idsByName));
 }
 
 const QVector<QueryCapture> &QueryMatch::captures() const
@@ -113,14 +130,7 @@ bool QueryMatch::isEmpty() const
  */
 Core::RangeMarkList QueryMatch::getAll(const QString &name) const
 {
-    Core::RangeMarkList result;
-
-    for (const auto &capture : m_captures) {
-        if (capture.name == name)
-            result.emplace_back(capture.range);
-    }
-
-    return result;
+    return getAllById(captureId(name));
 }
 
 /*!
@@ -129,13 +139,13 @@ Core::RangeMarkList QueryMatch::getAll(const QString &name) const
  */
 Core::RangeMarkList QueryMatch::getAllInRange(const QString &name, const Core::RangeMark &range) const
 {
-    auto captureMatch = [&name, &range](const QueryCapture &capture) {
-        return capture.name == name && range.contains(capture.range);
-    };
-    auto toRange = [](const QueryCapture &capture) {
-        return capture.range;
-    };
-    return kdalgorithms::filtered_transformed(m_captures, toRange, captureMatch);
+    const int id = captureId(name);
+    Core::RangeMarkList result;
+    for (qsizetype i = 0; i < m_captures.size(); ++i) {
+        if (m_ids[i] == id && range.contains(m_captures[i].range))
+            result.emplace_back(m_captures[i].range);
+    }
+    return result;
 }
 
 /*!
@@ -156,12 +166,7 @@ Core::RangeMarkList QueryMatch::getAllInRange(const QString &name, const Core::R
  */
 RangeMark QueryMatch::get(const QString &name) const
 {
-    for (const auto &capture : m_captures) {
-        if (capture.name == name)
-            return capture.range;
-    }
-
-    return RangeMark();
+    return getById(captureId(name));
 }
 
 /*!
@@ -170,12 +175,11 @@ RangeMark QueryMatch::get(const QString &name) const
  */
 Core::RangeMark QueryMatch::getInRange(const QString &name, const Core::RangeMark &range) const
 {
-    auto captureMatch = [&name, &range](const QueryCapture &capture) {
-        return capture.name == name && range.contains(capture.range);
-    };
-    auto result = kdalgorithms::find_if(m_captures, captureMatch);
-    if (result)
-        return result->range;
+    const int id = captureId(name);
+    for (qsizetype i = 0; i < m_captures.size(); ++i) {
+        if (m_ids[i] == id && range.contains(m_captures[i].range))
+            return m_captures[i].range;
+    }
     return {};
 }
 
@@ -193,6 +197,75 @@ RangeMark QueryMatch::getAllJoined(const QString &name) const
     return kdalgorithms::accumulate(ranges, &RangeMark::join, ranges.at(0));
 }
 
+/*!
+ * \qmlmethod array<int> QueryMatch::ranges(string name)
+ * Returns the positions of all captures of the given `name`, as a flat array: `[start0, end0, start1, end1, ...]`.
+ *
+ * This is cheaper than `getAll` when only the positions are needed, as no RangeMark is passed to JavaScript.
+ */
+QList<int> QueryMatch::ranges(const QString &name) const
+{
+    const int id = captureId(name);
+    QList<int> result;
+    for (qsizetype i = 0; i < m_captures.size(); ++i) {
+        if (m_ids[i] == id) {
+            result.push_back(m_captures[i].range.start());
+            result.push_back(m_captures[i].range.end());
+        }
+    }
+    return result;
+}
+
+/*!
+ * \qmlmethod int QueryMatch::captureId(string name)
+ * Returns the id of the capture `name` in the query, or -1 if the query has no such capture. The id is the same for
+ * all the matches of a query.
+ *
+ * The names passed to the other getters are converted to an id each time. When the same capture is read in many
+ * matches, the id can be computed once and passed to `getById` or `getAllById` instead:
+ * ``` javascript
+ * let matches = document.query("(call_expression function: (_) @function)");
+ * let id = matches.length > 0 ? matches[0].captureId("function") : -1;
+ * for (let match of matches)
+ *     Message.log(match.getById(id).text);
+ * ```
+ */
+int QueryMatch::captureId(const QString &name) const
+{
+    if (!m_idsByName)
+        return -1;
+    auto it = m_idsByName->constFind(name);
+    return it == m_idsByName->cend() ? -1 : static_cast<int>(*it);
+}
+
+/*!
+ * \qmlmethod RangeMark QueryMatch::getById(int id)
+ * Returns the range covered by the first capture with the given `id`, see `captureId`.
+ */
+RangeMark QueryMatch::getById(int id) const
+{
+    if (id < 0)
+        return {};
+    const auto index = m_ids.indexOf(id);
+    return index == -1 ? RangeMark() : m_captures.at(index).range;
+}
+
+/*!
+ * \qmlmethod array<RangeMark> QueryMatch::getAllById(int id)
+ * Returns all ranges that are covered by the captures with the given `id`, see `captureId`.
+ */
+Core::RangeMarkList QueryMatch::getAllById(int id) const
+{
+    Core::RangeMarkList result;
+    if (id < 0)
+        return result;
+    for (qsizetype i = 0; i < m_captures.size(); ++i) {
+        if (m_ids[i] == id)
+            result.emplace_back(m_captures[i].range);
+    }
+    return result;
+}
+
 /**
  * \qmlmethod array<QueryMatch> QueryMatch::queryIn(capture, query)
  * \param capture The name of the capture to query in
@@ -232,6 +305,24 @@ Core::QueryMatchList QueryMatch::queryIn(const QString &capture, const QString &
     return result;
 }
 
+Core::QueryMatchList QueryMatch::queryIn(const QString &capture,
+                                         const std::shared_ptr<treesitter::Query> &query) const
+{
+    Core::QueryMatchList result;
+
+    const auto ranges = getAll(capture);
+    for (const auto &range : ranges) {
+        auto document = qobject_cast<CodeDocument *>(range.document());
+        if (document) {
+            result.append(document->queryInRange(range, query));
+        } else {
+            spdlog::warn("QueryMatch::queryIn: RangeMark is not backed by CodeDocument!");
+        }
+    }
+
+    return result;
+}
+
 QString QueryMatch::toString() const
 {
     return QString("QueryMatch{%1}").arg(m_captures.size());
@@ -12,9 +12,12 @@
 
 #include "rangemark.h"
 
+#include <QHash>
 #include <QObject>
+#include <memory>
 
 namespace treesitter {
+class Query;
 class QueryMatch;
 }
 
@@ -47,6 +50,7 @@ public:
     // Default constructor is required for Q_DECLARE_METATYPE
     QueryMatch() = default;
     QueryMatch(TextDocument &document, const treesitter::QueryMatch &match);
+    explicit QueryMatch(QVector<QueryCapture> &&captures);
 
     const QVector<QueryCapture> &captures() const;
     bool isEmpty() const;
@@ -57,6 +61,12 @@ public:
     Q_INVOKABLE Core::RangeMarkList getAll(const QString &name) const;
     Q_INVOKABLE Core::RangeMarkList getAllInRange(const QString &name, const Core::RangeMark &range) const;
     Q_INVOKABLE Core::RangeMark getAllJoined(const QString &name) const;
+    Q_INVOKABLE QList<int> ranges(const QString &name) const;
+
+    // Access to captures by id, to avoid comparing the names in tight loops
+    Q_INVOKABLE int captureId(const QString &name) const;
+    Q_INVOKABLE Core::RangeMark getById(int id) const;
+    Q_INVOKABLE Core::RangeMarkList getAllById(int id) const;
 
     // Sub-query in capture
     // This API is exposed publicly here, instead of on RangeMark, as we could in future
@@ -71,11 +81,17 @@ public:
     // let matches = function.queryIn("body", ...);
     // ```
     Q_INVOKABLE QList<Core::QueryMatch> queryIn(const QString &capture, const QString &query) const;
+    // Same with a compiled query, not available from QML/JS
+    QList<Core::QueryMatch> queryIn(const QString &capture, const std::shared_ptr<treesitter::Query> &query) const;
 
     Q_INVOKABLE QString toString() const;
 
 private:
     QVector<QueryCapture> m_captures;
+    // Capture id of each capture in m_captures
+    QVector<int> m_ids;
+    // Capture ids by name, shared by all the matches of a query
+    std::shared_ptr<const QHash<QString, uint32_t>> m_idsByName;
 };
 
 using QueryMatchList = QList<Core::QueryMatch>;
@@ -0,0 +1,105 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "querymatchiterator.h"
+#include "codedocument.h"
+#include "scriptdialogitem.h"
+#include "treesitter/predicates.h"
+
+#include <QTextDocument>
+#include <spdlog/spdlog.h>
+
+namespace Core {
+
+/*!
+ * \qmltype QueryMatchIterator
+ * \brief Iterates over the matches of a query.
+ * \inqmlmodule Script
+ * \ingroup CodeDocument
+ * \sa CodeDocument::queryIterator
+ *
+ * The QueryMatchIterator returns the matches of a query one by one, only searching for the next match when needed.
+ * This is faster than `CodeDocument::query` if you don't need all the matches:
+ *
+ * ``` javascript
+ * let it = document.queryIterator("(call_expression) @call");
+ * while (it.hasNext()) {
+ *     let match = it.next();
+ *     if (match.get("call").text.startsWith("foo"))
+ *         break;
+ * }
+ * ```
+ *
+ * The iteration stops as soon as the document is changed.
+ */
+
+QueryMatchIterator::QueryMatchIterator(CodeDocument *document, std::optional<treesitter::Tree> &&tree,
+                                       const QString &source, std::shared_ptr<treesitter::Query> query,
+                                       QObject *parent)
+    : QObject(parent)
+    , m_document(document)
+    , m_tree(std::move(tree))
+{
+    if (!m_document || !m_tree || !query) {
+        m_done = true;
+        return;
+    }
+
+    m_cursor.setProgressCallback(ScriptDialogItem::updateProgress);
+    m_cursor.execute(std::move(query), m_tree->rootNode(), std::make_unique<treesitter::Predicates>(source));
+
+    // The matches are converted to positions in the document, there's no way to update them after a change
+    connect(m_document->qTextDocument(), &QTextDocument::contentsChange, this, [this]() {
+        if (!m_done)
+            spdlog::warn("QueryMatchIterator: the document has changed, stopping the iteration");
+        m_done = true;
+        m_next.reset();
+    });
+}
+
+QueryMatchIterator::~QueryMatchIterator() = default;
+
+void QueryMatchIterator::fetchNext()
+{
+    if (m_fetched || m_done)
+        return;
+
+    m_next = m_cursor.nextMatch();
+    m_fetched = true;
+    m_done = !m_next.has_value();
+}
+
+/*!
+ * \qmlmethod bool QueryMatchIterator::hasNext()
+ * Returns true if there are more matches.
+ */
+bool QueryMatchIterator::hasNext()
+{
+    fetchNext();
+    return m_next.has_value();
+}
+
+/*!
+ * \qmlmethod QueryMatch QueryMatchIterator::next()
+ * Returns the next match, or an empty match if there are no more matches.
+ */
+Core::QueryMatch QueryMatchIterator::next()
+{
+    fetchNext();
+    if (!m_next || !m_document)
+        return {};
+
+    QueryMatch match(*m_document, m_next.value());
+    m_next.reset();
+    m_fetched = false;
+    return match;
+}
+
+} // namespace Core
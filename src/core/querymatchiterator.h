@@ -0,0 +1,51 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include "querymatch.h"
+#include "treesitter/query.h"
+#include "treesitter/tree.h"
+
+#include <QObject>
+#include <QPointer>
+#include <memory>
+#include <optional>
+
+namespace Core {
+
+class CodeDocument;
+
+class QueryMatchIterator : public QObject
+{
+    Q_OBJECT
+
+public:
+    QueryMatchIterator(CodeDocument *document, std::optional<treesitter::Tree> &&tree, const QString &source,
+                       std::shared_ptr<treesitter::Query> query, QObject *parent = nullptr);
+    ~QueryMatchIterator() override;
+
+    Q_INVOKABLE bool hasNext();
+    Q_INVOKABLE Core::QueryMatch next();
+
+private:
+    void fetchNext();
+
+    QPointer<CodeDocument> m_document;
+    // The cursor runs on its own copy of the tree, so it's not affected by reparsing the document.
+    // It must be declared before the cursor, as the cursor needs it.
+    std::optional<treesitter::Tree> m_tree;
+    treesitter::QueryCursor m_cursor;
+    std::optional<treesitter::QueryMatch> m_next;
+    bool m_fetched = false;
+    bool m_done = false;
+};
+
+} // namespace Core
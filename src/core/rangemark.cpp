@@ -14,8 +14,6 @@
 #include "textdocument.h"
 #include "utils/log.h"
 
-#include <QPlainTextEdit>
-
 namespace Core {
 
 /*!
@@ -52,16 +50,24 @@ namespace Core {
 
 RangeMarkPrivate::RangeMarkPrivate(TextDocument *editor, int start, int end)
     : m_editor(editor)
-    , m_start(start)
-    , m_end(end)
+    , m_start {.value = start}
+    , m_end {.value = end}
 {
     ensureInvariant();
 
     Q_ASSERT(editor);
     Q_ASSERT(isValid());
 
-    auto document = editor->textEdit()->document();
-    connect(document, &QTextDocument::contentsChange, this, &RangeMarkPrivate::update);
+    editor->m_markTracker->add(&m_start);
+    editor->m_markTracker->add(&m_end);
+}
+
+RangeMarkPrivate::~RangeMarkPrivate()
+{
+    if (m_editor) {
+        m_editor->m_markTracker->remove(&m_end);
+        m_editor->m_markTracker->remove(&m_start);
+    }
 }
 
 bool RangeMarkPrivate::checkEditor() const
@@ -75,22 +81,16 @@ bool RangeMarkPrivate::checkEditor() const
 
 void RangeMarkPrivate::ensureInvariant()
 {
-    if (m_start > m_end) {
-        spdlog::warn("RangeMark::ensureInvariant: invariant violated: m_start > m_end ({} > {})", m_start, m_end);
-        std::swap(m_start, m_end);
+    if (m_start.value > m_end.value) {
+        spdlog::warn("RangeMark::ensureInvariant: invariant violated: m_start > m_end ({} > {})", m_start.value,
+                     m_end.value);
+        std::swap(m_start.value, m_end.value);
     }
 }
 
-void RangeMarkPrivate::update(int from, int charsRemoved, int charsAdded)
-{
-    Mark::updateMark(m_start, from, charsRemoved, charsAdded);
-    Mark::updateMark(m_end, from, charsRemoved, charsAdded);
-    ensureInvariant();
-}
-
 bool RangeMarkPrivate::isValid() const
 {
-    return checkEditor() && m_start >= 0 && m_end >= 0;
+    return checkEditor() && m_start.value >= 0 && m_end.value >= 0;
 }
 
 RangeMark::RangeMark(TextDocument *editor, int start, int end)
@@ -105,12 +105,12 @@ bool RangeMark::isValid() const
 
 int RangeMark::start() const
 {
-    return d ? d->m_start : -1;
+    return d ? d->m_start.value : -1;
 }
 
 int RangeMark::end() const
 {
-    return d ? d->m_end : -1;
+    return d ? d->m_end.value : -1;
 }
 
 int RangeMark::length() const
@@ -141,8 +141,11 @@ TextRange RangeMark::toTextRange() const
 QString RangeMark::text() const
 {
     // <= here instead of < because m_end is exclusive
-    if (isValid() && end() <= document()->text().size())
-        return document()->text().sliced(start(), end() - start());
+    if (!isValid())
+        return {};
+    const auto text = document()->text();
+    if (end() <= text.size())
+        return text.sliced(start(), end() - start());
     return {};
 }
 
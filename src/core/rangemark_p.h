@@ -10,20 +10,23 @@
 
 #pragma once
 
-#include <QObject>
+#include "mark_p.h"
+
 #include <QPointer>
 
 namespace Core {
 
 class TextDocument;
 
-class RangeMarkPrivate : public QObject
+class RangeMarkPrivate
 {
-    Q_OBJECT
-
 public:
     // Unfortunately this needs to be public, as otherwise std::make_shared can't access it
     explicit RangeMarkPrivate(TextDocument *editor, int start, int end);
+    ~RangeMarkPrivate();
+
+    RangeMarkPrivate(const RangeMarkPrivate &) = delete;
+    RangeMarkPrivate &operator=(const RangeMarkPrivate &) = delete;
 
 private:
     void ensureInvariant();
@@ -31,18 +34,17 @@ private:
     bool isValid() const;
     bool checkEditor() const;
 
-    void update(int from, int charsRemoved, int charsAdded);
-
     QPointer<TextDocument> m_editor;
 
     // We need to uphold the invariant
     // that m_start <= m_end
     //
     // Encoding with m_start + m_length would remove this requirement,
-    // however, it would make update() more complicated.
-    int m_start;
+    // however, it would make the updates more complicated.
+    // Updating positions never reorders them, so the invariant holds after each change in the document.
+    TrackedPosition m_start;
     // Note: m_end is exclusive
-    int m_end;
+    TrackedPosition m_end;
 
     friend class RangeMark;
     friend class AstNode;
@@ -10,14 +10,21 @@
 
 #include "rcdocument.h"
 #include "logger.h"
+#include "qtuidocument.h"
 #include "rccore/rcfile.h"
 #include "utils/log.h"
+#include "version.h"
 
 #include <QBuffer>
+#include <QDir>
 #include <QFile>
+#include <QFileInfo>
 #include <QUiLoader>
 #include <QWidget>
+#include <QtConcurrent/QtConcurrentMap>
 #include <kdalgorithms.h>
+#include <memory>
+#include <pugixml.hpp>
 
 namespace Core {
 
@@ -89,6 +96,42 @@ RcDocument::RcDocument(QObject *parent)
 {
 }
 
+// Types of the resources in the lazy loading index
+static const QStringList DialogTypes = {"DIALOG", "DIALOGEX"};
+static const QStringList MenuTypes = {"MENU", "MENUEX"};
+static const QStringList AssetTypes = {"BITMAP", "CURSOR", "ICON", "IMAGE", "PNG"};
+
+// Fingerprints of the outputs, see the RcIncrementalConversion setting
+static constexpr char ManifestFileName[] = ".knut-manifest.json";
+
+static std::unique_ptr<RcCore::OutputManifest> loadManifest(const QString &path)
+{
+    if (!Settings::instance()->value<bool>(Settings::RcIncrementalConversion))
+        return {};
+    // Outputs written by another version of Knut may be different
+    return std::make_unique<RcCore::OutputManifest>(path + '/' + ManifestFileName, core::knut_version());
+}
+
+template <typename T>
+static QHash<QString, qsizetype> buildIndex(const QVector<T> &collection)
+{
+    QHash<QString, qsizetype> index;
+    index.reserve(collection.size());
+    // Iterate backward, so the first item wins if an id is duplicated, as with a linear search
+    for (auto i = collection.size() - 1; i >= 0; --i)
+        index.insert(collection.at(i).id, i);
+    return index;
+}
+
+template <typename T>
+static const T *findByIndex(const QVector<T> &collection, const QHash<QString, qsizetype> &index, const QString &id)
+{
+    const auto it = index.constFind(id);
+    if (it == index.cend())
+        return nullptr;
+    return &collection.at(it.value());
+}
+
 bool RcDocument::isValid() const
 {
     return m_rcFile.isValid;
@@ -124,12 +167,10 @@ RcCore::Action RcDocument::action(const QString &id) const
 
     // Make sure the action vector is populated by calling actions
     if (isDataValid() && !actions().isEmpty()) {
-        auto result = kdalgorithms::find_if(m_cacheActions, [id](const auto &data) {
-            return data.id == id;
-        });
-        if (!result)
-            return {};
-        return *result;
+        if (m_actionIndex.isEmpty())
+            m_actionIndex = buildIndex(m_cacheActions);
+        if (auto result = findByIndex(m_cacheActions, m_actionIndex, id))
+            return *result;
     }
     return {};
 }
@@ -146,7 +187,7 @@ RcCore::ActionList RcDocument::actionsFromMenu(const QString &menuId) const
         return {};
 
     RcCore::ActionList actions;
-    if (auto menu = data().menu(menuId)) {
+    if (auto menu = findMenu(menuId)) {
         const auto actionIds = menu->actionIds();
         for (const auto &id : actionIds)
             actions.push_back(action(id));
@@ -166,7 +207,7 @@ RcCore::ActionList RcDocument::actionsFromToolbar(const QString &toolBarId) cons
         return {};
 
     RcCore::ActionList actions;
-    if (auto toolbar = data().toolBar(toolBarId)) {
+    if (auto toolbar = findToolBar(toolBarId)) {
         const auto actionIds = toolbar->actionIds();
         for (const auto &id : actionIds)
             actions.push_back(action(id));
@@ -190,7 +231,7 @@ RcCore::ToolBar RcDocument::toolBar(const QString &id) const
     LOG("RcDocument::toolBar", id);
 
     if (isDataValid()) {
-        if (auto tb = data().toolBar(id))
+        if (auto tb = findToolBar(id))
             return *tb;
     }
     return {};
@@ -219,9 +260,18 @@ RcCore::Widget RcDocument::dialog(const QString &id, int flags, double scaleX, d
     SET_DEFAULT_VALUE(RcDialogScaleX, scaleX);
     SET_DEFAULT_VALUE(RcDialogScaleY, scaleY);
     if (isDataValid()) {
-        if (auto dialog = data().dialog(id))
-            return RcCore::convertDialog(data(), *dialog, static_cast<RcCore::Widget::ConversionFlags>(flags), scaleX,
-                                         scaleY);
+        if (!isLanguageParsed(m_language)) {
+            // Only parse the dialog, its initialization data and the assets used by its controls
+            const auto dialogData = parseLanguage(m_language, [&id](const RcCore::RcFile::Resource &resource) {
+                return ((DialogTypes.contains(resource.type) || resource.type == "DLGINIT") && resource.id == id)
+                    || AssetTypes.contains(resource.type);
+            });
+            if (auto dialog = dialogData.dialog(id))
+                return convertDialog(dialogData, *dialog, flags, scaleX, scaleY);
+            return {};
+        }
+        if (auto dialog = findDialog(id))
+            return convertDialog(data(), *dialog, flags, scaleX, scaleY);
     }
     return {};
 }
@@ -235,7 +285,15 @@ RcCore::Menu RcDocument::menu(const QString &id) const
     LOG("RcDocument::menu", id);
 
     if (isDataValid()) {
-        if (auto menu = data().menu(id))
+        if (!isLanguageParsed(m_language)) {
+            const auto menuData = parseLanguage(m_language, [&id](const RcCore::RcFile::Resource &resource) {
+                return MenuTypes.contains(resource.type) && resource.id == id;
+            });
+            if (auto menu = menuData.menu(id))
+                return *menu;
+            return {};
+        }
+        if (auto menu = findMenu(id))
             return *menu;
     }
     return {};
@@ -262,6 +320,8 @@ QStringList RcDocument::dialogIds() const
 {
     LOG("RcDocument::dialogIds");
     if (isDataValid()) {
+        if (!isLanguageParsed(m_language))
+            return resourceIds(DialogTypes);
         const auto &dialogs = data().dialogs;
         QStringList result;
         result.reserve(dialogs.size());
@@ -278,6 +338,8 @@ QStringList RcDocument::menuIds() const
 {
     LOG("RcDocument::menuIds");
     if (isDataValid()) {
+        if (!isLanguageParsed(m_language))
+            return resourceIds(MenuTypes);
         const auto &menus = data().menus;
         QStringList result;
         result.reserve(menus.size());
@@ -294,6 +356,8 @@ QStringList RcDocument::acceleratorIds() const
 {
     LOG("RcDocument::acceleratorIds");
     if (isDataValid()) {
+        if (!isLanguageParsed(m_language))
+            return resourceIds({"ACCELERATORS"});
         const auto &accelerators = data().acceleratorTables;
         QStringList result;
         result.reserve(accelerators.size());
@@ -310,6 +374,8 @@ QStringList RcDocument::toolbarIds() const
 {
     LOG("RcDocument::toolbarIds");
     if (isDataValid()) {
+        if (!isLanguageParsed(m_language))
+            return resourceIds({"TOOLBAR"});
         const auto &toolbars = data().toolBars;
         QStringList result;
         result.reserve(toolbars.size());
@@ -326,7 +392,7 @@ QStringList RcDocument::stringIds() const
 {
     LOG("RcDocument::stringIds");
     if (isDataValid())
-        return data().strings.keys();
+        return stringTable(m_language)->keys();
     return {};
 }
 
@@ -334,6 +400,8 @@ QStringList RcDocument::ribbonIds() const
 {
     LOG("RcDocument::ribbonIds");
     if (isDataValid()) {
+        if (!isLanguageParsed(m_language))
+            return resourceIds({"RT_RIBBON_XML"});
         const auto &ribbons = data().ribbons;
         QStringList result;
         result.reserve(ribbons.size());
@@ -353,10 +421,8 @@ QStringList RcDocument::ribbonIds() const
 QList<RcCore::String> RcDocument::stringsForLanguage(const QString &language) const
 {
     LOG("RcDocument::stringsForLanguage", language);
-    if (m_rcFile.isValid && m_rcFile.data.contains(language)) {
-        const RcCore::Data data = const_cast<RcCore::RcFile *>(&m_rcFile)->data[language];
-        const auto &strings = data.strings;
-        return strings.values();
+    if (const auto strings = stringTable(language)) {
+        return strings->values();
     } else {
         return {};
     }
@@ -370,10 +436,8 @@ QString RcDocument::stringForLanguage(const QString &language, const QString &id
 {
     LOG("RcDocument::stringForLanguage", language, id);
 
-    if (m_rcFile.isValid && m_rcFile.data.contains(language)) {
-        const RcCore::Data data = const_cast<RcCore::RcFile *>(&m_rcFile)->data[language];
-        const auto &strings = data.strings;
-        return strings.value(id).text;
+    if (const auto strings = stringTable(language)) {
+        return strings->value(id).text;
     } else {
         spdlog::warn("RcDocument::stringForLanguage: language {} does not exist in the rc file.", language);
         return {};
@@ -382,10 +446,8 @@ QString RcDocument::stringForLanguage(const QString &language, const QString &id
 
 QList<RcCore::String> RcDocument::strings() const
 {
-    if (isDataValid()) {
-        const auto &strings = data().strings;
-        return strings.values();
-    }
+    if (isDataValid())
+        return stringTable(m_language)->values();
     return {};
 }
 
@@ -398,13 +460,13 @@ QString RcDocument::string(const QString &id) const
     LOG("RcDocument::string", id);
 
     if (isDataValid())
-        return data().strings.value(id).text;
+        return stringTable(m_language)->value(id).text;
     return {};
 }
 
 std::optional<RcCore::Data::Control> findControlWithId(const RcCore::Data::Dialog *dialog, const QString &id)
 {
-    const auto controls = dialog->controls;
+    const auto &controls = dialog->controls;
     auto isSameId = [id](const auto &control) {
         return control.id == id;
     };
@@ -439,9 +501,14 @@ QString RcDocument::stringForDialogAndLanguage(const QString &language, const QS
 {
     LOG("RcDocument::stringForDialogAndLanguage", language, dialogId, id);
 
-    if (m_rcFile.isValid && m_rcFile.data.contains(language)) {
-        const RcCore::Data data = const_cast<RcCore::RcFile *>(&m_rcFile)->data[language];
-        const auto dialog = data.dialog(dialogId);
+    if (m_rcFile.isValid && !isLanguageParsed(language) && m_rcFile.data.contains(language)) {
+        const auto dialogData = parseLanguage(language, [&dialogId](const RcCore::RcFile::Resource &resource) {
+            return DialogTypes.contains(resource.type) && resource.id == dialogId;
+        });
+        return extractStringForDialog(dialogData.dialog(dialogId), id);
+    }
+    if (const auto data = dataForLanguage(language)) {
+        const auto dialog = data->dialog(dialogId);
         return extractStringForDialog(dialog, id);
     } else {
         spdlog::warn("RcDocument::stringForDialogAndLanguage: language {} does not exist in the rc file.", language);
@@ -457,7 +524,13 @@ QString RcDocument::stringForDialog(const QString &dialogId, const QString &id)
 {
     LOG("RcDocument::stringForDialog", dialogId, id);
     if (isDataValid()) {
-        const auto dialog = data().dialog(dialogId);
+        if (!isLanguageParsed(m_language)) {
+            const auto dialogData = parseLanguage(m_language, [&dialogId](const RcCore::RcFile::Resource &resource) {
+                return DialogTypes.contains(resource.type) && resource.id == dialogId;
+            });
+            return extractStringForDialog(dialogData.dialog(dialogId), id);
+        }
+        const auto dialog = findDialog(dialogId);
         return extractStringForDialog(dialog, id);
     }
     return {};
@@ -465,8 +538,153 @@ QString RcDocument::stringForDialog(const QString &dialogId, const QString &id)
 
 const RcCore::Data &RcDocument::data() const
 {
-    Q_ASSERT(m_rcFile.data.contains(m_language));
-    return const_cast<RcCore::RcFile *>(&m_rcFile)->data[m_language];
+    const auto data = dataForLanguage(m_language);
+    Q_ASSERT(data);
+    return *data;
+}
+
+// Returns the data for the given language, without copying it, or nullptr if the language doesn't exist.
+// With the lazy loading, the resources of the language are parsed on the first call.
+const RcCore::Data *RcDocument::dataForLanguage(const QString &language) const
+{
+    if (!m_rcFile.isValid)
+        return nullptr;
+    const auto it = m_rcFile.data.find(language);
+    if (it == m_rcFile.data.end())
+        return nullptr;
+    if (!isLanguageParsed(language)) {
+        it.value() = parseLanguage(language, [](const RcCore::RcFile::Resource &) {
+            return true;
+        });
+        m_parsedLanguages.insert(language);
+        m_lazyStrings.remove(language);
+    }
+    return &it.value();
+}
+
+bool RcDocument::isLanguageParsed(const QString &language) const
+{
+    return !m_lazy || m_parsedLanguages.contains(language);
+}
+
+// Parses the resources of `language` accepted by `filter`, from the index built by RcCore::parseIndex
+RcCore::Data RcDocument::parseLanguage(const QString &language,
+                                       const std::function<bool(const RcCore::RcFile::Resource &)> &filter) const
+{
+    const auto data = RcCore::parseResources(m_rcFile, [&](const RcCore::RcFile::Resource &resource) {
+        return resource.language == language && filter(resource);
+    });
+    auto result = data.value(language);
+    result.fileName = m_rcFile.fileName;
+    result.language = language;
+    return result;
+}
+
+// Ids of the resources of the current language from the index, sorted
+QStringList RcDocument::resourceIds(const QStringList &types) const
+{
+    QStringList result;
+    for (const auto &resource : std::as_const(m_rcFile.resources)) {
+        if (resource.language == m_language && types.contains(resource.type))
+            result.push_back(resource.id);
+    }
+    result.sort();
+    return result;
+}
+
+// Returns the strings of the language, or nullptr if the language doesn't exist. With the lazy loading, only the
+// string tables are parsed if the language is not parsed yet.
+const QHash<QString, RcCore::String> *RcDocument::stringTable(const QString &language) const
+{
+    if (!m_rcFile.isValid || !m_rcFile.data.contains(language))
+        return nullptr;
+    if (isLanguageParsed(language))
+        return &dataForLanguage(language)->strings;
+
+    auto it = m_lazyStrings.find(language);
+    if (it == m_lazyStrings.end()) {
+        const auto data = parseLanguage(language, [](const RcCore::RcFile::Resource &resource) {
+            return resource.type == "STRINGTABLE";
+        });
+        it = m_lazyStrings.insert(language, data.strings);
+    }
+    return &it.value();
+}
+
+void RcDocument::parseAllLanguages() const
+{
+    const auto languages = m_rcFile.data.keys();
+    for (const auto &language : languages)
+        dataForLanguage(language);
+}
+
+// After a merge, the data of a language may come from both parsed and not parsed languages: all of them are parsed
+// again when needed, the index knows the new languages
+void RcDocument::resetLazyData()
+{
+    if (!m_lazy)
+        return;
+    for (auto &data : m_rcFile.data) {
+        auto language = data.language;
+        data = {};
+        data.fileName = m_rcFile.fileName;
+        data.language = std::move(language);
+    }
+    m_parsedLanguages.clear();
+    m_lazyStrings.clear();
+    m_dataIndexes.clear();
+}
+
+const RcDocument::DataIndex &RcDocument::dataIndex() const
+{
+    auto it = m_dataIndexes.find(m_language);
+    if (it == m_dataIndexes.end()) {
+        const auto &currentData = data();
+        it = m_dataIndexes.insert(m_language, {.dialogs = buildIndex(currentData.dialogs),
+                                               .menus = buildIndex(currentData.menus),
+                                               .toolBars = buildIndex(currentData.toolBars)});
+    }
+    return it.value();
+}
+
+// Converts the dialog, or returns the result of a previous conversion with the same parameters. Thread-safe, as
+// dialogs are converted in parallel.
+RcCore::Widget RcDocument::convertDialog(const RcCore::Data &data, const RcCore::Data::Dialog &dialog, int flags,
+                                         double scaleX, double scaleY) const
+{
+    const DialogKey key {m_language, dialog.id, flags, scaleX, scaleY};
+    {
+        QMutexLocker locker(&m_conversionMutex);
+        if (const auto it = m_dialogCache.constFind(key); it != m_dialogCache.cend())
+            return it.value();
+    }
+    auto widget =
+        RcCore::convertDialog(data, dialog, static_cast<RcCore::Widget::ConversionFlags>(flags), scaleX, scaleY);
+    QMutexLocker locker(&m_conversionMutex);
+    m_dialogCache.insert(key, widget);
+    return widget;
+}
+
+void RcDocument::clearConversionCache()
+{
+    QMutexLocker locker(&m_conversionMutex);
+    m_dialogCache.clear();
+    m_actionCache.clear();
+}
+
+const RcCore::Data::Dialog *RcDocument::findDialog(const QString &id) const
+{
+    return findByIndex(data().dialogs, dataIndex().dialogs, id);
+}
+
+const RcCore::Menu *RcDocument::findMenu(const QString &id) const
+{
+    return findByIndex(data().menus, dataIndex().menus, id);
+}
+
+const RcCore::ToolBar *RcDocument::findToolBar(const QString &id) const
+{
+    return findByIndex(data().toolBars, dataIndex().toolBars, id);
 }
 
 QString RcDocument::language() const
@@ -490,6 +708,7 @@ void RcDocument::setLanguage(const QString &language)
     m_language = language;
     m_cacheAssets.clear();
     m_cacheActions.clear();
+    m_actionIndex.clear();
     emit languageChanged();
     emit dataChanged();
 }
@@ -508,6 +727,7 @@ QStringList RcDocument::languages() const
 
 const RcCore::RcFile &RcDocument::file() const
 {
+    parseAllLanguages();
     return m_rcFile;
 }
 
@@ -559,7 +779,14 @@ void RcDocument::convertActions(int flags)
 
     SET_DEFAULT_VALUE(RcAssetFlags, static_cast<ConversionFlags>(flags));
     if (isDataValid()) {
-        m_cacheActions = RcCore::convertActions(data(), static_cast<RcCore::Asset::ConversionFlags>(flags));
+        const std::pair key(m_language, flags);
+        auto it = m_actionCache.find(key);
+        if (it == m_actionCache.end()) {
+            const auto actionFlags = static_cast<RcCore::Asset::ConversionFlags>(flags);
+            it = m_actionCache.insert(key, RcCore::convertActions(data(), actionFlags));
+        }
+        m_cacheActions = it.value();
+        m_actionIndex.clear();
         emit fileNameChanged();
     }
 }
@@ -586,27 +813,30 @@ bool RcDocument::writeAssetsToImage(int flags)
     SET_DEFAULT_VALUE(RcAssetColors, static_cast<ConversionFlags>(flags));
     if (m_cacheAssets.isEmpty())
         convertAssets();
-    RcCore::writeAssetsToImage(m_cacheAssets, static_cast<RcCore::Asset::TransparentColors>(flags));
-    return true;
+    const auto manifest = loadManifest(QFileInfo(fileName()).absolutePath());
+    RcCore::writeAssetsToImage(m_cacheAssets, static_cast<RcCore::Asset::TransparentColors>(flags), manifest.get());
+    return !manifest || manifest->save();
 }
 
 /*!
- * \qmlmethod bool RcDocument::writeAssetsToQrc(string fileName)
+ * \qmlmethod bool RcDocument::writeAssetsToQrc(string fileName, bool shareDuplicates = false)
  * \sa RcDocument::convertAssets
  * Writes a qrc file with the given `fileName`. Returns `true` if no issues.
  *
  * Before writing the qrc file, you first need to convert them using RcDocument::convertAssets.
+ *
+ * If `shareDuplicates` is true, the assets with the same content all use the same file, under their own alias.
  */
-bool RcDocument::writeAssetsToQrc(const QString &fileName)
+bool RcDocument::writeAssetsToQrc(const QString &fileName, bool shareDuplicates)
 {
-    LOG("RcDocument::writeAssetsToQrc", fileName);
+    LOG("RcDocument::writeAssetsToQrc", fileName, shareDuplicates);
 
     if (m_cacheAssets.isEmpty())
         convertAssets();
 
     QFile file(fileName);
     if (file.open(QIODevice::WriteOnly)) {
-        RcCore::writeAssetsToQrc(m_cacheAssets, &file, fileName);
+        RcCore::writeAssetsToQrc(m_cacheAssets, &file, fileName, shareDuplicates);
         return true;
     }
     return false;
@@ -629,6 +859,210 @@ bool RcDocument::writeDialogToUi(const RcCore::Widget &dialog, const QString &fi
     return false;
 }
 
+/*!
+ * \qmlmethod bool RcDocument::writeDialogToSlint(Widget dialog, string fileName)
+ * \sa RcDocument::dialog
+ * Writes a slint file for the given `dialog`, to the given `fileName`. Return `true` if no issues.
+ */
+bool RcDocument::writeDialogToSlint(const RcCore::Widget &dialog, const QString &fileName)
+{
+    LOG("RcDocument::writeDialogToSlint", dialog.id, fileName);
+
+    QFile file(fileName);
+    if (file.open(QIODevice::WriteOnly)) {
+        RcCore::writeDialogToSlint(dialog, &file);
+        return true;
+    }
+    return false;
+}
+
+/*!
+ * \qmlmethod QtUiDocument RcDocument::dialogToUiDocument(Widget dialog)
+ * \sa RcDocument::dialog
+ * \sa RcDocument::writeDialogToUi
+ * Returns a new ui document for the given `dialog`, without writing it to disk.
+ *
+ * The document is created in memory, use `saveAs` to write it:
+ *
+ * ```js
+ * let ui = document.dialogToUiDocument(document.dialog("IDD_ABOUTBOX"));
+ * Message.log(ui.findWidget("IDOK").getProperty("text"));
+ * ui.saveAs(Project.root + "/aboutbox.ui");
+ * ```
+ */
+QtUiDocument *RcDocument::dialogToUiDocument(const RcCore::Widget &dialog)
+{
+    LOG("RcDocument::dialogToUiDocument", dialog.id);
+
+    pugi::xml_document xmlDocument;
+    RcCore::writeDialogToUi(dialog, xmlDocument);
+
+    // No parent, the document is owned by the caller (the JavaScript engine for scripts)
+    auto document = new QtUiDocument();
+    document->setXmlDocument(std::move(xmlDocument));
+    return document;
+}
+
+/*!
+ * \qmlmethod bool RcDocument::convertAllDialogs(string path, int flags, real scaleX, real scaleY)
+ * \sa RcDocument::dialog
+ * \sa RcDocument::writeDialogToUi
+ * Converts all the dialogs and writes them as ui files in the directory `path`. Returns `true` if no issues.
+ *
+ * The dialogs are converted and written in parallel, each one in a file named after its id. The `flags` and scale
+ * factors `scaleX` and `scaleY` are the same as in RcDocument::dialog.
+ *
+ * With the `rc.incremental_conversion` setting, the dialogs unchanged since the previous conversion in `path` are not
+ * written again.
+ */
+bool RcDocument::convertAllDialogs(const QString &path, int flags, double scaleX, double scaleY)
+{
+    LOG("RcDocument::convertAllDialogs", path, flags, scaleX, scaleY);
+
+    if (!QDir(path).exists()) {
+        spdlog::error("RcDocument::convertAllDialogs: directory {} does not exist.", path);
+        return false;
+    }
+    const auto failures = writeDialogsToUi(dialogIds(), path, static_cast<ConversionFlags>(flags), scaleX, scaleY);
+    for (const auto &fileName : failures)
+        spdlog::error("RcDocument::convertAllDialogs: unable to write ui file {}.", fileName);
+    return failures.isEmpty();
+}
+
+/*!
+ * \qmlmethod bool RcDocument::convertAllDialogsToSlint(string path, int flags, real scaleX, real scaleY)
+ * \sa RcDocument::dialog
+ * \sa RcDocument::convertAllDialogs
+ * Converts all the dialogs and writes them as slint files in the directory `path`. Returns `true` if no issues.
+ *
+ * Each dialog is written as a component inheriting `Window`, using the Slint standard widgets when there's an
+ * equivalent. The dialogs are converted and written in parallel, like in RcDocument::convertAllDialogs.
+ */
+bool RcDocument::convertAllDialogsToSlint(const QString &path, int flags, double scaleX, double scaleY)
+{
+    LOG("RcDocument::convertAllDialogsToSlint", path, flags, scaleX, scaleY);
+
+    if (!QDir(path).exists()) {
+        spdlog::error("RcDocument::convertAllDialogsToSlint: directory {} does not exist.", path);
+        return false;
+    }
+    const auto failures = writeDialogsToSlint(dialogIds(), path, static_cast<ConversionFlags>(flags), scaleX, scaleY);
+    for (const auto &fileName : failures)
+        spdlog::error("RcDocument::convertAllDialogsToSlint: unable to write slint file {}.", fileName);
+    return failures.isEmpty();
+}
+
+// Converts the dialogs `ids` and writes them in the directory `path`, in parallel on the global thread pool.
+// Returns the list of files that couldn't be written.
+QStringList RcDocument::writeDialogsToUi(const QStringList &ids, const QString &path, ConversionFlags flags,
+                                         double scaleX, double scaleY) const
+{
+    return writeDialogs(ids, path, flags, scaleX, scaleY, ".ui",
+                        static_cast<void (*)(const RcCore::Widget &, QIODevice *)>(&RcCore::writeDialogToUi));
+}
+
+QStringList RcDocument::writeDialogsToSlint(const QStringList &ids, const QString &path, ConversionFlags flags,
+                                            double scaleX, double scaleY) const
+{
+    return writeDialogs(ids, path, flags, scaleX, scaleY, ".slint", &RcCore::writeDialogToSlint);
+}
+
+QStringList RcDocument::writeDialogs(const QStringList &ids, const QString &path, ConversionFlags flags, double scaleX,
+                                     double scaleY, const QString &extension,
+                                     void (*writeDialog)(const RcCore::Widget &, QIODevice *)) const
+{
+    SET_DEFAULT_VALUE(RcDialogFlags, flags);
+    SET_DEFAULT_VALUE(RcDialogScaleX, scaleX);
+    SET_DEFAULT_VALUE(RcDialogScaleY, scaleY);
+    if (!isDataValid())
+        return {};
+
+    // The data is only read here, and each dialog is converted and serialized independently
+    const auto &currentData = data();
+    QList<const RcCore::Data::Dialog *> dialogs;
+    dialogs.reserve(ids.size());
+    for (const auto &id : ids) {
+        if (auto dialog = findDialog(id))
+            dialogs.push_back(dialog);
+    }
+
+    // Dialogs whose fingerprint didn't change since the previous run are not converted again
+    const auto manifest = loadManifest(path);
+    const auto widgetFlags = static_cast<RcCore::Widget::ConversionFlags>(flags.toInt());
+
+    auto convertAndWrite = [&](const RcCore::Data::Dialog *dialog) -> QString {
+        const QString fileName = path + '/' + dialog->id + extension;
+        QByteArray fingerprint;
+        if (manifest) {
+            fingerprint = RcCore::dialogFingerprint(currentData, *dialog, widgetFlags, scaleX, scaleY, extension);
+            if (manifest->isUpToDate(fileName, fingerprint))
+                return {};
+        }
+
+        const auto widget = convertDialog(currentData, *dialog, flags.toInt(), scaleX, scaleY);
+        QFile file(fileName);
+        if (!file.open(QIODevice::WriteOnly))
+            return fileName;
+        writeDialog(widget, &file);
+        file.close();
+        if (manifest)
+            manifest->update(fileName, fingerprint);
+        return {};
+    };
+    auto results = QtConcurrent::blockingMapped<QStringList>(dialogs, convertAndWrite);
+    results.removeAll(QString());
+    if (manifest)
+        manifest->save();
+    return results;
+}
+
+/*!
+ * \qmlmethod bool RcDocument::writeLanguagesToTs(string path, string sourceLanguage = "")
+ * \sa RcDocument::convertLanguageToCode
+ * Writes a Qt translation file for each language of the rc file in the directory `path`. Returns `true` if no issues.
+ *
+ * The source texts of the strings, menus and dialogs are taken from `sourceLanguage`, or the current language if
+ * empty. Each file is named after the rc file and the language code, like `2048Game_fr_FR.ts`, and they are written
+ * in parallel.
+ */
+bool RcDocument::writeLanguagesToTs(const QString &path, const QString &sourceLanguage)
+{
+    LOG("RcDocument::writeLanguagesToTs", path, sourceLanguage);
+
+    if (!QDir(path).exists()) {
+        spdlog::error("RcDocument::writeLanguagesToTs: directory {} does not exist.", path);
+        return false;
+    }
+    const auto source = dataForLanguage(sourceLanguage.isEmpty() ? m_language : sourceLanguage);
+    if (!source) {
+        spdlog::error("RcDocument::writeLanguagesToTs: language {} does not exist in the rc file.", sourceLanguage);
+        return false;
+    }
+
+    // The data is only read here, each language is then serialized independently
+    parseAllLanguages();
+    const auto baseName = QFileInfo(fileName()).completeBaseName();
+    const auto location = QDir(path).relativeFilePath(fileName());
+    QList<const RcCore::Data *> translations;
+    for (const auto &data : std::as_const(m_rcFile.data))
+        translations.push_back(&data);
+
+    auto writeLanguage = [&](const RcCore::Data *translation) -> QString {
+        const auto code = RcCore::convertLanguageToCode(translation->language);
+        const QString tsFileName = QString("%1/%2_%3.ts").arg(path, baseName, code);
+        QFile file(tsFileName);
+        if (!file.open(QIODevice::WriteOnly))
+            return tsFileName;
+        RcCore::writeDataToTs(*source, *translation, &file, location);
+        return {};
+    };
+    auto failures = QtConcurrent::blockingMapped<QStringList>(translations, writeLanguage);
+    failures.removeAll(QString());
+    for (const auto &tsFileName : std::as_const(failures))
+        spdlog::error("RcDocument::writeLanguagesToTs: unable to write ts file {}.", tsFileName);
+    return failures.isEmpty();
+}
+
 /*!
  * \qmlmethod bool RcDocument::previewDialog(Widget dialog )
  * \sa RcDocument::dialog
@@ -662,6 +1096,9 @@ void RcDocument::mergeAllLanguages(const QString &language)
     LOG("RcDocument::mergeAllLanguages", language);
 
     m_rcFile.mergeLanguages(m_rcFile.data.keys(), language);
+    m_dataIndexes.clear();
+    resetLazyData();
+    clearConversionCache();
     {
         // Even if the newLanguage is set, we want to send the signals unconditionally
         QSignalBlocker sb(this);
@@ -703,6 +1140,9 @@ void RcDocument::mergeLanguages()
     // Do all the merges
     for (const auto &[lang, values] : merges)
         m_rcFile.mergeLanguages(values, lang);
+    m_dataIndexes.clear();
+    resetLazyData();
+    clearConversionCache();
 
     {
         // Even if the newLanguage is set, we want to send the signals unconditionally
@@ -734,9 +1174,43 @@ bool RcDocument::doSave(const QString &fileName)
     return true;
 }
 
+// Shallow estimate of the memory used by the RC data: the text and the resources, without the strings they own
+static qint64 rcFileBytes(const RcCore::RcFile &rcFile)
+{
+    qint64 bytes = rcFile.content.size() * sizeof(QChar);
+    for (const auto &data : rcFile.data) {
+        bytes += (data.icons.size() + data.assets.size()) * sizeof(RcCore::Asset);
+        bytes += data.strings.size() * (sizeof(QString) + sizeof(RcCore::String));
+        bytes += data.acceleratorTables.size() * sizeof(RcCore::Data::AcceleratorTable);
+        bytes += data.menus.size() * sizeof(RcCore::Menu);
+        bytes += data.toolBars.size() * sizeof(RcCore::ToolBar);
+        bytes += data.dialogDataList.size() * sizeof(RcCore::Data::DialogData);
+        bytes += data.ribbons.size() * sizeof(RcCore::Ribbon);
+        for (const auto &dialog : data.dialogs)
+            bytes += sizeof(RcCore::Data::Dialog) + dialog.controls.size() * sizeof(RcCore::Data::Control);
+    }
+    return bytes;
+}
+
+QVariantMap RcDocument::memoryUsage() const
+{
+    return {{"rc", rcFileBytes(m_rcFile)}};
+}
+
 bool RcDocument::doLoad(const QString &fileName)
 {
-    m_rcFile = RcCore::parse(fileName);
+    m_lazy = Settings::instance()->value<bool>(Settings::RcLazyLoading);
+    if (m_lazy) {
+        // Only the position of the resources is read, they are parsed when needed
+        m_rcFile = RcCore::parseIndex(fileName);
+    } else {
+        // Reuse the language sections that didn't change since the last load
+        m_rcFile = RcCore::parse(fileName, m_rcFile);
+    }
+    m_parsedLanguages.clear();
+    m_lazyStrings.clear();
+    m_dataIndexes.clear();
+    clearConversionCache();
 
     // There should always be one language in a RC file. If not, bail out.
     if (m_rcFile.data.isEmpty())
@@ -14,8 +14,13 @@
 #include "rccore/rcfile.h"
 #include "settings.h"
 
+#include <QMutex>
+#include <QSet>
+
 namespace Core {
 
+class QtUiDocument;
+
 class RcDocument : public Document
 {
     Q_OBJECT
@@ -62,6 +67,8 @@ public:
 
     bool isValid() const;
 
+    QVariantMap memoryUsage() const override;
+
     QVector<RcCore::Asset> assets() const;
     QVector<RcCore::Action> actions() const;
     Q_INVOKABLE RcCore::Action action(const QString &id) const;
@@ -103,12 +110,26 @@ public:
 
     const RcCore::RcFile &file() const;
 
+    QStringList writeDialogsToUi(const QStringList &ids, const QString &path, ConversionFlags flags, double scaleX,
+                                 double scaleY) const;
+    QStringList writeDialogsToSlint(const QStringList &ids, const QString &path, ConversionFlags flags, double scaleX,
+                                    double scaleY) const;
+
 public slots:
     void convertAssets(int flags = DEFAULT_VALUE(ConversionFlag, RcAssetFlags));
     void convertActions(int flags = DEFAULT_VALUE(ConversionFlags, RcAssetFlags));
     bool writeAssetsToImage(int flags = DEFAULT_VALUE(ConversionFlags, RcAssetColors));
-    bool writeAssetsToQrc(const QString &fileName);
+    bool writeAssetsToQrc(const QString &fileName, bool shareDuplicates = false);
     bool writeDialogToUi(const RcCore::Widget &dialog, const QString &fileName);
+    bool writeDialogToSlint(const RcCore::Widget &dialog, const QString &fileName);
+    Core::QtUiDocument *dialogToUiDocument(const RcCore::Widget &dialog);
+    bool convertAllDialogs(const QString &path, int flags = DEFAULT_VALUE(ConversionFlags, RcDialogFlags),
+                           double scaleX = DEFAULT_VALUE(double, RcDialogScaleX),
+                           double scaleY = DEFAULT_VALUE(double, RcDialogScaleY));
+    bool convertAllDialogsToSlint(const QString &path, int flags = DEFAULT_VALUE(ConversionFlags, RcDialogFlags),
+                                  double scaleX = DEFAULT_VALUE(double, RcDialogScaleX),
+                                  double scaleY = DEFAULT_VALUE(double, RcDialogScaleY));
+    bool writeLanguagesToTs(const QString &path, const QString &sourceLanguage = {});
     void previewDialog(const RcCore::Widget &dialog) const;
     void mergeAllLanguages(const QString &language = DefaultLanguage);
     void mergeLanguages();
@@ -124,13 +145,72 @@ protected:
     bool doLoad(const QString &fileName) override;
 
 private:
+    // Indexes of the resources by id, for one language
+    struct DataIndex
+    {
+        QHash<QString, qsizetype> dialogs;
+        QHash<QString, qsizetype> menus;
+        QHash<QString, qsizetype> toolBars;
+    };
+
+    QStringList writeDialogs(const QStringList &ids, const QString &path, ConversionFlags flags, double scaleX,
+                             double scaleY, const QString &extension,
+                             void (*writeDialog)(const RcCore::Widget &, QIODevice *)) const;
+
     const RcCore::Data &data() const;
+    const RcCore::Data *dataForLanguage(const QString &language) const;
+    const DataIndex &dataIndex() const;
     bool isDataValid() const;
 
-    RcCore::RcFile m_rcFile;
+    // Lazy loading, see the RcLazyLoading setting
+    bool isLanguageParsed(const QString &language) const;
+    RcCore::Data parseLanguage(const QString &language,
+                               const std::function<bool(const RcCore::RcFile::Resource &)> &filter) const;
+    QStringList resourceIds(const QStringList &types) const;
+    const QHash<QString, RcCore::String> *stringTable(const QString &language) const;
+    void parseAllLanguages() const;
+    void resetLazyData();
+
+    RcCore::Widget convertDialog(const RcCore::Data &data, const RcCore::Data::Dialog &dialog, int flags, double scaleX,
+                                 double scaleY) const;
+    void clearConversionCache();
+
+    const RcCore::Data::Dialog *findDialog(const QString &id) const;
+    const RcCore::Menu *findMenu(const QString &id) const;
+    const RcCore::ToolBar *findToolBar(const QString &id) const;
+
+    // Mutable for the lazy loading, the data of a language is parsed the first time it's needed
+    mutable RcCore::RcFile m_rcFile;
     QString m_language;
     QVector<RcCore::Asset> m_cacheAssets;
     QVector<RcCore::Action> m_cacheActions;
+    // Built the first time they are needed, and cleared when the data changes
+    mutable QHash<QString, DataIndex> m_dataIndexes;
+    mutable QHash<QString, qsizetype> m_actionIndex;
+    // Conversions already done, cleared when the data changes
+    struct DialogKey
+    {
+        QString language;
+        QString id;
+        int flags;
+        double scaleX;
+        double scaleY;
+
+        bool operator==(const DialogKey &other) const = default;
+        friend size_t qHash(const DialogKey &key, size_t seed = 0)
+        {
+            return qHashMulti(seed, key.language, key.id, key.flags, key.scaleX, key.scaleY);
+        }
+    };
+    mutable QMutex m_conversionMutex;
+    mutable QHash<DialogKey, RcCore::Widget> m_dialogCache;
+    // Actions by language and flags
+    QHash<std::pair<QString, int>, QVector<RcCore::Action>> m_actionCache;
+    // Set if the file is loaded with RcCore::parseIndex
+    bool m_lazy = false;
+    mutable QSet<QString> m_parsedLanguages;
+    // String tables of the languages not parsed yet, parsed on their own
+    mutable QHash<QString, QHash<QString, RcCore::String>> m_lazyStrings;
 };
 
 NLOHMANN_JSON_SERIALIZE_ENUM(RcDocument::ConversionFlag,
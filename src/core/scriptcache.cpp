@@ -0,0 +1,162 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "scriptcache.h"
+#include "utils/json.h"
+#include "utils/log.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+namespace Core {
+
+// Increment when the format of the cache changes, to invalidate existing caches
+constexpr int ScriptCacheVersion = 1;
+
+static QByteArray fileHash(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return {};
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(&file);
+    return hash.result().toHex();
+}
+
+QString ScriptCache::entryKey(const QString &key, const QString &fileName)
+{
+    return fileName.isEmpty() ? key : fileName + '\n' + key;
+}
+
+bool ScriptCache::load(const QString &cacheFile)
+{
+    QFile file(cacheFile);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    try {
+        const QByteArray data = file.readAll();
+        const auto json = nlohmann::json::from_cbor(data.cbegin(), data.cend());
+        if (json.at("version").get<int>() != ScriptCacheVersion)
+            return false;
+        // File names are stored relative to the cache, so the project can be moved
+        const QDir dir = QFileInfo(cacheFile).absoluteDir();
+        m_entries.clear();
+        for (const auto &item : json.at("entries")) {
+            Entry entry {item.at("key").get<QString>(), item.at("value")};
+            if (const auto fileName = item.at("file").get<QString>(); !fileName.isEmpty()) {
+                entry.fileName = QDir::cleanPath(dir.absoluteFilePath(fileName));
+                entry.hash = QByteArray::fromStdString(item.at("hash").get<std::string>());
+                entry.size = item.at("size").get<qint64>();
+                entry.lastModified = item.at("modified").get<qint64>();
+            }
+            const auto key = entryKey(entry.key, entry.fileName);
+            m_entries.insert(key, std::move(entry));
+        }
+    } catch (...) {
+        spdlog::warn("ScriptCache::load - invalid cache file {}", cacheFile);
+        m_entries.clear();
+        return false;
+    }
+    m_changed = false;
+    return true;
+}
+
+bool ScriptCache::save(const QString &cacheFile) const
+{
+    const QDir dir = QFileInfo(cacheFile).absoluteDir();
+    auto entries = nlohmann::json::array();
+    for (const auto &entry : m_entries) {
+        nlohmann::json item {{"key", entry.key}, {"value", entry.value}};
+        item["file"] = entry.fileName.isEmpty() ? QString() : dir.relativeFilePath(entry.fileName);
+        if (!entry.fileName.isEmpty()) {
+            item["hash"] = entry.hash.toStdString();
+            item["size"] = entry.size;
+            item["modified"] = entry.lastModified;
+        }
+        entries.push_back(std::move(item));
+    }
+    const nlohmann::json json {{"version", ScriptCacheVersion}, {"entries", std::move(entries)}};
+
+    if (!QDir().mkpath(dir.absolutePath())) {
+        spdlog::warn("ScriptCache::save - can't create cache directory {}", dir.absolutePath());
+        return false;
+    }
+    // Use a QSaveFile, so another Knut instance never reads a partial file
+    QSaveFile file(cacheFile);
+    if (!file.open(QIODevice::WriteOnly)) {
+        spdlog::warn("ScriptCache::save - can't write cache file {}", cacheFile);
+        return false;
+    }
+    const auto data = nlohmann::json::to_cbor(json);
+    file.write(reinterpret_cast<const char *>(data.data()), static_cast<qint64>(data.size()));
+    if (!file.commit()) {
+        spdlog::warn("ScriptCache::save - can't write cache file {}", cacheFile);
+        return false;
+    }
+    return true;
+}
+
+// The content is only hashed again if the size or modification time of the file changed
+bool ScriptCache::isValid(Entry &entry) const
+{
+    if (entry.fileName.isEmpty())
+        return true;
+    const QFileInfo fi(entry.fileName);
+    if (!fi.exists())
+        return false;
+    const qint64 lastModified = fi.lastModified().toMSecsSinceEpoch();
+    if (fi.size() == entry.size && lastModified == entry.lastModified)
+        return true;
+    if (fi.size() != entry.size || fileHash(entry.fileName) != entry.hash)
+        return false;
+    // Same content, touched since
+    entry.lastModified = lastModified;
+    return true;
+}
+
+std::optional<nlohmann::json> ScriptCache::value(const QString &key, const QString &fileName)
+{
+    auto it = m_entries.find(entryKey(key, fileName));
+    if (it == m_entries.end())
+        return {};
+    const qint64 lastModified = it->lastModified;
+    if (!isValid(*it)) {
+        m_entries.erase(it);
+        m_changed = true;
+        return {};
+    }
+    m_changed |= it->lastModified != lastModified;
+    return it->value;
+}
+
+void ScriptCache::setValue(const QString &key, nlohmann::json value, const QString &fileName)
+{
+    Entry entry {key, std::move(value), fileName};
+    if (!fileName.isEmpty()) {
+        const QFileInfo fi(fileName);
+        entry.hash = fileHash(fileName);
+        entry.size = fi.size();
+        entry.lastModified = fi.lastModified().toMSecsSinceEpoch();
+    }
+    m_entries.insert(entryKey(key, fileName), std::move(entry));
+    m_changed = true;
+}
+
+void ScriptCache::clear()
+{
+    m_changed = m_changed || !m_entries.isEmpty();
+    m_entries.clear();
+}
+
+} // namespace Core
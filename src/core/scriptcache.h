@@ -0,0 +1,59 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <nlohmann/json.hpp>
+#include <optional>
+
+namespace Core {
+
+/**
+ * \brief Persistent key-value store of the scripts, see Project::cacheValue
+ *
+ * An entry can be attached to a file: it's only valid as long as the file has the same content. The size and
+ * modification time of the file are checked first, so the file is only read again if they changed.
+ *
+ * The store is saved as one CBOR file (binary json), much more compact than json for large values.
+ */
+class ScriptCache
+{
+public:
+    bool load(const QString &cacheFile);
+    bool save(const QString &cacheFile) const;
+    bool hasChanged() const { return m_changed; }
+
+    // `fileName` is a full path, the entry is removed if the file changed since it was set
+    std::optional<nlohmann::json> value(const QString &key, const QString &fileName = {});
+    void setValue(const QString &key, nlohmann::json value, const QString &fileName = {});
+    void clear();
+
+private:
+    struct Entry
+    {
+        QString key;
+        nlohmann::json value;
+        QString fileName;
+        QByteArray hash;
+        qint64 size = 0;
+        qint64 lastModified = 0;
+    };
+
+    static QString entryKey(const QString &key, const QString &fileName);
+    bool isValid(Entry &entry) const;
+
+    QHash<QString, Entry> m_entries;
+    bool m_changed = false;
+};
+
+} // namespace Core
@@ -22,15 +22,20 @@
 #include <QCoreApplication>
 #include <QDialogButtonBox>
 #include <QDoubleSpinBox>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QFileInfo>
+#include <QHeaderView>
 #include <QLineEdit>
+#include <QListWidget>
 #include <QMessageBox>
 #include <QPushButton>
 #include <QQmlContext>
 #include <QRadioButton>
 #include <QSpinBox>
+#include <QTableWidget>
 #include <QToolButton>
+#include <QTreeWidget>
 #include <QUiLoader>
 #include <QVBoxLayout>
 
@@ -49,6 +54,11 @@ namespace Core {
  * Buttons (`QPushButton` or `QToolButton`) `clicked` signal is mapped to the `clicked` signal of this class, with the
  * button `objectName` as parameter. `QDialogButtonBox` `accepted` or `rejected` signals are automatically connected.
  *
+ * Item views (`QListView`, `QTableView` or `QTreeView`) show the array set to the `objectNameModel` property in one
+ * call, however many rows it has: each row is an object, an array or a value. The keys of the object rows, and the
+ * header of the columns, are set with the `objectNameColumns` property. The current row is in the `objectName`
+ * property.
+ *
  * ```qml
  * import Script 1.0
  *
@@ -70,6 +80,12 @@ namespace Core {
 /*!
  * \qmlproperty QQmlPropertyMap ScriptDialog::data
  * This read-only property contains all properties mapping the widgets.
+ *
+ * ```qml
+ * data.tableView = -1
+ * data.tableViewColumns = ["name", "file"]
+ * data.tableViewModel = candidates.map(symbol => ({name: symbol.name, file: symbol.fileName}))
+ * ```
  */
 
 /*!
@@ -321,6 +337,30 @@ void ScriptDialogItem::runSteps(const QJSValue &generator)
     runNextStep();
 }
 
+/**
+ * \qmlmethod ScriptDialog::setValues(object values)
+ *
+ * Sets several properties of `data` at once, the keys of `values` being the names of the properties. The dialog is
+ * only repainted once all the widgets are updated.
+ *
+ * ```javascript
+ * setValues({lineEdit: "Hello World!", checkBox: true, listViewModel: fileNames})
+ * ```
+ */
+void ScriptDialogItem::setValues(const QVariantMap &values)
+{
+    setUpdatesEnabled(false);
+    for (auto it = values.cbegin(); it != values.cend(); ++it) {
+        const auto name = it.key().toLocal8Bit();
+        if (m_data->metaObject()->indexOfProperty(name) == -1) {
+            spdlog::error("ScriptDialogItem::setValues - no property {}", it.key());
+            continue;
+        }
+        m_data->setProperty(name, it.value());
+    }
+    setUpdatesEnabled(true);
+}
+
 void ScriptDialogItem::showProgressDialog()
 {
     // If there's no interaction or the progress bar is already displayed, do nothing
@@ -342,6 +382,7 @@ void ScriptDialogItem::showProgressDialog()
 
     m_progressDialogs.push_back(m_progressDialog);
     m_progressDialog->show();
+    m_forceProgressUpdate = true;
     updateProgress();
 }
 
@@ -357,9 +398,17 @@ void ScriptDialogItem::cleanupProgressDialog()
 
 void ScriptDialogItem::updateProgress()
 {
-    if (!m_progressDialogs.empty()) {
-        QCoreApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
-    }
+    if (m_progressDialogs.empty())
+        return;
+
+    // This is called for each logged API call and each query match: processing the events every time would spend
+    // more time redrawing than running the script, so the progress is only repainted at a fixed frame rate.
+    static QElapsedTimer frameTimer;
+    if (frameTimer.isValid() && !m_forceProgressUpdate && frameTimer.elapsed() < ProgressFrameInterval)
+        return;
+    m_forceProgressUpdate = false;
+    frameTimer.start();
+    QCoreApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
 }
 
 QObject *ScriptDialogItem::data() const
@@ -391,6 +440,21 @@ void ScriptDialogItem::setUiFile(const QString &fileName)
     }
 }
 
+// Only the views using their own model can show an ArrayModel: not the item widgets, the headers or the popups of the
+// comboboxes
+static QAbstractItemView *arrayModelView(QWidget *widget)
+{
+    auto view = qobject_cast<QAbstractItemView *>(widget);
+    if (!view || view->objectName().isEmpty() || qobject_cast<QHeaderView *>(view) || qobject_cast<QListWidget *>(view)
+        || qobject_cast<QTableWidget *>(view) || qobject_cast<QTreeWidget *>(view))
+        return nullptr;
+    for (auto parent = view->parentWidget(); parent; parent = parent->parentWidget()) {
+        if (qobject_cast<QComboBox *>(parent))
+            return nullptr;
+    }
+    return view;
+}
+
 void ScriptDialogItem::createProperties(QWidget *dialogWidget)
 {
     const auto widgets = dialogWidget->findChildren<QWidget *>();
@@ -450,6 +514,18 @@ void ScriptDialogItem::createProperties(QWidget *dialogWidget)
                 completer->setModel(comboBox->model());
                 comboBox->setCompleter(completer);
             }
+        } else if (auto view = arrayModelView(widget)) {
+            const auto name = widget->objectName();
+            view->setModel(new ArrayModel(view));
+            m_data->addProperty(name.toLocal8Bit(), "int", QMetaType::Int, -1);
+            m_data->addProperty((name + "Model").toLocal8Bit(), "QVariantList", QMetaType::QVariantList,
+                                QVariantList());
+            m_data->addProperty((name + "Columns").toLocal8Bit(), "QStringList", QMetaType::QStringList,
+                                QStringList());
+            connect(view->selectionModel(), &QItemSelectionModel::currentRowChanged, this,
+                    [this, name](const QModelIndex &current) {
+                        m_data->setProperty(name.toLocal8Bit(), current.row());
+                    });
         }
     }
 
@@ -471,16 +547,27 @@ void ScriptDialogItem::changeValue(const QString &key, const QVariant &value)
         doubleSpinBox->setValue(value.toDouble());
     } else if (auto comboBox = qobject_cast<QComboBox *>(widget)) {
         comboBox->setCurrentText(value.toString());
+    } else if (auto view = arrayModelView(widget)) {
+        if (view->currentIndex().row() != value.toInt())
+            view->setCurrentIndex(view->model()->index(value.toInt(), 0));
     }
 
-    // It may be a combobox model
+    // It may be a combobox or an item view model
     if (key.endsWith("Model")) {
-        if (auto comboBox = findChild<QComboBox *>(key.left(key.length() - 5))) {
+        const auto name = key.left(key.length() - 5);
+        if (auto comboBox = findChild<QComboBox *>(name)) {
             comboBox->clear();
             comboBox->addItems(value.toStringList());
             if (comboBox->count())
                 comboBox->setCurrentIndex(0);
+        } else if (auto view = arrayModelView(findChild<QWidget *>(name))) {
+            static_cast<ArrayModel *>(view->model())->setRows(value.toList());
+            // The selection is cleared by the reset of the model, without any signal
+            m_data->setProperty(name.toLocal8Bit(), -1);
         }
+    } else if (key.endsWith("Columns")) {
+        if (auto view = arrayModelView(findChild<QWidget *>(key.left(key.length() - 7))))
+            static_cast<ArrayModel *>(view->model())->setColumns(value.toStringList());
     }
 }
 
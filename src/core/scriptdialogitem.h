@@ -39,7 +39,8 @@ public:
 
     // This method is used to redraw the application while a script is running
     // Long-running scripts will otherwise block the GUI, which may look like Knut is hung up.
-    // This method should be called in regular intervals to ensure visual progress.
+    // This method should be called in regular intervals to ensure visual progress, the events are processed at most
+    // 30 times per second.
     static void updateProgress();
 
     bool isInteractive() const;
@@ -50,6 +51,7 @@ public:
     Q_INVOKABLE void firstStep(const QString &firstStep);
     Q_INVOKABLE void nextStep(const QString &title);
     Q_INVOKABLE void runSteps(const QJSValue &generator);
+    Q_INVOKABLE void setValues(const QVariantMap &values);
 
 public slots:
     void setStepCount(int stepCount);
@@ -85,6 +87,9 @@ private:
     ScriptProgressDialog *m_progressDialog = nullptr;
     // Used to track existing progressDialog, in case we need to update the UI
     static inline QVector<ScriptProgressDialog *> m_progressDialogs = {};
+    // Interval in ms between two repaints of the progress, and whether the next update shouldn't wait for it
+    static constexpr int ProgressFrameInterval = 1000 / 30;
+    static inline bool m_forceProgressUpdate = false;
 
     int m_stepCount = 0;
     int m_currentStep = 0;
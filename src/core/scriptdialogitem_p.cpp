@@ -11,6 +11,7 @@
 #include "scriptdialogitem_p.h"
 #include "utils/log.h"
 
+#include <algorithm>
 #include <private/qmetaobjectbuilder_p.h>
 
 namespace Core {
@@ -88,4 +89,80 @@ void *DynamicObject::qt_metacast(const char *name)
     }
 }
 
+//=============================================================================
+// ArrayModel
+//=============================================================================
+void ArrayModel::setRows(QVariantList rows)
+{
+    beginResetModel();
+    m_rows = std::move(rows);
+    updateColumnCount();
+    endResetModel();
+}
+
+void ArrayModel::setColumns(QStringList columns)
+{
+    beginResetModel();
+    m_columns = std::move(columns);
+    updateColumnCount();
+    endResetModel();
+}
+
+// Only the first object row is used for the keys, all rows of a table are expected to have the same keys
+void ArrayModel::updateColumnCount()
+{
+    m_keys.clear();
+    if (!m_columns.isEmpty()) {
+        m_columnCount = static_cast<int>(m_columns.size());
+        return;
+    }
+
+    m_columnCount = m_rows.isEmpty() ? 0 : 1;
+    for (const auto &row : std::as_const(m_rows)) {
+        if (row.typeId() == QMetaType::QVariantList) {
+            const auto size = static_cast<const QVariantList *>(row.constData())->size();
+            m_columnCount = std::max(m_columnCount, static_cast<int>(size));
+        } else if (row.typeId() == QMetaType::QVariantMap && m_keys.isEmpty()) {
+            m_keys = row.toMap().keys();
+            m_columnCount = std::max(m_columnCount, static_cast<int>(m_keys.size()));
+        }
+    }
+}
+
+int ArrayModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : static_cast<int>(m_rows.size());
+}
+
+int ArrayModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_columnCount;
+}
+
+QVariant ArrayModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || (role != Qt::DisplayRole && role != Qt::ToolTipRole))
+        return {};
+
+    // The values are read in place, without copying the row
+    const auto &row = m_rows.at(index.row());
+    if (row.typeId() == QMetaType::QVariantList)
+        return static_cast<const QVariantList *>(row.constData())->value(index.column());
+    if (row.typeId() == QMetaType::QVariantMap) {
+        const auto &keys = m_columns.isEmpty() ? m_keys : m_columns;
+        return static_cast<const QVariantMap *>(row.constData())->value(keys.value(index.column()));
+    }
+    return index.column() == 0 ? row : QVariant();
+}
+
+QVariant ArrayModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole) {
+        const auto &keys = m_columns.isEmpty() ? m_keys : m_columns;
+        if (section < keys.size())
+            return keys.at(section);
+    }
+    return QAbstractTableModel::headerData(section, orientation, role);
+}
+
 } // namespace Core
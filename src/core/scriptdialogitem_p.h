@@ -10,7 +10,9 @@
 
 #pragma once
 
+#include <QAbstractTableModel>
 #include <QObject>
+#include <QStringList>
 #include <QVariant>
 
 namespace Core {
@@ -61,4 +63,35 @@ private:
     DataChangedFunc m_dataChangedCallback;
 };
 
+/**
+ * Read-only table model for the item views of a ScriptDialog, set from a JavaScript array in one call.
+ *
+ * Each row is an object (one column per key, see setColumns), an array (one column per value) or a plain value (one
+ * column). The rows are kept as they are, the values are only converted when displayed.
+ */
+class ArrayModel : public QAbstractTableModel
+{
+public:
+    using QAbstractTableModel::QAbstractTableModel;
+
+    /** Replaces all the rows, with only one reset of the model. */
+    void setRows(QVariantList rows);
+    /** Sets the keys of the columns for the object rows, and the header of the columns. */
+    void setColumns(QStringList columns);
+
+    int rowCount(const QModelIndex &parent = {}) const override;
+    int columnCount(const QModelIndex &parent = {}) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+private:
+    void updateColumnCount();
+
+    QVariantList m_rows;
+    QStringList m_columns;
+    // Keys of the first object row, used if there are no columns
+    QStringList m_keys;
+    int m_columnCount = 0;
+};
+
 } // namespace Core
@@ -20,9 +20,11 @@
 #include <QFile>
 #include <QFileInfo>
 #include <QFileSystemWatcher>
+#include <QFutureWatcher>
 #include <QTextStream>
 #include <QTimer>
-#include <kdalgorithms.h>
+#include <QtConcurrent>
+#include <utility>
 
 namespace Core {
 
@@ -30,9 +32,12 @@ ScriptManager::ScriptManager(QObject *parent)
     : QObject(parent)
     , m_watcher(new QFileSystemWatcher(this))
     , m_runner(new ScriptRunner(this))
+    , m_descriptionWatcher(new QFutureWatcher<QList<Description>>(this))
 {
     m_instance = this;
 
+    connect(m_descriptionWatcher, &QFutureWatcherBase::finished, this, &ScriptManager::applyDescriptions);
+
     connect(m_watcher, &QFileSystemWatcher::directoryChanged, this, &ScriptManager::updateScriptDirectory);
     connect(Settings::instance(), &Settings::settingsLoaded, this, &ScriptManager::updateDirectories);
     updateDirectories();
@@ -95,64 +100,123 @@ void ScriptManager::runScript(const QString &fileName, bool async, bool log)
         doRunScript(fileName, endScriptCallback);
 }
 
-void ScriptManager::addScript(const QString &fileName)
+static QString readDescription(const QString &fileName)
 {
     QFile file(fileName);
     if (!file.open(QIODevice::ReadOnly))
-        return;
+        return {};
 
     QTextStream stream(&file);
     const auto line = stream.readLine();
-    const QString description = line.startsWith("//") ? line.mid(2).simplified() : "";
-
-    const QFileInfo fi(fileName);
-
-    Script script {fi.fileName(), fileName, description};
-    emit aboutToAddScript(script, static_cast<int>(m_scriptList.size()));
-    m_scriptList.push_back(std::move(script));
-    emit scriptAdded(m_scriptList.back());
+    return line.startsWith("//") ? line.mid(2).simplified() : "";
 }
 
-static QStringList scriptListFromDir(const QString &path)
+void ScriptManager::addScripts(const QStringList &fileNames)
 {
-    const QStringList filter {"*.js", "*.qml"};
-    QDirIterator it(path, filter, QDir::Files);
-    QStringList files;
-    files.reserve(filter.count());
-    while (it.hasNext())
-        files << it.next();
-    return files;
+    for (const auto &fileName : fileNames) {
+        const QFileInfo fi(fileName);
+        Script script {fi.fileName(), fileName, {}};
+        emit aboutToAddScript(script, static_cast<int>(m_scriptList.size()));
+        m_scriptList.push_back(std::move(script));
+        emit scriptAdded(m_scriptList.back());
+    }
+
+    m_pendingDescriptions.append(fileNames);
+    readDescriptions();
 }
 
-void ScriptManager::updateScriptDirectory(const QString &path)
+void ScriptManager::removeScripts(const QSet<QString> &fileNames)
 {
-    const QStringList filesInDir = scriptListFromDir(path);
+    if (fileNames.isEmpty())
+        return;
 
-    // Remove deleted scripts
     auto it = m_scriptList.begin();
     while (it != m_scriptList.end()) {
-        const auto &script = *it;
-
-        // Only remove the script if it was actually in the directory that had changes
-        if (script.fileName.startsWith(path) && !filesInDir.contains(script.fileName)) {
-            it = removeScript(it);
+        if (fileNames.contains(it->fileName)) {
+            const auto script = *it;
+            emit aboutToRemoveScript(script, static_cast<int>(it - m_scriptList.begin()));
+            it = m_scriptList.erase(it);
+            emit scriptRemoved(script);
         } else {
             ++it;
         }
     }
+}
 
-    auto scriptToFileName = [](const auto &script) {
-        return script.fileName;
-    };
-    auto currentFileNames = kdalgorithms::transformed(m_scriptList, scriptToFileName);
-    // Add new scripts
-    for (const auto &fileName : filesInDir) {
-        if (!kdalgorithms::contains(currentFileNames, fileName)) {
-            addScript(fileName);
-        }
+void ScriptManager::readDescriptions()
+{
+    // Only one batch at a time, the next one is started once the current one is applied
+    if (m_descriptionFuture.isValid() || m_pendingDescriptions.isEmpty())
+        return;
+
+    m_descriptionFuture = QtConcurrent::run([fileNames = std::exchange(m_pendingDescriptions, {})]() {
+        QList<Description> descriptions;
+        descriptions.reserve(fileNames.size());
+        for (const auto &fileName : fileNames)
+            descriptions.emplace_back(fileName, readDescription(fileName));
+        return descriptions;
+    });
+    m_descriptionWatcher->setFuture(m_descriptionFuture);
+}
+
+void ScriptManager::applyDescriptions()
+{
+    if (!m_descriptionFuture.isValid() || !m_descriptionFuture.isFinished())
+        return;
+
+    QHash<QString, QString> descriptions;
+    const auto results = std::exchange(m_descriptionFuture, {}).result();
+    for (const auto &[fileName, description] : results)
+        descriptions.insert(fileName, description);
+
+    // Scripts removed in the meantime are just skipped
+    for (int i = 0; i < static_cast<int>(m_scriptList.size()); ++i) {
+        auto &script = m_scriptList[i];
+        const auto it = descriptions.constFind(script.fileName);
+        if (it == descriptions.cend() || it->isEmpty())
+            continue;
+        script.description = *it;
+        emit scriptChanged(script, i);
+    }
+
+    readDescriptions();
+}
+
+void ScriptManager::waitForDescriptions()
+{
+    while (m_descriptionFuture.isValid()) {
+        m_descriptionFuture.waitForFinished();
+        applyDescriptions();
     }
 }
 
+static QSet<QString> scriptListFromDir(const QString &path)
+{
+    const QStringList filter {"*.js", "*.qml"};
+    QDirIterator it(path, filter, QDir::Files);
+    QSet<QString> files;
+    while (it.hasNext())
+        files.insert(it.next());
+    return files;
+}
+
+void ScriptManager::updateScriptDirectory(const QString &path)
+{
+    auto it = m_directoryFiles.find(path);
+    if (it == m_directoryFiles.end())
+        return;
+
+    // Only update the scripts that were added or removed since the last change
+    QSet<QString> filesInDir = scriptListFromDir(path);
+    const QSet<QString> removedFiles = QSet<QString>(*it).subtract(filesInDir);
+    QStringList addedFiles = QSet<QString>(filesInDir).subtract(*it).values();
+    addedFiles.sort();
+    *it = std::move(filesInDir);
+
+    removeScripts(removedFiles);
+    addScripts(addedFiles);
+}
+
 void ScriptManager::addScriptsFromPath(const QString &path)
 {
     QFileInfo fi(path);
@@ -167,9 +231,11 @@ void ScriptManager::addScriptsFromPath(const QString &path)
     m_directories.append(path);
     m_watcher->addPath(path);
 
-    const QStringList files = scriptListFromDir(path);
-    for (const auto &fileName : files)
-        addScript(fileName);
+    const auto files = scriptListFromDir(path);
+    m_directoryFiles.insert(path, files);
+    QStringList fileNames = files.values();
+    fileNames.sort();
+    addScripts(fileNames);
 }
 
 void ScriptManager::removeScriptsFromPath(const QString &path)
@@ -179,24 +245,7 @@ void ScriptManager::removeScriptsFromPath(const QString &path)
     if (m_watcher->directories().contains(path))
         m_watcher->removePath(path);
 
-    const QStringList files = scriptListFromDir(path);
-    auto it = m_scriptList.begin();
-    while (it != m_scriptList.end()) {
-        if (files.contains(it->fileName)) {
-            it = removeScript(it);
-        } else {
-            ++it;
-        }
-    }
-}
-
-ScriptManager::ScriptList::iterator ScriptManager::removeScript(const ScriptList::iterator &iterator)
-{
-    auto script = *iterator;
-    emit aboutToRemoveScript(script, static_cast<int>(iterator - m_scriptList.begin()));
-    auto it = m_scriptList.erase(iterator);
-    emit scriptRemoved(script);
-    return it;
+    removeScripts(m_directoryFiles.take(path));
 }
 
 void ScriptManager::doRunScript(const QString &fileName, const std::function<void()> &endFunc)
@@ -10,7 +10,10 @@
 
 #pragma once
 
+#include <QFuture>
+#include <QHash>
 #include <QObject>
+#include <QSet>
 #include <QStringList>
 #include <QVariant>
 #include <functional>
@@ -18,6 +21,8 @@
 
 class QFileSystemWatcher;
 class QAbstractItemModel;
+template <typename T>
+class QFutureWatcher;
 
 namespace Core {
 
@@ -30,6 +35,9 @@ class ScriptRunner;
  *
  * Scripts directory are watched using a QFileSystemWatcher, to update
  * the list of script in case one is added or deleted.
+ *
+ * The descriptions of the scripts are read in a background thread, so they may be empty right after a script is
+ * added. The scriptChanged signal is emitted once the description is known.
  */
 class ScriptManager : public QObject
 {
@@ -57,6 +65,9 @@ public:
 
     static QAbstractItemModel *model();
 
+    // Blocks until the descriptions of all scripts are read
+    void waitForDescriptions();
+
 public slots:
     void runScript(const QString &fileName, bool async = true, bool log = true);
 
@@ -71,21 +82,27 @@ signals:
     void aboutToRemoveScript(const Core::ScriptManager::Script &script, int index);
     void scriptRemoved(const Core::ScriptManager::Script &script);
 
+    void scriptChanged(const Core::ScriptManager::Script &script, int index);
+
 private:
     friend class KnutCore;
     explicit ScriptManager(QObject *parent = nullptr);
 
-    void addScript(const QString &fileName);
+    using Description = std::pair<QString, QString>;
+
+    void addScripts(const QStringList &fileNames);
+    void removeScripts(const QSet<QString> &fileNames);
     void addScriptsFromPath(const QString &path);
     void removeScriptsFromPath(const QString &path);
 
+    void readDescriptions();
+    void applyDescriptions();
+
     void doRunScript(const QString &fileName, const std::function<void()> &endFunc);
 
     void updateDirectories();
     void updateScriptDirectory(const QString &path);
 
-    ScriptList::iterator removeScript(const ScriptList::iterator &iterator);
-
 private:
     inline static ScriptManager *m_instance = nullptr;
 
@@ -94,7 +111,13 @@ private:
 
     ScriptList m_scriptList;
     QStringList m_directories;
+    // Script files in each directory, to only update the ones that changed
+    QHash<QString, QSet<QString>> m_directoryFiles;
     QVariant m_result;
+
+    QStringList m_pendingDescriptions;
+    QFuture<QList<Description>> m_descriptionFuture;
+    QFutureWatcher<QList<Description>> *const m_descriptionWatcher;
 };
 
 } // namespace Core
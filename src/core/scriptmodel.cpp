@@ -26,6 +26,9 @@ ScriptModel::ScriptModel(ScriptManager *parent)
 
     connect(parent, &ScriptManager::scriptAdded, this, &ScriptModel::onScriptAdded);
     connect(parent, &ScriptManager::scriptRemoved, this, &ScriptModel::onScriptRemoved);
+    connect(parent, &ScriptManager::scriptChanged, this, [this](const ScriptManager::Script &, int index) {
+        emit dataChanged(this->index(index, 0), this->index(index, ColumnCount - 1));
+    });
 }
 
 const ScriptManager::ScriptList &scriptList()
@@ -9,42 +9,59 @@
 */
 
 #include "scriptrunner.h"
+#include "classeditor.h"
 #include "classsymbol.h"
 #include "cppdocument.h"
 #include "dir.h"
 #include "file.h"
+#include "filequerymatch.h"
 #include "fileinfo.h"
 #include "functionsymbol.h"
+#include "jsondocument.h"
+#include "lineiterator.h"
 #include "mark.h"
 #include "message.h"
+#include "mfcinfo.h"
+#include "profiler.h"
 #include "project.h"
 #include "qttsdocument.h"
 #include "qtuidocument.h"
+#include "querymatchiterator.h"
 #include "rcdocument.h"
 #include "scriptdialogitem.h"
 #include "scriptitem.h"
 #include "settings.h"
 #include "symbol.h"
+#include "symbolindex.h"
 #include "testutil.h"
 #include "textdocument.h"
 #include "textrange.h"
 #include "userdialog.h"
 #include "utils.h"
 #include "utils/log.h"
+#include "utils/metrics.h"
+#include "version.h"
 
+#include <QCoreApplication>
 #include <QDir>
+#include <QEventLoop>
 #include <QFile>
 #include <QFileInfo>
 #include <QQuickItem>
 #include <QQuickView>
 #include <QQuickWindow>
+#include <QStandardPaths>
+#include <QTimer>
 #include <QtQml/private/qqmlengine_p.h>
 #include <kdalgorithms.h>
+#include <memory>
 
 namespace Core {
 
 static constexpr int NormalExitCode = 0;
 static constexpr int ErrorCode = -1;
+// Maximum number of idle engines kept for reuse, more are only needed for nested scripts
+static constexpr int MaxPooledEngines = 4;
 
 template <typename Object>
 void addProperties(QSet<QString> &properties)
@@ -56,20 +73,51 @@ void addProperties(QSet<QString> &properties)
     }
 }
 
+// Scripts are compiled to bytecode by the QML engine, and cached on disk by Qt: the cache is checked against the
+// source file, and the Qt version. The cache is stored in a directory specific to the Knut version, so a new version
+// doesn't reuse bytecode compiled for a previous one.
+static void setupDiskCache()
+{
+    // Keep an explicit setup from the environment
+    if (qEnvironmentVariableIsSet("QML_DISK_CACHE_PATH") || qEnvironmentVariableIsSet("QML_DISABLE_DISK_CACHE"))
+        return;
+
+    QString path = Settings::instance()->value<QString>(Settings::ScriptCachePath);
+    if (path.isEmpty())
+        path = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/qmlcache";
+    path = QDir(path).absoluteFilePath(core::knut_version());
+    if (!QDir().mkpath(path)) {
+        spdlog::warn("ScriptRunner: can't create the script cache directory {}", path);
+        return;
+    }
+    qputenv("QML_DISK_CACHE_PATH", QFile::encodeName(path));
+}
+
 ScriptRunner::ScriptRunner(QObject *parent)
     : QObject(parent)
 {
+    // Needs to be done before the first engine is created
+    setupDiskCache();
+
     // Script objects registrations
     qRegisterMetaType<FunctionArgument>();
     qRegisterMetaType<ClassSymbol>();
     qRegisterMetaType<FunctionSymbol>();
+    qRegisterMetaType<FileQueryCapture>();
+    qRegisterMetaType<FileQueryMatch>();
+    qRegisterMetaType<IndexedSymbol>();
+    qRegisterMetaType<MfcClass>();
+    qRegisterMetaType<MfcMessageMapEntry>();
+    qRegisterMetaType<MfcMessageMap>();
+    qRegisterMetaType<MfcDataExchange>();
+    qRegisterMetaType<MfcFileInfo>();
     qRegisterMetaType<QDirValueType>();
     qRegisterMetaType<QFileInfoValueType>();
     qRegisterMetaType<Symbol>();
     qRegisterMetaType<TextRange>();
 
     // Script
-    qmlRegisterSingletonType<Dir>("Script", 1, 0, "Dir", [](QQmlEngine *engine, QJSEngine *) {
+    m_dirTypeId = qmlRegisterSingletonType<Dir>("Script", 1, 0, "Dir", [](QQmlEngine *engine, QJSEngine *) {
         return new Dir(engine->property("scriptPath").toString());
     });
     qmlRegisterSingletonType<FileInfo>("Script", 1, 0, "FileInfo", [](QQmlEngine *, QJSEngine *) {
@@ -103,9 +151,16 @@ ScriptRunner::ScriptRunner(QObject *parent)
     qmlRegisterType<QtUiDocument>("Script", 1, 0, "QtUiDocument");
     qmlRegisterUncreatableType<QtUiWidget>("Script", 1, 0, "QtUiWidget", "Only created by QtUiDocument");
     qmlRegisterType<CppDocument>("Script", 1, 0, "CppDocument");
+    qmlRegisterUncreatableType<ClassEditor>("Script", 1, 0, "ClassEditor", "Only created by CppDocument");
     qmlRegisterUncreatableType<Core::Symbol>("Script", 1, 0, "Symbol", "Only created by CodeDocument");
+    qmlRegisterUncreatableMetaObject(IndexedSymbol::staticMetaObject, "Script", 1, 0, "IndexedSymbol",
+                                     "Only created by Project");
+    qmlRegisterUncreatableType<QueryMatchIterator>("Script", 1, 0, "QueryMatchIterator",
+                                                   "Only created by CodeDocument");
+    qmlRegisterUncreatableType<LineIterator>("Script", 1, 0, "LineIterator", "Only created by File");
     qmlRegisterType<RcDocument>("Script", 1, 0, "RcDocument");
     qmlRegisterType<QtTsDocument>("Script", 1, 0, "QtTsDocument");
+    qmlRegisterType<JsonDocument>("Script", 1, 0, "JsonDocument");
     qmlRegisterUncreatableType<QtTsMessage>("Script", 1, 0, "QtTsMessage", "Only created by QtTsDocument");
 
     // RcCore
@@ -167,7 +222,10 @@ ScriptRunner::ScriptRunner(QObject *parent)
     addProperties<QtTsMessage>(m_properties);
 }
 
-ScriptRunner::~ScriptRunner() = default;
+ScriptRunner::~ScriptRunner()
+{
+    qDeleteAll(m_enginePool);
+}
 
 QVariant ScriptRunner::runScript(const QString &fileName, const std::function<void()> &endCallback)
 {
@@ -179,19 +237,54 @@ QVariant ScriptRunner::runScript(const QString &fileName, const std::function<vo
 
     QVariant result;
     if (fi.exists() && fi.isReadable()) {
+        Profiler::Scope profileScope("Script: " + fi.fileName());
+        static auto &runs = Utils::Metrics::counter("script.runs");
+        static auto &runTime = Utils::Metrics::histogram("script.run_time_us");
+        runs.add();
+        // Only the synchronous part of the script is measured, QML scripts may keep running afterward
+        Utils::Metrics::ScopedTimer timer(runTime);
         // TODO set the current project directory as the current path before running the script
 
+        const bool isJavascript = fi.suffix() == "js";
+
+        // Javascript scripts are run synchronously, so the engine can be reused for the next script.
+        // QML scripts may show a window or a dialog, and keep their engine until they are closed.
+        if (isJavascript && Settings::instance()->value<bool>(Settings::ScriptReuseEngines)) {
+            auto engine = takeEngine(fullName);
+            TextDocument::beginUndoGroup();
+            Project::instance()->beginBatch();
+            result = runJavascript(fullName, engine);
+            Project::instance()->endBatch();
+            releaseEngine(engine);
+            // Same order and timing as when the engine is deleted
+            QTimer::singleShot(0, this, [endCallback]() {
+                if (endCallback)
+                    endCallback();
+                TextDocument::endUndoGroup();
+            });
+            return result;
+        }
+
         // Run the script
         auto engine = getEngine(fullName);
         if (endCallback)
             connect(engine, &QObject::destroyed, this, endCallback);
 
-        if (fi.suffix() == "js") {
+        // All the edits done by the script are undone at once
+        TextDocument::beginUndoGroup();
+        connect(engine, &QObject::destroyed, this, &TextDocument::endUndoGroup);
+
+        // The documents opened by the script are only shown once it's run, QML scripts showing a dialog are not
+        // batched after that: the documents opened are shown while the user interacts with the dialog
+        Project::instance()->beginBatch();
+        if (isJavascript) {
             result = runJavascript(fullName, engine);
+            engine->deleteLater();
         } else {
             result = runQml(fullName, engine);
         }
-        // engine is deleted in runJavascript or runQml
+        Project::instance()->endBatch();
+        // engine is deleted here or in runQml
     } else {
         spdlog::error("File {} doesn't exist", fileName);
         return QVariant(ErrorCode);
@@ -231,6 +324,37 @@ QQmlEngine *ScriptRunner::getEngine(const QString &fileName)
     return engine;
 }
 
+// Returns an engine from the pool, set up for the script `fileName`, or a new one if the pool is empty.
+QQmlEngine *ScriptRunner::takeEngine(const QString &fileName)
+{
+    if (m_enginePool.isEmpty())
+        return getEngine(fileName);
+
+    const QFileInfo fi(fileName);
+    auto engine = m_enginePool.takeLast();
+    currentScriptPath = fi.absoluteFilePath();
+    engine->setProperty("scriptPath", fi.absolutePath());
+    engine->setProperty("scriptWindow", false);
+    // The Dir singleton is created once per engine, with the path of the first script
+    if (auto dir = engine->singletonInstance<Dir *>(m_dirTypeId))
+        dir->setCurrentScriptPath(fi.absolutePath());
+    return engine;
+}
+
+// Puts the engine back in the pool, after a script run.
+// The import paths, the Script module registrations and the singletons are kept, but the compiled scripts are
+// removed from the cache: a javascript file may have changed, and its global state must not leak to the next run.
+void ScriptRunner::releaseEngine(QQmlEngine *engine)
+{
+    if (m_enginePool.size() >= MaxPooledEngines) {
+        engine->deleteLater();
+        return;
+    }
+    engine->clearComponentCache();
+    engine->collectGarbage();
+    m_enginePool.push_back(engine);
+}
+
 QVariant ScriptRunner::runJavascript(const QString &fileName, QQmlEngine *engine)
 {
     const QString text =
@@ -238,17 +362,41 @@ QVariant ScriptRunner::runJavascript(const QString &fileName, QQmlEngine *engine
             "import QtQml 2.12\n"
             "import Script 1.0\n"
             "import \"%1\" as MyScript\n"
-            "QtObject { property var _scriptResult; Component.onCompleted : _scriptResult = MyScript.main() }")
+            "QtObject {\n"
+            "    property var _scriptResult\n"
+            "    property bool _scriptPending: false\n"
+            "    property string _scriptError\n"
+            "    Component.onCompleted: {\n"
+            "        let result = MyScript.main();\n"
+            "        if (!(result instanceof Promise)) {\n"
+            "            _scriptResult = result;\n"
+            "            return;\n"
+            "        }\n"
+            "        _scriptPending = true;\n"
+            "        result.then(value => _scriptResult = value, error => _scriptError = String(error) || \"Error\")\n"
+            "              .finally(() => _scriptPending = false);\n"
+            "    }\n"
+            "}")
             .arg(QUrl::fromLocalFile(fileName).toString());
 
     QQmlComponent component(engine);
     component.setData(text.toLatin1(), QUrl::fromLocalFile(fileName));
 
-    auto *result = qobject_cast<QObject *>(component.create());
-    engine->deleteLater();
+    std::unique_ptr<QObject> result(component.create());
     m_hasError = component.isError();
-    if (component.isReady() && !m_hasError)
+    if (component.isReady() && !m_hasError) {
+        // An async main function returns a promise, the script is done once it's settled.
+        // The promise reactions are run from posted events, so there's nothing to do until the next one.
+        while (result->property("_scriptPending").toBool())
+            QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents | QEventLoop::ExcludeUserInputEvents);
+        const auto error = result->property("_scriptError").toString();
+        if (!error.isEmpty()) {
+            spdlog::error("{}: {}", fileName, error);
+            m_hasError = true;
+            return QVariant(ErrorCode);
+        }
         return result->property("_scriptResult");
+    }
 
     filterErrors(component);
     return QVariant(ErrorCode);
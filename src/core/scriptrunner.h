@@ -44,6 +44,8 @@ public:
 
 private:
     QQmlEngine *getEngine(const QString &fileName);
+    QQmlEngine *takeEngine(const QString &fileName);
+    void releaseEngine(QQmlEngine *engine);
     QVariant runJavascript(const QString &fileName, QQmlEngine *engine);
     QVariant runQml(const QString &fileName, QQmlEngine *engine);
     void filterErrors(const QQmlComponent &component);
@@ -55,6 +57,10 @@ private:
     bool m_hasError = false;
     QList<QQmlError> m_errors;
 
+    // Idle engines, reused for the next javascript scripts if Settings::ScriptReuseEngines is set
+    QList<QQmlEngine *> m_enginePool;
+    inline static int m_dirTypeId = -1;
+
     inline static QSet<QString> m_properties = {};
 };
 
@@ -0,0 +1,254 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "scriptserver.h"
+#include "document.h"
+#include "knutcore.h"
+#include "project.h"
+#include "scriptmanager.h"
+#include "utils/log.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QTemporaryDir>
+#include <spdlog/sinks/base_sink.h>
+
+namespace Core {
+
+// Forwards the log messages to the server, it can be used from any thread (the logger may be asynchronous)
+class ScriptServerSink : public spdlog::sinks::base_sink<std::mutex>
+{
+public:
+    explicit ScriptServerSink(ScriptServer *server)
+        : m_server(server)
+    {
+    }
+
+protected:
+    void sink_it_(const spdlog::details::log_msg &msg) override
+    {
+        spdlog::memory_buf_t formatted;
+        formatter_->format(msg, formatted);
+        auto size = formatted.size();
+        while (size > 0 && (formatted[size - 1] == '\n' || formatted[size - 1] == '\r'))
+            --size;
+
+        const auto level = spdlog::level::to_string_view(msg.level);
+        QMetaObject::invokeMethod(
+            m_server,
+            [server = m_server, level = std::string(level.data(), level.size()),
+             text = std::string(formatted.data(), size)]() {
+                server->sendLog(level, text);
+            },
+            Qt::QueuedConnection);
+    }
+    void flush_() override { }
+
+private:
+    ScriptServer *const m_server;
+};
+
+ScriptServer::ScriptServer(QObject *parent)
+    : QObject(parent)
+    , m_server(new QLocalServer(this))
+    , m_sink(std::make_shared<ScriptServerSink>(this))
+{
+    connect(m_server, &QLocalServer::newConnection, this, &ScriptServer::addConnection);
+    // Queued, so the logs of the script are sent before its result
+    connect(ScriptManager::instance(), &ScriptManager::scriptFinished, this, &ScriptServer::finishJob,
+            Qt::QueuedConnection);
+    connect(Project::instance(), &Project::documentsChanged, this, &ScriptServer::watchDocuments);
+    watchDocuments();
+    KnutCore::addLogSink(m_sink);
+}
+
+ScriptServer::~ScriptServer()
+{
+    KnutCore::removeLogSink(m_sink);
+}
+
+bool ScriptServer::listen(const QString &name)
+{
+    // A previous server may have crashed without removing its socket
+    QLocalServer::removeServer(name);
+    if (!m_server->listen(name)) {
+        spdlog::error("ScriptServer::listen - can't listen on {}: {}", name, m_server->errorString());
+        return false;
+    }
+    spdlog::info("ScriptServer::listen - waiting for scripts on {}", m_server->fullServerName());
+    return true;
+}
+
+void ScriptServer::addConnection()
+{
+    while (auto socket = m_server->nextPendingConnection()) {
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket]() {
+            readJobs(socket);
+        });
+        connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+    }
+}
+
+void ScriptServer::readJobs(QLocalSocket *socket)
+{
+    while (socket->canReadLine()) {
+        const auto line = socket->readLine().trimmed();
+        if (line.isEmpty())
+            continue;
+
+        const auto message = nlohmann::json::parse(line.constData(), nullptr, false);
+        if (message.is_discarded() || !message.is_object() || !message.contains("script")
+            || !message["script"].is_string()) {
+            send(socket, {{"error", "invalid job, expecting {\"script\": <file>}"}});
+            continue;
+        }
+
+        Job job {socket, message.value("id", nlohmann::json()),
+                 QString::fromStdString(message["script"].get<std::string>())};
+        if (message.contains("input") && message["input"].is_string())
+            job.input = QString::fromStdString(message["input"].get<std::string>());
+        if (message.contains("source") && message["source"].is_string())
+            job.source = QByteArray::fromStdString(message["source"].get<std::string>());
+        job.returnFiles = message.contains("returnFiles") && message["returnFiles"].is_boolean()
+            && message["returnFiles"].get<bool>();
+        job.returnPatch = message.contains("returnPatch") && message["returnPatch"].is_boolean()
+            && message["returnPatch"].get<bool>();
+        m_jobs.push_back(std::move(job));
+    }
+    startNext();
+}
+
+void ScriptServer::startNext()
+{
+    if (m_currentJob || m_jobs.empty())
+        return;
+
+    m_currentJob = std::move(m_jobs.front());
+    m_jobs.pop_front();
+
+    if (!m_currentJob->socket) {
+        // The client is gone, nobody wants the result
+        m_currentJob.reset();
+        startNext();
+        return;
+    }
+
+    QString script = m_currentJob->script;
+    if (!m_currentJob->source.isEmpty()) {
+        script = writeScript(script, m_currentJob->source);
+        if (script.isEmpty()) {
+            send(m_currentJob->socket, {{"id", m_currentJob->id}, {"error", "can't write the script"}});
+            m_currentJob.reset();
+            startNext();
+            return;
+        }
+    }
+
+    const QFileInfo fi(script);
+    if (!fi.exists()) {
+        send(m_currentJob->socket, {{"id", m_currentJob->id}, {"error", "script not found"}});
+        m_currentJob.reset();
+        startNext();
+        return;
+    }
+
+    if (m_currentJob->returnPatch) {
+        m_currentJob->patchOutput = Project::instance()->hasPatchOutput();
+        Project::instance()->setPatchOutput(true);
+    }
+    if (!m_currentJob->input.isEmpty())
+        Project::instance()->open(m_currentJob->input);
+    ScriptManager::instance()->runScript(fi.absoluteFilePath());
+}
+
+// Writes a script sent by the client in a temporary directory, keeping its file name so its type is the same.
+// Returns the path of the script, or an empty string on error.
+QString ScriptServer::writeScript(const QString &fileName, const QByteArray &source)
+{
+    if (!m_scriptDir)
+        m_scriptDir = std::make_unique<QTemporaryDir>();
+    const QString path = m_scriptDir->filePath(QFileInfo(fileName).fileName());
+    QFile file(path);
+    if (!m_scriptDir->isValid() || !file.open(QIODevice::WriteOnly | QIODevice::Truncate)
+        || file.write(source) != source.size()) {
+        spdlog::error("ScriptServer::writeScript - can't write {}: {}", path, file.errorString());
+        return {};
+    }
+    return path;
+}
+
+void ScriptServer::watchDocuments()
+{
+    for (auto document : Project::instance()->documents())
+        connect(document, &Document::saved, this, &ScriptServer::recordSave, Qt::UniqueConnection);
+}
+
+void ScriptServer::recordSave()
+{
+    auto document = qobject_cast<Document *>(sender());
+    if (!m_currentJob || !document)
+        return;
+    const QString fileName = QDir(Project::instance()->root()).relativeFilePath(document->fileName());
+    if (!fileName.startsWith("..") && !m_currentJob->savedFiles.contains(fileName))
+        m_currentJob->savedFiles.push_back(fileName);
+}
+
+void ScriptServer::finishJob(const QVariant &result)
+{
+    // The script may have been started by something else than the server
+    if (!m_currentJob)
+        return;
+
+    if (m_currentJob->socket) {
+        nlohmann::json message {{"id", m_currentJob->id}, {"exitCode", result.toInt()}};
+        auto &saved = message["saved"] = nlohmann::json::array();
+        for (const auto &fileName : std::as_const(m_currentJob->savedFiles))
+            saved.push_back(fileName.toStdString());
+        if (m_currentJob->returnPatch) {
+            // The patches are sent to the client, and not kept in the project
+            auto &patches = message["patches"] = nlohmann::json::object();
+            for (const auto &fileName : std::as_const(m_currentJob->savedFiles)) {
+                const auto patch = Project::instance()->takeFilePatch(fileName);
+                if (!patch.isEmpty())
+                    patches[fileName.toStdString()] = patch.toStdString();
+            }
+        } else if (m_currentJob->returnFiles) {
+            auto &files = message["files"] = nlohmann::json::object();
+            const QDir root(Project::instance()->root());
+            for (const auto &fileName : std::as_const(m_currentJob->savedFiles)) {
+                QFile file(root.filePath(fileName));
+                if (file.open(QIODevice::ReadOnly))
+                    files[fileName.toStdString()] = file.readAll().toBase64().toStdString();
+            }
+        }
+        send(m_currentJob->socket, message);
+    }
+    if (m_currentJob->returnPatch)
+        Project::instance()->setPatchOutput(m_currentJob->patchOutput);
+    m_currentJob.reset();
+    startNext();
+}
+
+void ScriptServer::sendLog(const std::string &level, const std::string &text)
+{
+    if (m_currentJob && m_currentJob->socket)
+        send(m_currentJob->socket, {{"id", m_currentJob->id}, {"level", level}, {"log", text}});
+}
+
+void ScriptServer::send(QLocalSocket *socket, const nlohmann::json &message)
+{
+    socket->write(message.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace).c_str());
+    socket->write("\n");
+}
+
+} // namespace Core
@@ -0,0 +1,92 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QObject>
+#include <QPointer>
+#include <QStringList>
+#include <deque>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <optional>
+
+class QLocalServer;
+class QLocalSocket;
+class QTemporaryDir;
+
+namespace Core {
+
+class ScriptServerSink;
+
+/**
+ * \brief Runs the scripts submitted on a local socket, in the same Knut process
+ *
+ * The project, documents, parsed trees and caches are kept between scripts, so only the first one pays for
+ * the initialization. The protocol is line based, each line being a JSON object:
+ * - the client sends a job `{"id": 1, "script": "script.js", "input": "file.cpp"}`, `id` and `input` are optional;
+ * - while the script runs, the server sends its logs as `{"id": 1, "log": "...", "level": "info"}`;
+ * - once it's done, the server sends `{"id": 1, "exitCode": 0, "saved": ["file.cpp"]}`, with the files saved by the
+ *   script relative to the project root, or `{"id": 1, "error": "..."}` if it can't run.
+ *
+ * A job can also contain the `source` of the script, if the script isn't available on the server, and ask for the
+ * content of the saved files with `"returnFiles": true`: they are then sent base64 encoded in `files`. With
+ * `"returnPatch": true`, the saved files are not written and their changes are sent as git patches in `patches`.
+ *
+ * The jobs are run one after the other, in the order they are received.
+ */
+class ScriptServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ScriptServer(QObject *parent = nullptr);
+    ~ScriptServer() override;
+
+    bool listen(const QString &name);
+
+private:
+    friend ScriptServerSink;
+
+    struct Job
+    {
+        QPointer<QLocalSocket> socket;
+        nlohmann::json id;
+        QString script;
+        QString input;
+        QByteArray source;
+        bool returnFiles = false;
+        bool returnPatch = false;
+        // Patch output of the project before the job, restored after it with returnPatch
+        bool patchOutput = false;
+        // Files saved while running the script, relative to the project root
+        QStringList savedFiles;
+    };
+
+    void addConnection();
+    void readJobs(QLocalSocket *socket);
+    void startNext();
+    QString writeScript(const QString &fileName, const QByteArray &source);
+    void watchDocuments();
+    void recordSave();
+    void finishJob(const QVariant &result);
+    void sendLog(const std::string &level, const std::string &text);
+    static void send(QLocalSocket *socket, const nlohmann::json &message);
+
+    QLocalServer *const m_server;
+    std::shared_ptr<ScriptServerSink> m_sink;
+    std::deque<Job> m_jobs;
+    // The job being run, if any
+    std::optional<Job> m_currentJob;
+    // Scripts sent with their source
+    std::unique_ptr<QTemporaryDir> m_scriptDir;
+};
+
+} // namespace Core
@@ -16,7 +16,7 @@
 #include <QDir>
 #include <QFile>
 #include <QStandardPaths>
-#include <QTextStream>
+#include <algorithm>
 #include <optional>
 
 static std::optional<nlohmann::json> loadSettings(const QString &name, bool log = true)
@@ -76,8 +76,11 @@ Settings::Settings(Mode mode, QObject *parent)
     m_instance = this;
 
     loadKnutSettings();
-    if (!isTesting()) // Only load if not testing
+    if (!isTesting()) { // Only load and watch if not testing
+        m_watcher = new QFileSystemWatcher(this);
+        connect(m_watcher, &QFileSystemWatcher::fileChanged, this, &Settings::reloadFile);
         loadUserSettings();
+    }
 
     m_saveTimer->callOnTimeout(this, &Settings::saveSettings);
     m_saveTimer->setSingleShot(true);
@@ -96,10 +99,12 @@ Settings *Settings::instance()
 
 void Settings::loadUserSettings()
 {
+    watchFile(userFilePath());
     auto userSettings = loadSettings(userFilePath());
     if (userSettings) {
         m_userSettings = userSettings.value();
         m_settings.merge_patch(m_userSettings);
+        clearCache();
         emit settingsLoaded();
     }
 }
@@ -107,14 +112,61 @@ void Settings::loadUserSettings()
 void Settings::loadProjectSettings(const QString &rootDir)
 {
     m_projectPath = rootDir;
+    watchFile(projectFilePath());
     auto projectSettings = loadSettings(projectFilePath());
     if (projectSettings) {
         m_projectSettings = projectSettings.value();
         m_settings.merge_patch(m_projectSettings);
+        clearCache();
         emit settingsLoaded();
     }
 }
 
+void Settings::watchFile(const QString &filePath)
+{
+    if (!m_watcher || !QFile::exists(filePath))
+        return;
+    QFile file(filePath);
+    if (file.open(QIODevice::ReadOnly))
+        m_fileContents[filePath] = file.readAll();
+    if (!m_watcher->files().contains(filePath))
+        m_watcher->addPath(filePath);
+}
+
+// Called when a settings file is changed on disk: all settings are merged again, like on startup
+void Settings::reloadFile(const QString &filePath)
+{
+    // Editors often save by replacing the file, which removes it from the watcher
+    if (QFile::exists(filePath) && !m_watcher->files().contains(filePath))
+        m_watcher->addPath(filePath);
+
+    QFile file(filePath);
+    const QByteArray data = file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+    if (data == m_fileContents.value(filePath))
+        return;
+    m_fileContents[filePath] = data;
+
+    auto settings = data.isEmpty() ? nlohmann::json::object() : nlohmann::json::parse(data.constData(), nullptr, false);
+    if (settings.is_discarded() || !settings.is_object()) {
+        spdlog::error("Settings::reloadFile {} - invalid settings, they are not changed", filePath);
+        return;
+    }
+
+    spdlog::info("Settings::reloadFile {}", filePath);
+    if (!isUser() && filePath == projectFilePath())
+        m_projectSettings = std::move(settings);
+    else
+        m_userSettings = std::move(settings);
+
+    loadKnutSettings();
+    if (m_userSettings.is_object())
+        m_settings.merge_patch(m_userSettings);
+    if (m_projectSettings.is_object())
+        m_settings.merge_patch(m_projectSettings);
+    clearCache();
+    emit settingsLoaded();
+}
+
 /*!
  * \qmlmethod bool Settings::hasValue(string path)
  * Returns true if the project settings has a settings `path`.
@@ -138,40 +190,51 @@ QVariant Settings::value(QString path, const QVariant &defaultValue) const
         LOG("Settings::value", path, defaultValue);
     else
         LOG("Settings::value", path);
-    try {
-        if (!path.startsWith('/'))
-            path.prepend('/');
 
-        // Special cases
-        if (path == RcAssetColors || path == RcAssetFlags || path == RcDialogFlags) {
-            return static_cast<int>(value<RcDocument::ConversionFlags>(path.toStdString()));
-        }
+    if (!path.startsWith('/'))
+        path.prepend('/');
 
-        auto val = m_settings.at(nlohmann::json::json_pointer(path.toStdString()));
-        if (val.is_number_unsigned())
-            return val.get<unsigned int>();
-        if (val.is_number_integer())
-            return val.get<int>();
-        else if (val.is_number_float())
-            return val.get<float>();
-        else if (val.is_boolean())
-            return val.get<bool>();
-        else if (val.is_string())
-            return val.get<QString>();
-        else if (val.is_array()) {
-            // Only support QStringList for now
-            if (!val.empty()) {
-                if (val[0].is_string())
-                    return val.get<QStringList>();
-            } else {
-                return QStringList();
-            }
-        }
-        spdlog::error("Settings::value {} - can't convert", path);
-    } catch (...) {
+    // Special cases
+    if (path == RcAssetColors || path == RcAssetFlags || path == RcDialogFlags) {
+        return static_cast<int>(value<RcDocument::ConversionFlags>(path.toStdString()));
+    }
+
+    QMutexLocker locker(&m_cacheMutex);
+    if (auto it = m_variantCache.constFind(path); it != m_variantCache.cend())
+        return *it;
+
+    const auto pointer = nlohmann::json::json_pointer(path.toStdString());
+    if (!m_settings.contains(pointer)) {
         spdlog::info("Settings::value {} - accessing non-existing value", path);
+        return defaultValue;
+    }
+
+    const auto &val = m_settings.at(pointer);
+    QVariant result;
+    if (val.is_number_unsigned())
+        result = val.get<unsigned int>();
+    else if (val.is_number_integer())
+        result = val.get<int>();
+    else if (val.is_number_float())
+        result = val.get<float>();
+    else if (val.is_boolean())
+        result = val.get<bool>();
+    else if (val.is_string())
+        result = val.get<QString>();
+    else if (val.is_array() && val.empty())
+        result = QStringList();
+    // Only support QStringList for now
+    else if (val.is_array() && std::ranges::all_of(val, [](const auto &item) {
+                 return item.is_string();
+             }))
+        result = val.get<QStringList>();
+
+    if (!result.isValid()) {
+        spdlog::error("Settings::value {} - can't convert", path);
+        return defaultValue;
     }
-    return defaultValue;
+    m_variantCache.insert(path, result);
+    return result;
 }
 
 /*!
@@ -223,6 +286,7 @@ bool Settings::setValue(QString path, const QVariant &value)
         return false;
     }
 
+    clearCache();
     emit settingsChanged(path);
     // Asynchronous save
     m_saveTimer->start();
@@ -281,8 +345,14 @@ void Settings::saveSettings()
         return;
     }
 
-    QTextStream stream(&file);
-    stream << QString::fromStdString(settings.dump(4, ' ', false));
+    const QByteArray data = QByteArray::fromStdString(settings.dump(4, ' ', false));
+    file.write(data);
+    file.close();
+    if (m_watcher) {
+        m_fileContents[filePath] = data;
+        if (!m_watcher->files().contains(filePath))
+            m_watcher->addPath(filePath);
+    }
     emit settingsSaved();
 }
 
@@ -327,7 +397,16 @@ void Settings::updatePaths(const QString &path, const std::string &json_path, bo
     }
     settings[nlohmann::json::json_pointer(json_path)] = paths;
     m_settings[nlohmann::json::json_pointer(json_path)] = globalPaths;
+    clearCache();
     saveSettings();
 }
 
+void Settings::clearCache()
+{
+    QMutexLocker locker(&m_cacheMutex);
+    m_valueCache.clear();
+    m_variantCache.clear();
+    ++m_revision;
+}
+
 } // namespace Core
@@ -14,10 +14,17 @@
 #include "utils/json.h"
 #include "utils/log.h"
 
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QMutex>
 #include <QObject>
 #include <QStringList>
 #include <QTimer>
 #include <QVariant>
+#include <any>
+#include <atomic>
+#include <memory>
+#include <unordered_map>
 
 namespace Core {
 
@@ -32,6 +39,12 @@ namespace Core {
  * Settings are read in this order, and new settings are replacing old one if it's the same path.
  *
  * Access to settings is using json pointer: https://tools.ietf.org/html/rfc6901
+ *
+ * The values are cached once converted, so reading a setting again doesn't walk the json tree. The cache is cleared
+ * each time the settings are loaded or changed, and the revision is incremented: code deriving data from the settings
+ * can use it to know when to compute it again.
+ *
+ * The user and project settings files are watched outside of tests, and loaded again when changed by another program.
  */
 class Settings : public QObject
 {
@@ -41,17 +54,42 @@ class Settings : public QObject
 public:
     static inline constexpr char EnableLSP[] = "/lsp/enabled";
     static inline constexpr char MimeTypes[] = "/mime_types";
+    static inline constexpr char MaxLoadedDocuments[] = "/project/max_loaded_documents";
+    static inline constexpr char ReadAhead[] = "/project/read_ahead";
+    static inline constexpr char ProjectExcludes[] = "/project/excludes";
+    static inline constexpr char ProjectUseGitIgnore[] = "/project/use_gitignore";
     static inline constexpr char LspServers[] = "/lsp/servers";
+    static inline constexpr char LspRequestTimeout[] = "/lsp/request_timeout";
+    static inline constexpr char LspIndexingTimeout[] = "/lsp/indexing_timeout";
+    static inline constexpr char LspPrefetchWindow[] = "/lsp/prefetch_window";
     static inline constexpr char RcDialogFlags[] = "/rc/dialog_flags";
     static inline constexpr char RcDialogScaleX[] = "/rc/dialog_scalex";
     static inline constexpr char RcDialogScaleY[] = "/rc/dialog_scaley";
     static inline constexpr char RcAssetFlags[] = "/rc/asset_flags";
     static inline constexpr char RcAssetColors[] = "/rc/asset_transparent_colors";
     static inline constexpr char RcLanguageMap[] = "/rc/language_map";
+    static inline constexpr char RcLazyLoading[] = "/rc/lazy_loading";
+    static inline constexpr char RcIncrementalConversion[] = "/rc/incremental_conversion";
     static inline constexpr char SaveLogsToFile[] = "/logs/saveToFile";
+    static inline constexpr char LogApiCalls[] = "/logs/api_calls";
+    static inline constexpr char LogHistoryCapacity[] = "/logs/history_capacity";
+    static inline constexpr char LogAsync[] = "/logs/async";
+    static inline constexpr char LogAsyncQueueSize[] = "/logs/async_queue_size";
+    static inline constexpr char LogAsyncOverflow[] = "/logs/async_overflow";
+    static inline constexpr char LogFlushInterval[] = "/logs/flush_interval";
+    static inline constexpr char SymbolCache[] = "/cache/symbols";
+    static inline constexpr char SymbolIndexCache[] = "/cache/symbol_index";
+    static inline constexpr char ScriptCache[] = "/cache/script";
     static inline constexpr char ScriptPaths[] = "/script_paths";
+    static inline constexpr char ScriptReuseEngines[] = "/script/reuse_engines";
+    static inline constexpr char ScriptCachePath[] = "/script/cache_path";
     static inline constexpr char Tab[] = "/text_editor/tab";
+    static inline constexpr char UndoInCli[] = "/text_editor/undo_in_cli";
+    static inline constexpr char LargeFileSize[] = "/text_editor/large_file/size";
+    static inline constexpr char LargeFileLines[] = "/text_editor/large_file/lines";
     static inline constexpr char ToggleSection[] = "/toggle_section";
+    static inline constexpr char TreeSitterParseTimeout[] = "/treesitter/parse_timeout";
+    static inline constexpr char TreeSitterQueryMatchLimit[] = "/treesitter/query_match_limit";
 
 public:
     ~Settings() override;
@@ -65,19 +103,45 @@ public:
 
     [[nodiscard]] std::string dumpJson() const;
 
+    // Returns the converted value, shared by all callers until the settings change, or nullptr in case of error
     template <typename T>
-    T value(std::string path) const
+    std::shared_ptr<const T> valuePtr(std::string path) const
     {
         if (!path.starts_with('/'))
             path = '/' + path;
+
+        QMutexLocker locker(&m_cacheMutex);
+        if (auto it = m_valueCache.find(path); it != m_valueCache.end()) {
+            if (const auto cached = std::any_cast<std::shared_ptr<const T>>(&it->second))
+                return *cached;
+        }
+
+        const auto pointer = nlohmann::json::json_pointer(path);
+        if (!m_settings.contains(pointer)) {
+            spdlog::error("Settings::value {} - error reading", path);
+            return {};
+        }
         try {
-            return m_settings.at(nlohmann::json::json_pointer(path)).get<T>();
+            auto result = std::make_shared<const T>(m_settings.at(pointer).get<T>());
+            m_valueCache[path] = result;
+            return result;
         } catch (...) {
-            spdlog::error("Settings::value {} - error reading", path);
+            spdlog::error("Settings::value {} - can't convert", path);
         }
         return {};
     }
 
+    template <typename T>
+    T value(std::string path) const
+    {
+        if (const auto result = valuePtr<T>(std::move(path)))
+            return *result;
+        return {};
+    }
+
+    // Incremented each time the settings are loaded or changed
+    int revision() const { return m_revision; }
+
     template <typename T>
     bool setValue(std::string path, const T &value)
     {
@@ -90,6 +154,7 @@ public:
                 m_userSettings[pointer] = value;
             else
                 m_projectSettings[pointer] = value;
+            clearCache();
             emit settingsChanged(QString::fromStdString(path));
         } catch (...) {
             spdlog::error("Settings::setValue {} - error saving", path);
@@ -131,9 +196,12 @@ private:
 
     void loadKnutSettings();
     void loadUserSettings();
+    void watchFile(const QString &filePath);
+    void reloadFile(const QString &filePath);
     void updatePaths(const QString &path, const std::string &json_path, bool add);
     void saveSettings();
     bool isUser() const;
+    void clearCache();
 
     inline static Settings *m_instance = nullptr;
 
@@ -143,6 +211,16 @@ private:
     QString m_projectPath;
     QTimer *m_saveTimer = nullptr;
     Mode m_mode = Mode::Test;
+
+    QFileSystemWatcher *m_watcher = nullptr;
+    // Content of the settings files when last read or written, to ignore the changes done by Knut itself
+    QHash<QString, QByteArray> m_fileContents;
+    std::atomic<int> m_revision = 0;
+
+    // Converted values, by path
+    mutable QMutex m_cacheMutex;
+    mutable std::unordered_map<std::string, std::any> m_valueCache;
+    mutable QHash<QString, QVariant> m_variantCache;
 };
 
 } // namespace Core
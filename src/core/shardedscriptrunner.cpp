@@ -0,0 +1,325 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "shardedscriptrunner.h"
+#include "project.h"
+#include "utils/log.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QLocalSocket>
+#include <algorithm>
+#include <iostream>
+
+namespace Core {
+
+// Number of shards per node when the shard size is automatic: enough to balance the load between nodes, few enough
+// to limit the work lost when a node fails
+constexpr int ShardsPerNode = 8;
+
+ShardedScriptRunner::ShardedScriptRunner(QObject *parent)
+    : QObject(parent)
+{
+}
+
+ShardedScriptRunner::~ShardedScriptRunner() = default;
+
+void ShardedScriptRunner::setNodes(const QStringList &nodes)
+{
+    m_nodeNames = nodes;
+    m_nodeNames.removeAll(QString());
+}
+
+void ShardedScriptRunner::setShardSize(int size)
+{
+    m_shardSize = std::max(0, size);
+}
+
+void ShardedScriptRunner::run(const QString &script, const QStringList &files)
+{
+    m_files = files;
+    m_exitCode = 0;
+    m_remaining = static_cast<int>(files.size());
+    m_failedFiles.clear();
+    m_savedFiles.clear();
+    m_shards.clear();
+
+    QFile file(script);
+    if (!file.open(QIODevice::ReadOnly)) {
+        spdlog::error("ShardedScriptRunner::run - can't read {}: {}", script, file.errorString());
+        emit finished(1);
+        return;
+    }
+    m_scriptName = QFileInfo(script).fileName();
+    m_source = file.readAll();
+
+    if (m_nodeNames.isEmpty()) {
+        spdlog::error("ShardedScriptRunner::run - no nodes to run {}", script);
+        emit finished(1);
+        return;
+    }
+    if (m_files.isEmpty()) {
+        spdlog::warn("ShardedScriptRunner::run - no files to process with {}", script);
+        emit finished(0);
+        return;
+    }
+
+    const int nodeCount = static_cast<int>(m_nodeNames.size());
+    const int fileCount = static_cast<int>(m_files.size());
+    const int shardSize = m_shardSize > 0 ? m_shardSize : std::max(1, fileCount / (nodeCount * ShardsPerNode));
+    for (int first = 0; first < fileCount; first += shardSize) {
+        Shard shard;
+        for (int i = first; i < std::min(first + shardSize, fileCount); ++i)
+            shard.files.push_back(i);
+        m_shards.push_back(std::move(shard));
+    }
+
+    spdlog::info("ShardedScriptRunner::run - running {} on {} files, in {} shards on {} nodes", script, fileCount,
+                 m_shards.size(), nodeCount);
+    m_nodes.clear();
+    m_nodes.resize(nodeCount);
+    for (int i = 0; i < nodeCount; ++i) {
+        m_nodes[i].name = m_nodeNames.at(i);
+        connectNode(i);
+    }
+}
+
+void ShardedScriptRunner::connectNode(int index)
+{
+    auto socket = new QLocalSocket(this);
+    m_nodes[index].socket = socket;
+    connect(socket, &QLocalSocket::connected, this, [this, index]() {
+        m_nodes[index].connected = true;
+        spdlog::info("ShardedScriptRunner - connected to node {}", m_nodes[index].name);
+        sendShards();
+    });
+    connect(socket, &QLocalSocket::readyRead, this, [this, index]() {
+        readResponses(index);
+    });
+    connect(socket, &QLocalSocket::errorOccurred, this, [this, index, socket]() {
+        loseNode(index, socket->errorString());
+    });
+    connect(socket, &QLocalSocket::disconnected, this, [this, index]() {
+        loseNode(index, "disconnected");
+    });
+    socket->connectToServer(m_nodes[index].name);
+}
+
+void ShardedScriptRunner::loseNode(int index, const QString &reason)
+{
+    auto &node = m_nodes[index];
+    if (node.lost)
+        return;
+    node.lost = true;
+    node.socket->deleteLater();
+
+    if (node.shard) {
+        // Retry the unfinished files on another node, before the other shards as they are late already
+        Shard retry {{}, node.shard->failedNodes};
+        retry.failedNodes.insert(index);
+        for (int file : std::as_const(node.shard->files)) {
+            if (node.pendingFiles.contains(file))
+                retry.files.push_back(file);
+        }
+        spdlog::warn("ShardedScriptRunner - node {} failed ({}), retrying {} files on another node", node.name,
+                     reason, retry.files.size());
+        m_shards.push_front(std::move(retry));
+        node.shard.reset();
+        node.pendingFiles.clear();
+    } else {
+        spdlog::warn("ShardedScriptRunner - node {} failed ({})", node.name, reason);
+    }
+
+    sendShards();
+    checkFinished();
+}
+
+void ShardedScriptRunner::sendShards()
+{
+    for (int index = 0; index < m_nodes.size(); ++index) {
+        auto &node = m_nodes[index];
+        if (!node.connected || node.lost || node.shard)
+            continue;
+        auto it = std::ranges::find_if(m_shards, [index](const Shard &shard) {
+            return !shard.failedNodes.contains(index);
+        });
+        if (it == m_shards.end())
+            continue;
+
+        node.shard = std::move(*it);
+        m_shards.erase(it);
+        // All the jobs of the shard are sent at once, the server runs them one after the other
+        for (int file : std::as_const(node.shard->files)) {
+            node.pendingFiles.insert(file);
+            // With the patch output, only the changes are sent back
+            const bool patchOutput = Project::instance()->hasPatchOutput();
+            const nlohmann::json job {{"id", file},
+                                      {"script", m_scriptName.toStdString()},
+                                      {"source", m_source.toStdString()},
+                                      {"input", m_files.at(file).toStdString()},
+                                      {patchOutput ? "returnPatch" : "returnFiles", true}};
+            node.socket->write(job.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace).c_str());
+            node.socket->write("\n");
+        }
+    }
+}
+
+void ShardedScriptRunner::readResponses(int index)
+{
+    auto &node = m_nodes[index];
+    node.buffer += node.socket->readAll();
+    qsizetype start = 0;
+    for (auto end = node.buffer.indexOf('\n'); end >= 0; end = node.buffer.indexOf('\n', start)) {
+        const QByteArray line = node.buffer.mid(start, end - start).trimmed();
+        start = end + 1;
+        if (line.isEmpty())
+            continue;
+        const auto response = nlohmann::json::parse(line.constData(), nullptr, false);
+        if (response.is_object())
+            handleResponse(index, response);
+        else
+            spdlog::warn("ShardedScriptRunner - invalid response from node {}", node.name);
+    }
+    m_nodes[index].buffer.remove(0, start);
+}
+
+void ShardedScriptRunner::handleResponse(int index, const nlohmann::json &response)
+{
+    if (!response.contains("id") || !response["id"].is_number_integer())
+        return;
+    const int file = response["id"].get<int>();
+    if (file < 0 || file >= m_files.size() || !m_nodes[index].pendingFiles.contains(file))
+        return;
+
+    const std::string prefix = "[" + m_files.at(file).toStdString() + "] ";
+    if (response.contains("log")) {
+        std::cout << prefix << response.value("log", "") << '\n';
+        std::cout.flush();
+        return;
+    }
+
+    if (response.contains("error")) {
+        spdlog::error("ShardedScriptRunner - node {} can't run the script on {}: {}", m_nodes[index].name,
+                      m_files.at(file), response.value("error", ""));
+        finishFile(index, file, 1);
+        return;
+    }
+
+    if (response.contains("exitCode")) {
+        if (response.contains("files") && response["files"].is_object())
+            writeFiles(response["files"]);
+        if (response.contains("patches") && response["patches"].is_object())
+            addPatches(response["patches"]);
+        finishFile(index, file, response["exitCode"].is_number_integer() ? response["exitCode"].get<int>() : 1);
+    }
+}
+
+void ShardedScriptRunner::finishFile(int index, int file, int exitCode)
+{
+    auto &node = m_nodes[index];
+    node.pendingFiles.remove(file);
+    --m_remaining;
+
+    if (exitCode != 0) {
+        spdlog::error("ShardedScriptRunner - {} failed on {} (node {}): exit code {}", m_scriptName, m_files.at(file),
+                      node.name, exitCode);
+        m_failedFiles.push_back(m_files.at(file));
+        if (m_exitCode == 0)
+            m_exitCode = exitCode;
+    }
+
+    if (node.pendingFiles.isEmpty()) {
+        node.shard.reset();
+        sendShards();
+    }
+    checkFinished();
+}
+
+// Writes the files saved on a node in the local project, unless they are the same (the nodes may share the disk)
+void ShardedScriptRunner::writeFiles(const nlohmann::json &files)
+{
+    const QDir root(Project::instance()->root());
+    for (const auto &[name, content] : files.items()) {
+        const QString fileName = QString::fromStdString(name);
+        if (!content.is_string() || QDir::isAbsolutePath(fileName) || fileName.startsWith("..")) {
+            spdlog::warn("ShardedScriptRunner - ignoring saved file {}", fileName);
+            continue;
+        }
+        if (!m_savedFiles.contains(fileName))
+            m_savedFiles.push_back(fileName);
+
+        const auto data = QByteArray::fromBase64(QByteArray::fromStdString(content.get<std::string>()));
+        QFile file(root.filePath(fileName));
+        if (file.open(QIODevice::ReadOnly) && file.readAll() == data)
+            continue;
+        file.close();
+        QDir().mkpath(QFileInfo(file).absolutePath());
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(data) != data.size())
+            spdlog::error("ShardedScriptRunner - can't write {}: {}", fileName, file.errorString());
+    }
+}
+
+void ShardedScriptRunner::addPatches(const nlohmann::json &patches)
+{
+    for (const auto &[name, patch] : patches.items()) {
+        const QString fileName = QString::fromStdString(name);
+        if (!patch.is_string())
+            continue;
+        if (!m_savedFiles.contains(fileName))
+            m_savedFiles.push_back(fileName);
+        Project::instance()->setFilePatch(fileName, QString::fromStdString(patch.get<std::string>()));
+    }
+}
+
+void ShardedScriptRunner::checkFinished()
+{
+    // Shards which can't run anywhere anymore: all the nodes left already failed on them
+    for (auto it = m_shards.begin(); it != m_shards.end();) {
+        bool canRun = false;
+        for (int index = 0; index < m_nodes.size() && !canRun; ++index)
+            canRun = !m_nodes[index].lost && !it->failedNodes.contains(index);
+        if (canRun) {
+            ++it;
+            continue;
+        }
+        for (int file : std::as_const(it->files)) {
+            spdlog::error("ShardedScriptRunner - no node left to run {} on {}", m_scriptName, m_files.at(file));
+            m_failedFiles.push_back(m_files.at(file));
+            --m_remaining;
+        }
+        if (m_exitCode == 0)
+            m_exitCode = 1;
+        it = m_shards.erase(it);
+    }
+
+    if (m_remaining > 0)
+        return;
+
+    for (auto &node : m_nodes) {
+        if (!node.lost) {
+            node.lost = true;
+            node.socket->disconnect(this);
+            node.socket->deleteLater();
+        }
+    }
+
+    const auto processed = m_files.size() - m_failedFiles.size();
+    if (m_failedFiles.isEmpty()) {
+        spdlog::info("ShardedScriptRunner - {} files processed, {} files saved", processed, m_savedFiles.size());
+    } else {
+        m_failedFiles.sort();
+        spdlog::error("ShardedScriptRunner - {} files processed, {} failed: {}", processed, m_failedFiles.size(),
+                      m_failedFiles.join(", "));
+    }
+    emit finished(m_exitCode);
+}
+
+} // namespace Core
@@ -0,0 +1,106 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+#include <deque>
+#include <nlohmann/json.hpp>
+#include <optional>
+
+class QLocalSocket;
+
+namespace Core {
+
+/**
+ * \brief Runs one script on many files, sharded across several script servers
+ *
+ * Each node is a Knut script server (`knut-cli --serve <name> <project>`), possibly on another machine with its own
+ * checkout of the project, its local socket being forwarded (for example `ssh -L /tmp/node1:/tmp/knut-jobs host`).
+ * The files are split in shards: each node runs one shard at a time, and gets the next one once it's done.
+ *
+ * The source of the script is sent with the jobs, and the files saved by the script are sent back and written in the
+ * local project, or only their patches with the patch output (see Project::setPatchOutput). If a node fails (its
+ * connection is lost), the unfinished files of its shard are retried on another node. A file on which the script
+ * fails is not retried, the failure comes from the script.
+ */
+class ShardedScriptRunner : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ShardedScriptRunner(QObject *parent = nullptr);
+    ~ShardedScriptRunner() override;
+
+    // Names of the local sockets of the script servers
+    void setNodes(const QStringList &nodes);
+    // Number of files per shard, 0 to split the files in a few shards per node
+    void setShardSize(int size);
+
+    // Runs `script` on all `files`, the files are relative to the project root
+    void run(const QString &script, const QStringList &files);
+
+    QStringList failedFiles() const { return m_failedFiles; }
+    // Files saved by the script on all nodes, relative to the project root
+    QStringList savedFiles() const { return m_savedFiles; }
+
+signals:
+    // Emitted once all files are processed, the exit code is the exit code of the first failure, 0 otherwise
+    void finished(int exitCode);
+
+private:
+    struct Shard
+    {
+        // Indexes in m_files
+        QList<int> files;
+        // Nodes which failed while running this shard, it's not retried on them
+        QSet<int> failedNodes;
+    };
+
+    struct Node
+    {
+        QString name;
+        QLocalSocket *socket = nullptr;
+        bool connected = false;
+        bool lost = false;
+        // The shard being run, and its files not finished yet
+        std::optional<Shard> shard;
+        QSet<int> pendingFiles;
+        QByteArray buffer;
+    };
+
+    void connectNode(int index);
+    void loseNode(int index, const QString &reason);
+    void sendShards();
+    void readResponses(int index);
+    void handleResponse(int index, const nlohmann::json &response);
+    void finishFile(int index, int file, int exitCode);
+    void writeFiles(const nlohmann::json &files);
+    void addPatches(const nlohmann::json &patches);
+    void checkFinished();
+
+    QStringList m_nodeNames;
+    QList<Node> m_nodes;
+    int m_shardSize = 0;
+    QString m_scriptName;
+    QByteArray m_source;
+    QStringList m_files;
+    std::deque<Shard> m_shards;
+    int m_exitCode = 0;
+    int m_remaining = 0;
+    QStringList m_failedFiles;
+    QStringList m_savedFiles;
+};
+
+} // namespace Core
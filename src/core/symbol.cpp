@@ -15,6 +15,7 @@
 #include "logger.h"
 #include "project.h"
 #include "utils/log.h"
+#include "utils/stringpool.h"
 
 #include <kdalgorithms.h>
 
@@ -82,33 +83,43 @@ namespace Core {
  * contained by the `range`.
  */
 
-Symbol::Symbol(QObject *parent, const QueryMatch &match, Kind kind)
+Symbol::Symbol(QObject *parent, const QString &name, Captures &&captures, Kind kind)
     : QObject(parent)
-    , m_name {match.get("name").text()}
+    , m_name {Utils::intern(name)}
     , m_kind {kind}
-    , m_range {match.get("range").toTextRange()}
-    , m_selectionRange {match.get("selectionRange").toTextRange()}
-    , m_queryMatch {match}
+    , m_captures {std::move(captures)}
 {
+    const auto range = captureRanges("range");
+    m_range = range.isEmpty() ? TextRange {} : range.first();
+    const auto selectionRange = captureRanges("selectionRange");
+    m_selectionRange = selectionRange.isEmpty() ? TextRange {} : selectionRange.first();
 }
 
 Symbol *Symbol::makeSymbol(QObject *parent, const QueryMatch &match, Kind kind)
 {
+    // Only keep the positions of the captures, the RangeMarks of the match are released with it
+    auto captures = kdalgorithms::transformed<Captures>(match.captures(), [](const QueryCapture &capture) {
+        return Capture {.name = capture.name, .range = capture.range.toTextRange()};
+    });
+    return makeSymbol(parent, match.get("name").text(), std::move(captures), kind);
+}
 
+Symbol *Symbol::makeSymbol(QObject *parent, const QString &name, Captures &&captures, Kind kind)
+{
     if (kind == Method || kind == Function || kind == Constructor) {
-        return new FunctionSymbol(parent, match, kind);
+        return new FunctionSymbol(parent, name, std::move(captures), kind);
     }
     if (kind == Class || kind == Struct) {
-        return new ClassSymbol(parent, match, kind);
+        return new ClassSymbol(parent, name, std::move(captures), kind);
     }
-    return new Symbol(parent, match, kind);
+    return new Symbol(parent, name, std::move(captures), kind);
 }
 
 void Symbol::assignContext(const QVector<Symbol *> &contexts)
 {
     auto names = kdalgorithms::transformed<QStringList>(contexts, &Symbol::name);
     if (!names.isEmpty()) {
-        m_name = names.join("::") + "::" + m_name;
+        m_name = Utils::intern(names.join("::") + "::" + m_name);
     }
     auto is_class = [](const auto &symbol) {
         return symbol->kind() == Kind::Class;
@@ -123,6 +134,28 @@ CodeDocument *Symbol::document() const
     return qobject_cast<CodeDocument *>(parent());
 }
 
+QVector<TextRange> Symbol::captureRanges(const QString &name) const
+{
+    QVector<TextRange> ranges;
+    for (const auto &capture : m_captures) {
+        if (capture.name == name)
+            ranges.push_back(capture.range);
+    }
+    return ranges;
+}
+
+// The captures are positions in the text the symbol was found in
+QString Symbol::textAt(const TextRange &range) const
+{
+    auto codeDocument = document();
+    if (!codeDocument || range.start < 0 || range.end < range.start)
+        return {};
+    const auto text = codeDocument->text();
+    if (range.end > text.size())
+        return {};
+    return text.sliced(range.start, range.length());
+}
+
 /*!
  * \qmlmethod bool Symbol::isClass()
  *
@@ -62,19 +62,31 @@ public:
     };
     Q_ENUM(Kind)
 
+    // Capture of the query used to find the symbol, like the `return` or `parameter` captures of a function.
+    // Plain ranges are kept instead of RangeMarks, so the document doesn't have to update them on each change.
+    struct Capture
+    {
+        QString name;
+        TextRange range;
+    };
+    using Captures = QVector<Capture>;
+
 protected:
-    Symbol(QObject *parent, const QueryMatch &match, Kind kind);
+    Symbol(QObject *parent, const QString &name, Captures &&captures, Kind kind);
 
     QString m_name;
     Kind m_kind;
     TextRange m_range;
     TextRange m_selectionRange;
-    QueryMatch m_queryMatch;
+    Captures m_captures;
 
     CodeDocument *document() const;
+    QVector<TextRange> captureRanges(const QString &name) const;
+    QString textAt(const TextRange &range) const;
 
 public:
     static Symbol *makeSymbol(QObject *parent, const QueryMatch &match, Kind kind);
+    static Symbol *makeSymbol(QObject *parent, const QString &name, Captures &&captures, Kind kind);
 
     Q_INVOKABLE bool isClass() const;
     Core::ClassSymbol *toClass();
@@ -0,0 +1,95 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "symbolcache.h"
+#include "project.h"
+#include "settings.h"
+#include "utils/log.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+
+namespace Core {
+
+// Increment when the way symbols are extracted changes, to invalidate existing caches
+constexpr int SymbolCacheVersion = 1;
+
+bool SymbolCache::isEnabled()
+{
+    return !cacheDirectory().isEmpty();
+}
+
+QString SymbolCache::cacheDirectory()
+{
+    const auto path = Settings::instance()->value<QString>(Settings::SymbolCache);
+    if (path.isEmpty() || QDir::isAbsolutePath(path))
+        return path;
+    const auto &root = Project::instance()->root();
+    return root.isEmpty() ? QString() : QDir(root).absoluteFilePath(path);
+}
+
+QString SymbolCache::cacheFileName(const QString &fileName)
+{
+    const auto key = QCryptographicHash::hash(fileName.toUtf8(), QCryptographicHash::Sha1).toHex();
+    return cacheDirectory() + '/' + QString::fromLatin1(key) + ".json";
+}
+
+QByteArray SymbolCache::hash(const QString &text)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QByteArrayView(reinterpret_cast<const char *>(text.constData()), text.size() * sizeof(QChar)));
+    return hash.result().toHex();
+}
+
+std::optional<SymbolCache::Symbols> SymbolCache::load(const QString &fileName, const QByteArray &hash)
+{
+    QFile file(cacheFileName(fileName));
+    if (!file.open(QIODevice::ReadOnly))
+        return {};
+
+    try {
+        const auto json = nlohmann::json::parse(file.readAll().constData());
+        if (json.at("version").get<int>() != SymbolCacheVersion || json.at("fileName").get<QString>() != fileName
+            || json.at("hash").get<std::string>() != hash.toStdString())
+            return {};
+        return json.at("symbols").get<Symbols>();
+    } catch (...) {
+        spdlog::warn("SymbolCache::load - invalid cache file {} for {}", file.fileName(), fileName);
+    }
+    return {};
+}
+
+void SymbolCache::save(const QString &fileName, const QByteArray &hash, const Symbols &symbols)
+{
+    const auto directory = cacheDirectory();
+    if (!QDir().mkpath(directory)) {
+        spdlog::warn("SymbolCache::save - can't create cache directory {}", directory);
+        return;
+    }
+
+    const nlohmann::json json = {{"version", SymbolCacheVersion},
+                                 {"fileName", fileName},
+                                 {"hash", hash.toStdString()},
+                                 {"symbols", symbols}};
+
+    // Use a QSaveFile, so another Knut instance never reads a partial file
+    QSaveFile file(cacheFileName(fileName));
+    if (!file.open(QIODevice::WriteOnly)) {
+        spdlog::warn("SymbolCache::save - can't write cache file {}", file.fileName());
+        return;
+    }
+    file.write(QByteArray::fromStdString(json.dump()));
+    if (!file.commit())
+        spdlog::warn("SymbolCache::save - can't write cache file {}", file.fileName());
+}
+
+} // namespace Core
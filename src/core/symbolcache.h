@@ -0,0 +1,60 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include "utils/json.h"
+
+#include <QString>
+#include <QVector>
+#include <optional>
+
+namespace Core {
+
+/**
+ * \brief Persistent cache of the symbols of a file, to avoid parsing unchanged files between two runs
+ *
+ * The cache is enabled by setting a directory in the `/cache/symbols` setting. If the path is relative, it's relative
+ * to the project root directory.
+ * For each file, the cache stores a hash of its content with the captures of all the symbols found in it.
+ */
+class SymbolCache
+{
+public:
+    struct Capture
+    {
+        QString name;
+        int start = 0;
+        int end = 0;
+    };
+
+    struct Symbol
+    {
+        int kind = 0;
+        std::vector<Capture> captures;
+    };
+    using Symbols = std::vector<Symbol>;
+
+    static bool isEnabled();
+
+    static QByteArray hash(const QString &text);
+
+    static std::optional<Symbols> load(const QString &fileName, const QByteArray &hash);
+    static void save(const QString &fileName, const QByteArray &hash, const Symbols &symbols);
+
+private:
+    static QString cacheDirectory();
+    static QString cacheFileName(const QString &fileName);
+};
+
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(SymbolCache::Capture, name, start, end);
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(SymbolCache::Symbol, kind, captures);
+
+} // namespace Core
@@ -0,0 +1,313 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "symbolindex.h"
+#include "utils/log.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSet>
+#include <algorithm>
+#include <kdalgorithms.h>
+#include <tuple>
+
+namespace Core {
+
+// Increment when the way symbols are indexed changes, to invalidate existing caches
+constexpr int SymbolIndexVersion = 2;
+
+/*!
+ * \qmltype IndexedSymbol
+ * \brief Symbol found in the project by `Project::findClass`, `Project::findFunction` or `Project::findCallers`.
+ * \inqmlmodule Script
+ * \ingroup CodeDocument
+ *
+ * Contrary to a `Symbol`, the symbol is not linked to any document: its range won't be updated if the file changes.
+ * Open the document using `Project.open(symbol.fileName)` to edit it.
+ */
+/*!
+ * \qmlproperty Kind IndexedSymbol::kind
+ * Kind of the symbol, one of:
+ *
+ * - `IndexedSymbol.Class`: a class or struct definition
+ * - `IndexedSymbol.Function`: a function or method definition
+ * - `IndexedSymbol.Call`: a function call
+ */
+/*!
+ * \qmlproperty string IndexedSymbol::name
+ * Name of the symbol, without its scope.
+ */
+/*!
+ * \qmlproperty string IndexedSymbol::scope
+ * Scope of the symbol, like the class of a method, or an empty string.
+ */
+/*!
+ * \qmlproperty string IndexedSymbol::function
+ * For a call, the qualified name of the function containing the call.
+ */
+/*!
+ * \qmlproperty array<string> IndexedSymbol::bases
+ * For a class, the names of its base classes, as written in the class definition.
+ */
+/*!
+ * \qmlproperty string IndexedSymbol::fileName
+ * Full path of the file containing the symbol.
+ */
+/*!
+ * \qmlproperty TextRange IndexedSymbol::range
+ * Range of the symbol definition, or of the call expression.
+ */
+
+QString IndexedSymbol::toString() const
+{
+    const auto qualifiedName = scope.isEmpty() ? name : scope + "::" + name;
+    return QString("IndexedSymbol{'%1', '%2', %3}").arg(qualifiedName, fileName, range.toString());
+}
+
+// Split a qualified name `A::B::foo` into its scope `A::B` and name `foo`
+static std::pair<QString, QString> splitQualifiedName(const QString &qualifiedName)
+{
+    const auto index = qualifiedName.lastIndexOf("::");
+    if (index == -1)
+        return {{}, qualifiedName};
+    return {qualifiedName.left(index), qualifiedName.mid(index + 2)};
+}
+
+QString SymbolIndex::query()
+{
+    // All patterns are merged in one query, so each file is only traversed once. The patterns are recognized using
+    // their captures in fromMatches.
+    // Function declarators can be nested in pointer and reference declarators, depending on the return type.
+    return QStringLiteral(R"EOF(
+        [(class_specifier
+            name: (_) @class-name
+            (base_class_clause
+                [(type_identifier) @class-base (qualified_identifier) @class-base (template_type) @class-base _]*)?
+            body: (_)) @class
+        (struct_specifier
+            name: (_) @class-name
+            (base_class_clause
+                [(type_identifier) @class-base (qualified_identifier) @class-base (template_type) @class-base _]*)?
+            body: (_)) @class]
+
+        (function_definition
+            declarator: [
+                (function_declarator
+                    declarator: (_) @function-name)
+                (_ (function_declarator
+                    declarator: (_) @function-name))
+                (_ (_ (function_declarator
+                    declarator: (_) @function-name)))
+            ]) @function
+
+        (call_expression
+            function: [
+                (identifier) @call-name
+                (field_expression
+                    field: (_) @call-name)
+                (qualified_identifier
+                    name: (_) @call-name)
+                (template_function
+                    name: (_) @call-name)
+            ]) @call
+    )EOF");
+}
+
+/**
+ * Creates the symbols of the file `fileName` from the matches of the `query()`.
+ *
+ * The scope of classes and methods defined inline is the innermost class containing them, the function of a call is
+ * the innermost function containing it.
+ */
+SymbolIndex::FileSymbols SymbolIndex::fromMatches(const QString &fileName, const FileQueryMatchList &matches)
+{
+    FileSymbols result {.fileName = fileName};
+
+    QVector<IndexedSymbol> classes;
+    QVector<IndexedSymbol> functions;
+    QVector<IndexedSymbol> calls;
+    for (const auto &match : matches) {
+        if (const auto definition = match.get("class"); !definition.name.isEmpty()) {
+            auto [scope, name] = splitQualifiedName(match.get("class-name").text);
+            auto bases = kdalgorithms::transformed<QStringList>(match.getAll("class-base"), [](const auto &base) {
+                return base.text;
+            });
+            classes.push_back({.kind = IndexedSymbol::Class,
+                               .name = name,
+                               .scope = scope,
+                               .bases = std::move(bases),
+                               .range = definition.range});
+        } else if (const auto function = match.get("function"); !function.name.isEmpty()) {
+            auto [scope, name] = splitQualifiedName(match.get("function-name").text);
+            functions.push_back(
+                {.kind = IndexedSymbol::Function, .name = name, .scope = scope, .range = function.range});
+        } else if (const auto call = match.get("call"); !call.name.isEmpty()) {
+            auto name = match.get("call-name").text;
+            // Remove template arguments, if any
+            if (const auto index = name.indexOf('<'); index > 0)
+                name.truncate(index);
+            calls.push_back({.kind = IndexedSymbol::Call, .name = name, .range = call.range});
+        }
+    }
+
+    // Returns the innermost symbol containing `range`, or nullptr
+    auto innermost = [](const QVector<IndexedSymbol> &symbols, const TextRange &range) -> const IndexedSymbol * {
+        const IndexedSymbol *result = nullptr;
+        for (const auto &symbol : symbols) {
+            if (symbol.range != range && symbol.range.contains(range)
+                && (!result || result->range.length() > symbol.range.length()))
+                result = &symbol;
+        }
+        return result;
+    };
+    auto qualifiedName = [](const IndexedSymbol &symbol) {
+        return symbol.scope.isEmpty() ? symbol.name : symbol.scope + "::" + symbol.name;
+    };
+
+    // Fill the scope of outer classes first, so the scope of nested classes and inline methods is fully qualified
+    std::ranges::sort(classes, {}, [](const auto &symbol) {
+        return symbol.range.start;
+    });
+    for (auto &symbol : classes) {
+        if (!symbol.scope.isEmpty())
+            continue;
+        if (const auto parent = innermost(classes, symbol.range))
+            symbol.scope = qualifiedName(*parent);
+    }
+
+    for (auto &symbol : functions) {
+        if (!symbol.scope.isEmpty())
+            continue;
+        if (const auto parent = innermost(classes, symbol.range))
+            symbol.scope = qualifiedName(*parent);
+    }
+    for (auto &symbol : calls) {
+        if (const auto parent = innermost(functions, symbol.range))
+            symbol.function = qualifiedName(*parent);
+    }
+
+    result.symbols.reserve(classes.size() + functions.size() + calls.size());
+    for (auto *symbols : {&classes, &functions, &calls}) {
+        for (auto &symbol : *symbols) {
+            symbol.fileName = fileName;
+            result.symbols.push_back(std::move(symbol));
+        }
+    }
+    return result;
+}
+
+const QHash<QString, SymbolIndex::FileSymbols> &SymbolIndex::files() const
+{
+    return m_files;
+}
+
+void SymbolIndex::insert(FileSymbols &&fileSymbols)
+{
+    const auto fileName = fileSymbols.fileName;
+    m_files.insert(fileName, std::move(fileSymbols));
+    m_namesDirty = true;
+}
+
+void SymbolIndex::remove(const QString &fileName)
+{
+    if (m_files.remove(fileName))
+        m_namesDirty = true;
+}
+
+void SymbolIndex::updateNames() const
+{
+    if (!m_namesDirty)
+        return;
+    m_filesByName.clear();
+    for (const auto &fileSymbols : m_files) {
+        QSet<QString> names;
+        for (const auto &symbol : fileSymbols.symbols)
+            names.insert(symbol.name);
+        for (const auto &name : std::as_const(names))
+            m_filesByName.insert(name, fileSymbols.fileName);
+    }
+    m_namesDirty = false;
+}
+
+/**
+ * Returns all symbols of the given `kind` named `name`. The name can be qualified with its scope, like `Foo::bar`.
+ */
+QVector<IndexedSymbol> SymbolIndex::find(IndexedSymbol::Kind kind, const QString &name) const
+{
+    updateNames();
+
+    const auto [scope, shortName] = splitQualifiedName(name);
+    QVector<IndexedSymbol> result;
+    const auto files = m_filesByName.values(shortName);
+    for (const auto &fileName : files) {
+        for (const auto &symbol : m_files.value(fileName).symbols) {
+            if (symbol.kind == kind && symbol.name == shortName && (scope.isEmpty() || symbol.scope == scope))
+                result.push_back(symbol);
+        }
+    }
+    // QMultiHash doesn't keep the files in any specific order
+    std::ranges::sort(result, [](const auto &lhs, const auto &rhs) {
+        return std::tie(lhs.fileName, lhs.range) < std::tie(rhs.fileName, rhs.range);
+    });
+    return result;
+}
+
+bool SymbolIndex::load(const QString &cacheFile)
+{
+    QFile file(cacheFile);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    try {
+        const auto json = nlohmann::json::parse(file.readAll().constData());
+        if (json.at("version").get<int>() != SymbolIndexVersion)
+            return false;
+        auto files = json.at("files").get<std::vector<FileSymbols>>();
+        m_files.clear();
+        for (auto &fileSymbols : files) {
+            for (auto &symbol : fileSymbols.symbols)
+                symbol.fileName = fileSymbols.fileName;
+            insert(std::move(fileSymbols));
+        }
+        m_namesDirty = true;
+        return true;
+    } catch (...) {
+        spdlog::warn("SymbolIndex::load - invalid cache file {}", cacheFile);
+    }
+    return false;
+}
+
+void SymbolIndex::save(const QString &cacheFile) const
+{
+    const auto directory = QFileInfo(cacheFile).absolutePath();
+    if (!QDir().mkpath(directory)) {
+        spdlog::warn("SymbolIndex::save - can't create cache directory {}", directory);
+        return;
+    }
+
+    nlohmann::json files = nlohmann::json::array();
+    for (const auto &fileSymbols : m_files)
+        files.push_back(fileSymbols);
+    const nlohmann::json json = {{"version", SymbolIndexVersion}, {"files", std::move(files)}};
+
+    // Use a QSaveFile, so another Knut instance never reads a partial file
+    QSaveFile file(cacheFile);
+    if (!file.open(QIODevice::WriteOnly)) {
+        spdlog::warn("SymbolIndex::save - can't write cache file {}", cacheFile);
+        return;
+    }
+    file.write(QByteArray::fromStdString(json.dump()));
+    if (!file.commit())
+        spdlog::warn("SymbolIndex::save - can't write cache file {}", cacheFile);
+}
+
+} // namespace Core
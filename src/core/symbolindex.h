@@ -0,0 +1,108 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include "filequerymatch.h"
+#include "textrange.h"
+#include "utils/json.h"
+
+#include <QHash>
+#include <QMultiHash>
+#include <QObject>
+#include <QStringList>
+#include <QVector>
+
+namespace Core {
+
+// Symbol found in a file by the SymbolIndex, not backed by any document.
+struct IndexedSymbol
+{
+    Q_GADGET
+    Q_PROPERTY(Kind kind MEMBER kind CONSTANT)
+    Q_PROPERTY(QString name MEMBER name CONSTANT)
+    Q_PROPERTY(QString scope MEMBER scope CONSTANT)
+    Q_PROPERTY(QString function MEMBER function CONSTANT)
+    Q_PROPERTY(QStringList bases MEMBER bases CONSTANT)
+    Q_PROPERTY(QString fileName MEMBER fileName CONSTANT)
+    Q_PROPERTY(Core::TextRange range MEMBER range CONSTANT)
+
+public:
+    enum Kind {
+        Class,
+        Function,
+        Call,
+    };
+    Q_ENUM(Kind)
+
+    Kind kind = Class;
+    QString name;
+    QString scope;
+    // Qualified name of the function containing a call
+    QString function;
+    // Base classes of a class, as written in its definition
+    QStringList bases;
+    QString fileName;
+    TextRange range {};
+
+    Q_INVOKABLE QString toString() const;
+};
+
+NLOHMANN_JSON_SERIALIZE_ENUM(IndexedSymbol::Kind,
+                             {{IndexedSymbol::Class, "class"},
+                              {IndexedSymbol::Function, "function"},
+                              {IndexedSymbol::Call, "call"}});
+// The file name is stored once per file in the cache, see SymbolIndex::load
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(IndexedSymbol, kind, name, scope, function, bases, range);
+
+/**
+ * \brief Index of the C++ symbols of a project, built without opening any document
+ *
+ * The index stores the class and function definitions, as well as the function calls, of all C++ files. It's built
+ * and updated by the Project using tree-sitter, see Project::findClass, and can be stored on disk between two runs.
+ */
+class SymbolIndex
+{
+public:
+    struct FileSymbols
+    {
+        QString fileName;
+        // Modification time of the file (in ms since epoch) when it was indexed
+        qint64 lastModified = 0;
+        QVector<IndexedSymbol> symbols;
+    };
+
+    // Query extracting all the symbols of a C++ file in one pass, see fromMatches
+    static QString query();
+    static FileSymbols fromMatches(const QString &fileName, const FileQueryMatchList &matches);
+
+    const QHash<QString, FileSymbols> &files() const;
+    void insert(FileSymbols &&fileSymbols);
+    void remove(const QString &fileName);
+
+    QVector<IndexedSymbol> find(IndexedSymbol::Kind kind, const QString &name) const;
+
+    bool load(const QString &cacheFile);
+    void save(const QString &cacheFile) const;
+
+private:
+    void updateNames() const;
+
+    QHash<QString, FileSymbols> m_files;
+    // Files containing a symbol with a given name, updated lazily when looking for a symbol
+    mutable QMultiHash<QString, QString> m_filesByName;
+    mutable bool m_namesDirty = false;
+};
+
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(SymbolIndex::FileSymbols, fileName, lastModified, symbols);
+
+} // namespace Core
+
+Q_DECLARE_METATYPE(Core::IndexedSymbol)
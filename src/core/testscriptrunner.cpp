@@ -0,0 +1,304 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "testscriptrunner.h"
+#include "utils/log.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QProcess>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QThread>
+#include <QXmlStreamWriter>
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+
+namespace Core {
+
+TestScriptRunner::TestScriptRunner(QObject *parent)
+    : QObject(parent)
+    , m_jobs(QThread::idealThreadCount())
+{
+}
+
+TestScriptRunner::~TestScriptRunner() = default;
+
+QStringList TestScriptRunner::testScripts(const QString &dir)
+{
+    QStringList scripts;
+    QDirIterator it(dir, {"tst_*.qml", "tst_*.js"}, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext())
+        scripts.push_back(QFileInfo(it.next()).absoluteFilePath());
+    scripts.sort();
+    return scripts;
+}
+
+TestScriptRunner::Result TestScriptRunner::parseOutput(const QString &script, const QStringList &output, int exitCode,
+                                                       bool crashed)
+{
+    // Lines logged by TestCase, possibly after the prefix of the logger
+    static const QRegularExpression startRegexp(R"(\*{9} Start testing of (.+) \*{9})");
+    static const QRegularExpression functionRegexp(R"((PASS   |FAIL!  ): (.+)::(\w+)\(\)\s*(.*)$)");
+    static const QRegularExpression totalsRegexp(R"(Totals: \d+ passed, \d+ failed)");
+
+    Result result {script, QFileInfo(script).baseName(), exitCode, crashed};
+    result.output = output;
+    // Details are only added to the last failed function, until the next function
+    qsizetype failed = -1;
+    for (const auto &line : output) {
+        if (const auto match = startRegexp.match(line); match.hasMatch()) {
+            result.name = match.captured(1);
+            failed = -1;
+        } else if (const auto match = functionRegexp.match(line); match.hasMatch()) {
+            result.name = match.captured(2);
+            const bool passed = match.captured(1).startsWith("PASS");
+            auto index = std::distance(result.functions.cbegin(),
+                                       std::ranges::find(result.functions, match.captured(3), &Function::name));
+            if (index == result.functions.size())
+                result.functions.push_back({match.captured(3), passed});
+            // A function fails once per failed check, but is only passed if none failed
+            auto &function = result.functions[index];
+            function.passed = function.passed && passed;
+            if (!passed && function.message.isEmpty())
+                function.message = match.captured(4);
+            failed = passed ? -1 : index;
+        } else if (totalsRegexp.match(line).hasMatch()) {
+            failed = -1;
+        } else if (failed != -1) {
+            result.functions[failed].details.push_back(line.trimmed());
+        }
+    }
+    return result;
+}
+
+static QString seconds(qint64 milliseconds)
+{
+    return QString::number(milliseconds / 1000.0, 'f', 3);
+}
+
+bool TestScriptRunner::saveJUnit(const QString &fileName, const QList<Result> &results)
+{
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        spdlog::error("TestScriptRunner::saveJUnit - can't write {}: {}", fileName, file.errorString());
+        return false;
+    }
+
+    // An error is a test which didn't run to the end: crashed, or failed without any failed function
+    auto hasError = [](const Result &result) {
+        return !result.passed() && std::ranges::none_of(result.functions, [](const Function &function) {
+                   return !function.passed;
+               });
+    };
+    auto failures = [](const Result &result) {
+        return std::ranges::count_if(result.functions, [](const Function &function) {
+            return !function.passed;
+        });
+    };
+    // The script itself is a testcase if it has no functions, or an error
+    auto hasScriptCase = [&hasError](const Result &result) {
+        return result.functions.isEmpty() || hasError(result);
+    };
+
+    qsizetype tests = 0;
+    qsizetype failureCount = 0;
+    qsizetype errorCount = 0;
+    qint64 duration = 0;
+    for (const auto &result : results) {
+        tests += result.functions.size() + (hasScriptCase(result) ? 1 : 0);
+        failureCount += failures(result);
+        errorCount += hasError(result) ? 1 : 0;
+        duration += result.duration;
+    }
+
+    QXmlStreamWriter xml(&file);
+    xml.setAutoFormatting(true);
+    xml.writeStartDocument();
+    xml.writeStartElement("testsuites");
+    xml.writeAttribute("name", "knut");
+    xml.writeAttribute("tests", QString::number(tests));
+    xml.writeAttribute("failures", QString::number(failureCount));
+    xml.writeAttribute("errors", QString::number(errorCount));
+    xml.writeAttribute("time", seconds(duration));
+
+    for (const auto &result : results) {
+        const bool error = hasError(result);
+        xml.writeStartElement("testsuite");
+        xml.writeAttribute("name", result.name);
+        xml.writeAttribute("file", result.script);
+        xml.writeAttribute("tests", QString::number(result.functions.size() + (hasScriptCase(result) ? 1 : 0)));
+        xml.writeAttribute("failures", QString::number(failures(result)));
+        xml.writeAttribute("errors", QString::number(error ? 1 : 0));
+        xml.writeAttribute("time", seconds(result.duration));
+
+        for (const auto &function : result.functions) {
+            xml.writeStartElement("testcase");
+            xml.writeAttribute("name", function.name);
+            xml.writeAttribute("classname", result.name);
+            if (!function.passed) {
+                xml.writeStartElement("failure");
+                xml.writeAttribute("message", function.message);
+                xml.writeCharacters(function.details.join('\n'));
+                xml.writeEndElement();
+            }
+            xml.writeEndElement();
+        }
+        if (hasScriptCase(result)) {
+            xml.writeStartElement("testcase");
+            xml.writeAttribute("name", QFileInfo(result.script).fileName());
+            xml.writeAttribute("classname", result.name);
+            xml.writeAttribute("time", seconds(result.duration));
+            if (error) {
+                xml.writeStartElement("error");
+                xml.writeAttribute("message", result.crashed ? QString("crashed")
+                                                             : QString("exit code %1").arg(result.exitCode));
+                xml.writeEndElement();
+            }
+            xml.writeEndElement();
+        }
+
+        xml.writeTextElement("system-out", result.output.join('\n'));
+        xml.writeEndElement();
+    }
+
+    xml.writeEndElement();
+    xml.writeEndDocument();
+    if (xml.hasError() || !file.commit()) {
+        spdlog::error("TestScriptRunner::saveJUnit - can't write {}: {}", fileName, file.errorString());
+        return false;
+    }
+    return true;
+}
+
+void TestScriptRunner::setJobs(int jobs)
+{
+    m_jobs = jobs > 0 ? jobs : QThread::idealThreadCount();
+}
+
+void TestScriptRunner::run(const QStringList &scripts)
+{
+    m_scripts = scripts;
+    m_next = 0;
+    m_running = 0;
+    m_results = QList<Result>(scripts.size());
+    m_outputs = QList<QStringList>(scripts.size());
+    m_startTimes = QList<qint64>(scripts.size());
+    m_timer.start();
+
+    if (m_scripts.isEmpty()) {
+        spdlog::warn("TestScriptRunner::run - no test scripts to run");
+        emit finished(0);
+        return;
+    }
+
+    spdlog::info("TestScriptRunner::run - running {} tests with {} jobs", m_scripts.size(),
+                 std::min<int>(m_jobs, m_scripts.size()));
+    for (int i = 0; i < m_jobs && m_next < m_scripts.size(); ++i)
+        startNext();
+}
+
+void TestScriptRunner::startNext()
+{
+    const int index = m_next++;
+    auto process = new QProcess(this);
+    process->setProcessChannelMode(QProcess::MergedChannels);
+    connect(process, &QProcess::readyReadStandardOutput, this, [this, process, index]() {
+        readOutput(process, index);
+    });
+    connect(process, &QProcess::finished, this, [this, process, index](int exitCode, QProcess::ExitStatus status) {
+        handleFinished(process, index, exitCode, status == QProcess::CrashExit);
+    });
+    connect(process, &QProcess::errorOccurred, this, [this, process, index](QProcess::ProcessError error) {
+        // Other errors are followed by the finished signal
+        if (error == QProcess::FailedToStart)
+            handleFinished(process, index, 1, true);
+    });
+
+    // Same as tst_knut: the tst_<name> directory next to the script is the project of the test
+    const QFileInfo script(m_scripts.at(index));
+    QStringList arguments {"--test", script.absoluteFilePath()};
+    const QDir projectDir(script.absolutePath() + '/' + script.baseName());
+    if (projectDir.exists())
+        arguments.append(projectDir.absolutePath());
+    ++m_running;
+    m_startTimes[index] = m_timer.elapsed();
+    process->start(QCoreApplication::applicationFilePath(), arguments);
+}
+
+void TestScriptRunner::readOutput(QProcess *process, int index, bool flush)
+{
+    auto &output = m_outputs[index];
+    auto addLine = [&output](QByteArray line) {
+        // Windows line endings
+        while (line.endsWith('\n') || line.endsWith('\r'))
+            line.chop(1);
+        output.push_back(QString::fromUtf8(line));
+    };
+    while (process->canReadLine())
+        addLine(process->readLine());
+    if (flush) {
+        const QByteArray rest = process->readAll();
+        if (!rest.isEmpty())
+            addLine(rest);
+    }
+}
+
+void TestScriptRunner::handleFinished(QProcess *process, int index, int exitCode, bool crashed)
+{
+    readOutput(process, index, true);
+    process->deleteLater();
+    --m_running;
+
+    auto &result = m_results[index];
+    result = parseOutput(m_scripts.at(index), m_outputs.at(index), exitCode, crashed);
+    result.duration = m_timer.elapsed() - m_startTimes.at(index);
+    m_outputs[index].clear();
+
+    // The output of the failed tests only, the passed ones would hide them
+    const QString fileName = QFileInfo(result.script).fileName();
+    if (result.passed()) {
+        spdlog::info("TestScriptRunner - PASS {} ({} ms)", fileName, result.duration);
+    } else {
+        const std::string prefix = "[" + fileName.toStdString() + "] ";
+        for (const auto &line : std::as_const(result.output))
+            std::cout << prefix << line.toStdString() << '\n';
+        std::cout.flush();
+        spdlog::error("TestScriptRunner - FAIL {}: {}", fileName,
+                      crashed ? process->errorString() : QString("exit code %1").arg(exitCode));
+    }
+
+    if (m_next < m_scripts.size()) {
+        startNext();
+        return;
+    }
+    if (m_running > 0)
+        return;
+
+    QStringList failedTests;
+    for (const auto &test : std::as_const(m_results)) {
+        if (!test.passed())
+            failedTests.push_back(QFileInfo(test.script).fileName());
+    }
+    if (failedTests.isEmpty()) {
+        spdlog::info("TestScriptRunner - {} tests passed in {} ms", m_results.size(), m_timer.elapsed());
+    } else {
+        spdlog::error("TestScriptRunner - {} tests passed, {} failed in {} ms: {}",
+                      m_results.size() - failedTests.size(), failedTests.size(), m_timer.elapsed(),
+                      failedTests.join(", "));
+    }
+    // Exit codes are truncated to 8 bits, 256 failures is not a success
+    emit finished(std::min<int>(failedTests.size(), 255));
+}
+
+} // namespace Core
@@ -0,0 +1,99 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <QStringList>
+
+class QProcess;
+
+namespace Core {
+
+/**
+ * \brief Runs many test scripts in parallel
+ *
+ * Each test script is run by its own Knut process (`knut --test <script> [<dir>]`), so each test has its own script
+ * engine and project, like with `--test`. If there is a `tst_<name>` directory next to a `tst_<name>.qml` script, it's
+ * used as the project of the test.
+ *
+ * The test functions passed and failed are read from the output of the TestCase, and the results of all tests can be
+ * saved as JUnit XML.
+ */
+class TestScriptRunner : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Function
+    {
+        QString name;
+        bool passed = false;
+        // Message of the failure, and the details logged after it
+        QString message;
+        QStringList details;
+    };
+
+    struct Result
+    {
+        QString script;
+        // Name of the TestCase, the script base name if there is none
+        QString name;
+        int exitCode = 0;
+        bool crashed = false;
+        // In milliseconds
+        qint64 duration = 0;
+        QList<Function> functions;
+        QStringList output;
+
+        bool passed() const { return !crashed && exitCode == 0; }
+    };
+
+    explicit TestScriptRunner(QObject *parent = nullptr);
+    ~TestScriptRunner() override;
+
+    // Returns all test scripts (`tst_*.qml` and `tst_*.js`) in `dir` and its subdirectories, sorted
+    static QStringList testScripts(const QString &dir);
+    // Returns the result of `script`, read from its `output`
+    static Result parseOutput(const QString &script, const QStringList &output, int exitCode, bool crashed);
+    // Saves the `results` as JUnit XML in `fileName`, one testsuite per script and one testcase per test function
+    static bool saveJUnit(const QString &fileName, const QList<Result> &results);
+
+    void setJobs(int jobs);
+    int jobs() const { return m_jobs; }
+
+    // Runs all the test `scripts`
+    void run(const QStringList &scripts);
+
+    QList<Result> results() const { return m_results; }
+
+signals:
+    // Emitted once all tests are run, the exit code is the number of failed tests (at most 255)
+    void finished(int exitCode);
+
+private:
+    void startNext();
+    void readOutput(QProcess *process, int index, bool flush = false);
+    void handleFinished(QProcess *process, int index, int exitCode, bool crashed);
+
+    QStringList m_scripts;
+    int m_jobs = 0;
+    int m_next = 0;
+    int m_running = 0;
+    QElapsedTimer m_timer;
+    // Same order as m_scripts
+    QList<Result> m_results;
+    QList<QStringList> m_outputs;
+    QList<qint64> m_startTimes;
+};
+
+} // namespace Core
@@ -11,56 +11,198 @@
 #include "textdocument.h"
 #include "logger.h"
 #include "mark.h"
+#include "mark_p.h"
+#include "project.h"
 #include "rangemark.h"
 #include "settings.h"
 #include "textdocument_p.h"
 #include "texteditor.h"
 #include "utils/log.h"
+#include "utils/metrics.h"
+#include "utils/regularexpressioncache.h"
 #include "utils/string_helper.h"
 
+#include <QApplication>
+#include <QCryptographicHash>
 #include <QFile>
 #include <QKeyEvent>
 #include <QPlainTextEdit>
 #include <QRegularExpression>
+#include <QSaveFile>
 #include <QSignalBlocker>
+#include <QStringDecoder>
 #include <QTextBlock>
-#include <QTextStream>
+#include <algorithm>
+#include <functional>
+#include <numeric>
+#include <ranges>
+#include <utility>
 #include <private/qwidgettextcontrol_p.h>
 
 namespace Core {
 
-static std::optional<std::pair<QRegularExpressionMatch, QTextCursor>>
-matchInBlock(const QTextBlock &block, const QRegularExpression &expr, int offset, int options)
+// Delay after the last key typed in the editor before it's recorded in the history, see TextDocument::typeKey
+constexpr int TypingHistoryDelay = 500;
+
+// The clipboard handling is done by the editor, which needs a QApplication (it doesn't exist with knut-cli)
+static bool hasClipboard(const char *function)
+{
+    if (qobject_cast<QApplication *>(QCoreApplication::instance()))
+        return true;
+    spdlog::error("{} - the clipboard is not available without a GUI", function);
+    return false;
+}
+
+// Returns the expression used to search for `regexp`, with the same options as findRegexp.
+static QRegularExpression searchExpression(QString regexp, int options)
+{
+    if (options & TextDocument::FindWholeWords) {
+        if (!regexp.startsWith("\\b"))
+            regexp = "\\b" + regexp;
+        if (!regexp.endsWith("\\b"))
+            regexp += "\\b";
+    }
+
+    QRegularExpression::PatternOptions patternOptions =
+        (options & (TextDocument::FindCaseSensitively | TextDocument::PreserveCase))
+        ? QRegularExpression::NoPatternOption
+        : QRegularExpression::CaseInsensitiveOption;
+    // `^` and `$` still match at the start and end of each line
+    if (options & TextDocument::FindMultiline)
+        patternOptions |= QRegularExpression::MultilineOption;
+    return Utils::RegularExpressionCache::instance().regularExpression(regexp, patternOptions);
+}
+
+struct TextMatch
 {
-    QString text = block.text();
-    // Open Question: Why is this replacement necessary?
-    text.replace(QChar::Nbsp, u' ');
+    TextRange range;
     QRegularExpressionMatch match;
+};
 
-    if (options & TextDocument::FindBackward) {
-        // For backwards search use offset - 1 because the cursor is positioned between characters,
+static TextMatch textMatch(qsizetype offset, const QRegularExpressionMatch &match)
+{
+    const auto start = static_cast<int>(offset + match.capturedStart());
+    return {{start, start + static_cast<int>(match.capturedLength())}, match};
+}
+
+// Returns the first match of `expression` in `text` from `position`, or before it with FindBackward.
+// Matching is done line by line, or on the whole text with FindMultiline.
+static std::optional<TextMatch> matchInText(const QString &text, const QRegularExpression &expression, int position,
+                                            int options)
+{
+    const bool backward = options & TextDocument::FindBackward;
+    QRegularExpressionMatch match;
+    if (options & TextDocument::FindMultiline) {
+        // For backwards search use position - 1 because the cursor is positioned between characters,
         // so don't include the character for backward search.
-        --offset;
+        const auto start = backward ? (position > 0 ? text.lastIndexOf(expression, position - 1, &match) : -1)
+                                    : text.indexOf(expression, position, &match);
+        if (start == -1)
+            return {};
+        return textMatch(0, match);
     }
 
-    if (offset >= 0 && offset <= text.size()) {
-        const auto matchStart = (options & TextDocument::FindBackward) ? text.lastIndexOf(expr, offset, &match)
-                                                                       : text.indexOf(expr, offset, &match);
-        if (matchStart == -1)
-            return {};
+    qsizetype lineStart = position > 0 ? text.lastIndexOf(u'\n', position - 1) + 1 : 0;
+    qsizetype offset = position - lineStart;
+    while (true) {
+        qsizetype lineEnd = text.indexOf(u'\n', lineStart);
+        if (lineEnd == -1)
+            lineEnd = text.size();
+        const QString line = text.sliced(lineStart, lineEnd - lineStart);
+        if (backward)
+            --offset;
+        if (offset >= 0 && offset <= line.size()) {
+            const auto start =
+                backward ? line.lastIndexOf(expression, offset, &match) : line.indexOf(expression, offset, &match);
+            if (start != -1)
+                return textMatch(lineStart, match);
+        }
 
-        QTextCursor cursor(block);
-        if (options & TextDocument::FindBackward) {
-            cursor.movePosition(QTextCursor::Right, QTextCursor::MoveAnchor, matchStart + match.capturedLength());
-            cursor.movePosition(QTextCursor::Left, QTextCursor::KeepAnchor, match.capturedLength());
+        if (backward) {
+            if (lineStart == 0)
+                return {};
+            lineEnd = lineStart - 1;
+            lineStart = lineEnd > 0 ? text.lastIndexOf(u'\n', lineEnd - 1) + 1 : 0;
+            offset = lineEnd - lineStart;
         } else {
-            cursor.movePosition(QTextCursor::Right, QTextCursor::MoveAnchor, matchStart);
-            cursor.movePosition(QTextCursor::Right, QTextCursor::KeepAnchor, match.capturedLength());
+            if (lineEnd == text.size())
+                return {};
+            lineStart = lineEnd + 1;
+            offset = 0;
         }
+    }
+}
 
-        return std::make_pair(match, cursor);
+// Returns all non-overlapping matches of `expression` in `text`, in the order successive calls to find would return
+// them. Like find, matching is done line by line, or on the whole text with FindMultiline.
+static QVector<TextMatch> matchesInText(const QString &text, const QRegularExpression &expression, int options)
+{
+    const bool backward = options & TextDocument::FindBackward;
+    QVector<TextMatch> result;
+    if (options & TextDocument::FindMultiline) {
+        for (qsizetype from = 0; from <= text.size();) {
+            const auto match = expression.match(text, from);
+            if (!match.hasMatch())
+                break;
+            result.push_back(textMatch(0, match));
+            // Make sure to progress after an empty match
+            from = match.capturedEnd() + (match.capturedLength() == 0 ? 1 : 0);
+        }
+        // Backward, the matches are the same ones, found in the reverse order
+        if (backward)
+            std::ranges::reverse(result);
+        return result;
     }
-    return {};
+
+    QVector<TextMatch> lineMatches;
+    qsizetype lineStart = backward ? text.lastIndexOf(u'\n') + 1 : 0;
+    while (true) {
+        qsizetype lineEnd = text.indexOf(u'\n', lineStart);
+        if (lineEnd == -1)
+            lineEnd = text.size();
+        const QString line = text.sliced(lineStart, lineEnd - lineStart);
+        auto addMatch = [&](const QRegularExpressionMatch &match) {
+            lineMatches.push_back(textMatch(lineStart, match));
+        };
+
+        if (backward) {
+            // Matching is greedy backward too, skip the matches overlapping the previous (next in the text) one
+            qsizetype limit = line.size();
+            for (qsizetype from = line.size() - 1; from >= 0;) {
+                QRegularExpressionMatch match;
+                const auto start = line.lastIndexOf(expression, from, &match);
+                if (start == -1)
+                    break;
+                if (match.capturedEnd() <= limit) {
+                    addMatch(match);
+                    limit = start;
+                }
+                from = start - 1;
+            }
+        } else {
+            for (qsizetype from = 0; from <= line.size();) {
+                const auto match = expression.match(line, from);
+                if (!match.hasMatch())
+                    break;
+                addMatch(match);
+                // Make sure to progress after an empty match
+                from = match.capturedEnd() + (match.capturedLength() == 0 ? 1 : 0);
+            }
+        }
+        result.append(lineMatches);
+        lineMatches.clear();
+
+        if (backward) {
+            if (lineStart == 0)
+                break;
+            lineStart = lineStart >= 2 ? text.lastIndexOf(u'\n', lineStart - 2) + 1 : 0;
+        } else {
+            if (lineEnd == text.size())
+                break;
+            lineStart = lineEnd + 1;
+        }
+    }
+    return result;
 }
 
 /*!
@@ -114,6 +256,23 @@ matchInBlock(const QTextBlock &block, const QRegularExpression &expr, int offset
  *
  * Native is the default for new documents.
  */
+/*!
+ * \qmlproperty bool TextDocument::isLargeFile
+ * This read-only property is true if the file loaded is larger than the `/text_editor/large_file/size` characters or
+ * `/text_editor/large_file/lines` lines settings (0 disables the threshold). Only the documents opened with the
+ * project use the thresholds.
+ *
+ * Large files are opened with fewer features, to keep Knut responsive: see `degradedFeatures`.
+ */
+/*!
+ * \qmlproperty array<string> TextDocument::degradedFeatures
+ * This read-only property holds the features turned off or reduced because the document is a large file:
+ *
+ * - `highlighting`: only the visible part of the editor is highlighted right away, the rest is highlighted when idle
+ * - `undo`: undo and redo are disabled, on headless runs only
+ * - `lsp`: the language server is not used, unless `CodeDocument::enableLsp` is called
+ * - `background_parsing`: the file is not parsed when prefetched, only when the syntax tree is first needed
+ */
 /*!
  * \qmlproperty string TextDocument::currentLine
  * This read-only property return the line under the current position.
@@ -130,30 +289,131 @@ TextDocument::TextDocument(QObject *parent)
 
 TextDocument::~TextDocument()
 {
-    delete m_document;
+    delete m_textEdit;
 }
 
 TextDocument::TextDocument(Type type, QObject *parent)
     : Document(type, parent)
-    , m_document(new TextEditor)
-{
-    m_document->hide();
-    connect(m_document, &QPlainTextEdit::textChanged, this, &TextDocument::textChanged);
-    connect(m_document, &QPlainTextEdit::selectionChanged, this, &TextDocument::selectionChanged);
-    connect(m_document, &QPlainTextEdit::cursorPositionChanged, this, &TextDocument::positionChanged);
-    connect(m_document->document(), &QTextDocument::contentsChange, this, [this]() {
+    , m_document(new QTextDocument(this))
+    , m_cursor(m_document)
+    , m_lineIndex(std::make_unique<LineIndex>(m_document))
+    , m_markTracker(std::make_unique<MarkTracker>())
+{
+    // The layout is needed to move the cursor by lines, and must be the one expected by QPlainTextEdit
+    m_document->setDocumentLayout(new QPlainTextDocumentLayout(m_document));
+    connect(m_document, &QTextDocument::contentsChanged, this, &TextDocument::textChanged);
+    // Connected first, so the text and the marks are up to date for all other connections
+    connect(m_document, &QTextDocument::contentsChange, this, [this](int position, int charsRemoved, int charsAdded) {
+        static auto &edits = Utils::Metrics::counter("textdocument.edits");
+        edits.add();
+        m_plainText.reset();
+        ++m_contentRevision;
+        m_lineIndex->update(position, charsRemoved, charsAdded);
+        if (!m_applyingEdits)
+            m_markTracker->update(position, charsRemoved, charsAdded);
         setHasChanged(true);
     });
-    m_document->installEventFilter(this);
+    connect(m_document, &QTextDocument::undoCommandAdded, this, &TextDocument::addUndoStep);
+    m_typingTimer.setSingleShot(true);
+    m_typingTimer.setInterval(TypingHistoryDelay);
+    connect(&m_typingTimer, &QTimer::timeout, this, &TextDocument::flushTypedKeys);
+    if (!m_undoRedoEnabledForNewDocuments)
+        m_document->setUndoRedoEnabled(false);
+    // Once the editor is created, it's the one notifying cursor changes
+    connect(m_document, &QTextDocument::cursorPositionChanged, this, [this](const QTextCursor &cursor) {
+        if (!m_textEdit && cursor.isCopyOf(m_cursor))
+            emit positionChanged();
+    });
+}
+
+static bool isBackspace(QKeyEvent *keyEvent)
+{
+    // The test is coming from QTextWidgetControl
+    return keyEvent == QKeySequence::Backspace
+        || (keyEvent->key() == Qt::Key_Backspace && !(keyEvent->modifiers() & ~Qt::ShiftModifier));
+}
+
+// Typing is by far the most frequent edit in the editor: the keys typed are applied directly instead of going through
+// the API for each of them, and recorded in the history once the user stops typing, see flushTypedKeys.
+// Returns false if the key is not a simple typing key, or if there's a selection.
+bool TextDocument::typeKey(QKeyEvent *keyEvent)
+{
+    QTextCursor cursor = m_textEdit->textCursor();
+    if (cursor.hasSelection())
+        return false;
+
+    const bool isDelete = keyEvent == QKeySequence::Delete;
+    QString text;
+    if (keyEvent == QKeySequence::InsertParagraphSeparator) {
+        text = "\n";
+    } else if (keyEvent == QKeySequence::InsertLineSeparator) {
+        text = QChar::LineSeparator;
+    } else if (!isDelete && !isBackspace(keyEvent)) {
+        // Tab is an acceptable input, but it indents the line
+        if (keyEvent->key() == Qt::Key_Tab || keyEvent->key() == Qt::Key_Backtab)
+            return false;
+        auto control = m_textEdit->findChild<QWidgetTextControl *>();
+        if (!control->isAcceptableInput(keyEvent))
+            return false;
+        text = keyEvent->text();
+    }
+
+    // The keys are recorded as if they were typed at the same position, the user may have clicked elsewhere since
+    if (cursor.position() != m_typedKeys.position)
+        flushTypedKeys();
+
+    if (text.isEmpty()) {
+        cursor.movePosition(isDelete ? QTextCursor::NextCharacter : QTextCursor::PreviousCharacter,
+                            QTextCursor::KeepAnchor);
+        const auto removed = static_cast<int>(cursor.selectedText().size());
+        cursor.removeSelectedText();
+        // Deleting the next character and typing before the cursor are independent, the order doesn't matter
+        if (isDelete)
+            m_typedKeys.deletes += removed;
+        else if (m_typedKeys.text.size() >= removed)
+            m_typedKeys.text.chop(removed);
+        else if (m_typedKeys.text.isEmpty())
+            m_typedKeys.backspaces += removed;
+        else
+            flushTypedKeys(); // Part of a surrogate pair typed before, can't happen in practice
+    } else {
+        cursor.insertText(text);
+        m_typedKeys.text += text;
+    }
+    m_textEdit->setTextCursor(cursor);
+    m_typedKeys.position = cursor.position();
+    m_typingTimer.start();
+    return true;
+}
+
+// Records the keys typed since the last call in the history, as if they were typed with the API
+void TextDocument::flushTypedKeys()
+{
+    m_typingTimer.stop();
+    const auto typedKeys = std::exchange(m_typedKeys, {});
+    if (typedKeys.backspaces > 0) {
+        LOG_AND_MERGE("TextDocument::deletePreviousCharacter", typedKeys.backspaces);
+    }
+    if (!typedKeys.text.isEmpty()) {
+        LOG_AND_MERGE("TextDocument::insert", LOG_ARG("text", typedKeys.text));
+    }
+    if (typedKeys.deletes > 0) {
+        LOG_AND_MERGE("TextDocument::deleteNextCharacter", typedKeys.deletes);
+    }
 }
 
 bool TextDocument::eventFilter(QObject *watched, QEvent *event)
 {
-    Q_ASSERT(watched == m_document);
+    Q_ASSERT(watched == m_textEdit);
 
     if (event->type() == QEvent::KeyPress) {
         auto keyEvent = static_cast<QKeyEvent *>(event);
 
+        if (typeKey(keyEvent))
+            return true;
+        // The keys typed so far are recorded before the next call
+        flushTypedKeys();
+
         if (keyEvent == QKeySequence::MoveToNextChar)
             gotoNextChar();
         else if (keyEvent == QKeySequence::MoveToPreviousChar)
@@ -209,11 +469,9 @@ bool TextDocument::eventFilter(QObject *watched, QEvent *event)
         else if (keyEvent == QKeySequence::Paste)
             paste();
         else if (keyEvent == QKeySequence::Delete)
-            m_document->textCursor().hasSelection() ? deleteSelection() : deleteNextCharacter();
-        else if (keyEvent == QKeySequence::Backspace
-                 || (keyEvent->key() == Qt::Key_Backspace
-                     && !(keyEvent->modifiers() & ~Qt::ShiftModifier))) // test is coming from QTextWidgetControl
-            m_document->textCursor().hasSelection() ? deleteSelection() : deletePreviousCharacter();
+            textCursor().hasSelection() ? deleteSelection() : deleteNextCharacter();
+        else if (isBackspace(keyEvent))
+            textCursor().hasSelection() ? deleteSelection() : deletePreviousCharacter();
         else if (keyEvent == QKeySequence::InsertParagraphSeparator)
             insert("\n");
         else if (keyEvent == QKeySequence::InsertLineSeparator)
@@ -227,7 +485,7 @@ bool TextDocument::eventFilter(QObject *watched, QEvent *event)
         else if (keyEvent == QKeySequence::SelectAll)
             selectAll();
         else if (!keyEvent->text().isEmpty()) {
-            auto control = m_document->findChild<QWidgetTextControl *>();
+            auto control = m_textEdit->findChild<QWidgetTextControl *>();
             if (control->isAcceptableInput(keyEvent))
                 insert(keyEvent->text());
         }
@@ -237,50 +495,192 @@ bool TextDocument::eventFilter(QObject *watched, QEvent *event)
     return Document::eventFilter(watched, event);
 }
 
+struct LineEndingCount
+{
+    qsizetype lf = 0;
+    qsizetype crlf = 0;
+    bool firstIsCrlf = false;
+};
+
+// Counts the LF and CRLF line endings in `data`.
+// Searching with indexOf uses the vectorized memchr of the C library, which is a lot faster than checking each byte.
+static LineEndingCount countLineEndings(QByteArrayView data)
+{
+    LineEndingCount count;
+    for (qsizetype pos = data.indexOf('\n'); pos != -1; pos = data.indexOf('\n', pos + 1)) {
+        const bool isCrlf = pos > 0 && data.at(pos - 1) == '\r';
+        if (count.lf + count.crlf == 0)
+            count.firstIsCrlf = isCrlf;
+        if (isCrlf)
+            ++count.crlf;
+        else
+            ++count.lf;
+    }
+    return count;
+}
+
+static QByteArray contentHash(QByteArrayView data)
+{
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha256);
+}
+
+// Returns `data` with all LF line endings replaced by CRLF, in one pass.
+static QByteArray convertToCrlf(QByteArrayView data)
+{
+    QByteArray result;
+    result.reserve(data.size() + data.count('\n'));
+    qsizetype from = 0;
+    for (qsizetype pos = data.indexOf('\n'); pos != -1; pos = data.indexOf('\n', from)) {
+        result.append(data.sliced(from, pos - from));
+        result.append("\r\n");
+        from = pos + 1;
+    }
+    result.append(data.sliced(from));
+    return result;
+}
+
 bool TextDocument::doSave(const QString &fileName)
 {
     Q_ASSERT(!fileName.isEmpty());
 
-    QFile file(fileName);
-    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    QByteArray data = plainText().toUtf8();
+    if (m_lineEnding == CRLFLineEnding)
+        data = convertToCrlf(data);
+    if (m_utf8Bom)
+        data.prepend("\xef\xbb\xbf");
+
+    // With the patch output, the change is added to the project patch instead of writing the file
+    if (Project::recordPatch(fileName, data))
+        return true;
+
+    // Don't touch the file if it already has this exact content: rewriting it would only change its modification time,
+    // and trigger a rebuild of everything depending on it
+    const QByteArray hash = contentHash(data);
+    if (fileName == m_diskFileName && hash == m_diskContentHash && QFile::exists(fileName) && !hasChangedOnDisk())
+        return true;
+
+    // Write to a temporary file first, so the file is never left half-written
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
         setErrorString(file.errorString());
         spdlog::error("Can't save file {}: {}", fileName, errorString());
         return false;
     }
 
-    if (m_utf8Bom)
-        file.write("\xef\xbb\xbf", 3);
+    m_diskFileName = fileName;
+    m_diskContentHash = hash;
+    return true;
+}
 
-    QString plainText = m_document->toPlainText();
-    if (m_lineEnding == CRLFLineEnding)
-        plainText.replace('\n', "\r\n");
+// Decodes the content of a file, like QTextStream would: the encoding is detected from the BOM, and defaults to UTF-8.
+// The BOM itself is not part of the text.
+static QString decodeText(QByteArrayView data)
+{
+    QStringDecoder decoder(QStringDecoder::encodingForData(data).value_or(QStringDecoder::Utf8));
+    return decoder.decode(data);
+}
 
-    QTextStream stream(&file);
-    stream << plainText;
-    return true;
+void TextDocument::setPrefetchedData(QByteArray data)
+{
+    m_prefetchedData = std::move(data);
 }
 
 bool TextDocument::doLoad(const QString &fileName)
 {
     Q_ASSERT(!fileName.isEmpty());
 
-    QFile file(fileName);
-    if (!file.open(QIODevice::ReadOnly)) {
-        setErrorString(file.errorString());
-        spdlog::warn("Can't load file {}: {}", fileName, errorString());
-        return false;
-    }
+    QString text;
+    if (m_prefetchedData) {
+        const QByteArray data = std::exchange(m_prefetchedData, std::nullopt).value();
+        detectFormat(data);
+        text = decodeText(data);
+        m_diskContentHash = contentHash(data);
+    } else {
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly)) {
+            setErrorString(file.errorString());
+            spdlog::warn("Can't load file {}: {}", fileName, errorString());
+            return false;
+        }
 
-    QByteArray data = file.readAll();
-    detectFormat(data);
-    QTextStream stream(data);
-    const QString text = stream.readAll();
+        // Map the file when possible, to decode the text without copying the whole file in memory first
+        const qint64 size = file.size();
+        uchar *mapped = size > 0 ? file.map(0, size) : nullptr;
+        const QByteArray data = mapped ? QByteArray::fromRawData(reinterpret_cast<const char *>(mapped), size)
+                                       : file.readAll();
+        detectFormat(data);
+        text = decodeText(data);
+        m_diskContentHash = contentHash(data);
+        if (mapped)
+            file.unmap(mapped);
+    }
+    m_diskFileName = fileName;
 
-    QSignalBlocker sb(m_document->document());
+    QSignalBlocker sb(m_document);
     // This will replace '\r\n' with '\n'
     m_document->setPlainText(text);
+    // Signals are blocked, so the caches need to be reset manually
+    m_plainText.reset();
+    ++m_contentRevision;
+    m_lineIndex->invalidate();
+    setTextCursor(QTextCursor(m_document));
     setHasChanged(false);
 
+    const bool largeFile = (m_largeFileSize > 0 && m_document->characterCount() > m_largeFileSize)
+        || (m_largeFileLines > 0 && m_document->blockCount() > m_largeFileLines);
+    if (largeFile && !m_undoRedoEnabledForLargeFiles)
+        m_document->setUndoRedoEnabled(false);
+    if (largeFile != m_largeFile) {
+        m_largeFile = largeFile;
+        emit largeFileChanged();
+    }
+
+    return true;
+}
+
+// Only the part of the text that changed is replaced, if it's small enough: the marks and the cursor are kept, and the
+// syntax tree and the language server get an incremental change
+bool TextDocument::doRefresh()
+{
+    QFile file(fileName());
+    if (!file.open(QIODevice::ReadOnly))
+        return Document::doRefresh();
+    QByteArray data = file.readAll();
+
+    const QByteArray hash = contentHash(data);
+    if (fileName() == m_diskFileName && hash == m_diskContentHash)
+        return false;
+
+    detectFormat(data);
+    QString text = decodeText(data);
+    text.replace("\r\n", "\n");
+    const QString current = plainText();
+    if (text == current) {
+        m_diskFileName = fileName();
+        m_diskContentHash = hash;
+        return false;
+    }
+
+    const auto commonSize = std::min(text.size(), current.size());
+    qsizetype prefix = 0;
+    while (prefix < commonSize && text.at(prefix) == current.at(prefix))
+        ++prefix;
+    qsizetype suffix = 0;
+    while (suffix < commonSize - prefix && text.at(text.size() - 1 - suffix) == current.at(current.size() - 1 - suffix))
+        ++suffix;
+    const auto changedSize = text.size() - prefix - suffix;
+    if (changedSize > text.size() / 2) {
+        setPrefetchedData(std::move(data));
+        return Document::doRefresh();
+    }
+
+    QTextCursor cursor(m_document);
+    cursor.setPosition(static_cast<int>(prefix));
+    cursor.setPosition(static_cast<int>(current.size() - suffix), QTextCursor::KeepAnchor);
+    cursor.insertText(text.sliced(prefix, changedSize));
+    m_diskFileName = fileName();
+    m_diskContentHash = hash;
+    setHasChanged(false);
     return true;
 }
 
@@ -296,51 +696,53 @@ void TextDocument::detectFormat(const QByteArray &data)
         m_utf8Bom = true;
 
     // end code taken from qtextstream
-    const int newLinePos = data.indexOf('\n');
-    if (newLinePos == -1)
+
+    // With mixed line endings, use the most common one, as all lines will use the same one when saving
+    const auto count = countLineEndings(data);
+    if (count.lf + count.crlf == 0)
         setLineEnding(NativeLineEnding);
-    else if (newLinePos == 0)
-        setLineEnding(LFLineEnding);
+    else if (count.lf == count.crlf)
+        setLineEnding(count.firstIsCrlf ? CRLFLineEnding : LFLineEnding);
     else
-        setLineEnding(data.at(newLinePos - 1) == '\r' ? CRLFLineEnding : LFLineEnding);
+        setLineEnding(count.crlf > count.lf ? CRLFLineEnding : LFLineEnding);
 }
 
 int TextDocument::column() const
 {
     LOG("TextDocument::column");
-    const QTextCursor cursor = m_document->textCursor();
+    const QTextCursor cursor = textCursor();
     LOG_RETURN("column", cursor.positionInBlock() + 1);
 }
 
 int TextDocument::line() const
 {
     LOG("TextDocument::line");
-    const QTextCursor cursor = m_document->textCursor();
+    const QTextCursor cursor = textCursor();
     LOG_RETURN("line", cursor.blockNumber() + 1);
 }
 
 int TextDocument::lineCount() const
 {
     LOG("TextDocument::lineCount");
-    return m_document->document()->lineCount();
+    return m_document->lineCount();
 }
 
 int TextDocument::position() const
 {
     LOG("TextDocument::position");
-    LOG_RETURN("pos", m_document->textCursor().position());
+    LOG_RETURN("pos", textCursor().position());
 }
 
 int TextDocument::selectionStart() const
 {
     LOG("TextDocument::selectionStart");
-    LOG_RETURN("pos", m_document->textCursor().selectionStart());
+    LOG_RETURN("pos", textCursor().selectionStart());
 }
 
 int TextDocument::selectionEnd() const
 {
     LOG("TextDocument::selectionEnd");
-    LOG_RETURN("pos", m_document->textCursor().selectionEnd());
+    LOG_RETURN("pos", textCursor().selectionEnd());
 }
 
 void TextDocument::setPosition(int newPosition)
@@ -349,29 +751,34 @@ void TextDocument::setPosition(int newPosition)
 
     if (position() == newPosition)
         return;
-    auto cursor = m_document->textCursor();
+    auto cursor = textCursor();
     cursor.setPosition(newPosition);
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
     emit positionChanged();
 }
 
 void TextDocument::convertPosition(int pos, int *line, int *column) const
 {
     Q_ASSERT(line && column);
-    const QTextBlock block = m_document->document()->findBlock(pos);
-    if (!block.isValid()) {
+    const int lineNumber = m_lineIndex->lineAt(pos);
+    if (lineNumber == -1) {
         (*line) = -1;
         (*column) = -1;
     } else {
         // line and column are both 1-based
-        (*line) = block.blockNumber() + 1;
-        (*column) = pos - block.position() + 1;
+        (*line) = lineNumber + 1;
+        (*column) = pos - m_lineIndex->lineStart(lineNumber) + 1;
     }
 }
 
+const LineIndex &TextDocument::lineIndex() const
+{
+    return *m_lineIndex;
+}
+
 int TextDocument::position(QTextCursor::MoveOperation operation, int pos) const
 {
-    auto cursor = m_document->textCursor();
+    auto cursor = textCursor();
 
     if (pos != -1)
         cursor.setPosition(pos);
@@ -416,18 +823,141 @@ int TextDocument::columnAtPosition(int position)
 int TextDocument::positionAt(int line, int column)
 {
     LOG("TextDocument::positionAt", LOG_ARG("line", line), LOG_ARG("column", column));
-    const QTextBlock block = m_document->document()->findBlockByLineNumber(line - 1);
-    if (!block.isValid()) {
+    const int start = m_lineIndex->lineStart(line - 1);
+    if (start == -1) {
         return -1;
     } else {
-        return block.position() + column - 1;
+        return start + column - 1;
     }
 }
 
+/*!
+ * \qmlmethod string TextDocument::textRegion(int from, int to)
+ * Returns the text between `from` and `to` positions, or an empty string if the positions are invalid.
+ */
+QString TextDocument::textRegion(int from, int to)
+{
+    LOG("TextDocument::textRegion", from, to);
+    const QString text = plainText();
+    if (from < 0 || from > to || to > text.size())
+        return {};
+    return text.sliced(from, to - from);
+}
+
+/*!
+ * \qmlmethod array<string> TextDocument::textRegions(array<int> positions)
+ * Returns the texts of all the regions passed as a flat array of positions: `[start0, end0, start1, end1, ...]`.
+ *
+ * This is one call for all regions, and works well with `CodeDocument::queryRanges`. The text of an invalid region is
+ * an empty string.
+ */
+QStringList TextDocument::textRegions(const QList<int> &positions)
+{
+    LOG("TextDocument::textRegions");
+    if (positions.size() % 2 != 0)
+        spdlog::warn("TextDocument::textRegions - odd number of positions, the last one is ignored");
+
+    const QString text = plainText();
+    QStringList result;
+    result.reserve(positions.size() / 2);
+    for (int i = 0; i + 1 < positions.size(); i += 2) {
+        const int from = positions.at(i);
+        const int to = positions.at(i + 1);
+        if (from < 0 || from > to || to > text.size())
+            result.push_back({});
+        else
+            result.push_back(text.sliced(from, to - from));
+    }
+    return result;
+}
+
+/*!
+ * \qmlmethod array<int> TextDocument::lineColumns(array<RangeMark> ranges)
+ * Returns the lines and columns of all the `ranges`, as a flat array:
+ * `[startLine0, startColumn0, endLine0, endColumn0, startLine1, ...]`. Lines and columns are 1-based, they are -1 for
+ * an invalid range, or a range of another document.
+ *
+ * This is one call for all ranges, converted in one sweep over the lines of the document: use it to report the
+ * locations of many query matches.
+ */
+QList<int> TextDocument::lineColumns(const Core::RangeMarkList &ranges)
+{
+    LOG("TextDocument::lineColumns");
+
+    std::vector<int> positions;
+    positions.reserve(ranges.size() * 2);
+    for (const auto &range : ranges) {
+        const bool valid = range.isValid() && range.document() == this;
+        positions.push_back(valid ? range.start() : -1);
+        positions.push_back(valid ? range.end() : -1);
+    }
+
+    QList<int> result;
+    result.reserve(positions.size() * 2);
+    for (const auto &[line, column] : lineIndex().lineColumns(positions)) {
+        // line and column are both 1-based
+        result.push_back(line == -1 ? -1 : line + 1);
+        result.push_back(column == -1 ? -1 : column + 1);
+    }
+    return result;
+}
+
+/*!
+ * \qmlmethod array<string> TextDocument::lines(int from = 1, int to = -1)
+ * Returns the text of the lines from `from` to `to` included, without the line separators. If `to` is -1, returns the
+ * lines up to the end of the document. `from` and `to` are 1-based.
+ *
+ * It's one call for all the lines, a lot faster than going to each line with `gotoLine` and reading `currentLine`.
+ */
+QStringList TextDocument::lines(int from, int to)
+{
+    LOG("TextDocument::lines", from, to);
+    const auto &index = lineIndex();
+    if (to == -1)
+        to = index.lineCount();
+    if (from < 1 || from > to || to > index.lineCount()) {
+        spdlog::error("TextDocument::lines - invalid lines {} to {}", from, to);
+        return {};
+    }
+
+    const QString text = plainText();
+    QStringList result;
+    result.reserve(to - from + 1);
+    for (int line = from - 1; line < to; ++line)
+        result.push_back(text.sliced(index.lineStart(line), index.lineLength(line)));
+    return result;
+}
+
 QString TextDocument::text() const
 {
     LOG("TextDocument::text");
-    LOG_RETURN("text", m_document->toPlainText());
+    LOG_RETURN("text", plainText());
+}
+
+QString TextDocument::plainText() const
+{
+    // The cache is reset on each change of the document, but beware that changes inside an edit block are only
+    // notified at the end of the block
+    if (!m_plainText)
+        m_plainText = m_document->toPlainText();
+    return *m_plainText;
+}
+
+QVariantMap TextDocument::memoryUsage() const
+{
+    // The layout of the QTextDocument blocks is not counted, only the text itself
+    qint64 textBytes = m_document->characterCount() * sizeof(QChar);
+    if (m_plainText)
+        textBytes += m_plainText->size() * sizeof(QChar);
+    // Each mark owns one tracked position, each range mark two
+    const qint64 markBytes = m_markTracker->count() * (sizeof(TrackedPosition *) + sizeof(MarkPrivate));
+    return {{"text", textBytes}, {"marks", markBytes}};
+}
+
+// Incremented on each change of the text, so caches computed from the text can detect they are outdated
+int TextDocument::contentRevision() const
+{
+    return m_contentRevision;
 }
 
 void TextDocument::setText(const QString &newText)
@@ -435,12 +965,13 @@ void TextDocument::setText(const QString &newText)
     LOG("TextDocument::text", LOG_ARG("text", newText));
 
     m_document->setPlainText(newText);
+    setTextCursor(QTextCursor(m_document));
 }
 
 QString TextDocument::currentLine() const
 {
     LOG("TextDocument::currentLine");
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.movePosition(QTextCursor::StartOfLine);
     cursor.movePosition(QTextCursor::EndOfLine, QTextCursor::KeepAnchor);
     LOG_RETURN("text", cursor.selectedText());
@@ -449,7 +980,7 @@ QString TextDocument::currentLine() const
 QString TextDocument::currentWord() const
 {
     LOG("TextDocument::currentWord");
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.movePosition(QTextCursor::StartOfWord);
     cursor.movePosition(QTextCursor::EndOfWord, QTextCursor::KeepAnchor);
     LOG_RETURN("text", cursor.selectedText());
@@ -459,7 +990,7 @@ QString TextDocument::selectedText() const
 {
     LOG("TextDocument::selectedText");
     // Replace \u2029 with \n
-    const QString text = m_document->textCursor().selectedText().replace(QChar(8233), "\n");
+    const QString text = textCursor().selectedText().replace(QChar(8233), "\n");
     LOG_RETURN("text", text);
 }
 
@@ -473,11 +1004,96 @@ bool TextDocument::hasUtf8Bom() const
     return m_utf8Bom;
 }
 
+void TextDocument::setLargeFileThresholds(int size, int lines)
+{
+    m_largeFileSize = size;
+    m_largeFileLines = lines;
+}
+
+bool TextDocument::isLargeFile() const
+{
+    return m_largeFile;
+}
+
+QStringList TextDocument::degradedFeatures() const
+{
+    if (!m_largeFile)
+        return {};
+    QStringList features {"highlighting"};
+    if (!m_document->isUndoRedoEnabled())
+        features.push_back("undo");
+    return features;
+}
+
+/**
+ * \brief Returns the editor used to display the document
+ *
+ * The editor is only created when needed, usually when the document is displayed. Until then, the document is
+ * handled directly on the `QTextDocument`, which avoids the cost of a widget when running Knut without a GUI.
+ */
 QPlainTextEdit *TextDocument::textEdit() const
+{
+    if (!m_textEdit) {
+        auto self = const_cast<TextDocument *>(this);
+        m_textEdit = new TextEditor;
+        m_textEdit->hide();
+        m_textEdit->setDocument(m_document);
+        m_textEdit->setTextCursor(m_cursor);
+        connect(m_textEdit, &QPlainTextEdit::selectionChanged, self, &TextDocument::selectionChanged);
+        connect(m_textEdit, &QPlainTextEdit::cursorPositionChanged, self, &TextDocument::positionChanged);
+        m_textEdit->installEventFilter(self);
+    }
+    return m_textEdit;
+}
+
+void TextDocument::doEvict()
+{
+    // Only the hidden editors created for the scripts, not the ones displayed in a view
+    if (m_textEdit && !m_textEdit->parentWidget()) {
+        m_cursor = m_textEdit->textCursor();
+        delete m_textEdit;
+    }
+    m_plainText.reset();
+}
+
+/**
+ * \brief Returns the underlying `QTextDocument`
+ */
+QTextDocument *TextDocument::qTextDocument() const
 {
     return m_document;
 }
 
+/**
+ * \brief Returns the text cursor of the document, the one from the editor if it exists
+ */
+QTextCursor TextDocument::textCursor() const
+{
+    if (m_textEdit)
+        return m_textEdit->textCursor();
+    return m_cursor;
+}
+
+/**
+ * \brief Sets the text cursor of the document, notifying position and selection changes
+ */
+void TextDocument::setTextCursor(const QTextCursor &cursor)
+{
+    if (m_textEdit) {
+        m_textEdit->setTextCursor(cursor);
+        return;
+    }
+
+    const bool positionHasChanged = cursor.position() != m_cursor.position();
+    const bool selectionHasChanged = (cursor.hasSelection() || m_cursor.hasSelection())
+        && (cursor.selectionStart() != m_cursor.selectionStart() || cursor.selectionEnd() != m_cursor.selectionEnd());
+    m_cursor = cursor;
+    if (positionHasChanged)
+        emit positionChanged();
+    if (selectionHasChanged)
+        emit selectionChanged();
+}
+
 /**
  * \brief Returns the string when pressing on the tab key
  */
@@ -496,10 +1112,13 @@ QString TextDocument::tab() const
 void TextDocument::undo(int count)
 {
     LOG_AND_MERGE("TextDocument::undo", count);
+    auto cursor = textCursor();
     while (count != 0) {
-        m_document->undo();
+        for (int steps = undoStepCount(false); steps > 0; --steps)
+            m_document->undo(&cursor);
         --count;
     }
+    setTextCursor(cursor);
 }
 
 /*!
@@ -509,17 +1128,76 @@ void TextDocument::undo(int count)
 void TextDocument::redo(int count)
 {
     LOG_AND_MERGE("TextDocument::redo", count);
+    auto cursor = textCursor();
     while (count != 0) {
-        m_document->redo();
+        for (int steps = undoStepCount(true); steps > 0; --steps)
+            m_document->redo(&cursor);
         --count;
     }
+    setTextCursor(cursor);
+}
+
+void TextDocument::beginUndoGroup()
+{
+    m_currentUndoGroupId = ++m_lastUndoGroupId;
+}
+
+void TextDocument::endUndoGroup()
+{
+    m_currentUndoGroupId = 0;
+}
+
+void TextDocument::setUndoRedoEnabledForNewDocuments(bool enabled)
+{
+    m_undoRedoEnabledForNewDocuments = enabled;
+}
+
+void TextDocument::setUndoRedoEnabledForLargeFiles(bool enabled)
+{
+    m_undoRedoEnabledForLargeFiles = enabled;
+}
+
+void TextDocument::addUndoStep()
+{
+    // The new step replaces all the redo steps
+    const int step = m_document->availableUndoSteps() - 1;
+    std::erase_if(m_undoGroups, [step](const UndoGroup &group) {
+        return group.start >= step;
+    });
+    if (!m_undoGroups.empty() && m_undoGroups.back().end > step)
+        m_undoGroups.back().end = step;
+
+    if (m_currentUndoGroupId == 0)
+        return;
+    if (!m_undoGroups.empty() && m_undoGroups.back().id == m_currentUndoGroupId && m_undoGroups.back().end == step)
+        m_undoGroups.back().end = step + 1;
+    else
+        m_undoGroups.push_back({step, step + 1, m_currentUndoGroupId});
+}
+
+// Returns the number of steps to undo or redo at once: all the steps of a group, or a single one.
+int TextDocument::undoStepCount(bool redo)
+{
+    // Setting the text or disabling undo clears the undo stack
+    const int undoSteps = m_document->availableUndoSteps();
+    if (!m_undoGroups.empty() && m_undoGroups.back().end > undoSteps + m_document->availableRedoSteps())
+        m_undoGroups.clear();
+
+    // Undoing while recording a group: the script expects its own steps to be undone one by one
+    if (m_currentUndoGroupId != 0 && !m_undoGroups.empty() && m_undoGroups.back().id == m_currentUndoGroupId)
+        m_undoGroups.pop_back();
+
+    auto it = std::ranges::find_if(m_undoGroups, [redo, undoSteps](const UndoGroup &group) {
+        return redo ? group.start == undoSteps : group.end == undoSteps;
+    });
+    return it == m_undoGroups.end() ? 1 : it->end - it->start;
 }
 
 void TextDocument::movePosition(QTextCursor::MoveOperation operation, QTextCursor::MoveMode mode, int count)
 {
-    auto cursor = m_document->textCursor();
+    auto cursor = textCursor();
     cursor.movePosition(operation, mode, count);
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -532,22 +1210,133 @@ void TextDocument::gotoLine(int line, int column)
 {
     LOG("TextDocument::gotoLine", LOG_ARG("line", line), LOG_ARG("column", column));
 
-    gotoLineInTextEdit(m_document, line, column);
+    const QTextCursor cursor = cursorAtLine(m_document, line, column);
+    if (!cursor.isNull())
+        setTextCursor(cursor);
 }
 
-void gotoLineInTextEdit(QPlainTextEdit *textEdit, int line, int column)
+QTextCursor cursorAtLine(QTextDocument *document, int line, int column)
 {
     // Internally, columns are 0-based, while 1-based on the API
     column = column - 1;
-    const int blockNumber = qMin(line, textEdit->document()->blockCount()) - 1;
-    const QTextBlock &block = textEdit->document()->findBlockByNumber(blockNumber);
-    if (block.isValid()) {
-        QTextCursor cursor(block);
-        if (column > 0)
-            cursor.movePosition(QTextCursor::Right, QTextCursor::MoveAnchor, column);
+    const int blockNumber = qMin(line, document->blockCount()) - 1;
+    const QTextBlock &block = document->findBlockByNumber(blockNumber);
+    if (!block.isValid())
+        return {};
 
+    QTextCursor cursor(block);
+    if (column > 0)
+        cursor.movePosition(QTextCursor::Right, QTextCursor::MoveAnchor, column);
+    return cursor;
+}
+
+void gotoLineInTextEdit(QPlainTextEdit *textEdit, int line, int column)
+{
+    const QTextCursor cursor = cursorAtLine(textEdit->document(), line, column);
+    if (!cursor.isNull())
         textEdit->setTextCursor(cursor);
+}
+
+LineIndex::LineIndex(QTextDocument *document)
+    : m_document(document)
+{
+}
+
+int LineIndex::lineCount() const
+{
+    ensureBuilt();
+    return static_cast<int>(m_lineStarts.size());
+}
+
+int LineIndex::lineAt(int position) const
+{
+    // The last position is the one after the last character
+    if (position < 0 || position >= m_document->characterCount())
+        return -1;
+    ensureBuilt();
+    const auto it = std::upper_bound(m_lineStarts.cbegin(), m_lineStarts.cend(), position);
+    return static_cast<int>(std::distance(m_lineStarts.cbegin(), it)) - 1;
+}
+
+int LineIndex::lineStart(int line) const
+{
+    if (line < 0 || line >= lineCount())
+        return -1;
+    return m_lineStarts[line];
+}
+
+int LineIndex::lineLength(int line) const
+{
+    if (line < 0 || line >= lineCount())
+        return -1;
+    // Both the line separators and the last position take one character
+    const int nextStart = line + 1 < lineCount() ? m_lineStarts[line + 1] : m_document->characterCount();
+    return nextStart - m_lineStarts[line] - 1;
+}
+
+std::vector<std::pair<int, int>> LineIndex::lineColumns(const std::vector<int> &positions) const
+{
+    ensureBuilt();
+    std::vector<std::size_t> order(positions.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::ranges::stable_sort(order, {}, [&positions](std::size_t index) {
+        return positions[index];
+    });
+
+    std::vector<std::pair<int, int>> result(positions.size(), {-1, -1});
+    const int characterCount = m_document->characterCount();
+    std::size_t line = 0;
+    for (const auto index : order) {
+        const int position = positions[index];
+        // The last position is the one after the last character
+        if (position < 0 || position >= characterCount)
+            continue;
+        while (line + 1 < m_lineStarts.size() && m_lineStarts[line + 1] <= position)
+            ++line;
+        result[index] = {static_cast<int>(line), position - m_lineStarts[line]};
     }
+    return result;
+}
+
+void LineIndex::update(int position, int charsRemoved, int charsAdded)
+{
+    if (m_lineStarts.empty())
+        return;
+
+    // Lines starting inside the removed text are gone, the following ones are moved
+    const auto first = std::upper_bound(m_lineStarts.begin(), m_lineStarts.end(), position);
+    const auto last = std::upper_bound(first, m_lineStarts.end(), position + charsRemoved);
+    std::for_each(last, m_lineStarts.end(), [delta = charsAdded - charsRemoved](int &start) {
+        start += delta;
+    });
+
+    // The new lines come from the blocks in the added text
+    std::vector<int> addedStarts;
+    const int addedEnd = position + charsAdded;
+    for (auto block = m_document->findBlock(position).next(); block.isValid() && block.position() <= addedEnd;
+         block = block.next()) {
+        addedStarts.push_back(block.position());
+    }
+    const auto it = m_lineStarts.erase(first, last);
+    m_lineStarts.insert(it, addedStarts.cbegin(), addedStarts.cend());
+
+    // QTextDocument sometimes reports more than what was changed, rebuild if the table doesn't match anymore
+    if (static_cast<int>(m_lineStarts.size()) != m_document->blockCount())
+        invalidate();
+}
+
+void LineIndex::invalidate()
+{
+    m_lineStarts.clear();
+}
+
+void LineIndex::ensureBuilt() const
+{
+    if (!m_lineStarts.empty())
+        return;
+    m_lineStarts.reserve(m_document->blockCount());
+    for (auto block = m_document->begin(); block.isValid(); block = block.next())
+        m_lineStarts.push_back(block.position());
 }
 
 /*!
@@ -677,9 +1466,9 @@ void TextDocument::gotoEndOfDocument()
 void TextDocument::unselect()
 {
     LOG("TextDocument::unselect");
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.clearSelection();
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -689,7 +1478,7 @@ void TextDocument::unselect()
 bool TextDocument::hasSelection()
 {
     LOG("TextDocument::hasSelection");
-    return m_document->textCursor().hasSelection();
+    return textCursor().hasSelection();
 }
 
 /*!
@@ -699,7 +1488,9 @@ bool TextDocument::hasSelection()
 void TextDocument::selectAll()
 {
     LOG("TextDocument::selectAll");
-    m_document->selectAll();
+    QTextCursor cursor = textCursor();
+    cursor.select(QTextCursor::Document);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -709,9 +1500,9 @@ void TextDocument::selectAll()
 void TextDocument::selectTo(int pos)
 {
     LOG("TextDocument::selectTo", LOG_ARG("pos", pos));
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.setPosition(pos, QTextCursor::KeepAnchor);
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -821,10 +1612,10 @@ void TextDocument::selectNextWord(int count)
 void TextDocument::selectRegion(int from, int to)
 {
     LOG("TextDocument::selectRegion", from, to);
-    QTextCursor cursor(m_document->document());
+    QTextCursor cursor(m_document);
     cursor.setPosition(from, QTextCursor::MoveAnchor);
     cursor.setPosition(to, QTextCursor::KeepAnchor);
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -844,7 +1635,9 @@ void TextDocument::selectRange(const TextRange &range)
 void TextDocument::copy()
 {
     LOG("TextDocument::copy");
-    m_document->copy();
+    if (!hasClipboard("TextDocument::copy"))
+        return;
+    textEdit()->copy();
 }
 
 /*!
@@ -854,7 +1647,9 @@ void TextDocument::copy()
 void TextDocument::paste()
 {
     LOG("TextDocument::paste");
-    m_document->paste();
+    if (!hasClipboard("TextDocument::paste"))
+        return;
+    textEdit()->paste();
 }
 
 /*!
@@ -864,7 +1659,9 @@ void TextDocument::paste()
 void TextDocument::cut()
 {
     LOG("TextDocument::cut");
-    m_document->cut();
+    if (!hasClipboard("TextDocument::cut"))
+        return;
+    textEdit()->cut();
 }
 
 /*!
@@ -874,10 +1671,10 @@ void TextDocument::cut()
 void TextDocument::remove(int length)
 {
     LOG("TextDocument::remove", length);
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.setPosition(cursor.position() + length, QTextCursor::KeepAnchor);
     cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -887,7 +1684,9 @@ void TextDocument::remove(int length)
 void TextDocument::insert(const QString &text)
 {
     LOG_AND_MERGE("TextDocument::insert", LOG_ARG("text", text));
-    m_document->insertPlainText(text);
+    QTextCursor cursor = textCursor();
+    cursor.insertText(text);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -901,10 +1700,10 @@ void TextDocument::insertAtLine(const QString &text, int line)
     else
         LOG("TextDocument::insertAtLine", LOG_ARG("text", text), LOG_ARG("line", line));
 
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     if (line > 0) {
-        const int blockNumber = qMin(line, m_document->document()->blockCount()) - 1;
-        const QTextBlock &block = m_document->document()->findBlockByNumber(blockNumber);
+        const int blockNumber = qMin(line, m_document->blockCount()) - 1;
+        const QTextBlock &block = m_document->findBlockByNumber(blockNumber);
         if (block.isValid())
             cursor = QTextCursor(block);
     }
@@ -918,7 +1717,7 @@ void TextDocument::insertAtLine(const QString &text, int line)
 void TextDocument::insertAtPosition(const QString &text, int pos)
 {
     LOG("TextDocument::insertAtPosition", text, pos);
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.setPosition(pos);
     cursor.beginEditBlock();
     cursor.movePosition(QTextCursor::EndOfLine, QTextCursor::KeepAnchor);
@@ -933,10 +1732,10 @@ void TextDocument::insertAtPosition(const QString &text, int pos)
 void TextDocument::replace(int length, const QString &text)
 {
     LOG("TextDocument::replace", length, text);
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.setPosition(cursor.position() + length, QTextCursor::KeepAnchor);
     cursor.insertText(text);
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -946,11 +1745,11 @@ void TextDocument::replace(int length, const QString &text)
 void TextDocument::replace(int from, int to, const QString &text)
 {
     LOG("TextDocument::replace", from, to, text);
-    QTextCursor cursor(m_document->document());
+    QTextCursor cursor(m_document);
     cursor.setPosition(from);
     cursor.setPosition(to, QTextCursor::KeepAnchor);
     cursor.insertText(text);
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -963,6 +1762,208 @@ void TextDocument::replace(const TextRange &range, const QString &text)
     replace(range.start, range.end, text);
 }
 
+/*!
+ * \qmlmethod bool TextDocument::applyEdits(array<object> edits)
+ * Applies all the `edits` at once, and returns true on success.
+ *
+ * Each edit is an object with `start`, `end` and `text` properties, and replaces the text from `start` to `end` with
+ * `text`. Positions are in the text before any edit, and edits can't overlap. Insertions at the same position are
+ * done in the order of the `edits` array.
+ *
+ * It's a lot faster than calling `replace` for each edit, as the language server and Tree-sitter are only notified
+ * once. The edits are undone in one step.
+ *
+ * ```js
+ * let edits = document.query("(identifier) @id").map(match => {
+ *     let range = match.get("id");
+ *     return {start: range.start, end: range.end, text: range.text.toUpperCase()};
+ * });
+ * document.applyEdits(edits);
+ * ```
+ */
+bool TextDocument::applyEdits(const QVariantList &edits)
+{
+    LOG("TextDocument::applyEdits", LOG_ARG("count", static_cast<int>(edits.size())));
+
+    QVector<TextEdit> textEdits;
+    textEdits.reserve(edits.size());
+    for (const auto &edit : edits) {
+        const auto map = edit.toMap();
+        if (!map.contains("start") || !map.contains("end")) {
+            spdlog::error("TextDocument::applyEdits: edits need a start and an end");
+            return false;
+        }
+        textEdits.push_back({{map.value("start").toInt(), map.value("end").toInt()}, map.value("text").toString()});
+    }
+    return applyEdits(std::move(textEdits));
+}
+
+bool TextDocument::applyEdits(QVector<TextEdit> edits)
+{
+    // Apply the edits back-to-front, so the positions of the remaining ones are still valid.
+    // Reversing first keeps insertions at the same position in their original order in the document.
+    std::ranges::reverse(edits);
+    std::ranges::stable_sort(edits, std::ranges::greater {}, [](const TextEdit &edit) {
+        return std::pair(edit.range.start, edit.range.end);
+    });
+
+    const int length = m_document->characterCount() - 1;
+    for (int i = 0; i < edits.size(); ++i) {
+        const auto &range = edits.at(i).range;
+        if (range.start < 0 || range.start > range.end || range.end > length) {
+            spdlog::error("TextDocument::applyEdits: invalid range {}", range.toString());
+            return false;
+        }
+        if (i > 0 && range.end > edits.at(i - 1).range.start) {
+            spdlog::error("TextDocument::applyEdits: ranges {} and {} overlap", range.toString(),
+                          edits.at(i - 1).range.toString());
+            return false;
+        }
+    }
+    if (edits.isEmpty())
+        return true;
+
+    // All changes are reported with a single contentsChange signal at the end of the edit block, covering all the
+    // edits. Marks are updated for each edit instead, so the ones between the edits don't move.
+    m_applyingEdits = true;
+    QTextCursor cursor(m_document);
+    cursor.beginEditBlock();
+    for (const auto &edit : std::as_const(edits)) {
+        cursor.setPosition(edit.range.start);
+        cursor.setPosition(edit.range.end, QTextCursor::KeepAnchor);
+        cursor.insertText(edit.text);
+        m_markTracker->update(edit.range.start, edit.range.length(), static_cast<int>(edit.text.size()));
+    }
+    cursor.endEditBlock();
+    m_applyingEdits = false;
+
+    setTextCursor(cursor);
+    return true;
+}
+
+/*!
+ * \qmlmethod bool TextDocument::setLines(int from, int to, array<string> texts)
+ * Replaces the lines from `from` to `to` included with `texts`, one line for each string, and returns true on success.
+ * `from` and `to` are 1-based.
+ *
+ * The number of lines can change: an empty `texts` removes the lines, and `to` equal to `from - 1` inserts the lines
+ * before `from` without removing any. The change is applied at once, like `applyEdits`.
+ *
+ * ```js
+ * let lines = document.lines(10, 20).map(line => line.trimEnd());
+ * document.setLines(10, 20, lines);
+ * ```
+ */
+bool TextDocument::setLines(int from, int to, const QStringList &texts)
+{
+    LOG("TextDocument::setLines", from, to, LOG_ARG("count", static_cast<int>(texts.size())));
+    const int count = lineIndex().lineCount();
+    if (from < 1 || from > count + 1 || to < from - 1 || to > count) {
+        spdlog::error("TextDocument::setLines - invalid lines {} to {}", from, to);
+        return false;
+    }
+    if (to < from && texts.isEmpty())
+        return true;
+    return applyEdits(QVector<TextEdit> {linesEdit(from, to, texts)});
+}
+
+/*!
+ * \qmlmethod bool TextDocument::editLines(function callback)
+ * Calls `callback` with the text and the 1-based number of each line of the document, then applies all the changes
+ * at once, and returns true on success.
+ *
+ * The callback returns the new text of the line, or an array of strings to replace the line with several ones (an
+ * empty array removes the line). Any other value keeps the line unchanged. The callback must not change the document.
+ *
+ * It's a lot faster than editing the lines one by one: the language server and Tree-sitter are only notified once,
+ * and the change is undone in one step.
+ *
+ * ```js
+ * document.editLines((line, number) => {
+ *     if (line.startsWith("#pragma region") || line.startsWith("#pragma endregion"))
+ *         return [];
+ *     return line.trimEnd();
+ * });
+ * ```
+ */
+bool TextDocument::editLines(const QJSValue &callback)
+{
+    LOG("TextDocument::editLines");
+    if (!callback.isCallable()) {
+        spdlog::error("TextDocument::editLines - the callback is not a function");
+        return false;
+    }
+
+    const auto &index = lineIndex();
+    const QString text = plainText();
+    const int count = index.lineCount();
+    const int revision = contentRevision();
+    // New lines for each line changed by the callback
+    std::vector<std::optional<QStringList>> replacements(count);
+    for (int line = 0; line < count; ++line) {
+        const QString current = text.sliced(index.lineStart(line), index.lineLength(line));
+        const auto result = callback.call({QJSValue(current), QJSValue(line + 1)});
+        if (result.isError()) {
+            spdlog::error("TextDocument::editLines - {}", result.toString());
+            return false;
+        }
+        if (contentRevision() != revision) {
+            spdlog::error("TextDocument::editLines - the document was changed by the callback");
+            return false;
+        }
+        if (result.isString()) {
+            if (auto newText = result.toString(); newText != current)
+                replacements[line] = QStringList {std::move(newText)};
+        } else if (result.isArray()) {
+            replacements[line] = result.toVariant().toStringList();
+        }
+    }
+
+    // Consecutive changed lines are replaced by one edit, as removing a line also removes one of its separators
+    QVector<TextEdit> edits;
+    for (int line = 0; line < count;) {
+        if (!replacements[line]) {
+            ++line;
+            continue;
+        }
+        const int from = line;
+        QStringList texts;
+        for (; line < count && replacements[line]; ++line)
+            texts.append(*replacements[line]);
+        edits.push_back(linesEdit(from + 1, line, texts));
+    }
+    return applyEdits(std::move(edits));
+}
+
+TextEdit TextDocument::linesEdit(int from, int to, const QStringList &texts) const
+{
+    const auto &index = lineIndex();
+    const int count = index.lineCount();
+    const auto lineEnd = [&index](int line) {
+        return index.lineStart(line) + index.lineLength(line);
+    };
+
+    // Insertion before `from`, or after the last line
+    if (to < from) {
+        if (from <= count) {
+            const int position = index.lineStart(from - 1);
+            return {{position, position}, texts.join('\n') + '\n'};
+        }
+        const int position = lineEnd(count - 1);
+        return {{position, position}, '\n' + texts.join('\n')};
+    }
+
+    TextRange range {index.lineStart(from - 1), lineEnd(to - 1)};
+    if (texts.isEmpty()) {
+        // Remove the lines with one of their separators: the following one, or the previous one for the last lines
+        if (to < count)
+            range.end = index.lineStart(to);
+        else if (from > 1)
+            range.start = lineEnd(from - 2);
+    }
+    return {range, texts.join('\n')};
+}
+
 /*!
  * \qmlmethod TextDocument::deleteLine(int line = -1)
  * Remove a the line `line`. If `line` is -1, remove the current line. `line` is 1-based.
@@ -974,10 +1975,10 @@ void TextDocument::deleteLine(int line)
     else
         LOG("TextDocument::deleteLine", LOG_ARG("line", line));
 
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     if (line > 0) {
-        const int blockNumber = qMin(line, m_document->document()->blockCount()) - 1;
-        const QTextBlock &block = m_document->document()->findBlockByNumber(blockNumber);
+        const int blockNumber = qMin(line, m_document->blockCount()) - 1;
+        const QTextBlock &block = m_document->findBlockByNumber(blockNumber);
         if (block.isValid())
             cursor = QTextCursor(block);
     } else {
@@ -994,7 +1995,7 @@ void TextDocument::deleteLine(int line)
 void TextDocument::deleteSelection()
 {
     LOG("TextDocument::deleteSelection");
-    m_document->textCursor().removeSelectedText();
+    textCursor().removeSelectedText();
 }
 
 /*!
@@ -1004,11 +2005,11 @@ void TextDocument::deleteSelection()
 void TextDocument::deleteRegion(int from, int to)
 {
     LOG("TextDocument::deleteRegion", from, to);
-    QTextCursor cursor(m_document->document());
+    QTextCursor cursor(m_document);
     cursor.setPosition(from);
     cursor.setPosition(to, QTextCursor::KeepAnchor);
     cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -1018,11 +2019,11 @@ void TextDocument::deleteRegion(int from, int to)
 void TextDocument::deleteRange(const TextRange &range)
 {
     LOG("TextDocument::deleteRange", range);
-    QTextCursor cursor(m_document->document());
+    QTextCursor cursor(m_document);
     cursor.setPosition(range.start, QTextCursor::MoveAnchor);
     cursor.setPosition(range.end, QTextCursor::KeepAnchor);
     cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -1032,10 +2033,10 @@ void TextDocument::deleteRange(const TextRange &range)
 void TextDocument::deleteEndOfLine()
 {
     LOG("TextDocument::deleteEndOfLine");
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.movePosition(QTextCursor::EndOfLine, QTextCursor::KeepAnchor);
     cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -1045,10 +2046,10 @@ void TextDocument::deleteEndOfLine()
 void TextDocument::deleteStartOfLine()
 {
     LOG("TextDocument::deleteStartOfLine");
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.movePosition(QTextCursor::StartOfLine, QTextCursor::KeepAnchor);
     cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -1058,11 +2059,11 @@ void TextDocument::deleteStartOfLine()
 void TextDocument::deleteEndOfWord()
 {
     LOG("TextDocument::deleteEndOfWord");
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     if (!cursor.hasSelection())
         cursor.movePosition(QTextCursor::NextWord, QTextCursor::KeepAnchor);
     cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -1072,11 +2073,11 @@ void TextDocument::deleteEndOfWord()
 void TextDocument::deleteStartOfWord()
 {
     LOG("TextDocument::deleteStartOfWord");
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     if (!cursor.hasSelection())
         cursor.movePosition(QTextCursor::PreviousWord, QTextCursor::KeepAnchor);
     cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -1086,10 +2087,10 @@ void TextDocument::deleteStartOfWord()
 void TextDocument::deletePreviousCharacter(int count)
 {
     LOG_AND_MERGE("TextDocument::deletePreviousCharacter", count);
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.movePosition(QTextCursor::PreviousCharacter, QTextCursor::KeepAnchor, count);
     cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -1099,10 +2100,10 @@ void TextDocument::deletePreviousCharacter(int count)
 void TextDocument::deleteNextCharacter(int count)
 {
     LOG_AND_MERGE("TextDocument::deleteNextCharacter", count);
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.movePosition(QTextCursor::NextCharacter, QTextCursor::KeepAnchor, count);
     cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -1131,9 +2132,9 @@ void TextDocument::gotoMark(const Mark &mark)
         return;
     }
 
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.setPosition(mark.position());
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -1148,9 +2149,9 @@ void TextDocument::selectToMark(const Mark &mark)
         return;
     }
 
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.setPosition(mark.position(), QTextCursor::KeepAnchor);
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /**
@@ -1176,7 +2177,7 @@ Core::RangeMark TextDocument::createRangeMark(int from, int to)
 Core::RangeMark TextDocument::createRangeMark()
 {
     LOG("TextDocument::createRangeMark");
-    const auto cursor = m_document->textCursor();
+    const auto cursor = textCursor();
     const int start = cursor.selectionStart();
     const int end = cursor.selectionEnd();
 
@@ -1223,8 +2224,12 @@ bool TextDocument::find(const QString &text, int options)
         return findRegexp(text, options);
     else if (options & FindWholeWords)
         return findRegexp(QRegularExpression::escape(text), options);
-    else
-        return m_document->find(text, static_cast<QTextDocument::FindFlags>(options));
+
+    QTextCursor cursor = m_document->find(text, textCursor(), static_cast<QTextDocument::FindFlags>(options));
+    if (cursor.isNull())
+        return false;
+    setTextCursor(cursor);
+    return true;
 }
 
 /*!
@@ -1234,6 +2239,7 @@ bool TextDocument::find(const QString &text, int options)
  * - `TextDocument.FindBackward`: search backward
  * - `TextDocument.FindCaseSensitively`: match case
  * - `TextDocument.FindWholeWords`: match only complete words
+ * - `TextDocument.FindMultiline`: match the whole text at once, so the regexp can span several lines
  *
  * Selects the match and returns `true` if a match is found.
  */
@@ -1252,44 +2258,32 @@ auto TextDocument::selectRegexpMatch(
 {
     unselect();
 
-    if (options & FindWholeWords) {
-        if (!regexp.startsWith("\\b"))
-            regexp = "\\b" + regexp;
-        if (!regexp.endsWith("\\b"))
-            regexp += "\\b";
-    }
-
-    QRegularExpression expression(regexp);
-    if (options & (TextDocument::FindCaseSensitively | TextDocument::PreserveCase))
-        expression.setPatternOptions(expression.patternOptions() & ~QRegularExpression::CaseInsensitiveOption);
-    else
-        expression.setPatternOptions(expression.patternOptions() | QRegularExpression::CaseInsensitiveOption);
-
-    const QTextCursor startCursor = m_document->textCursor();
-    QTextBlock block = startCursor.block();
-    int blockOffset = startCursor.positionInBlock();
-
-    while (block.isValid()) {
-        const auto found = matchInBlock(block, expression, blockOffset, options);
-        if (found.has_value()) {
-            const auto &[match, newCursor] = *found;
-            if (selectionFunction(expression, match, newCursor)) {
-                m_document->setTextCursor(newCursor);
-                return found;
-            }
+    // One scan of the text snapshot, the blocks of the document are not used
+    const auto expression = searchExpression(regexp, options);
+    const QString text = plainText();
+    int position = textCursor().position();
+    while (const auto found = matchInText(text, expression, position, options)) {
+        const auto &[range, match] = *found;
+        QTextCursor cursor(m_document);
+        if (options & FindBackward) {
+            cursor.setPosition(range.end);
+            cursor.setPosition(range.start, QTextCursor::KeepAnchor);
+        } else {
+            cursor.setPosition(range.start);
+            cursor.setPosition(range.end, QTextCursor::KeepAnchor);
+        }
+        if (selectionFunction(expression, match, cursor)) {
+            setTextCursor(cursor);
+            return std::make_pair(match, cursor);
+        }
 
-            // The previous match has been discarded, continue searching
-            blockOffset = newCursor.positionInBlock();
+        // The previous match has been discarded, continue searching, after it if it's empty
+        if (options & FindBackward) {
+            position = range.start;
         } else {
-            if (options & FindBackward) {
-                block = block.previous();
-                // Use `block.text().size()` here, instead of `block.length()`, as the later includes the trailing
-                // newline.
-                blockOffset = block.text().size();
-            } else {
-                block = block.next();
-                blockOffset = 0;
-            }
+            position = range.end + (range.start == range.end ? 1 : 0);
+            if (position > text.size())
+                break;
         }
     }
 
@@ -1303,6 +2297,7 @@ auto TextDocument::selectRegexpMatch(
  * - `TextDocument.FindBackward`: search backward
  * - `TextDocument.FindCaseSensitively`: match case
  * - `TextDocument.FindWholeWords`: match only complete words
+ * - `TextDocument.FindMultiline`: match the whole text at once, so the regexp can span several lines
  *
  * Selects the match and returns the named group if a match is found.
  */
@@ -1333,6 +2328,7 @@ QString TextDocument::match(const QString &regexp, int options)
  * - `TextDocument.FindCaseSensitively`: match case
  * - `TextDocument.FindWholeWords`: match only complete words
  * - `TextDocument.FindRegexp`: use a regexp, equivalent to calling `findRegexp`
+ * - `TextDocument.FindMultiline`: match a regexp on the whole text at once, instead of line by line
  * - `TextDocument.PreserveCase`: preserve case when replacing
  *
  * If the option `TextEditor.PreserveCase` is used, it means:
@@ -1350,9 +2346,9 @@ bool TextDocument::replaceOne(const QString &before, const QString &after, int o
 {
     LOG("TextDocument::replaceOne", LOG_ARG("text", before), after, options);
 
-    auto cursor = m_document->textCursor();
+    auto cursor = textCursor();
     cursor.movePosition(QTextCursor::Start);
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 
     const bool usesRegExp = options & FindRegexp;
     const bool preserveCase = options & PreserveCase;
@@ -1360,7 +2356,7 @@ bool TextDocument::replaceOne(const QString &before, const QString &after, int o
     const auto regexp = Utils::createRegularExpression(before, options, usesRegExp);
     if (find(before, options)) {
         cursor.beginEditBlock();
-        const auto found = m_document->textCursor();
+        const auto found = textCursor();
         cursor.setPosition(found.selectionStart());
         cursor.setPosition(found.selectionEnd(), QTextCursor::KeepAnchor);
         QString afterText = after;
@@ -1385,6 +2381,7 @@ bool TextDocument::replaceOne(const QString &before, const QString &after, int o
  * - `TextDocument.FindCaseSensitively`: match case
  * - `TextDocument.FindWholeWords`: match only complete words
  * - `TextDocument.FindRegexp`: use a regexp, equivalent to calling `findRegexp`
+ * - `TextDocument.FindMultiline`: match a regexp on the whole text at once, instead of line by line
  * - `TextDocument.PreserveCase`: preserve case when replacing
  *
  * If the option `TextEditor.PreserveCase` is used, it means:
@@ -1401,7 +2398,7 @@ bool TextDocument::replaceOne(const QString &before, const QString &after, int o
 int TextDocument::replaceAll(const QString &before, const QString &after, int options /* = NoFindFlags */)
 {
     LOG("TextDocument::replaceAll", LOG_ARG("text", before), after, options);
-    return replaceAll(before, after, options, [](auto) {
+    return replaceAll(before, after, options, [](const TextRange &) {
         return true;
     });
 }
@@ -1428,48 +2425,62 @@ int TextDocument::replaceAllInRange(const QString &before, const QString &after,
         return 0;
     }
 
-    return replaceAll(before, after, options, [&range](auto cursor) {
-        return range.start() <= cursor.selectionStart()
-            && cursor.selectionEnd()
-            <= range.end(); // Use <= here, as the selection may be equal to the range, both values are exclusive.
+    return replaceAll(before, after, options, [&range](const TextRange &match) {
+        // Use <= here, as the match may be equal to the range, both values are exclusive.
+        return range.start() <= match.start && match.end <= range.end();
     });
 }
 
 int TextDocument::replaceAll(const QString &before, const QString &after, int options,
-                             const std::function<bool(QTextCursor)> &filterAcceptsCursor)
+                             const std::function<bool(const TextRange &)> &filterAcceptsRange)
 {
-    const bool backwards = options & FindBackward;
     const bool usesRegExp = options & FindRegexp;
     const bool preserveCase = options & PreserveCase;
 
-    int count = 0;
-    auto cursor = m_document->textCursor();
-    cursor.movePosition(backwards ? QTextCursor::End : QTextCursor::Start);
-    m_document->setTextCursor(cursor);
-    cursor.beginEditBlock();
+    // Same expression as the one used by find, so both find the same occurrences
+    QRegularExpression expression;
+    if (usesRegExp || (options & FindWholeWords)) {
+        expression = searchExpression(usesRegExp ? before : QRegularExpression::escape(before), options);
+    } else {
+        const auto patternOptions = (options & FindCaseSensitively) ? QRegularExpression::NoPatternOption
+                                                                    : QRegularExpression::CaseInsensitiveOption;
+        const auto pattern = QRegularExpression::escape(before);
+        expression = Utils::RegularExpressionCache::instance().regularExpression(pattern, patternOptions);
+    }
 
-    const auto regexp = Utils::createRegularExpression(before, options, usesRegExp);
-    while (find(before, options)) {
-        const auto found = m_document->textCursor();
-        cursor.setPosition(found.selectionStart());
-        cursor.setPosition(found.selectionEnd(), QTextCursor::KeepAnchor);
-        if (!filterAcceptsCursor(cursor)) {
-            // Result filtered, so do not replace.
+    // Collect all occurrences in one scan of the text, then apply all replacements at once
+    QVector<TextEdit> edits;
+    const auto matches = matchesInText(plainText(), expression, options);
+    for (const auto &[range, match] : matches) {
+        if (!filterAcceptsRange(range))
             continue;
-        }
         QString afterText = after;
-        if (usesRegExp) {
-            QRegularExpressionMatch match = regexp.match(selectedText());
+        if (usesRegExp)
             afterText = Utils::expandRegExpReplacement(after, match.capturedTexts());
-        } else if (preserveCase) {
-            afterText = Utils::matchCaseReplacement(cursor.selectedText(), after);
-        }
-        cursor.insertText(afterText);
-        ++count;
+        else if (preserveCase)
+            afterText = Utils::matchCaseReplacement(match.captured(), after);
+        edits.push_back({range, afterText});
     }
 
-    cursor.endEditBlock();
-    return count;
+    // Leave the cursor on the last replacement, as successive find and replace would do
+    auto moveCursor = [this](int position) {
+        auto cursor = textCursor();
+        cursor.setPosition(position);
+        setTextCursor(cursor);
+    };
+    if (edits.isEmpty() || !applyEdits(edits)) {
+        moveCursor((options & FindBackward) ? m_document->characterCount() - 1 : 0);
+        return 0;
+    }
+    if (options & FindBackward) {
+        moveCursor(edits.last().range.start);
+    } else {
+        int offset = 0;
+        for (const auto &edit : std::as_const(edits))
+            offset += static_cast<int>(edit.text.size()) - edit.range.length();
+        moveCursor(edits.last().range.end + offset);
+    }
+    return static_cast<int>(edits.size());
 }
 
 /*!
@@ -1483,7 +2494,7 @@ int TextDocument::replaceAll(const QString &before, const QString &after, int op
 int TextDocument::replaceAllRegexp(const QString &regexp, const QString &after, int options /* = NoFindFlags */)
 {
     LOG("TextDocument::replaceAllRegexp", LOG_ARG("text", regexp), after, options);
-    return replaceAllRegexp(regexp, after, options, [](auto) {
+    return replaceAllRegexp(regexp, after, options, [](const TextRange &) {
         return true;
     });
 }
@@ -1511,17 +2522,16 @@ int TextDocument::replaceAllRegexpInRange(const QString &regexp, const QString &
         return 0;
     }
 
-    return replaceAllRegexp(regexp, after, options, [&range](auto cursor) {
-        return range.start() <= cursor.selectionStart()
-            && cursor.selectionEnd()
-            <= range.end(); // Use <= here, as the selection may be equal to the range, both values are exclusive.
+    return replaceAllRegexp(regexp, after, options, [&range](const TextRange &match) {
+        // Use <= here, as the match may be equal to the range, both values are exclusive.
+        return range.start() <= match.start && match.end <= range.end();
     });
 }
 
 int TextDocument::replaceAllRegexp(const QString &regexp, const QString &after, int options,
-                                   const std::function<bool(QTextCursor)> &filterAcceptsCursor)
+                                   const std::function<bool(const TextRange &)> &filterAcceptsRange)
 {
-    return replaceAll(regexp, after, options | FindRegexp, filterAcceptsCursor);
+    return replaceAll(regexp, after, options | FindRegexp, filterAcceptsRange);
 }
 
 static int columnAt(const QString &text, int position, int tabSize)
@@ -1547,91 +2557,118 @@ static int firstNonSpace(const QString &text)
     return i;
 }
 
-static int indentOneLine(QTextCursor &cursor, int tabCount, const TabSettings &settings)
+// Changes of indentation of the lines in a selection, with the selection once the edits are applied
+struct Indentation
 {
-    QString text = cursor.selectedText();
-    cursor.removeSelectedText();
+    QVector<TextEdit> edits;
+    int anchor;
+    int position;
+};
 
-    const int oldSize = text.size();
-    const int firstChar = firstNonSpace(text);
-    const int startColumn = columnAt(text, firstChar, settings.tabSize);
-    const int indentSize = qMax(startColumn / settings.tabSize + tabCount, 0);
-
-    text.remove(0, firstChar);
-    if (settings.insertSpaces)
-        text = QString(indentSize * settings.tabSize, ' ') + text;
-    else
-        text = QString(indentSize, '\t') + text;
+static Indentation computeIndentation(const QTextCursor &cursor, int tabCount)
+{
+    const auto settings = Settings::instance()->value<TabSettings>(Settings::Tab);
+    const auto document = cursor.document();
+    const auto firstBlock = document->findBlock(cursor.selectionStart());
+    const auto lastBlock = document->findBlock(cursor.selectionEnd());
+
+    // All the lines are computed in one pass, the edits are sorted by position
+    Indentation result;
+    for (auto block = firstBlock; block.isValid(); block = block.next()) {
+        const QString text = block.text();
+        const int firstChar = firstNonSpace(text);
+        const int indentSize = qMax(columnAt(text, firstChar, settings.tabSize) / settings.tabSize + tabCount, 0);
+        QString indentation =
+            settings.insertSpaces ? QString(indentSize * settings.tabSize, ' ') : QString(indentSize, '\t');
+        if (QStringView(text).first(firstChar) != indentation)
+            result.edits.push_back({{block.position(), block.position() + firstChar}, std::move(indentation)});
+        if (block == lastBlock)
+            break;
+    }
 
-    cursor.insertText(text);
-    return text.size() - oldSize;
+    // Positions after the edits, a position inside the indentation stays on its line
+    const auto mapPosition = [&result](int position) {
+        int offset = 0;
+        for (const auto &edit : std::as_const(result.edits)) {
+            const int delta = static_cast<int>(edit.text.size()) - edit.range.length();
+            if (edit.range.end <= position)
+                offset += delta;
+            else if (edit.range.start < position)
+                return qMax(edit.range.start + offset, position + offset + delta);
+            else
+                break;
+        }
+        return position + offset;
+    };
+    if (cursor.hasSelection()) {
+        // Select all the lines indented
+        result.anchor = mapPosition(cursor.selectionStart());
+        result.position = mapPosition(lastBlock.position() + lastBlock.length() - 1);
+    } else {
+        result.anchor = result.position = mapPosition(cursor.position());
+    }
+    return result;
 }
 
 void indentTextInTextEdit(QPlainTextEdit *textEdit, int tabCount)
 {
-    const auto settings = Core::Settings::instance()->value<Core::TabSettings>(Core::Settings::Tab);
-
-    QTextCursor cursor = textEdit->textCursor();
-    const bool hasSelection = cursor.hasSelection();
-    const int lineStart = textEdit->document()->findBlock(cursor.selectionStart()).blockNumber();
-    const int lineEnd = textEdit->document()->findBlock(cursor.selectionEnd()).blockNumber();
+    textEdit->setTextCursor(indentText(textEdit->textCursor(), tabCount));
+}
 
-    // Move the position to the beginning of the first line
-    int startPosition = cursor.position();
-    cursor.setPosition(cursor.selectionStart());
+QTextCursor indentText(QTextCursor cursor, int tabCount)
+{
+    const auto indentation = computeIndentation(cursor, tabCount);
 
     cursor.beginEditBlock();
-    if (hasSelection) {
-        startPosition = cursor.position();
-        // Iterate through all line, and change the indentation
-        for (int line = lineStart; line <= lineEnd; ++line) {
-            cursor.select(QTextCursor::LineUnderCursor);
-            const int delta = indentOneLine(cursor, tabCount, settings);
-            if (line == lineStart)
-                startPosition += delta;
-            cursor.movePosition(QTextCursor::Down, QTextCursor::MoveAnchor);
-        }
-        const int endPosition = cursor.position();
-        // Select whole the lines indented
-        cursor.setPosition(startPosition);
-        cursor.setPosition(endPosition - 1, QTextCursor::KeepAnchor);
-    } else {
-        cursor.select(QTextCursor::LineUnderCursor);
-        startPosition += indentOneLine(cursor, tabCount, settings);
-        const int finalLine = textEdit->document()->findBlock(startPosition).blockNumber();
-        if (finalLine != lineStart)
-            gotoLineInTextEdit(textEdit, lineStart + 1);
-        else
-            cursor.setPosition(startPosition);
+    for (const auto &edit : indentation.edits | std::views::reverse) {
+        cursor.setPosition(edit.range.start);
+        cursor.setPosition(edit.range.end, QTextCursor::KeepAnchor);
+        cursor.insertText(edit.text);
     }
     cursor.endEditBlock();
-    textEdit->setTextCursor(cursor);
+
+    cursor.setPosition(indentation.anchor);
+    cursor.setPosition(indentation.position, QTextCursor::KeepAnchor);
+    return cursor;
+}
+
+void TextDocument::changeIndentation(int tabCount)
+{
+    auto indentation = computeIndentation(textCursor(), tabCount);
+    if (!indentation.edits.isEmpty() && !applyEdits(std::move(indentation.edits)))
+        return;
+
+    QTextCursor cursor(m_document);
+    cursor.setPosition(indentation.anchor);
+    cursor.setPosition(indentation.position, QTextCursor::KeepAnchor);
+    setTextCursor(cursor);
 }
 
 /*!
  * \qmlmethod TextDocument::indent(int count)
  * Indents the current line `count` times. If there's a selection, indent all lines in the selection.
+ *
+ * All the lines are changed in one edit, like `applyEdits`.
  */
 void TextDocument::indent(int count)
 {
     LOG_AND_MERGE("TextDocument::indent", count);
-    while (count != 0) {
-        indentTextInTextEdit(m_document, 1);
-        --count;
-    }
+    if (count > 0)
+        changeIndentation(count);
 }
 
 /*!
  * \qmlmethod TextDocument::removeIndent(int count)
- * Indents the current line `count` times. If there's a selection, indent all lines in the selection.
+ * Removes one level of indentation from the current line `count` times. If there's a selection, remove indentation
+ * from all lines in the selection.
+ *
+ * All the lines are changed in one edit, like `applyEdits`.
  */
 void TextDocument::removeIndent(int count)
 {
     LOG_AND_MERGE("TextDocument::removeIndent", count);
-    while (count != 0) {
-        indentTextInTextEdit(m_document, -1);
-        --count;
-    }
+    if (count > 0)
+        changeIndentation(-count);
 }
 
 void TextDocument::setLineEnding(LineEnding newLineEnding)
@@ -1651,7 +2688,7 @@ void TextDocument::setLineEnding(LineEnding newLineEnding)
 QString TextDocument::indentationAtPosition(int pos)
 {
     LOG("TextDocument::indentationAtPosition", pos);
-    auto cursor = m_document->textCursor();
+    auto cursor = textCursor();
     cursor.setPosition(pos);
     cursor.movePosition(QTextCursor::StartOfLine);
     const QString line = cursor.block().text();
@@ -12,18 +12,33 @@
 
 #include "document.h"
 #include "mark.h"
+#include "rangemark.h"
 #include "textrange.h"
 
+#include <QJSValue>
 #include <QPointer>
 #include <QRegularExpressionMatch>
 #include <QTextCursor>
 #include <QTextDocument>
+#include <QTimer>
+#include <memory>
+#include <optional>
 
+class QKeyEvent;
 class QPlainTextEdit;
 
 namespace Core {
 
-class RangeMark;
+class LineIndex;
+class MarkTracker;
+class RangeMarkPrivate;
+
+// Replacement of the text in `range` by `text`, see TextDocument::applyEdits
+struct TextEdit
+{
+    TextRange range;
+    QString text;
+};
 
 class TextDocument : public Document
 {
@@ -39,6 +54,8 @@ class TextDocument : public Document
     Q_PROPERTY(QString currentLine READ currentLine NOTIFY positionChanged)
     Q_PROPERTY(QString currentWord READ currentWord NOTIFY positionChanged)
     Q_PROPERTY(LineEnding lineEnding READ lineEnding WRITE setLineEnding NOTIFY lineEndingChanged)
+    Q_PROPERTY(bool isLargeFile READ isLargeFile NOTIFY largeFileChanged)
+    Q_PROPERTY(QStringList degradedFeatures READ degradedFeatures NOTIFY largeFileChanged)
 
 public:
     enum LineEnding {
@@ -59,7 +76,8 @@ public:
         FindCaseSensitively = QTextDocument::FindCaseSensitively,
         FindWholeWords = QTextDocument::FindWholeWords,
         FindRegexp = 0x08,
-        PreserveCase = 0x10
+        PreserveCase = 0x10,
+        FindMultiline = 0x20
     };
     Q_DECLARE_FLAGS(FindFlags, FindFlag)
     Q_ENUM(FindFlag)
@@ -87,10 +105,31 @@ public:
 
     bool hasUtf8Bom() const;
 
+    bool isLargeFile() const;
+    virtual QStringList degradedFeatures() const;
+
     QPlainTextEdit *textEdit() const;
+    QTextDocument *qTextDocument() const;
 
     QString tab() const;
 
+    bool applyEdits(QVector<Core::TextEdit> edits);
+
+    // All edits done on a text document between beginUndoGroup and endUndoGroup are undone and redone at once by undo
+    // and redo. Starting a new group ends the current one.
+    static void beginUndoGroup();
+    static void endUndoGroup();
+    // Disables undo and redo for text documents created afterwards, to save memory on headless runs
+    static void setUndoRedoEnabledForNewDocuments(bool enabled);
+    // Disables undo and redo for the large files loaded afterwards, see isLargeFile
+    static void setUndoRedoEnabledForLargeFiles(bool enabled);
+    // The next loads use the large-file mode above `size` characters or `lines` lines, 0 disables the threshold
+    void setLargeFileThresholds(int size, int lines);
+    // The next load uses `data` as the content of the file, instead of reading it (see Project::prefetch)
+    void setPrefetchedData(QByteArray data);
+
+    QVariantMap memoryUsage() const override;
+
 public slots:
     void setPosition(int newPosition);
     void setText(const QString &newText);
@@ -100,6 +139,11 @@ public slots:
     int columnAtPosition(int position);
     int positionAt(int line, int column);
 
+    QString textRegion(int from, int to);
+    QStringList textRegions(const QList<int> &positions);
+    QStringList lines(int from = 1, int to = -1);
+    QList<int> lineColumns(const Core::RangeMarkList &ranges);
+
     void undo(int count = 1);
     void redo(int count = 1);
 
@@ -150,6 +194,9 @@ public slots:
     void replace(int length, const QString &text);
     void replace(int from, int to, const QString &text);
     void replace(const Core::TextRange &range, const QString &text);
+    bool applyEdits(const QVariantList &edits);
+    bool setLines(int from, int to, const QStringList &texts);
+    bool editLines(const QJSValue &callback);
 
     // Deletion
     void deleteLine(int line = -1);
@@ -197,24 +244,47 @@ signals:
     void textChanged();
     void selectionChanged();
     void lineEndingChanged();
+    void largeFileChanged();
 
 protected:
     explicit TextDocument(Type type, QObject *parent = nullptr);
 
     bool doSave(const QString &fileName) override;
     bool doLoad(const QString &fileName) override;
+    bool doRefresh() override;
+    void doEvict() override;
+
+    QTextCursor textCursor() const;
+    void setTextCursor(const QTextCursor &cursor);
+
+    // Same as text, without logging the call
+    QString plainText() const;
+    int contentRevision() const;
 
     friend MarkPrivate;
+    friend RangeMarkPrivate;
     void convertPosition(int pos, int *line, int *column) const;
+    const LineIndex &lineIndex() const;
     int position(QTextCursor::MoveOperation operation, int pos) const;
 
     int replaceAll(const QString &before, const QString &after, int options,
-                   const std::function<bool(QTextCursor)> &filterAcceptsCursor);
+                   const std::function<bool(const TextRange &)> &filterAcceptsRange);
     int replaceAllRegexp(const QString &regexp, const QString &after, int options,
-                         const std::function<bool(QTextCursor)> &filterAcceptsCursor);
+                         const std::function<bool(const TextRange &)> &filterAcceptsRange);
 
 private:
     void detectFormat(const QByteArray &data);
+    // Edit replacing the lines [from, to] with `texts`, lines are 1-based and must be valid (see setLines)
+    TextEdit linesEdit(int from, int to, const QStringList &texts) const;
+
+    void addUndoStep();
+    int undoStepCount(bool redo);
+
+    bool typeKey(QKeyEvent *keyEvent);
+    void flushTypedKeys();
+
+    // Changes the indentation of the current line or the selected lines by `tabCount` tabs, in one edit
+    void changeIndentation(int tabCount);
 
     void movePosition(QTextCursor::MoveOperation operation, QTextCursor::MoveMode mode = QTextCursor::MoveAnchor,
                       int count = 1);
@@ -226,11 +296,55 @@ private:
                 return true;
             }) -> std::optional<std::pair<QRegularExpressionMatch, QTextCursor>>;
 
-    // TODO: use a QTextDocument maybe, to avoid creating a widget
-    // The QPlainTextEdit has a nicer API, so it's slightly easier with that now
-    QPointer<QPlainTextEdit> m_document;
+    QTextDocument *m_document = nullptr;
+    // Cursor used as long as there is no editor
+    QTextCursor m_cursor;
+    // The editor is created on demand, see textEdit()
+    mutable QPointer<QPlainTextEdit> m_textEdit;
+    // Plain text of m_document, shared by all text() calls until the next change
+    mutable std::optional<QString> m_plainText;
+    int m_contentRevision = 0;
+    // Start of each line, kept up to date like the marks
+    std::unique_ptr<LineIndex> m_lineIndex;
+    // Positions of all the marks and range marks of this document
+    std::unique_ptr<MarkTracker> m_markTracker;
+    // Set while applyEdits is running, it updates the marks itself
+    bool m_applyingEdits = false;
     LineEnding m_lineEnding = NativeLineEnding;
     bool m_utf8Bom = false;
+    // Content of the file read in advance, used by the next load
+    std::optional<QByteArray> m_prefetchedData;
+    // Undo steps grouped by beginUndoGroup, as [start, end) ranges in the undo stack
+    struct UndoGroup
+    {
+        int start;
+        int end;
+        int id;
+    };
+    std::vector<UndoGroup> m_undoGroups;
+    // Group being recorded, 0 if none
+    inline static int m_currentUndoGroupId = 0;
+    inline static int m_lastUndoGroupId = 0;
+    inline static bool m_undoRedoEnabledForNewDocuments = true;
+    inline static bool m_undoRedoEnabledForLargeFiles = true;
+    // Set on load if the file is above the thresholds, see setLargeFileThresholds
+    int m_largeFileSize = 0;
+    int m_largeFileLines = 0;
+    bool m_largeFile = false;
+    // Keys typed in the editor not recorded in the history yet, see typeKey
+    struct TypedKeys
+    {
+        int backspaces = 0;
+        QString text;
+        int deletes = 0;
+        // Position of the cursor after the last key
+        int position = -1;
+    };
+    TypedKeys m_typedKeys;
+    QTimer m_typingTimer;
+    // File last loaded or saved, and the hash of its content, to avoid rewriting a file with the same content
+    QString m_diskFileName;
+    QByteArray m_diskContentHash;
 };
 
 } // namespace Core
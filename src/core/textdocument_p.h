@@ -12,7 +12,12 @@
 
 #include "utils/json.h"
 
+#include <utility>
+#include <vector>
+
 class QPlainTextEdit;
+class QTextCursor;
+class QTextDocument;
 
 namespace Core {
 
@@ -28,4 +33,42 @@ NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(TabSettings, insertSpaces, tabSize);
 void indentTextInTextEdit(QPlainTextEdit *textEdit, int tabCount);
 void gotoLineInTextEdit(QPlainTextEdit *textEdit, int line, int column = 1);
 
+QTextCursor indentText(QTextCursor cursor, int tabCount);
+QTextCursor cursorAtLine(QTextDocument *document, int line, int column = 1);
+
+// Start position of each line of a QTextDocument, to convert between positions and lines/columns in O(log n).
+//
+// Going through QTextDocument::findBlock or a QTextCursor for each conversion is slow when converting lots of
+// positions, like all the locations of a LSP response. The table is built on first use, then updated on each change
+// of the document. Lines and columns are 0-based, and columns are in UTF-16 code units, like the LSP ones.
+class LineIndex
+{
+public:
+    explicit LineIndex(QTextDocument *document);
+
+    LineIndex(const LineIndex &) = delete;
+    LineIndex &operator=(const LineIndex &) = delete;
+
+    int lineCount() const;
+    // Returns -1 if the position or the line is invalid
+    int lineAt(int position) const;
+    int lineStart(int line) const;
+    // Length of the line, without the line separator
+    int lineLength(int line) const;
+    // Returns the line and column of all the `positions`, -1 for both if the position is invalid. The positions are
+    // converted in one sweep over the lines, instead of one binary search each.
+    std::vector<std::pair<int, int>> lineColumns(const std::vector<int> &positions) const;
+
+    void update(int position, int charsRemoved, int charsAdded);
+    // Forces a rebuild of the table on next use, for changes not reported by QTextDocument::contentsChange
+    void invalidate();
+
+private:
+    void ensureBuilt() const;
+
+    QTextDocument *m_document;
+    // Sorted, the first line always starts at 0
+    mutable std::vector<int> m_lineStarts;
+};
+
 } // namespace Core
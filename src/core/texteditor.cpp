@@ -70,7 +70,19 @@ void TextEditor::updateCurrentLine()
     if (m_currentLine == textCursor().blockNumber())
         return;
     m_currentLine = textCursor().blockNumber();
+    updateExtraSelections();
+}
+
+void TextEditor::setSearchHighlights(const QList<QTextEdit::ExtraSelection> &highlights)
+{
+    if (highlights.isEmpty() && m_searchHighlights.isEmpty())
+        return;
+    m_searchHighlights = highlights;
+    updateExtraSelections();
+}
 
+void TextEditor::updateExtraSelections()
+{
     QList<QTextEdit::ExtraSelection> extraSelections;
     QTextEdit::ExtraSelection selection;
     selection.format.setBackground(palette().alternateBase());
@@ -78,6 +90,7 @@ void TextEditor::updateCurrentLine()
     selection.cursor = textCursor();
     selection.cursor.clearSelection();
     extraSelections.append(selection);
+    extraSelections.append(m_searchHighlights);
     setExtraSelections(extraSelections);
 }
 
@@ -23,6 +23,9 @@ class TextEditor : public QPlainTextEdit
 public:
     explicit TextEditor(QWidget *parent = nullptr);
 
+    // Highlights displayed with the current line, used to show the search matches
+    void setSearchHighlights(const QList<QTextEdit::ExtraSelection> &highlights);
+
 protected:
     void resizeEvent(QResizeEvent *) override;
 
@@ -30,12 +33,14 @@ private:
     void updateGutterWidth(int);
     void updateGutter(const QRect &rect, int dy);
     void updateCurrentLine();
+    void updateExtraSelections();
 
 private:
     friend class Gutter;
 
     Gutter *m_gutter;
     int m_currentLine = -1;
+    QList<QTextEdit::ExtraSelection> m_searchHighlights;
 };
 
 }
@@ -12,6 +12,13 @@
 #include "codedocument.h"
 #include "project.h"
 
+#include <QFile>
+#include <QStringDecoder>
+#include <QUrl>
+#include <algorithm>
+#include <spdlog/spdlog.h>
+#include <unordered_map>
+
 namespace Core {
 
 /*!
@@ -24,23 +31,73 @@ namespace Core {
  * A mark is always created by a [CodeDocument](codedocument.md).
  */
 
+/*!
+ * \qmlproperty string TextLocation::fileName
+ * This read-only property contains the full path of the file of this text location.
+ */
 /*!
  * \qmlproperty CodeDocument TextLocation::document
- * This read-only property contains the source document for this text location.
+ * This read-only property contains the source document for this text location. The document is opened when this
+ * property is first read, use `fileName` to check the file without opening it.
  */
 /*!
  * \qmlproperty TextRange TextLocation::range
  * This read-only property contains the range of text in the document.
  */
 
+CodeDocument *TextLocation::document() const
+{
+    return qobject_cast<CodeDocument *>(Project::instance()->get(fileName));
+}
+
 QString TextLocation::toString() const
 {
-    return QString("{'%1', %2}").arg(document->fileName(), range.toString());
+    return QString("{'%1', %2}").arg(fileName, range.toString());
+}
+
+// Returns the start of each line of the file, as in the text of a TextDocument loading it: "\r\n" is a single
+// character. The last item is one past the end of the text, so the length of each line is known.
+static QVector<int> fileLineStarts(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        spdlog::warn("TextLocation::fromLsp - can't read file {}: {}", fileName, file.errorString());
+        return {};
+    }
+    const qint64 size = file.size();
+    uchar *mapped = size > 0 ? file.map(0, size) : nullptr;
+    const QByteArray data = mapped ? QByteArray::fromRawData(reinterpret_cast<const char *>(mapped), size)
+                                   : file.readAll();
+    QStringDecoder decoder(QStringDecoder::encodingForData(data).value_or(QStringDecoder::Utf8));
+    const QString text = decoder.decode(data);
+    if (mapped)
+        file.unmap(mapped);
+
+    QVector<int> lineStarts = {0};
+    int position = 0;
+    for (qsizetype i = 0; i < text.size(); ++i, ++position) {
+        if (text[i] == '\r' && i + 1 < text.size() && text[i + 1] == '\n')
+            ++i;
+        if (text[i] == '\n' || text[i] == '\r')
+            lineStarts.push_back(position + 1);
+    }
+    lineStarts.push_back(position + 1);
+    return lineStarts;
+}
+
+// Same as CodeDocument::toPos, using the line starts of a file
+static int toPos(const QVector<int> &lineStarts, const Lsp::Position &pos)
+{
+    const auto line = static_cast<int>(std::min<unsigned int>(pos.line, lineStarts.size() - 2));
+    const auto lineLength = lineStarts[line + 1] - lineStarts[line] - 1;
+    return lineStarts[line] + static_cast<int>(std::min<unsigned int>(pos.character, lineLength));
 }
 
 QVector<TextLocation> TextLocation::fromLsp(const std::vector<Lsp::Location> &locations)
 {
     QVector<Core::TextLocation> textLocations;
+    // Files not opened are only scanned once, to find the start of each line
+    std::unordered_map<QString, QVector<int>> lineStarts;
 
     for (const auto &location : locations) {
         const auto url = QUrl::fromEncoded(QByteArray::fromStdString(location.uri));
@@ -49,11 +106,18 @@ QVector<TextLocation> TextLocation::fromLsp(const std::vector<Lsp::Location> &lo
         }
         const auto filepath = url.toLocalFile();
 
-        if (auto *document = qobject_cast<CodeDocument *>(Project::instance()->get(filepath))) {
-            const auto range = document->toRange(location.range);
-
-            textLocations.emplace_back(TextLocation {.document = document, .range = range});
+        // An opened document may have changed since it was saved, its text is the one known by the server
+        if (auto *document = qobject_cast<CodeDocument *>(Project::instance()->findDocument(filepath))) {
+            textLocations.push_back({filepath, document->toRange(location.range)});
+            continue;
         }
+        auto it = lineStarts.find(filepath);
+        if (it == lineStarts.end())
+            it = lineStarts.emplace(filepath, fileLineStarts(filepath)).first;
+        if (it->second.isEmpty())
+            continue;
+        const TextRange range = {toPos(it->second, location.range.start), toPos(it->second, location.range.end)};
+        textLocations.push_back({filepath, range});
     }
 
     return textLocations;
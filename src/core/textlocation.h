@@ -19,19 +19,25 @@ namespace Core {
 
 class CodeDocument;
 
+// The document of a location is only opened when it's accessed, so the locations of a big LSP result don't open all
+// the files they reference.
 struct TextLocation
 {
     Q_GADGET
-    Q_PROPERTY(Core::CodeDocument *document MEMBER document CONSTANT)
+    Q_PROPERTY(QString fileName MEMBER fileName CONSTANT)
+    Q_PROPERTY(Core::CodeDocument *document READ document CONSTANT)
     Q_PROPERTY(Core::TextRange range MEMBER range CONSTANT)
 
 public:
-    CodeDocument *document;
+    QString fileName;
     TextRange range;
 
+    // Opens the document if needed
+    CodeDocument *document() const;
+
     Q_INVOKABLE QString toString() const;
 
-    auto operator<=>(const TextLocation &) const = default;
+    bool operator==(const TextLocation &) const = default;
 
     static QVector<TextLocation> fromLsp(const std::vector<Lsp::Location> &locations);
 };
@@ -10,6 +10,8 @@
 
 #pragma once
 
+#include "utils/json.h"
+
 #include <QObject>
 
 namespace Core {
@@ -34,6 +36,8 @@ public:
     auto operator<=>(const TextRange &) const = default;
 };
 
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(TextRange, start, end);
+
 } // namespace Core
 
 Q_DECLARE_METATYPE(Core::TextRange)
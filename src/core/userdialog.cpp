@@ -15,6 +15,7 @@
 #include <QInputDialog>
 #include <QMessageBox>
 #include <QQmlEngine>
+#include <spdlog/spdlog.h>
 
 namespace Core {
 
@@ -34,6 +35,8 @@ namespace Core {
  * else
  *     Message.log("Cancelled")
  * ````
+ *
+ * Without a GUI, when running `knut-cli`, the dialogs are always cancelled and the messages are logged instead.
  */
 
 UserDialog::UserDialog(QQmlEngine *parent)
@@ -50,6 +53,8 @@ UserDialog::UserDialog(QQmlEngine *parent)
  */
 QJSValue UserDialog::getOpenFileName(const QString &caption, const QString &dir, const QString &filters)
 {
+    if (!canShowDialog())
+        return QJSValue(QJSValue::NullValue);
     const QString s = QFileDialog::getOpenFileName(dialogParent(), caption, dir, filters);
     if (!s.isEmpty())
         return s;
@@ -65,6 +70,8 @@ QJSValue UserDialog::getOpenFileName(const QString &caption, const QString &dir,
  */
 QJSValue UserDialog::getSaveFileName(const QString &caption, const QString &dir, const QString &filters)
 {
+    if (!canShowDialog())
+        return QJSValue(QJSValue::NullValue);
     const QString s = QFileDialog::getSaveFileName(dialogParent(), caption, dir, filters);
     if (!s.isEmpty())
         return s;
@@ -79,6 +86,8 @@ QJSValue UserDialog::getSaveFileName(const QString &caption, const QString &dir,
  */
 QJSValue UserDialog::getExistingDirectory(const QString &caption, const QString &dir)
 {
+    if (!canShowDialog())
+        return QJSValue(QJSValue::NullValue);
     const QString s = QFileDialog::getExistingDirectory(dialogParent(), caption, dir);
     if (!s.isEmpty())
         return s;
@@ -98,6 +107,8 @@ QJSValue UserDialog::getExistingDirectory(const QString &caption, const QString
 QJSValue UserDialog::getItem(const QString &title, const QString &label, const QStringList &items, int current,
                              bool editable)
 {
+    if (!canShowDialog())
+        return QJSValue(QJSValue::NullValue);
     bool ok;
     const QString ret = QInputDialog::getItem(dialogParent(), title, label, items, current, editable, &ok);
     if (ok)
@@ -119,6 +130,8 @@ QJSValue UserDialog::getItem(const QString &title, const QString &label, const Q
 QJSValue UserDialog::getDouble(const QString &title, const QString &label, double value, int decimals, double step,
                                double min, double max)
 {
+    if (!canShowDialog())
+        return QJSValue(QJSValue::NullValue);
     bool ok;
     const double ret =
         QInputDialog::getDouble(dialogParent(), title, label, value, min, max, decimals, &ok, Qt::WindowFlags(), step);
@@ -139,6 +152,8 @@ QJSValue UserDialog::getDouble(const QString &title, const QString &label, doubl
 // clang-format on
 QJSValue UserDialog::getInt(const QString &title, const QString &label, int value, int step, int min, int max)
 {
+    if (!canShowDialog())
+        return QJSValue(QJSValue::NullValue);
     bool ok;
     const int ret = QInputDialog::getInt(dialogParent(), title, label, value, min, max, step, &ok);
     if (ok)
@@ -155,6 +170,8 @@ QJSValue UserDialog::getInt(const QString &title, const QString &label, int valu
  */
 QJSValue UserDialog::getText(const QString &title, const QString &label, const QString &text)
 {
+    if (!canShowDialog())
+        return QJSValue(QJSValue::NullValue);
     bool ok;
     const QString ret = QInputDialog::getText(dialogParent(), title, label, QLineEdit::Normal, text, &ok);
     if (ok)
@@ -168,6 +185,10 @@ QJSValue UserDialog::getText(const QString &title, const QString &label, const Q
  */
 void UserDialog::information(const QString &title, const QString &text)
 {
+    if (!canShowDialog()) {
+        spdlog::info("{}: {}", title, text);
+        return;
+    }
     QMessageBox::information(dialogParent(), title, text);
 }
 
@@ -177,6 +198,10 @@ void UserDialog::information(const QString &title, const QString &text)
  */
 void UserDialog::warning(const QString &title, const QString &text)
 {
+    if (!canShowDialog()) {
+        spdlog::warn("{}: {}", title, text);
+        return;
+    }
     QMessageBox::warning(dialogParent(), title, text);
 }
 
@@ -186,9 +211,19 @@ void UserDialog::warning(const QString &title, const QString &text)
  */
 void UserDialog::critical(const QString &title, const QString &text)
 {
+    if (!canShowDialog()) {
+        spdlog::error("{}: {}", title, text);
+        return;
+    }
     QMessageBox::critical(dialogParent(), title, text);
 }
 
+// Dialogs need a QApplication, which doesn't exist when running knut-cli
+bool UserDialog::canShowDialog() const
+{
+    return qobject_cast<QApplication *>(QCoreApplication::instance()) != nullptr;
+}
+
 QWidget *UserDialog::dialogParent() const
 {
     return parent() && parent()->property("scriptWindow").toBool() ? nullptr : QApplication::activeWindow();
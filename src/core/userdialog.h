@@ -43,6 +43,7 @@ public slots:
     void critical(const QString &title, const QString &text);
 
 private:
+    bool canShowDialog() const;
     QWidget *dialogParent() const;
 };
 
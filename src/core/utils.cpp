@@ -9,9 +9,11 @@
 */
 
 #include "utils.h"
+#include "jsondocument.h"
 #include "logger.h"
 #include "scriptmanager.h"
 #include "utils/log.h"
+#include "utils/resultwriter.h"
 
 #include <QApplication>
 #include <QClipboard>
@@ -162,7 +164,9 @@ QString Utils::mktemp(const QString &pattern)
 
 /*!
  * \qmlmethod string Utils::convertCase(string str, Case from, Case to)
- * Converts and returns the string `str` with a different case pattern: from `from` to `to`.
+ * \qmlmethod array<string> Utils::convertCase(array<string> strings, Case from, Case to)
+ * Converts and returns the string `str` with a different case pattern: from `from` to `to`. With an array of
+ * `strings`, converts all of them at once.
  *
  * The different cases are:
  *
@@ -179,6 +183,12 @@ QString Utils::convertCase(const QString &str, Case from, Case to)
     return ::Utils::convertCase(str, static_cast<::Utils::Case>(from), static_cast<::Utils::Case>(to));
 }
 
+QStringList Utils::convertCase(const QStringList &strings, Case from, Case to)
+{
+    LOG("Utils::convertCase", strings, from, to);
+    return ::Utils::convertCase(strings, static_cast<::Utils::Case>(from), static_cast<::Utils::Case>(to));
+}
+
 /*!
  * \qmlmethod string Utils::copyToClipboard(string text)
  * Copy the text to the clipboard
@@ -186,10 +196,39 @@ QString Utils::convertCase(const QString &str, Case from, Case to)
 void Utils::copyToClipboard(const QString &text)
 {
     LOG("Utils::copyToClipboard", text);
+    // There's no clipboard without a GUI, when running knut-cli
+    if (!qobject_cast<QApplication *>(QCoreApplication::instance())) {
+        spdlog::error("Utils::copyToClipboard - the clipboard is not available without a GUI");
+        return;
+    }
     auto clipboard = QApplication::clipboard();
     clipboard->setText(text);
 }
 
+/*!
+ * \qmlmethod Utils::writeResult(object record)
+ * Writes `record` in the results file passed with `--results`, as one line of JSON. The records are written as they
+ * come, so a script reporting a lot of findings doesn't have to keep them in memory until the end:
+ *
+ * ```js
+ * for (const match of document.query("(call_expression) @call"))
+ *     Utils.writeResult({file: document.fileName, line: match.get("call").startLine});
+ * ```
+ *
+ * With `--each`, the records of all the files processed are written in the same results file. Without a results file,
+ * the record is logged instead.
+ */
+void Utils::writeResult(const QVariant &record)
+{
+    // Not logged in the history, it would keep all the records in memory
+    const auto json = JsonDocument::toJson(record);
+    if (!::Utils::ResultWriter::isOpen()) {
+        spdlog::info("Utils::writeResult - {}", json.dump());
+        return;
+    }
+    ::Utils::ResultWriter::write(json);
+}
+
 /*!
  * \qmlmethod string Utils::cppKeywords()
  * Returns a list of cpp keywords.
@@ -49,9 +49,12 @@ public slots:
     static QString mktemp(const QString &pattern);
 
     static QString convertCase(const QString &str, Case from, Case to);
+    static QStringList convertCase(const QStringList &strings, Case from, Case to);
 
     static void copyToClipboard(const QString &text);
 
+    static void writeResult(const QVariant &record);
+
     static QStringList cppKeywords();
 
     static QStringList cppPrimitiveTypes();
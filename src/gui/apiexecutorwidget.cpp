@@ -41,13 +41,15 @@ APIExecutorWidget::APIExecutorWidget(QWidget *parent)
     ui->setupUi(this);
     setProperty("panelWidget", true);
 
-    initializeApi();
-
     GuiSettings::setIcon(ui->closeButton, ":/gui/close.png");
     connect(ui->closeButton, &QToolButton::clicked, this, &QWidget::hide);
 
+    // The list of APIs is only created and updated once the widget is opened
     auto project = Core::Project::instance();
-    connect(project, &Core::Project::currentDocumentChanged, this, &APIExecutorWidget::populateApiList);
+    connect(project, &Core::Project::currentDocumentChanged, this, [this](Core::Document *document) {
+        if (isVisible() && document)
+            populateApiList(document);
+    });
     connect(ui->apiComboBox, &QComboBox::currentIndexChanged, this, &APIExecutorWidget::populateArgumentList);
 
     connect(ui->executeButton, &QToolButton::clicked, this, &APIExecutorWidget::onExecuteButtonClicked);
@@ -293,6 +295,10 @@ void APIExecutorWidget::executeAPI(Core::Document *document, const QByteArray &n
 
 void APIExecutorWidget::open()
 {
+    if (m_apis.isEmpty())
+        initializeApi();
+    if (auto document = Core::Project::instance()->currentDocument())
+        populateApiList(document);
     populateArgumentList();
 
     show();
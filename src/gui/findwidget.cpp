@@ -12,16 +12,59 @@
 #include "core/logger.h"
 #include "core/project.h"
 #include "core/textdocument.h"
+#include "core/texteditor.h"
 #include "guisettings.h"
 #include "ui_findwidget.h"
+#include "utils/regularexpressioncache.h"
 
 #include <QAction>
 #include <QKeySequence>
 #include <QPlainTextEdit>
+#include <QPromise>
+#include <QScrollBar>
+#include <QTextBlock>
 #include <QTextDocument>
+#include <QtConcurrent>
 
 namespace Gui {
 
+// Delay before counting the matches again after a change in the document
+constexpr int CountDelay = 300;
+static const QColor MatchColor(255, 220, 0, 96);
+
+// Calls `func` for each non-empty match of `expression` in `line`, matching is done line by line like
+// TextDocument::find
+template <typename Func>
+static void forEachMatch(const QString &line, const QRegularExpression &expression, Func func)
+{
+    for (qsizetype from = 0; from <= line.size();) {
+        const auto match = expression.match(line, from);
+        if (!match.hasMatch())
+            break;
+        if (match.capturedLength() > 0)
+            func(match);
+        // Make sure to progress after an empty match
+        from = match.capturedEnd() + (match.capturedLength() == 0 ? 1 : 0);
+    }
+}
+
+static void countMatches(QPromise<int> &promise, const QString &text, const QRegularExpression &expression)
+{
+    int count = 0;
+    for (qsizetype lineStart = 0; lineStart <= text.size();) {
+        if (promise.isCanceled())
+            return;
+        qsizetype lineEnd = text.indexOf(u'\n', lineStart);
+        if (lineEnd == -1)
+            lineEnd = text.size();
+        forEachMatch(text.sliced(lineStart, lineEnd - lineStart), expression, [&count](const auto &) {
+            ++count;
+        });
+        lineStart = lineEnd + 1;
+    }
+    promise.addResult(count);
+}
+
 FindWidget::FindWidget(QWidget *parent)
     : QWidget(parent)
     , ui(new Ui::FindWidget)
@@ -53,6 +96,19 @@ FindWidget::FindWidget(QWidget *parent)
     connect(ui->replaceEdit, &QLineEdit::returnPressed, this, &FindWidget::replaceOne);
     connect(ui->replaceButton, &QToolButton::pressed, this, &FindWidget::replaceOne);
     connect(ui->replaceAllbutton, &QToolButton::pressed, this, &FindWidget::replaceAll);
+
+    connect(ui->findEdit, &QLineEdit::textChanged, this, &FindWidget::updateSearch);
+    for (auto action : {m_matchCase, m_matchWord, m_matchRegexp})
+        connect(action, &QAction::toggled, this, &FindWidget::updateSearch);
+    connect(Core::Project::instance(), &Core::Project::currentDocumentChanged, this, [this]() {
+        if (isVisible())
+            updateSearch();
+    });
+
+    m_countTimer.setSingleShot(true);
+    m_countTimer.setInterval(CountDelay);
+    connect(&m_countTimer, &QTimer::timeout, this, &FindWidget::startCount);
+    connect(&m_countWatcher, &QFutureWatcher<int>::finished, this, &FindWidget::showCount);
 }
 
 FindWidget::~FindWidget() = default;
@@ -116,6 +172,15 @@ void FindWidget::open()
     m_firstTime = true;
     show();
     ui->findEdit->setFocus(Qt::OtherFocusReason);
+    updateSearch();
+}
+
+void FindWidget::hideEvent(QHideEvent *event)
+{
+    QWidget::hideEvent(event);
+    setTextEditor(nullptr);
+    m_countTimer.stop();
+    m_countFuture.cancel();
 }
 
 void FindWidget::find(int options)
@@ -153,4 +218,103 @@ void FindWidget::replace(bool onlyOne)
     }
 }
 
+void FindWidget::updateSearch()
+{
+    const QString text = ui->findEdit->text();
+    const int flags = findFlags();
+    QString pattern = (flags & Core::TextDocument::FindRegexp) ? text : QRegularExpression::escape(text);
+    if (flags & Core::TextDocument::FindWholeWords)
+        pattern = "\\b" + pattern + "\\b";
+    const auto patternOptions = (flags & (Core::TextDocument::FindCaseSensitively | Core::TextDocument::PreserveCase))
+        ? QRegularExpression::NoPatternOption
+        : QRegularExpression::CaseInsensitiveOption;
+    auto &cache = Utils::RegularExpressionCache::instance();
+    m_expression = text.isEmpty() ? QRegularExpression() : cache.regularExpression(pattern, patternOptions);
+
+    auto textDocument = qobject_cast<Core::TextDocument *>(Core::Project::instance()->currentDocument());
+    setTextEditor(textDocument ? textDocument->textEdit() : nullptr);
+    highlightVisibleMatches();
+    startCount();
+}
+
+void FindWidget::setTextEditor(QPlainTextEdit *textEdit)
+{
+    auto textEditor = qobject_cast<Core::TextEditor *>(textEdit);
+    if (textEditor == m_textEditor)
+        return;
+
+    if (m_textEditor) {
+        m_textEditor->setSearchHighlights({});
+        disconnect(m_textEditor, nullptr, this, nullptr);
+        disconnect(m_textEditor->verticalScrollBar(), nullptr, this, nullptr);
+    }
+    m_textEditor = textEditor;
+    if (m_textEditor) {
+        connect(m_textEditor->verticalScrollBar(), &QScrollBar::valueChanged, this,
+                &FindWidget::highlightVisibleMatches);
+        connect(m_textEditor, &QPlainTextEdit::textChanged, this, [this]() {
+            highlightVisibleMatches();
+            m_countTimer.start();
+        });
+    }
+}
+
+void FindWidget::highlightVisibleMatches()
+{
+    if (!m_textEditor)
+        return;
+
+    QList<QTextEdit::ExtraSelection> highlights;
+    if (m_expression.isValid() && !m_expression.pattern().isEmpty()) {
+        QTextCharFormat format;
+        format.setBackground(MatchColor);
+
+        const auto viewport = m_textEditor->viewport()->rect();
+        auto block = m_textEditor->cursorForPosition(viewport.topLeft()).block();
+        const int lastBlock = m_textEditor->cursorForPosition(viewport.bottomRight()).blockNumber();
+        for (; block.isValid() && block.blockNumber() <= lastBlock; block = block.next()) {
+            forEachMatch(block.text(), m_expression, [&](const QRegularExpressionMatch &match) {
+                QTextCursor cursor(block);
+                cursor.setPosition(block.position() + static_cast<int>(match.capturedStart()));
+                cursor.setPosition(block.position() + static_cast<int>(match.capturedEnd()), QTextCursor::KeepAnchor);
+                highlights.push_back({cursor, format});
+            });
+        }
+    }
+    m_textEditor->setSearchHighlights(highlights);
+}
+
+// The count is done on a snapshot of the text, a new count cancels the previous one
+void FindWidget::startCount()
+{
+    m_countTimer.stop();
+    m_countFuture.cancel();
+    m_countWatcher.setFuture(QFuture<int>());
+
+    if (!m_textEditor || ui->findEdit->text().isEmpty()) {
+        ui->matchLabel->clear();
+        ui->replaceAllbutton->setToolTip({});
+        return;
+    }
+    if (!m_expression.isValid()) {
+        ui->matchLabel->setText(tr("Invalid regular expression"));
+        ui->replaceAllbutton->setToolTip({});
+        return;
+    }
+
+    m_countFuture = QtConcurrent::run(countMatches, m_textEditor->toPlainText(), m_expression);
+    m_countWatcher.setFuture(m_countFuture);
+}
+
+void FindWidget::showCount()
+{
+    if (m_countFuture.isCanceled() || m_countFuture.resultCount() == 0)
+        return;
+
+    const int count = m_countFuture.result();
+    ui->matchLabel->setText(count == 0 ? tr("No matches") : tr("%n match(es)", nullptr, count));
+    // Preview of what replace all would do, without changing the document
+    ui->replaceAllbutton->setToolTip(tr("Replaces %n match(es)", nullptr, count));
+}
+
 } // namespace Gui
@@ -10,8 +10,19 @@
 
 #pragma once
 
+#include <QFuture>
+#include <QFutureWatcher>
+#include <QPointer>
+#include <QRegularExpression>
+#include <QTimer>
 #include <QWidget>
 
+class QPlainTextEdit;
+
+namespace Core {
+class TextEditor;
+}
+
 namespace Gui {
 
 namespace Ui {
@@ -31,6 +42,9 @@ public:
 
     void open();
 
+protected:
+    void hideEvent(QHideEvent *event) override;
+
 private:
     int findFlags() const;
     QString findString();
@@ -40,6 +54,13 @@ private:
     void replaceAll();
     void replace(bool onlyOne);
 
+    // Incremental search: the matches visible are highlighted right away, the total is counted in a thread
+    void updateSearch();
+    void setTextEditor(QPlainTextEdit *textEdit);
+    void highlightVisibleMatches();
+    void startCount();
+    void showCount();
+
     std::unique_ptr<Ui::FindWidget> ui;
     QAction *m_matchCase = nullptr;
     QAction *m_matchWord = nullptr;
@@ -48,6 +69,12 @@ private:
     QString m_defaultString;
     bool m_isDefaultSelection = false;
     bool m_firstTime = true;
+
+    QPointer<Core::TextEditor> m_textEditor;
+    QRegularExpression m_expression;
+    QTimer m_countTimer;
+    QFuture<int> m_countFuture;
+    QFutureWatcher<int> m_countWatcher;
 };
 
 } // namespace Gui
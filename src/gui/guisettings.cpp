@@ -11,8 +11,10 @@
 #include "guisettings.h"
 #include "core/document.h"
 #include "core/settings.h"
+#include "core/textdocument.h"
 #include "core/textdocument_p.h"
 #include "knutstyle.h"
+#include "largefilehighlighter.h"
 
 #include <QAction>
 #include <QApplication>
@@ -171,7 +173,7 @@ GuiSettings::ShortcutList GuiSettings::shortcuts() const
     return shortcuts;
 }
 
-static void setupHighlighter(KSyntaxHighlighting::SyntaxHighlighter *highlighter, const QString &theme,
+static void setupHighlighter(KSyntaxHighlighting::AbstractHighlighter *highlighter, const QString &theme,
                              const QString &fileName = {})
 {
     static KSyntaxHighlighting::Repository repository;
@@ -185,12 +187,17 @@ static void setupHighlighter(KSyntaxHighlighting::SyntaxHighlighter *highlighter
     }
 }
 
-KSyntaxHighlighting::SyntaxHighlighter *GuiSettings::initializeTextEdit(QPlainTextEdit *textEdit,
-                                                                        const QString &fileName)
+QObject *GuiSettings::initializeTextEdit(QPlainTextEdit *textEdit, const QString &fileName, bool largeFile)
 {
     textEdit->setProperty(IsDocument, true);
     instance()->updateTextEdit(textEdit, instance()->computeTextEditSettings());
 
+    // QSyntaxHighlighter highlights the whole document synchronously, which freezes the GUI for large files
+    if (largeFile || textEdit->document()->characterCount() > LargeFileHighlighter::MinimumCharacterCount) {
+        auto highlighter = new LargeFileHighlighter(textEdit);
+        setupHighlighter(highlighter, instance()->m_theme, fileName);
+        return highlighter;
+    }
     auto highlighter = new KSyntaxHighlighting::SyntaxHighlighter(textEdit->document());
     setupHighlighter(highlighter, instance()->m_theme, fileName);
     return highlighter;
@@ -199,9 +206,16 @@ KSyntaxHighlighting::SyntaxHighlighter *GuiSettings::initializeTextEdit(QPlainTe
 void GuiSettings::setupDocumentTextEdit(QPlainTextEdit *textEdit, Core::Document *document)
 {
     const auto &fileName = document->fileName();
-    auto highlighter = initializeTextEdit(textEdit, fileName);
-
-    connect(document, &Core::Document::fileUpdated, highlighter, &KSyntaxHighlighting::SyntaxHighlighter::rehighlight);
+    const auto textDocument = qobject_cast<Core::TextDocument *>(document);
+    auto highlighter = initializeTextEdit(textEdit, fileName, textDocument && textDocument->isLargeFile());
+
+    if (auto largeFileHighlighter = qobject_cast<LargeFileHighlighter *>(highlighter)) {
+        connect(document, &Core::Document::fileUpdated, largeFileHighlighter, &LargeFileHighlighter::rehighlight);
+    } else {
+        auto syntaxHighlighter = static_cast<KSyntaxHighlighting::SyntaxHighlighter *>(highlighter);
+        connect(document, &Core::Document::fileUpdated, syntaxHighlighter,
+                &KSyntaxHighlighting::SyntaxHighlighter::rehighlight);
+    }
 }
 
 void GuiSettings::setupFileNameTextEdit(QPlainTextEdit *textEdit, const QString &fileName)
@@ -293,6 +307,11 @@ void GuiSettings::updateTheme() const
             setupHighlighter(highlighter, m_theme);
             highlighter->rehighlight();
         }
+        const auto largeFileHighlighters = topLevel->findChildren<LargeFileHighlighter *>();
+        for (auto *highlighter : largeFileHighlighters) {
+            setupHighlighter(highlighter, m_theme);
+            highlighter->rehighlight();
+        }
     }
 }
 
@@ -21,7 +21,7 @@ class QPlainTextEdit;
 class QObject;
 
 namespace KSyntaxHighlighting {
-class SyntaxHighlighter;
+class AbstractHighlighter;
 }
 
 namespace Core {
@@ -84,8 +84,8 @@ private:
     TextEditSettings computeTextEditSettings() const;
     void updateTextEdit(QPlainTextEdit *textEdit, const TextEditSettings &settings) const;
 
-    static KSyntaxHighlighting::SyntaxHighlighter *initializeTextEdit(QPlainTextEdit *textEdit,
-                                                                      const QString &fileName);
+    // Returns the highlighter, either a KSyntaxHighlighting::SyntaxHighlighter or a LargeFileHighlighter
+    static QObject *initializeTextEdit(QPlainTextEdit *textEdit, const QString &fileName, bool largeFile = false);
 
     void updateIcons() const;
     void updateIcon(QObject *object, const QString &asset) const;
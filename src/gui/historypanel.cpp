@@ -10,6 +10,7 @@
 
 #include "historypanel.h"
 #include "core/logger.h"
+#include "core/settings.h"
 #include "guisettings.h"
 
 #include <QAction>
@@ -29,6 +30,7 @@ HistoryPanel::HistoryPanel(QWidget *parent)
     setWindowTitle(tr("History"));
     setObjectName("HistoryPanel");
 
+    m_model->setCapacity(Core::Settings::instance()->value<int>(Core::Settings::LogHistoryCapacity));
     setModel(m_model);
     header()->setStretchLastSection(true);
     header()->setSectionResizeMode(Core::HistoryModel::NameCol, QHeaderView::ResizeToContents);
@@ -37,6 +39,11 @@ HistoryPanel::HistoryPanel(QWidget *parent)
         scrollTo(m_model->index(m_model->rowCount() - 1, 0));
     };
     connect(m_model, &QAbstractItemModel::rowsInserted, this, showLast);
+    // The oldest calls are removed once the capacity is reached
+    connect(m_model, &QAbstractItemModel::rowsRemoved, this, [this](const QModelIndex &, int first, int last) {
+        if (m_startRow != -1)
+            m_startRow = std::max(0, m_startRow - (last - first + 1));
+    });
 
     auto layout = new QHBoxLayout(m_toolBar);
     layout->setContentsMargins({});
@@ -68,6 +75,7 @@ bool HistoryPanel::isRecording() const
 
 void HistoryPanel::startRecording()
 {
+    m_model->flush();
     m_startRow = m_model->rowCount();
     m_clearButton->setEnabled(false);
     emit recordingChanged(true);
@@ -75,6 +83,7 @@ void HistoryPanel::startRecording()
 
 void HistoryPanel::stopRecording()
 {
+    m_model->flush();
     emit scriptCreated(m_model->createScript(m_startRow, m_model->rowCount() - 1));
     m_clearButton->setEnabled(true);
     m_startRow = -1;
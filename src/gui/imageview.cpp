@@ -13,6 +13,7 @@
 #include "guisettings.h"
 
 #include <QGraphicsItem>
+#include <QGraphicsPixmapItem>
 #include <QGraphicsScene>
 #include <QShortcut>
 #include <QWheelEvent>
@@ -35,7 +36,7 @@ ImageView::ImageView(QWidget *parent)
     zoomIn->setShortcut(QKeySequence("Ctrl++"));
     zoomIn->setShortcutContext(Qt::WidgetShortcut);
     connect(zoomIn, &QAction::triggered, this, [this]() {
-        scale(2, 2);
+        zoom(2);
     });
     addAction(zoomIn);
 
@@ -44,22 +45,49 @@ ImageView::ImageView(QWidget *parent)
     zoomOut->setShortcut(QKeySequence("Ctrl+-"));
     zoomOut->setShortcutContext(Qt::WidgetShortcut);
     connect(zoomOut, &QAction::triggered, this, [this]() {
-        scale(.5, .5);
+        zoom(.5);
     });
     addAction(zoomOut);
 }
 
 void ImageView::setImageDocument(Core::ImageDocument *document)
 {
-    scene()->addPixmap(QPixmap::fromImage(document->image()));
+    m_document = document;
+    connect(document, &Core::ImageDocument::previewChanged, this, &ImageView::updateImage);
+    updateImage();
+}
+
+void ImageView::updateImage()
+{
+    if (!m_document)
+        return;
+    const auto image = m_fullResolution ? m_document->image() : m_document->preview();
+    if (image.isNull())
+        return;
+
+    if (!m_item)
+        m_item = scene()->addPixmap({});
+    m_item->setPixmap(QPixmap::fromImage(image));
+    // The preview is displayed at the size of the full image
+    m_item->setScale(static_cast<double>(m_document->imageSize().width()) / image.width());
+}
+
+void ImageView::zoom(double factor)
+{
+    scale(factor, factor);
+    // Only decode the full resolution image once the preview is magnified
+    if (!m_fullResolution && m_item && transform().m11() * m_item->scale() > 1) {
+        m_fullResolution = true;
+        updateImage();
+    }
 }
 
 void ImageView::wheelEvent(QWheelEvent *event)
 {
     if (event->angleDelta().y() > 0)
-        scale(2, 2);
+        zoom(2);
     else
-        scale(.5, .5);
+        zoom(.5);
 
     QGraphicsView::wheelEvent(event);
 }
@@ -11,6 +11,9 @@
 #pragma once
 
 #include <QGraphicsView>
+#include <QPointer>
+
+class QGraphicsPixmapItem;
 
 namespace Core {
 class ImageDocument;
@@ -29,6 +32,15 @@ public:
 protected:
     void wheelEvent(QWheelEvent *event) override;
     void drawBackground(QPainter *painter, const QRectF &rect) override;
+
+private:
+    void updateImage();
+    void zoom(double factor);
+
+    QPointer<Core::ImageDocument> m_document;
+    QGraphicsPixmapItem *m_item = nullptr;
+    // The preview is shown until the image is zoomed in
+    bool m_fullResolution = false;
 };
 
 } // namespace Gui
@@ -0,0 +1,192 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "largefilehighlighter.h"
+
+#include <QElapsedTimer>
+#include <QPlainTextEdit>
+#include <QScrollBar>
+#include <QTextBlock>
+#include <QTextDocument>
+#include <algorithm>
+#include <format.h>
+#include <state.h>
+#include <theme.h>
+
+namespace Gui {
+
+// Number of blocks highlighted above and below the visible ones
+constexpr int VisibleBlockMargin = 100;
+// Maximum duration of one chunk of idle highlighting, so the GUI stays responsive
+constexpr int ChunkDuration = 10;
+
+namespace {
+
+struct BlockState : public QTextBlockUserData
+{
+    KSyntaxHighlighting::State input;
+    KSyntaxHighlighting::State output;
+    // Generation of the highlighter if the input state is exact, -1 if it's an approximation
+    int generation = -1;
+};
+
+BlockState *blockState(const QTextBlock &block)
+{
+    return static_cast<BlockState *>(block.userData());
+}
+
+} // namespace
+
+LargeFileHighlighter::LargeFileHighlighter(QPlainTextEdit *textEdit)
+    : QObject(textEdit->document())
+    , m_textEdit(textEdit)
+{
+    m_idleTimer.setSingleShot(true);
+    m_idleTimer.setInterval(0);
+    connect(&m_idleTimer, &QTimer::timeout, this, &LargeFileHighlighter::highlightNextChunk);
+
+    connect(textEdit->document(), &QTextDocument::contentsChange, this, &LargeFileHighlighter::changeContents);
+    connect(textEdit->verticalScrollBar(), &QScrollBar::valueChanged, this,
+            &LargeFileHighlighter::highlightVisibleBlocks);
+
+    // Wait for the definition and theme to be set
+    QTimer::singleShot(0, this, &LargeFileHighlighter::rehighlight);
+}
+
+LargeFileHighlighter::~LargeFileHighlighter() = default;
+
+void LargeFileHighlighter::rehighlight()
+{
+    ++m_generation;
+    m_nextBlock = 0;
+    highlightVisibleBlocks();
+    m_idleTimer.start();
+}
+
+void LargeFileHighlighter::applyFormat(int offset, int length, const KSyntaxHighlighting::Format &format)
+{
+    if (format.isDefaultTextStyle(theme()))
+        return;
+
+    QTextCharFormat charFormat;
+    if (format.hasTextColor(theme()))
+        charFormat.setForeground(format.textColor(theme()));
+    if (format.hasBackgroundColor(theme()))
+        charFormat.setBackground(format.backgroundColor(theme()));
+    if (format.isBold(theme()))
+        charFormat.setFontWeight(QFont::Bold);
+    if (format.isItalic(theme()))
+        charFormat.setFontItalic(true);
+    if (format.isUnderline(theme()))
+        charFormat.setFontUnderline(true);
+    if (format.isStrikeThrough(theme()))
+        charFormat.setFontStrikeOut(true);
+    m_formats.push_back({offset, length, charFormat});
+}
+
+void LargeFileHighlighter::highlightVisibleBlocks()
+{
+    if (!definition().isValid())
+        return;
+
+    auto document = m_textEdit->document();
+    const auto viewport = m_textEdit->viewport()->rect();
+    const int firstVisible = m_textEdit->cursorForPosition(viewport.topLeft()).blockNumber();
+    const int lastVisible = m_textEdit->cursorForPosition(viewport.bottomLeft()).blockNumber();
+    const int first = std::max(0, firstVisible - VisibleBlockMargin);
+    const int last = lastVisible + VisibleBlockMargin;
+
+    auto block = document->findBlockByNumber(first);
+    for (int number = first; number <= last && block.isValid(); ++number) {
+        auto data = blockState(block);
+        if (!data || (data->generation != m_generation && number >= m_nextBlock)) {
+            // The best state known is the one of the previous block, even if it's only an approximation
+            const auto previous = blockState(block.previous());
+            const bool exact = number == m_nextBlock || (previous && previous->generation == m_generation);
+            highlightBlock(block, previous ? previous->output : KSyntaxHighlighting::State(), exact);
+        }
+        block = block.next();
+    }
+}
+
+void LargeFileHighlighter::highlightNextChunk()
+{
+    if (!definition().isValid())
+        return;
+
+    auto block = m_textEdit->document()->findBlockByNumber(m_nextBlock);
+    const auto previous = blockState(block.previous());
+    auto state = previous ? previous->output : KSyntaxHighlighting::State();
+
+    QElapsedTimer timer;
+    timer.start();
+    while (block.isValid() && timer.elapsed() < ChunkDuration) {
+        auto data = blockState(block);
+        if (data && data->generation == m_generation && data->input == state) {
+            // Already highlighted with the same state, it won't change
+            state = data->output;
+        } else {
+            state = highlightBlock(block, state, true);
+        }
+        ++m_nextBlock;
+        block = block.next();
+    }
+
+    if (block.isValid())
+        m_idleTimer.start();
+}
+
+KSyntaxHighlighting::State LargeFileHighlighter::highlightBlock(QTextBlock &block,
+                                                                const KSyntaxHighlighting::State &state, bool exact)
+{
+    m_formats.clear();
+    const auto newState = highlightLine(block.text(), state);
+
+    auto data = blockState(block);
+    if (!data) {
+        data = new BlockState;
+        block.setUserData(data);
+    }
+    data->input = state;
+    data->output = newState;
+    data->generation = exact ? m_generation : -1;
+
+    // Same as QSyntaxHighlighter, the formats are only used for the layout, they are not part of the document
+    m_applyingFormats = true;
+    block.layout()->setFormats(m_formats);
+    m_textEdit->document()->markContentsDirty(block.position(), block.length());
+    m_applyingFormats = false;
+    return newState;
+}
+
+void LargeFileHighlighter::changeContents(int position, int charsRemoved, int charsAdded)
+{
+    Q_UNUSED(charsRemoved)
+    if (m_applyingFormats)
+        return;
+
+    auto document = m_textEdit->document();
+    auto block = document->findBlock(position);
+    const auto lastBlock = document->findBlock(position + charsAdded);
+    m_nextBlock = std::min(m_nextBlock, block.blockNumber());
+    // The changed blocks need to be highlighted again, even if their input state is the same
+    while (block.isValid()) {
+        if (auto data = blockState(block))
+            data->generation = -1;
+        if (block == lastBlock)
+            break;
+        block = block.next();
+    }
+
+    highlightVisibleBlocks();
+    m_idleTimer.start();
+}
+
+} // namespace Gui
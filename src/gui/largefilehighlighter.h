@@ -0,0 +1,73 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QList>
+#include <QObject>
+#include <QTextLayout>
+#include <QTimer>
+#include <abstracthighlighter.h>
+
+class QPlainTextEdit;
+class QTextBlock;
+
+namespace KSyntaxHighlighting {
+class State;
+}
+
+namespace Gui {
+
+/**
+ * \brief Syntax highlighter for large files
+ *
+ * Unlike KSyntaxHighlighting::SyntaxHighlighter, which highlights the whole document synchronously, only the blocks
+ * visible in the text edit (plus a margin) are highlighted right away. The rest of the document is highlighted in
+ * small chunks when the event loop is idle.
+ *
+ * The visible blocks may be highlighted before the blocks above them, with an approximate state: they are
+ * highlighted again once the idle highlighting reaches them.
+ */
+class LargeFileHighlighter : public QObject, public KSyntaxHighlighting::AbstractHighlighter
+{
+    Q_OBJECT
+
+public:
+    explicit LargeFileHighlighter(QPlainTextEdit *textEdit);
+    ~LargeFileHighlighter() override;
+
+    // Documents with more characters should use this highlighter
+    static constexpr int MinimumCharacterCount = 1024 * 1024;
+
+public slots:
+    void rehighlight();
+
+protected:
+    void applyFormat(int offset, int length, const KSyntaxHighlighting::Format &format) override;
+
+private:
+    void highlightVisibleBlocks();
+    void highlightNextChunk();
+    KSyntaxHighlighting::State highlightBlock(QTextBlock &block, const KSyntaxHighlighting::State &state,
+                                              bool exact);
+    void changeContents(int position, int charsRemoved, int charsAdded);
+
+    QPlainTextEdit *const m_textEdit;
+    QTimer m_idleTimer;
+    // Incremented on each rehighlight, a block is highlighted with an exact state if its generation is this one
+    int m_generation = 0;
+    // All blocks before this one are highlighted with an exact state
+    int m_nextBlock = 0;
+    // Formats of the block being highlighted
+    QList<QTextLayout::FormatRange> m_formats;
+    bool m_applyingFormats = false;
+};
+
+} // namespace Gui
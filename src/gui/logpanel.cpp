@@ -9,79 +9,302 @@
 */
 
 #include "logpanel.h"
+#include "core/knutcore.h"
 #include "guisettings.h"
 #include "utils/log.h"
 
+#include <QAbstractListModel>
+#include <QApplication>
 #include <QComboBox>
 #include <QHBoxLayout>
 #include <QLabel>
-#include <QMetaObject>
-#include <QPlainTextEdit>
-#include <QPointer>
-#include <QSyntaxHighlighter>
-#include <QTextCharFormat>
+#include <QPainter>
+#include <QScrollBar>
+#include <QStyledItemDelegate>
 #include <QToolButton>
+#include <algorithm>
+#include <deque>
 #include <mutex>
-#include <spdlog/sinks/qt_sinks.h>
+#include <spdlog/sinks/base_sink.h>
+#include <utility>
 
 namespace Gui {
 
-class LogHighlighter : public QSyntaxHighlighter
+// Maximum number of lines kept in the log panel, older ones are removed
+constexpr size_t MaximumLineCount = 100000;
+// Interval between two batches of lines added to the model
+constexpr int FlushInterval = 100;
+
+struct LogLine
+{
+    spdlog::level::level_enum level;
+    QString text;
+    // Range of the level name in the text
+    int levelStart = 0;
+    int levelLength = 0;
+};
+
+// Sink storing the formatted messages until they are taken by the panel, it can be used from any thread
+class LogSink : public spdlog::sinks::base_sink<std::mutex>
 {
 public:
-    explicit LogHighlighter(QTextDocument *parent = nullptr)
-        : QSyntaxHighlighter(parent)
+    std::deque<LogLine> takeLines()
     {
-        auto getFormat = [](const QColor &color, const QColor &background = {}) {
-            QTextCharFormat format;
-            format.setForeground(color);
-            if (background.isValid())
-                format.setBackground(background);
-            return format;
-        };
-        m_rules = {
-            {"[trace]", getFormat(QColor(128, 128, 128))},
-            {"[debug]", getFormat(Qt::cyan)},
-            {"[info]", getFormat(Qt::green)},
-            {"[warning]", getFormat(QColor(255, 220, 0))},
-            {"[error]", getFormat(Qt::red)},
-            {"[critical]", getFormat(Qt::white, Qt::red)},
-        };
+        std::lock_guard lock(mutex_);
+        return std::exchange(m_lines, {});
     }
 
 protected:
-    void highlightBlock(const QString &text) override
+    void sink_it_(const spdlog::details::log_msg &msg) override
     {
-        for (const auto &rule : std::as_const(m_rules)) {
-            if (int start = text.indexOf(rule.keyword); start != -1)
-                setFormat(start + 1, rule.keyword.length() - 2, rule.format);
+        spdlog::memory_buf_t formatted;
+        formatter_->format(msg, formatted);
+        auto size = formatted.size();
+        while (size > 0 && (formatted[size - 1] == '\n' || formatted[size - 1] == '\r'))
+            --size;
+
+        LogLine line {msg.level, QString::fromUtf8(formatted.data(), size)};
+        if (msg.color_range_end > msg.color_range_start) {
+            line.levelStart = QString::fromUtf8(formatted.data(), msg.color_range_start).size();
+            line.levelLength = QString::fromUtf8(formatted.data() + msg.color_range_start,
+                                                 msg.color_range_end - msg.color_range_start)
+                                   .size();
         }
+        m_lines.push_back(std::move(line));
+        // The panel won't display more lines anyway
+        if (m_lines.size() > MaximumLineCount)
+            m_lines.pop_front();
     }
+    void flush_() override { }
 
 private:
-    struct HighlightingRule
-    {
-        QString keyword;
-        QTextCharFormat format;
+    std::deque<LogLine> m_lines;
+};
+
+// Model of the last log lines, only the lines with a level higher than the one set are listed
+class LogModel : public QAbstractListModel
+{
+public:
+    enum Roles {
+        LevelStartRole = Qt::UserRole,
+        LevelLengthRole,
+        LevelRole,
     };
-    QVector<HighlightingRule> m_rules;
+
+    using QAbstractListModel::QAbstractListModel;
+
+    int rowCount(const QModelIndex &parent = {}) const override
+    {
+        return parent.isValid() ? 0 : static_cast<int>(m_rows.size());
+    }
+
+    QVariant data(const QModelIndex &index, int role) const override
+    {
+        if (!index.isValid() || index.row() >= rowCount())
+            return {};
+        const auto &line = m_lines[m_rows[index.row()] - m_firstId];
+        switch (role) {
+        case Qt::DisplayRole:
+            return line.text;
+        case LevelStartRole:
+            return line.levelStart;
+        case LevelLengthRole:
+            return line.levelLength;
+        case LevelRole:
+            return static_cast<int>(line.level);
+        }
+        return {};
+    }
+
+    void addLines(std::deque<LogLine> lines)
+    {
+        if (lines.empty())
+            return;
+        while (lines.size() > MaximumLineCount)
+            lines.pop_front();
+
+        // Remove the oldest lines first, the ids of the lines are kept in m_rows so they don't change
+        const auto totalCount = static_cast<qint64>(m_lines.size() + lines.size());
+        const auto extraCount = totalCount - static_cast<qint64>(MaximumLineCount);
+        if (extraCount > 0) {
+            const qint64 firstKeptId = m_firstId + extraCount;
+            const auto removedRows = std::distance(
+                m_rows.cbegin(), std::lower_bound(m_rows.cbegin(), m_rows.cend(), firstKeptId));
+            if (removedRows > 0) {
+                beginRemoveRows({}, 0, static_cast<int>(removedRows) - 1);
+                m_rows.erase(m_rows.begin(), m_rows.begin() + removedRows);
+                endRemoveRows();
+            }
+            m_lines.erase(m_lines.begin(), m_lines.begin() + extraCount);
+            m_firstId = firstKeptId;
+        }
+
+        std::vector<qint64> newRows;
+        for (auto &line : lines) {
+            if (line.level >= m_level) {
+                newRows.push_back(m_firstId + static_cast<qint64>(m_lines.size()));
+                m_maximumLength = std::max(m_maximumLength, static_cast<int>(line.text.size()));
+            }
+            m_lines.push_back(std::move(line));
+        }
+        if (newRows.empty())
+            return;
+        const int first = rowCount();
+        beginInsertRows({}, first, first + static_cast<int>(newRows.size()) - 1);
+        m_rows.insert(m_rows.end(), newRows.cbegin(), newRows.cend());
+        endInsertRows();
+    }
+
+    void setLevel(spdlog::level::level_enum level)
+    {
+        if (level == m_level)
+            return;
+        beginResetModel();
+        m_level = level;
+        m_rows.clear();
+        m_maximumLength = 0;
+        for (size_t i = 0; i < m_lines.size(); ++i) {
+            if (m_lines[i].level >= m_level) {
+                m_rows.push_back(m_firstId + static_cast<qint64>(i));
+                m_maximumLength = std::max(m_maximumLength, static_cast<int>(m_lines[i].text.size()));
+            }
+        }
+        endResetModel();
+    }
+
+    void clear()
+    {
+        beginResetModel();
+        m_firstId += static_cast<qint64>(m_lines.size());
+        m_lines.clear();
+        m_rows.clear();
+        m_maximumLength = 0;
+        endResetModel();
+    }
+
+    // Length of the longest line listed
+    int maximumLength() const { return m_maximumLength; }
+
+private:
+    // Ring buffer of the last lines, the id of m_lines[i] is m_firstId + i
+    std::deque<LogLine> m_lines;
+    qint64 m_firstId = 0;
+    // Ids of the lines listed by the model
+    std::deque<qint64> m_rows;
+    spdlog::level::level_enum m_level = spdlog::level::trace;
+    int m_maximumLength = 0;
+};
+
+namespace {
+
+struct LevelFormat
+{
+    QColor foreground;
+    QColor background;
+};
+
+LevelFormat levelFormat(int level)
+{
+    switch (level) {
+    case spdlog::level::trace:
+        return {QColor(128, 128, 128), {}};
+    case spdlog::level::debug:
+        return {Qt::cyan, {}};
+    case spdlog::level::info:
+        return {Qt::green, {}};
+    case spdlog::level::warn:
+        return {QColor(255, 220, 0), {}};
+    case spdlog::level::err:
+        return {Qt::red, {}};
+    case spdlog::level::critical:
+        return {Qt::white, Qt::red};
+    }
+    return {};
+}
+
+// Paint one line, with the level name colored, all lines have the same size
+class LogDelegate : public QStyledItemDelegate
+{
+public:
+    LogDelegate(LogModel *model, QObject *parent)
+        : QStyledItemDelegate(parent)
+        , m_model(model)
+    {
+    }
+
+    void paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const override
+    {
+        QStyleOptionViewItem opt = option;
+        initStyleOption(&opt, index);
+        const QString text = opt.text;
+        opt.text.clear();
+        const auto style = opt.widget ? opt.widget->style() : QApplication::style();
+        style->drawControl(QStyle::CE_ItemViewItem, &opt, painter, opt.widget);
+
+        const int levelStart = index.data(LogModel::LevelStartRole).toInt();
+        const int levelLength = index.data(LogModel::LevelLengthRole).toInt();
+        const auto format = levelFormat(index.data(LogModel::LevelRole).toInt());
+        const QColor textColor = opt.palette.color(
+            (opt.state & QStyle::State_Selected) ? QPalette::HighlightedText : QPalette::Text);
+
+        painter->save();
+        painter->setFont(opt.font);
+        int x = opt.rect.left() + TextMargin;
+        auto drawText = [&](QStringView part, const QColor &color, const QColor &background = {}) {
+            const int width = opt.fontMetrics.horizontalAdvance(part.toString());
+            const QRect rect(x, opt.rect.top(), width, opt.rect.height());
+            if (background.isValid())
+                painter->fillRect(rect, background);
+            painter->setPen(color);
+            painter->drawText(rect, Qt::AlignLeft | Qt::AlignVCenter | Qt::TextSingleLine, part.toString());
+            x += width;
+        };
+        const QStringView view(text);
+        drawText(view.first(levelStart), textColor);
+        drawText(view.sliced(levelStart, levelLength), format.foreground, format.background);
+        drawText(view.sliced(levelStart + levelLength), textColor);
+        painter->restore();
+    }
+
+    QSize sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const override
+    {
+        Q_UNUSED(index)
+        // The font is monospace, the width is enough to display the longest line
+        const auto &metrics = option.fontMetrics;
+        return {metrics.horizontalAdvance(QLatin1Char('M')) * m_model->maximumLength() + 2 * TextMargin,
+                metrics.height()};
+    }
+
+private:
+    static constexpr int TextMargin = 3;
+    LogModel *const m_model;
 };
 
+} // namespace
+
 LogPanel::LogPanel(QWidget *parent)
-    : QPlainTextEdit(parent)
+    : QListView(parent)
     , m_toolBar(new QWidget)
+    , m_model(new LogModel(this))
+    , m_sink(std::make_shared<LogSink>())
 {
     setWindowTitle(tr("Log Output"));
     setObjectName("LogPanel");
-    setReadOnly(true);
 
     auto logger = spdlog::default_logger();
-    logger->sinks().push_back(std::make_shared<spdlog::sinks::qt_sink_mt>(this, "appendPlainText"));
+    Core::KnutCore::addLogSink(m_sink);
+
+    // Setup view, all lines have the same height so only the visible ones are laid out and painted
+    setModel(m_model);
+    setItemDelegate(new LogDelegate(m_model, this));
+    setUniformItemSizes(true);
+    setSelectionMode(QAbstractItemView::ExtendedSelection);
+    setHorizontalScrollMode(QAbstractItemView::ScrollPerPixel);
+    setFont(QFont(GuiSettings::instance()->fontFamily(), GuiSettings::instance()->fontSize()));
 
-    // Setup text edit
-    new LogHighlighter(document());
-    setWordWrapMode(QTextOption::NoWrap);
-    GuiSettings::setupTextEdit(this);
+    m_flushTimer.setInterval(FlushInterval);
+    connect(&m_flushTimer, &QTimer::timeout, this, &LogPanel::flushLines);
+    m_flushTimer.start();
 
     // Setup titlebar
     auto layout = new QHBoxLayout(m_toolBar);
@@ -92,21 +315,24 @@ LogPanel::LogPanel(QWidget *parent)
     clearButton->setToolTip(tr("Clear"));
     clearButton->setAutoRaise(true);
     layout->addWidget(clearButton);
-    connect(clearButton, &QToolButton::clicked, this, &QPlainTextEdit::clear);
+    connect(clearButton, &QToolButton::clicked, m_model, &LogModel::clear);
 
     layout->addWidget(new QLabel(tr("Level:")));
     auto levelCombo = new QComboBox(m_toolBar);
     levelCombo->addItems({"trace", "debug", "info", "warning", "error", "critical"});
     levelCombo->setCurrentIndex(logger->level());
+    m_model->setLevel(logger->level());
     layout->addWidget(levelCombo);
-    connect(levelCombo, qOverload<int>(&QComboBox::currentIndexChanged), levelCombo, [logger](int index) {
-        logger->set_level(static_cast<spdlog::level::level_enum>(index));
+    connect(levelCombo, qOverload<int>(&QComboBox::currentIndexChanged), this, [this](int index) {
+        const auto level = static_cast<spdlog::level::level_enum>(index);
+        spdlog::default_logger()->set_level(level);
+        m_model->setLevel(level);
     });
 }
+
 LogPanel::~LogPanel()
 {
-    auto logger = spdlog::default_logger();
-    logger->sinks().pop_back();
+    Core::KnutCore::removeLogSink(m_sink);
 }
 
 QWidget *LogPanel::toolBar() const
@@ -114,4 +340,20 @@ QWidget *LogPanel::toolBar() const
     return m_toolBar;
 }
 
+void LogPanel::flushLines()
+{
+    auto lines = m_sink->takeLines();
+    if (lines.empty())
+        return;
+
+    // Follow the new lines only if the last line was visible
+    const bool atBottom = verticalScrollBar()->value() == verticalScrollBar()->maximum();
+    const int maximumLength = m_model->maximumLength();
+    m_model->addLines(std::move(lines));
+    if (m_model->maximumLength() != maximumLength)
+        scheduleDelayedItemsLayout();
+    if (atBottom)
+        scrollToBottom();
+}
+
 } // namespace Gui
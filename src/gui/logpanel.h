@@ -10,12 +10,25 @@
 
 #pragma once
 
-#include <QPlainTextEdit>
+#include <QListView>
+#include <QTimer>
+#include <memory>
 
 namespace Gui {
 
-class LogPanel : public QPlainTextEdit
+class LogModel;
+class LogSink;
+
+/**
+ * \brief Panel displaying the log output
+ *
+ * The log messages are buffered by the sink and added to the model in batches, at most once every
+ * 100ms. The model only keeps the last lines, and filters them by level.
+ */
+class LogPanel : public QListView
 {
+    Q_OBJECT
+
 public:
     explicit LogPanel(QWidget *parent = nullptr);
     ~LogPanel() override;
@@ -23,7 +36,12 @@ public:
     QWidget *toolBar() const;
 
 private:
+    void flushLines();
+
     QWidget *const m_toolBar = nullptr;
+    LogModel *const m_model = nullptr;
+    std::shared_ptr<LogSink> m_sink;
+    QTimer m_flushTimer;
 };
 
 } // namespace Gui
@@ -48,22 +48,30 @@
 #include "toolbar.h"
 #include "treesitterinspector.h"
 #include "ui_mainwindow.h"
+#include "utils/log.h"
+#include "utils/metrics.h"
 
 #include <QApplication>
+#include <QDialog>
+#include <QDialogButtonBox>
 #include <QDir>
 #include <QDockWidget>
+#include <QElapsedTimer>
 #include <QFileDialog>
 #include <QFileInfo>
 #include <QFileSystemModel>
+#include <QFontDatabase>
 #include <QHeaderView>
 #include <QLabel>
 #include <QMessageBox>
 #include <QPlainTextEdit>
+#include <QPushButton>
 #include <QScopedValueRollback>
 #include <QSettings>
 #include <QShortcut>
 #include <QToolButton>
 #include <QTreeView>
+#include <QVBoxLayout>
 
 namespace Gui {
 
@@ -72,8 +80,16 @@ constexpr char RecentProjectKey[] = "RecentProject";
 constexpr char GeometryKey[] = "MainWindow/Geometry";
 constexpr char WindowStateKey[] = "MainWindow/WindowState";
 
+static QElapsedTimer startedTimer()
+{
+    QElapsedTimer timer;
+    timer.start();
+    return timer;
+}
+
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
+    , m_startupTimer(startedTimer())
     , ui(new Ui::MainWindow)
     , m_fileModel(new QFileSystemModel(this))
     , m_projectView(new QTreeView(this))
@@ -109,7 +125,12 @@ MainWindow::MainWindow(QWidget *parent)
     auto scriptDock = createDock(m_scriptPanel, Qt::LeftDockWidgetArea, m_scriptPanel->toolBar());
     auto scriptListDock = createDock(m_scriptlistpanel, Qt::BottomDockWidgetArea, m_scriptlistpanel->toolBar());
     scriptListDock->setAllowedAreas(Qt::AllDockWidgetAreas);
-    m_scriptlistpanel->setModel(Core::ScriptManager::model());
+    // The script list is only filled the first time it's shown, its name column is resized to the content on each
+    // change, which would slow down the startup
+    connect(scriptListDock, &QDockWidget::visibilityChanged, this, [this](bool visible) {
+        if (visible && !m_scriptlistpanel->model())
+            m_scriptlistpanel->setModel(Core::ScriptManager::model());
+    });
 
     // Ensure we display the script panel when a script is created
     auto showScriptPanel = [scriptDock]() {
@@ -187,6 +208,7 @@ MainWindow::MainWindow(QWidget *parent)
         m_palette->showPalette(">");
     };
     connect(ui->actionCommandPalette, &QAction::triggered, this, showCommandPalette);
+    connect(ui->actionShowMetrics, &QAction::triggered, this, &MainWindow::showMetrics);
 
     // About
     connect(ui->actionAboutKnut, &QAction::triggered, this, &MainWindow::aboutKnut);
@@ -362,6 +384,15 @@ void MainWindow::showEvent(QShowEvent *event)
     restoreState(settings.value(WindowStateKey).toByteArray());
 }
 
+void MainWindow::paintEvent(QPaintEvent *event)
+{
+    QMainWindow::paintEvent(event);
+    if (m_startupTimer.isValid()) {
+        spdlog::debug("MainWindow: first paint {}ms after the construction", m_startupTimer.elapsed());
+        m_startupTimer.invalidate();
+    }
+}
+
 void MainWindow::openProject()
 {
     auto path = QFileDialog::getExistingDirectory(this, tr("Open project"), QDir::currentPath());
@@ -488,7 +519,7 @@ void MainWindow::reloadDocuments()
             if (document->hasChanged())
                 conflictDocs.push_back(document);
             else
-                document->reload();
+                document->refresh();
         }
     }
 
@@ -582,6 +613,31 @@ See Wikipedia article: <a href="https://en.wikipedia.org/wiki/Saint_Knut%27s_Day
     dialog.exec();
 }
 
+void MainWindow::showMetrics()
+{
+    QDialog dialog(this);
+    dialog.setWindowTitle(tr("Metrics"));
+    dialog.resize(600, 600);
+
+    auto textEdit = new QPlainTextEdit(&dialog);
+    textEdit->setReadOnly(true);
+    textEdit->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    auto updateMetrics = [textEdit]() {
+        textEdit->setPlainText(QString::fromStdString(Utils::Metrics::toJson().dump(4)));
+    };
+    updateMetrics();
+
+    auto buttons = new QDialogButtonBox(QDialogButtonBox::Close, &dialog);
+    auto refreshButton = buttons->addButton(tr("Refresh"), QDialogButtonBox::ActionRole);
+    connect(refreshButton, &QPushButton::clicked, &dialog, updateMetrics);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+
+    auto layout = new QVBoxLayout(&dialog);
+    layout->addWidget(textEdit);
+    layout->addWidget(buttons);
+    dialog.exec();
+}
+
 void MainWindow::openOptions()
 {
     OptionsDialog dialog(this);
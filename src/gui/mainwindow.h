@@ -10,6 +10,7 @@
 
 #pragma once
 
+#include <QElapsedTimer>
 #include <QMainWindow>
 #include <memory>
 
@@ -47,6 +48,7 @@ public:
 protected:
     void closeEvent(QCloseEvent *event) override;
     void showEvent(QShowEvent *event) override;
+    void paintEvent(QPaintEvent *event) override;
 
 private:
     // File
@@ -86,6 +88,7 @@ private:
 
     // Help
     void aboutKnut();
+    void showMetrics();
 
     void updateActions();
     void updateScriptActions();
@@ -98,6 +101,8 @@ private:
     QDockWidget *createDock(QWidget *widget, Qt::DockWidgetArea area, QWidget *toolbar = nullptr);
     void reloadDocuments();
 
+    // Started before the panels are created, used to log the time to the first paint
+    QElapsedTimer m_startupTimer;
     std::unique_ptr<Ui::MainWindow> ui;
     QMenu *m_recentProjects = nullptr;
     QFileSystemModel *const m_fileModel = nullptr;
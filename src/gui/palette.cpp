@@ -19,20 +19,23 @@
 #include "gui_constants.h"
 #include "mainwindow.h"
 #include "ui_palette.h"
+#include "utils/string_helper.h"
 
 #include <QAbstractTableModel>
 #include <QAction>
-#include <QDirIterator>
-#include <QFileInfo>
+#include <QFutureWatcher>
 #include <QHeaderView>
 #include <QKeyEvent>
 #include <QMenuBar>
 #include <QPlainTextEdit>
+#include <QPointer>
 #include <QShowEvent>
 #include <QSignalBlocker>
 #include <QSortFilterProxyModel>
 #include <QTimer>
+#include <QtConcurrent/QtConcurrentMap>
 #include <algorithm>
+#include <memory>
 
 namespace Gui {
 
@@ -42,13 +45,25 @@ namespace Gui {
 class FileModel : public QAbstractTableModel
 {
 public:
-    using QAbstractTableModel::QAbstractTableModel;
+    explicit FileModel(QObject *parent = nullptr)
+        : QAbstractTableModel(parent)
+    {
+        QObject::connect(&m_watcher, &QFutureWatcher<Matches>::resultReadyAt, this, [this](int index) {
+            addMatches(m_watcher.resultAt(index));
+        });
+    }
+
+    ~FileModel() override
+    {
+        m_watcher.cancel();
+        m_watcher.waitForFinished();
+    }
 
     int rowCount(const QModelIndex &parent = QModelIndex()) const override
     {
         if (parent.isValid())
             return 0;
-        return static_cast<int>(m_files.size());
+        return static_cast<int>(m_pattern.isEmpty() ? m_files->size() : m_matches.size());
     }
     int columnCount(const QModelIndex &parent = QModelIndex()) const override
     {
@@ -61,18 +76,18 @@ public:
     {
         Q_ASSERT(checkIndex(index, CheckIndexOption::IndexIsValid));
 
+        const auto &file = m_files->at(m_pattern.isEmpty() ? index.row() : m_matches.at(index.row()).file);
         switch (role) {
         case Qt::DisplayRole:
             if (index.column() == 0) {
-                return m_files.at(index.row()).fileName;
+                return file.fileName;
             } else if (index.column() == 1) {
-                QDir dir(Core::Project::instance()->root());
-                return dir.relativeFilePath(m_files.at(index.row()).path);
+                return file.relativePath;
             }
             break;
         case Qt::ToolTipRole:
         case Qt::UserRole:
-            return m_files.at(index.row()).path;
+            return file.path;
         }
 
         return {};
@@ -80,45 +95,126 @@ public:
 
     void resetFileInfo()
     {
-        if (Core::Project::instance()->root().isEmpty())
+        const auto root = Core::Project::instance()->root();
+        if (root.isEmpty())
             return;
 
+        cancelFilter();
         beginResetModel();
 
-        m_files = allFilesInDirectory(Core::Project::instance()->root());
+        Core::LoggerDisabler ld;
+        // The files come from the project index, they are kept in the index order: sorting is only done on the
+        // matches when filtering
+        const auto files = Core::Project::instance()->allFiles(Core::Project::FullPath);
+        auto fileInfos = std::make_shared<std::vector<FileInfo>>();
+        fileInfos->reserve(files.size());
+        for (const auto &file : files) {
+            const auto relativePath = file.startsWith(root) ? file.mid(root.size() + 1) : file;
+            fileInfos->push_back({file.mid(file.lastIndexOf('/') + 1), relativePath, file});
+        }
+        m_files = std::move(fileInfos);
+        m_pattern.clear();
+        m_matches.clear();
 
-        auto byFileName = [](const auto &fi1, const auto &fi2) {
-            return fi1.fileName < fi2.fileName;
-        };
-        std::ranges::sort(m_files, byFileName);
+        endResetModel();
+    }
+
+    // Only the best matches are kept, the files are scored in parallel chunks and the model is updated each time a
+    // chunk is done
+    void setFilter(const QString &filter)
+    {
+        auto pattern = filter;
+        pattern.remove(' ');
+        if (pattern == m_pattern)
+            return;
 
+        cancelFilter();
+        beginResetModel();
+        m_pattern = pattern;
+        m_matches.clear();
         endResetModel();
+        if (m_pattern.isEmpty())
+            return;
+
+        QList<std::pair<int, int>> chunks;
+        const auto fileCount = static_cast<int>(m_files->size());
+        for (int start = 0; start < fileCount; start += ChunkSize)
+            chunks.push_back({start, std::min(start + ChunkSize, fileCount)});
+
+        auto scoreChunk = [files = m_files, pattern = m_pattern](const std::pair<int, int> &chunk) {
+            Matches matches;
+            for (int i = chunk.first; i < chunk.second; ++i) {
+                const auto &file = files->at(i);
+                // A match in the file name is always better than a match in the directories
+                int score = Utils::fuzzyMatchScore(pattern, file.fileName);
+                if (score >= 0)
+                    score += FileNameBonus;
+                else
+                    score = Utils::fuzzyMatchScore(pattern, file.relativePath);
+                if (score >= 0)
+                    matches.push_back({score, i});
+            }
+            keepBestMatches(matches, *files);
+            return matches;
+        };
+        m_watcher.setFuture(QtConcurrent::mapped(chunks, scoreChunk));
     }
 
 private:
     struct FileInfo
     {
         QString fileName;
+        QString relativePath;
         QString path;
     };
+    struct Match
+    {
+        int score;
+        int file;
+    };
+    using Matches = std::vector<Match>;
+
+    static constexpr int ChunkSize = 2048;
+    static constexpr int MaxMatches = 100;
+    static constexpr int FileNameBonus = 1000;
+
+    void cancelFilter()
+    {
+        // Setting a new future also discards the results of the previous one not reported yet
+        m_watcher.cancel();
+        m_watcher.setFuture(QFuture<Matches>());
+    }
 
-    // Returns the list of all files recursively, without the hidden files or directories (starting with '.')
-    QVector<FileInfo> allFilesInDirectory(const QString &path)
+    // Sorts the matches, best first, and removes the ones above MaxMatches
+    static void keepBestMatches(Matches &matches, const std::vector<FileInfo> &files)
     {
-        QVector<FileInfo> result;
-        QDir dir(path);
-        const auto fiList = dir.entryInfoList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
-        for (const auto &fi : fiList) {
-            if (fi.fileName().startsWith('.'))
-                continue;
-            if (fi.isFile())
-                result.push_back({fi.fileName(), fi.absoluteFilePath()});
-            else if (fi.isDir())
-                result.append(allFilesInDirectory(fi.absoluteFilePath()));
+        auto isBetter = [&files](const Match &m1, const Match &m2) {
+            if (m1.score != m2.score)
+                return m1.score > m2.score;
+            return files.at(m1.file).relativePath.size() < files.at(m2.file).relativePath.size();
+        };
+        if (matches.size() > static_cast<size_t>(MaxMatches)) {
+            std::ranges::partial_sort(matches, matches.begin() + MaxMatches, isBetter);
+            matches.resize(MaxMatches);
+        } else {
+            std::ranges::sort(matches, isBetter);
         }
-        return result;
     }
-    QVector<FileInfo> m_files;
+
+    void addMatches(Matches &&matches)
+    {
+        if (matches.empty())
+            return;
+        beginResetModel();
+        m_matches.insert(m_matches.end(), matches.begin(), matches.end());
+        keepBestMatches(m_matches, *m_files);
+        endResetModel();
+    }
+
+    std::shared_ptr<const std::vector<FileInfo>> m_files = std::make_shared<std::vector<FileInfo>>();
+    QString m_pattern;
+    Matches m_matches;
+    QFutureWatcher<Matches> m_watcher;
 };
 
 //=============================================================================
@@ -206,17 +302,66 @@ public:
         return {};
     }
 
+    // The symbols are built in a worker thread, the model stays empty until they are ready
     void resetSymbols()
     {
-        Core::LoggerDisabler ld;
         beginResetModel();
+        m_pattern.clear();
+        m_allSymbols.clear();
         m_symbols.clear();
-        if (auto codeDocument = qobject_cast<Core::CodeDocument *>(Core::Project::instance()->currentDocument()))
-            m_symbols = codeDocument->symbols();
         endResetModel();
+
+        auto codeDocument = qobject_cast<Core::CodeDocument *>(Core::Project::instance()->currentDocument());
+        m_document = codeDocument;
+        if (!codeDocument)
+            return;
+        codeDocument->updateSymbolsAsync([this, safeThis = QPointer(this), document = QPointer(codeDocument)]() {
+            // The palette may have been reset with another document in the meantime
+            if (!safeThis || !document || m_document != document)
+                return;
+            Core::LoggerDisabler ld;
+            m_allSymbols = document->symbols();
+            updateMatches();
+        });
+    }
+
+    // Same fuzzy matching as the files, the best matches first
+    void setFilter(const QString &filter)
+    {
+        auto pattern = filter;
+        pattern.remove(' ');
+        if (pattern == m_pattern)
+            return;
+        m_pattern = pattern;
+        updateMatches();
     }
 
 private:
+    void updateMatches()
+    {
+        beginResetModel();
+        if (m_pattern.isEmpty()) {
+            m_symbols = m_allSymbols;
+        } else {
+            std::vector<std::pair<int, Core::Symbol *>> matches;
+            for (auto *symbol : std::as_const(m_allSymbols)) {
+                const int score = Utils::fuzzyMatchScore(m_pattern, symbol->name());
+                if (score >= 0)
+                    matches.emplace_back(score, symbol);
+            }
+            // Stable, so symbols with the same score stay in the document order
+            std::ranges::stable_sort(matches, std::ranges::greater {}, &std::pair<int, Core::Symbol *>::first);
+            m_symbols.clear();
+            for (const auto &match : matches)
+                m_symbols.push_back(match.second);
+        }
+        endResetModel();
+    }
+
+    QPointer<Core::CodeDocument> m_document;
+    QString m_pattern;
+    // All the symbols of the document, and the ones matching the pattern
+    QVector<Core::Symbol *> m_allSymbols;
     QVector<Core::Symbol *> m_symbols;
 };
 
@@ -321,6 +466,8 @@ Palette::Palette(QMainWindow *parent)
 
     m_proxyModel->setFilterCaseSensitivity(Qt::CaseInsensitive);
     ui->treeView->setModel(m_proxyModel);
+    // Some models are filtered asynchronously
+    connect(m_proxyModel, &QAbstractItemModel::modelReset, this, &Palette::updateListHeight);
 
     ui->treeView->setStyleSheet("QTreeView::item { padding: 5px }");
     ui->treeView->setRootIsDecorated(false);
@@ -430,8 +577,14 @@ void Palette::changeText(const QString &text)
         setSourceModel(m_selectors.at(index).model.get());
     }
 
-    const auto search = text.mid(m_selectors.at(m_currentSelector).prefix.length()).simplified();
-    m_proxyModel->setFilterWildcard(search);
+    const auto &selector = m_selectors.at(m_currentSelector);
+    const auto search = text.mid(selector.prefix.length()).simplified();
+    if (selector.filterFunc) {
+        m_proxyModel->setFilterWildcard("");
+        selector.filterFunc(search);
+    } else {
+        m_proxyModel->setFilterWildcard(search);
+    }
     updateListHeight();
 }
 
@@ -483,7 +636,10 @@ void Palette::addFileSelector()
     auto selectFile = [](const QVariant &path) {
         Core::Project::instance()->open(path.toString());
     };
-    m_selectors.emplace_back("", std::move(fileModel), selectFile, resetFiles);
+    auto filterFiles = [model = fileModel.get()](const QString &filter) {
+        model->setFilter(filter);
+    };
+    m_selectors.emplace_back("", std::move(fileModel), selectFile, resetFiles, filterFiles);
 }
 
 void Palette::addLineSelector()
@@ -523,7 +679,10 @@ void Palette::addSymbolSelector()
             codeDocument->textEdit()->centerCursor();
         }
     };
-    m_selectors.emplace_back("@", std::move(symbolModel), gotoSymbol, resetSymbols);
+    auto filterSymbols = [model = symbolModel.get()](const QString &filter) {
+        model->setFilter(filter);
+    };
+    m_selectors.emplace_back("@", std::move(symbolModel), gotoSymbol, resetSymbols, filterSymbols);
 }
 
 void Palette::addActionSelector()
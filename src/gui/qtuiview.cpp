@@ -35,14 +35,19 @@ public:
     QtUiModelView(Core::QtUiDocument *document)
         : QAbstractTableModel(document)
         , m_document(document)
+        , m_rowCount(static_cast<int>(document->widgets().count()))
     {
         Q_ASSERT(document);
+        // Only update the rows affected by a change, instead of recreating the whole model
+        connect(document, &Core::QtUiDocument::widgetAdded, this, &QtUiModelView::addWidgetRows);
+        connect(document, &Core::QtUiDocument::widgetChanged, this, &QtUiModelView::updateWidgetRow);
+        connect(document, &Core::QtUiDocument::widgetPropertyChanged, this, &QtUiModelView::updateWidgetRow);
     }
 
     int rowCount(const QModelIndex &parent = QModelIndex()) const override
     {
         Q_UNUSED(parent)
-        return m_document->widgets().count();
+        return m_rowCount;
     }
     int columnCount(const QModelIndex &parent = QModelIndex()) const override
     {
@@ -96,7 +101,27 @@ public:
     }
 
 private:
+    void addWidgetRows()
+    {
+        // The widget is already in the document, m_rowCount is what the views know about
+        const auto count = static_cast<int>(m_document->widgets().count());
+        if (count <= m_rowCount)
+            return;
+        beginInsertRows({}, m_rowCount, count - 1);
+        m_rowCount = count;
+        endInsertRows();
+    }
+
+    void updateWidgetRow(Core::QtUiWidget *widget)
+    {
+        const auto row = static_cast<int>(m_document->widgets().indexOf(widget));
+        if (row == -1 || row >= m_rowCount)
+            return;
+        emit dataChanged(index(row, QtUiColumn::Name), index(row, QtUiColumn::ClassName));
+    }
+
     Core::QtUiDocument *m_document = nullptr;
+    int m_rowCount = 0;
 };
 
 QtUiView::QtUiView(QWidget *parent)
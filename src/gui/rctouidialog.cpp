@@ -82,17 +82,18 @@ void RcToUiDialog::accept()
         return;
     }
 
+    QStringList ids;
     const int numberOfDialogs = ui->idList->count();
     for (int i = 0; i < numberOfDialogs; ++i) {
         QListWidgetItem *item = ui->idList->item(i);
-        if (item->checkState() == Qt::Checked) {
-            const auto &dialog = m_document->dialog(item->text(), flags, scaleX, scaleY);
-            const QString fileName = path + '/' + dialog.id + ".ui";
-            if (!m_document->writeDialogToUi(dialog, fileName)) {
-                QMessageBox::warning(nullptr, tr("Error"), tr("Unable to write ui file %1.").arg(fileName));
-                return;
-            }
-        }
+        if (item->checkState() == Qt::Checked)
+            ids.push_back(item->text());
+    }
+
+    const auto failures = m_document->writeDialogsToUi(ids, path, flags, scaleX, scaleY);
+    if (!failures.isEmpty()) {
+        QMessageBox::warning(nullptr, tr("Error"), tr("Unable to write ui file %1.").arg(failures.join(", ")));
+        return;
     }
     QDialog::accept();
 }
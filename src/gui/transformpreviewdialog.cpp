@@ -16,18 +16,18 @@
 
 namespace Gui {
 
-TransformPreviewDialog::TransformPreviewDialog(Core::CodeDocument *document, const QString &resultText,
-                                               int numberReplacements, QWidget *parent /* = nullptr */)
+TransformPreviewDialog::TransformPreviewDialog(QWidget *parent /* = nullptr */)
     : QDialog(parent)
     , ui(new Ui::TransformPreviewDialog)
 {
     ui->setupUi(this);
 
-    ui->replacementsLabel->setText(tr("%1 Replacements made").arg(numberReplacements));
-    ui->transformedText->setPlainText(resultText);
-    GuiSettings::setupDocumentTextEdit(ui->transformedText, document);
+    ui->transformedText->setReadOnly(true);
+    GuiSettings::setupFileNameTextEdit(ui->transformedText, "transformation.diff");
+    setProgress(0);
 
     if (auto applyButton = ui->buttonBox->button(QDialogButtonBox::Apply)) {
+        applyButton->setEnabled(false);
         connect(applyButton, &QPushButton::clicked, this, &QDialog::accept);
     }
 }
@@ -37,4 +37,23 @@ TransformPreviewDialog::~TransformPreviewDialog()
     delete ui;
 }
 
+void TransformPreviewDialog::setProgress(int replacements)
+{
+    ui->replacementsLabel->setText(tr("Transforming... %1 Replacements made").arg(replacements));
+}
+
+void TransformPreviewDialog::setResult(const QString &diff, int replacements)
+{
+    ui->replacementsLabel->setText(tr("%1 Replacements made").arg(replacements));
+    ui->transformedText->setPlainText(diff);
+    if (auto applyButton = ui->buttonBox->button(QDialogButtonBox::Apply))
+        applyButton->setEnabled(replacements > 0);
+}
+
+void TransformPreviewDialog::setError(const QString &error)
+{
+    ui->replacementsLabel->setText(tr("<span style='color:red'>Error performing Transformation: %1</span>")
+                                       .arg(error.toHtmlEscaped()));
+}
+
 } // namespace Gui
@@ -10,8 +10,6 @@
 
 #pragma once
 
-#include "core/codedocument.h"
-
 #include <QDialog>
 
 namespace Gui {
@@ -25,10 +23,15 @@ class TransformPreviewDialog : public QDialog
     Q_OBJECT
 
 public:
-    explicit TransformPreviewDialog(Core::CodeDocument *document, const QString &resultText, int numberReplacements,
-                                    QWidget *parent = nullptr);
+    explicit TransformPreviewDialog(QWidget *parent = nullptr);
     ~TransformPreviewDialog() override;
 
+    // Shows the number of replacements made so far, while the transformation is running
+    void setProgress(int replacements);
+    // Shows the difference between the document and the transformed text, the transformation can then be applied
+    void setResult(const QString &diff, int replacements);
+    void setError(const QString &error);
+
 private:
     Ui::TransformPreviewDialog *ui;
 };
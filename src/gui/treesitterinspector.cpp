@@ -14,17 +14,78 @@
 #include "core/project.h"
 #include "transformpreviewdialog.h"
 #include "treesitter/languages.h"
+#include "treesitter/parserpool.h"
 #include "treesitter/predicates.h"
 #include "treesitter/transformation.h"
 #include "ui_treesitterinspector.h"
 #include "utils/log.h"
+#include "utils/string_helper.h"
 
 #include <QMessageBox>
 #include <QPalette>
+#include <QPromise>
 #include <QTextEdit>
+#include <QtConcurrent/QtConcurrentRun>
+#include <chrono>
+#include <memory>
 
 namespace Gui {
 
+namespace {
+
+// Delay after the last change of the document before parsing it again
+constexpr auto ParseDelay = std::chrono::milliseconds(300);
+
+struct PreviewResult
+{
+    QString text;
+    // Difference between the document and the transformed text
+    QString diff;
+    int replacements = 0;
+    QString error;
+};
+
+// Returns the point at the end of `text`, if `text` starts at `start`.
+// Columns are counted in bytes, as required by Tree-sitter.
+TSPoint pointAfter(const TSPoint &start, QStringView text)
+{
+    const auto newLines = text.count(u'\n');
+    if (newLines == 0) {
+        return {start.row, start.column + static_cast<uint32_t>(text.size() * sizeof(QChar))};
+    }
+    const auto lastLineLength = text.size() - text.lastIndexOf(u'\n') - 1;
+    return {start.row + static_cast<uint32_t>(newLines), static_cast<uint32_t>(lastLineLength * sizeof(QChar))};
+}
+
+// Returns the edit changing `oldText` into `newText`: the range between their common prefix and suffix.
+TSInputEdit textEdit(const QString &oldText, const QString &newText)
+{
+    const auto commonLength = std::min(oldText.size(), newText.size());
+    qsizetype start = 0;
+    while (start < commonLength && oldText.at(start) == newText.at(start)) {
+        ++start;
+    }
+    qsizetype suffix = 0;
+    while (suffix < commonLength - start
+           && oldText.at(oldText.size() - suffix - 1) == newText.at(newText.size() - suffix - 1)) {
+        ++suffix;
+    }
+
+    const auto startPoint = pointAfter({0, 0}, QStringView(oldText).first(start));
+    const auto oldEnd = oldText.size() - suffix;
+    const auto newEnd = newText.size() - suffix;
+    return {
+        .start_byte = static_cast<uint32_t>(start * sizeof(QChar)),
+        .old_end_byte = static_cast<uint32_t>(oldEnd * sizeof(QChar)),
+        .new_end_byte = static_cast<uint32_t>(newEnd * sizeof(QChar)),
+        .start_point = startPoint,
+        .old_end_point = pointAfter(startPoint, QStringView(oldText).sliced(start, oldEnd - start)),
+        .new_end_point = pointAfter(startPoint, QStringView(newText).sliced(start, newEnd - start)),
+    };
+}
+
+} // namespace
+
 QueryErrorHighlighter::QueryErrorHighlighter(QTextDocument *parent)
     : QSyntaxHighlighter(parent)
 {
@@ -92,6 +153,11 @@ TreeSitterInspector::TreeSitterInspector(QWidget *parent)
 
     ui->treeInspector->setModel(&m_treemodel);
 
+    m_parseTimer.setSingleShot(true);
+    m_parseTimer.setInterval(ParseDelay);
+    connect(&m_parseTimer, &QTimer::timeout, this, &TreeSitterInspector::startParse);
+    connect(&m_parseWatcher, &QFutureWatcher<ParseResult>::finished, this, &TreeSitterInspector::finishParse);
+
     connect(ui->treeInspector->selectionModel(), &QItemSelectionModel::currentChanged, this,
             &TreeSitterInspector::changeTreeSelection);
 
@@ -107,6 +173,9 @@ TreeSitterInspector::TreeSitterInspector(QWidget *parent)
 
 TreeSitterInspector::~TreeSitterInspector()
 {
+    // The parse uses m_cancelParse, it must be done before the inspector is destroyed
+    m_cancelParse = 1;
+    m_parseWatcher.waitForFinished();
     delete ui;
 }
 
@@ -118,14 +187,43 @@ void TreeSitterInspector::changeQueryState()
 
         const QColor col = palette().color(QPalette::ColorGroup::Normal, QPalette::Highlight);
 
-        ui->queryInfo->setText(tr("<span style='color:%1'>%2 Patterns - %3 Matches - %4 Captures</span>")
-                                   .arg(patternCount == 0 || matchCount == 0 ? col.name() : "green")
-                                   .arg(patternCount)
-                                   .arg(matchCount)
-                                   .arg(m_treemodel.captureCount()));
+        auto text = tr("<span style='color:%1'>%2 Patterns - %3 Matches - %4 Captures</span>")
+                        .arg(patternCount == 0 || matchCount == 0 ? col.name() : "green")
+                        .arg(patternCount)
+                        .arg(matchCount)
+                        .arg(m_treemodel.captureCount());
+        const auto warnings = m_treemodel.queryWarnings();
+        if (!warnings.isEmpty())
+            text += tr(" - <span style='color:orange'>%1 Warnings</span>").arg(warnings.size());
+        ui->queryInfo->setText(text);
+        ui->queryInfo->setToolTip(queryProfileToolTip(warnings));
     }
 }
 
+// Matches and time spent per pattern, to find the slow ones
+QString TreeSitterInspector::queryProfileToolTip(const QStringList &warnings) const
+{
+    const auto profile = m_treemodel.queryProfile();
+    if (!profile)
+        return {};
+
+    QString result = tr("<table><tr><th>Pattern</th><th>Matches</th><th>Rejected</th><th>Time (ms)</th></tr>");
+    for (int i = 0; i < profile->patterns.size(); ++i) {
+        const auto &pattern = profile->patterns.at(i);
+        result += QString("<tr><td>%1</td><td>%2</td><td>%3</td><td>%4</td></tr>")
+                      .arg(i)
+                      .arg(pattern.matches)
+                      .arg(pattern.rejectedMatches)
+                      .arg(std::chrono::duration<double, std::milli>(pattern.duration).count(), 0, 'f', 2);
+    }
+    result += "</table>";
+    if (profile->exceededMatchLimit > 0)
+        result += tr("<p>The match limit was exceeded, some matches may be missing.</p>");
+    for (const auto &warning : warnings)
+        result += QString("<p style='color:orange'>%1</p>").arg(warning.toHtmlEscaped());
+    return result;
+}
+
 void TreeSitterInspector::changeCurrentDocument(Core::Document *document)
 {
     setDocument(qobject_cast<Core::CodeDocument *>(document));
@@ -142,21 +240,23 @@ void TreeSitterInspector::changeQuery()
     m_queryText = text;
 
     if (text.isEmpty()) {
-        m_treemodel.setQuery({}, makePredicates());
+        m_treemodel.setQuery({});
         ui->queryInfo->setText("");
+        ui->queryInfo->setToolTip("");
         m_errorHighlighter->setUtf8Position(-1);
         return;
     }
 
     try {
-        auto query = std::make_shared<treesitter::Query>(tree_sitter_cpp(), ui->query->toPlainText());
-        m_treemodel.setQuery(query, makePredicates());
+        auto query = std::make_shared<treesitter::Query>(m_parser.language(), ui->query->toPlainText());
+        m_treemodel.setQuery(query);
         m_errorHighlighter->setUtf8Position(-1);
 
         changeQueryState();
     } catch (treesitter::Query::Error &error) {
-        m_treemodel.setQuery({}, nullptr);
+        m_treemodel.setQuery({});
         ui->queryInfo->setText(highlightQueryError(error));
+        ui->queryInfo->setToolTip("");
 
         // The error may be behind the last character, which couldn't be highlighted
         // So move back by one character in that case.
@@ -169,29 +269,80 @@ void TreeSitterInspector::changeQuery()
 
 void TreeSitterInspector::showUnnamedChanged()
 {
-    // technically the text didn't change, but this will force
-    // a complete re-parse and re-build of the entire tree.
-    changeText();
+    // The text didn't change, no need to parse again, but the tree is rebuilt entirely.
+    if (m_tree.has_value()) {
+        showTree(m_tree->copy());
+    }
 }
 
 void TreeSitterInspector::changeText()
 {
+    // Only parse once the user stops typing
+    m_parseTimer.start();
+}
+
+void TreeSitterInspector::startParse()
+{
+    if (m_parseWatcher.isRunning()) {
+        // The result would be outdated, parse again once the current parse is stopped
+        m_cancelParse = 1;
+        m_parsePending = true;
+        return;
+    }
+    m_parsePending = false;
+    if (!m_document) {
+        return;
+    }
+
     QString text;
     {
         Core::LoggerDisabler disableLogging;
         text = m_document->text();
     }
-    auto tree = m_parser.parseString(text);
-    if (tree.has_value()) {
-        m_treemodel.setTree(std::move(tree.value()), makePredicates(), ui->enableUnnamed->isChecked());
-        ui->treeInspector->expandAll();
-        for (int i = 0; i < 2; i++) {
-            ui->treeInspector->resizeColumnToContents(i);
+    // The previous tree is reused, so only the changed parts of the text are parsed again
+    auto oldTree = m_tree.has_value() ? std::make_shared<treesitter::Tree>(m_tree->copy()) : nullptr;
+    m_cancelParse = 0;
+    m_parseWatcher.setFuture(QtConcurrent::run([this, language = m_document->treeSitterLanguage(),
+                                                oldText = m_text, text = std::move(text), oldTree]() {
+        auto parser = treesitter::ParserPool::instance().acquire(language);
+        parser->setTimeout(std::chrono::microseconds(0));
+        parser->setCancellationFlag(&m_cancelParse);
+        if (oldTree) {
+            oldTree->edit(textEdit(oldText, text));
         }
-        changeQueryState();
-    } else {
+        auto tree = parser->parseString(text, oldTree.get());
+        parser->setCancellationFlag(nullptr);
+        return ParseResult {text, std::move(tree)};
+    }));
+}
+
+void TreeSitterInspector::finishParse()
+{
+    auto result = m_parseWatcher.future().takeResult();
+    if (m_parsePending) {
+        startParse();
+        return;
+    }
+
+    if (!result.tree.has_value()) {
+        m_text.clear();
+        m_tree.reset();
         m_treemodel.clear();
+        return;
+    }
+    m_text = std::move(result.text);
+    m_tree = result.tree->copy();
+    showTree(std::move(result.tree.value()));
+}
+
+void TreeSitterInspector::showTree(treesitter::Tree &&tree)
+{
+    m_treemodel.updateTree(std::move(tree), m_text, ui->enableUnnamed->isChecked());
+    changeCursor();
+    for (int i = 0; i < 2; i++) {
+        ui->treeInspector->resizeColumnToContents(i);
     }
+    changeQueryState();
 }
 
 void TreeSitterInspector::changeCursor()
@@ -202,6 +353,15 @@ void TreeSitterInspector::changeCursor()
         position = m_document->position();
     }
     m_treemodel.setCursorPosition(position);
+
+    // Only the nodes around the cursor are expanded, expanding everything would create a row for each node
+    const auto index = m_treemodel.indexAt(position);
+    if (index.isValid()) {
+        for (auto parent = index.parent(); parent.isValid(); parent = parent.parent()) {
+            ui->treeInspector->expand(parent);
+        }
+        ui->treeInspector->scrollTo(index);
+    }
 }
 
 void TreeSitterInspector::setDocument(Core::CodeDocument *document)
@@ -212,14 +372,25 @@ void TreeSitterInspector::setDocument(Core::CodeDocument *document)
 
     m_document = document;
     if (m_document) {
+        if (m_parser.language() != m_document->treeSitterLanguage()) {
+            m_parser = treesitter::Parser(m_document->treeSitterLanguage());
+            // The current query may not be valid for the new language
+            m_queryText.clear();
+            changeQuery();
+        }
         connect(m_document, &Core::CodeDocument::textChanged, this, &TreeSitterInspector::changeText);
         connect(m_document, &Core::CodeDocument::positionChanged, this, &TreeSitterInspector::changeCursor);
+    }
 
+    // The tree of the previous document can't be reused
+    m_parseTimer.stop();
+    m_text.clear();
+    m_tree.reset();
+    m_treemodel.clear();
+    if (m_document) {
         changeCursor();
-        changeText();
-    } else {
-        m_treemodel.clear();
     }
+    startParse();
 }
 
 QString TreeSitterInspector::preCheckTransformation() const
@@ -241,14 +412,47 @@ QString TreeSitterInspector::preCheckTransformation() const
 
 void TreeSitterInspector::previewTransformation()
 {
-    prepareTransformation([this](auto &transformation) {
-        auto result = transformation.run();
+    auto transformation = createTransformation();
+    if (!transformation)
+        return;
 
-        TransformPreviewDialog dialog(m_document, result, transformation.replacementsMade(), this);
-        if (dialog.exec() == QDialog::Accepted) {
-            m_document->setText(result);
-        }
+    // The transformation runs in a worker thread, the dialog shows the progress until the difference is computed
+    TransformPreviewDialog dialog(this);
+    QFutureWatcher<PreviewResult> watcher;
+    connect(&watcher, &QFutureWatcherBase::progressValueChanged, &dialog, &TransformPreviewDialog::setProgress);
+    connect(&watcher, &QFutureWatcherBase::finished, &dialog, [&dialog, &watcher]() {
+        if (watcher.isCanceled() || watcher.future().resultCount() == 0)
+            return;
+        const auto &result = watcher.future().result();
+        if (result.error.isEmpty())
+            dialog.setResult(result.diff, result.replacements);
+        else
+            dialog.setError(result.error);
     });
+
+    watcher.setFuture(QtConcurrent::run([transformation](QPromise<PreviewResult> &promise) {
+        PreviewResult result;
+        try {
+            result.text = transformation->run([&promise](const QString &, int replacements) {
+                promise.setProgressValue(replacements);
+                return !promise.isCanceled();
+            });
+            if (promise.isCanceled())
+                return;
+            result.replacements = transformation->replacementsMade();
+            result.diff = Utils::unifiedDiff(transformation->source(), result.text);
+        } catch (treesitter::Transformation::Error &error) {
+            result.error = error.description;
+        }
+        promise.addResult(std::move(result));
+    }));
+
+    if (dialog.exec() == QDialog::Accepted) {
+        m_document->setText(watcher.future().result().text);
+    } else {
+        // The transformation stops after the current replacement, its result is not needed
+        watcher.cancel();
+    }
 }
 
 QString TreeSitterInspector::highlightQueryError(const treesitter::Query::Error &error) const
@@ -260,16 +464,21 @@ QString TreeSitterInspector::highlightQueryError(const treesitter::Query::Error
 
 void TreeSitterInspector::runTransformation()
 {
-    prepareTransformation([this](auto &transformation) {
-        m_document->setText(transformation.run());
+    auto transformation = createTransformation();
+    if (!transformation)
+        return;
+
+    try {
+        m_document->setText(transformation->run());
 
         QMessageBox msgBox;
-        msgBox.setText(tr("%1 Replacements made").arg(transformation.replacementsMade()));
-    });
+        msgBox.setText(tr("%1 Replacements made").arg(transformation->replacementsMade()));
+    } catch (treesitter::Transformation::Error &error) {
+        showTransformationError(error.description);
+    }
 }
 
-void TreeSitterInspector::prepareTransformation(
-    const std::function<void(treesitter::Transformation &transformation)> &runFunction)
+std::shared_ptr<treesitter::Transformation> TreeSitterInspector::createTransformation()
 {
     const auto errorMessage = preCheckTransformation();
     if (!errorMessage.isEmpty()) {
@@ -277,41 +486,32 @@ void TreeSitterInspector::prepareTransformation(
         msgBox.setText(errorMessage);
         msgBox.setIcon(QMessageBox::Critical);
         msgBox.exec();
-        return;
+        return {};
     }
 
     try {
-        auto query = std::make_shared<treesitter::Query>(tree_sitter_cpp(), m_queryText);
-        treesitter::Parser parser(tree_sitter_cpp());
+        auto query = std::make_shared<treesitter::Query>(m_parser.language(), m_queryText);
+        treesitter::Parser parser(m_parser.language());
 
-        treesitter::Transformation transformation(m_document->text(), std::move(parser), query,
-                                                  ui->target->toPlainText());
-
-        runFunction(transformation);
+        return std::make_shared<treesitter::Transformation>(m_document->text(), std::move(parser), query,
+                                                            ui->target->toPlainText());
     } catch (treesitter::Query::Error &error) {
         QMessageBox msgBox;
         msgBox.setText(tr("Error in Query"));
         msgBox.setInformativeText(highlightQueryError(error));
         msgBox.setIcon(QMessageBox::Critical);
         msgBox.exec();
-    } catch (treesitter::Transformation::Error &error) {
-        QMessageBox msgBox;
-        msgBox.setText(tr("Error performing Transformation"));
-        msgBox.setInformativeText(error.description);
-        msgBox.setIcon(QMessageBox::Critical);
-        msgBox.exec();
     }
+    return {};
 }
 
-std::unique_ptr<treesitter::Predicates> TreeSitterInspector::makePredicates()
+void TreeSitterInspector::showTransformationError(const QString &description)
 {
-    if (m_document) {
-        // No need to always log the call to TextDocument::text
-        Core::LoggerDisabler disabler;
-        return std::make_unique<treesitter::Predicates>(m_document->text());
-    } else {
-        return nullptr;
-    }
+    QMessageBox msgBox;
+    msgBox.setText(tr("Error performing Transformation"));
+    msgBox.setInformativeText(description);
+    msgBox.setIcon(QMessageBox::Critical);
+    msgBox.exec();
 }
 
 void TreeSitterInspector::changeTreeSelection(const QModelIndex &current, const QModelIndex &previous)
@@ -14,11 +14,15 @@
 #include "treesittertreemodel.h"
 
 #include <QDialog>
+#include <QFutureWatcher>
 #include <QSyntaxHighlighter>
+#include <QTimer>
+#include <atomic>
+#include <memory>
+#include <optional>
 
 namespace treesitter {
 class Transformation;
-class Predicates;
 }
 
 namespace Core {
@@ -58,14 +62,18 @@ private:
     void changeCurrentDocument(Core::Document *document);
     void setDocument(Core::CodeDocument *document);
     void changeText();
+    void startParse();
+    void finishParse();
+    void showTree(treesitter::Tree &&tree);
     void changeCursor();
     void changeQuery();
     void changeQueryState();
+    QString queryProfileToolTip(const QStringList &warnings) const;
     void previewTransformation();
     void runTransformation();
-    void prepareTransformation(const std::function<void(treesitter::Transformation &transformation)> &runFunction);
-
-    std::unique_ptr<treesitter::Predicates> makePredicates();
+    // Returns nothing if the transformation can't be created, after showing the error
+    std::shared_ptr<treesitter::Transformation> createTransformation();
+    void showTransformationError(const QString &description);
 
     QString preCheckTransformation() const;
 
@@ -82,6 +90,21 @@ private:
     Core::CodeDocument *m_document;
 
     QString m_queryText;
+
+    struct ParseResult
+    {
+        QString text;
+        std::optional<treesitter::Tree> tree;
+    };
+    // The document is parsed in a worker thread, once the text hasn't changed for a while
+    QTimer m_parseTimer;
+    QFutureWatcher<ParseResult> m_parseWatcher;
+    std::atomic<size_t> m_cancelParse = 0;
+    // Set if the text changed while parsing, the result is then outdated
+    bool m_parsePending = false;
+    // Text and tree currently displayed, used for the next incremental parse
+    QString m_text;
+    std::optional<treesitter::Tree> m_tree;
 };
 
 } // namespace Gui
@@ -9,10 +9,14 @@
 */
 
 #include "treesittertreemodel.h"
+#include "treesitter/predicates.h"
+#include "treesitter/treecursor.h"
 #include "utils/log.h"
 
 #include <QBrush>
 #include <QColor>
+#include <algorithm>
+#include <utility>
 
 namespace Gui {
 
@@ -32,10 +36,10 @@ const std::vector<std::unique_ptr<TreeSitterTreeModel::TreeNode>> &TreeSitterTre
 
 std::vector<std::unique_ptr<TreeSitterTreeModel::TreeNode>> &TreeSitterTreeModel::TreeNode::children()
 {
-
-    if (m_children.empty() && childCount() > 0) {
-        auto children = m_enableUnnamed ? m_node.children() : m_node.namedChildren();
-        for (const auto &child : children) {
+    if (!m_childrenCreated) {
+        m_childrenCreated = true;
+        m_children.reserve(childCount());
+        for (const auto &child : m_enableUnnamed ? m_node.childRange() : m_node.namedChildRange()) {
             m_children.emplace_back(new TreeNode(child, this, m_enableUnnamed));
         }
     }
@@ -45,7 +49,26 @@ std::vector<std::unique_ptr<TreeSitterTreeModel::TreeNode>> &TreeSitterTreeModel
 
 int TreeSitterTreeModel::TreeNode::childCount() const
 {
-    return static_cast<int>(m_enableUnnamed ? m_node.childCount() : m_node.namedChildCount());
+    // Once created, the children may differ from the node ones while the tree is updated, see updateNode
+    if (m_childrenCreated) {
+        return static_cast<int>(m_children.size());
+    }
+    return nodeChildCount(m_node);
+}
+
+int TreeSitterTreeModel::TreeNode::nodeChildCount(const treesitter::Node &node) const
+{
+    return static_cast<int>(m_enableUnnamed ? node.childCount() : node.namedChildCount());
+}
+
+std::vector<treesitter::Node> TreeSitterTreeModel::TreeNode::nodeChildren(const treesitter::Node &node) const
+{
+    std::vector<treesitter::Node> result;
+    result.reserve(nodeChildCount(node));
+    for (const auto &child : m_enableUnnamed ? node.childRange() : node.namedChildRange()) {
+        result.push_back(child);
+    }
+    return result;
 }
 
 const TreeSitterTreeModel::TreeNode *TreeSitterTreeModel::TreeNode::child(int row) const
@@ -111,6 +134,11 @@ bool TreeSitterTreeModel::TreeNode::includesPosition(int position) const
     return static_cast<int>(m_node.startPosition()) <= position && position <= static_cast<int>(m_node.endPosition());
 }
 
+bool TreeSitterTreeModel::TreeNode::childrenCreated() const
+{
+    return m_childrenCreated;
+}
+
 treesitter::Node TreeSitterTreeModel::TreeNode::tsNode() const
 {
     return m_node;
@@ -122,7 +150,7 @@ void TreeSitterTreeModel::TreeNode::traverse(const std::function<void(TreeNode *
     if (filter(this)) {
         fun(this);
 
-        for (const auto &child : children()) {
+        for (const auto &child : m_children) {
             child->traverse(fun, filter);
         }
     }
@@ -227,13 +255,8 @@ QVariant TreeSitterTreeModel::data(const QModelIndex &index, int role) const
     case Qt::DisplayRole:
         if (index.column() < 2) {
             return node->data(index.column());
-        } else {
-            if (m_query.has_value()) {
-                const auto it = m_query->captures.find(node->tsNode());
-                if (it != m_query->captures.cend()) {
-                    return it->second;
-                }
-            }
+        } else if (m_query.has_value()) {
+            return captures(*node);
         }
         break;
     case Qt::ForegroundRole:
@@ -254,76 +277,204 @@ Qt::ItemFlags TreeSitterTreeModel::flags(const QModelIndex &index) const
     return QAbstractItemModel::flags(index);
 }
 
-void TreeSitterTreeModel::setTree(treesitter::Tree &&tree, std::unique_ptr<treesitter::Predicates> &&predicates,
-                                  bool enableUnnamed)
+void TreeSitterTreeModel::setTree(treesitter::Tree &&tree, const QString &text, bool enableUnnamed)
 {
     beginResetModel();
     m_tree = std::move(tree);
+    m_text = text;
     m_rootNode = std::make_unique<TreeNode>(m_tree->rootNode(), nullptr, enableUnnamed);
-    executeQuery(std::move(predicates));
+    executeQuery();
     endResetModel();
 }
 
+// Updates the model with a new version of the same document, typically after an incremental parse.
+// Unlike setTree, the model is not reset: only the rows of the changed nodes are removed or inserted, so the
+// expanded and selected items of the views are kept.
+void TreeSitterTreeModel::updateTree(treesitter::Tree &&tree, const QString &text, bool enableUnnamed)
+{
+    if (!m_rootNode || m_rootNode->m_enableUnnamed != enableUnnamed) {
+        setTree(std::move(tree), text, enableUnnamed);
+        return;
+    }
+
+    // The old tree must outlive the update, as the existing nodes are compared with the new ones
+    std::optional<treesitter::Tree> oldTree = std::exchange(m_tree, std::move(tree));
+    m_text = text;
+    executeQuery();
+
+    const auto rootIndex = createIndex(0, 0, m_rootNode.get());
+    updateNode(*m_rootNode, m_tree->rootNode(), rootIndex);
+    emit dataChanged(rootIndex, rootIndex.siblingAtColumn(columnCount() - 1));
+}
+
+// Replaces the tree-sitter node of `node` with `newNode`, and updates its children recursively.
+// The children with the same type at the start and the end are kept, the ones in the middle are replaced.
+void TreeSitterTreeModel::updateNode(TreeNode &node, const treesitter::Node &newNode, const QModelIndex &index)
+{
+    const int oldCount = node.childCount();
+    node.m_captures.reset();
+
+    if (!node.m_childrenCreated) {
+        // The children were never requested, the views only know their count
+        const int newCount = node.nodeChildCount(newNode);
+        if (newCount < oldCount) {
+            beginRemoveRows(index, newCount, oldCount - 1);
+            node.m_node = newNode;
+            endRemoveRows();
+        } else if (newCount > oldCount) {
+            beginInsertRows(index, oldCount, newCount - 1);
+            node.m_node = newNode;
+            endInsertRows();
+        } else {
+            node.m_node = newNode;
+        }
+        return;
+    }
+
+    node.m_node = newNode;
+    const auto newChildren = node.nodeChildren(newNode);
+    const int newCount = static_cast<int>(newChildren.size());
+    auto &children = node.m_children;
+
+    const int commonCount = std::min(oldCount, newCount);
+    int prefix = 0;
+    while (prefix < commonCount && children[prefix]->m_node.type() == newChildren[prefix].type()) {
+        ++prefix;
+    }
+    int suffix = 0;
+    while (suffix < commonCount - prefix
+           && children[oldCount - suffix - 1]->m_node.type() == newChildren[newCount - suffix - 1].type()) {
+        ++suffix;
+    }
+
+    if (const int removed = oldCount - prefix - suffix; removed > 0) {
+        beginRemoveRows(index, prefix, prefix + removed - 1);
+        children.erase(children.begin() + prefix, children.begin() + prefix + removed);
+        endRemoveRows();
+    }
+    if (const int inserted = newCount - prefix - suffix; inserted > 0) {
+        beginInsertRows(index, prefix, prefix + inserted - 1);
+        std::vector<std::unique_ptr<TreeNode>> newNodes;
+        newNodes.reserve(inserted);
+        for (int row = prefix; row < prefix + inserted; ++row) {
+            newNodes.emplace_back(new TreeNode(newChildren[row], &node, node.m_enableUnnamed));
+        }
+        children.insert(children.begin() + prefix, std::make_move_iterator(newNodes.begin()),
+                        std::make_move_iterator(newNodes.end()));
+        endInsertRows();
+    }
+
+    // The kept children are now at the same rows as their new nodes
+    for (int row = 0; row < newCount; ++row) {
+        if (row < prefix || row >= newCount - suffix) {
+            updateNode(*children[row], newChildren[row], createIndex(row, 0, children[row].get()));
+        }
+    }
+    if (newCount > 0) {
+        emit dataChanged(createIndex(0, 0, children.front().get()),
+                         createIndex(newCount - 1, columnCount() - 1, children.back().get()));
+    }
+}
+
 void TreeSitterTreeModel::clear()
 {
     beginResetModel();
     m_tree = {};
+    m_text.clear();
     m_rootNode.reset();
     m_cursorPosition = -1;
     endResetModel();
 }
 
-void TreeSitterTreeModel::executeQuery(std::unique_ptr<treesitter::Predicates> &&predicates)
+QModelIndex TreeSitterTreeModel::indexAt(int position) const
 {
-    treesitter::QueryCursor cursor;
+    if (!m_rootNode || !m_rootNode->includesPosition(position)) {
+        return {};
+    }
+
+    auto index = createIndex(0, 0, m_rootNode.get());
+    const TreeNode *node = m_rootNode.get();
+    while (true) {
+        const auto &children = node->children();
+        const auto it = std::ranges::find_if(children, [position](const auto &child) {
+            return child->includesPosition(position);
+        });
+        if (it == children.cend()) {
+            return index;
+        }
+        node = it->get();
+        index = createIndex(static_cast<int>(std::distance(children.cbegin(), it)), 0, node);
+    }
+}
 
+void TreeSitterTreeModel::executeQuery()
+{
     if (m_rootNode && m_query.has_value()) {
-        m_query->captures = decltype(m_query->captures)();
         m_query->numCaptures = 0;
         m_query->numMatches = 0;
 
-        cursor.execute(m_query->query, m_rootNode->tsNode(), std::move(predicates));
-
+        // Only count the matches here, the captures of a node are computed when it's displayed, see captures()
+        treesitter::QueryCursor cursor;
+        cursor.enableProfiling();
+        cursor.execute(m_query->query, m_tree->rootNode(), std::make_unique<treesitter::Predicates>(m_text));
         while (const auto match = cursor.nextMatch()) {
             m_query->numMatches++;
+            m_query->numCaptures += match->captures().size();
+        }
+        m_query->profile = cursor.profile();
+    }
+}
 
-            const auto captures = match->captures();
-            for (const auto &capture : captures) {
-                m_query->numCaptures++;
-                m_query->captures[capture.node] += " @" + m_query->query->captureAt(capture.id).name;
+QString TreeSitterTreeModel::captures(const TreeNode &node) const
+{
+    if (!node.m_captures.has_value()) {
+        QString result;
+        const auto tsNode = node.tsNode();
+
+        // All the matches capturing the node intersect it, no need to run the query on the whole tree.
+        // The query is still executed on the root node, as the predicates may depend on it.
+        treesitter::QueryCursor cursor;
+        cursor.setByteRange(tsNode.startPosition() * sizeof(QChar), tsNode.endPosition() * sizeof(QChar));
+        cursor.execute(m_query->query, m_tree->rootNode(), std::make_unique<treesitter::Predicates>(m_text));
+        while (const auto match = cursor.nextMatch()) {
+            for (const auto &capture : match->captures()) {
+                if (capture.node == tsNode) {
+                    result += " @" + m_query->query->captureAt(capture.id).name;
+                }
             }
         }
+        node.m_captures = result;
     }
+    return node.m_captures.value();
 }
 
-void TreeSitterTreeModel::capturesChanged(const std::unordered_map<treesitter::Node, QString> &oldCaptures)
+void TreeSitterTreeModel::capturesChanged()
 {
     if (m_rootNode) {
-        m_rootNode->traverse([&oldCaptures, this](const auto *node) {
-            const bool isOldCapture = oldCaptures.contains(node->tsNode());
-            const bool isNewCapture = m_query.has_value() && m_query->captures.contains(node->tsNode());
-            if (isOldCapture || isNewCapture) {
-                emit dataChanged(indexFor(*node, 2), indexFor(*node, 2));
+        const auto rootIndex = createIndex(0, 2, m_rootNode.get());
+        emit dataChanged(rootIndex, rootIndex);
+        // One signal per list of children, the rows of the nodes are known
+        m_rootNode->traverse([this](auto *node) {
+            node->m_captures.reset();
+            const auto &children = node->m_children;
+            if (!children.empty()) {
+                emit dataChanged(createIndex(0, 2, children.front().get()),
+                                 createIndex(static_cast<int>(children.size()) - 1, 2, children.back().get()));
             }
         });
     }
 }
 
-void TreeSitterTreeModel::setQuery(const std::shared_ptr<treesitter::Query> &query,
-                                   std::unique_ptr<treesitter::Predicates> &&predicates)
+void TreeSitterTreeModel::setQuery(const std::shared_ptr<treesitter::Query> &query)
 {
-    std::unordered_map<treesitter::Node, QString> oldCaptures =
-        m_query.has_value() ? std::move(m_query->captures) : decltype(m_query->captures)();
-
     if (query != nullptr) {
-        m_query =
-            QueryData {.query = query, .captures = decltype(m_query->captures)(), .numMatches = 0, .numCaptures = 0};
+        m_query = QueryData {.query = query, .numMatches = 0, .numCaptures = 0, .profile = {}};
     } else {
         m_query = {};
     }
 
-    executeQuery(std::move(predicates));
-    capturesChanged(oldCaptures);
+    executeQuery();
+    capturesChanged();
 }
 
 void TreeSitterTreeModel::positionChanged(int position)
@@ -387,4 +538,20 @@ int TreeSitterTreeModel::captureCount() const
     return 0;
 }
 
+const treesitter::QueryProfile *TreeSitterTreeModel::queryProfile() const
+{
+    if (m_query.has_value() && m_query->profile.has_value()) {
+        return &m_query->profile.value();
+    }
+    return nullptr;
+}
+
+QStringList TreeSitterTreeModel::queryWarnings() const
+{
+    if (m_query.has_value()) {
+        return m_query->query->patternWarnings();
+    }
+    return {};
+}
+
 }
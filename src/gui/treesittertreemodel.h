@@ -40,18 +40,28 @@ public:
         treesitter::Node tsNode() const;
 
         bool includesPosition(int position) const;
+        bool childrenCreated() const;
 
         const std::vector<std::unique_ptr<TreeNode>> &children() const;
         std::vector<std::unique_ptr<TreeNode>> &children();
 
+        // Only traverse the nodes already created, which are the only ones known by the views
         void traverse(
             const std::function<void(TreeNode *)> &fun, const std::function<bool(TreeNode *)> &filter = [](auto) {
                 return true;
             });
 
     private:
+        friend TreeSitterTreeModel;
+        int nodeChildCount(const treesitter::Node &node) const;
+        std::vector<treesitter::Node> nodeChildren(const treesitter::Node &node) const;
+
         const TreeNode *m_parent;
+        // The children are created when first needed, m_children is only valid if m_childrenCreated is true
         mutable std::vector<std::unique_ptr<TreeNode>> m_children;
+        mutable bool m_childrenCreated = false;
+        // Query captures of the node, computed when first displayed
+        mutable std::optional<QString> m_captures;
         treesitter::Node m_node;
         bool m_enableUnnamed;
     };
@@ -69,33 +79,45 @@ public:
     QVariant data(const QModelIndex &index, int role) const override;
     Qt::ItemFlags flags(const QModelIndex &index) const override;
 
-    void setQuery(const std::shared_ptr<treesitter::Query> &query,
-                  std::unique_ptr<treesitter::Predicates> &&predicates);
+    void setQuery(const std::shared_ptr<treesitter::Query> &query);
     void setCursorPosition(int position);
-    void setTree(treesitter::Tree &&tree, std::unique_ptr<treesitter::Predicates> &&predicates, bool enableUnnamed);
+    void setTree(treesitter::Tree &&tree, const QString &text, bool enableUnnamed);
+    void updateTree(treesitter::Tree &&tree, const QString &text, bool enableUnnamed);
     void clear();
 
+    // Returns the index of the innermost node containing `position`, creating the nodes on the way if needed
+    QModelIndex indexAt(int position) const;
+
     std::optional<treesitter::Node> tsNode(const QModelIndex &index) const;
 
     bool hasQuery() const;
     int patternCount() const;
     int captureCount() const;
     int matchCount() const;
+    // Profile of the query on the whole tree, and warnings about its slow patterns
+    const treesitter::QueryProfile *queryProfile() const;
+    QStringList queryWarnings() const;
 
 private:
     void positionChanged(int position);
-    void capturesChanged(const std::unordered_map<treesitter::Node, QString> &oldCaptures);
-    void executeQuery(std::unique_ptr<treesitter::Predicates> &&predicates);
+    void capturesChanged();
+    void executeQuery();
+    QString captures(const TreeNode &node) const;
+    void updateNode(TreeNode &node, const treesitter::Node &newNode, const QModelIndex &index);
 
     int m_cursorPosition;
     std::optional<treesitter::Tree> m_tree;
+    // Source of m_tree, for the query predicates
+    QString m_text;
 
+    // Only the number of matches and captures are computed for the whole tree, the captures of each node are
+    // computed when the node is displayed
     struct QueryData
     {
         std::shared_ptr<treesitter::Query> query;
-        std::unordered_map<treesitter::Node, QString> captures;
         int numMatches;
         int numCaptures;
+        std::optional<treesitter::QueryProfile> profile;
     };
 
     std::optional<QueryData> m_query;
@@ -20,21 +20,32 @@
 #include <QDir>
 #include <QElapsedTimer>
 #include <QFileInfo>
+#include <QPromise>
+#include <QTimer>
 #include <QUrl>
+#include <algorithm>
+#include <string>
+#include <utility>
 
 namespace Lsp {
 
+template <typename Request>
+bool checkResponse(const Request &request, const typename Request::Response &response)
+{
+    if (!response.isValid() || response.error) {
+        spdlog::warn("Response error for request {} - {}", request.method,
+                     response.error ? response.error->message : "");
+        return false;
+    }
+    return true;
+}
+
 template <typename Request>
 std::optional<typename Request::Result> sendRequest(ClientBackend *backend, Request request,
                                                     std::function<void(typename Request::Result)> callback)
 {
     auto checkResponse = [request](typename Request::Response response) {
-        if (!response.isValid() || response.error) {
-            spdlog::warn("Response error for request {} - {}", request.method,
-                         response.error ? response.error->message : "");
-            return false;
-        }
-        return true;
+        return Lsp::checkResponse(request, response);
     };
 
     if (callback) {
@@ -54,6 +65,25 @@ std::optional<typename Request::Result> sendRequest(ClientBackend *backend, Requ
     return {};
 }
 
+template <typename Request>
+QFuture<std::optional<typename Request::Result>> sendFutureRequest(ClientBackend *backend, Request request)
+{
+    // If the backend is destroyed or the server stops before the response arrives, the promise is destroyed with the
+    // callback, which cancels and finishes the future
+    auto promise = std::make_shared<QPromise<std::optional<typename Request::Result>>>();
+    promise->start();
+    auto future = promise->future();
+
+    backend->sendAsyncRequest(request, [request, promise](typename Request::Response response) {
+        if (checkResponse(request, response))
+            promise->addResult(std::move(response.result));
+        else
+            promise->addResult(std::nullopt);
+        promise->finish();
+    });
+    return future;
+}
+
 Client::Client(std::string languageId, QString program, QStringList arguments, QObject *parent)
     : QObject(parent)
     , m_languageId(std::move(languageId))
@@ -65,6 +95,9 @@ Client::Client(std::string languageId, QString program, QStringList arguments, Q
     connect(m_backend, &ClientBackend::finished, this, [this]() {
         setState(Shutdown);
     });
+    m_backend->setNotificationHandler([this](const nlohmann::json &notification) {
+        handleNotification(notification);
+    });
 }
 
 Client::~Client() = default;
@@ -74,6 +107,26 @@ std::string Client::languageId() const
     return m_languageId;
 }
 
+void Client::setRequestTimeout(int msecs)
+{
+    m_backend->setRequestTimeout(msecs);
+}
+
+MessageId Client::lastRequestId() const
+{
+    return m_nextRequestId - 1;
+}
+
+void Client::cancelRequest(const MessageId &id)
+{
+    m_backend->cancelRequest(id);
+}
+
+void Client::setServerSocket(const QString &socketName)
+{
+    m_backend->setSocketName(socketName);
+}
+
 bool Client::initialize(const QString &rootPath)
 {
     if (!m_backend->start())
@@ -86,10 +139,29 @@ bool Client::initialize(const QString &rootPath)
     request.params.processId = static_cast<int>(QCoreApplication::applicationPid());
     request.params.clientInfo = {"knut", "4.0"};
 
+    // General capabilities
+    {
+        // Positions in Knut are offsets in a QString, so UTF-16 code units: the LSP positions can be used as-is
+        GeneralClientCapabilities generalCapabilities;
+        generalCapabilities.positionEncodings = std::vector<PositionEncodingKind> {PositionEncodingKind::UTF16};
+        request.params.capabilities.general = generalCapabilities;
+    }
+
+    // Window capabilities
+    {
+        // Needed to know when the background indexing is done, see waitUntilIndexed
+        WindowClientCapabilities windowCapabilities;
+        windowCapabilities.workDoneProgress = true;
+        request.params.capabilities.window = windowCapabilities;
+    }
+
     // Workspace capabilities
     {
         WorkspaceClientCapabilities workspaceCapabilities;
         workspaceCapabilities.workspaceFolders = true;
+        WorkspaceSymbolClientCapabilities symbol;
+        symbol.dynamicRegistration = false;
+        workspaceCapabilities.symbol = symbol;
         request.params.capabilities.workspace = workspaceCapabilities;
     }
 
@@ -114,15 +186,23 @@ bool Client::initialize(const QString &rootPath)
 
         SemanticTokensClientCapabilities semanticTokens;
         semanticTokens.dynamicRegistration = false;
-        semanticTokens.requests.full = true;
+        semanticTokens.requests.full = SemanticTokensClientCapabilities::RequestsType::FullType {true};
         semanticTokens.formats = {TokenFormat::Relative};
 
         DeclarationClientCapabilities declaration;
         declaration.dynamicRegistration = false;
         declaration.linkSupport = true;
 
+        PublishDiagnosticsClientCapabilities publishDiagnostics;
+        publishDiagnostics.versionSupport = true;
+
+        DiagnosticClientCapabilities diagnostic;
+        diagnostic.dynamicRegistration = false;
+
         TextDocumentClientCapabilities textDocument;
         textDocument.synchronization = synchronization;
+        textDocument.publishDiagnostics = publishDiagnostics;
+        textDocument.diagnostic = diagnostic;
         textDocument.documentSymbol = symbol;
         textDocument.declaration = declaration;
         textDocument.semanticTokens = semanticTokens;
@@ -177,9 +257,13 @@ void Client::didOpen(DidOpenTextDocumentParams &&params)
     if (!canSendOpenCloseChanges())
         return;
 
+    // The text of the document is moved into the message
+    ClientBackend::MovedStrings strings;
+    strings.emplace_back("/params/textDocument/text", std::exchange(params.textDocument.text, {}));
+
     TextDocumentDidOpenNotification notification;
     notification.params = std::move(params);
-    m_backend->sendNotification(notification);
+    m_backend->sendNotification(notification, std::move(strings));
 }
 
 void Client::didClose(DidCloseTextDocumentParams &&params)
@@ -197,9 +281,21 @@ void Client::didChange(DidChangeTextDocumentParams &&params)
     if (!canSendOpenCloseChanges())
         return;
 
+    // The texts of the changes are moved into the message, one of them may be the whole document
+    ClientBackend::MovedStrings strings;
+    strings.reserve(params.contentChanges.size());
+    for (std::size_t i = 0; i < params.contentChanges.size(); ++i) {
+        std::visit(
+            [&strings, i](auto &event) {
+                strings.emplace_back("/params/contentChanges/" + std::to_string(i) + "/text",
+                                     std::exchange(event.text, {}));
+            },
+            params.contentChanges[i]);
+    }
+
     TextDocumentDidChangeNotification notification;
     notification.params = std::move(params);
-    m_backend->sendNotification(notification);
+    m_backend->sendNotification(notification, std::move(strings));
 }
 
 std::optional<TextDocumentDocumentSymbolRequest::Result>
@@ -233,6 +329,192 @@ Client::references(ReferenceParams &&params,
                                                              std::move(params), asyncCallback);
 }
 
+std::optional<TextDocumentDiagnosticRequest::Result>
+Client::diagnostic(DocumentDiagnosticParams &&params,
+                   std::function<void(TextDocumentDiagnosticRequest::Result)> asyncCallback /* = {} */)
+{
+    return sendGenericRequest<TextDocumentDiagnosticRequest>(&Client::canSendDiagnostic, TextDocumentDiagnosticName,
+                                                             std::move(params), asyncCallback);
+}
+
+std::optional<TextDocumentSemanticTokensFullRequest::Result>
+Client::semanticTokensFull(SemanticTokensParams &&params,
+                           std::function<void(TextDocumentSemanticTokensFullRequest::Result)> asyncCallback /* = {} */)
+{
+    return sendGenericRequest<TextDocumentSemanticTokensFullRequest>(
+        &Client::canSendSemanticTokens, TextDocumentSemanticTokensFullName, std::move(params), asyncCallback);
+}
+
+std::optional<TextDocumentSemanticTokensFullDeltaRequest::Result> Client::semanticTokensFullDelta(
+    SemanticTokensDeltaParams &&params,
+    std::function<void(TextDocumentSemanticTokensFullDeltaRequest::Result)> asyncCallback /* = {} */)
+{
+    return sendGenericRequest<TextDocumentSemanticTokensFullDeltaRequest>(
+        &Client::canSendSemanticTokensDelta, TextDocumentSemanticTokensFullDeltaName, std::move(params),
+        asyncCallback);
+}
+
+std::optional<WorkspaceSymbolRequest::Result>
+Client::workspaceSymbol(WorkspaceSymbolParams &&params,
+                        std::function<void(WorkspaceSymbolRequest::Result)> partialResultCallback /* = {} */)
+{
+    // The token is only used by this request, the id of the request is used to make it unique
+    std::string token;
+    if (partialResultCallback) {
+        token = "knut-partial-result-" + std::to_string(m_nextRequestId);
+        params.partialResultToken = token;
+        m_partialResultCallbacks[token] = [callback = std::move(partialResultCallback)](const nlohmann::json &value) {
+            callback(value.get<WorkspaceSymbolRequest::Result>());
+        };
+    }
+    auto result = sendGenericRequest<WorkspaceSymbolRequest>(&Client::canSendWorkspaceSymbol, WorkspaceSymbolName,
+                                                             std::move(params), {});
+    if (!token.empty())
+        m_partialResultCallbacks.erase(token);
+    return result;
+}
+
+std::optional<PublishDiagnosticsParams> Client::publishedDiagnostics(const std::string &uri) const
+{
+    if (auto it = m_publishedDiagnostics.find(uri); it != m_publishedDiagnostics.end())
+        return it->second;
+    return {};
+}
+
+bool Client::waitForPublishedDiagnostics(const std::string &uri, int version, int msecs)
+{
+    // Without a version, there's no way to know if the diagnostics are up-to-date
+    auto isPublished = [this, &uri, version]() {
+        const auto it = m_publishedDiagnostics.find(uri);
+        return it != m_publishedDiagnostics.end() && it->second.version.value_or(version) >= version;
+    };
+    if (isPublished())
+        return true;
+
+    QEventLoop loop;
+    connect(this, &Client::diagnosticsPublished, &loop, [&loop, &isPublished]() {
+        if (isPublished())
+            loop.exit();
+    });
+    connect(this, &Client::stateChanged, &loop, &QEventLoop::quit);
+    QTimer::singleShot(msecs, &loop, &QEventLoop::quit);
+    loop.exec(QEventLoop::ExcludeUserInputEvents);
+    return isPublished();
+}
+
+bool Client::isIndexed() const
+{
+    return m_hasProgress && m_progress.empty();
+}
+
+bool Client::waitUntilIndexed(int msecs)
+{
+    if (isIndexed())
+        return true;
+    if (m_indexingTimedOut && !m_hasProgress)
+        return false;
+
+    QEventLoop loop;
+    connect(this, &Client::indexingProgress, &loop, [this, &loop]() {
+        if (isIndexed())
+            loop.exit();
+    });
+    connect(this, &Client::stateChanged, &loop, &QEventLoop::quit);
+    QTimer::singleShot(msecs, &loop, &QEventLoop::quit);
+    loop.exec(QEventLoop::ExcludeUserInputEvents);
+    if (!m_hasProgress && !m_indexingTimedOut) {
+        spdlog::warn("LSP server {} didn't report any indexing progress in {} ms", m_languageId, msecs);
+        m_indexingTimedOut = true;
+    }
+    return isIndexed();
+}
+
+QFuture<std::optional<TextDocumentDocumentSymbolRequest::Result>>
+Client::documentSymbolAsync(DocumentSymbolParams &&params)
+{
+    return sendGenericFutureRequest<TextDocumentDocumentSymbolRequest>(
+        &Client::canSendDocumentSymbol, TextDocumentDocumentSymbolName, std::move(params));
+}
+
+QFuture<std::optional<TextDocumentDeclarationRequest::Result>> Client::declarationAsync(DeclarationParams &&params)
+{
+    return sendGenericFutureRequest<TextDocumentDeclarationRequest>(&Client::canSendDeclaration,
+                                                                    TextDocumentDeclarationName, std::move(params));
+}
+
+QFuture<std::optional<TextDocumentHoverRequest::Result>> Client::hoverAsync(HoverParams &&params)
+{
+    return sendGenericFutureRequest<TextDocumentHoverRequest>(&Client::canSendHover, TextDocumentHoverName,
+                                                              std::move(params));
+}
+
+QFuture<std::optional<TextDocumentReferencesRequest::Result>> Client::referencesAsync(ReferenceParams &&params)
+{
+    return sendGenericFutureRequest<TextDocumentReferencesRequest>(&Client::canSendReferences,
+                                                                   TextDocumentReferencesName, std::move(params));
+}
+
+template <typename Result, typename Params>
+QList<std::optional<Result>> Client::sendBatch(QFuture<std::optional<Result>> (Client::*send)(Params &&),
+                                               std::vector<Params> &&params, int maxInFlight)
+{
+    using Watcher = QFutureWatcher<std::optional<Result>>;
+
+    QList<std::optional<Result>> results(params.size());
+    if (params.empty())
+        return results;
+
+    QEventLoop loop;
+    std::vector<std::unique_ptr<Watcher>> watchers;
+    watchers.reserve(params.size());
+    size_t next = 0;
+    size_t remaining = params.size();
+
+    // Each finished request sends the next one, so there are never more than maxInFlight requests pending. The
+    // finished signal is always queued, even for an already finished future, so this doesn't recurse.
+    std::function<void()> sendNext = [&]() {
+        const size_t index = next++;
+        auto *watcher = watchers.emplace_back(std::make_unique<Watcher>()).get();
+        QObject::connect(watcher, &Watcher::finished, &loop, [&, index, watcher]() {
+            if (watcher->future().resultCount() > 0)
+                results[index] = watcher->result();
+            if (next < params.size())
+                sendNext();
+            if (--remaining == 0)
+                loop.exit();
+        });
+        watcher->setFuture((this->*send)(std::move(params[index])));
+    };
+
+    const size_t inFlight = std::min(params.size(), static_cast<size_t>(std::max(maxInFlight, 1)));
+    for (size_t i = 0; i < inFlight; ++i)
+        sendNext();
+    loop.exec(QEventLoop::ExcludeUserInputEvents);
+
+    return results;
+}
+
+QList<std::optional<TextDocumentDocumentSymbolRequest::Result>>
+Client::documentSymbolBatch(const std::vector<std::string> &uris, int maxInFlight)
+{
+    std::vector<DocumentSymbolParams> params(uris.size());
+    for (size_t i = 0; i < uris.size(); ++i)
+        params[i].textDocument.uri = uris[i];
+    return sendBatch(&Client::documentSymbolAsync, std::move(params), maxInFlight);
+}
+
+QList<std::optional<TextDocumentHoverRequest::Result>> Client::hoverBatch(std::vector<HoverParams> &&params,
+                                                                          int maxInFlight)
+{
+    return sendBatch(&Client::hoverAsync, std::move(params), maxInFlight);
+}
+
+QList<std::optional<TextDocumentReferencesRequest::Result>>
+Client::referencesBatch(std::vector<ReferenceParams> &&params, int maxInFlight)
+{
+    return sendBatch(&Client::referencesAsync, std::move(params), maxInFlight);
+}
+
 std::string Client::toUri(const QString &path)
 {
     QFileInfo fi(path);
@@ -247,6 +529,51 @@ void Client::setState(State newState)
     emit stateChanged(m_state);
 }
 
+// Progress tokens are either numbers or strings
+static std::string tokenToString(const ProgressToken &token)
+{
+    return std::visit(
+        [](const auto &value) {
+            if constexpr (std::is_same_v<std::decay_t<decltype(value)>, std::string>)
+                return value;
+            else
+                return std::to_string(value);
+        },
+        token);
+}
+
+void Client::handleNotification(const nlohmann::json &notification)
+{
+    if (!notification.contains("params"))
+        return;
+    const auto method = notification.value("method", "");
+    if (method == ProgressName) {
+        try {
+            const auto params = notification.at("params").get<ProgressParams>();
+            // Partial results are sent as progress, using the token of the request
+            if (auto it = m_partialResultCallbacks.find(tokenToString(params.token));
+                it != m_partialResultCallbacks.end())
+                it->second(params.value);
+            else
+                handleProgress(params);
+        } catch (const nlohmann::json::exception &exception) {
+            spdlog::warn("Invalid progress reported by the LSP server: {}", exception.what());
+        }
+        return;
+    }
+    if (method != TextDocumentPublishDiagnosticsName)
+        return;
+
+    try {
+        auto params = notification.at("params").get<PublishDiagnosticsParams>();
+        const auto uri = params.uri;
+        m_publishedDiagnostics[uri] = std::move(params);
+        emit diagnosticsPublished(uri);
+    } catch (const nlohmann::json::exception &exception) {
+        spdlog::warn("Invalid diagnostics published by the LSP server: {}", exception.what());
+    }
+}
+
 bool Client::initializeCallback(InitializeRequest::Response response)
 {
     if (!response.isValid() || response.error) {
@@ -256,6 +583,11 @@ bool Client::initializeCallback(InitializeRequest::Response response)
     }
 
     m_serverCapabilities = response.result->capabilities;
+    if (const auto &encoding = m_serverCapabilities.positionEncoding;
+        encoding && *encoding != PositionEncodingKind::UTF16) {
+        spdlog::warn("LSP server uses the {} position encoding instead of utf-16, positions may be wrong",
+                     nlohmann::json(*encoding).get<std::string>());
+    }
     m_backend->sendNotification(InitializedNotification());
     spdlog::debug("LSP server initialized");
     setState(Initialized);
@@ -307,6 +639,45 @@ bool Client::canSendOpenCloseChanges() const
     return false;
 }
 
+bool Client::canSendDiagnostic() const
+{
+    Q_ASSERT(m_state == Initialized);
+    return m_serverCapabilities.diagnosticProvider.has_value();
+}
+
+bool Client::canSendSemanticTokens() const
+{
+    Q_ASSERT(m_state == Initialized);
+    if (!m_serverCapabilities.semanticTokensProvider)
+        return false;
+    // The registration options derive from the options
+    return std::visit(
+        [](const SemanticTokensOptions &options) {
+            if (!options.full)
+                return false;
+            if (const auto *full = std::get_if<bool>(&options.full.value()))
+                return *full;
+            return true;
+        },
+        m_serverCapabilities.semanticTokensProvider.value());
+}
+
+bool Client::canSendSemanticTokensDelta() const
+{
+    Q_ASSERT(m_state == Initialized);
+    if (!m_serverCapabilities.semanticTokensProvider)
+        return false;
+    return std::visit(
+        [](const SemanticTokensOptions &options) {
+            if (!options.full)
+                return false;
+            if (const auto *full = std::get_if<SemanticTokensOptions::FullType>(&options.full.value()))
+                return full->delta.value_or(false);
+            return false;
+        },
+        m_serverCapabilities.semanticTokensProvider.value());
+}
+
 bool Client::canSendDocumentChanges(TextDocumentSyncKind kind) const
 {
     Q_ASSERT(m_state == Initialized);
@@ -343,4 +714,34 @@ bool Client::canSendReferences() const
     return canSend<ReferenceOptions>(&Lsp::ServerCapabilities::referencesProvider);
 }
 
+bool Client::canSendWorkspaceSymbol() const
+{
+    return canSend<WorkspaceSymbolOptions>(&Lsp::ServerCapabilities::workspaceSymbolProvider);
+}
+
+void Client::handleProgress(const ProgressParams &params)
+{
+    const auto token = tokenToString(params.token);
+    const auto kind = params.value.value("kind", "");
+    const auto message = params.value.value("message", "");
+    const int percentage = params.value.value("percentage", -1);
+
+    if (kind == WorkDoneProgressBegin::kind) {
+        m_hasProgress = true;
+        const auto title = params.value.value("title", "");
+        m_progress[token] = title;
+        spdlog::debug("LSP server {}: {} started", m_languageId, title);
+        emit indexingProgress(percentage, message.empty() ? title : message);
+    } else if (kind == WorkDoneProgressReport::kind) {
+        emit indexingProgress(percentage, message);
+    } else if (kind == WorkDoneProgressEnd::kind) {
+        const auto it = m_progress.find(token);
+        if (it != m_progress.end()) {
+            spdlog::debug("LSP server {}: {} done", m_languageId, it->second);
+            m_progress.erase(it);
+        }
+        emit indexingProgress(100, message);
+    }
+}
+
 } // namespace Lsp
@@ -12,10 +12,17 @@
 
 #include "requests.h"
 #include "types.h"
+#include "utils/json.h"
 #include "utils/log.h"
 
+#include <QEventLoop>
+#include <QFuture>
+#include <QFutureWatcher>
 #include <QObject>
+#include <memory>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace Lsp {
 
@@ -38,6 +45,27 @@ public:
 
     std::string languageId() const;
 
+    /**
+     * Sets the time to wait for the response of a request, no timeout if 0 or less.
+     * A request without any response in time is cancelled.
+     */
+    void setRequestTimeout(int msecs);
+    /**
+     * Returns the id of the last request sent, which can be used to cancel it with cancelRequest
+     */
+    MessageId lastRequestId() const;
+    /**
+     * Cancels a pending request, for example if its result is not needed anymore. Its callback won't be called, and
+     * the server is notified with $/cancelRequest.
+     */
+    void cancelRequest(const MessageId &id);
+
+    /**
+     * Connects to a server listening on a local socket, instead of starting the program, to reuse a server that is
+     * already running. Must be called before initialize.
+     */
+    void setServerSocket(const QString &socketName);
+
     bool initialize(const QString &rootPath = {});
     bool shutdown();
 
@@ -70,6 +98,13 @@ public:
      */
     bool canSendDocumentChanges(TextDocumentSyncKind kind) const;
 
+    /**
+     * Query which kind of diagnostics and semantic tokens requests can be sent to the server.
+     */
+    bool canSendDiagnostic() const;
+    bool canSendSemanticTokens() const;
+    bool canSendSemanticTokensDelta() const;
+
     /**
      * ##### LSP requests #####
      * If asyncCallback is not null, the request will be sent asynchronously and the callback called once the response
@@ -90,15 +125,119 @@ public:
     std::optional<TextDocumentReferencesRequest::Result>
     references(ReferenceParams &&params, std::function<void(TextDocumentReferencesRequest::Result)> asyncCallback = {});
 
+    std::optional<TextDocumentDiagnosticRequest::Result>
+    diagnostic(DocumentDiagnosticParams &&params,
+               std::function<void(TextDocumentDiagnosticRequest::Result)> asyncCallback = {});
+
+    std::optional<TextDocumentSemanticTokensFullRequest::Result>
+    semanticTokensFull(SemanticTokensParams &&params,
+                       std::function<void(TextDocumentSemanticTokensFullRequest::Result)> asyncCallback = {});
+
+    std::optional<TextDocumentSemanticTokensFullDeltaRequest::Result>
+    semanticTokensFullDelta(SemanticTokensDeltaParams &&params,
+                            std::function<void(TextDocumentSemanticTokensFullDeltaRequest::Result)> asyncCallback = {});
+
+    /**
+     * ##### Workspace symbols #####
+     * Searches the symbols matching the query in the whole workspace, waiting for the response. If the server
+     * streams partial results, each one is passed to `partialResultCallback` as soon as it arrives, and the response
+     * only contains the remaining symbols.
+     */
+    std::optional<WorkspaceSymbolRequest::Result>
+    workspaceSymbol(WorkspaceSymbolParams &&params,
+                    std::function<void(WorkspaceSymbolRequest::Result)> partialResultCallback = {});
+
+    /**
+     * ##### Published diagnostics #####
+     * Servers not supporting diagnostic requests (like clangd) publish the diagnostics of a document after each change.
+     * Returns the last diagnostics published for the document, if any.
+     */
+    std::optional<PublishDiagnosticsParams> publishedDiagnostics(const std::string &uri) const;
+    /**
+     * Waits until the diagnostics for the given version of the document are published, for at most msecs
+     * milliseconds. Returns false if they are not published in time.
+     */
+    bool waitForPublishedDiagnostics(const std::string &uri, int version, int msecs);
+
+    /**
+     * ##### Indexing #####
+     * Servers like clangd index the project in the background after the initialization, reporting their progress
+     * with $/progress notifications. Until it's done, some requests are slow, or return incomplete results (e.g.
+     * references).
+     * The project is indexed once the server has reported some progress, and all of it is done.
+     */
+    bool isIndexed() const;
+    /**
+     * Waits until the project is indexed, for at most msecs milliseconds. Returns false if it's not indexed in time,
+     * which is always the case for servers not reporting their progress: once a wait timed out without any progress
+     * reported, it returns false right away.
+     */
+    bool waitUntilIndexed(int msecs);
+
+    /**
+     * ##### Non-blocking LSP requests #####
+     * The requests are sent right away, and the future is finished once the response has arrived. An empty optional
+     * means there was an error. Multiple requests can be sent before waiting for the responses, see waitForFinished.
+     */
+    QFuture<std::optional<TextDocumentDocumentSymbolRequest::Result>>
+    documentSymbolAsync(DocumentSymbolParams &&params);
+    QFuture<std::optional<TextDocumentDeclarationRequest::Result>> declarationAsync(DeclarationParams &&params);
+    QFuture<std::optional<TextDocumentHoverRequest::Result>> hoverAsync(HoverParams &&params);
+    QFuture<std::optional<TextDocumentReferencesRequest::Result>> referencesAsync(ReferenceParams &&params);
+
+    /**
+     * Waits until all the futures are finished, processing events (except user input) in the meantime, so the
+     * responses can be received.
+     */
+    template <typename T>
+    static void waitForFinished(const QList<QFuture<T>> &futures)
+    {
+        QEventLoop loop;
+        std::vector<std::unique_ptr<QFutureWatcher<T>>> watchers;
+        qsizetype remaining = 0;
+        for (const auto &future : futures) {
+            if (future.isFinished())
+                continue;
+            ++remaining;
+            auto &watcher = watchers.emplace_back(std::make_unique<QFutureWatcher<T>>());
+            QObject::connect(watcher.get(), &QFutureWatcher<T>::finished, &loop, [&loop, &remaining]() {
+                if (--remaining == 0)
+                    loop.exit();
+            });
+            watcher->setFuture(future);
+        }
+        if (remaining > 0)
+            loop.exec(QEventLoop::ExcludeUserInputEvents);
+    }
+
+    /**
+     * ##### Batch LSP requests #####
+     * Sends all the requests, keeping at most `maxInFlight` of them pending at the same time, and waits for all the
+     * responses. The results are in the same order as the parameters, and empty if the request failed.
+     * The documents must have been opened on the server first.
+     */
+    static constexpr int DefaultMaxRequestsInFlight = 16;
+    QList<std::optional<TextDocumentDocumentSymbolRequest::Result>>
+    documentSymbolBatch(const std::vector<std::string> &uris, int maxInFlight = DefaultMaxRequestsInFlight);
+    QList<std::optional<TextDocumentHoverRequest::Result>> hoverBatch(std::vector<HoverParams> &&params,
+                                                                      int maxInFlight = DefaultMaxRequestsInFlight);
+    QList<std::optional<TextDocumentReferencesRequest::Result>>
+    referencesBatch(std::vector<ReferenceParams> &&params, int maxInFlight = DefaultMaxRequestsInFlight);
+
     State state() const { return m_state; }
 
     static std::string toUri(const QString &path);
 
 signals:
     void stateChanged(Lsp::Client::State state);
+    void diagnosticsPublished(const std::string &uri);
+    // Emitted for each progress reported by the server, the percentage is -1 if unknown and 100 once it's done
+    void indexingProgress(int percentage, const std::string &message);
 
 private:
     void setState(State newState);
+    void handleNotification(const nlohmann::json &notification);
+    void handleProgress(const ProgressParams &params);
     bool initializeCallback(InitializeRequest::Response response);
     bool shutdownCallback(ShutdownRequest::Response response);
 
@@ -108,6 +247,7 @@ private:
     bool canSendDeclaration() const;
     bool canSendHover() const;
     bool canSendReferences() const;
+    bool canSendWorkspaceSymbol() const;
 
     template <typename Request, typename Params>
     std::optional<typename Request::Result>
@@ -126,6 +266,26 @@ private:
         return sendRequest(m_backend, request, asyncCallback);
     }
 
+    template <typename Request, typename Params>
+    QFuture<std::optional<typename Request::Result>>
+    sendGenericFutureRequest(bool (Client::*canSend)() const, const char *name, Params &&params)
+    {
+        if (!(this->*canSend)()) {
+            spdlog::error("{} not supported by LSP server", name);
+            return QtFuture::makeReadyFuture(std::optional<typename Request::Result>());
+        }
+
+        Request request;
+        request.id = m_nextRequestId++;
+        request.params = std::forward<Params>(params);
+
+        return sendFutureRequest(m_backend, request);
+    }
+
+    template <typename Result, typename Params>
+    QList<std::optional<Result>> sendBatch(QFuture<std::optional<Result>> (Client::*send)(Params &&),
+                                           std::vector<Params> &&params, int maxInFlight);
+
     template <typename Options, typename Variant>
     bool canSend(Variant Lsp::ServerCapabilities::*pProvider) const
     {
@@ -146,6 +306,13 @@ private:
     State m_state = Uninitialized;
 
     ServerCapabilities m_serverCapabilities;
+    std::unordered_map<std::string, PublishDiagnosticsParams> m_publishedDiagnostics;
+    // Titles of the progress in progress, by token
+    std::unordered_map<std::string, std::string> m_progress;
+    bool m_hasProgress = false;
+    bool m_indexingTimedOut = false;
+    // Callbacks of the requests streaming partial results, by partial result token
+    std::unordered_map<std::string, std::function<void(const nlohmann::json &)>> m_partialResultCallbacks;
 };
 
 } // namespace Lsp
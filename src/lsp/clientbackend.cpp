@@ -14,12 +14,18 @@
 #include "requestmessage_json.h"
 #include "requests.h"
 #include "types_json.h"
+#include "utils/metrics.h"
+#include "utils/tracing.h"
 
-#include <QBuffer>
 #include <QEventLoop>
+#include <QLocalSocket>
 #include <QString>
+#include <QTimer>
 #include <QtEnvironmentVariables>
+#include <algorithm>
 #include <ctime>
+#include <utility>
+#include <spdlog/async.h>
 #include <spdlog/sinks/basic_file_sink.h>
 
 using json = nlohmann::json;
@@ -30,8 +36,8 @@ namespace Lsp {
 // Return the message to send, with the header + content
 static QByteArray toMessage(const json &content)
 {
-    const QByteArray data = QByteArray::fromStdString(content.dump());
-    const int length = data.size();
+    const std::string data = content.dump();
+    const auto length = static_cast<qsizetype>(data.size());
 
     // https://microsoft.github.io/language-server-protocol/specifications/specification-current/#headerPart
     // The content-type is optional, and only UTF-8 is accepted for the charset
@@ -41,9 +47,11 @@ static QByteArray toMessage(const json &content)
     // {
     //     ~~~
     // }
-    const QString header = QString("Content-Length: %1\r\n\r\n").arg(length);
-
-    return header.toLatin1() + data;
+    // The content is only copied once, it may be the whole text of a document
+    QByteArray message = "Content-Length: " + QByteArray::number(length) + "\r\n\r\n";
+    message.reserve(message.size() + length);
+    message.append(data.data(), length);
+    return message;
 }
 
 ClientBackend::ClientBackend(const std::string &language, QString program, QStringList arguments, QObject *parent)
@@ -51,6 +59,7 @@ ClientBackend::ClientBackend(const std::string &language, QString program, QStri
     , m_program(std::move(program))
     , m_arguments(std::move(arguments))
     , m_process(new QProcess(this))
+    , m_device(m_process)
 {
     if (!qEnvironmentVariable("KNUT_LOG_LSP").isEmpty()) {
         const auto serverLogName = language + "_server";
@@ -64,7 +73,10 @@ ClientBackend::ClientBackend(const std::string &language, QString program, QStri
         const auto messageLogName = language + "_messages";
         m_messageLogger = spdlog::get(messageLogName);
         if (!m_messageLogger) {
-            m_messageLogger = spdlog::basic_logger_mt(messageLogName, messageLogName + ".log", true);
+            // Messages can be big and numerous: write them in a background thread, and let the file buffer
+            // batch the writes instead of flushing after each message. It's flushed when the backend is destroyed.
+            m_messageLogger =
+                spdlog::basic_logger_mt<spdlog::async_factory>(messageLogName, messageLogName + ".log", true);
             m_messageLogger->set_level(spdlog::level::info);
             m_messageLogger->set_pattern("[LSP   - %H:%M:%S] %v");
         }
@@ -78,6 +90,13 @@ ClientBackend::ClientBackend(const std::string &language, QString program, QStri
 
 ClientBackend::~ClientBackend()
 {
+    if (m_messageLogger)
+        m_messageLogger->flush();
+    if (m_socket) {
+        // Don't get notified during the destruction
+        m_socket->disconnect(this);
+        m_socket->disconnectFromServer();
+    }
     if (m_process->state() == QProcess::NotRunning)
         return;
     m_process->terminate();
@@ -87,8 +106,22 @@ ClientBackend::~ClientBackend()
     m_process->waitForFinished(300);
 }
 
+void ClientBackend::setSocketName(const QString &socketName)
+{
+    Q_ASSERT(m_process->state() == QProcess::NotRunning && !m_socket);
+    m_socketName = socketName;
+}
+
+void ClientBackend::setNotificationHandler(std::function<void(const nlohmann::json &)> handler)
+{
+    m_notificationHandler = std::move(handler);
+}
+
 bool ClientBackend::start()
 {
+    if (!m_socketName.isEmpty())
+        return connectToSocket();
+
     if (m_serverLogger)
         m_serverLogger->trace("==> Starting LSP server {}", m_program);
     m_process->start(m_program, m_arguments);
@@ -97,6 +130,27 @@ bool ClientBackend::start()
     return false;
 }
 
+bool ClientBackend::connectToSocket()
+{
+    if (m_serverLogger)
+        m_serverLogger->trace("==> Connecting to LSP server on {}", m_socketName);
+
+    m_socket = new QLocalSocket(this);
+    m_device = m_socket;
+    connect(m_socket, &QLocalSocket::readyRead, this, &ClientBackend::readOutput);
+    connect(m_socket, &QLocalSocket::errorOccurred, this, [this]() {
+        if (m_serverLogger)
+            m_serverLogger->error("==> LSP socket {} raises an error {}", m_socketName, m_socket->errorString());
+        emit errorOccured(m_socket->errorString());
+    });
+    connect(m_socket, &QLocalSocket::disconnected, this, [this]() {
+        handleFinished(0, QProcess::NormalExit);
+    });
+
+    m_socket->connectToServer(m_socketName);
+    return m_socket->waitForConnected();
+}
+
 void ClientBackend::readError()
 {
     if (m_serverLogger)
@@ -105,10 +159,37 @@ void ClientBackend::readError()
 
 void ClientBackend::readOutput()
 {
-    m_message.addData(m_process->readAllStandardOutput());
+    KNUT_TRACE_SCOPE("ClientBackend::readOutput");
+    m_message.addData(m_device->readAll());
+
+    while (auto content = m_message.getNextMessage()) {
+        // Responses with a streaming parser don't need to go through a json object, except to log them
+        if (!m_messageLogger && hasStreamingParser()) {
+            if (auto id = peekMessageId(content.value())) {
+                auto it = m_callbacks.find(id.value());
+                if (it != m_callbacks.end() && it->second.parse) {
+                    // Remove the callback first, it may send new requests
+                    auto pending = std::move(it->second);
+                    m_callbacks.erase(it);
+                    if (pending.parse(content.value())) {
+                        recordLatency(pending);
+                        continue;
+                    }
+                    // Not the expected kind of response, use the generic parsing
+                    m_callbacks[id.value()] = std::move(pending);
+                }
+            }
+        }
+
+        json message;
+        try {
+            message = json::parse(content->begin(), content->end());
+        } catch (const json::parse_error &error) {
+            // Waiting for more data won't fix it, skip this message
+            spdlog::error("ClientBackend::Message - invalid message: {}", error.what());
+            continue;
+        }
 
-    auto message = m_message.getNextMessage();
-    while (!message.is_null()) {
         // Check if there is an error
         if (message.contains("error")) {
             auto errorString = message.at("error").at("message").get<std::string>();
@@ -116,22 +197,61 @@ void ClientBackend::readOutput()
                 m_serverLogger->error("<== Error response: {}", errorString);
         }
 
-        if (message.contains("id")) {
+        if (message.contains("id") && message.contains("method")) {
+            handleServerRequest(message);
+        } else if (message.contains("id")) {
             const MessageId id = message.at("id").get<MessageId>();
             auto it = m_callbacks.find(id);
             if (it != m_callbacks.end()) {
                 logMessage("receive-response", message);
-                it->second(std::move(message));
+                recordLatency(it->second);
+                // Remove the callback first, it may send new requests
+                auto callback = std::move(it->second.callback);
+                m_callbacks.erase(it);
+                callback(std::move(message));
             } else {
-                logMessage("receive-request", message);
+                logMessage("receive-response", message);
             }
         } else {
             logMessage("receive-notification", message);
+            if (m_notificationHandler)
+                m_notificationHandler(message);
         }
-        message = m_message.getNextMessage();
     }
 }
 
+// The server waits for the response of its requests, so each of them is answered, even if it's not supported
+void ClientBackend::handleServerRequest(const nlohmann::json &request)
+{
+    logMessage("receive-request", request);
+    json response {{"jsonrpc", "2.0"}, {"id", request.at("id")}};
+    const auto method = request.value("method", "");
+    if (method == WorkDoneProgressCreateName) {
+        // Nothing to create, the progress is reported with $/progress notifications, see Client
+        response["result"] = nullptr;
+    } else {
+        response["error"] = {{"code", static_cast<int>(ErrorCodes::MethodNotFound)},
+                             {"message", "Unsupported request " + method}};
+    }
+    logMessage("send-response", response);
+    m_device->write(toMessage(response));
+}
+
+void ClientBackend::recordLatency(const PendingRequest &pending)
+{
+    static auto &latency = Utils::Metrics::histogram("lsp.request_latency_us");
+    latency.record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now()
+                                                                         - pending.sentTime)
+                       .count());
+}
+
+bool ClientBackend::hasStreamingParser() const
+{
+    return std::ranges::any_of(m_callbacks, [](const auto &pending) {
+        return static_cast<bool>(pending.second.parse);
+    });
+}
+
 void ClientBackend::handleError()
 {
     if (m_serverLogger)
@@ -143,109 +263,137 @@ void ClientBackend::handleFinished(int exitCode, QProcess::ExitStatus exitStatus
 {
     if (m_serverLogger)
         m_serverLogger->trace("==> Exiting LSP server {} with exit code {}", m_program, exitCode);
+    // No response will come anymore: destroying the callbacks also cancels the pending non-blocking requests
+    m_callbacks.clear();
     if (exitStatus != QProcess::CrashExit)
         emit finished();
 }
 
+void ClientBackend::setRequestTimeout(int msecs)
+{
+    m_requestTimeout = msecs;
+}
+
+void ClientBackend::cancelRequest(const MessageId &id)
+{
+    if (m_callbacks.erase(id) == 0)
+        return;
+
+    CancelRequestNotification notification;
+    notification.params.id = id;
+    sendNotification(notification);
+}
+
+void ClientBackend::startRequestTimer(const MessageId &id)
+{
+    if (m_requestTimeout <= 0)
+        return;
+    QTimer::singleShot(m_requestTimeout, this, [this, id]() {
+        if (m_callbacks.contains(id))
+            timeoutRequest(id);
+    });
+}
+
+void ClientBackend::timeoutRequest(const MessageId &id)
+{
+    static auto &timeouts = Utils::Metrics::counter("lsp.request_timeouts");
+    timeouts.add();
+    std::visit(
+        [this](const auto &value) {
+            spdlog::warn("LSP server {} didn't answer request {} in time, cancelling it", m_program, value);
+        },
+        id);
+    cancelRequest(id);
+}
+
 void ClientBackend::sendAsyncJsonRequest(const nlohmann::json &jsonRequest)
 {
+    static auto &requests = Utils::Metrics::counter("lsp.requests");
+    requests.add();
     logMessage("send-request", jsonRequest);
     const auto message = toMessage(jsonRequest);
-    m_process->write(message);
+    m_device->write(message);
 }
 
-nlohmann::json ClientBackend::sendJsonRequest(const nlohmann::json &jsonRequest)
+void ClientBackend::waitForResponse(const MessageId &id, QEventLoop &loop)
 {
-    // Wait for the response to be emitted using the QEventLoop trick
-    QEventLoop loop;
-    connect(this, &ClientBackend::responseEmitted, &loop, [&loop]() {
+    QTimer timer;
+    timer.setSingleShot(true);
+    connect(&timer, &QTimer::timeout, &loop, [this, &loop, &id]() {
+        timeoutRequest(id);
         loop.exit();
     });
-    sendAsyncJsonRequest(jsonRequest);
+    if (m_requestTimeout > 0)
+        timer.start(m_requestTimeout);
     loop.exec(QEventLoop::ExcludeUserInputEvents);
 
-    return m_response;
+    // The callback references the loop, make sure it's gone whatever made the loop exit
+    m_callbacks.erase(id);
 }
 
 void ClientBackend::sendJsonNotification(const nlohmann::json &jsonNotification)
 {
     logMessage("send-notification", jsonNotification);
     const auto message = toMessage(jsonNotification);
-    m_process->write(message);
+    m_device->write(message);
 }
 
-void ClientBackend::logMessage(std::string type, const nlohmann::json &message)
+void ClientBackend::logMessage(std::string_view type, const nlohmann::json &message)
 {
-    json log = {
-        {"type", type},
-        {"message", message},
-        {"timestamp", std::time(nullptr)},
-    };
-    if (m_messageLogger) {
-        m_messageLogger->info(log.dump());
-        m_messageLogger->flush();
-    }
+    if (!m_messageLogger)
+        return;
+    // Build the log entry directly, instead of copying the message into a new json object
+    m_messageLogger->info(R"({{"type":"{}","message":{},"timestamp":{}}})", type, message.dump(), std::time(nullptr));
 }
 
 void ClientBackend::Message::addData(const QByteArray &data)
 {
+    // Drop the messages already parsed, once it's worth moving the rest of the buffer
+    if (m_offset > 0 && m_offset * 2 >= m_data.size()) {
+        m_data.remove(0, m_offset);
+        m_offset = 0;
+    }
     m_data += data;
 }
 
-nlohmann::json ClientBackend::Message::getNextMessage()
+std::optional<QByteArrayView> ClientBackend::Message::getNextMessage()
 {
-    // Not enough data yet to read the message
-    if (m_length == 0 && !readHeader())
+    // Not enough data yet to read the header, or the content
+    if (m_length == -1 && !readHeader())
+        return {};
+    if (m_data.size() - m_offset < m_length)
         return {};
 
-    // There is a message
-    if (m_length) {
-        QBuffer buf;
-        buf.setData(m_data);
-        if (buf.open(QIODevice::ReadOnly)) {
-            json message;
-            try {
-                message = json::parse(buf.read(m_length).constData());
-
-                m_length = 0;
-                m_data = m_data.mid(buf.pos());
-            } catch (...) {
-                // If we have parsing errors then the message
-                // is not fully received, return an empty message
-                // and wait for the next time this function runs.
-                message = {};
-            }
-            return message;
-        }
-    }
-    return {};
+    // The content is complete, it's parsed directly from the buffer
+    const auto content = QByteArrayView(m_data).sliced(m_offset, m_length);
+    m_offset += m_length;
+    m_length = -1;
+    return content;
 }
 
 bool ClientBackend::Message::readHeader()
 {
-    QBuffer buf;
-    buf.setData(m_data);
-    int length = 0;
-    if (buf.open(QIODevice::ReadOnly)) {
-        while (!buf.atEnd()) {
-            const QByteArray &headerLine = buf.readLine();
-
-            // There's always an empty line between header and content
-            if (headerLine == "\r\n") {
-                m_length = length;
-                m_data = m_data.mid(buf.pos());
-                return true;
-            }
-
-            int assignmentIndex = headerLine.indexOf(": ");
-            if (assignmentIndex >= 0) {
-                const QByteArray &key = headerLine.mid(0, assignmentIndex).trimmed();
-                const QByteArray &value = headerLine.mid(assignmentIndex + 2).trimmed();
-                if (key == "Content-Length")
-                    length = value.toInt();
-            }
+    // There's always an empty line between header and content
+    const auto headerEnd = m_data.indexOf("\r\n\r\n", m_offset);
+    if (headerEnd == -1)
+        return false;
+
+    const auto header = QByteArrayView(m_data).sliced(m_offset, headerEnd - m_offset);
+    qsizetype length = 0;
+    for (qsizetype lineStart = 0; lineStart < header.size();) {
+        auto lineEnd = header.indexOf("\r\n", lineStart);
+        if (lineEnd == -1)
+            lineEnd = header.size();
+        const auto line = header.sliced(lineStart, lineEnd - lineStart);
+        if (const auto assignmentIndex = line.indexOf(':'); assignmentIndex >= 0) {
+            if (line.first(assignmentIndex).trimmed() == "Content-Length")
+                length = line.sliced(assignmentIndex + 1).trimmed().toLongLong();
         }
+        lineStart = lineEnd + 2;
     }
-    return false;
+
+    m_length = length;
+    m_offset = headerEnd + 4;
+    return true;
 }
 }
@@ -11,14 +11,25 @@
 #pragma once
 
 #include "requestmessage.h"
+#include "responseparser.h"
 #include "utils/json.h"
 #include "utils/log.h"
 
+#include <QByteArrayView>
+#include <QEventLoop>
 #include <QObject>
 #include <QProcess>
+#include <chrono>
 #include <functional>
+#include <optional>
+#include <string_view>
+#include <type_traits>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
+class QIODevice;
+class QLocalSocket;
 class QProcess;
 
 namespace Lsp {
@@ -31,27 +42,41 @@ public:
     ClientBackend(const std::string &language, QString program, QStringList arguments, QObject *parent = nullptr);
     ~ClientBackend() override;
 
+    // Connects to an already running server through a local socket, instead of starting the program.
+    // Must be called before start.
+    void setSocketName(const QString &socketName);
+
     bool start();
 
+    // Called for each notification sent by the server
+    void setNotificationHandler(std::function<void(const nlohmann::json &)> handler);
+
+    // Time to wait for a response before cancelling a request, no timeout if 0 or less
+    static constexpr int DefaultRequestTimeout = 30000;
+    void setRequestTimeout(int msecs);
+
+    // Cancels a pending request: its callback is removed and the server is notified with $/cancelRequest.
+    // Does nothing if the response has already been received.
+    void cancelRequest(const MessageId &id);
+
     template <typename Request>
     void sendAsyncRequest(const Request &request, typename Request::ResponseCallback callback)
     {
-        m_callbacks[request.id] = [this, callback](nlohmann::json &&j) {
-            if (callback) {
-                auto response = deserializeResponse<typename Request::Response>(std::move(j));
-                callback(std::move(response));
-            }
-        };
+        addPendingRequest(request, std::move(callback));
         sendAsyncJsonRequest(request);
+        startRequestTimer(request.id);
     }
 
     template <typename Request>
     typename Request::Response sendRequest(const Request &request)
     {
-        m_callbacks[request.id] = [this](nlohmann::json &&j) {
-            m_response = std::move(j);
-            emit responseEmitted(QPrivateSignal {});
-        };
+        // Wait for the response using the QEventLoop trick
+        QEventLoop loop;
+        typename Request::Response response;
+        addPendingRequest(request, [&loop, &response](typename Request::Response result) {
+            response = std::move(result);
+            loop.exit();
+        });
 
         std::visit(
             [this, &request](const auto &id) {
@@ -59,8 +84,10 @@ public:
                     m_serverLogger->debug("==> Sending Request {} with id {}", request.method, id);
             },
             request.id);
-        auto j = sendJsonRequest(request);
-        return deserializeResponse<typename Request::Response>(std::move(j));
+        sendAsyncJsonRequest(request);
+        // The response is invalid if the request timed out
+        waitForResponse(request.id, loop);
+        return response;
     }
 
     template <typename Notification>
@@ -71,14 +98,29 @@ public:
         sendJsonNotification(notification);
     }
 
+    // Same as above, with large strings (e.g. the text of a document) moved into the message instead of being copied
+    // with the rest of the notification. Each string is set at its json pointer, once the notification is converted.
+    using MovedStrings = std::vector<std::pair<nlohmann::json::json_pointer, std::string>>;
+    template <typename Notification>
+    void sendNotification(const Notification &notification, MovedStrings &&strings)
+    {
+        if (m_serverLogger)
+            m_serverLogger->debug("==> Sending Notification {}", notification.method);
+        nlohmann::json jsonNotification = notification;
+        for (auto &[pointer, string] : strings)
+            jsonNotification[pointer] = std::move(string);
+        sendJsonNotification(jsonNotification);
+    }
+
 signals:
     void errorOccured(const QString &message);
     void finished();
-    void responseEmitted(QPrivateSignal);
 
 private:
     void readError();
+    bool connectToSocket();
     void readOutput();
+    bool hasStreamingParser() const;
     void handleError();
     void handleFinished(int exitCode, QProcess::ExitStatus exitStatus);
 
@@ -101,11 +143,39 @@ private:
         return {};
     }
 
+    template <typename Request>
+    void addPendingRequest(const Request &request, typename Request::ResponseCallback callback)
+    {
+        PendingRequest pending;
+        pending.callback = [this, callback](nlohmann::json &&j) {
+            if (callback) {
+                auto response = deserializeResponse<typename Request::Response>(std::move(j));
+                callback(std::move(response));
+            }
+        };
+        // Lists of locations can be huge, parse them directly from the message content
+        if constexpr (std::is_same_v<typename Request::Response, LocationsResponse>) {
+            pending.parse = [callback](QByteArrayView content) {
+                LocationsResponse response;
+                if (!parseLocationsResponse(content, response))
+                    return false;
+                if (callback)
+                    callback(std::move(response));
+                return true;
+            };
+        }
+        m_callbacks[request.id] = std::move(pending);
+    }
+
+    void waitForResponse(const MessageId &id, QEventLoop &loop);
+    void startRequestTimer(const MessageId &id);
+    void timeoutRequest(const MessageId &id);
+
+    void handleServerRequest(const nlohmann::json &request);
     void sendAsyncJsonRequest(const nlohmann::json &jsonRequest);
-    nlohmann::json sendJsonRequest(const nlohmann::json &jsonRequest);
     void sendJsonNotification(const nlohmann::json &jsonNotification);
 
-    void logMessage(std::string type, const nlohmann::json &message);
+    void logMessage(std::string_view type, const nlohmann::json &message);
 
 private:
     std::shared_ptr<spdlog::logger> m_serverLogger;
@@ -113,26 +183,44 @@ private:
     const QString m_program;
     const QStringList m_arguments;
     QProcess *m_process = nullptr;
-
-    std::unordered_map<MessageId, std::function<void(nlohmann::json)>> m_callbacks;
-    nlohmann::json m_response;
+    QString m_socketName;
+    QLocalSocket *m_socket = nullptr;
+    // Either the process or the socket, used to communicate with the server
+    QIODevice *m_device = nullptr;
+    std::function<void(const nlohmann::json &)> m_notificationHandler;
+    int m_requestTimeout = DefaultRequestTimeout;
+
+    struct PendingRequest
+    {
+        std::function<void(nlohmann::json)> callback;
+        // Optional streaming parser, calling the callback itself. Returns false if the content must be parsed as json.
+        std::function<bool(QByteArrayView)> parse;
+        // Used to measure the latency of the request
+        std::chrono::steady_clock::time_point sentTime = std::chrono::steady_clock::now();
+    };
+    static void recordLatency(const PendingRequest &pending);
+    std::unordered_map<MessageId, PendingRequest> m_callbacks;
 
     class Message
     {
     public:
         void addData(const QByteArray &data);
 
-        // Parse the current data, and return a message as a json object or empty if there's nothing
-        nlohmann::json getNextMessage();
+        // Parse the current data, and return the content of the next message or an empty optional if there's nothing
+        // The content is only valid until data is added.
+        std::optional<QByteArrayView> getNextMessage();
 
     private:
-        // Read the header file and remove the data from m_data
-        // Returns true if the header file is read
+        // Read the header at m_offset, and move m_offset to the content
+        // Returns true if the header is read
         bool readHeader();
 
     private:
         QByteArray m_data;
-        int m_length = 0;
+        // Start of the data not parsed yet
+        qsizetype m_offset = 0;
+        // Length of the content of the current message, -1 if the header is not read yet
+        qsizetype m_length = -1;
     };
 
     Message m_message;
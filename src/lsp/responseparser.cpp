@@ -0,0 +1,278 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "responseparser.h"
+#include "utils/json.h"
+
+#include <limits>
+#include <utility>
+
+using json = nlohmann::json;
+
+namespace Lsp {
+
+///////////////////////////////////////////////////////////////////////////////
+// MessageIdHandler
+///////////////////////////////////////////////////////////////////////////////
+// Stops the parsing as soon as the top-level "id" value is found
+class MessageIdHandler : public nlohmann::json_sax<json>
+{
+public:
+    std::optional<MessageId> id;
+
+    bool null() override { return value(); }
+    bool boolean(bool) override { return value(); }
+    bool number_integer(number_integer_t number) override { return idValue(static_cast<int>(number)); }
+    bool number_unsigned(number_unsigned_t number) override { return idValue(static_cast<int>(number)); }
+    bool number_float(number_float_t, const string_t &) override { return value(); }
+    bool string(string_t &text) override { return idValue(text); }
+    bool binary(binary_t &) override { return value(); }
+
+    bool start_object(std::size_t) override { return start(); }
+    bool end_object() override { return end(); }
+    bool start_array(std::size_t) override { return start(); }
+    bool end_array() override { return end(); }
+    bool key(string_t &text) override
+    {
+        m_isIdKey = m_depth == 1 && text == "id";
+        return true;
+    }
+
+    bool parse_error(std::size_t, const std::string &, const nlohmann::detail::exception &) override { return false; }
+
+private:
+    bool value()
+    {
+        m_isIdKey = false;
+        return true;
+    }
+    template <typename T>
+    bool idValue(T &&value)
+    {
+        if (!m_isIdKey)
+            return true;
+        id = std::forward<T>(value);
+        return false;
+    }
+    bool start()
+    {
+        m_isIdKey = false;
+        ++m_depth;
+        return true;
+    }
+    bool end()
+    {
+        --m_depth;
+        return true;
+    }
+
+    int m_depth = 0;
+    bool m_isIdKey = false;
+};
+
+std::optional<MessageId> peekMessageId(QByteArrayView content)
+{
+    MessageIdHandler handler;
+    json::sax_parse(content.begin(), content.end(), &handler);
+    return handler.id;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// LocationsResponseHandler
+///////////////////////////////////////////////////////////////////////////////
+// Fills a LocationsResponse while parsing. Any unexpected value makes the parsing fail, so the caller can fall back to
+// the generic parsing; unknown keys are skipped.
+class LocationsResponseHandler : public nlohmann::json_sax<json>
+{
+public:
+    explicit LocationsResponseHandler(LocationsResponse &response)
+        : m_response(response)
+    {
+    }
+
+    bool null() override
+    {
+        if (skipValue())
+            return true;
+        if (m_contexts.empty())
+            return false;
+        if (current() == Context::Response && m_key == "result") {
+            m_response.result = nullptr;
+            return true;
+        }
+        return false;
+    }
+    bool boolean(bool) override { return skipValue(); }
+    bool number_integer(number_integer_t number) override
+    {
+        if (number < 0)
+            return skipValue();
+        return number_unsigned(static_cast<number_unsigned_t>(number));
+    }
+    bool number_unsigned(number_unsigned_t number) override
+    {
+        if (skipValue())
+            return true;
+        if (m_contexts.empty() || number > std::numeric_limits<unsigned int>::max())
+            return false;
+        switch (current()) {
+        case Context::Response:
+            if (m_key != "id")
+                return false;
+            m_response.id = static_cast<int>(number);
+            return true;
+        case Context::Position:
+            (m_key == "line" ? m_position->line : m_position->character) = static_cast<unsigned int>(number);
+            return true;
+        default:
+            return false;
+        }
+    }
+    bool number_float(number_float_t, const string_t &) override { return skipValue(); }
+    bool string(string_t &text) override
+    {
+        if (skipValue())
+            return true;
+        if (m_contexts.empty())
+            return false;
+        if (current() == Context::Response) {
+            if (m_key == "jsonrpc")
+                m_response.jsonrpc = std::move(text);
+            else if (m_key == "id")
+                m_response.id = std::move(text);
+            else
+                return false;
+            return true;
+        }
+        if (current() == Context::Location && m_key == "uri") {
+            location().uri = std::move(text);
+            return true;
+        }
+        return false;
+    }
+    bool binary(binary_t &) override { return skipValue(); }
+
+    bool start_object(std::size_t) override
+    {
+        if (skipContainer())
+            return true;
+        if (m_contexts.empty()) {
+            m_contexts.push_back(Context::Response);
+            return true;
+        }
+        switch (current()) {
+        case Context::LocationList:
+            std::get<std::vector<Location>>(m_response.result.value()).emplace_back();
+            m_contexts.push_back(Context::Location);
+            return true;
+        case Context::Location:
+            if (m_key != "range")
+                return false;
+            m_contexts.push_back(Context::Range);
+            return true;
+        case Context::Range:
+            m_position = m_key == "start" ? &location().range.start : &location().range.end;
+            m_contexts.push_back(Context::Position);
+            return true;
+        default:
+            return false;
+        }
+    }
+    bool end_object() override { return end(); }
+    bool start_array(std::size_t size) override
+    {
+        if (skipContainer())
+            return true;
+        if (m_contexts.empty() || current() != Context::Response || m_key != "result")
+            return false;
+        std::vector<Location> locations;
+        if (size != std::numeric_limits<std::size_t>::max())
+            locations.reserve(size);
+        m_response.result = std::move(locations);
+        m_contexts.push_back(Context::LocationList);
+        return true;
+    }
+    bool end_array() override { return end(); }
+
+    bool key(string_t &text) override
+    {
+        if (m_skipDepth > 0)
+            return true;
+        // The error data is generic, leave it to the json parsing
+        if (current() == Context::Response && text == "error")
+            return false;
+        m_key = std::move(text);
+        m_skipNext = !isKnownKey();
+        return true;
+    }
+
+    bool parse_error(std::size_t, const std::string &, const nlohmann::detail::exception &) override { return false; }
+
+private:
+    enum class Context { Response, LocationList, Location, Range, Position };
+
+    Context current() const { return m_contexts.back(); }
+    Location &location() { return std::get<std::vector<Location>>(m_response.result.value()).back(); }
+
+    bool isKnownKey() const
+    {
+        switch (current()) {
+        case Context::Response:
+            return m_key == "jsonrpc" || m_key == "id" || m_key == "result";
+        case Context::Location:
+            return m_key == "uri" || m_key == "range";
+        case Context::Range:
+            return m_key == "start" || m_key == "end";
+        case Context::Position:
+            return m_key == "line" || m_key == "character";
+        default:
+            return false;
+        }
+    }
+
+    // Returns true if the current scalar value is skipped
+    bool skipValue()
+    {
+        if (m_skipDepth > 0)
+            return true;
+        return std::exchange(m_skipNext, false);
+    }
+    // Returns true if the object or array starting is skipped
+    bool skipContainer()
+    {
+        if (m_skipDepth == 0 && !std::exchange(m_skipNext, false))
+            return false;
+        ++m_skipDepth;
+        return true;
+    }
+    bool end()
+    {
+        if (m_skipDepth > 0)
+            --m_skipDepth;
+        else
+            m_contexts.pop_back();
+        return true;
+    }
+
+    LocationsResponse &m_response;
+    std::vector<Context> m_contexts;
+    std::string m_key;
+    Position *m_position = nullptr;
+    bool m_skipNext = false;
+    int m_skipDepth = 0;
+};
+
+bool parseLocationsResponse(QByteArrayView content, LocationsResponse &response)
+{
+    LocationsResponseHandler handler(response);
+    return json::sax_parse(content.begin(), content.end(), &handler) && response.isValid();
+}
+
+}
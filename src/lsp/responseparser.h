@@ -0,0 +1,38 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include "requestmessage.h"
+#include "types.h"
+
+#include <QByteArrayView>
+#include <optional>
+#include <vector>
+
+namespace Lsp {
+
+// Streaming parsers for the responses that can be big, like the list of references of a symbol.
+//
+// They deserialize the content of a message directly into the Lsp structs, using a SAX parser, instead of building
+// a json object first and converting it afterward.
+
+using LocationsResult = std::variant<std::vector<Location>, std::nullptr_t>;
+using LocationsResponse = ResponseMessage<LocationsResult, std::nullptr_t>;
+
+// Returns the id of the message, without parsing the rest of the content if the id comes first.
+std::optional<MessageId> peekMessageId(QByteArrayView content);
+
+// Parses a response whose result is a list of locations, or null.
+// Returns false if the content can't be parsed that way (for example for an error response), in which case the
+// generic json parsing should be used instead.
+bool parseLocationsResponse(QByteArrayView content, LocationsResponse &response);
+
+}
@@ -12,101 +12,176 @@
 #include "utils/log.h"
 
 #include <QDir>
-#include <QHash>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <string_view>
 
 namespace RcCore {
 
-#define COMMA ,
+struct KeywordEntry
+{
+    std::u16string_view name;
+    Keywords keyword;
+};
+
 // clang-format off
-Q_GLOBAL_STATIC_WITH_ARGS(QHash<QString COMMA Keywords>, KeywordMap, {
+static constexpr KeywordEntry KeywordList[] = {
     // Used in MENUITEM - not handled in Qt
-    {"ACCELERATORS" COMMA Keywords::ACCELERATORS} COMMA
-    {"AFX_DIALOG_LAYOUT" COMMA Keywords::AFX_DIALOG_LAYOUT} COMMA
-    {"BITMAP" COMMA Keywords::BITMAP} COMMA
-    {"CURSOR" COMMA Keywords::CURSOR} COMMA
-    {"DESIGNINFO" COMMA Keywords::DESIGNINFO} COMMA
-    {"DIALOG" COMMA Keywords::DIALOG} COMMA
-    {"DIALOGEX" COMMA Keywords::DIALOGEX} COMMA
-    {"DLGINIT" COMMA Keywords::DLGINIT} COMMA
-    {"FONT" COMMA Keywords::FONT} COMMA
-    {"HTML" COMMA Keywords::HTML} COMMA
-    {"ICON" COMMA Keywords::ICON} COMMA
-    {"IMAGE" COMMA Keywords::IMAGE} COMMA
-    {"MENU" COMMA Keywords::MENU} COMMA
-    {"MENUEX" COMMA Keywords::MENUEX} COMMA
-    {"MESSAGETABLE" COMMA Keywords::MESSAGETABLE} COMMA
-    {"PNG" COMMA Keywords::PNG} COMMA
-    {"POPUP" COMMA Keywords::POPUP} COMMA
-    {"RCDATA" COMMA Keywords::RCDATA} COMMA
-    {"REGISTRY" COMMA Keywords::REGISTRY} COMMA
-    {"STRINGTABLE" COMMA Keywords::STRINGTABLE} COMMA
-    {"TEXTINCLUDE" COMMA Keywords::TEXTINCLUDE} COMMA
-    {"TOOLBAR" COMMA Keywords::TOOLBAR} COMMA
-    {"VERSIONINFO" COMMA Keywords::VERSIONINFO} COMMA
-    {"RT_RIBBON_XML" COMMA Keywords::RT_RIBBON_XML} COMMA
-    {"PRELOAD" COMMA Keywords::IGNORE_16BITS} COMMA
-    {"LOADONCALL" COMMA Keywords::IGNORE_16BITS} COMMA
-    {"FIXED" COMMA Keywords::IGNORE_16BITS} COMMA
-    {"MOVEABLE" COMMA Keywords::IGNORE_16BITS} COMMA
-    {"DISCARDABLE" COMMA Keywords::IGNORE_16BITS} COMMA
-    {"PURE" COMMA Keywords::IGNORE_16BITS} COMMA
-    {"IMPURE" COMMA Keywords::IGNORE_16BITS} COMMA
-    {"SHARED" COMMA Keywords::IGNORE_16BITS} COMMA
-    {"NONSHARED" COMMA Keywords::IGNORE_16BITS} COMMA
-    {"BEGIN" COMMA Keywords::BEGIN} COMMA
-    {"END" COMMA Keywords::END} COMMA
-    {"SEPARATOR" COMMA Keywords::SEPARATOR} COMMA
-    {"MFT_SEPARATOR" COMMA Keywords::SEPARATOR} COMMA
-    {"BUTTON" COMMA Keywords::BUTTON} COMMA
-    {"NOT" COMMA Keywords::NOT} COMMA
-    {"CHECKED" COMMA Keywords::CHECKED} COMMA
-    {"MFS_CHECKED" COMMA Keywords::CHECKED} COMMA
-    {"GRAYED" COMMA Keywords::GRAYED} COMMA
-    {"MFS_GRAYED" COMMA Keywords::GRAYED} COMMA
-    {"MFS_DISABLED" COMMA Keywords::INACTIVE} COMMA
-    {"HELP" COMMA Keywords::HELP} COMMA
-    {"INACTIVE" COMMA Keywords::INACTIVE} COMMA
-    {"MENUBARBREAK" COMMA Keywords::MENUBARBREAK} COMMA
-    {"MFT_MENUBARBREAK" COMMA Keywords::MENUBARBREAK} COMMA
-    {"MENUBREAK" COMMA Keywords::MENUBREAK} COMMA
-    {"MFT_MENUBREAK" COMMA Keywords::MENUBREAK} COMMA
-    {"MFT_STRING" COMMA Keywords::MFTSTRING} COMMA
-    {"MFS_ENABLED" COMMA Keywords::MFSENABLED} COMMA
-    {"MFT_RIGHTJUSTIFY" COMMA Keywords::MFTRIGHTJUSTIFY} COMMA
-    {"ALT" COMMA Keywords::ALT} COMMA
-    {"ASCII" COMMA Keywords::ASCII} COMMA
-    {"NOINVERT" COMMA Keywords::NOINVERT} COMMA
-    {"SHIFT" COMMA Keywords::SHIFT} COMMA
-    {"VIRTKEY" COMMA Keywords::VIRTKEY} COMMA
-    {"CAPTION" COMMA Keywords::CAPTION} COMMA
-    {"CHARACTERISTICS" COMMA Keywords::CHARACTERISTICS} COMMA
-    {"CLASS" COMMA Keywords::CLASS} COMMA
-    {"EXSTYLE" COMMA Keywords::EXSTYLE} COMMA
-    {"LANGUAGE" COMMA Keywords::LANGUAGE} COMMA
-    {"MENUITEM" COMMA Keywords::MENUITEM} COMMA
-    {"STYLE" COMMA Keywords::STYLE} COMMA
-    {"VERSION" COMMA Keywords::VERSION} COMMA
-    {"AUTO3STATE" COMMA Keywords::AUTO3STATE} COMMA
-    {"AUTOCHECKBOX" COMMA Keywords::AUTOCHECKBOX} COMMA
-    {"AUTORADIOBUTTON" COMMA Keywords::AUTORADIOBUTTON} COMMA
-    {"CHECKBOX" COMMA Keywords::CHECKBOX} COMMA
-    {"COMBOBOX" COMMA Keywords::COMBOBOX} COMMA
-    {"CONTROL" COMMA Keywords::CONTROL} COMMA
-    {"CTEXT" COMMA Keywords::CTEXT} COMMA
-    {"DEFPUSHBUTTON" COMMA Keywords::DEFPUSHBUTTON} COMMA
-    {"EDITTEXT" COMMA Keywords::EDITTEXT} COMMA
-    {"GROUPBOX" COMMA Keywords::GROUPBOX} COMMA
-    {"LISTBOX" COMMA Keywords::LISTBOX} COMMA
-    {"LTEXT" COMMA Keywords::LTEXT} COMMA
-    {"PUSHBOX" COMMA Keywords::PUSHBOX} COMMA
-    {"PUSHBUTTON" COMMA Keywords::PUSHBUTTON} COMMA
-    {"RADIOBUTTON" COMMA Keywords::RADIOBUTTON} COMMA
-    {"RTEXT" COMMA Keywords::RTEXT} COMMA
-    {"SCROLLBAR" COMMA Keywords::SCROLLBAR} COMMA
-    {"STATE3" COMMA Keywords::STATE3} COMMA
-});
+    {u"ACCELERATORS", Keywords::ACCELERATORS},
+    {u"AFX_DIALOG_LAYOUT", Keywords::AFX_DIALOG_LAYOUT},
+    {u"BITMAP", Keywords::BITMAP},
+    {u"CURSOR", Keywords::CURSOR},
+    {u"DESIGNINFO", Keywords::DESIGNINFO},
+    {u"DIALOG", Keywords::DIALOG},
+    {u"DIALOGEX", Keywords::DIALOGEX},
+    {u"DLGINIT", Keywords::DLGINIT},
+    {u"FONT", Keywords::FONT},
+    {u"HTML", Keywords::HTML},
+    {u"ICON", Keywords::ICON},
+    {u"IMAGE", Keywords::IMAGE},
+    {u"MENU", Keywords::MENU},
+    {u"MENUEX", Keywords::MENUEX},
+    {u"MESSAGETABLE", Keywords::MESSAGETABLE},
+    {u"PNG", Keywords::PNG},
+    {u"POPUP", Keywords::POPUP},
+    {u"RCDATA", Keywords::RCDATA},
+    {u"REGISTRY", Keywords::REGISTRY},
+    {u"STRINGTABLE", Keywords::STRINGTABLE},
+    {u"TEXTINCLUDE", Keywords::TEXTINCLUDE},
+    {u"TOOLBAR", Keywords::TOOLBAR},
+    {u"VERSIONINFO", Keywords::VERSIONINFO},
+    {u"RT_RIBBON_XML", Keywords::RT_RIBBON_XML},
+    {u"PRELOAD", Keywords::IGNORE_16BITS},
+    {u"LOADONCALL", Keywords::IGNORE_16BITS},
+    {u"FIXED", Keywords::IGNORE_16BITS},
+    {u"MOVEABLE", Keywords::IGNORE_16BITS},
+    {u"DISCARDABLE", Keywords::IGNORE_16BITS},
+    {u"PURE", Keywords::IGNORE_16BITS},
+    {u"IMPURE", Keywords::IGNORE_16BITS},
+    {u"SHARED", Keywords::IGNORE_16BITS},
+    {u"NONSHARED", Keywords::IGNORE_16BITS},
+    {u"BEGIN", Keywords::BEGIN},
+    {u"END", Keywords::END},
+    {u"SEPARATOR", Keywords::SEPARATOR},
+    {u"MFT_SEPARATOR", Keywords::SEPARATOR},
+    {u"BUTTON", Keywords::BUTTON},
+    {u"NOT", Keywords::NOT},
+    {u"CHECKED", Keywords::CHECKED},
+    {u"MFS_CHECKED", Keywords::CHECKED},
+    {u"GRAYED", Keywords::GRAYED},
+    {u"MFS_GRAYED", Keywords::GRAYED},
+    {u"MFS_DISABLED", Keywords::INACTIVE},
+    {u"HELP", Keywords::HELP},
+    {u"INACTIVE", Keywords::INACTIVE},
+    {u"MENUBARBREAK", Keywords::MENUBARBREAK},
+    {u"MFT_MENUBARBREAK", Keywords::MENUBARBREAK},
+    {u"MENUBREAK", Keywords::MENUBREAK},
+    {u"MFT_MENUBREAK", Keywords::MENUBREAK},
+    {u"MFT_STRING", Keywords::MFTSTRING},
+    {u"MFS_ENABLED", Keywords::MFSENABLED},
+    {u"MFT_RIGHTJUSTIFY", Keywords::MFTRIGHTJUSTIFY},
+    {u"ALT", Keywords::ALT},
+    {u"ASCII", Keywords::ASCII},
+    {u"NOINVERT", Keywords::NOINVERT},
+    {u"SHIFT", Keywords::SHIFT},
+    {u"VIRTKEY", Keywords::VIRTKEY},
+    {u"CAPTION", Keywords::CAPTION},
+    {u"CHARACTERISTICS", Keywords::CHARACTERISTICS},
+    {u"CLASS", Keywords::CLASS},
+    {u"EXSTYLE", Keywords::EXSTYLE},
+    {u"LANGUAGE", Keywords::LANGUAGE},
+    {u"MENUITEM", Keywords::MENUITEM},
+    {u"STYLE", Keywords::STYLE},
+    {u"VERSION", Keywords::VERSION},
+    {u"AUTO3STATE", Keywords::AUTO3STATE},
+    {u"AUTOCHECKBOX", Keywords::AUTOCHECKBOX},
+    {u"AUTORADIOBUTTON", Keywords::AUTORADIOBUTTON},
+    {u"CHECKBOX", Keywords::CHECKBOX},
+    {u"COMBOBOX", Keywords::COMBOBOX},
+    {u"CONTROL", Keywords::CONTROL},
+    {u"CTEXT", Keywords::CTEXT},
+    {u"DEFPUSHBUTTON", Keywords::DEFPUSHBUTTON},
+    {u"EDITTEXT", Keywords::EDITTEXT},
+    {u"GROUPBOX", Keywords::GROUPBOX},
+    {u"LISTBOX", Keywords::LISTBOX},
+    {u"LTEXT", Keywords::LTEXT},
+    {u"PUSHBOX", Keywords::PUSHBOX},
+    {u"PUSHBUTTON", Keywords::PUSHBUTTON},
+    {u"RADIOBUTTON", Keywords::RADIOBUTTON},
+    {u"RTEXT", Keywords::RTEXT},
+    {u"SCROLLBAR", Keywords::SCROLLBAR},
+    {u"STATE3", Keywords::STATE3},
+};
 // clang-format on
 
+// Keywords are classified using a perfect hash table, computed at compile time: the seed of the hash is chosen so that
+// there are no collisions, a lookup is then a single hash and string comparison.
+static constexpr std::size_t KeywordTableSize = 1024;
+
+static constexpr uint32_t keywordHash(const char16_t *data, std::size_t size, uint32_t seed)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u ^ seed;
+    for (std::size_t i = 0; i < size; ++i)
+        hash = (hash ^ data[i]) * 16777619u;
+    return hash % KeywordTableSize;
+}
+
+static constexpr bool isPerfectSeed(uint32_t seed)
+{
+    std::array<bool, KeywordTableSize> used {};
+    for (const auto &entry : KeywordList) {
+        const auto index = keywordHash(entry.name.data(), entry.name.size(), seed);
+        if (used[index])
+            return false;
+        used[index] = true;
+    }
+    return true;
+}
+
+static constexpr uint32_t findPerfectSeed()
+{
+    uint32_t seed = 0;
+    while (!isPerfectSeed(seed))
+        ++seed;
+    return seed;
+}
+
+static constexpr uint32_t KeywordSeed = findPerfectSeed();
+
+static constexpr auto KeywordTable = [] {
+    static_assert(std::size(KeywordList) < std::numeric_limits<int8_t>::max());
+    std::array<int8_t, KeywordTableSize> table {};
+    table.fill(-1);
+    for (std::size_t i = 0; i < std::size(KeywordList); ++i) {
+        const auto &name = KeywordList[i].name;
+        table[keywordHash(name.data(), name.size(), KeywordSeed)] = static_cast<int8_t>(i);
+    }
+    return table;
+}();
+
+static std::optional<Keywords> findKeyword(QStringView word)
+{
+    const auto index = KeywordTable[keywordHash(word.utf16(), word.size(), KeywordSeed)];
+    if (index == -1)
+        return {};
+    const auto &entry = KeywordList[index];
+    if (word != QStringView(entry.name.data(), entry.name.size()))
+        return {};
+    return entry.keyword;
+}
+
+static QString keywordName(Keywords keyword)
+{
+    // Some keywords have multiple spellings, the first one is the canonical one
+    for (const auto &entry : KeywordList) {
+        if (entry.keyword == keyword)
+            return QString::fromUtf16(entry.name.data(), entry.name.size());
+    }
+    return {};
+}
+
 //=============================================================================
 // Parser::Token
 //=============================================================================
@@ -115,7 +190,7 @@ QString Token::toString() const
 {
     if (data.index() == 1)
         return std::get<QString>(data);
-    return KeywordMap->key(std::get<Keywords>(data));
+    return keywordName(std::get<Keywords>(data));
 }
 
 QString Token::prettyPrint() const
@@ -132,7 +207,7 @@ QString Token::prettyPrint() const
     case Token::Integer:
         return QString::number(toInt());
     case Token::Keyword:
-        return KeywordMap->key(toKeyword());
+        return keywordName(toKeyword());
     case Token::Word:
         return toString();
     }
@@ -179,12 +254,12 @@ void Lexer::skipScope()
         skipSpace();
         const QChar &ch = m_stream.peek();
         if (ch == 'B' || ch == 'E') {
-            const QString word = readWhile([](const auto &c) {
+            const QStringView word = readWhile([](const auto &c) {
                 return c.isLetter();
             });
-            if (word == "BEGIN")
+            if (word == u"BEGIN")
                 ++scope;
-            else if (word == "END")
+            else if (word == u"END")
                 --scope;
         }
         skipLine();
@@ -202,10 +277,10 @@ void Lexer::skipToBegin()
         skipSpace();
         const QChar &ch = m_stream.peek();
         if (ch == 'B') {
-            const QString word = readWhile([](const auto &c) {
+            const QStringView word = readWhile([](const auto &c) {
                 return c.isLetter();
             });
-            if (word == "BEGIN")
+            if (word == u"BEGIN")
                 return;
         }
         skipLine();
@@ -215,14 +290,15 @@ void Lexer::skipToBegin()
 
 std::optional<Token> Lexer::next()
 {
-    auto token = m_current;
+    if (!m_current.has_value())
+        return readNext();
+    // Move the lookahead token out instead of copying it
+    std::optional<Token> token = std::move(m_current);
     m_current.reset();
-    if (!token.has_value())
-        token = readNext();
     return token;
 }
 
-std::optional<Token> Lexer::peek()
+const std::optional<Token> &Lexer::peek()
 {
     if (!m_current.has_value())
         m_current = readNext();
@@ -231,7 +307,11 @@ std::optional<Token> Lexer::peek()
 
 QList<QString> Lexer::keywords()
 {
-    return KeywordMap->keys();
+    QList<QString> result;
+    result.reserve(std::size(KeywordList));
+    for (const auto &entry : KeywordList)
+        result.push_back(QString::fromUtf16(entry.name.data(), entry.name.size()));
+    return result;
 }
 
 std::optional<Token> Lexer::readNext()
@@ -275,7 +355,7 @@ Token Lexer::readDirective()
     m_stream.next(); // Read the first '#'
     return {Token::Directive, readWhile([](const auto &c) {
                 return c.isLetter();
-            })};
+            }).toString()};
 }
 
 Token Lexer::readString()
@@ -326,29 +406,29 @@ Token Lexer::readInclude()
 
 Token Lexer::readNumber()
 {
-    QString text = m_stream.next();
-    if (text[0] == '0' && m_stream.peek() == 'x') {
-        text += m_stream.next();
-        text += readWhile([](const auto &c) {
+    const int start = m_stream.pos();
+    if (m_stream.next() == '0' && m_stream.peek() == 'x') {
+        m_stream.next();
+        skipWhile([](const auto &c) {
             return c.isLetterOrNumber();
         });
-        return {Token::Word, text};
+        return {Token::Word, m_stream.view(start).toString()};
     }
 
-    text += readWhile([](const auto &c) {
+    skipWhile([](const auto &c) {
         return c.isNumber();
     });
-    return {Token::Integer, text.toInt()};
+    return {Token::Integer, m_stream.view(start).toInt()};
 }
 
 Token Lexer::readWord()
 {
-    const QString word = readWhile([](const auto &c) {
+    const QStringView word = readWhile([](const auto &c) {
         return c.isLetterOrNumber() || c == '_';
     });
-    if (auto it = KeywordMap->find(word); it != KeywordMap->end())
-        return {Token::Keyword, it.value()};
-    return {Token::Word, word};
+    if (auto keyword = findKeyword(word))
+        return {Token::Keyword, *keyword};
+    return {Token::Word, m_stringPool ? m_stringPool->intern(word) : word.toString()};
 }
 
 } // namespace RcCore
@@ -11,6 +11,7 @@
 #pragma once
 
 #include "stream.h"
+#include "utils/stringpool.h"
 
 #include <QString>
 #include <QVariant>
@@ -151,8 +152,12 @@ public:
     void setFileName(const QString &name) { m_fileName = name; }
     QString fileName() const { return m_fileName; }
 
+    // If set, the words are interned in the pool
+    void setStringPool(Utils::StringPool *pool) { m_stringPool = pool; }
+
     std::optional<Token> next();
-    std::optional<Token> peek();
+    // The lookahead token is returned by reference, it's valid until the next call changing the position
+    const std::optional<Token> &peek();
 
     static QList<QString> keywords();
 
@@ -165,13 +170,13 @@ private:
         while (!m_stream.atEnd() && std::invoke(func, m_stream.peek()))
             m_stream.next();
     }
+    // Returns a view on the stream content, valid as long as the lexer is alive
     template <typename Func>
-    QString readWhile(Func func)
+    QStringView readWhile(Func func)
     {
-        QString result;
-        while (!m_stream.atEnd() && std::invoke(func, m_stream.peek()))
-            result += m_stream.next();
-        return result;
+        const int start = m_stream.pos();
+        skipWhile(func);
+        return m_stream.view(start);
     }
 
     Token readDirective();
@@ -184,6 +189,7 @@ private:
     Stream m_stream;
     std::optional<Token> m_current;
     QString m_fileName;
+    Utils::StringPool *m_stringPool = nullptr;
 };
 
 } // namespace RcCore
@@ -17,6 +17,8 @@
 #include <QImage>
 #include <algorithm>
 #include <cmath>
+#include <limits>
+#include <vector>
 
 using namespace Qt::Literals::StringLiterals;
 
@@ -641,6 +643,12 @@ static Widget convertChildWidget(const Data &data, const QString &dialogId, Data
     return widget;
 }
 
+// Extent of a rectangle on one axis, normalized like QRect::contains does
+static std::pair<int, int> rectSpan(int start, int end)
+{
+    return end < start - 1 ? std::pair(end + 1, start - 1) : std::pair(start, end);
+}
+
 static QVector<Widget> adjustHierarchy(QVector<Widget> widgets)
 {
     if (widgets.isEmpty())
@@ -653,26 +661,61 @@ static QVector<Widget> adjustHierarchy(QVector<Widget> widgets)
     };
     std::ranges::stable_sort(widgets, sortByArea);
 
+    // The parent of a widget is the next one in the sorted list containing it. Instead of checking all of them, the
+    // candidates are found with a uniform grid: a widget containing another one has the top-left corner of the other
+    // one in its extent, so it's in the grid cell of this corner.
+    const auto count = widgets.size();
+    int left = std::numeric_limits<int>::max();
+    int top = std::numeric_limits<int>::max();
+    int right = std::numeric_limits<int>::min();
+    int bottom = std::numeric_limits<int>::min();
+    for (const auto &widget : std::as_const(widgets)) {
+        const auto [x1, x2] = rectSpan(widget.geometry.left(), widget.geometry.right());
+        const auto [y1, y2] = rectSpan(widget.geometry.top(), widget.geometry.bottom());
+        left = std::min(left, x1);
+        top = std::min(top, y1);
+        right = std::max(right, x2 + 1);
+        bottom = std::max(bottom, y2 + 1);
+    }
+    const int gridSize = std::max(1, static_cast<int>(std::sqrt(static_cast<double>(count))));
+    const int cellWidth = std::max(1, (right - left) / gridSize + 1);
+    const int cellHeight = std::max(1, (bottom - top) / gridSize + 1);
+    auto column = [&](int x) {
+        return std::clamp((x - left) / cellWidth, 0, gridSize - 1);
+    };
+    auto row = [&](int y) {
+        return std::clamp((y - top) / cellHeight, 0, gridSize - 1);
+    };
+    std::vector<std::vector<qsizetype>> cells(gridSize * gridSize);
+
+    // Widgets are added to the grid from the largest, so the grid only has the candidates for the current widget
+    std::vector<qsizetype> parents(count, -1);
+    for (auto i = count - 1; i >= 0; --i) {
+        const QRect &geometry = widgets.at(i).geometry;
+        const auto [x1, x2] = rectSpan(geometry.left(), geometry.right());
+        const auto [y1, y2] = rectSpan(geometry.top(), geometry.bottom());
+
+        for (const auto candidate : cells[row(y1) * gridSize + column(x1)]) {
+            if ((parents[i] == -1 || candidate < parents[i]) && widgets.at(candidate).geometry.contains(geometry))
+                parents[i] = candidate;
+        }
+
+        for (int r = row(y1); r <= row(y2 + 1); ++r) {
+            for (int c = column(x1); c <= column(x2 + 1); ++c)
+                cells[r * gridSize + c].push_back(i);
+        }
+    }
+
+    // Children are moved in the sorted order, before their parent is moved
     QVector<Widget> result;
-    for (int i = 0; i < widgets.size(); ++i) {
-        bool isChildren = false;
-        Widget iWidget = std::move(widgets[i]);
-        QRect geomi = widgets.at(i).geometry;
-
-        // Check if the widget is inside another one
-        for (int j = i + 1; j < widgets.size(); ++j) {
-            const QRect geomj = widgets.at(j).geometry;
-            if (geomj.contains(geomi)) {
-                geomi.moveLeft(geomi.x() - geomj.x());
-                geomi.moveTop(geomi.y() - geomj.y());
-                iWidget.geometry = geomi;
-                widgets[j].children.push_back(std::move(iWidget));
-                isChildren = true;
-                break;
-            }
+    for (qsizetype i = 0; i < count; ++i) {
+        const auto parent = parents[i];
+        if (parent == -1) {
+            result.push_back(std::move(widgets[i]));
+            continue;
         }
-        if (!isChildren)
-            result.push_back(std::move(iWidget));
+        widgets[i].geometry.translate(-widgets.at(parent).geometry.topLeft());
+        widgets[parent].children.push_back(std::move(widgets[i]));
     }
 
     return result;
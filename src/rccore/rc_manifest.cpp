@@ -0,0 +1,186 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "rcfile.h"
+#include "utils/log.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <algorithm>
+
+namespace RcCore {
+
+//=============================================================================
+// Fingerprints
+//=============================================================================
+// Each value is followed by a separator, so two different lists of values can't have the same data
+static void addValue(QCryptographicHash &hash, const QString &value)
+{
+    hash.addData(value.toUtf8());
+    hash.addData(QByteArrayView("\0", 1));
+}
+
+static void addValue(QCryptographicHash &hash, qint64 value)
+{
+    addValue(hash, QString::number(value));
+}
+
+static void addValue(QCryptographicHash &hash, const QStringList &values)
+{
+    addValue(hash, values.size());
+    for (const auto &value : values)
+        addValue(hash, value);
+}
+
+static void addValue(QCryptographicHash &hash, const QRect &rect)
+{
+    addValue(hash, rect.x());
+    addValue(hash, rect.y());
+    addValue(hash, rect.width());
+    addValue(hash, rect.height());
+}
+
+QByteArray dialogFingerprint(const Data &data, const Data::Dialog &dialog, Widget::ConversionFlags flags,
+                             double scaleX, double scaleY, const QString &format)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    addValue(hash, format);
+    addValue(hash, flags.toInt());
+    addValue(hash, QString::number(scaleX, 'g', 17));
+    addValue(hash, QString::number(scaleY, 'g', 17));
+
+    // The line numbers are not used, they are only in the logs
+    addValue(hash, dialog.id);
+    addValue(hash, dialog.geometry);
+    addValue(hash, dialog.caption);
+    addValue(hash, dialog.menu);
+    addValue(hash, dialog.styles);
+    addValue(hash, dialog.controls.size());
+    for (const auto &control : dialog.controls) {
+        addValue(hash, control.type);
+        addValue(hash, control.text);
+        addValue(hash, control.id);
+        addValue(hash, control.className);
+        addValue(hash, control.geometry);
+        addValue(hash, control.styles);
+        // Pixmaps use the file name of the asset
+        if (!(flags & Widget::UseIdForPixmap)) {
+            if (const auto asset = data.asset(control.text))
+                addValue(hash, asset->fileName);
+        }
+    }
+
+    // Values of the comboboxes
+    if (const auto dialogData = data.dialogData(dialog.id)) {
+        auto ids = dialogData->values.keys();
+        std::ranges::sort(ids);
+        for (const auto &id : std::as_const(ids)) {
+            addValue(hash, id);
+            addValue(hash, dialogData->values.value(id));
+        }
+    }
+    return hash.result().toHex();
+}
+
+QByteArray assetFingerprint(const Asset &asset, Asset::TransparentColors colors)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    addValue(hash, colors.toInt());
+    addValue(hash, asset.fileName);
+    addValue(hash, asset.iconRect);
+
+    // The original image is not read, it's too slow for large toolbars: its size and date are good enough
+    const QFileInfo original(asset.originalFileName);
+    addValue(hash, asset.originalFileName);
+    addValue(hash, original.size());
+    addValue(hash, original.lastModified().toMSecsSinceEpoch());
+    return hash.result().toHex();
+}
+
+//=============================================================================
+// OutputManifest
+//=============================================================================
+OutputManifest::OutputManifest(const QString &fileName, const QString &version)
+    : m_fileName(fileName)
+    , m_version(version)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+
+    const auto json = QJsonDocument::fromJson(file.readAll()).object();
+    if (json.value("version").toString() != version)
+        return;
+    const auto outputs = json.value("outputs").toObject();
+    for (auto it = outputs.constBegin(); it != outputs.constEnd(); ++it) {
+        const auto entry = it.value().toObject();
+        m_entries.insert(it.key(),
+                         {entry.value("fingerprint").toString().toLatin1(),
+                          static_cast<qint64>(entry.value("modified").toDouble())});
+    }
+}
+
+bool OutputManifest::isUpToDate(const QString &output, const QByteArray &fingerprint) const
+{
+    Entry entry;
+    {
+        QMutexLocker locker(&m_mutex);
+        const auto it = m_entries.constFind(key(output));
+        if (it == m_entries.cend() || it->fingerprint != fingerprint)
+            return false;
+        entry = it.value();
+    }
+    const QFileInfo fi(output);
+    return fi.exists() && fi.lastModified().toMSecsSinceEpoch() == entry.modified;
+}
+
+void OutputManifest::update(const QString &output, const QByteArray &fingerprint)
+{
+    const qint64 modified = QFileInfo(output).lastModified().toMSecsSinceEpoch();
+    QMutexLocker locker(&m_mutex);
+    m_entries.insert(key(output), {fingerprint, modified});
+    m_changed = true;
+}
+
+bool OutputManifest::save() const
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_changed)
+        return true;
+
+    QJsonObject outputs;
+    for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it) {
+        outputs.insert(it.key(),
+                       QJsonObject {{"fingerprint", QString::fromLatin1(it->fingerprint)},
+                                    {"modified", static_cast<double>(it->modified)}});
+    }
+    const QJsonObject json {{"version", m_version}, {"outputs", outputs}};
+
+    QFile file(m_fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        spdlog::error("OutputManifest::save: unable to write {}", m_fileName);
+        return false;
+    }
+    file.write(QJsonDocument(json).toJson());
+    return true;
+}
+
+// Outputs are saved relative to the manifest, so the directory can be moved
+QString OutputManifest::key(const QString &output) const
+{
+    return QFileInfo(m_fileName).absoluteDir().relativeFilePath(QFileInfo(output).absoluteFilePath());
+}
+
+} // namespace RcCore
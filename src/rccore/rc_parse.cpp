@@ -12,13 +12,20 @@
 #include "rcfile.h"
 #include "stream.h"
 #include "utils/log.h"
+#include "utils/stringpool.h"
+#include "utils/tracing.h"
 
+#include <QDateTime>
 #include <QElapsedTimer>
 #include <QFile>
 #include <QFileInfo>
 #include <QHash>
 #include <QKeySequence>
+#include <QMutex>
+#include <QMutexLocker>
 #include <QTextStream>
+#include <QtConcurrent/QtConcurrentMap>
+#include <algorithm>
 #include <kdalgorithms.h>
 
 namespace RcCore {
@@ -62,7 +69,7 @@ static std::optional<QString> computeFilePath(const QString &absolutePath, const
     return {};
 }
 
-static QHash<int, QString> loadResourceFile(const QString &resourceFile)
+static QHash<int, QString> readResourceFile(const QString &resourceFile)
 {
     QFile file(resourceFile);
     if (!file.open(QIODevice::ReadOnly))
@@ -84,8 +91,41 @@ static QHash<int, QString> loadResourceFile(const QString &resourceFile)
         if (!ok)
             continue;
 
-        resourceMap[key] = value;
+        // The macros are the ids used in the RC files, which are interned by the lexer
+        resourceMap[key] = Utils::intern(value);
+    }
+    return resourceMap;
+}
+
+// The same resource header is usually included by many RC files, so the resource maps are cached for the whole
+// process, keyed by the canonical path. The cache is invalidated if the file is modified.
+// QHash is implicitly shared, returning the cached map doesn't copy it.
+static QHash<int, QString> loadResourceFile(const QString &resourceFile)
+{
+    struct CachedResourceMap
+    {
+        QDateTime lastModified;
+        QHash<int, QString> resourceMap;
+    };
+    static QMutex mutex;
+    static QHash<QString, CachedResourceMap> cache;
+
+    const QFileInfo fi(resourceFile);
+    const QString path = fi.canonicalFilePath();
+    if (path.isEmpty())
+        return {};
+    const QDateTime lastModified = fi.lastModified();
+    {
+        QMutexLocker locker(&mutex);
+        if (auto it = cache.constFind(path); it != cache.cend() && it->lastModified == lastModified)
+            return it->resourceMap;
     }
+
+    // Don't hold the lock while parsing, worst case the same file is parsed twice in different threads
+    auto resourceMap = readResourceFile(path);
+
+    QMutexLocker locker(&mutex);
+    cache.insert(path, {lastModified, resourceMap});
     return resourceMap;
 }
 
@@ -126,7 +166,7 @@ static void readDialogStatements(Context &context, Data::Dialog &dialog)
 {
     LEXER_FROM_CONTEXT;
 
-    while (const auto peekToken = lexer.peek()) {
+    while (const auto &peekToken = lexer.peek()) {
         // There could be some #if/#else/#end here
         // Just skip them, as they don't add much values
         if (peekToken->type == Token::Directive) {
@@ -1288,7 +1328,7 @@ static void readDialog(Context &context, const QString &id)
 static void skipResourceAttributes(Lexer &lexer)
 {
     // Ignore any resource attributes, only used in 16-bits Windows
-    const auto next = lexer.peek();
+    const auto &next = lexer.peek();
     if (next.has_value() && next->type == Token::Keyword && next->toKeyword() == Keywords::IGNORE_16BITS)
         lexer.next();
 }
@@ -1395,22 +1435,9 @@ static void readDirective(Context &context, const QString &directive)
 //=============================================================================
 // RcFileUtils::parse
 //=============================================================================
-RcFile parse(const QString &fileName)
+static bool parseSection(Context &context)
 {
-    QElapsedTimer time;
-    time.start();
-    QFile file(fileName);
-    if (!file.open(QIODevice::ReadOnly))
-        return {};
-
-    RcFile rcFile;
-    rcFile.fileName = fileName;
-
-    Lexer lexer(Stream {&file});
-    lexer.setFileName(fileName);
-    rcFile.content = lexer.content();
-
-    Context context = {.rcFile = rcFile, .lexer = lexer};
+    LEXER_FROM_CONTEXT;
 
     try {
         std::optional<Token> previousToken;
@@ -1444,11 +1471,309 @@ RcFile parse(const QString &fileName)
         }
     } catch (...) {
         spdlog::critical("{}({}): parser general error", context.fileName(), context.line());
+        return false;
+    }
+    return true;
+}
+
+// Returns the keyword at the start of a trimmed line, if any
+static QStringView firstWord(QStringView text)
+{
+    const auto wordEnd = std::find_if_not(text.begin(), text.end(), [](QChar c) {
+        return c.isLetter() || c == '_';
+    });
+    return text.first(std::distance(text.begin(), wordEnd));
+}
+
+// Split the content at the top-level LANGUAGE statements: each section can then be parsed independently.
+// A LANGUAGE statement is only considered top-level if it follows the END of a resource, as it could also be an
+// optional statement of a resource (like a dialog).
+static QList<RcFile::Section> splitLanguageSections(const QString &content)
+{
+    QList<RcFile::Section> sections(1);
+    int depth = 0;
+    int line = 1;
+    bool afterEnd = true;
+    qsizetype pos = 0;
+    while (pos < content.size()) {
+        qsizetype end = content.indexOf('\n', pos);
+        if (end == -1)
+            end = content.size();
+
+        const QStringView text = QStringView(content).sliced(pos, end - pos).trimmed();
+        if (!text.isEmpty() && text.front() != '/' && text.front() != '#') {
+            const QStringView word = firstWord(text);
+            if (word == u"BEGIN") {
+                ++depth;
+            } else if (word == u"END") {
+                --depth;
+            } else if (word == u"LANGUAGE" && depth == 0 && afterEnd && pos != 0) {
+                sections.back().end = pos;
+                sections.push_back({.start = pos, .line = line});
+            }
+            afterEnd = depth == 0 && word == u"END";
+        }
+        pos = end + 1;
+        ++line;
+    }
+    sections.back().end = content.size();
+    return sections;
+}
+
+static void mergeSection(RcFile &rcFile, const RcFile &section)
+{
+    rcFile.includes.append(section.includes);
+    rcFile.resourceMap.insert(section.resourceMap);
+    for (const auto &d : section.data) {
+        auto it = rcFile.data.find(d.language);
+        if (it == rcFile.data.end()) {
+            rcFile.data.insert(d.language, d);
+            continue;
+        }
+        it->acceleratorTables.append(d.acceleratorTables);
+        it->assets.append(d.assets);
+        it->dialogDataList.append(d.dialogDataList);
+        it->dialogs.append(d.dialogs);
+        it->icons.append(d.icons);
+        it->menus.append(d.menus);
+        it->strings.insert(d.strings);
+        it->toolBars.append(d.toolBars);
+        it->ribbons.append(d.ribbons);
+    }
+}
+
+static QStringView sectionText(const QString &content, const RcFile::Section &section)
+{
+    return QStringView(content).sliced(section.start, section.end - section.start);
+}
+
+RcFile parse(const QString &fileName, const RcFile &previous)
+{
+    KNUT_TRACE_SCOPE("RcCore::parse");
+    QElapsedTimer time;
+    time.start();
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return {};
+
+    RcFile rcFile;
+    rcFile.fileName = fileName;
+    rcFile.content = Stream {&file}.content();
+
+    auto parseContent = [&](const RcFile::Section &section,
+                            const QHash<int, QString> &resourceMap) -> std::shared_ptr<const RcFile> {
+        auto result = std::make_shared<RcFile>();
+        result->fileName = fileName;
+        result->resourceMap = resourceMap;
+        Lexer lexer(Stream {sectionText(rcFile.content, section).toString(), section.line});
+        lexer.setFileName(fileName);
+        // Ids and styles are shared between all the sections, and with the other RC files
+        lexer.setStringPool(&Utils::StringPool::instance());
+        Context context = {.rcFile = *result, .lexer = lexer};
+        if (!parseSection(context))
+            return {};
+        result->isValid = true;
+        return result;
+    };
+
+    rcFile.sections = splitLanguageSections(rcFile.content);
+    for (auto &section : rcFile.sections)
+        section.hash = qHash(sectionText(rcFile.content, section));
+
+    // The first section contains the includes, and so the resource map used by the other sections.
+    // It's always parsed again, as the included files may have changed.
+    auto &firstSection = rcFile.sections.first();
+    firstSection.result = parseContent(firstSection, {});
+    if (!firstSection.result)
+        return {};
+    const auto &resourceMap = firstSection.result->resourceMap;
+
+    // A section from the previous parsing can be reused if it has the same text at the same line (so the lines in the
+    // data are still right), and was parsed with the same resource map
+    const bool canReuse = previous.fileName == fileName && !previous.sections.isEmpty()
+        && previous.sections.first().result && previous.sections.first().result->resourceMap == resourceMap;
+    auto findPrevious = [&](const RcFile::Section &section) -> std::shared_ptr<const RcFile> {
+        if (!canReuse)
+            return {};
+        for (qsizetype i = 1; i < previous.sections.size(); ++i) {
+            const auto &previousSection = previous.sections.at(i);
+            if (previousSection.hash == section.hash && previousSection.line == section.line
+                && sectionText(previous.content, previousSection) == sectionText(rcFile.content, section))
+                return previousSection.result;
+        }
+        return {};
+    };
+
+    // Each language section is independent and parsed in parallel, the results are then merged in order. Only the
+    // resource map of the first section is used while parsing them, as includes are at the top of the file.
+    if (rcFile.sections.size() > 1) {
+        auto parseLanguage = [&](RcFile::Section &section) {
+            section.result = findPrevious(section);
+            if (!section.result)
+                section.result = parseContent(section, resourceMap);
+        };
+        QtConcurrent::blockingMap(rcFile.sections.begin() + 1, rcFile.sections.end(), parseLanguage);
+    }
+
+    for (const auto &section : std::as_const(rcFile.sections)) {
+        if (!section.result)
+            return {};
+        mergeSection(rcFile, *section.result);
+    }
+
+    spdlog::trace("{} ms for parsing {}", static_cast<int>(time.elapsed()), fileName);
+    rcFile.isValid = true;
+    return rcFile;
+}
+
+//=============================================================================
+// RcFileUtils::parseIndex
+//=============================================================================
+// Resources made of a BEGIN/END block and the statements before it, the other ones are on one line
+static bool isBlockResource(QStringView type)
+{
+    static constexpr QStringView BlockResources[] = {
+        u"ACCELERATORS", u"AFX_DIALOG_LAYOUT", u"DESIGNINFO",  u"DIALOG",      u"DIALOGEX", u"DLGINIT",
+        u"MENU",         u"MENUEX",            u"RCDATA",      u"STRINGTABLE", u"TEXTINCLUDE", u"TOOLBAR",
+        u"VERSIONINFO",
+    };
+    return std::ranges::find(BlockResources, type) != std::end(BlockResources);
+}
+
+// Finds the position of all the resources, with a line by line scan like splitLanguageSections. Only the includes and
+// the LANGUAGE statements are parsed, the resources are not even tokenized.
+static void indexResources(RcFile &rcFile)
+{
+    const QString &content = rcFile.content;
+    // Parses one line with the lexer, it returns the current language
+    auto parseLine = [&rcFile](QStringView text, int line, const auto &read) {
+        Lexer lexer(Stream {text.toString(), line});
+        lexer.setFileName(rcFile.fileName);
+        Context context = {.rcFile = rcFile, .lexer = lexer};
+        read(context, lexer.next());
+        return context.currentLanguage;
+    };
+
+    QString language;
+    // Set while the end of the last resource is not known yet
+    bool inResource = false;
+    int depth = 0;
+    int line = 1;
+    qsizetype pos = 0;
+    while (pos < content.size()) {
+        qsizetype end = content.indexOf('\n', pos);
+        if (end == -1)
+            end = content.size();
+        const qsizetype next = std::min(end + 1, content.size());
+
+        const QStringView text = QStringView(content).sliced(pos, end - pos).trimmed();
+        const QStringView word = firstWord(text);
+        if (word == u"BEGIN") {
+            ++depth;
+        } else if (word == u"END") {
+            depth = std::max(depth - 1, 0);
+            if (depth == 0 && inResource) {
+                rcFile.resources.last().end = next;
+                inResource = false;
+            }
+        } else if (depth == 0 && !inResource && !text.isEmpty() && text.front() != '/') {
+            if (text.startsWith(u"#include")) {
+                parseLine(text, line, [](Context &context, const std::optional<Token> &token) {
+                    readDirective(context, token->toString());
+                });
+            } else if (word == u"LANGUAGE") {
+                language = parseLine(text, line, [](Context &context, const std::optional<Token> &) {
+                    readLanguage(context);
+                });
+            } else if (text.front() != '#') {
+                // Either "STRINGTABLE [attributes]" or "nameID KEYWORD ..."
+                QStringView id;
+                QStringView type = word;
+                if (word != u"STRINGTABLE") {
+                    const auto idEnd = std::find_if(text.begin(), text.end(), [](QChar c) {
+                        return c.isSpace();
+                    });
+                    id = text.first(std::distance(text.begin(), idEnd));
+                    type = firstWord(text.sliced(id.size()).trimmed());
+                    if (id.size() > 1 && id.startsWith('"') && id.endsWith('"'))
+                        id = id.sliced(1, id.size() - 2);
+                }
+                rcFile.resources.push_back({.type = type.toString(),
+                                            .id = id.toString(),
+                                            .language = language,
+                                            .start = pos,
+                                            .end = next,
+                                            .line = line});
+                inResource = isBlockResource(type);
+            }
+        }
+        pos = end + 1;
+        ++line;
+    }
+    if (inResource)
+        rcFile.resources.last().end = content.size();
+}
+
+RcFile parseIndex(const QString &fileName)
+{
+    KNUT_TRACE_SCOPE("RcCore::parseIndex");
+    QElapsedTimer time;
+    time.start();
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return {};
+
+    RcFile rcFile;
+    rcFile.fileName = fileName;
+    rcFile.content = Stream {&file}.content();
+    try {
+        indexResources(rcFile);
+    } catch (...) {
+        spdlog::critical("{}: parser general error while indexing", fileName);
         return {};
     }
-    spdlog::trace("{} ms for parsing {}", static_cast<int>(time.elapsed()), context.fileName());
+
+    // One entry for each language, even the ones only set by LANGUAGE statements
+    for (const auto &resource : std::as_const(rcFile.resources)) {
+        auto &data = rcFile.data[resource.language];
+        data.language = resource.language;
+        data.fileName = fileName;
+    }
+
+    spdlog::trace("{} ms for indexing {}", static_cast<int>(time.elapsed()), fileName);
     rcFile.isValid = true;
     return rcFile;
 }
 
+QHash<QString, Data> parseResources(const RcFile &rcFile, const std::function<bool(const RcFile::Resource &)> &filter)
+{
+    KNUT_TRACE_SCOPE("RcCore::parseResources");
+    QList<const RcFile::Resource *> resources;
+    for (const auto &resource : rcFile.resources) {
+        if (filter(resource))
+            resources.push_back(&resource);
+    }
+
+    // Each resource is parsed independently and in parallel, like the language sections in parse
+    auto parseResource = [&](const RcFile::Resource *resource) {
+        RcFile result;
+        result.fileName = rcFile.fileName;
+        result.resourceMap = rcFile.resourceMap;
+        const auto text = QStringView(rcFile.content).sliced(resource->start, resource->end - resource->start);
+        Lexer lexer(Stream {text.toString(), resource->line});
+        lexer.setFileName(rcFile.fileName);
+        lexer.setStringPool(&Utils::StringPool::instance());
+        Context context = {.rcFile = result, .lexer = lexer};
+        context.setCurrentData(resource->language);
+        parseSection(context);
+        return result;
+    };
+    const auto results = QtConcurrent::blockingMapped<QList<RcFile>>(resources, parseResource);
+
+    RcFile merged;
+    for (const auto &result : results)
+        mergeSection(merged, result);
+    return merged.data;
+}
+
 } // namespace RcCore
@@ -38,6 +38,11 @@ void RcFile::mergeLanguages(const QStringList &languages, const QString &newLang
     for (const auto &lang : languages)
         data.remove(lang);
     data[newLanguage] = newData;
+
+    for (auto &resource : resources) {
+        if (languages.contains(resource.language))
+            resource.language = newLanguage;
+    }
 }
 
 } // namespace RcCore
@@ -12,54 +12,106 @@
 #include "utils/log.h"
 #include "utils/qtuiwriter.h"
 
+#include <QBuffer>
+#include <QCryptographicHash>
 #include <QDir>
+#include <QFile>
 #include <QFileInfo>
 #include <QHash>
 #include <QIODevice>
 #include <QImage>
 #include <QSet>
 #include <QXmlStreamWriter>
+#include <QtConcurrent/QtConcurrentMap>
+#include <algorithm>
+#include <array>
+#include <map>
+#include <pugixml.hpp>
+#include <tuple>
 
 namespace RcCore {
 
 //=============================================================================
 // Asset writing
 //=============================================================================
-static QImage convertBmpImage(const Asset &asset, Asset::TransparentColors colors)
+static QList<QRgb> transparentColors(const QImage &image, Asset::TransparentColors colors)
 {
-    QImage image(asset.originalFileName);
-
-    QSet<QRgb> transparentColors;
+    QList<QRgb> result;
     if (image.format() != QImage::Format_ARGB32) {
         if (colors & Asset::Gray)
-            transparentColors.insert(qRgb(192, 192, 192));
+            result.push_back(qRgb(192, 192, 192));
         if (colors & Asset::Magenta)
-            transparentColors.insert(qRgb(255, 0, 255));
+            result.push_back(qRgb(255, 0, 255));
         if (colors & Asset::BottomLeftPixel)
-            transparentColors.insert(image.pixel(0, image.height() - 1));
+            result.push_back(image.pixel(0, image.height() - 1));
     }
+    return result;
+}
 
-    image = image.convertToFormat(QImage::Format_ARGB32);
-    if (!transparentColors.isEmpty()) {
-        for (int x = 0; x < image.width(); ++x) {
-            for (int y = 0; y < image.height(); ++y) {
-                if (transparentColors.contains(image.pixel(x, y)))
-                    image.setPixel(x, y, qRgba(0, 0, 0, 0));
-            }
+// Convert the image to ARGB32, and make the transparent colors transparent.
+static QImage convertBmpImage(const QImage &source, const QList<QRgb> &colors)
+{
+    QImage image = source.convertToFormat(QImage::Format_ARGB32);
+    if (colors.isEmpty() || image.isNull())
+        return image;
+
+    // Always compare with 3 colors, without branches, so the compiler can vectorize the loop
+    const std::array<QRgb, 3> rgbs = {colors.value(0), colors.value(1, colors.first()),
+                                      colors.value(2, colors.first())};
+    const int width = image.width();
+    for (int y = 0; y < image.height(); ++y) {
+        auto line = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x < width; ++x) {
+            const QRgb pixel = line[x];
+            const bool transparent = (pixel == rgbs[0]) | (pixel == rgbs[1]) | (pixel == rgbs[2]);
+            line[x] = transparent ? qRgba(0, 0, 0, 0) : pixel;
         }
     }
     return image;
 }
 
+// Hash of the content of each file, so identical images are only converted once even with different names
+static QHash<QString, QByteArray> contentHashes(const QStringList &fileNames)
+{
+    auto hashFile = [](const QString &fileName) {
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly))
+            return std::pair(fileName, QByteArray());
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+        hash.addData(&file);
+        return std::pair(fileName, hash.result());
+    };
+    const auto hashes = QtConcurrent::blockingMapped<QList<std::pair<QString, QByteArray>>>(fileNames, hashFile);
+
+    QHash<QString, QByteArray> result;
+    for (const auto &[fileName, hash] : hashes) {
+        // Files that can't be read are kept on their own
+        result.insert(fileName, hash.isEmpty() ? fileName.toUtf8() : hash);
+    }
+    return result;
+}
+
+static bool writeFile(const QString &fileName, const QByteArray &content)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    return file.write(content) == content.size();
+}
+
 /**
  * @brief Write new images for assets
  * Used if there's a BMP->PNG conversion, or toolbar splitting (default).
+ * Assets with the same image content, even from different files, are only converted once: the result is then written
+ * for each of them.
  * @param assets list of assets
  * @param colors list of transparent colors for the conversion
+ * @param manifest fingerprints of the images already written, the ones up to date are skipped (optional)
  */
-void writeAssetsToImage(const QVector<Asset> &assets, Asset::TransparentColors colors)
+void writeAssetsToImage(const QVector<Asset> &assets, Asset::TransparentColors colors, OutputManifest *manifest)
 {
-    QHash<QString, QImage> cache;
+    QVector<const Asset *> toWrite;
+    QSet<QString> originalFileNames;
     for (const auto &asset : assets) {
         if (!asset.exist)
             continue;
@@ -67,20 +119,49 @@ void writeAssetsToImage(const QVector<Asset> &assets, Asset::TransparentColors c
         if (asset.isSame())
             continue;
 
-        // Write BMP -> PNG conversion
-        if (asset.iconRect.isNull()) {
-            convertBmpImage(asset, colors).save(asset.fileName);
+        if (manifest && manifest->isUpToDate(asset.fileName, assetFingerprint(asset, colors)))
+            continue;
 
-            // Write BMP -> PNG for split toolbars
-        } else {
-            QImage image = cache.value(asset.originalFileName);
-            if (image.isNull()) {
-                image = convertBmpImage(asset, colors);
-                cache[asset.originalFileName] = image;
+        toWrite.push_back(&asset);
+        originalFileNames.insert(asset.originalFileName);
+    }
+
+    // Group the assets by content of the original file, so each image is only loaded once, even for split toolbars
+    // or copies of the same file. Each group is then written in parallel.
+    const auto hashes = contentHashes(originalFileNames.values());
+    QHash<QByteArray, QVector<const Asset *>> groups;
+    for (const auto *asset : std::as_const(toWrite))
+        groups[hashes.value(asset->originalFileName)].push_back(asset);
+
+    auto writeGroup = [colors, manifest](const QVector<const Asset *> &group) {
+        const QImage source(group.first()->originalFileName);
+        const auto rgbs = transparentColors(source, colors);
+        // Converted images, by icon rect and format
+        std::map<std::tuple<int, int, int, int, QString>, QByteArray> images;
+        for (const auto *asset : group) {
+            const QRect &rect = asset->iconRect;
+            const QString format = QFileInfo(asset->fileName).suffix().toLower();
+            const auto key = std::tuple(rect.x(), rect.y(), rect.width(), rect.height(), format);
+            auto it = images.find(key);
+            if (it == images.end()) {
+                // Write BMP -> PNG conversion, for split toolbars: only convert the icon, not the whole strip
+                const auto image = convertBmpImage(rect.isNull() ? source : source.copy(rect), rgbs);
+                QByteArray content;
+                QBuffer buffer(&content);
+                buffer.open(QIODevice::WriteOnly);
+                if (!image.save(&buffer, format.toLatin1().constData()))
+                    content.clear();
+                it = images.emplace(key, content).first;
             }
-            image.copy(asset.iconRect).save(asset.fileName);
+            if (it->second.isEmpty() || !writeFile(asset->fileName, it->second)) {
+                spdlog::error("writeAssetsToImage: unable to write {}", asset->fileName);
+                continue;
+            }
+            if (manifest)
+                manifest->update(asset->fileName, assetFingerprint(*asset, colors));
         }
-    }
+    };
+    QtConcurrent::blockingMap(groups.values(), writeGroup);
 }
 
 /**
@@ -88,11 +169,31 @@ void writeAssetsToImage(const QVector<Asset> &assets, Asset::TransparentColors c
  * @param assets list of assets to write
  * @param device device to write on
  * @param fileName fileName of the qrc file (to have relative path to it)
+ * @param shareDuplicates if true, the assets with the same content as a previous one use the file of the first one
  */
-void writeAssetsToQrc(const QVector<Asset> &assets, QIODevice *device, const QString &fileName)
+void writeAssetsToQrc(const QVector<Asset> &assets, QIODevice *device, const QString &fileName, bool shareDuplicates)
 {
     Q_ASSERT(device);
 
+    // The first file with each content, and the file used for each duplicate
+    QHash<QString, QString> sharedFiles;
+    if (shareDuplicates) {
+        QStringList fileNames;
+        for (const auto &asset : assets) {
+            if (asset.exist)
+                fileNames.push_back(asset.fileName);
+        }
+        fileNames.removeDuplicates();
+        const auto hashes = contentHashes(fileNames);
+        QHash<QByteArray, QString> firstFiles;
+        for (const auto &assetFileName : std::as_const(fileNames)) {
+            auto &firstFile = firstFiles[hashes.value(assetFileName)];
+            if (firstFile.isEmpty())
+                firstFile = assetFileName;
+            sharedFiles.insert(assetFileName, firstFile);
+        }
+    }
+
     QXmlStreamWriter w(device);
     w.setAutoFormatting(true);
 
@@ -108,7 +209,7 @@ void writeAssetsToQrc(const QVector<Asset> &assets, QIODevice *device, const QSt
         // Compute relative filePath for assets
         QString assetFileName = asset.fileName;
         if (asset.exist)
-            assetFileName = fi.absoluteDir().relativeFilePath(asset.fileName);
+            assetFileName = fi.absoluteDir().relativeFilePath(sharedFiles.value(asset.fileName, asset.fileName));
 
         w.writeCharacters(assetFileName);
         w.writeEndElement();
@@ -143,11 +244,380 @@ static void writeWidget(Utils::QtUiWriter &writer, const Widget &widget, pugi::x
 void writeDialogToUi(const Widget &widget, QIODevice *device)
 {
     pugi::xml_document doc;
-    Utils::QtUiWriter writer(doc);
+    writeDialogToUi(widget, doc);
+
+    device->write(Utils::QtUiWriter(doc).dump().toUtf8());
+}
+
+// Fills `document` with the ui content for the dialog, so it can be used without serializing it
+void writeDialogToUi(const Widget &widget, pugi::xml_document &document)
+{
+    Utils::QtUiWriter writer(document);
 
     writeWidget(writer, widget);
+}
+
+//=============================================================================
+// Translation writing
+//=============================================================================
+namespace {
+
+// Streams the xml document directly to the device, without building an intermediate string
+class DeviceWriter : public pugi::xml_writer
+{
+public:
+    explicit DeviceWriter(QIODevice *device)
+        : m_device(device)
+    {
+    }
+
+    void write(const void *data, size_t size) override
+    {
+        m_device->write(static_cast<const char *>(data), static_cast<qint64>(size));
+    }
+
+private:
+    QIODevice *m_device;
+};
+
+class TsWriter
+{
+public:
+    TsWriter(pugi::xml_node ts, const QString &location)
+        : m_ts(ts)
+        , m_location(location.toUtf8())
+    {
+    }
+
+    void startContext(const QString &name)
+    {
+        m_context = m_ts.append_child("context");
+        m_context.append_child("name").text().set(name.toUtf8().constData());
+    }
+
+    // An empty translation is written as unfinished, so it shows up in Qt Linguist
+    void addMessage(const QString &id, const QString &source, const QString &translation, int line)
+    {
+        if (source.isEmpty())
+            return;
+        auto message = m_context.append_child("message");
+        auto location = message.append_child("location");
+        location.append_attribute("filename").set_value(m_location.constData());
+        location.append_attribute("line").set_value(line);
+        message.append_child("source").text().set(source.toUtf8().constData());
+        if (!id.isEmpty())
+            message.append_child("comment").text().set(id.toUtf8().constData());
+        auto translationNode = message.append_child("translation");
+        if (translation.isEmpty())
+            translationNode.append_attribute("type").set_value("unfinished");
+        else
+            translationNode.text().set(translation.toUtf8().constData());
+    }
+
+private:
+    pugi::xml_node m_ts;
+    pugi::xml_node m_context;
+    const QByteArray m_location;
+};
+
+} // namespace
+
+// Menu items don't always have an id (popups), so the translated items are matched by position
+static void writeMenuItems(TsWriter &writer, const QVector<MenuItem> &items, const QVector<MenuItem> *translatedItems)
+{
+    for (int i = 0; i < items.size(); ++i) {
+        const auto &item = items.at(i);
+        if (item.isSeparator())
+            continue;
+        const MenuItem *translatedItem = nullptr;
+        if (translatedItems && i < translatedItems->size() && translatedItems->at(i).id == item.id)
+            translatedItem = &translatedItems->at(i);
+        writer.addMessage(item.id, item.text, translatedItem ? translatedItem->text : QString(), item.line);
+        writeMenuItems(writer, item.children, translatedItem ? &translatedItem->children : nullptr);
+    }
+}
+
+/**
+ * @brief Write a Qt translation file for the strings, menus and dialogs of the rc file
+ * The source texts are taken from `source`, and the translations from `translation`, matched by id. Use the same data
+ * for both to generate a source-language ts file.
+ * @param source data of the source language
+ * @param translation data of the translated language
+ * @param device device to write the ts file to
+ * @param location rc file name used in the messages location, usually relative to the ts file
+ */
+void writeDataToTs(const Data &source, const Data &translation, QIODevice *device, const QString &location)
+{
+    pugi::xml_document doc;
+    auto declaration = doc.append_child(pugi::node_declaration);
+    declaration.append_attribute("version").set_value("1.0");
+    declaration.append_attribute("encoding").set_value("utf-8");
+    doc.append_child(pugi::node_doctype).set_value("TS");
 
-    device->write(writer.dump().toUtf8());
+    auto ts = doc.append_child("TS");
+    ts.append_attribute("version").set_value("2.1");
+    ts.append_attribute("language").set_value(convertLanguageToCode(translation.language).toUtf8().constData());
+    ts.append_attribute("sourcelanguage").set_value(convertLanguageToCode(source.language).toUtf8().constData());
+
+    TsWriter writer(ts, location);
+
+    if (!source.strings.isEmpty()) {
+        // Strings are stored in a hash, sort them to get a stable output
+        auto strings = source.strings.values();
+        std::ranges::sort(strings, {}, &String::line);
+        writer.startContext("strings");
+        for (const auto &string : std::as_const(strings))
+            writer.addMessage(string.id, string.text, translation.strings.value(string.id).text, string.line);
+    }
+
+    QHash<QString, const Menu *> translatedMenus;
+    for (const auto &menu : translation.menus)
+        translatedMenus.insert(menu.id, &menu);
+    for (const auto &menu : source.menus) {
+        const auto translatedMenu = translatedMenus.value(menu.id);
+        writer.startContext(menu.id);
+        writeMenuItems(writer, menu.children, translatedMenu ? &translatedMenu->children : nullptr);
+    }
+
+    QHash<QString, const Data::Dialog *> translatedDialogs;
+    for (const auto &dialog : translation.dialogs)
+        translatedDialogs.insert(dialog.id, &dialog);
+    for (const auto &dialog : source.dialogs) {
+        const auto translatedDialog = translatedDialogs.value(dialog.id);
+        writer.startContext(dialog.id);
+        writer.addMessage(dialog.id, dialog.caption, translatedDialog ? translatedDialog->caption : QString(),
+                          dialog.line);
+        // Control ids are not unique (IDC_STATIC), so the controls are matched by position
+        for (int i = 0; i < dialog.controls.size(); ++i) {
+            const auto &control = dialog.controls.at(i);
+            QString translatedText;
+            if (translatedDialog && i < translatedDialog->controls.size()
+                && translatedDialog->controls.at(i).id == control.id)
+                translatedText = translatedDialog->controls.at(i).text;
+            writer.addMessage(control.id, control.text, translatedText, control.line);
+        }
+    }
+
+    DeviceWriter deviceWriter(device);
+    doc.save(deviceWriter, "    ", pugi::format_default, pugi::encoding_utf8);
+}
+
+//=============================================================================
+// Slint writing
+//=============================================================================
+namespace {
+
+class SlintWriter
+{
+public:
+    explicit SlintWriter(const Widget &dialog)
+    {
+        // Count the ids, only unique ones can be used as element ids
+        countIds(dialog);
+        // Rough estimate of the output size, so the buffer is not reallocated while writing
+        m_body.reserve(m_widgetCount * 160);
+    }
+
+    QString write(const Widget &dialog)
+    {
+        writeDialog(dialog);
+
+        QString result;
+        result.reserve(m_body.size() + 128);
+        if (!m_imports.isEmpty()) {
+            auto imports = m_imports.values();
+            imports.sort();
+            result += "import { " + imports.join(", ") + " } from \"std-widgets.slint\";\n\n";
+        }
+        result += m_body;
+        return result;
+    }
+
+private:
+    void countIds(const Widget &widget)
+    {
+        ++m_widgetCount;
+        ++m_idCount[widget.id];
+        for (const auto &child : widget.children)
+            countIds(child);
+    }
+
+    void indent(int level) { m_body += QString(level * 4, ' '); }
+
+    void writeProperty(int level, QStringView name, const QString &value)
+    {
+        indent(level);
+        m_body += name;
+        m_body += ": ";
+        m_body += value;
+        m_body += ";\n";
+    }
+
+    void writeGeometry(int level, const QRect &geometry, bool withPosition)
+    {
+        if (withPosition) {
+            writeProperty(level, u"x", QString::number(geometry.x()) + "px");
+            writeProperty(level, u"y", QString::number(geometry.y()) + "px");
+        }
+        writeProperty(level, u"width", QString::number(geometry.width()) + "px");
+        writeProperty(level, u"height", QString::number(geometry.height()) + "px");
+    }
+
+    void writeDialog(const Widget &dialog)
+    {
+        m_body += "export component " + elementName(dialog.id) + " inherits Window {\n";
+        if (const auto title = dialog.properties.value("windowTitle").toString(); !title.isEmpty())
+            writeProperty(1, u"title", stringLiteral(title));
+        writeGeometry(1, dialog.geometry, false);
+        for (const auto &child : dialog.children)
+            writeWidget(child, 1);
+        m_body += "}\n";
+    }
+
+    void writeWidget(const Widget &widget, int level)
+    {
+        const auto &properties = widget.properties;
+        const auto element = elementType(widget);
+        if (element == "Rectangle") {
+            indent(level);
+            m_body += "// " + widget.className + '\n';
+        }
+        indent(level);
+        if (isValidId(widget.id) && m_idCount.value(widget.id) == 1)
+            m_body += widget.id + " := ";
+        m_body += element + " {\n";
+
+        const int propertyLevel = level + 1;
+        writeGeometry(propertyLevel, widget.geometry, true);
+        if (element == "Text" || element == "Button" || element == "CheckBox" || element == "LineEdit") {
+            if (const auto text = properties.value("text").toString(); !text.isEmpty())
+                writeProperty(propertyLevel, u"text", stringLiteral(text));
+        }
+        if (element == "GroupBox")
+            writeProperty(propertyLevel, u"title", stringLiteral(properties.value("title").toString()));
+        if (element == "ComboBox") {
+            const auto values = properties.value("text").toStringList();
+            QStringList model;
+            model.reserve(values.size());
+            for (const auto &value : values)
+                model.push_back(stringLiteral(value));
+            writeProperty(propertyLevel, u"model", '[' + model.join(", ") + ']');
+        }
+        if (element == "Image")
+            writeProperty(propertyLevel, u"source", "@image-url(" + stringLiteral(properties.value("pixmap").toString())
+                              + ')');
+        if (element == "Button" && properties.value("default").toBool())
+            writeProperty(propertyLevel, u"primary", "true");
+        if (element == "Button" && properties.value("checkable").toBool())
+            writeProperty(propertyLevel, u"checkable", "true");
+        if ((element == "LineEdit" || element == "TextEdit") && properties.value("readOnly").toBool())
+            writeProperty(propertyLevel, u"read-only", "true");
+        if (element == "Text" && properties.value("wordWrap").toBool())
+            writeProperty(propertyLevel, u"wrap", "word-wrap");
+        if (element == "Slider" && properties.value("orientation").toString() == "Qt::Vertical")
+            writeProperty(propertyLevel, u"orientation", "vertical");
+        if (properties.contains("enabled") && !properties.value("enabled").toBool())
+            writeProperty(propertyLevel, u"enabled", "false");
+
+        for (const auto &child : widget.children)
+            writeWidget(child, propertyLevel);
+
+        indent(level);
+        m_body += "}\n";
+    }
+
+    // Returns the Slint element for the widget, and registers its import
+    QString elementType(const Widget &widget)
+    {
+        static const QHash<QString, QString> stdWidgets = {
+            {"QPushButton", "Button"},
+            {"QCheckBox", "CheckBox"},
+            // There's no radio button in the Slint standard widgets
+            {"QRadioButton", "CheckBox"},
+            {"QComboBox", "ComboBox"},
+            {"QLineEdit", "LineEdit"},
+            {"QTextEdit", "TextEdit"},
+            {"QGroupBox", "GroupBox"},
+            {"QListWidget", "StandardListView"},
+            {"QListView", "StandardListView"},
+            {"QTreeView", "StandardListView"},
+            {"QSlider", "Slider"},
+            {"QSpinBox", "SpinBox"},
+            {"QProgressBar", "ProgressIndicator"},
+        };
+        if (const auto it = stdWidgets.constFind(widget.className); it != stdWidgets.cend()) {
+            m_imports.insert(it.value());
+            return it.value();
+        }
+        if (widget.className == "QLabel")
+            return widget.properties.contains("pixmap") ? "Image" : "Text";
+        return "Rectangle";
+    }
+
+    static bool isValidId(const QString &id)
+    {
+        if (id.isEmpty() || id == "IDC_STATIC" || (!id.front().isLetter() && id.front() != '_'))
+            return false;
+        return std::ranges::all_of(id, [](QChar c) {
+            return c.isLetterOrNumber() || c == '_' || c == '-';
+        });
+    }
+
+    static QString elementName(const QString &id) { return isValidId(id) ? id : "Dialog_" + id; }
+
+    // Converts the text to a Slint string literal, removing the MFC mnemonics
+    static QString stringLiteral(const QString &text)
+    {
+        QString result;
+        result.reserve(text.size() + 2);
+        result += '"';
+        for (int i = 0; i < text.size(); ++i) {
+            const auto c = text.at(i);
+            if (c == '&') {
+                // "&&" is a literal '&', a single '&' marks the mnemonic
+                if (i + 1 < text.size() && text.at(i + 1) == '&') {
+                    result += '&';
+                    ++i;
+                }
+            } else if (c == '"' || c == '\\') {
+                result += '\\';
+                result += c;
+            } else if (c == '\n') {
+                result += "\\n";
+            } else if (c == '\t') {
+                result += "\\t";
+            } else {
+                result += c;
+            }
+        }
+        result += '"';
+        return result;
+    }
+
+    qsizetype m_widgetCount = 0;
+    QHash<QString, int> m_idCount;
+    QSet<QString> m_imports;
+    // Content after the imports, which are only known once all widgets are written
+    QString m_body;
+};
+
+} // namespace
+
+/**
+ * @brief Convert a dialog to a Slint component
+ * The dialog becomes a component inheriting Window, and its children use the Slint standard widgets when there's
+ * an equivalent, a Rectangle otherwise.
+ * @param widget dialog to convert, usually the result of convertDialog
+ * @return the content of the slint file
+ */
+QString convertDialogToSlint(const Widget &widget)
+{
+    return SlintWriter(widget).write(widget);
+}
+
+void writeDialogToSlint(const Widget &widget, QIODevice *device)
+{
+    device->write(convertDialogToSlint(widget).toUtf8());
 }
 
 } // namespace RcCore
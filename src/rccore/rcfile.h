@@ -12,10 +12,18 @@
 
 #include "data.h"
 
+#include <QHash>
+#include <QMutex>
 #include <QStringList>
+#include <functional>
+#include <memory>
 
 class QIODevice;
 
+namespace pugi {
+class xml_document;
+}
+
 namespace RcCore {
 
 struct RcFile
@@ -31,11 +39,45 @@ struct RcFile
     // Data by languages
     QHash<QString, Data> data;
 
+    // Language sections of the content, each one parsed independently
+    struct Section
+    {
+        qsizetype start = 0;
+        qsizetype end = 0;
+        int line = 1;
+        size_t hash = 0;
+        std::shared_ptr<const RcFile> result;
+    };
+    QList<Section> sections;
+
+    // Position of each top-level resource in the content, only set by parseIndex
+    struct Resource
+    {
+        // Keyword of the resource, like "DIALOGEX" or "STRINGTABLE"
+        QString type;
+        // Empty for string tables
+        QString id;
+        QString language;
+        qsizetype start = 0;
+        qsizetype end = 0;
+        int line = 1;
+    };
+    QList<Resource> resources;
+
     void mergeLanguages(const QStringList &languages, const QString &newLanguage);
 };
 
 // Parse method
-RcFile parse(const QString &fileName);
+// If `previous` is the result of a previous parsing of the same file, only the sections that changed are parsed again.
+RcFile parse(const QString &fileName, const RcFile &previous = {});
+
+// Lazy parse methods
+// parseIndex only reads the includes, the languages and the position of each resource, without parsing them: the data
+// has an empty entry for each language. The resources are then parsed on demand by parseResources, which returns the
+// data by language of the resources accepted by `filter`, in the order of the file.
+RcFile parseIndex(const QString &fileName);
+QHash<QString, Data> parseResources(const RcFile &rcFile,
+                                    const std::function<bool(const RcFile::Resource &)> &filter);
 
 // Conversion methods
 QVector<Asset> convertAssets(const Data &data, Asset::ConversionFlags flags = Asset::AllFlags);
@@ -45,12 +87,55 @@ Widget convertDialog(const Data &data, const Data::Dialog &dialog,
 
 QVector<Action> convertActions(const Data &data, Asset::ConversionFlags flags = Asset::AllFlags);
 
+// Incremental conversion
+// Fingerprint of everything used to write a dialog or an asset: if it's the same as the one of the previous output, the
+// output doesn't need to be written again.
+QByteArray dialogFingerprint(const Data &data, const Data::Dialog &dialog, Widget::ConversionFlags flags,
+                             double scaleX, double scaleY, const QString &format);
+QByteArray assetFingerprint(const Asset &asset, Asset::TransparentColors colors);
+
+// Fingerprints of the files written by the previous conversions, saved as a json file.
+// An output is up to date if its fingerprint is the same, and it wasn't modified since it was written. All the entries
+// are dropped if the manifest was saved with another `version` of the converter. Thread-safe.
+class OutputManifest
+{
+public:
+    explicit OutputManifest(const QString &fileName, const QString &version = {});
+
+    bool isUpToDate(const QString &output, const QByteArray &fingerprint) const;
+    void update(const QString &output, const QByteArray &fingerprint);
+    bool save() const;
+
+private:
+    struct Entry
+    {
+        QByteArray fingerprint;
+        qint64 modified = 0;
+    };
+    QString key(const QString &output) const;
+
+    QString m_fileName;
+    QString m_version;
+    mutable QMutex m_mutex;
+    QHash<QString, Entry> m_entries;
+    bool m_changed = false;
+};
+
 // Write methods
-void writeAssetsToImage(const QVector<Asset> &assets, Asset::TransparentColors colors = Asset::AllColors);
+// Identical images are only converted once. If `manifest` is set, the images up to date are not written again.
+void writeAssetsToImage(const QVector<Asset> &assets, Asset::TransparentColors colors = Asset::AllColors,
+                        OutputManifest *manifest = nullptr);
 
-void writeAssetsToQrc(const QVector<Asset> &assets, QIODevice *device, const QString &fileName);
+void writeAssetsToQrc(const QVector<Asset> &assets, QIODevice *device, const QString &fileName,
+                      bool shareDuplicates = false);
 
 void writeDialogToUi(const Widget &widget, QIODevice *device);
+void writeDialogToUi(const Widget &widget, pugi::xml_document &document);
+
+QString convertDialogToSlint(const Widget &widget);
+void writeDialogToSlint(const Widget &widget, QIODevice *device);
+
+void writeDataToTs(const Data &source, const Data &translation, QIODevice *device, const QString &location);
 
 QString convertLanguageToCode(const QString &name);
 
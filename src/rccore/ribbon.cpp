@@ -10,6 +10,7 @@
 
 #include "ribbon.h"
 #include "utils/log.h"
+#include "utils/xml_helper.h"
 
 #include <pugixml.hpp>
 
@@ -247,7 +248,9 @@ static RibbonContext readContext(pugi::xml_node node)
 bool Ribbon::load()
 {
     pugi::xml_document document;
-    pugi::xml_parse_result result = document.load_file(fileName.toLatin1().constData());
+    // The ribbon only uses elements, attributes don't need to be normalized
+    pugi::xml_parse_result result =
+        Utils::loadXmlFile(document, fileName, pugi::parse_default & ~pugi::parse_wconv_attribute);
 
     if (!result) {
         spdlog::critical("{}({}): {}", fileName, result.offset, result.description());
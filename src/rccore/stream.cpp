@@ -10,19 +10,36 @@
 
 #include "stream.h"
 
-#include <QTextStream>
+#include <QFile>
+#include <QStringDecoder>
 
 namespace RcCore {
 
+static QString decode(QByteArrayView data)
+{
+    // RC files are usually either UTF-8 or UTF-16 with a BOM
+    const auto encoding = QStringConverter::encodingForData(data).value_or(QStringConverter::Utf8);
+    QStringDecoder decoder(encoding);
+    return decoder(data);
+}
+
 Stream::Stream(QIODevice *device)
 {
-    QTextStream stream(device);
-    m_content = stream.readAll();
+    // Decode the file directly from the mapped memory if possible, to avoid an intermediate copy
+    if (auto file = qobject_cast<QFile *>(device); file && file->size() > 0) {
+        if (uchar *data = file->map(0, file->size())) {
+            m_content = decode(QByteArrayView(data, file->size()));
+            file->unmap(data);
+            return;
+        }
+    }
+    m_content = decode(device->readAll());
 }
 
-Stream::Stream(const QString &text)
+Stream::Stream(const QString &text, int firstLine)
+    : m_content(text)
+    , m_line(firstLine)
 {
-    m_content = text;
 }
 
 bool Stream::atEnd() const
@@ -52,6 +69,16 @@ QChar Stream::peek() const
     return m_content.at(m_pos);
 }
 
+int Stream::pos() const
+{
+    return m_pos;
+}
+
+QStringView Stream::view(int from) const
+{
+    return QStringView(m_content).sliced(from, m_pos - from);
+}
+
 QString Stream::content() const
 {
     return m_content;
@@ -12,6 +12,7 @@
 
 #include <QChar>
 #include <QString>
+#include <QStringView>
 
 class QIODevice;
 
@@ -21,7 +22,7 @@ class Stream
 {
 public:
     explicit Stream(QIODevice *device);
-    Stream(const QString &text);
+    Stream(const QString &text, int firstLine = 1);
 
     bool atEnd() const;
     int line() const;
@@ -29,6 +30,10 @@ public:
     QChar next();
     QChar peek() const;
 
+    // Position in the content, to be used with view() to get a slice of the content without copying it
+    int pos() const;
+    QStringView view(int from) const;
+
     QString content() const;
 
 private:
@@ -13,25 +13,38 @@
 
 #include <QColor>
 #include <algorithm>
+#include <numeric>
 
 using namespace RcCore;
 
+namespace {
+
+std::vector<int> sortedRows(const QVector<Asset> &assets)
+{
+    std::vector<int> rows(assets.size());
+    std::iota(rows.begin(), rows.end(), 0);
+    std::ranges::sort(rows, [&assets](int left, int right) {
+        return assets.at(left).id < assets.at(right).id;
+    });
+    return rows;
+}
+
+} // namespace
+
 namespace RcUi {
 
 AssetModel::AssetModel(const QVector<Asset> &assets, QObject *parent)
     : QAbstractTableModel(parent)
-    , m_assets(assets)
+    , m_assets(&assets)
+    , m_rows(sortedRows(assets))
 {
-    std::ranges::sort(m_assets, [](const auto &left, const auto &right) {
-        return left.id < right.id;
-    });
 }
 
 int AssetModel::rowCount(const QModelIndex &parent) const
 {
     if (parent.isValid())
         return 0;
-    return m_assets.size();
+    return static_cast<int>(m_rows.size());
 }
 
 int AssetModel::columnCount(const QModelIndex &parent) const
@@ -45,7 +58,7 @@ QVariant AssetModel::data(const QModelIndex &index, int role) const
     Q_ASSERT(checkIndex(index, CheckIndexOption::IndexIsValid));
 
     if (role == Qt::DisplayRole || role == Qt::ToolTipRole) {
-        const auto &asset = m_assets.at(index.row());
+        const auto &asset = this->asset(index.row());
         switch (index.column()) {
         case ID:
             return asset.id;
@@ -55,16 +68,23 @@ QVariant AssetModel::data(const QModelIndex &index, int role) const
     }
 
     if (role == Qt::ForegroundRole) {
-        const auto &asset = m_assets.at(index.row());
-        if (!asset.exist)
+        if (!asset(index.row()).exist)
             return QVariant::fromValue(QColor(Qt::red));
     }
 
-    if (role == LineRole) {
-        const auto &asset = m_assets.at(index.row());
-        return asset.line;
+    if (role == Qt::DecorationRole && index.column() == FileName) {
+        const auto &asset = this->asset(index.row());
+        if (!asset.exist)
+            return {};
+        auto it = m_icons.find(index.row());
+        if (it == m_icons.end())
+            it = m_icons.insert(index.row(), QIcon(asset.fileName));
+        return it.value();
     }
 
+    if (role == LineRole)
+        return asset(index.row()).line;
+
     return {};
 }
 
@@ -77,4 +97,28 @@ QVariant AssetModel::headerData(int section, Qt::Orientation orientation, int ro
     return {};
 }
 
+// Used when the language changes: the assets usually have the same ids, so the view is kept as is
+void AssetModel::setAssets(const QVector<Asset> &assets)
+{
+    auto rows = sortedRows(assets);
+    m_icons.clear();
+    if (rows.size() == m_rows.size()) {
+        m_assets = &assets;
+        m_rows = std::move(rows);
+        if (!m_rows.empty())
+            emit dataChanged(index(0, 0), index(rowCount() - 1, columnCount() - 1));
+        return;
+    }
+
+    beginResetModel();
+    m_assets = &assets;
+    m_rows = std::move(rows);
+    endResetModel();
+}
+
+const Asset &AssetModel::asset(int row) const
+{
+    return m_assets->at(m_rows.at(row));
+}
+
 } // namespace RcUi
@@ -13,6 +13,9 @@
 #include "rccore/data.h"
 
 #include <QAbstractTableModel>
+#include <QHash>
+#include <QIcon>
+#include <vector>
 
 namespace RcUi {
 
@@ -34,8 +37,16 @@ public:
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
     QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
 
+    void setAssets(const QVector<RcCore::Asset> &assets);
+
 private:
-    QVector<RcCore::Asset> m_assets;
+    const RcCore::Asset &asset(int row) const;
+
+    const QVector<RcCore::Asset> *m_assets = nullptr;
+    // Indexes in m_assets, sorted by id
+    std::vector<int> m_rows;
+    // Previews, only loaded when the rows are displayed
+    mutable QHash<int, QIcon> m_icons;
 };
 
 } // namespace RcUi
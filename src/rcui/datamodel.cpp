@@ -18,6 +18,21 @@ namespace {
 const char *DataTypeStr[] = {
     "Dialogs", "Menus", "ToolBars", "Accelerators", "Assets", "Icons", "Strings", "Includes",
 };
+
+const Data *languageData(const RcFile &rcFile, const QString &language)
+{
+    const auto it = rcFile.data.constFind(language);
+    return it == rcFile.data.cend() ? nullptr : &it.value();
+}
+
+// Number of children of the dialogs, menus, toolbars and accelerators items (the other types have no children)
+std::array<int, 4> childCounts(const Data *data)
+{
+    if (!data)
+        return {};
+    return {static_cast<int>(data->dialogs.size()), static_cast<int>(data->menus.size()),
+            static_cast<int>(data->toolBars.size()), static_cast<int>(data->acceleratorTables.size())};
+}
 }
 
 namespace RcUi {
@@ -26,8 +41,10 @@ DataModel::DataModel(const RcCore::RcFile &rcFile, QString language, QObject *pa
     : QAbstractItemModel(parent)
     , m_rcFile(rcFile)
     , m_language(std::move(language))
+    , m_data(languageData(m_rcFile, m_language))
+    , m_rowCounts(childCounts(m_data))
 {
-    Q_ASSERT(m_rcFile.data.contains(m_language));
+    Q_ASSERT(m_data);
 }
 
 QModelIndex DataModel::index(int row, int column, const QModelIndex &parent) const
@@ -58,24 +75,8 @@ int DataModel::rowCount(const QModelIndex &parent) const
         return static_cast<int>(std::size(DataTypeStr));
 
     const int dataType = static_cast<int>(parent.internalId());
-    if (dataType == NoData) {
-        const auto &data = m_rcFile.data.value(m_language);
-        switch (parent.row()) {
-        case DialogData:
-            return data.dialogs.size();
-        case MenuData:
-            return data.menus.size();
-        case ToolBarData:
-            return data.toolBars.size();
-        case AcceleratorData:
-            return data.acceleratorTables.size();
-        case AssetData:
-        case IconData:
-        case StringData:
-        case IncludeData:
-            return 0;
-        }
-    }
+    if (dataType == NoData && parent.row() < static_cast<int>(m_rowCounts.size()))
+        return m_rowCounts.at(parent.row());
     return 0;
 }
 
@@ -92,7 +93,8 @@ QVariant DataModel::data(const QModelIndex &index, int role) const
     Q_ASSERT(checkIndex(index, CheckIndexOption::IndexIsValid));
 
     const int dataType = static_cast<int>(index.internalId());
-    const auto &data = m_rcFile.data.value(m_language);
+    static const Data emptyData;
+    const auto &data = m_data ? *m_data : emptyData;
 
     if (role == Qt::DisplayRole) {
         if (dataType == NoData)
@@ -168,11 +170,44 @@ QVariant DataModel::data(const QModelIndex &index, int role) const
     return {};
 }
 
+// Only the children at the end are removed or added, so the expanded and selected items are kept in the views
 void DataModel::setLanguage(const QString &language)
 {
-    beginResetModel();
+    if (language == m_language)
+        return;
+
+    const auto newData = languageData(m_rcFile, language);
+    const auto newCounts = childCounts(newData);
+    if (!m_rcFile.isValid) {
+        // Nothing is displayed
+        m_language = language;
+        m_data = newData;
+        m_rowCounts = newCounts;
+        return;
+    }
+
+    for (int type = 0; type < static_cast<int>(m_rowCounts.size()); ++type) {
+        if (newCounts[type] < m_rowCounts[type]) {
+            beginRemoveRows(index(type, 0), newCounts[type], m_rowCounts[type] - 1);
+            m_rowCounts[type] = newCounts[type];
+            endRemoveRows();
+        }
+    }
+
     m_language = language;
-    endResetModel();
+    m_data = newData;
+    for (int type = 0; type < static_cast<int>(m_rowCounts.size()); ++type) {
+        const auto parent = index(type, 0);
+        if (m_rowCounts[type] > 0)
+            emit dataChanged(index(0, 0, parent), index(m_rowCounts[type] - 1, 0, parent));
+        if (newCounts[type] > m_rowCounts[type]) {
+            beginInsertRows(parent, m_rowCounts[type], newCounts[type] - 1);
+            m_rowCounts[type] = newCounts[type];
+            endInsertRows();
+        }
+    }
+    // The top level items may be empty now
+    emit dataChanged(index(0, 0), index(rowCount() - 1, 0));
 }
 
 } // namespace RcUi
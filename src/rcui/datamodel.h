@@ -11,8 +11,10 @@
 #pragma once
 
 #include <QAbstractItemModel>
+#include <array>
 
 namespace RcCore {
+struct Data;
 struct RcFile;
 }
 
@@ -45,6 +47,10 @@ public:
 private:
     const RcCore::RcFile &m_rcFile;
     QString m_language;
+    // Data of the current language, there's no copy
+    const RcCore::Data *m_data = nullptr;
+    // Number of children of the dialogs, menus, toolbars and accelerators items
+    std::array<int, 4> m_rowCounts = {};
 };
 
 } // namespace RcUi
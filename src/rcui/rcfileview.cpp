@@ -91,6 +91,7 @@ RcFileView::RcFileView(QWidget *parent)
     findPrevious->setContext(Qt::WidgetWithChildrenShortcut);
     connect(findPrevious, &QShortcut::activated, this, &RcFileView::slotSearchPrevious);
 
+    connect(ui->languageCombo, &QComboBox::currentTextChanged, this, &RcFileView::changeLanguage);
     connect(ui->languageCombo, &QComboBox::currentTextChanged, this, &RcFileView::languageChanged);
 }
 
@@ -98,6 +99,14 @@ RcFileView::~RcFileView() = default;
 
 void RcFileView::setRcFile(const RcCore::RcFile &rcFile)
 {
+    // The models point to the data of the previous file, they are deleted before the language combo is filled
+    m_contentProxyModel->setSourceModel(nullptr);
+    delete m_contentModel;
+    m_contentModel = nullptr;
+    auto oldModel = m_dataProxyModel->sourceModel();
+    m_dataProxyModel->setSourceModel(nullptr);
+    delete oldModel;
+
     m_rcFile = &rcFile;
 
     auto languageList = m_rcFile->data.keys();
@@ -105,19 +114,12 @@ void RcFileView::setRcFile(const RcCore::RcFile &rcFile)
     ui->languageCombo->clear();
     ui->languageCombo->addItems(languageList);
 
-    delete m_dataProxyModel->sourceModel();
-    auto model = new DataModel(rcFile, ui->languageCombo->currentText(), this);
-    m_dataProxyModel->setSourceModel(model);
+    m_dataProxyModel->setSourceModel(new DataModel(rcFile, ui->languageCombo->currentText(), this));
     ui->dataView->sortByColumn(0, Qt::AscendingOrder);
 
-    delete m_contentModel;
-    m_contentModel = nullptr;
-
     auto content = rcFile.content;
     ui->textEdit->setPlainText(content.replace("\t", "    "));
 
-    connect(ui->languageCombo, &QComboBox::currentTextChanged, model, &DataModel::setLanguage);
-
     changeDataItem({});
 }
 
@@ -126,6 +128,36 @@ QPlainTextEdit *RcFileView::textEdit() const
     return ui->textEdit;
 }
 
+// The models are updated in place, so the expanded and selected items are kept when switching languages
+void RcFileView::changeLanguage()
+{
+    auto model = qobject_cast<DataModel *>(m_dataProxyModel->sourceModel());
+    if (!model)
+        return;
+    model->setLanguage(ui->languageCombo->currentText());
+
+    switch (m_dataType) {
+    case IconData:
+        static_cast<AssetModel *>(m_contentModel)->setAssets(data().icons);
+        break;
+    case AssetData:
+        static_cast<AssetModel *>(m_contentModel)->setAssets(data().assets);
+        break;
+    case StringData:
+        static_cast<StringModel *>(m_contentModel)->setStrings(data());
+        break;
+    default: {
+        // The other models are cheap to create, the item may not exist in the new language though
+        const auto current = ui->dataView->currentIndex();
+        if (current.isValid())
+            setData(current.data(DataModel::TypeRole).toInt(), current.data(DataModel::IndexRole).toInt());
+        else
+            setData(NoData, -1);
+        break;
+    }
+    }
+}
+
 void RcFileView::changeDataItem(const QModelIndex &current)
 {
     int type = NoData;
@@ -153,6 +185,7 @@ void RcFileView::setData(int type, int index)
     m_contentModel = nullptr;
     ui->propertyView->setVisible(false);
     m_contentProxyModel->setFilterKeyColumn(0);
+    m_dataType = type;
 
     switch (type) {
     case MenuData:
@@ -298,7 +331,9 @@ void RcFileView::slotSearchPrevious()
 const RcCore::Data &RcFileView::data() const
 {
     Q_ASSERT(m_rcFile);
-    return const_cast<RcCore::RcFile *>(m_rcFile)->data[ui->languageCombo->currentText()];
+    static const RcCore::Data emptyData;
+    const auto it = m_rcFile->data.constFind(ui->languageCombo->currentText());
+    return it == m_rcFile->data.cend() ? emptyData : it.value();
 }
 
 } // namespace RcUi
@@ -45,6 +45,7 @@ signals:
     void languageChanged(const QString &language);
 
 private:
+    void changeLanguage();
     void changeDataItem(const QModelIndex &current);
     void changeContentItem(const QModelIndex &current);
     void setData(int type, int index);
@@ -65,6 +66,8 @@ private:
     QSortFilterProxyModel *const m_dataProxyModel;
     QSortFilterProxyModel *const m_contentProxyModel;
     QAbstractItemModel *m_contentModel = nullptr;
+    // Type of the data displayed in the content view
+    int m_dataType = -1;
 };
 
 } // namespace RcUi
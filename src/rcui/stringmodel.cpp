@@ -15,22 +15,35 @@
 
 using namespace RcCore;
 
+namespace {
+
+std::vector<const String *> sortedStrings(const Data &data)
+{
+    std::vector<const String *> strings;
+    strings.reserve(data.strings.size());
+    for (const auto &string : data.strings)
+        strings.push_back(&string);
+    std::ranges::sort(strings, [](const auto *left, const auto *right) {
+        return left->id < right->id;
+    });
+    return strings;
+}
+
+} // namespace
+
 namespace RcUi {
 
 StringModel::StringModel(const Data &data, QObject *parent)
     : QAbstractTableModel(parent)
-    , m_strings(data.strings.values())
+    , m_strings(sortedStrings(data))
 {
-    std::ranges::sort(m_strings, [](const auto &left, const auto &right) {
-        return left.id < right.id;
-    });
 }
 
 int StringModel::rowCount(const QModelIndex &parent) const
 {
     if (parent.isValid())
         return 0;
-    return m_strings.size();
+    return static_cast<int>(m_strings.size());
 }
 
 int StringModel::columnCount(const QModelIndex &parent) const
@@ -44,7 +57,7 @@ QVariant StringModel::data(const QModelIndex &index, int role) const
     Q_ASSERT(checkIndex(index, CheckIndexOption::IndexIsValid));
 
     if (role == Qt::DisplayRole || role == Qt::ToolTipRole) {
-        const auto &asset = m_strings.at(index.row());
+        const auto &asset = *m_strings.at(index.row());
         switch (index.column()) {
         case ID:
             return asset.id;
@@ -54,7 +67,7 @@ QVariant StringModel::data(const QModelIndex &index, int role) const
     }
 
     if (role == LineRole) {
-        const auto &asset = m_strings.at(index.row());
+        const auto &asset = *m_strings.at(index.row());
         return asset.line;
     }
 
@@ -70,4 +83,20 @@ QVariant StringModel::headerData(int section, Qt::Orientation orientation, int r
     return {};
 }
 
+// Used when the language changes: the strings usually have the same ids, so the view is kept as is
+void StringModel::setStrings(const Data &data)
+{
+    auto strings = sortedStrings(data);
+    if (strings.size() == m_strings.size()) {
+        m_strings = std::move(strings);
+        if (!m_strings.empty())
+            emit dataChanged(index(0, 0), index(rowCount() - 1, columnCount() - 1));
+        return;
+    }
+
+    beginResetModel();
+    m_strings = std::move(strings);
+    endResetModel();
+}
+
 } // namespace RcUi
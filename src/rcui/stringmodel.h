@@ -13,7 +13,7 @@
 #include "rccore/data.h"
 
 #include <QAbstractTableModel>
-#include <QList>
+#include <vector>
 
 namespace RcUi {
 
@@ -35,8 +35,11 @@ public:
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
     QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
 
+    void setStrings(const RcCore::Data &data);
+
 private:
-    QList<RcCore::String> m_strings;
+    // Points to the strings of the data, sorted by id
+    std::vector<const RcCore::String *> m_strings;
 };
 
 } // namespace RcUi
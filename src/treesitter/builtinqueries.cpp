@@ -0,0 +1,98 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "builtinqueries.h"
+#include "languages.h"
+#include "utils/log.h"
+
+#include <QDirIterator>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <unordered_map>
+
+// Resources of a static library must be initialized explicitly, outside of any namespace
+static void initResources()
+{
+    static const bool initialized = []() {
+        Q_INIT_RESOURCE(treesitter);
+        return true;
+    }();
+    Q_UNUSED(initialized)
+}
+
+namespace treesitter {
+
+static constexpr char QueriesPath[] = ":/treesitter/queries/";
+
+static const TSLanguage *builtinQueryLanguage(const QString &name)
+{
+    if (name.startsWith("cpp/"))
+        return tree_sitter_cpp();
+    if (name.startsWith("qml/"))
+        return tree_sitter_qmljs();
+    return nullptr;
+}
+
+QString builtinQueryText(const QString &name)
+{
+    initResources();
+    QFile file(QueriesPath + name + ".scm");
+    if (!file.open(QIODevice::ReadOnly)) {
+        spdlog::error("treesitter::builtinQueryText - no built-in query {}", name);
+        return {};
+    }
+    return QString::fromUtf8(file.readAll());
+}
+
+std::shared_ptr<Query> builtinQuery(const QString &name)
+{
+    static QMutex mutex;
+    static std::unordered_map<QString, std::shared_ptr<Query>> queries;
+    {
+        QMutexLocker locker(&mutex);
+        if (auto it = queries.find(name); it != queries.end())
+            return it->second;
+    }
+
+    // Same as the QueryCache, the lock isn't held while compiling
+    const auto *language = builtinQueryLanguage(name);
+    const auto text = builtinQueryText(name);
+    if (!language || text.isEmpty())
+        return {};
+    std::shared_ptr<Query> query;
+    try {
+        query = std::make_shared<Query>(language, text);
+    } catch (const Query::Error &error) {
+        // Can't happen, the queries are checked when building
+        spdlog::error("treesitter::builtinQuery - invalid query {}: {} at {}", name, error.description,
+                      error.utf8_offset);
+        return {};
+    }
+
+    QMutexLocker locker(&mutex);
+    return queries.try_emplace(name, std::move(query)).first->second;
+}
+
+QStringList builtinQueryNames()
+{
+    initResources();
+    QStringList names;
+    QDirIterator it(QueriesPath, {"*.scm"}, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        auto fileName = it.next().mid(qstrlen(QueriesPath));
+        fileName.chop(4);
+        names.push_back(fileName);
+    }
+    names.sort();
+    return names;
+}
+
+} // namespace treesitter
@@ -0,0 +1,36 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include "query.h"
+
+#include <QString>
+#include <memory>
+
+namespace treesitter {
+
+// Queries used by Knut itself, stored as `.scm` files in the `queries/<language>` directory, which are embedded as
+// resources and checked by querycheck when building.
+//
+// A built-in query is compiled the first time it's used, then shared by all documents and threads: unlike the queries
+// of the QueryCache, it's never evicted. Parts changing between two calls (like names) are passed as parameters of the
+// #in? and #like_in? predicates, see the comment at the start of each file.
+//
+// These functions are thread-safe.
+
+// Returns the compiled query `name`, e.g. `cpp/find_include`, or nullptr if there's no such query.
+std::shared_ptr<Query> builtinQuery(const QString &name);
+// Returns the text of the query `name`, to combine it with other queries.
+QString builtinQueryText(const QString &name);
+// Returns the names of all built-in queries, sorted.
+QStringList builtinQueryNames();
+
+} // namespace treesitter
@@ -9,10 +9,9 @@
 */
 
 #include "node.h"
+#include "treecursor.h"
 #include "utils/log.h"
 
-#include <kdalgorithms.h>
-
 namespace treesitter {
 
 Node::Node(const TSNode &node)
@@ -84,31 +83,18 @@ QString Node::fieldNameForChild(const Node &child) const
     // [^2]:
     // https://github.com/tree-sitter/tree-sitter/blob/20924fa4cdeb10d82ac308481e39bf8519334e55/docs/assets/js/playground.js#L178C35-L178C35
 
-    QString result;
-    bool found = false;
-
-    TSTreeCursor cursor = ts_tree_cursor_new(m_node);
-
-    if (ts_tree_cursor_goto_first_child(&cursor)) {
+    TreeCursor cursor(*this);
+    if (cursor.gotoFirstChild()) {
         do {
-            if (Node(ts_tree_cursor_current_node(&cursor)) == child) {
-                found = true;
-
-                if (const auto *name = ts_tree_cursor_current_field_name(&cursor)) {
-                    result = name;
-                }
-                break;
+            if (cursor.currentNode() == child) {
+                const auto *name = cursor.currentFieldName();
+                return name ? QString(name) : QString();
             }
-        } while (ts_tree_cursor_goto_next_sibling(&cursor));
+        } while (cursor.gotoNextSibling());
     }
 
-    ts_tree_cursor_delete(&cursor);
-
-    if (!found) {
-        spdlog::warn("Node::fieldNameForChild - given node is not a child!");
-    }
-
-    return result;
+    spdlog::warn("Node::fieldNameForChild - given node is not a child!");
+    return {};
 }
 
 uint32_t Node::childCount() const
@@ -118,28 +104,35 @@ uint32_t Node::childCount() const
 
 QVector<Node> Node::children() const
 {
-    const auto count = childCount();
     QVector<Node> result;
-    result.reserve(count);
-
-    for (uint32_t i = 0; i < count; i++) {
-        result.emplace_back(Node(ts_node_child(m_node, i)));
-    }
-
+    result.reserve(childCount());
+    for (const auto &child : childRange())
+        result.push_back(child);
     return result;
 }
 
+ChildRange Node::childRange() const
+{
+    return ChildRange(*this, false);
+}
+
 QVector<Node> Node::namedChildren() const
 {
-    const auto count = namedChildCount();
     QVector<Node> result;
-    result.reserve(count);
+    result.reserve(namedChildCount());
+    for (const auto &child : namedChildRange())
+        result.push_back(child);
+    return result;
+}
 
-    for (uint32_t i = 0; i < count; i++) {
-        result.emplace_back(Node(ts_node_named_child(m_node, i)));
-    }
+ChildRange Node::namedChildRange() const
+{
+    return ChildRange(*this, true);
+}
 
-    return result;
+DescendantRange Node::descendants() const
+{
+    return DescendantRange(*this);
 }
 
 uint32_t Node::startPosition() const
@@ -197,40 +190,47 @@ QString Node::textIn(const QString &source) const
 
 QString Node::textExcept(const QString &source, const QVector<QString> &nodeTypes) const
 {
-    auto text = textIn(source);
+    const auto symbols = symbolsForTypes(ts_tree_language(m_node.tree), nodeTypes);
+    return textExcept(source, symbols);
+}
+
+QString Node::textExcept(const QString &source, const QVector<TSSymbol> &symbols) const
+{
+    const auto start = startPosition();
+    const auto end = endPosition();
+    const auto sourceView = QStringView(source);
 
-    auto children = allChildrenOfType(nodeTypes);
-    // make sure to sort the children back-to-front, so that removing them in order
-    // doesn't mess up the ranges of the remaining children.
-    kdalgorithms::sort(children, [](const auto &left, const auto &right) {
-        return left.startPosition() > right.startPosition();
-    });
+    QString text;
+    text.reserve(end - start);
+    auto position = start;
 
-    for (const auto &child : std::as_const(children)) {
-        const auto start = child.startPosition();
-        const auto end = child.endPosition();
-        text.remove(start - this->startPosition(), end - start);
+    const auto range = descendants();
+    for (auto it = range.begin(); it != range.end();) {
+        // Stop at the first node of the given types, so the removed nodes don't overlap and come in order
+        if (const auto child = *it; symbols.contains(ts_node_symbol(child.m_node))) {
+            text.append(sourceView.sliced(position, child.startPosition() - position));
+            position = child.endPosition();
+            it.skipChildren();
+        } else {
+            ++it;
+        }
     }
+    text.append(sourceView.sliced(position, end - position));
 
     return text;
 }
 
-QVector<Node> Node::allChildrenOfType(const QVector<QString> &nodeTypes) const
+QVector<TSSymbol> Node::symbolsForTypes(const TSLanguage *language, const QVector<QString> &nodeTypes)
 {
-    auto result = QVector<Node>();
-
-    const auto allChildren = children();
-    for (const auto &child : allChildren) {
-        // break the recursion at the first node that is of the given type
-        // That way we don't get overlapping child nodes.
-        if (kdalgorithms::contains(nodeTypes, child.type())) {
-            result.push_back(child);
-        } else {
-            result.append(child.allChildrenOfType(nodeTypes));
-        }
+    // Aliases and anonymous nodes can share the name of another symbol, so all the symbols are checked
+    QVector<TSSymbol> symbols;
+    const auto count = ts_language_symbol_count(language);
+    for (uint32_t symbol = 0; symbol < count; ++symbol) {
+        const auto name = QLatin1String(ts_language_symbol_name(language, static_cast<TSSymbol>(symbol)));
+        if (nodeTypes.contains(name))
+            symbols.push_back(static_cast<TSSymbol>(symbol));
     }
-
-    return result;
+    return symbols;
 }
 
 bool Node::operator==(const Node &other) const
@@ -14,11 +14,16 @@
 
 #include <QString>
 #include <QVector>
+#include <cstdint>
+#include <functional>
 
 namespace treesitter {
 
 using Point = TSPoint;
 
+class ChildRange;
+class DescendantRange;
+
 class Node
 {
 public:
@@ -34,11 +39,17 @@ public:
     uint32_t namedChildCount() const;
     Node namedChild(uint32_t index) const;
     QVector<Node> namedChildren() const;
+    // Same as namedChildren, without allocating a vector. Use it when iterating over the children.
+    ChildRange namedChildRange() const;
 
     QString fieldNameForChild(const Node &child) const;
 
     uint32_t childCount() const;
     QVector<Node> children() const;
+    // Same as children, without allocating a vector. Use it when iterating over the children.
+    ChildRange childRange() const;
+    // All the descendants of this node, in depth-first pre-order.
+    DescendantRange descendants() const;
 
     uint32_t startPosition() const;
     uint32_t endPosition() const;
@@ -55,6 +66,11 @@ public:
 
     QString textIn(const QString &source) const;
     QString textExcept(const QString &source, const QVector<QString> &nodeTypes) const;
+    // Same as above, with the node types resolved by symbolsForTypes. Use it when the types are known in advance.
+    QString textExcept(const QString &source, const QVector<TSSymbol> &symbols) const;
+
+    // Returns all the symbols of the language with one of the given node types.
+    static QVector<TSSymbol> symbolsForTypes(const TSLanguage *language, const QVector<QString> &nodeTypes);
 
     Node descendantForRange(uint32_t left, uint32_t right) const;
     Node parent() const;
@@ -64,13 +80,12 @@ public:
 private:
     Node(const TSNode &node);
 
-    QVector<Node> allChildrenOfType(const QVector<QString> &nodeTypes) const;
-
     // TODO: make private again
 public:
     TSNode m_node;
 
     friend class Tree;
+    friend class TreeCursor;
     friend class QueryCursor;
     friend class QueryMatch;
 };
@@ -80,12 +95,15 @@ public:
 template <>
 struct std::hash<treesitter::Node>
 {
+    // Nodes are equal if they have the same id and tree (see ts_node_eq), the context doesn't need to be hashed.
+    // The ids are addresses close to each other for sibling nodes, so the bits are mixed with the splitmix64
+    // finalizer to spread them over all the buckets.
     std::size_t operator()(const treesitter::Node &node) const noexcept
     {
-        std::size_t result = 0;
-        for (unsigned int i : node.m_node.context) {
-            result ^= std::hash<uint32_t> {}(i);
-        }
-        return result ^ std::hash<const void *> {}(node.m_node.id) ^ std::hash<const TSTree *> {}(node.m_node.tree);
+        uint64_t value = reinterpret_cast<uintptr_t>(node.m_node.id)
+            ^ (reinterpret_cast<uintptr_t>(node.m_node.tree) * 0x9e3779b97f4a7c15ull);
+        value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+        value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+        return static_cast<std::size_t>(value ^ (value >> 31));
     }
 };
@@ -10,13 +10,15 @@
 
 #include "parser.h"
 #include "tree.h"
+#include "utils/memoryaccounting.h"
+#include "utils/tracing.h"
 
 #include <tree_sitter/api.h>
 #include <utility>
 
 namespace treesitter {
 
-Parser::Parser(TSLanguage *language)
+Parser::Parser(const TSLanguage *language)
     : m_parser(ts_parser_new())
 {
     ts_parser_set_language(m_parser, language);
@@ -46,15 +48,63 @@ void Parser::swap(Parser &other) noexcept
     std::swap(m_parser, other.m_parser);
 }
 
+static void *treeSitterMalloc(size_t size)
+{
+    return Utils::MemoryAccounting::allocate(Utils::MemoryAccounting::TreeSitter, size);
+}
+
+static void *treeSitterCalloc(size_t count, size_t size)
+{
+    return Utils::MemoryAccounting::allocateZeroed(Utils::MemoryAccounting::TreeSitter, count, size);
+}
+
+static void *treeSitterRealloc(void *pointer, size_t size)
+{
+    return Utils::MemoryAccounting::reallocate(Utils::MemoryAccounting::TreeSitter, pointer, size);
+}
+
+static void treeSitterFree(void *pointer)
+{
+    Utils::MemoryAccounting::deallocate(Utils::MemoryAccounting::TreeSitter, pointer);
+}
+
+void installAllocator()
+{
+    ts_set_allocator(treeSitterMalloc, treeSitterCalloc, treeSitterRealloc, treeSitterFree);
+}
+
 std::optional<Tree> Parser::parseString(const QString &text, const Tree *old_tree) const
 {
+    KNUT_TRACE_SCOPE("Parser::parseString");
     auto tree =
         ts_parser_parse_string_encoding(m_parser, old_tree ? old_tree->m_tree : nullptr, (const char *)text.constData(),
                                         static_cast<uint32_t>(text.size() * sizeof(QChar)), TSInputEncodingUTF16);
 
     // TreeSitter may return a nullptr. See: https://tree-sitter.docsforge.com/master/api/ts_parser_parse/
     // In this case, return an empty optional.
-    return tree ? Tree(tree) : std::optional<Tree> {};
+    if (!tree) {
+        // After a timeout or a cancellation, the parser would otherwise resume the same parse next time.
+        ts_parser_reset(m_parser);
+        return {};
+    }
+    return Tree(tree);
+}
+
+void Parser::setTimeout(std::chrono::microseconds timeout)
+{
+    ts_parser_set_timeout_micros(m_parser, static_cast<uint64_t>(timeout.count()));
+}
+
+std::chrono::microseconds Parser::timeout() const
+{
+    return std::chrono::microseconds(ts_parser_timeout_micros(m_parser));
+}
+
+void Parser::setCancellationFlag(const std::atomic<size_t> *flag)
+{
+    static_assert(sizeof(std::atomic<size_t>) == sizeof(size_t) && std::atomic<size_t>::is_always_lock_free);
+    // Tree-sitter reads the flag atomically
+    ts_parser_set_cancellation_flag(m_parser, reinterpret_cast<const size_t *>(flag));
 }
 
 const TSLanguage *Parser::language() const
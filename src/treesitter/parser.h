@@ -11,6 +11,8 @@
 #pragma once
 
 #include <QString>
+#include <atomic>
+#include <chrono>
 
 struct TSParser;
 struct TSLanguage;
@@ -19,10 +21,13 @@ namespace treesitter {
 
 class Tree;
 
+// Accounts the memory allocated by tree-sitter in Utils::MemoryAccounting, should be called before any parse
+void installAllocator();
+
 class Parser
 {
 public:
-    Parser(TSLanguage *language);
+    Parser(const TSLanguage *language);
 
     Parser(const Parser &) = delete;
     Parser(Parser &&) noexcept;
@@ -34,8 +39,17 @@ public:
 
     void swap(Parser &other) noexcept;
 
+    // Returns an empty optional if the parse failed, timed out or was cancelled.
     std::optional<Tree> parseString(const QString &text, const Tree *old_tree = nullptr) const;
 
+    // Maximum duration of a parse, 0 means no limit.
+    void setTimeout(std::chrono::microseconds timeout);
+    std::chrono::microseconds timeout() const;
+
+    // Parsing stops as soon as the value pointed to by `flag` is non-zero, it may be set from another thread.
+    // The flag must outlive the parser, or be reset with setCancellationFlag(nullptr).
+    void setCancellationFlag(const std::atomic<size_t> *flag);
+
     const TSLanguage *language() const;
 
 private:
@@ -0,0 +1,82 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "parserpool.h"
+
+#include <QMutexLocker>
+
+namespace treesitter {
+
+ParserPool::Lease::Lease(ParserPool *pool, const TSLanguage *language, Parser &&parser)
+    : m_pool(pool)
+    , m_language(language)
+    , m_parser(std::move(parser))
+{
+}
+
+ParserPool::Lease::Lease(Lease &&other) noexcept
+    : m_pool(other.m_pool)
+    , m_language(other.m_language)
+    , m_parser(std::move(other.m_parser))
+{
+    other.m_parser.reset();
+}
+
+ParserPool::Lease::~Lease()
+{
+    if (m_parser)
+        m_pool->release(m_language, std::move(m_parser.value()));
+}
+
+ParserPool &ParserPool::instance()
+{
+    static ParserPool pool;
+    return pool;
+}
+
+ParserPool::Lease ParserPool::acquire(const TSLanguage *language)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        auto &parsers = m_parsers[language];
+        if (!parsers.empty()) {
+            auto parser = std::move(parsers.back());
+            parsers.pop_back();
+            return Lease(this, language, std::move(parser));
+        }
+    }
+
+    return Lease(this, language, Parser(language));
+}
+
+void ParserPool::release(const TSLanguage *language, Parser &&parser)
+{
+    // Limits are set per parse, don't leak them to the next user
+    parser.setTimeout({});
+    parser.setCancellationFlag(nullptr);
+
+    QMutexLocker locker(&m_mutex);
+    m_parsers[language].push_back(std::move(parser));
+}
+
+void ParserPool::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_parsers.clear();
+}
+
+int ParserPool::idleCount(const TSLanguage *language) const
+{
+    QMutexLocker locker(&m_mutex);
+    const auto it = m_parsers.find(language);
+    return it == m_parsers.cend() ? 0 : static_cast<int>(it->second.size());
+}
+
+} // namespace treesitter
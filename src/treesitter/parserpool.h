@@ -0,0 +1,76 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include "parser.h"
+
+#include <QMutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+struct TSLanguage;
+
+namespace treesitter {
+
+// Process-wide pool of parsers, indexed by language.
+//
+// A parser is only needed during a parse, so there's no need for each document to own one. Parsers are borrowed from
+// the pool for the duration of a parse, and given back afterward. The pool then only contains as many parsers per
+// language as there were parses running at the same time.
+//
+// This class is thread-safe, a borrowed parser must not be shared between threads.
+class ParserPool
+{
+public:
+    // A parser borrowed from the pool, given back to the pool on destruction.
+    class Lease
+    {
+    public:
+        Lease(const Lease &) = delete;
+        Lease(Lease &&other) noexcept;
+        ~Lease();
+
+        Lease &operator=(const Lease &) = delete;
+        Lease &operator=(Lease &&) = delete;
+
+        Parser &operator*() { return *m_parser; }
+        Parser *operator->() { return &m_parser.value(); }
+
+    private:
+        Lease(ParserPool *pool, const TSLanguage *language, Parser &&parser);
+
+        ParserPool *m_pool;
+        const TSLanguage *m_language;
+        std::optional<Parser> m_parser;
+
+        friend class ParserPool;
+    };
+
+    static ParserPool &instance();
+
+    Lease acquire(const TSLanguage *language);
+
+    void clear();
+
+    // Number of parsers in the pool, not counting the borrowed ones.
+    int idleCount(const TSLanguage *language) const;
+
+private:
+    ParserPool() = default;
+
+    void release(const TSLanguage *language, Parser &&parser);
+
+    mutable QMutex m_mutex;
+    std::unordered_map<const TSLanguage *, std::vector<Parser>> m_parsers;
+};
+
+} // namespace treesitter
@@ -10,10 +10,11 @@
 
 #include "predicates.h"
 
-#include "languages.h"
+#include "builtinqueries.h"
 
 #include "kdalgorithms.h"
 #include "utils/log.h"
+#include "utils/tracing.h"
 
 #include <ranges>
 #include <set>
@@ -34,47 +35,56 @@ QString QString_no_whitespace(const QString &string)
     return simplified;
 }
 
-Predicates::Filters Predicates::filters()
+const Predicates::Filters &Predicates::filters()
 {
-    Predicates::Filters filters;
+    static const Predicates::Filters filters = []() {
+        Predicates::Filters filters;
 #define REGISTER_FILTER(NAME)                                                                                          \
     filters.filterFunctions[#NAME "?"] = &Predicates::filter_##NAME;                                                   \
     filters.checkFunctions[#NAME "?"] = &Predicates::checkFilter_##NAME
 
-    REGISTER_FILTER(eq);
-    REGISTER_FILTER(eq_except);
-    REGISTER_FILTER(like);
-    REGISTER_FILTER(like_except);
-    REGISTER_FILTER(match);
-    REGISTER_FILTER(in_message_map);
-    REGISTER_FILTER(not_is);
+        REGISTER_FILTER(eq);
+        REGISTER_FILTER(eq_except);
+        REGISTER_FILTER(like);
+        REGISTER_FILTER(like_except);
+        REGISTER_FILTER(match);
+        REGISTER_FILTER(in_message_map);
+        REGISTER_FILTER(not_is);
+        REGISTER_FILTER(in);
+        REGISTER_FILTER(like_in);
 #undef REGISTER_FILTER
+        return filters;
+    }();
 
     return filters;
 }
 
-Predicates::Commands Predicates::commands()
+const Predicates::Commands &Predicates::commands()
 {
-    Predicates::Commands commands;
+    static const Predicates::Commands commands = []() {
+        Predicates::Commands commands;
 
 #define REGISTER_COMMAND(NAME)                                                                                         \
     commands.commandFunctions[#NAME "!"] = &Predicates::command_##NAME;                                                \
     commands.checkFunctions[#NAME "!"] = &Predicates::checkCommand_##NAME;
 
-    REGISTER_COMMAND(exclude)
+        REGISTER_COMMAND(exclude)
 #undef REGISTER_COMMAND
+        return commands;
+    }();
+
     return commands;
 }
 
 std::optional<QString> Predicates::checkPredicate(const Query::Predicate &predicate)
 {
-    const auto filters = Predicates::filters();
+    const auto &filters = Predicates::filters();
     auto it = filters.checkFunctions.find(predicate.name);
     if (it != filters.checkFunctions.cend()) {
         return it->second(predicate.arguments);
     }
 
-    const auto commands = Predicates::commands();
+    const auto &commands = Predicates::commands();
     it = commands.checkFunctions.find(predicate.name);
     if (it != commands.checkFunctions.cend()) {
         return it->second(predicate.arguments);
@@ -83,39 +93,54 @@ std::optional<QString> Predicates::checkPredicate(const Query::Predicate &predic
     return "Unknown predicate";
 }
 
-Predicates::Predicates(QString source)
+void Predicates::compilePredicate(Query::Predicate &predicate, const TSLanguage *language)
+{
+    const auto &filters = Predicates::filters();
+    if (auto it = filters.filterFunctions.find(predicate.name); it != filters.filterFunctions.cend())
+        predicate.filter = it->second;
+
+    const auto &commands = Predicates::commands();
+    if (auto it = commands.commandFunctions.find(predicate.name); it != commands.commandFunctions.cend())
+        predicate.command = it->second;
+
+    if (predicate.filter == &Predicates::filter_match) {
+        predicate.regex.setPattern(std::get<QString>(predicate.arguments.first()));
+        predicate.regex.optimize();
+    }
+
+    if (predicate.filter == &Predicates::filter_eq_except || predicate.filter == &Predicates::filter_like_except) {
+        // The node types are the arguments after the expected string and the capture
+        QVector<QString> types;
+        for (const auto &argument : predicate.arguments.sliced(2))
+            types.push_back(std::get<QString>(argument));
+        predicate.symbols = Node::symbolsForTypes(language, types);
+    }
+}
+
+Predicates::Predicates(QString source, Parameters parameters)
     : m_source(std::move(source))
+    , m_parameters(std::move(parameters))
 {
 }
 
 void Predicates::executeCommands(QueryMatch &match) const
 {
-    const auto patterns = match.query()->patterns();
-    const auto &pattern = patterns.at(match.patternIndex());
+    const auto &pattern = match.query()->patterns().at(match.patternIndex());
 
     for (const auto &predicate : pattern.predicates) {
-        const auto commands = Predicates::commands();
-        const auto it = commands.commandFunctions.find(predicate.name);
-        if (it != commands.commandFunctions.cend()) {
-            const auto commandPredicate = it->second;
-            (this->*(commandPredicate))(match, predicate.arguments);
-        }
+        if (predicate.command)
+            (this->*(predicate.command))(match, predicate);
     }
 }
 
 bool Predicates::filterMatch(const QueryMatch &match) const
 {
-    const auto patterns = match.query()->patterns();
-    const auto &pattern = patterns.at(match.patternIndex());
+    KNUT_TRACE_SCOPE("Predicates::filterMatch");
+    const auto &pattern = match.query()->patterns().at(match.patternIndex());
 
     for (const auto &predicate : pattern.predicates) {
-        const auto filters = Predicates::filters();
-        const auto it = filters.filterFunctions.find(predicate.name);
-        if (it != filters.filterFunctions.cend()) {
-            const auto filterPredicate = it->second;
-            if (!(this->*(filterPredicate))(match, predicate.arguments)) {
-                return false;
-            }
+        if (predicate.filter && !(this->*(predicate.filter))(match, predicate)) {
+            return false;
         }
     }
 
@@ -145,8 +170,9 @@ std::optional<QString> Predicates::checkCommand_exclude(const Predicates::Predic
     return {};
 }
 
-void Predicates::command_exclude(QueryMatch &match, const Predicates::PredicateArguments &arguments) const
+void Predicates::command_exclude(QueryMatch &match, const Query::Predicate &predicate) const
 {
+    const auto &arguments = predicate.arguments;
     auto to_string = [](const auto &variant) {
         return std::get<QString>(variant);
     };
@@ -207,10 +233,9 @@ bool Predicates::filter_eq_with(const QueryMatch &match,
     return texts.size() == 1;
 }
 
-bool Predicates::filter_eq(const QueryMatch &match,
-                           const QVector<std::variant<Query::Capture, QString>> &arguments) const
+bool Predicates::filter_eq(const QueryMatch &match, const Query::Predicate &predicate) const
 {
-    return filter_eq_with(match, arguments, QString_identity);
+    return filter_eq_with(match, predicate.arguments, QString_identity);
 }
 
 std::optional<QString> Predicates::checkFilter_eq_except(const Predicates::PredicateArguments &arguments)
@@ -239,71 +264,48 @@ std::optional<QString> Predicates::checkFilter_eq_except(const Predicates::Predi
     return {};
 }
 
-bool Predicates::filter_like(const QueryMatch &match,
-                             const QVector<std::variant<Query::Capture, QString>> &arguments) const
+bool Predicates::filter_like(const QueryMatch &match, const Query::Predicate &predicate) const
 {
-    return filter_eq_with(match, arguments, QString_no_whitespace);
+    return filter_eq_with(match, predicate.arguments, QString_no_whitespace);
 }
-bool Predicates::filter_eq_except_with(const QueryMatch &match,
-                                       const QVector<std::variant<Query::Capture, QString>> &arguments,
+bool Predicates::filter_eq_except_with(const QueryMatch &match, const Query::Predicate &predicate,
                                        const std::function<QString(const QString &)> &textTransform) const
 {
-    auto args = arguments;
-    if (const auto *rawExpected = std::get_if<QString>(&args.front())) {
-        auto expected = textTransform(*rawExpected);
-        args.pop_front();
-        if (const auto *rawCapture = std::get_if<Query::Capture>(&args.front())) {
-            // we need to copy the capture here, as otherwise it might get dropped
-            // when we pop_front() on args
-            auto capture = *rawCapture;
-            args.pop_front();
-
-            auto types = QVector<QString>();
-            for (const auto &arg : std::as_const(args)) {
-                if (const auto *type = std::get_if<QString>(&arg)) {
-                    types.push_back(*type);
-                }
-            }
-
-            const auto idCaptures = match.capturesWithId(capture.id);
-            if (idCaptures.isEmpty()) {
-                spdlog::warn("Predicates: #eq_except? - No captures");
-                // Insert an empty string into the set if we find an unmatched capture.
-                // This likely means we have encountered a quantified capture that matched 0 times.
-                // So check whether the expected string is also empty
-                return expected.isEmpty();
-            }
-
-            for (const auto &idCapture : idCaptures) {
-                if (expected != textTransform(idCapture.node.textExcept(m_source, types))) {
-                    return false;
-                }
-            }
+    // The arguments are checked by checkFilter_eq_except: the expected string, the capture, then the node types
+    const auto expected = textTransform(std::get<QString>(predicate.arguments.at(0)));
+    const auto &capture = std::get<Query::Capture>(predicate.arguments.at(1));
+
+    const auto idCaptures = match.capturesWithId(capture.id);
+    if (idCaptures.isEmpty()) {
+        spdlog::warn("Predicates: #eq_except? - No captures");
+        // Insert an empty string into the set if we find an unmatched capture.
+        // This likely means we have encountered a quantified capture that matched 0 times.
+        // So check whether the expected string is also empty
+        return expected.isEmpty();
+    }
 
-            return true;
-        } else {
-            spdlog::warn("Predicates: #eq_except? - Expected Capture argument");
+    for (const auto &idCapture : idCaptures) {
+        if (expected != textTransform(idCapture.node.textExcept(m_source, predicate.symbols))) {
             return false;
         }
-    } else {
-        spdlog::warn("Predicates: #eq_except? - Non-string expected argument");
-        return false;
     }
+
+    return true;
 }
 
-bool Predicates::filter_eq_except(const QueryMatch &match, const PredicateArguments &arguments) const
+bool Predicates::filter_eq_except(const QueryMatch &match, const Query::Predicate &predicate) const
 {
-    return filter_eq_except_with(match, arguments, QString_identity);
+    return filter_eq_except_with(match, predicate, QString_identity);
 }
 
-bool Predicates::filter_like_except(const QueryMatch &match, const PredicateArguments &arguments) const
+bool Predicates::filter_like_except(const QueryMatch &match, const Query::Predicate &predicate) const
 {
-    return filter_eq_except_with(match, arguments, QString_no_whitespace);
+    return filter_eq_except_with(match, predicate, QString_no_whitespace);
 }
 
-bool Predicates::filter_not_is(const QueryMatch &match, const PredicateArguments &arguments) const
+bool Predicates::filter_not_is(const QueryMatch &match, const Query::Predicate &predicate) const
 {
-    const auto matched = matchArguments(match, arguments);
+    const auto matched = matchArguments(match, predicate.arguments);
 
     auto captures = QVector<QueryMatch::Capture>();
     auto types = QVector<QString>();
@@ -382,108 +384,171 @@ std::optional<QString> Predicates::checkFilter_not_is(const Predicates::Predicat
     return std::nullopt;
 }
 
-bool Predicates::filter_match(const QueryMatch &match,
-                              const QVector<std::variant<Query::Capture, QString>> &arguments) const
+bool Predicates::filter_match(const QueryMatch &match, const Query::Predicate &predicate) const
 {
-    const auto matched = matchArguments(match, arguments);
-
-    if (arguments.size() < 2) {
+    // The regex is compiled with the query, the first argument is the regex string
+    const auto &regex = predicate.regex;
+    if (!regex.isValid()) {
+        spdlog::warn("Predicates: #match? - Invalid regex");
         return false;
     }
 
-    if (const auto regexString = std::get_if<QString>(&matched.first())) {
-        const QRegularExpression regex(*regexString);
-        if (!regex.isValid()) {
-            spdlog::warn("Predicates: #match? - Invalid regex");
-            return false;
-        }
-
-        for (const auto &argument : matched | std::views::drop(1)) {
-            if (const auto *capture = std::get_if<QueryMatch::Capture>(&argument)) {
-                auto source = capture->node.textIn(m_source);
-                if (!regex.match(source).hasMatch()) {
-                    return false;
-                }
-            } else if (std::holds_alternative<MissingCapture>(argument)) {
+    for (const auto &argument : predicate.arguments | std::views::drop(1)) {
+        if (const auto *captureArgument = std::get_if<Query::Capture>(&argument)) {
+            const auto captures = match.capturesWithId(captureArgument->id);
+            if (captures.isEmpty()) {
                 spdlog::warn("Predicates: #match? - Unmatched capture argument");
                 return false;
-            } else {
-                spdlog::warn("Predicates: #match? - Argument is not a capture");
-                return false;
             }
+            for (const auto &capture : captures) {
+                if (!regex.match(capture.node.textIn(m_source)).hasMatch()) {
+                    return false;
+                }
+            }
+        } else {
+            spdlog::warn("Predicates: #match? - Argument is not a capture");
+            return false;
         }
-    } else {
-
-        spdlog::warn("Predicates: #match? - First argument is not a string");
-        return false;
     }
 
     return true;
 }
 
-void Predicates::insertCache(std::unique_ptr<PredicateCache> cache) const
+std::optional<QString> Predicates::checkFilter_in(const Predicates::PredicateArguments &arguments)
 {
-    m_caches.emplace_back(std::move(cache));
+    if (arguments.size() != 2) {
+        return "Expected a capture and a parameter name";
+    }
+    if (!std::holds_alternative<Query::Capture>(arguments.first())) {
+        return "First argument must be a capture";
+    }
+    if (!std::holds_alternative<QString>(arguments.last())) {
+        return "Second argument must be a parameter name";
+    }
+    return {};
 }
 
-class MessageMapCache : public PredicateCache
+std::optional<QString> Predicates::checkFilter_like_in(const Predicates::PredicateArguments &arguments)
 {
-public:
-    MessageMapCache(const Node &begin, const Node &end)
-        : m_begin(begin)
-        , m_end(end)
-    {
+    return Predicates::checkFilter_in(arguments);
+}
+
+bool Predicates::filter_in_with(const QueryMatch &match, const Query::Predicate &predicate,
+                                const QSet<QString> &values,
+                                const std::function<QString(const QString &)> &textTransform) const
+{
+    const auto &captureArgument = std::get<Query::Capture>(predicate.arguments.first());
+    const auto captures = match.capturesWithId(captureArgument.id);
+    // Like #eq?, a quantified capture that matched 0 times is considered empty
+    if (captures.isEmpty())
+        return values.contains(QString());
+
+    return std::ranges::all_of(captures, [&](const auto &capture) {
+        return values.contains(textTransform(capture.node.textIn(m_source)));
+    });
+}
+
+const QSet<QString> *Predicates::parameter(const QString &name) const
+{
+    const auto it = m_parameters.find(name);
+    if (it == m_parameters.cend()) {
+        spdlog::warn("Predicates: Unknown parameter '{}'", name);
+        return nullptr;
     }
+    return &it->second;
+}
+
+bool Predicates::filter_in(const QueryMatch &match, const Query::Predicate &predicate) const
+{
+    const auto *values = parameter(std::get<QString>(predicate.arguments.last()));
+    return values && filter_in_with(match, predicate, *values, QString_identity);
+}
 
-    ~MessageMapCache() override = default;
+// Parameters without whitespace, computed once per cursor for the #like_in? filter
+class LikeParametersCache : public PredicateCache
+{
+public:
+    ~LikeParametersCache() override = default;
 
-    Node m_begin;
-    Node m_end;
+    std::unordered_map<QString, QSet<QString>> m_values;
 };
 
-void Predicates::findMessageMap() const
+const QSet<QString> *Predicates::likeParameter(const QString &name) const
 {
-    if (findCache<MessageMapCache>()) {
-        // Already found it!
-        return;
+    auto *cache = findCache<LikeParametersCache>();
+    if (!cache) {
+        insertCache(std::make_unique<LikeParametersCache>());
+        cache = findCache<LikeParametersCache>();
     }
 
-    if (!m_rootNode.has_value()) {
-        spdlog::warn("Predicates::findMessageMap: No rootNode!");
-        return;
-    }
+    if (const auto it = cache->m_values.find(name); it != cache->m_values.cend())
+        return &it->second;
+
+    const auto *values = parameter(name);
+    if (!values)
+        return nullptr;
+    QSet<QString> likeValues;
+    likeValues.reserve(values->size());
+    for (const auto &value : *values)
+        likeValues.insert(QString_no_whitespace(value));
+    return &cache->m_values.emplace(name, std::move(likeValues)).first->second;
+}
+
+bool Predicates::filter_like_in(const QueryMatch &match, const Query::Predicate &predicate) const
+{
+    const auto *values = likeParameter(std::get<QString>(predicate.arguments.last()));
+    return values && filter_in_with(match, predicate, *values, QString_no_whitespace);
+}
 
+void Predicates::insertCache(std::unique_ptr<PredicateCache> cache) const
+{
+    m_caches.emplace_back(std::move(cache));
+}
+
+std::optional<Predicates::MessageMapRange> Predicates::findMessageMap(const Node &root, const QString &source)
+{
     // This variable is "static" because Query construction is actually a non-trivial task.
     // We don't want to construct the query every time we call this function, as it's always the same query anyway.
     //
     // This has caused performance problems in the past, when combined with the ScriptSuggestions model, which queries
     // after every keystroke.
-    static auto query = std::make_shared<Query>(tree_sitter_cpp() /*in_message_map only makes sense in C++*/, R"EOF(
-(
-(expression_statement
-    (call_expression
-        function: (identifier) @begin (#eq? @begin "BEGIN_MESSAGE_MAP")
-        arguments: (argument_list . (_) @class)))
-.
-(expression_statement)*
-.
-(expression_statement (call_expression
-    function: (identifier) @end (#eq? @end "END_MESSAGE_MAP")))
-)
-    )EOF");
+    static const auto query = builtinQuery("cpp/message_map_range");
+    if (!query)
+        return {};
 
     QueryCursor cursor;
-    cursor.execute(query, *m_rootNode, std::make_unique<Predicates>(m_source));
+    cursor.execute(query, root, std::make_unique<Predicates>(source));
 
     auto match = cursor.nextMatch();
     if (match.has_value()) {
         auto begin = match->capturesNamed("begin");
         auto end = match->capturesNamed("end");
 
-        if (!begin.isEmpty() && !end.isEmpty()) {
-            insertCache(std::make_unique<MessageMapCache>(begin.first().node, end.first().node));
-        }
+        if (!begin.isEmpty() && !end.isEmpty())
+            return MessageMapRange {begin.first().node.endPosition(), end.first().node.startPosition()};
+    }
+    return {};
+}
+
+void Predicates::setMessageMapProvider(MessageMapProvider provider)
+{
+    m_messageMapProvider = std::move(provider);
+}
+
+std::optional<Predicates::MessageMapRange> Predicates::messageMap() const
+{
+    if (m_messageMap)
+        return *m_messageMap;
+
+    if (m_messageMapProvider) {
+        m_messageMap = m_messageMapProvider();
+    } else if (m_rootNode.has_value()) {
+        m_messageMap = findMessageMap(*m_rootNode, m_source);
+    } else {
+        spdlog::warn("Predicates::messageMap: No rootNode!");
+        return {};
     }
+    return *m_messageMap;
 }
 
 std::optional<QString> Predicates::checkFilter_in_message_map(const Predicates::PredicateArguments &arguments)
@@ -501,17 +566,15 @@ std::optional<QString> Predicates::checkFilter_in_message_map(const Predicates::
     return {};
 }
 
-bool Predicates::filter_in_message_map(const QueryMatch &match, const PredicateArguments &arguments) const
+bool Predicates::filter_in_message_map(const QueryMatch &match, const Query::Predicate &predicate) const
 {
-    findMessageMap();
-
-    if (const auto *message_map = findCache<MessageMapCache>()) {
-        const auto matched = matchArguments(match, arguments);
+    if (const auto message_map = messageMap()) {
+        const auto matched = matchArguments(match, predicate.arguments);
 
         for (const auto &argument : matched) {
             if (const auto capture = std::get_if<QueryMatch::Capture>(&argument)) {
-                if (!(message_map->m_begin.endPosition() <= capture->node.startPosition()
-                      && capture->node.endPosition() <= message_map->m_end.startPosition())) {
+                if (!(message_map->start <= capture->node.startPosition()
+                      && capture->node.endPosition() <= message_map->end)) {
                     // We're outside of the message map
                     return false;
                 }
@@ -13,7 +13,11 @@
 #include "node.h"
 #include "query.h"
 
+#include <QSet>
 #include <QString>
+#include <functional>
+#include <optional>
+#include <unordered_map>
 
 namespace treesitter {
 
@@ -38,7 +42,7 @@ class Predicates
     using PredicateArguments = QVector<std::variant<Query::Capture, QString>>;
     struct Filters
     {
-        std::unordered_map<QString, bool (Predicates::*)(const QueryMatch &, const PredicateArguments &) const>
+        std::unordered_map<QString, bool (Predicates::*)(const QueryMatch &, const Query::Predicate &) const>
             filterFunctions;
 
         std::unordered_map<QString, std::optional<QString> (*)(const PredicateArguments &)> checkFunctions;
@@ -47,18 +51,38 @@ class Predicates
     struct Commands
     {
         std::unordered_map<QString, std::optional<QString> (*)(const PredicateArguments &)> checkFunctions;
-        std::unordered_map<QString, void (Predicates::*)(QueryMatch &, const PredicateArguments &) const>
+        std::unordered_map<QString, void (Predicates::*)(QueryMatch &, const Query::Predicate &) const>
             commandFunctions;
     };
 
-    static Filters filters();
-    static Commands commands();
+    static const Filters &filters();
+    static const Commands &commands();
 
 public:
-    explicit Predicates(QString source);
+    // Named sets of strings, used by the #in? and #like_in? filters to match a capture against many strings at once.
+    // Compared to generating one query per string, the query stays the same and is only compiled once.
+    using Parameters = std::unordered_map<QString, QSet<QString>>;
+
+    // Byte range between the BEGIN_MESSAGE_MAP and END_MESSAGE_MAP macros of an MFC source file
+    struct MessageMapRange
+    {
+        uint32_t start;
+        uint32_t end;
+    };
+    using MessageMapProvider = std::function<std::optional<MessageMapRange>()>;
+
+    explicit Predicates(QString source, Parameters parameters = {});
+
+    // Searches the message map in the tree of `source`, used by #in_message_map?
+    static std::optional<MessageMapRange> findMessageMap(const Node &root, const QString &source);
+    // Uses `provider` to get the message map, instead of searching it again for each Predicates instance.
+    // The provider can cache it, for example as long as the document doesn't change.
+    void setMessageMapProvider(MessageMapProvider provider);
 
     // Returns an error message if the predicate is not supported
     static std::optional<QString> checkPredicate(const Query::Predicate &predicate);
+    // Resolves the predicate function and precompiles its arguments, the predicate must be valid.
+    static void compilePredicate(Query::Predicate &predicate, const TSLanguage *language);
 
     // Executes all command-predicates (e.g. exclude!) on the match.
     void executeCommands(QueryMatch &match) const;
@@ -69,7 +93,7 @@ public:
 private:
     // ################# Commands #########################
 #define PREDICATE_COMMAND(NAME)                                                                                        \
-    void command_##NAME(QueryMatch &match, const PredicateArguments &arguments) const;                                 \
+    void command_##NAME(QueryMatch &match, const Query::Predicate &predicate) const;                                  \
     static std::optional<QString> checkCommand_##NAME(const PredicateArguments &arguments);
 
     PREDICATE_COMMAND(exclude)
@@ -77,7 +101,7 @@ private:
 
     // ################## Filters #########################
 #define PREDICATE_FILTER(NAME)                                                                                         \
-    bool filter_##NAME(const QueryMatch &match, const PredicateArguments &arguments) const;                            \
+    bool filter_##NAME(const QueryMatch &match, const Query::Predicate &predicate) const;                             \
     static std::optional<QString> checkFilter_##NAME(const PredicateArguments &arguments)
 
     PREDICATE_FILTER(eq);
@@ -87,12 +111,18 @@ private:
     PREDICATE_FILTER(match);
     PREDICATE_FILTER(in_message_map);
     PREDICATE_FILTER(not_is);
+    PREDICATE_FILTER(in);
+    PREDICATE_FILTER(like_in);
 #undef PREDICATE_FILTER
 
     bool filter_eq_with(const QueryMatch &match, const QVector<std::variant<Query::Capture, QString>> &arguments,
                         const std::function<QString(const QString &)> &textTransform) const;
-    bool filter_eq_except_with(const QueryMatch &match, const QVector<std::variant<Query::Capture, QString>> &arguments,
+    bool filter_eq_except_with(const QueryMatch &match, const Query::Predicate &predicate,
                                const std::function<QString(const QString &)> &textTransform) const;
+    bool filter_in_with(const QueryMatch &match, const Query::Predicate &predicate, const QSet<QString> &values,
+                        const std::function<QString(const QString &)> &textTransform) const;
+    const QSet<QString> *parameter(const QString &name) const;
+    const QSet<QString> *likeParameter(const QString &name) const;
 
     // ################## Argument matching #########################
     // Marker type indicating a capture is missing
@@ -120,13 +150,17 @@ private:
 
     void insertCache(std::unique_ptr<PredicateCache>) const;
 
-    void findMessageMap() const;
+    std::optional<MessageMapRange> messageMap() const;
+    MessageMapProvider m_messageMapProvider;
+    // Set once the message map has been searched, even if there is none
+    mutable std::optional<std::optional<MessageMapRange>> m_messageMap;
 
     // ################## Context data #########################
     friend class QueryCursor;
     void setRootNode(const Node &node);
 
     const QString m_source;
+    const Parameters m_parameters;
     std::optional<Node> m_rootNode;
 };
 
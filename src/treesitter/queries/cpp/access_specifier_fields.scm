@@ -0,0 +1,6 @@
+; Fields of an access specifier section in a class body
+; Parameters: "specifiers" - the access specifiers to look for (public, protected or private)
+(field_declaration_list
+    (access_specifier) @access (#in? @access "specifiers")
+    . [(declaration) (comment) (field_declaration)]* @field
+)
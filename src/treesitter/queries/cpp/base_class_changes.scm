@@ -0,0 +1,18 @@
+; Base classes of class definitions, and method definitions, used by Project::changeBaseClasses
+[(class_specifier
+    name: (_) @class-name
+    (base_class_clause
+        [(type_identifier) @base _]*)
+    body: (_))
+(struct_specifier
+    name: (_) @class-name
+    (base_class_clause
+        [(type_identifier) @base _]*)
+    body: (_))]
+
+(function_definition
+    declarator: (function_declarator
+        declarator: (qualified_identifier
+            scope: (_) @scope
+            name: (_) @name))
+    body: (_) @body) @definition
@@ -0,0 +1,4 @@
+; All children of a class body
+(field_declaration_list
+    (_)@pos
+)
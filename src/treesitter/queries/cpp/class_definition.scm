@@ -0,0 +1,12 @@
+; Classes or structs
+; Parameters: "names" - the names of the classes, whitespace is ignored
+[(class_specifier
+    name: (_) @name (#like_in? @name "names")
+    (base_class_clause
+        [(type_identifier) @base _]*)?
+    body: (_) @body)
+(struct_specifier
+    name: (_) @name (#like_in? @name "names")
+    (base_class_clause
+        [(type_identifier) @base _]*)?
+    body: (_) @body)]
@@ -0,0 +1,9 @@
+; MFC DDV calls, used in DoDataExchange
+(expression_statement
+    (call_expression
+        function: (identifier) @ddv-function(#match? "^DDV_" @ddv-function)
+        arguments: (argument_list
+            (_)* ","
+            (_)* @ddv-member ","
+            ((_) ","?)* @ddv-arguments
+            (#exclude! @ddv-arguments @ddv-member comment)))) @ddv
@@ -0,0 +1,9 @@
+; MFC DDX calls, used in DoDataExchange
+(expression_statement
+    (call_expression
+        function: (identifier) @ddx-function(#match? "^DDX_" @ddx-function)
+        arguments: (argument_list
+            (_)* "," ; The CDataExchange* pDX argument
+            (_)* @ddx-idc ","
+            (_)* @ddx-member
+            (#exclude! @ddx-idc @ddx-member comment)))) @ddx
@@ -0,0 +1,10 @@
+; Include guard of a header
+(translation_unit
+    (preproc_ifdef
+        "#ifndef"
+        name: (_) @name
+        (preproc_def
+            name: (_) @value (#eq? @name @value)
+        )
+    )
+)
@@ -0,0 +1,4 @@
+; Includes of the file
+(preproc_include
+    path: (_) @path
+)
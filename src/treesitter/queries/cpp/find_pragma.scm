@@ -0,0 +1,6 @@
+; #pragma once of a header
+(translation_unit
+    (preproc_call
+        argument: (_) @value (#match? "once" @value)
+    )
+)
@@ -0,0 +1,8 @@
+; Function calls, with all their arguments
+; Parameters: "names" - the names of the functions
+(call_expression
+    function: (_) @name (#in? @name "names")
+    arguments: (argument_list
+            [(_) @arguments ","]* (#exclude! @arguments comment)
+        ) @argument-list
+) @call
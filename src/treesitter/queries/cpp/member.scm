@@ -0,0 +1,11 @@
+; Members of a class body, handles Type, Type *, Type &, Type *&, Type &* and Type **
+; Parameters: "names" - the names of the members
+(field_declaration
+    type: (_) @type
+    [
+        declarator: (_ (_ (field_identifier) @name ) )
+        declarator: (_ (field_identifier) @name )
+        declarator: (field_identifier) @name
+    ]
+    (#in? @name "names")
+) @member
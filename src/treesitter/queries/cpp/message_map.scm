@@ -0,0 +1,63 @@
+; MFC message map entries, from BEGIN_MESSAGE_MAP to END_MESSAGE_MAP
+; Assumption: the MESSAGE_MAP is either top-level or in a namespace
+; Parenthesis are used to make sure nodes are siblings
+(translation_unit
+    [
+        (namespace_definition (_ (
+            ; Search for BEGIN_MESSAGE_MAP
+            (expression_statement
+                (call_expression
+                    function: (identifier) @begin_ident
+                    (#eq? @begin_ident "BEGIN_MESSAGE_MAP")
+                    arguments: (argument_list
+                            (identifier) @class
+                            (identifier) @superclass)) @begin)
+
+            ; Followed by one or more entries
+            [
+            (expression_statement
+                (call_expression
+                    function: (identifier) @message-name
+                    arguments: (argument_list
+                        [(_)* @parameter ","]*
+                        (#exclude! @parameter comment))
+            ))@message
+            (_)
+            ]*
+
+            ; Ending with END_MESSAGE_MAP
+            (expression_statement
+                (call_expression
+                    function: (identifier) @end_ident
+                    (#eq? @end_ident "END_MESSAGE_MAP")) @end)
+        ) ) )
+        (
+            ; Search for BEGIN_MESSAGE_MAP
+            (expression_statement
+                (call_expression
+                    function: (identifier) @begin_ident
+                    (#eq? @begin_ident "BEGIN_MESSAGE_MAP")
+                    arguments: (argument_list
+                            (identifier) @class
+                            (identifier) @superclass)) @begin)
+
+            ; Followed by one or more entries
+            [
+            (expression_statement
+                (call_expression
+                    function: (identifier) @message-name
+                    arguments: (argument_list
+                        [(_)* @parameter ","]*
+                        (#exclude! @parameter comment))
+            ))@message
+            (_)
+            ]*
+
+            ; Ending with END_MESSAGE_MAP
+            (expression_statement
+                (call_expression
+                    function: (identifier) @end_ident
+                    (#eq? @end_ident "END_MESSAGE_MAP")) @end)
+        )
+    ]
+)
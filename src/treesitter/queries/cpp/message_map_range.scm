@@ -0,0 +1,12 @@
+; Range of the MFC message map, used by the #in_message_map? predicate
+(
+(expression_statement
+    (call_expression
+        function: (identifier) @begin (#eq? @begin "BEGIN_MESSAGE_MAP")
+        arguments: (argument_list . (_) @class)))
+.
+(expression_statement)*
+.
+(expression_statement (call_expression
+    function: (identifier) @end (#eq? @end "END_MESSAGE_MAP")))
+)
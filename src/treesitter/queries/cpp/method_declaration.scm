@@ -0,0 +1,16 @@
+; Method declarations in a class body, handles Type, Type *, Type &, Type *&, Type &* and Type **
+; Parameters: "names" - the names of the methods
+(field_declaration
+    type: (_)? @return-type
+    [
+        declarator: (_ (_ (function_declarator
+            declarator:(field_identifier) @name (#in? @name "names")
+        ) ) )
+        declarator: (_ (function_declarator
+            declarator:(field_identifier) @name (#in? @name "names")
+        ) )
+        declarator: (function_declarator
+            declarator:(field_identifier) @name (#in? @name "names")
+        )
+    ]
+) @declaration
@@ -0,0 +1,26 @@
+; Method definitions, handles Type, Type *, Type &, Type *&, Type &* and Type **
+; Parameters: "names" - the names of the methods
+(function_definition
+    type: (_)? @return-type
+    [
+        declarator: (_ (_ (function_declarator
+            declarator: (identifier) @name (#in? @name "names")
+            parameters: (parameter_list
+                (parameter_declaration)* @parameters
+            ) @parameter-list
+        ) ) )
+        declarator: (_ (function_declarator
+            declarator: (identifier) @name (#in? @name "names")
+            parameters: (parameter_list
+                (parameter_declaration)* @parameters
+            ) @parameter-list
+        ) )
+        declarator: (function_declarator
+            declarator: (identifier) @name (#in? @name "names")
+            parameters: (parameter_list
+                (parameter_declaration)* @parameters
+            ) @parameter-list
+        )
+    ]
+    body: (compound_statement) @body
+) @definition
@@ -0,0 +1,18 @@
+; Classes and DoDataExchange definitions, see MfcFileInfo::query
+[(class_specifier
+    name: (_) @class-name
+    (base_class_clause
+        [(type_identifier) @class-base _]*)?
+    body: (_)) @class-definition
+(struct_specifier
+    name: (_) @class-name
+    (base_class_clause
+        [(type_identifier) @class-base _]*)?
+    body: (_)) @class-definition]
+
+(function_definition
+    declarator: (function_declarator
+        declarator: (qualified_identifier
+            scope: (_) @ddx-class
+            name: (identifier) @ddx-name (#eq? @ddx-name "DoDataExchange")))
+    body: (_)) @ddx-definition
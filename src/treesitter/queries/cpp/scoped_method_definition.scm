@@ -0,0 +1,35 @@
+; Method definitions in a scope, handles Type, Type *, Type &, Type *&, Type &* and Type **
+; Parameters: "names" - the names of the methods, "scopes" - the scopes, whitespace is ignored
+(function_definition
+    type: (_)? @return-type
+    [
+        declarator: (_ (_ (function_declarator
+            declarator: (qualified_identifier
+                scope: (_) @scope (#like_in? @scope "scopes")
+                (identifier) @name (#in? @name "names")
+            )
+            parameters: (parameter_list
+                (parameter_declaration)* @parameters
+            ) @parameter-list
+        ) ) )
+        declarator: (_ (function_declarator
+            declarator: (qualified_identifier
+                scope: (_) @scope (#like_in? @scope "scopes")
+                (identifier) @name (#in? @name "names")
+            )
+            parameters: (parameter_list
+                (parameter_declaration)* @parameters
+            ) @parameter-list
+        ) )
+        declarator: (function_declarator
+            declarator: (qualified_identifier
+                scope: (_) @scope (#like_in? @scope "scopes")
+                (identifier) @name (#in? @name "names")
+            )
+            parameters: (parameter_list
+                (parameter_declaration)* @parameters
+            ) @parameter-list
+        )
+    ]
+    body: (compound_statement) @body
+) @definition
@@ -11,8 +11,12 @@
 #include "query.h"
 #include "node.h"
 #include "predicates.h"
+#include "utils/stringpool.h"
+#include "utils/tracing.h"
 
 #include <QStringList>
+#include <algorithm>
+#include <chrono>
 #include <kdalgorithms.h>
 #include <tree_sitter/api.h>
 
@@ -36,23 +40,49 @@ Query::Query(const TSLanguage *language, const QString &query)
         };
     }
 
-    const auto patterns = this->patterns();
-    for (const auto &pattern : patterns) {
-        for (const auto &predicate : pattern.predicates) {
+    // The names are needed by the predicates below
+    const auto captureCount = ts_query_capture_count(m_query);
+    QHash<QString, uint32_t> captureIds;
+    m_captureNames.reserve(captureCount);
+    captureIds.reserve(captureCount);
+    for (uint32_t id = 0; id < captureCount; ++id) {
+        uint32_t length;
+        const auto name = ts_query_capture_name_for_id(m_query, id, &length);
+        // The same capture names are used by most queries, and by the symbols built from their matches
+        m_captureNames.push_back(Utils::intern(QString::fromUtf8(name, length)));
+        captureIds.insert(m_captureNames.back(), id);
+    }
+    m_captureIds = std::make_shared<const QHash<QString, uint32_t>>(std::move(captureIds));
+
+    const auto count = ts_query_pattern_count(m_query);
+    m_patterns.reserve(count);
+    for (uint32_t patternIndex = 0; patternIndex < count; ++patternIndex) {
+        auto start_byte = ts_query_start_byte_for_pattern(m_query, patternIndex);
+        auto predicates = predicatesForPattern(patternIndex);
+
+        for (auto &predicate : predicates) {
             auto error = Predicates::checkPredicate(predicate);
             if (error.has_value()) {
                 auto predicateString = QString("#%1").arg(predicate.name).toUtf8();
                 auto offset = m_utf8_text.indexOf(predicateString);
                 offset = offset >= 0 ? offset : 0;
 
+                ts_query_delete(m_query);
                 throw Error {.utf8_offset = static_cast<uint32_t>(offset), .description = error.value()};
             }
+            Predicates::compilePredicate(predicate, language);
         }
+
+        m_patterns.emplace_back(Pattern {.predicates = std::move(predicates), .utf8_start_byte = start_byte});
     }
 }
 
 Query::Query(Query &&other) noexcept
-    : m_query(other.m_query)
+    : m_utf8_text(std::move(other.m_utf8_text))
+    , m_query(other.m_query)
+    , m_patterns(std::move(other.m_patterns))
+    , m_captureNames(std::move(other.m_captureNames))
+    , m_captureIds(std::move(other.m_captureIds))
 {
     other.m_query = nullptr;
 }
@@ -72,7 +102,11 @@ Query &Query::operator=(Query &&other) noexcept
 
 void Query::swap(Query &other) noexcept
 {
+    m_utf8_text.swap(other.m_utf8_text);
     std::swap(m_query, other.m_query);
+    m_patterns.swap(other.m_patterns);
+    m_captureNames.swap(other.m_captureNames);
+    m_captureIds.swap(other.m_captureIds);
 }
 
 QVector<Query::Predicate> Query::predicatesForPattern(uint32_t index) const
@@ -91,10 +125,11 @@ QVector<Query::Predicate> Query::predicatesForPattern(uint32_t index) const
         case TSQueryPredicateStepTypeString:
             // The name of the predicate is always the first PredicateStepTypeString.
             if (predicate.name.isEmpty()) {
-                predicate.name = ts_query_string_value_for_id(m_query, step.value_id, &length);
+                predicate.name = Utils::intern(QString(ts_query_string_value_for_id(m_query, step.value_id, &length)));
             } else {
-                predicate.arguments.emplace_back(std::in_place_type<QString>,
-                                                 ts_query_string_value_for_id(m_query, step.value_id, &length));
+                predicate.arguments.emplace_back(
+                    std::in_place_type<QString>,
+                    Utils::intern(QString(ts_query_string_value_for_id(m_query, step.value_id, &length))));
             }
             break;
         case TSQueryPredicateStepTypeCapture:
@@ -110,37 +145,72 @@ QVector<Query::Predicate> Query::predicatesForPattern(uint32_t index) const
     return predicates;
 }
 
-QVector<Query::Pattern> Query::patterns() const
+const QVector<Query::Pattern> &Query::patterns() const
 {
-    QVector<Query::Pattern> result;
-
-    auto count = ts_query_pattern_count(m_query);
-    result.reserve(count);
-    for (uint32_t patternIndex = 0; patternIndex < count; ++patternIndex) {
-        auto start_byte = ts_query_start_byte_for_pattern(m_query, patternIndex);
-        auto predicates = predicatesForPattern(patternIndex);
-
-        result.emplace_back(Pattern {.predicates = std::move(predicates), .utf8_start_byte = start_byte});
-    }
-    return result;
+    return m_patterns;
 }
 
 QVector<Query::Capture> Query::captures() const
 {
-    uint32_t length = ts_query_capture_count(m_query);
-
     QVector<Query::Capture> results;
-    for (uint32_t i = 0; i < length; i++) {
+    results.reserve(m_captureNames.size());
+    for (uint32_t i = 0; i < static_cast<uint32_t>(m_captureNames.size()); i++) {
         results.emplace_back(captureAt(i));
     }
     return results;
 }
 Query::Capture Query::captureAt(uint32_t index) const
 {
-    uint32_t length;
-    auto name = ts_query_capture_name_for_id(m_query, index, &length);
+    return Capture {.name = m_captureNames.value(index), .id = index};
+}
+
+std::optional<uint32_t> Query::captureId(const QString &name) const
+{
+    if (auto it = m_captureIds->constFind(name); it != m_captureIds->cend())
+        return *it;
+    return {};
+}
 
-    return Capture {.name = QString(name), .id = index};
+const std::shared_ptr<const QHash<QString, uint32_t>> &Query::captureIds() const
+{
+    return m_captureIds;
+}
+
+const QByteArray &Query::utf8Text() const
+{
+    return m_utf8_text;
+}
+
+bool Query::isPatternRooted(uint32_t index) const
+{
+    return ts_query_is_pattern_rooted(m_query, index);
+}
+
+bool Query::isPatternNonLocal(uint32_t index) const
+{
+    return ts_query_is_pattern_non_local(m_query, index);
+}
+
+QStringList Query::patternWarnings() const
+{
+    QStringList warnings;
+    for (uint32_t index = 0; index < static_cast<uint32_t>(m_patterns.size()); ++index) {
+        const auto start = m_patterns.at(index).utf8_start_byte;
+        const auto line = m_utf8_text.first(std::min<qsizetype>(start, m_utf8_text.size())).count('\n') + 1;
+        if (!isPatternRooted(index)) {
+            warnings.push_back(QString("Pattern %1 (line %2) is not rooted: it's matched from every node of the tree, "
+                                       "wrap its top-level nodes in a common parent")
+                                   .arg(index)
+                                   .arg(line));
+        }
+        if (isPatternNonLocal(index)) {
+            warnings.push_back(QString("Pattern %1 (line %2) is non-local: its repeated top-level siblings keep many "
+                                       "matches in progress")
+                                   .arg(index)
+                                   .arg(line));
+        }
+    }
+    return warnings;
 }
 
 // ------------------------ QueryMatch --------------------
@@ -180,12 +250,8 @@ std::shared_ptr<Query> QueryMatch::query() const
 
 QVector<QueryMatch::Capture> QueryMatch::capturesNamed(const QString &name) const
 {
-    auto captures = this->captures();
-    QVector<Capture> result;
-    std::ranges::copy_if(std::as_const(captures), std::back_inserter(result), [this, &name](const auto &capture) {
-        return m_query->captureAt(capture.id).name == name;
-    });
-    return result;
+    const auto id = m_query->captureId(name);
+    return id ? capturesWithId(*id) : QVector<Capture>();
 }
 
 void QueryMatch::setCaptures(QVector<Capture> &&captures)
@@ -193,7 +259,7 @@ void QueryMatch::setCaptures(QVector<Capture> &&captures)
     m_captures = std::move(captures);
 }
 
-QVector<QueryMatch::Capture> QueryMatch::captures() const
+const QVector<QueryMatch::Capture> &QueryMatch::captures() const
 {
     return m_captures;
 }
@@ -213,6 +279,7 @@ QueryCursor::QueryCursor()
 
 QueryCursor::~QueryCursor()
 {
+    recordProfile();
     if (m_cursor) {
         ts_query_cursor_delete(m_cursor);
     }
@@ -220,10 +287,16 @@ QueryCursor::~QueryCursor()
 
 QueryCursor::QueryCursor(QueryCursor &&other) noexcept
     : m_query(std::move(other.m_query))
+    , m_progressCallback(std::move(other.m_progressCallback))
     , m_predicates(std::move(other.m_predicates))
     , m_cursor(std::move(other.m_cursor))
+    , m_deadline(other.m_deadline)
+    , m_expired(other.m_expired)
+    , m_profile(std::move(other.m_profile))
+    , m_profileFinished(other.m_profileFinished)
 {
     other.m_cursor = nullptr;
+    other.m_profile.reset();
 }
 
 QueryCursor &QueryCursor::operator=(QueryCursor &&other) noexcept
@@ -234,16 +307,42 @@ QueryCursor &QueryCursor::operator=(QueryCursor &&other) noexcept
 
 void QueryCursor::swap(QueryCursor &other) noexcept
 {
+    std::swap(m_query, other.m_query);
+    std::swap(m_progressCallback, other.m_progressCallback);
+    std::swap(m_predicates, other.m_predicates);
     std::swap(m_cursor, other.m_cursor);
+    std::swap(m_deadline, other.m_deadline);
+    std::swap(m_expired, other.m_expired);
+    std::swap(m_profile, other.m_profile);
+    std::swap(m_profileFinished, other.m_profileFinished);
+}
+
+void QueryCursor::setByteRange(uint32_t startByte, uint32_t endByte)
+{
+    ts_query_cursor_set_byte_range(m_cursor, startByte, endByte);
+}
+
+void QueryCursor::setPointRange(const TSPoint &startPoint, const TSPoint &endPoint)
+{
+    ts_query_cursor_set_point_range(m_cursor, startPoint, endPoint);
 }
 
 void QueryCursor::execute(std::shared_ptr<Query> query, const Node &node, std::unique_ptr<Predicates> &&predicates)
 {
+    KNUT_TRACE_SCOPE("QueryCursor::execute");
     m_predicates = std::move(predicates);
     if (m_predicates) {
         m_predicates->setRootNode(node);
     }
+    // The profile of the previous execution is complete, each execution has its own
+    recordProfile();
     m_query = std::move(query);
+    if (m_profile || QueryProfiler::isEnabled()) {
+        m_profile = QueryProfile();
+        m_profile->patterns.resize(m_query->patterns().size());
+        m_profile->executions = 1;
+    }
+    m_profileFinished = false;
     ts_query_cursor_exec(m_cursor, m_query->m_query, node.m_node);
 }
 
@@ -252,20 +351,89 @@ void QueryCursor::setProgressCallback(std::function<void()> callback)
     m_progressCallback = std::move(callback);
 }
 
+void QueryCursor::setMatchLimit(uint32_t limit)
+{
+    ts_query_cursor_set_match_limit(m_cursor, limit == 0 ? UINT32_MAX : limit);
+}
+
+uint32_t QueryCursor::matchLimit() const
+{
+    const auto limit = ts_query_cursor_match_limit(m_cursor);
+    return limit == UINT32_MAX ? 0 : limit;
+}
+
+bool QueryCursor::didExceedMatchLimit() const
+{
+    return ts_query_cursor_did_exceed_match_limit(m_cursor);
+}
+
+void QueryCursor::setDeadline(QDeadlineTimer deadline)
+{
+    m_deadline = deadline;
+}
+
+bool QueryCursor::hasExpired() const
+{
+    return m_expired;
+}
+
+void QueryCursor::enableProfiling()
+{
+    if (!m_profile) {
+        m_profile = QueryProfile();
+        if (m_query) {
+            m_profile->patterns.resize(m_query->patterns().size());
+            m_profile->executions = 1;
+        }
+    }
+}
+
+const std::optional<QueryProfile> &QueryCursor::profile() const
+{
+    return m_profile;
+}
+
+void QueryCursor::recordProfile()
+{
+    if (m_profile && m_query && QueryProfiler::isEnabled())
+        QueryProfiler::record(*m_query, *m_profile);
+}
+
 std::optional<QueryMatch> QueryCursor::nextMatch()
 {
+    KNUT_TRACE_SCOPE("QueryCursor::nextMatch");
     TSQueryMatch match;
+    auto start = m_profile ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+
+    while (!m_expired) {
+        // Checked before each match, the query is only stopped between two matches
+        if (m_deadline.hasExpired()) {
+            m_expired = true;
+            break;
+        }
+        if (!ts_query_cursor_next_match(m_cursor, &match)) {
+            if (m_profile && !m_profileFinished) {
+                m_profileFinished = true;
+                m_profile->exceededMatchLimit += didExceedMatchLimit();
+            }
+            break;
+        }
 
-    while (ts_query_cursor_next_match(m_cursor, &match)) {
         QueryMatch result(match, m_query);
+        bool accepted = true;
         if (m_predicates) {
             m_predicates->executeCommands(result);
-            if (m_predicates->filterMatch(result)) {
-                return result;
-            }
-        } else {
-            return result;
+            accepted = m_predicates->filterMatch(result);
         }
+        if (m_profile) {
+            const auto now = std::chrono::steady_clock::now();
+            auto &pattern = m_profile->patterns[match.pattern_index];
+            pattern.duration += now - start;
+            ++(accepted ? pattern.matches : pattern.rejectedMatches);
+            start = now;
+        }
+        if (accepted)
+            return result;
 
         if (m_progressCallback) {
             m_progressCallback();
@@ -11,11 +11,18 @@
 #pragma once
 
 #include "node.h"
+#include "queryprofile.h"
 
 #include <QByteArray>
+#include <QDeadlineTimer>
+#include <QHash>
+#include <QRegularExpression>
 #include <QString>
+#include <QStringList>
 #include <QVector>
 #include <functional>
+#include <memory>
+#include <optional>
 #include <tree_sitter/api.h>
 
 struct TSLanguage;
@@ -26,6 +33,7 @@ namespace treesitter {
 
 class Node;
 class Predicates;
+class QueryMatch;
 
 class Query
 {
@@ -40,6 +48,15 @@ public:
     {
         QString name;
         QVector<std::variant<Capture, QString>> arguments;
+
+        // Resolved by Predicates::compilePredicate when the query is constructed, so they are not looked up for
+        // every match.
+        bool (Predicates::*filter)(const QueryMatch &, const Predicate &) const = nullptr;
+        void (Predicates::*command)(QueryMatch &, const Predicate &) const = nullptr;
+        // Regular expression argument, for the predicates using one (e.g. #match?)
+        QRegularExpression regex;
+        // Symbols of the node types removed from the capture text, for the predicates using them (e.g. #eq_except?)
+        QVector<TSSymbol> symbols;
     };
 
     struct Pattern
@@ -67,16 +84,33 @@ public:
 
     void swap(Query &other) noexcept;
 
-    QVector<Pattern> patterns() const;
+    const QVector<Pattern> &patterns() const;
 
     QVector<Capture> captures() const;
     Capture captureAt(uint32_t index) const;
+    // Returns the id of the capture named `name`, if there is one
+    std::optional<uint32_t> captureId(const QString &name) const;
+    // Capture ids by name, can be kept by the matches of this query to look up their captures
+    const std::shared_ptr<const QHash<QString, uint32_t>> &captureIds() const;
+
+    const QByteArray &utf8Text() const;
+
+    // A pattern is rooted if it has a single top-level node: other patterns are matched from every node of the tree.
+    bool isPatternRooted(uint32_t index) const;
+    // A non-local pattern has repeated siblings at its top-level, its in-progress matches can't be dropped early.
+    bool isPatternNonLocal(uint32_t index) const;
+    // Returns a warning for each pattern which is slow to match, see isPatternRooted and isPatternNonLocal
+    QStringList patternWarnings() const;
 
 private:
     QVector<Predicate> predicatesForPattern(uint32_t index) const;
 
     QByteArray m_utf8_text;
     TSQuery *m_query;
+    QVector<Pattern> m_patterns;
+    // Capture names by id, converted once from the UTF-8 names of tree-sitter
+    QVector<QString> m_captureNames;
+    std::shared_ptr<const QHash<QString, uint32_t>> m_captureIds;
 
     friend class QueryCursor;
 };
@@ -101,7 +135,7 @@ public:
     uint32_t patternIndex() const;
 
     void setCaptures(QVector<Capture> &&captures);
-    QVector<Capture> captures() const;
+    const QVector<Capture> &captures() const;
     QVector<Capture> capturesWithId(uint32_t id) const;
 
     // Captures with quantifiers may return multiple values for the same capture.
@@ -137,6 +171,11 @@ public:
 
     void swap(QueryCursor &other) noexcept;
 
+    // Restrict the next executions to the nodes intersecting the given range.
+    // Matches may still contain nodes outside of the range, as long as one of their nodes intersects it.
+    void setByteRange(uint32_t startByte, uint32_t endByte);
+    void setPointRange(const TSPoint &startPoint, const TSPoint &endPoint);
+
     void execute(std::shared_ptr<Query> query, const Node &node, std::unique_ptr<Predicates> &&predicates);
 
     std::optional<QueryMatch> nextMatch();
@@ -150,7 +189,25 @@ public:
     // It allows the UI to update and remain responsive while the query is running.
     void setProgressCallback(std::function<void()> callback);
 
+    // Maximum number of in-progress matches, 0 means no limit (the default).
+    // Once the limit is reached, the oldest in-progress matches are dropped, so some matches may be missing.
+    void setMatchLimit(uint32_t limit);
+    uint32_t matchLimit() const;
+    bool didExceedMatchLimit() const;
+
+    // No match is returned anymore once the deadline expired, use hasExpired() to know if it happened.
+    void setDeadline(QDeadlineTimer deadline);
+    bool hasExpired() const;
+
+    // Records the matches and time spent per pattern of the next executions, see profile().
+    // Profiling is always enabled when the QueryProfiler is, each execution being recorded in it.
+    void enableProfiling();
+    // Profile of the last execution
+    const std::optional<QueryProfile> &profile() const;
+
 private:
+    void recordProfile();
+
     // The query must be kept alive for as long as the cursor is alive.
     // Otherwise, no new matches can be returned and the Predicates can't be executed.
     std::shared_ptr<Query> m_query;
@@ -158,6 +215,13 @@ private:
 
     std::unique_ptr<Predicates> m_predicates;
     TSQueryCursor *m_cursor;
+
+    QDeadlineTimer m_deadline = QDeadlineTimer::Forever;
+    bool m_expired = false;
+
+    std::optional<QueryProfile> m_profile;
+    // Set once the last execution returned all its matches
+    bool m_profileFinished = false;
 };
 
 using QueryList = QVector<std::shared_ptr<Query>>;
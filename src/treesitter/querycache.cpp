@@ -0,0 +1,91 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "querycache.h"
+#include "utils/metrics.h"
+
+#include <QMutexLocker>
+
+namespace treesitter {
+
+// Default number of queries kept in the cache.
+constexpr int DefaultMaxSize = 256;
+
+QueryCache::QueryCache()
+    : m_cache(DefaultMaxSize)
+{
+}
+
+QueryCache &QueryCache::instance()
+{
+    static QueryCache cache;
+    return cache;
+}
+
+std::shared_ptr<Query> QueryCache::query(const TSLanguage *language, const QString &query)
+{
+    static auto &hits = Utils::Metrics::counter("treesitter.query_cache.hits");
+    static auto &misses = Utils::Metrics::counter("treesitter.query_cache.misses");
+    const Key key {language, query};
+    {
+        QMutexLocker locker(&m_mutex);
+        if (auto cached = m_cache.object(key)) {
+            ++m_hits;
+            hits.add();
+            return *cached;
+        }
+        ++m_misses;
+        misses.add();
+    }
+
+    // Don't hold the lock while compiling, this may take a while.
+    // Worst case, the same query is compiled twice in different threads, and only one is kept.
+    static auto &compilations = Utils::Metrics::counter("treesitter.query_compilations");
+    compilations.add();
+    auto result = std::make_shared<Query>(language, query);
+
+    QMutexLocker locker(&m_mutex);
+    m_cache.insert(key, new std::shared_ptr<Query>(result));
+    return result;
+}
+
+void QueryCache::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_cache.clear();
+    m_hits = 0;
+    m_misses = 0;
+}
+
+int QueryCache::maxSize() const
+{
+    QMutexLocker locker(&m_mutex);
+    return static_cast<int>(m_cache.maxCost());
+}
+
+void QueryCache::setMaxSize(int maxSize)
+{
+    QMutexLocker locker(&m_mutex);
+    m_cache.setMaxCost(maxSize);
+}
+
+int QueryCache::hits() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_hits;
+}
+
+int QueryCache::misses() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_misses;
+}
+
+} // namespace treesitter
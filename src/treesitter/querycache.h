@@ -0,0 +1,59 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include "query.h"
+
+#include <QCache>
+#include <QMutex>
+#include <QString>
+#include <memory>
+
+struct TSLanguage;
+
+namespace treesitter {
+
+// Process-wide cache of compiled queries.
+//
+// Constructing a Query is relatively expensive, and scripts tend to run the same queries over and over again on
+// many documents. The cache keeps the most recently used queries around, indexed by language and query text.
+//
+// This class is thread-safe.
+class QueryCache
+{
+public:
+    static QueryCache &instance();
+
+    // Returns the compiled query, from the cache if possible.
+    // throws a Query::Error if the query is ill-formed. Ill-formed queries are not cached.
+    std::shared_ptr<Query> query(const TSLanguage *language, const QString &query);
+
+    void clear();
+
+    int maxSize() const;
+    void setMaxSize(int maxSize);
+
+    int hits() const;
+    int misses() const;
+
+private:
+    QueryCache();
+
+    using Key = std::pair<const TSLanguage *, QString>;
+
+    mutable QMutex m_mutex;
+    // QCache owns the values, hence the pointer to a shared_ptr.
+    QCache<Key, std::shared_ptr<Query>> m_cache;
+    int m_hits = 0;
+    int m_misses = 0;
+};
+
+} // namespace treesitter
@@ -0,0 +1,142 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "queryprofile.h"
+#include "query.h"
+
+#include <QFile>
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+
+namespace treesitter {
+
+namespace {
+
+struct Registry
+{
+    std::atomic<bool> enabled = false;
+    std::mutex mutex;
+    // Profiles by query text, the same query may be compiled once per language
+    std::map<QByteArray, QueryProfile> profiles;
+    std::map<QByteArray, QStringList> warnings;
+};
+
+Registry &registry()
+{
+    static Registry registry;
+    return registry;
+}
+
+int64_t toMicroseconds(std::chrono::nanoseconds duration)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+}
+
+} // namespace
+
+//=============================================================================
+// QueryProfile
+//=============================================================================
+std::chrono::nanoseconds QueryProfile::duration() const
+{
+    std::chrono::nanoseconds result {0};
+    for (const auto &pattern : patterns)
+        result += pattern.duration;
+    return result;
+}
+
+void QueryProfile::merge(const QueryProfile &other)
+{
+    if (patterns.size() < other.patterns.size())
+        patterns.resize(other.patterns.size());
+    for (int i = 0; i < other.patterns.size(); ++i) {
+        patterns[i].matches += other.patterns.at(i).matches;
+        patterns[i].rejectedMatches += other.patterns.at(i).rejectedMatches;
+        patterns[i].duration += other.patterns.at(i).duration;
+    }
+    executions += other.executions;
+    exceededMatchLimit += other.exceededMatchLimit;
+}
+
+//=============================================================================
+// QueryProfiler
+//=============================================================================
+void QueryProfiler::setEnabled(bool enabled)
+{
+    registry().enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool QueryProfiler::isEnabled()
+{
+    return registry().enabled.load(std::memory_order_relaxed);
+}
+
+void QueryProfiler::record(const Query &query, const QueryProfile &profile)
+{
+    auto &profiles = registry();
+    std::lock_guard lock(profiles.mutex);
+    profiles.profiles[query.utf8Text()].merge(profile);
+    if (!profiles.warnings.contains(query.utf8Text()))
+        profiles.warnings[query.utf8Text()] = query.patternWarnings();
+}
+
+nlohmann::json QueryProfiler::toJson()
+{
+    auto &profiles = registry();
+    std::lock_guard lock(profiles.mutex);
+
+    std::vector<std::pair<QByteArray, const QueryProfile *>> sorted;
+    for (const auto &[text, profile] : profiles.profiles)
+        sorted.emplace_back(text, &profile);
+    std::ranges::stable_sort(sorted, [](const auto &lhs, const auto &rhs) {
+        return lhs.second->duration() > rhs.second->duration();
+    });
+
+    auto queries = nlohmann::json::array();
+    for (const auto &[text, profile] : sorted) {
+        auto patterns = nlohmann::json::array();
+        for (const auto &pattern : profile->patterns) {
+            patterns.push_back({{"matches", pattern.matches},
+                                {"rejectedMatches", pattern.rejectedMatches},
+                                {"duration", toMicroseconds(pattern.duration)}});
+        }
+        auto warnings = nlohmann::json::array();
+        for (const auto &warning : profiles.warnings[text])
+            warnings.push_back(warning.toStdString());
+        queries.push_back({{"query", text.toStdString()},
+                           {"executions", profile->executions},
+                           {"exceededMatchLimit", profile->exceededMatchLimit},
+                           {"duration", toMicroseconds(profile->duration())},
+                           {"patterns", patterns},
+                           {"warnings", warnings}});
+    }
+    return {{"queries", queries}};
+}
+
+bool QueryProfiler::save(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    file.write(QByteArray::fromStdString(toJson().dump(4)));
+    return true;
+}
+
+void QueryProfiler::reset()
+{
+    auto &profiles = registry();
+    std::lock_guard lock(profiles.mutex);
+    profiles.profiles.clear();
+    profiles.warnings.clear();
+}
+
+}
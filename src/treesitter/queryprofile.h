@@ -0,0 +1,61 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QString>
+#include <QVector>
+#include <chrono>
+#include <nlohmann/json.hpp>
+
+namespace treesitter {
+
+class Query;
+
+// Statistics of the executions of a query, per pattern, filled by QueryCursor::enableProfiling
+struct QueryProfile
+{
+    struct Pattern
+    {
+        int matches = 0;
+        // Matches found by tree-sitter, but discarded by the predicates
+        int rejectedMatches = 0;
+        // Tree-sitter advances all patterns together: the time of each step is attributed to the pattern of the match
+        // it returns, predicates included
+        std::chrono::nanoseconds duration {0};
+    };
+
+    QVector<Pattern> patterns;
+    int executions = 0;
+    // Number of executions which dropped in-progress matches, because there were more than the match limit
+    int exceededMatchLimit = 0;
+
+    std::chrono::nanoseconds duration() const;
+    void merge(const QueryProfile &other);
+};
+
+// Process-wide profile of all the queries executed, to find the slow ones in scripts (see the --query-profile option).
+// Disabled by default, this class is thread-safe.
+class QueryProfiler
+{
+public:
+    static void setEnabled(bool enabled);
+    static bool isEnabled();
+
+    static void record(const Query &query, const QueryProfile &profile);
+
+    // Returns the profile of all queries, the slowest first, with the durations in microseconds
+    static nlohmann::json toJson();
+    // Saves the profile as json in `fileName`, returns false if the file can't be written
+    static bool save(const QString &fileName);
+    static void reset();
+};
+
+}
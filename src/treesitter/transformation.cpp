@@ -13,7 +13,13 @@
 #include "tree.h"
 
 #include <QObject>
+#include <QStringList>
+#include <algorithm>
+#include <map>
+#include <ranges>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 namespace treesitter {
 
@@ -26,28 +32,47 @@ Transformation::Transformation(QString source, Parser &&parser, std::shared_ptr<
 {
 }
 
-QString Transformation::run()
+// Returns the point at the end of `text`, if `text` starts at `start`.
+// Columns are counted in bytes, as required by Tree-sitter.
+static TSPoint pointAfter(const TSPoint &start, QStringView text)
+{
+    const auto newLines = text.count(u'\n');
+    if (newLines == 0) {
+        return {start.row, start.column + static_cast<uint32_t>(text.size() * sizeof(QChar))};
+    }
+    const auto lastLineLength = text.size() - text.lastIndexOf(u'\n') - 1;
+    return {start.row + static_cast<uint32_t>(newLines), static_cast<uint32_t>(lastLineLength * sizeof(QChar))};
+}
+
+QString Transformation::run(const ReplacementCallback &callback)
 {
     auto resultText = m_source;
 
     m_replacements = 0;
 
     QueryCursor cursor;
-    bool shouldContinue;
-    do {
-        const auto tree = m_parser.parseString(resultText);
+    std::optional<Tree> tree = m_parser.parseString(resultText);
+    while (true) {
         if (!tree.has_value()) {
             throw Error {.description = "Unknown parser error!"};
         }
         cursor.execute(m_query, tree->rootNode(), std::make_unique<Predicates>(resultText));
 
-        shouldContinue = runOneTransformation(cursor, resultText);
-    } while (shouldContinue);
+        const auto edit = runOneTransformation(cursor, resultText);
+        if (!edit)
+            break;
+        if (callback && !callback(resultText, m_replacements))
+            break;
+
+        // Only the replaced part of the text needs to be parsed again
+        tree->edit(edit.value());
+        tree = m_parser.parseString(resultText, &tree.value());
+    }
 
     return resultText;
 }
 
-bool Transformation::runOneTransformation(QueryCursor &cursor, QString &resultText)
+std::optional<TSInputEdit> Transformation::runOneTransformation(QueryCursor &cursor, QString &resultText)
 {
     std::unordered_map<QString, QString> context;
 
@@ -65,21 +90,30 @@ bool Transformation::runOneTransformation(QueryCursor &cursor, QString &resultTe
 
         const auto from = match->capturesNamed("from");
         if (!from.isEmpty()) {
-            const auto fromStart = from.first().node.startPosition();
-            const auto fromEnd = from.first().node.endPosition();
+            const auto &fromNode = from.first().node;
+            const auto fromStart = fromNode.startPosition();
+            const auto fromEnd = fromNode.endPosition();
 
             QString after = m_to;
             for (const auto &[name, value] : context) {
                 after.replace("@" + name, value);
             }
 
+            const TSInputEdit edit {
+                .start_byte = static_cast<uint32_t>(fromStart * sizeof(QChar)),
+                .old_end_byte = static_cast<uint32_t>(fromEnd * sizeof(QChar)),
+                .new_end_byte = static_cast<uint32_t>((fromStart + after.size()) * sizeof(QChar)),
+                .start_point = fromNode.startPoint(),
+                .old_end_point = fromNode.endPoint(),
+                .new_end_point = pointAfter(fromNode.startPoint(), after),
+            };
+
             resultText.replace(fromStart, fromEnd - fromStart, after);
             if (++m_replacements >= m_max_replacements) {
                 throw Error {.description = QObject::tr("Maximum number of allowed transformations reached.\nPossibly "
                                                         "your transformation is recursive?")};
             }
-            context = std::unordered_map<QString, QString>();
-            return true;
+            return edit;
         }
     }
 
@@ -88,7 +122,90 @@ bool Transformation::runOneTransformation(QueryCursor &cursor, QString &resultTe
         throw Error {.description = QObject::tr("'@from' capture not found!")};
     }
 
-    return false;
+    return {};
+}
+
+RuleSetTransformation::RuleSetTransformation(const TSLanguage *language, const QVector<Rule> &rules)
+    : m_rules(rules)
+{
+    // Each rule is compiled on its own first, to know its patterns, and report errors in its own query
+    QStringList queries;
+    for (int rule = 0; rule < rules.size(); ++rule) {
+        const auto &text = rules.at(rule).query;
+        try {
+            const Query ruleQuery(language, text);
+            if (!ruleQuery.captureId("from"))
+                throw Query::Error {.utf8_offset = 0, .description = QObject::tr("'@from' capture not found!")};
+            m_patternRules.insert(m_patternRules.size(), ruleQuery.patterns().size(), rule);
+        } catch (Query::Error &error) {
+            error.description = QObject::tr("Rule %1: %2").arg(rule).arg(error.description);
+            throw;
+        }
+        queries.push_back(text);
+    }
+    m_query = std::make_shared<Query>(language, queries.join('\n'));
+}
+
+RuleSetTransformation::Result RuleSetTransformation::findReplacements(const QString &source, const Tree &tree) const
+{
+    // Captures seen so far by each rule: as with Transformation, patterns without @from provide context to the next
+    // replacements of their rule
+    std::vector<std::unordered_map<QString, QString>> contexts(m_rules.size());
+    QVector<Replacement> candidates;
+
+    QueryCursor cursor;
+    cursor.execute(m_query, tree.rootNode(), std::make_unique<Predicates>(source));
+    while (const auto match = cursor.nextMatch()) {
+        const int rule = m_patternRules.at(match->patternIndex());
+        auto &context = contexts[rule];
+        for (const auto &capture : match->captures())
+            context[m_query->captureAt(capture.id).name] = capture.node.textIn(source);
+
+        const auto from = match->capturesNamed("from");
+        if (from.isEmpty())
+            continue;
+        QString after = m_rules.at(rule).to;
+        for (const auto &[name, value] : context)
+            after.replace("@" + name, value);
+        const auto &fromNode = from.first().node;
+        const auto start = static_cast<int>(fromNode.startPosition());
+        candidates.push_back({rule, start, static_cast<int>(fromNode.endPosition()), std::move(after)});
+    }
+
+    // The first rules have priority, then the first matches
+    std::ranges::stable_sort(candidates, {}, &Replacement::rule);
+
+    Result result;
+    std::map<int, const Replacement *> accepted;
+    for (const auto &candidate : std::as_const(candidates)) {
+        // Only the replacements around the start of the candidate may overlap it
+        const Replacement *other = nullptr;
+        const auto next = accepted.lower_bound(candidate.start);
+        if (next != accepted.end() && (next->first < candidate.end || next->first == candidate.start))
+            other = next->second;
+        else if (next != accepted.begin() && std::prev(next)->second->end > candidate.start)
+            other = std::prev(next)->second;
+
+        if (!other) {
+            accepted.emplace(candidate.start, &candidate);
+        } else if (other->rule != candidate.rule || other->end != candidate.end || other->text != candidate.text) {
+            result.conflicts.push_back({candidate.rule, candidate.start, candidate.end, other->rule});
+        }
+        // Otherwise it's the same replacement, found by several patterns of the rule
+    }
+
+    result.replacements.reserve(static_cast<qsizetype>(accepted.size()));
+    for (const auto &[start, replacement] : accepted)
+        result.replacements.push_back(*replacement);
+    return result;
+}
+
+QString RuleSetTransformation::apply(QString source, const QVector<Replacement> &replacements)
+{
+    // From the end, so the positions of the next replacements are still valid
+    for (const auto &replacement : replacements | std::views::reverse)
+        source.replace(replacement.start, replacement.end - replacement.start, replacement.text);
+    return source;
 }
 
 } // namespace treesitter
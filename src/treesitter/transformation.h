@@ -14,6 +14,9 @@
 #include "query.h"
 
 #include <QString>
+#include <QVector>
+#include <functional>
+#include <memory>
 
 namespace treesitter {
 
@@ -27,13 +30,19 @@ public:
 
     Transformation(QString source, Parser &&parser, std::shared_ptr<Query> query, QString transformationTarget);
 
+    // Called after each replacement with the text transformed so far, the transformation stops if it returns false
+    using ReplacementCallback = std::function<bool(const QString &text, int replacements)>;
+
     // Throws a Transformation::Error on failure
-    QString run();
+    QString run(const ReplacementCallback &callback = {});
 
     int replacementsMade() const { return m_replacements; }
+    const QString &source() const { return m_source; }
 
 private:
-    bool runOneTransformation(QueryCursor &cursor, QString &resultText);
+    // Returns the edit made to resultText, so the tree can be reparsed incrementally, or nothing if there's no more
+    // transformation to do.
+    std::optional<TSInputEdit> runOneTransformation(QueryCursor &cursor, QString &resultText);
 
     QString m_source;
     Parser m_parser;
@@ -46,4 +55,60 @@ private:
     int m_replacements = 0;
 };
 
+// Applies several rewrite rules in a single pass: the queries of the rules are combined in one multi-pattern query, and
+// all the replacements found are applied at once, instead of one query and one parse per rule and per replacement.
+class RuleSetTransformation
+{
+public:
+    // Same as a Transformation: `to` replaces the @from capture, with @name replaced by the text of the capture `name`
+    struct Rule
+    {
+        QString query;
+        QString to;
+    };
+
+    // Positions are in the source text, the end being exclusive
+    struct Replacement
+    {
+        int rule;
+        int start;
+        int end;
+        QString text;
+    };
+
+    // Replacement of `rule` not applied, as it overlaps with a replacement of `otherRule`
+    struct Conflict
+    {
+        int rule;
+        int start;
+        int end;
+        int otherRule;
+    };
+
+    struct Result
+    {
+        // Sorted by position, they don't overlap
+        QVector<Replacement> replacements;
+        QVector<Conflict> conflicts;
+    };
+
+    // Throws a Query::Error if one of the queries is ill-formed or has no @from capture, the offset being in the query
+    // of the rule given in the description.
+    RuleSetTransformation(const TSLanguage *language, const QVector<Rule> &rules);
+
+    const std::shared_ptr<Query> &query() const { return m_query; }
+
+    // Returns the replacements of all rules in `source`. When two replacements overlap, the one of the first rule is
+    // kept, and the other one is a conflict. Can be called from several threads at once.
+    Result findReplacements(const QString &source, const Tree &tree) const;
+
+    static QString apply(QString source, const QVector<Replacement> &replacements);
+
+private:
+    QVector<Rule> m_rules;
+    std::shared_ptr<Query> m_query;
+    // Rule of each pattern of the combined query
+    QVector<int> m_patternRules;
+};
+
 }
@@ -9,6 +9,7 @@
 */
 
 #include "tree.h"
+#include "utils/memoryaccounting.h"
 
 #include <tree_sitter/api.h>
 #include <utility>
@@ -49,4 +50,27 @@ Node Tree::rootNode() const
     return Node(ts_tree_root_node(m_tree));
 }
 
+Tree Tree::copy() const
+{
+    return Tree(ts_tree_copy(m_tree));
+}
+
+void Tree::edit(const TSInputEdit &edit)
+{
+    ts_tree_edit(m_tree, &edit);
+}
+
+std::vector<std::pair<uint32_t, uint32_t>> Tree::changedRanges(const Tree &newTree) const
+{
+    uint32_t count = 0;
+    TSRange *ranges = ts_tree_get_changed_ranges(m_tree, newTree.m_tree, &count);
+    std::vector<std::pair<uint32_t, uint32_t>> result;
+    result.reserve(count);
+    for (uint32_t i = 0; i < count; ++i)
+        result.emplace_back(ranges[i].start_byte, ranges[i].end_byte);
+    // Allocated with the tree-sitter allocator, see installAllocator
+    Utils::MemoryAccounting::deallocate(Utils::MemoryAccounting::TreeSitter, ranges);
+    return result;
+}
+
 }
@@ -12,6 +12,9 @@
 
 #include "node.h"
 
+#include <utility>
+#include <vector>
+
 struct TSTree;
 
 namespace treesitter {
@@ -31,6 +34,18 @@ public:
 
     Node rootNode() const;
 
+    // Returns a shallow copy of the tree, which is cheap as the nodes are shared.
+    Tree copy() const;
+
+    // Adjusts the positions of the tree to reflect an edit of the source text.
+    // The tree can then be passed to Parser::parseString to reparse incrementally.
+    // Note: This invalidates all existing Node instances of this tree!
+    void edit(const TSInputEdit &edit);
+
+    // Returns the ranges whose syntactic structure changed between this tree, once edited, and `newTree` parsed from
+    // it. The ranges are in bytes of the new text.
+    std::vector<std::pair<uint32_t, uint32_t>> changedRanges(const Tree &newTree) const;
+
     void swap(Tree &other) noexcept;
 
 private:
@@ -39,9 +54,6 @@ private:
     TSTree *m_tree;
 
     friend class Parser;
-
-    // TODO: Once update is implemented, store weak pointers to all
-    // TSNodes so that they may be updated as well.
 };
 
 }
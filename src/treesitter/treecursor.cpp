@@ -0,0 +1,161 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "treecursor.h"
+
+#include <utility>
+
+namespace treesitter {
+
+///////////////////////////////////////////////////////////////////////////////
+// TreeCursor
+///////////////////////////////////////////////////////////////////////////////
+TreeCursor::TreeCursor(const Node &node)
+    : m_cursor(ts_tree_cursor_new(node.m_node))
+{
+}
+
+TreeCursor::TreeCursor(const TreeCursor &other)
+    : m_cursor(ts_tree_cursor_copy(&other.m_cursor))
+{
+}
+
+TreeCursor::TreeCursor(TreeCursor &&other) noexcept
+    : m_cursor(other.m_cursor)
+{
+    // The moved-from cursor doesn't own the memory anymore
+    other.m_valid = false;
+}
+
+TreeCursor &TreeCursor::operator=(const TreeCursor &other)
+{
+    TreeCursor(other).swap(*this);
+    return *this;
+}
+
+TreeCursor &TreeCursor::operator=(TreeCursor &&other) noexcept
+{
+    TreeCursor(std::move(other)).swap(*this);
+    return *this;
+}
+
+TreeCursor::~TreeCursor()
+{
+    if (m_valid)
+        ts_tree_cursor_delete(&m_cursor);
+}
+
+void TreeCursor::swap(TreeCursor &other) noexcept
+{
+    std::swap(m_cursor, other.m_cursor);
+    std::swap(m_valid, other.m_valid);
+}
+
+void TreeCursor::reset(const Node &node)
+{
+    if (m_valid) {
+        ts_tree_cursor_reset(&m_cursor, node.m_node);
+    } else {
+        m_cursor = ts_tree_cursor_new(node.m_node);
+        m_valid = true;
+    }
+}
+
+Node TreeCursor::currentNode() const
+{
+    return Node(ts_tree_cursor_current_node(&m_cursor));
+}
+
+const char *TreeCursor::currentFieldName() const
+{
+    return ts_tree_cursor_current_field_name(&m_cursor);
+}
+
+bool TreeCursor::gotoFirstChild()
+{
+    return ts_tree_cursor_goto_first_child(&m_cursor);
+}
+
+bool TreeCursor::gotoNextSibling()
+{
+    return ts_tree_cursor_goto_next_sibling(&m_cursor);
+}
+
+bool TreeCursor::gotoParent()
+{
+    return ts_tree_cursor_goto_parent(&m_cursor);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ChildRange
+///////////////////////////////////////////////////////////////////////////////
+ChildRange::ChildRange(const Node &parent, bool namedOnly)
+    : m_parent(parent)
+    , m_namedOnly(namedOnly)
+{
+}
+
+ChildRange::Iterator::Iterator(const Node &parent, bool namedOnly)
+    : m_cursor(parent)
+    , m_namedOnly(namedOnly)
+    , m_atEnd(!m_cursor.gotoFirstChild())
+{
+    skipUnnamed();
+}
+
+ChildRange::Iterator &ChildRange::Iterator::operator++()
+{
+    m_atEnd = !m_cursor.gotoNextSibling();
+    skipUnnamed();
+    return *this;
+}
+
+void ChildRange::Iterator::skipUnnamed()
+{
+    if (!m_namedOnly)
+        return;
+    while (!m_atEnd && !m_cursor.currentNode().isNamed())
+        m_atEnd = !m_cursor.gotoNextSibling();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DescendantRange
+///////////////////////////////////////////////////////////////////////////////
+DescendantRange::DescendantRange(const Node &root)
+    : m_root(root)
+{
+}
+
+DescendantRange::Iterator::Iterator(const Node &root)
+    : m_cursor(root)
+    , m_depth(m_cursor.gotoFirstChild() ? 1 : 0)
+{
+}
+
+DescendantRange::Iterator &DescendantRange::Iterator::operator++()
+{
+    if (m_cursor.gotoFirstChild())
+        ++m_depth;
+    else
+        skipChildren();
+    return *this;
+}
+
+void DescendantRange::Iterator::skipChildren()
+{
+    while (m_depth > 0) {
+        if (m_cursor.gotoNextSibling())
+            return;
+        m_cursor.gotoParent();
+        --m_depth;
+    }
+}
+
+} // namespace treesitter
@@ -0,0 +1,138 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include "node.h"
+
+#include <iterator>
+#include <tree_sitter/api.h>
+
+namespace treesitter {
+
+// Wrapper around a TSTreeCursor, to walk a tree starting from a given node.
+//
+// Walking the tree with a cursor is a lot faster than using Node::child, which has to go through all the previous
+// siblings each time. The cursor can't go outside of the subtree of the node it started from.
+class TreeCursor
+{
+public:
+    explicit TreeCursor(const Node &node);
+
+    TreeCursor(const TreeCursor &other);
+    TreeCursor(TreeCursor &&other) noexcept;
+
+    TreeCursor &operator=(const TreeCursor &other);
+    TreeCursor &operator=(TreeCursor &&other) noexcept;
+
+    ~TreeCursor();
+
+    void swap(TreeCursor &other) noexcept;
+
+    // Restarts the walk from `node`, reusing the memory of the cursor.
+    void reset(const Node &node);
+
+    Node currentNode() const;
+    // Returns nullptr if the current node isn't associated with a field.
+    const char *currentFieldName() const;
+
+    bool gotoFirstChild();
+    bool gotoNextSibling();
+    bool gotoParent();
+
+private:
+    TSTreeCursor m_cursor;
+    bool m_valid = true;
+};
+
+// Range over the children of a node, usable in range-based for loops:
+//
+//     for (const auto &child : node.childRange())
+//
+// Contrary to Node::children, it doesn't allocate a vector of nodes.
+class ChildRange
+{
+public:
+    class Iterator
+    {
+    public:
+        using value_type = Node;
+        using difference_type = std::ptrdiff_t;
+
+        Node operator*() const { return m_cursor.currentNode(); }
+        Iterator &operator++();
+        void operator++(int) { ++*this; }
+        bool operator==(std::default_sentinel_t) const { return m_atEnd; }
+
+    private:
+        Iterator(const Node &parent, bool namedOnly);
+
+        void skipUnnamed();
+
+        TreeCursor m_cursor;
+        bool m_namedOnly;
+        bool m_atEnd;
+
+        friend class ChildRange;
+    };
+
+    Iterator begin() const { return Iterator(m_parent, m_namedOnly); }
+    std::default_sentinel_t end() const { return {}; }
+
+private:
+    ChildRange(const Node &parent, bool namedOnly);
+
+    Node m_parent;
+    bool m_namedOnly;
+
+    friend class Node;
+};
+
+// Range over all the descendants of a node (the node itself excluded), in depth-first pre-order.
+// Like ChildRange, it doesn't allocate any vector of nodes.
+class DescendantRange
+{
+public:
+    class Iterator
+    {
+    public:
+        using value_type = Node;
+        using difference_type = std::ptrdiff_t;
+
+        Node operator*() const { return m_cursor.currentNode(); }
+        Iterator &operator++();
+        void operator++(int) { ++*this; }
+        bool operator==(std::default_sentinel_t) const { return m_depth == 0; }
+
+        // Goes to the next node, without visiting the descendants of the current one.
+        void skipChildren();
+
+    private:
+        explicit Iterator(const Node &root);
+
+        TreeCursor m_cursor;
+        // Depth of the current node relative to the root, 0 once the iteration is done.
+        int m_depth = 0;
+
+        friend class DescendantRange;
+    };
+
+    Iterator begin() const { return Iterator(m_root); }
+    std::default_sentinel_t end() const { return {}; }
+
+private:
+    explicit DescendantRange(const Node &root);
+
+    Node m_root;
+
+    friend class Node;
+};
+
+} // namespace treesitter
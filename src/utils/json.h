@@ -13,24 +13,61 @@
 #include <QFlags>
 #include <QMetaEnum>
 #include <QString>
+#include <QStringEncoder>
 #include <QStringList>
+#include <QStringView>
 #include <nlohmann/json.hpp>
 #include <optional>
+#include <string>
 #include <variant>
 
+namespace Utils {
+
+// Same as QString::toStdString, with the UTF-8 text encoded directly in the std::string instead of a QByteArray
+// copied afterwards. Used for the strings sent to the language servers, which may be the whole text of a document.
+inline std::string toStdString(QStringView str)
+{
+    // The size is exact unless there are surrogates: an invalid one is replaced, with a different size
+    std::size_t size = 0;
+    bool exactSize = true;
+    for (const auto c : str) {
+        if (c.unicode() < 0x80) {
+            size += 1;
+        } else if (c.unicode() < 0x800) {
+            size += 2;
+        } else if (c.isSurrogate()) {
+            exactSize = false;
+            break;
+        } else {
+            size += 3;
+        }
+    }
+
+    QStringEncoder encoder(QStringEncoder::Utf8);
+    std::string result;
+    result.resize(exactSize ? size : static_cast<std::size_t>(encoder.requiredSpace(str.size())));
+    const char *end = encoder.appendToBuffer(result.data(), str);
+    result.resize(static_cast<std::size_t>(end - result.data()));
+    return result;
+}
+
+} // namespace Utils
+
 ///////////////////////////////////////////////////////////////////////////////
 // QString
 ///////////////////////////////////////////////////////////////////////////////
 inline void to_json(nlohmann::json &j, const QString &str)
 {
-    j = nlohmann::json(str.toStdString());
+    j = nlohmann::json(Utils::toStdString(str));
 }
 
 inline void from_json(const nlohmann::json &j, QString &str)
 {
-    if (j.is_string())
-        str = QString::fromStdString(j.get<std::string>());
-    else {
+    if (j.is_string()) {
+        // Decoded in place, without copying the std::string first
+        const auto &utf8 = j.get_ref<const std::string &>();
+        str = QString::fromUtf8(utf8.data(), static_cast<qsizetype>(utf8.size()));
+    } else {
         throw nlohmann::detail::type_error::create(302, "type must be a string, but is not", &j);
     }
 }
@@ -40,15 +77,21 @@ inline void from_json(const nlohmann::json &j, QString &str)
 ///////////////////////////////////////////////////////////////////////////////
 inline void to_json(nlohmann::json &j, const QStringList &strList)
 {
-    std::vector<QString> list(strList.cbegin(), strList.cend());
-    j = list;
+    j = nlohmann::json::array();
+    auto &array = j.get_ref<nlohmann::json::array_t &>();
+    array.reserve(static_cast<std::size_t>(strList.size()));
+    for (const auto &str : strList)
+        array.emplace_back(Utils::toStdString(str));
 }
 
 inline void from_json(const nlohmann::json &j, QStringList &strList)
 {
     if (j.is_array()) {
-        auto list = j.get<std::vector<QString>>();
-        strList = QStringList(list.cbegin(), list.cend());
+        QStringList list;
+        list.reserve(static_cast<qsizetype>(j.size()));
+        for (const auto &value : j)
+            list.push_back(value.get<QString>());
+        strList = std::move(list);
     } else {
         throw nlohmann::detail::type_error::create(302, "type must be an array, but is not", &j);
     }
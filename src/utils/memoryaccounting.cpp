@@ -0,0 +1,209 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "memoryaccounting.h"
+
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <pugixml.hpp>
+
+#ifdef KNUT_MIMALLOC
+#include <mimalloc.h>
+#endif
+
+#if defined(__APPLE__)
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#endif
+
+namespace Utils {
+
+namespace {
+
+struct Usage
+{
+    std::atomic<int64_t> allocated = 0;
+    std::atomic<int64_t> peak = 0;
+};
+
+std::array<Usage, MemoryAccounting::SubsystemCount> usages;
+thread_local std::array<int64_t, MemoryAccounting::SubsystemCount> threadUsages = {};
+
+MemoryAccounting::Allocator defaultAllocator()
+{
+    const char *name = std::getenv("KNUT_ALLOCATOR");
+    if (name && std::strcmp(name, "system") == 0)
+        return MemoryAccounting::SystemAllocator;
+    return MemoryAccounting::hasMimalloc() ? MemoryAccounting::MimallocAllocator : MemoryAccounting::SystemAllocator;
+}
+
+std::atomic<MemoryAccounting::Allocator> currentAllocator = defaultAllocator();
+
+#ifdef KNUT_MIMALLOC
+bool useMimalloc()
+{
+    return currentAllocator.load(std::memory_order_relaxed) == MemoryAccounting::MimallocAllocator;
+}
+
+// Blocks allocated before a change of allocator are still freed by the one which allocated them
+bool isMimallocBlock(void *pointer)
+{
+    return pointer && mi_is_in_heap_region(pointer);
+}
+#endif
+
+size_t blockSize(void *pointer)
+{
+    if (!pointer)
+        return 0;
+#ifdef KNUT_MIMALLOC
+    if (isMimallocBlock(pointer))
+        return mi_usable_size(pointer);
+#endif
+#if defined(_WIN32)
+    return _msize(pointer);
+#elif defined(__APPLE__)
+    return malloc_size(pointer);
+#else
+    return malloc_usable_size(pointer);
+#endif
+}
+
+void account(MemoryAccounting::Subsystem subsystem, int64_t bytes)
+{
+    if (bytes == 0)
+        return;
+    auto &usage = usages[subsystem];
+    const auto allocated = usage.allocated.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    auto peak = usage.peak.load(std::memory_order_relaxed);
+    while (allocated > peak && !usage.peak.compare_exchange_weak(peak, allocated, std::memory_order_relaxed)) { }
+    threadUsages[subsystem] += bytes;
+}
+
+void *pugixmlAllocate(size_t size)
+{
+    return MemoryAccounting::allocate(MemoryAccounting::Pugixml, size);
+}
+
+void pugixmlDeallocate(void *pointer)
+{
+    MemoryAccounting::deallocate(MemoryAccounting::Pugixml, pointer);
+}
+
+} // namespace
+
+void MemoryAccounting::installPugixml()
+{
+    pugi::set_memory_management_functions(pugixmlAllocate, pugixmlDeallocate);
+}
+
+void MemoryAccounting::setAllocator(Allocator allocator)
+{
+    currentAllocator.store(allocator == MimallocAllocator && !hasMimalloc() ? SystemAllocator : allocator,
+                           std::memory_order_relaxed);
+}
+
+MemoryAccounting::Allocator MemoryAccounting::allocator()
+{
+    return currentAllocator.load(std::memory_order_relaxed);
+}
+
+bool MemoryAccounting::hasMimalloc()
+{
+#ifdef KNUT_MIMALLOC
+    return true;
+#else
+    return false;
+#endif
+}
+
+void *MemoryAccounting::allocate(Subsystem subsystem, size_t size)
+{
+#ifdef KNUT_MIMALLOC
+    auto pointer = useMimalloc() ? mi_malloc(size) : std::malloc(size);
+#else
+    auto pointer = std::malloc(size);
+#endif
+    account(subsystem, static_cast<int64_t>(blockSize(pointer)));
+    return pointer;
+}
+
+void *MemoryAccounting::allocateZeroed(Subsystem subsystem, size_t count, size_t size)
+{
+#ifdef KNUT_MIMALLOC
+    auto pointer = useMimalloc() ? mi_calloc(count, size) : std::calloc(count, size);
+#else
+    auto pointer = std::calloc(count, size);
+#endif
+    account(subsystem, static_cast<int64_t>(blockSize(pointer)));
+    return pointer;
+}
+
+void *MemoryAccounting::reallocate(Subsystem subsystem, void *pointer, size_t size)
+{
+    if (!pointer)
+        return allocate(subsystem, size);
+
+    const auto oldSize = static_cast<int64_t>(blockSize(pointer));
+#ifdef KNUT_MIMALLOC
+    auto result = isMimallocBlock(pointer) ? mi_realloc(pointer, size) : std::realloc(pointer, size);
+#else
+    auto result = std::realloc(pointer, size);
+#endif
+    // On failure, the old block is left untouched
+    if (result || size == 0)
+        account(subsystem, static_cast<int64_t>(blockSize(result)) - oldSize);
+    return result;
+}
+
+void MemoryAccounting::deallocate(Subsystem subsystem, void *pointer)
+{
+    account(subsystem, -static_cast<int64_t>(blockSize(pointer)));
+#ifdef KNUT_MIMALLOC
+    if (isMimallocBlock(pointer)) {
+        mi_free(pointer);
+        return;
+    }
+#endif
+    std::free(pointer);
+}
+
+int64_t MemoryAccounting::allocatedBytes(Subsystem subsystem)
+{
+    return usages[subsystem].allocated.load(std::memory_order_relaxed);
+}
+
+int64_t MemoryAccounting::peakBytes(Subsystem subsystem)
+{
+    return usages[subsystem].peak.load(std::memory_order_relaxed);
+}
+
+int64_t MemoryAccounting::threadAllocatedBytes(Subsystem subsystem)
+{
+    return threadUsages[subsystem];
+}
+
+const char *MemoryAccounting::name(Subsystem subsystem)
+{
+    switch (subsystem) {
+    case TreeSitter:
+        return "treesitter";
+    case Pugixml:
+        return "pugixml";
+    case SubsystemCount:
+        break;
+    }
+    return "";
+}
+
+} // namespace Utils
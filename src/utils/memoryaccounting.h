@@ -0,0 +1,87 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Utils {
+
+// Accounts the memory allocated by the 3rd-party libraries supporting custom allocation functions: tree-sitter
+// (ts_set_allocator) and pugixml (set_memory_management_functions).
+//
+// The size of a block is given by the C library (malloc_usable_size and friends), so blocks allocated before the
+// functions are installed can still be freed safely: they are only missing from the accounting.
+//
+// Besides the global usage, the net usage of each thread is kept: the difference between two calls to
+// threadAllocatedBytes gives the memory kept by the code in between, like the tree of a document after a parse.
+//
+// The blocks are allocated with the C library, or with mimalloc if Knut is built with KNUT_MIMALLOC: it's much faster
+// for the many small blocks of tree-sitter and pugixml. The KNUT_ALLOCATOR environment variable (`system` or
+// `mimalloc`) selects the allocator at runtime, to measure the difference. Each block is freed by the allocator which
+// allocated it, so the allocator can be changed at any time.
+//
+// This class is thread-safe.
+class MemoryAccounting
+{
+public:
+    enum Subsystem {
+        TreeSitter,
+        Pugixml,
+        SubsystemCount,
+    };
+
+    enum Allocator {
+        SystemAllocator,
+        MimallocAllocator,
+    };
+
+    // Installs the pugixml allocation functions, the tree-sitter ones are installed by treesitter::installAllocator
+    static void installPugixml();
+
+    // Allocator used for the new blocks, mimalloc is ignored if Knut is not built with it
+    static void setAllocator(Allocator allocator);
+    static Allocator allocator();
+    static bool hasMimalloc();
+
+    static void *allocate(Subsystem subsystem, size_t size);
+    static void *allocateZeroed(Subsystem subsystem, size_t count, size_t size);
+    static void *reallocate(Subsystem subsystem, void *pointer, size_t size);
+    static void deallocate(Subsystem subsystem, void *pointer);
+
+    // Bytes currently allocated in `subsystem`, by all threads
+    static int64_t allocatedBytes(Subsystem subsystem);
+    // Highest value of allocatedBytes since the start of the process
+    static int64_t peakBytes(Subsystem subsystem);
+    // Net bytes allocated in `subsystem` by the current thread, may be negative if it frees other threads' memory
+    static int64_t threadAllocatedBytes(Subsystem subsystem);
+
+    static const char *name(Subsystem subsystem);
+};
+
+// Measures the memory kept in `subsystem` by the current thread between its construction and bytes()
+class AllocationScope
+{
+public:
+    explicit AllocationScope(MemoryAccounting::Subsystem subsystem)
+        : m_subsystem(subsystem)
+        , m_start(MemoryAccounting::threadAllocatedBytes(subsystem))
+    {
+    }
+
+    int64_t bytes() const { return MemoryAccounting::threadAllocatedBytes(m_subsystem) - m_start; }
+
+private:
+    const MemoryAccounting::Subsystem m_subsystem;
+    const int64_t m_start;
+};
+
+} // namespace Utils
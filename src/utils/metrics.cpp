@@ -0,0 +1,217 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "metrics.h"
+
+#include <QFile>
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ranges>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+// windows.h must be included first
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace Utils {
+
+namespace {
+
+struct Registry
+{
+    std::mutex mutex;
+    // std::map keeps the metrics sorted by name, and the unique_ptr keeps the references stable
+    std::map<std::string, std::unique_ptr<Metrics::Counter>> counters;
+    std::map<std::string, std::unique_ptr<Metrics::Histogram>> histograms;
+};
+
+Registry &registry()
+{
+    static Registry registry;
+    return registry;
+}
+
+template <typename T>
+T &findOrCreate(std::map<std::string, std::unique_ptr<T>> &metrics, const std::string &name)
+{
+    std::lock_guard lock(registry().mutex);
+    auto &metric = metrics[name];
+    if (!metric)
+        metric = std::make_unique<T>();
+    return *metric;
+}
+
+} // namespace
+
+//=============================================================================
+// Metrics::Histogram
+//=============================================================================
+int Metrics::Histogram::bucketIndex(int64_t value)
+{
+    if (value < SubBucketCount)
+        return static_cast<int>(std::max<int64_t>(value, 0));
+    const int msb = std::bit_width(static_cast<uint64_t>(value)) - 1;
+    const int subBucket = static_cast<int>((value >> (msb - SubBucketBits)) & (SubBucketCount - 1));
+    return (msb - SubBucketBits + 1) * SubBucketCount + subBucket;
+}
+
+int64_t Metrics::Histogram::bucketUpperBound(int index)
+{
+    if (index < SubBucketCount)
+        return index;
+    const int msb = index / SubBucketCount + SubBucketBits - 1;
+    const int subBucket = index % SubBucketCount;
+    const auto lowerBound = static_cast<int64_t>(SubBucketCount + subBucket) << (msb - SubBucketBits);
+    return lowerBound + (int64_t(1) << (msb - SubBucketBits)) - 1;
+}
+
+void Metrics::Histogram::record(int64_t value)
+{
+    m_buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(value, std::memory_order_relaxed);
+
+    auto current = m_min.load(std::memory_order_relaxed);
+    while (value < current && !m_min.compare_exchange_weak(current, value, std::memory_order_relaxed)) { }
+    current = m_max.load(std::memory_order_relaxed);
+    while (value > current && !m_max.compare_exchange_weak(current, value, std::memory_order_relaxed)) { }
+}
+
+int64_t Metrics::Histogram::min() const
+{
+    return count() == 0 ? 0 : m_min.load(std::memory_order_relaxed);
+}
+
+int64_t Metrics::Histogram::percentile(double percentile) const
+{
+    const auto total = count();
+    if (total == 0)
+        return 0;
+
+    const auto rank = std::max<int64_t>(1, static_cast<int64_t>(std::ceil(total * percentile / 100.)));
+    int64_t seen = 0;
+    for (int i = 0; i < BucketCount; ++i) {
+        seen += m_buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank)
+            return std::min(bucketUpperBound(i), max());
+    }
+    return max();
+}
+
+void Metrics::Histogram::reset()
+{
+    for (auto &bucket : m_buckets)
+        bucket.store(0, std::memory_order_relaxed);
+    m_count.store(0, std::memory_order_relaxed);
+    m_sum.store(0, std::memory_order_relaxed);
+    m_min.store(INT64_MAX, std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+}
+
+nlohmann::json Metrics::Histogram::toJson() const
+{
+    return {
+        {"count", count()},      {"sum", sum()},          {"min", min()},          {"max", max()},
+        {"p50", percentile(50)}, {"p90", percentile(90)}, {"p99", percentile(99)},
+    };
+}
+
+//=============================================================================
+// Metrics
+//=============================================================================
+Metrics::Counter &Metrics::counter(const std::string &name)
+{
+    return findOrCreate(registry().counters, name);
+}
+
+Metrics::Histogram &Metrics::histogram(const std::string &name)
+{
+    return findOrCreate(registry().histograms, name);
+}
+
+#if !defined(Q_OS_WIN)
+static int64_t maxResidentSetSize(int who)
+{
+    rusage usage {};
+    if (getrusage(who, &usage) != 0)
+        return 0;
+#if defined(Q_OS_MACOS)
+    return usage.ru_maxrss;
+#else
+    // In kilobytes on Linux and the BSDs
+    return static_cast<int64_t>(usage.ru_maxrss) * 1024;
+#endif
+}
+#endif
+
+int64_t Metrics::peakResidentMemory()
+{
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters {};
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return static_cast<int64_t>(counters.PeakWorkingSetSize);
+#else
+    return maxResidentSetSize(RUSAGE_SELF);
+#endif
+}
+
+int64_t Metrics::childrenPeakResidentMemory()
+{
+#if defined(Q_OS_WIN)
+    // Windows doesn't keep the usage of the terminated child processes
+    return 0;
+#else
+    return maxResidentSetSize(RUSAGE_CHILDREN);
+#endif
+}
+
+nlohmann::json Metrics::toJson()
+{
+    auto &metrics = registry();
+    std::lock_guard lock(metrics.mutex);
+    auto counters = nlohmann::json::object();
+    for (const auto &[name, counter] : metrics.counters)
+        counters[name] = counter->value();
+    auto histograms = nlohmann::json::object();
+    for (const auto &[name, histogram] : metrics.histograms)
+        histograms[name] = histogram->toJson();
+    const nlohmann::json process = {{"peak_rss", peakResidentMemory()},
+                                    {"children_peak_rss", childrenPeakResidentMemory()}};
+    return {{"counters", counters}, {"histograms", histograms}, {"process", process}};
+}
+
+bool Metrics::save(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    file.write(QByteArray::fromStdString(toJson().dump(4)));
+    return true;
+}
+
+void Metrics::reset()
+{
+    auto &metrics = registry();
+    std::lock_guard lock(metrics.mutex);
+    for (auto &counter : metrics.counters | std::views::values)
+        counter->reset();
+    for (auto &histogram : metrics.histograms | std::views::values)
+        histogram->reset();
+}
+
+} // namespace Utils
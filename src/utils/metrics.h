@@ -0,0 +1,117 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QString>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <nlohmann/json.hpp>
+#include <string>
+
+namespace Utils {
+
+// Process-wide registry of counters and histograms, to know what happened during a run: number of parses, cache
+// hits, latencies...
+//
+// Metrics are created on first use and never destroyed, so the usual pattern is to keep a static reference:
+//     static auto &parses = Utils::Metrics::counter("treesitter.parses");
+//     parses.add();
+//
+// Recording a value is lock-free, this class is thread-safe.
+class Metrics
+{
+public:
+    class Counter
+    {
+    public:
+        void add(int64_t value = 1) { m_value.fetch_add(value, std::memory_order_relaxed); }
+        int64_t value() const { return m_value.load(std::memory_order_relaxed); }
+        void reset() { m_value.store(0, std::memory_order_relaxed); }
+
+    private:
+        std::atomic<int64_t> m_value = 0;
+    };
+
+    // Histogram with logarithmic buckets, each power of two being split in 8 linear buckets (like HdrHistogram), so
+    // the percentiles have a relative error below 12.5%.
+    class Histogram
+    {
+    public:
+        void record(int64_t value);
+
+        int64_t count() const { return m_count.load(std::memory_order_relaxed); }
+        int64_t sum() const { return m_sum.load(std::memory_order_relaxed); }
+        int64_t min() const;
+        int64_t max() const { return m_max.load(std::memory_order_relaxed); }
+        // Returns the upper bound of the bucket containing the given percentile (between 0 and 100)
+        int64_t percentile(double percentile) const;
+        void reset();
+
+        nlohmann::json toJson() const;
+
+    private:
+        static constexpr int SubBucketBits = 3;
+        static constexpr int SubBucketCount = 1 << SubBucketBits;
+        static constexpr int BucketCount = (64 - SubBucketBits + 1) * SubBucketCount;
+
+        static int bucketIndex(int64_t value);
+        static int64_t bucketUpperBound(int index);
+
+        std::array<std::atomic<int64_t>, BucketCount> m_buckets = {};
+        std::atomic<int64_t> m_count = 0;
+        std::atomic<int64_t> m_sum = 0;
+        std::atomic<int64_t> m_min = INT64_MAX;
+        std::atomic<int64_t> m_max = 0;
+    };
+
+    // Records the duration of a scope in a histogram, in microseconds
+    class ScopedTimer
+    {
+    public:
+        explicit ScopedTimer(Histogram &histogram)
+            : m_histogram(histogram)
+            , m_start(std::chrono::steady_clock::now())
+        {
+        }
+        ~ScopedTimer()
+        {
+            m_histogram.record(std::chrono::duration_cast<std::chrono::microseconds>(
+                                   std::chrono::steady_clock::now() - m_start)
+                                   .count());
+        }
+        ScopedTimer(const ScopedTimer &) = delete;
+        ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+    private:
+        Histogram &m_histogram;
+        const std::chrono::steady_clock::time_point m_start;
+    };
+
+    // Returns the metric `name`, creating it if needed: the reference stays valid until the end of the process
+    static Counter &counter(const std::string &name);
+    static Histogram &histogram(const std::string &name);
+
+    // Peak resident memory of the process, and of the largest of its child processes already terminated, in bytes.
+    // Returns 0 if it's not available on the platform.
+    static int64_t peakResidentMemory();
+    static int64_t childrenPeakResidentMemory();
+
+    // Returns all metrics, sorted by name, and the peak resident memory of the process
+    static nlohmann::json toJson();
+    // Saves all metrics as json in `fileName`, returns false if the file can't be written
+    static bool save(const QString &fileName);
+    // Resets all metrics to 0, used by the tests to start from a known state
+    static void reset();
+};
+
+} // namespace Utils
@@ -0,0 +1,85 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "regularexpressioncache.h"
+
+#include <QMutexLocker>
+
+namespace Utils {
+
+// Default number of expressions kept in the cache.
+constexpr int DefaultMaxSize = 256;
+
+RegularExpressionCache::RegularExpressionCache()
+    : m_cache(DefaultMaxSize)
+{
+}
+
+RegularExpressionCache &RegularExpressionCache::instance()
+{
+    static RegularExpressionCache cache;
+    return cache;
+}
+
+QRegularExpression RegularExpressionCache::regularExpression(const QString &pattern,
+                                                             QRegularExpression::PatternOptions options)
+{
+    const Key key {pattern, options.toInt()};
+    {
+        QMutexLocker locker(&m_mutex);
+        if (auto cached = m_cache.object(key)) {
+            ++m_hits;
+            return *cached;
+        }
+        ++m_misses;
+    }
+
+    // Don't hold the lock while compiling, see treesitter::QueryCache::query
+    QRegularExpression result(pattern, options);
+    result.optimize();
+
+    QMutexLocker locker(&m_mutex);
+    m_cache.insert(key, new QRegularExpression(result));
+    return result;
+}
+
+void RegularExpressionCache::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_cache.clear();
+    m_hits = 0;
+    m_misses = 0;
+}
+
+int RegularExpressionCache::maxSize() const
+{
+    QMutexLocker locker(&m_mutex);
+    return static_cast<int>(m_cache.maxCost());
+}
+
+void RegularExpressionCache::setMaxSize(int maxSize)
+{
+    QMutexLocker locker(&m_mutex);
+    m_cache.setMaxCost(maxSize);
+}
+
+int RegularExpressionCache::hits() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_hits;
+}
+
+int RegularExpressionCache::misses() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_misses;
+}
+
+} // namespace Utils
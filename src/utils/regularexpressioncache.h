@@ -0,0 +1,56 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QCache>
+#include <QMutex>
+#include <QRegularExpression>
+#include <QString>
+
+namespace Utils {
+
+// Process-wide cache of optimized regular expressions.
+//
+// Scripts tend to search for the same patterns over and over again, in loops or on many documents. The cache keeps
+// the most recently used expressions around, indexed by pattern and options, so each pattern is only compiled once.
+// Expressions are optimized when inserted, and as QRegularExpression is implicitly shared, the returned copies reuse
+// the compiled pattern.
+//
+// This class is thread-safe.
+class RegularExpressionCache
+{
+public:
+    static RegularExpressionCache &instance();
+
+    // Returns the expression, from the cache if possible.
+    // Invalid expressions are cached too, check QRegularExpression::isValid on the result.
+    QRegularExpression regularExpression(const QString &pattern, QRegularExpression::PatternOptions options = {});
+
+    void clear();
+
+    int maxSize() const;
+    void setMaxSize(int maxSize);
+
+    int hits() const;
+    int misses() const;
+
+private:
+    RegularExpressionCache();
+
+    using Key = std::pair<QString, int>;
+
+    mutable QMutex m_mutex;
+    QCache<Key, QRegularExpression> m_cache;
+    int m_hits = 0;
+    int m_misses = 0;
+};
+
+} // namespace Utils
@@ -0,0 +1,124 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "resultwriter.h"
+
+#include <QFile>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace Utils {
+
+// Size of the pending records written at once
+constexpr size_t ChunkSize = 64 * 1024;
+
+namespace {
+
+struct Channel
+{
+    std::mutex mutex;
+    std::unique_ptr<QFile> file;
+    std::string buffer;
+};
+
+Channel &channel()
+{
+    static Channel channel;
+    return channel;
+}
+
+// Must be called with the mutex locked
+void flush(Channel &channel)
+{
+    if (!channel.file || channel.buffer.empty())
+        return;
+    channel.file->write(channel.buffer.data(), static_cast<qint64>(channel.buffer.size()));
+    channel.buffer.clear();
+}
+
+} // namespace
+
+bool ResultWriter::open(const QString &fileName)
+{
+    close();
+
+    // The records are already buffered here
+    auto file = std::make_unique<QFile>();
+    if (fileName == "-") {
+        if (!file->open(stdout, QIODevice::WriteOnly | QIODevice::Unbuffered))
+            return false;
+    } else {
+        file->setFileName(fileName);
+        if (!file->open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered))
+            return false;
+    }
+
+    auto &results = channel();
+    std::lock_guard lock(results.mutex);
+    results.file = std::move(file);
+    return true;
+}
+
+bool ResultWriter::isOpen()
+{
+    auto &results = channel();
+    std::lock_guard lock(results.mutex);
+    return results.file != nullptr;
+}
+
+void ResultWriter::write(const nlohmann::json &record)
+{
+    // Serialized outside of the lock, strings coming from the documents may not be valid UTF-8
+    std::string line = record.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+    line += '\n';
+
+    auto &results = channel();
+    std::lock_guard lock(results.mutex);
+    if (!results.file)
+        return;
+    results.buffer += line;
+    if (results.buffer.size() >= ChunkSize)
+        flush(results);
+}
+
+bool ResultWriter::append(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    // Locked for the whole file, so the records written by other threads are not inserted in the middle of a line
+    auto &results = channel();
+    std::lock_guard lock(results.mutex);
+    if (!results.file)
+        return false;
+    while (!file.atEnd()) {
+        const QByteArray chunk = file.read(ChunkSize);
+        results.buffer.append(chunk.constData(), chunk.size());
+        // A file not ending with a newline would merge its last record with the next one
+        if (file.atEnd() && !chunk.isEmpty() && !chunk.endsWith('\n'))
+            results.buffer += '\n';
+        if (results.buffer.size() >= ChunkSize)
+            flush(results);
+    }
+    return true;
+}
+
+void ResultWriter::close()
+{
+    auto &results = channel();
+    std::lock_guard lock(results.mutex);
+    flush(results);
+    results.file.reset();
+}
+
+} // namespace Utils
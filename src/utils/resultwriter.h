@@ -0,0 +1,38 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QString>
+#include <nlohmann/json.hpp>
+
+namespace Utils {
+
+// Process-wide channel for the results reported by the scripts, written as one json record per line (JSON Lines).
+//
+// The records are serialized as they come, and written by chunks: a script can report millions of them without
+// keeping them in memory. The file name "-" writes to the standard output, so the results can be piped.
+//
+// This class is thread-safe.
+class ResultWriter
+{
+public:
+    // Opens `fileName`, truncating it, the previous file being closed. Returns false if it can't be written.
+    static bool open(const QString &fileName);
+    static bool isOpen();
+    // Writes `record` as one line, does nothing if no file is opened
+    static void write(const nlohmann::json &record);
+    // Writes all the records of the results file `fileName`, used to merge the results of other processes
+    static bool append(const QString &fileName);
+    // Writes the pending records, and closes the file
+    static void close();
+};
+
+} // namespace Utils
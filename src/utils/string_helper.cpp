@@ -9,36 +9,73 @@
 */
 
 #include "string_helper.h"
+#include "regularexpressioncache.h"
 
-#include <QSet>
 #include <QTextDocument>
+#include <algorithm>
+#include <optional>
+#include <vector>
 
 namespace Utils {
 
-static QString nextWordInString(const QString &str, QString::const_iterator &i, Case c)
+static bool isCaseSeparator(QChar ch, Case c)
 {
-    QString word;
+    switch (c) {
+    case Case::CamelCase:
+    case Case::PascalCase:
+        return ch.isUpper();
+    case Case::SnakeCase:
+    case Case::UpperCase:
+        return ch == '_';
+    case Case::KebabCase:
+        return ch == '-';
+    case Case::TitleCase:
+        break;
+    }
+    return ch == ' ';
+}
 
-    auto isSeparator = [&i, c]() {
-        if (c == Case::CamelCase || c == Case::PascalCase)
-            return i->isUpper();
-        else if (c == Case::SnakeCase || c == Case::UpperCase)
-            return *i == '_';
-        else if (c == Case::KebabCase)
-            return *i == '-';
-        return *i == ' ';
-    };
+static bool isAscii(QStringView str)
+{
+    return std::ranges::all_of(str, [](QChar ch) {
+        return ch.unicode() < 0x80;
+    });
+}
 
-    do {
-        word += *i;
-        i++;
-    } while (!isSeparator() && i != str.end());
+// Uncapitalized is upper case except for the first character
+enum class WordCase { Lower, Upper, Capitalized, Uncapitalized };
 
-    if (i != str.end()
-        && (c == Case::SnakeCase || c == Case::KebabCase || c == Case::UpperCase || c == Case::TitleCase))
-        i++;
+// Appends `word` to `result` with the given case, ASCII words are converted in place without any allocation
+static void appendWord(QString &result, QStringView word, WordCase wordCase)
+{
+    if (isAscii(word)) {
+        for (qsizetype i = 0; i < word.size(); ++i) {
+            const char16_t ch = word[i].unicode();
+            const bool upper = wordCase == WordCase::Upper || (wordCase == WordCase::Capitalized && i == 0)
+                || (wordCase == WordCase::Uncapitalized && i != 0);
+            if (upper)
+                result += QChar(ch >= 'a' && ch <= 'z' ? ch - 'a' + 'A' : ch);
+            else
+                result += QChar(ch >= 'A' && ch <= 'Z' ? ch - 'A' + 'a' : ch);
+        }
+        return;
+    }
+
+    // The full Unicode case mapping may change the length of the word
+    const bool upper = wordCase == WordCase::Upper || wordCase == WordCase::Uncapitalized;
+    QString w = upper ? word.toString().toUpper() : word.toString().toLower();
+    if (wordCase == WordCase::Capitalized)
+        w[0] = w.front().toUpper();
+    else if (wordCase == WordCase::Uncapitalized)
+        w[0] = w.front().toLower();
+    result += w;
+}
 
-    return word;
+static bool isTitleCaseException(QStringView word)
+{
+    static const QStringList exceptions = {"a",  "an", "the", "at", "by",  "for", "in",
+                                           "of", "on", "to",  "and", "as", "or"};
+    return word.size() <= 3 && exceptions.contains(word, Qt::CaseInsensitive);
 }
 
 QString convertCase(const QString &str, Case from, Case to)
@@ -46,62 +83,75 @@ QString convertCase(const QString &str, Case from, Case to)
     if (from == to)
         return str;
 
-    static const QSet<QString> titleCaseExceptions = {"a",  "an", "the", "at", "by",  "by", "for",
-                                                      "in", "of", "on",  "to", "and", "as", "or"};
+    const bool skipSeparator = from != Case::CamelCase && from != Case::PascalCase;
 
     QString result;
-
-    auto i = str.cbegin();
-    while (i < str.cend()) {
-        QString w = nextWordInString(str, i, from);
-        const bool firstWord = result.isEmpty();
+    // Most conversions add at most one separator for every few characters
+    result.reserve(str.size() + str.size() / 2);
+
+    const QStringView view(str);
+    qsizetype i = 0;
+    while (i < view.size()) {
+        // A word starts with the current character, even if it's a separator, and ends before the next separator
+        qsizetype end = i + 1;
+        while (end < view.size() && !isCaseSeparator(view[end], from))
+            ++end;
+        const auto word = view.sliced(i, end - i);
+        const bool firstWord = i == 0;
+        i = end;
+        if (i < view.size() && skipSeparator)
+            ++i;
 
         switch (to) {
         case Case::CamelCase:
-            w = w.toLower();
-            if (!firstWord)
-                w[0] = w.front().toUpper();
-            result += w;
+            appendWord(result, word, firstWord ? WordCase::Lower : WordCase::Capitalized);
             break;
         case Case::PascalCase:
-            w = w.toLower();
-            w[0] = w.front().toUpper();
-            result += w;
+            appendWord(result, word, WordCase::Capitalized);
             break;
         case Case::SnakeCase:
             if (!firstWord)
                 result += '_';
-            result += w.toLower();
+            appendWord(result, word, WordCase::Lower);
             break;
         case Case::KebabCase:
             if (!firstWord)
                 result += '-';
-            result += w.toLower();
+            appendWord(result, word, WordCase::Lower);
             break;
         case Case::UpperCase:
             if (!firstWord)
                 result += '_';
-            result += w.toUpper();
+            appendWord(result, word, WordCase::Upper);
             break;
         case Case::TitleCase:
             if (!firstWord)
                 result += ' ';
-            w = w.toLower();
-            if (firstWord || !titleCaseExceptions.contains(w))
-                w[0] = w.front().toUpper();
-            result += w;
+            appendWord(result, word,
+                       firstWord || !isTitleCaseException(word) ? WordCase::Capitalized : WordCase::Lower);
         }
     }
 
     return result;
 }
 
+QStringList convertCase(const QStringList &strings, Case from, Case to)
+{
+    QStringList result;
+    result.reserve(strings.size());
+    for (const auto &str : strings)
+        result.push_back(convertCase(str, from, to));
+    return result;
+}
+
 namespace Internal {
     // This function is copied from from Qt Creator.
-    QString matchCaseReplacement(const QString &originalText, const QString &replaceText)
+    static void appendMatchCaseReplacement(QString &result, QStringView originalText, QStringView replaceText)
     {
-        if (originalText.isEmpty() || replaceText.isEmpty())
-            return replaceText;
+        if (originalText.isEmpty() || replaceText.isEmpty()) {
+            result += replaceText;
+            return;
+        }
 
         // Now proceed with actual case matching
         bool firstIsUpperCase = originalText.at(0).isUpper();
@@ -119,19 +169,12 @@ namespace Internal {
                 break;
         }
 
-        if (restIsLowerCase) {
-            QString res = replaceText.toLower();
-            if (firstIsUpperCase)
-                res.replace(0, 1, res.at(0).toUpper());
-            return res;
-        } else if (restIsUpperCase) {
-            QString res = replaceText.toUpper();
-            if (firstIsLowerCase)
-                res.replace(0, 1, res.at(0).toLower());
-            return res;
-        } else {
-            return replaceText; // mixed
-        }
+        if (restIsLowerCase)
+            appendWord(result, replaceText, firstIsUpperCase ? WordCase::Capitalized : WordCase::Lower);
+        else if (restIsUpperCase)
+            appendWord(result, replaceText, firstIsLowerCase ? WordCase::Uncapitalized : WordCase::Upper);
+        else
+            result += replaceText; // mixed
     }
 }
 
@@ -157,19 +200,30 @@ QString matchCaseReplacement(const QString &originalText, const QString &replace
             break;
 
     // keep prefix and suffix, and do actual replacement on the 'middle' of the string
-    return originalText.left(prefixLen)
-        + Internal::matchCaseReplacement(originalText.mid(prefixLen, originalTextLen - prefixLen - suffixLen),
-                                         replaceText.mid(prefixLen, replaceTextLen - prefixLen - suffixLen))
-        + originalText.right(suffixLen);
+    const QStringView original(originalText);
+    const QStringView replace(replaceText);
+    QString result;
+    result.reserve(replaceTextLen);
+    result += original.first(prefixLen);
+    Internal::appendMatchCaseReplacement(result,
+                                         original.sliced(prefixLen, originalTextLen - prefixLen - suffixLen),
+                                         replace.sliced(prefixLen, replaceTextLen - prefixLen - suffixLen));
+    result += original.last(suffixLen);
+    return result;
 }
 
 // This function is copied from Qt creator.
 QString expandRegExpReplacement(const QString &replaceText, const QStringList &capturedTexts)
 {
+    // Most replacements don't use any capture, the text is shared and not copied
+    if (!replaceText.contains('\\') && !replaceText.contains('$'))
+        return replaceText;
+
     // handles \1 \\ \& \t \n $1 $$ $&
     QString result;
     const int numCaptures = capturedTexts.size() - 1;
     const int replaceLength = replaceText.length();
+    result.reserve(replaceLength);
     for (int i = 0; i < replaceLength; ++i) {
         QChar c = replaceText.at(i);
         if (c == QLatin1Char('\\') && i < replaceLength - 1) {
@@ -223,7 +277,289 @@ QRegularExpression createRegularExpression(const QString &txt, int flags, bool i
     if (txt.contains('\n'))
         options |= QRegularExpression::MultilineOption;
 
-    return QRegularExpression(isRegExp ? txt : QRegularExpression::escape(txt), options);
+    return RegularExpressionCache::instance().regularExpression(isRegExp ? txt : QRegularExpression::escape(txt),
+                                                                options);
+}
+
+// Scores used by fuzzyMatchScore, the same as fzf
+namespace FuzzyScore {
+constexpr int Match = 16;
+constexpr int GapStart = 3;
+constexpr int GapExtension = 1;
+constexpr int Boundary = Match / 2;
+constexpr int NonWord = Match / 2;
+constexpr int CamelCase = Boundary - GapExtension;
+constexpr int Consecutive = GapStart + GapExtension;
+constexpr int FirstCharMultiplier = 2;
+}
+
+static bool isWordChar(QChar c)
+{
+    return c.isLetterOrNumber();
+}
+
+static int fuzzyCharBonus(QChar previous, QChar c)
+{
+    if (!isWordChar(c))
+        return FuzzyScore::NonWord;
+    if (!isWordChar(previous))
+        return FuzzyScore::Boundary;
+    if ((previous.isLower() && c.isUpper()) || (!previous.isDigit() && c.isDigit()))
+        return FuzzyScore::CamelCase;
+    return 0;
+}
+
+int fuzzyMatchScore(QStringView pattern, QStringView text)
+{
+    if (pattern.isEmpty())
+        return 0;
+
+    // Find the end of the first match, then go backward to find the shortest one ending there
+    qsizetype p = 0;
+    qsizetype end = 0;
+    for (; end < text.size() && p < pattern.size(); ++end) {
+        if (text.at(end).toLower() == pattern.at(p).toLower())
+            ++p;
+    }
+    if (p < pattern.size())
+        return -1;
+
+    qsizetype start = end;
+    for (p = pattern.size() - 1; p >= 0; --start) {
+        if (text.at(start - 1).toLower() == pattern.at(p).toLower())
+            --p;
+    }
+
+    int score = 0;
+    int consecutive = 0;
+    // Bonus of the first character of the current consecutive chunk, shared by the whole chunk
+    int chunkBonus = 0;
+    bool inGap = false;
+    QChar previous = start > 0 ? text.at(start - 1) : QChar(u' ');
+    p = 0;
+    for (qsizetype i = start; i < end; ++i) {
+        const QChar c = text.at(i);
+        if (p < pattern.size() && c.toLower() == pattern.at(p).toLower()) {
+            int bonus = fuzzyCharBonus(previous, c);
+            if (consecutive == 0) {
+                chunkBonus = bonus;
+            } else {
+                if (bonus >= FuzzyScore::Boundary)
+                    chunkBonus = bonus;
+                bonus = std::max({bonus, chunkBonus, FuzzyScore::Consecutive});
+            }
+            if (p == 0)
+                bonus *= FuzzyScore::FirstCharMultiplier;
+            score += FuzzyScore::Match + bonus;
+            // Prefer the same case, when everything else is equal
+            if (c == pattern.at(p))
+                ++score;
+            ++consecutive;
+            inGap = false;
+            ++p;
+        } else {
+            score -= inGap ? FuzzyScore::GapExtension : FuzzyScore::GapStart;
+            consecutive = 0;
+            inGap = true;
+        }
+        previous = c;
+    }
+    return score;
+}
+
+namespace Diff {
+// Above this number of edits, the changed lines are shown as completely removed then added
+constexpr int MaximumEdits = 4096;
+
+struct Line
+{
+    char type; // ' ' for a common line, '-' for a removed one and '+' for an added one
+    QStringView text;
+};
+}
+
+// Returns the shortest edit script from `a` to `b`, or nothing if it needs more than Diff::MaximumEdits edits.
+// See "An O(ND) Difference Algorithm and Its Variations", Eugene W. Myers.
+static std::optional<std::vector<Diff::Line>> myersDiff(const QList<QStringView> &a, const QList<QStringView> &b)
+{
+    const int n = static_cast<int>(a.size());
+    const int m = static_cast<int>(b.size());
+    const int maxEdits = std::min(n + m, Diff::MaximumEdits);
+
+    // trace[d][k + d] is the furthest x reached on the diagonal k with d edits
+    std::vector<std::vector<int>> trace;
+    std::vector<int> previous;
+    int editCount = -1;
+    for (int d = 0; d <= maxEdits && editCount == -1; ++d) {
+        std::vector<int> current(2 * d + 1);
+        // Access the previous furthest x on the diagonal k, the diagonal k = 1 is 0 before the first edit
+        auto previousX = [&](int k) {
+            return d == 0 ? 0 : previous[k + d - 1];
+        };
+        for (int k = -d; k <= d; k += 2) {
+            int x = (k == -d || (k != d && previousX(k - 1) < previousX(k + 1))) ? previousX(k + 1)
+                                                                                : previousX(k - 1) + 1;
+            int y = x - k;
+            while (x < n && y < m && a[x] == b[y]) {
+                ++x;
+                ++y;
+            }
+            current[k + d] = x;
+            if (x >= n && y >= m) {
+                editCount = d;
+                break;
+            }
+        }
+        trace.push_back(current);
+        previous = std::move(current);
+    }
+    if (editCount == -1)
+        return {};
+
+    // Go back from the end to find the path
+    std::vector<Diff::Line> lines;
+    int x = n;
+    int y = m;
+    for (int d = editCount; d > 0; --d) {
+        const auto &previousTrace = trace[d - 1];
+        const int k = x - y;
+        const bool down = k == -d || (k != d && previousTrace[k - 1 + d - 1] < previousTrace[k + 1 + d - 1]);
+        const int previousK = down ? k + 1 : k - 1;
+        const int previousXValue = previousTrace[previousK + d - 1];
+        const int previousYValue = previousXValue - previousK;
+        while (x > previousXValue && y > previousYValue) {
+            lines.push_back({' ', a[--x]});
+            --y;
+        }
+        if (down)
+            lines.push_back({'+', b[--y]});
+        else
+            lines.push_back({'-', a[--x]});
+    }
+    while (x > 0 && y > 0) {
+        lines.push_back({' ', a[--x]});
+        --y;
+    }
+    std::reverse(lines.begin(), lines.end());
+    return lines;
+}
+
+QString unifiedDiff(const QString &before, const QString &after, int context)
+{
+    if (before == after)
+        return {};
+
+    // The lines keep their newline, so a last line without one is different from the same line with one
+    auto splitLines = [](const QString &text) {
+        QList<QStringView> lines;
+        qsizetype start = 0;
+        while (start < text.size()) {
+            const auto end = text.indexOf(u'\n', start);
+            const auto length = end == -1 ? text.size() - start : end - start + 1;
+            lines.push_back(QStringView(text).sliced(start, length));
+            start += length;
+        }
+        return lines;
+    };
+    const auto beforeLines = splitLines(before);
+    const auto afterLines = splitLines(after);
+
+    // Skip the common lines at the start and the end, keeping enough of them for the context
+    const qsizetype commonLength = std::min(beforeLines.size(), afterLines.size());
+    qsizetype prefix = 0;
+    while (prefix < commonLength && beforeLines[prefix] == afterLines[prefix])
+        ++prefix;
+    qsizetype suffix = 0;
+    while (suffix < commonLength - prefix
+           && beforeLines[beforeLines.size() - suffix - 1] == afterLines[afterLines.size() - suffix - 1])
+        ++suffix;
+
+    const auto changedBefore = beforeLines.mid(prefix, beforeLines.size() - prefix - suffix);
+    const auto changedAfter = afterLines.mid(prefix, afterLines.size() - prefix - suffix);
+    auto changes = myersDiff(changedBefore, changedAfter);
+    if (!changes) {
+        changes.emplace();
+        for (const auto &line : changedBefore)
+            changes->push_back({'-', line});
+        for (const auto &line : changedAfter)
+            changes->push_back({'+', line});
+    }
+
+    const qsizetype contextStart = std::max<qsizetype>(0, prefix - context);
+    const qsizetype contextEnd = std::min(beforeLines.size(), beforeLines.size() - suffix + context);
+    std::vector<Diff::Line> lines;
+    for (qsizetype i = contextStart; i < prefix; ++i)
+        lines.push_back({' ', beforeLines[i]});
+    lines.insert(lines.end(), changes->cbegin(), changes->cend());
+    for (qsizetype i = beforeLines.size() - suffix; i < contextEnd; ++i)
+        lines.push_back({' ', beforeLines[i]});
+
+    // Group the changes in hunks, two changes are in the same hunk if the context around them overlaps
+    QString result;
+    const auto size = static_cast<qsizetype>(lines.size());
+    auto beforeLine = contextStart + 1;
+    auto afterLine = contextStart + 1;
+    qsizetype index = 0;
+    while (index < size) {
+        auto firstChange = index;
+        while (firstChange < size && lines[firstChange].type == ' ')
+            ++firstChange;
+        if (firstChange == size)
+            break;
+        auto lastChange = firstChange;
+        for (auto i = firstChange + 1; i < size && i - lastChange <= 2 * context + 1; ++i) {
+            if (lines[i].type != ' ')
+                lastChange = i;
+        }
+
+        const auto hunkStart = std::max(index, firstChange - context);
+        const auto hunkEnd = std::min(size, lastChange + context + 1);
+        for (auto i = index; i < hunkStart; ++i) {
+            ++beforeLine;
+            ++afterLine;
+        }
+        QString hunk;
+        qsizetype beforeCount = 0;
+        qsizetype afterCount = 0;
+        for (auto i = hunkStart; i < hunkEnd; ++i) {
+            const auto &line = lines[i];
+            beforeCount += line.type != '+' ? 1 : 0;
+            afterCount += line.type != '-' ? 1 : 0;
+            hunk += QLatin1Char(line.type);
+            hunk += line.text;
+            if (!line.text.endsWith(u'\n'))
+                hunk += QStringLiteral("\n\\ No newline at end of file\n");
+        }
+        // As in GNU diff, an empty range starts at the line before it
+        result += QStringLiteral("@@ -%1,%2 +%3,%4 @@\n")
+                      .arg(beforeCount ? beforeLine : beforeLine - 1)
+                      .arg(beforeCount)
+                      .arg(afterCount ? afterLine : afterLine - 1)
+                      .arg(afterCount);
+        result += hunk;
+        beforeLine += beforeCount;
+        afterLine += afterCount;
+        index = hunkEnd;
+    }
+    return result;
+}
+
+QString gitPatch(const QString &fileName, const std::optional<QString> &before, const QString &after)
+{
+    const QString diff = unifiedDiff(before.value_or(QString()), after);
+    if (diff.isEmpty() && before)
+        return {};
+
+    QString result = QStringLiteral("diff --git a/%1 b/%1\n").arg(fileName);
+    if (!before)
+        result += QStringLiteral("new file mode 100644\n");
+    // An empty new file has no hunk, only the header
+    if (!diff.isEmpty()) {
+        result += before ? QStringLiteral("--- a/%1\n").arg(fileName) : QStringLiteral("--- /dev/null\n");
+        result += QStringLiteral("+++ b/%1\n").arg(fileName);
+        result += diff;
+    }
+    return result;
 }
 
 } // namespace Migration
@@ -12,6 +12,8 @@
 
 #include <QRegularExpression>
 #include <QString>
+#include <QStringList>
+#include <optional>
 
 namespace Utils {
 
@@ -24,6 +26,7 @@ enum class Case {
     TitleCase,
 };
 QString convertCase(const QString &str, Case from, Case to);
+QStringList convertCase(const QStringList &strings, Case from, Case to);
 
 QString matchCaseReplacement(const QString &originalText, const QString &replaceText);
 QString expandRegExpReplacement(const QString &replaceText, const QStringList &capturedTexts);
@@ -34,4 +37,27 @@ QString expandRegExpReplacement(const QString &replaceText, const QStringList &c
  */
 QRegularExpression createRegularExpression(const QString &txt, int flags, bool isRegExp = true);
 
+/**
+ * @brief fuzzyMatchScore
+ * Returns the score of `text` for the fuzzy `pattern`, or -1 if `text` doesn't contain all characters of `pattern`
+ * in order. The match is case insensitive, and favors consecutive characters and characters at word boundaries, like
+ * fzf does. An empty pattern matches everything with a score of 0.
+ */
+int fuzzyMatchScore(QStringView pattern, QStringView text);
+
+/**
+ * @brief unifiedDiff
+ * Returns the line by line difference between `before` and `after`, in the unified diff format with `context` lines
+ * around each change, or an empty string if they are identical. The common lines at the start and the end are
+ * skipped, only the lines in between are compared, using the Myers algorithm.
+ */
+QString unifiedDiff(const QString &before, const QString &after, int context = 3);
+
+/**
+ * @brief gitPatch
+ * Returns the change of the file `fileName` from `before` to `after` in the `git diff` format, which `git apply` and
+ * `patch -p1` accept, or an empty string if there is no change. If `before` is not set, the file is a new file.
+ */
+QString gitPatch(const QString &fileName, const std::optional<QString> &before, const QString &after);
+
 } // namespace Core
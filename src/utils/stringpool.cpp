@@ -0,0 +1,49 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "stringpool.h"
+
+#include <QHashFunctions>
+#include <QMutexLocker>
+
+namespace Utils {
+
+StringPool &StringPool::instance()
+{
+    static StringPool pool;
+    return pool;
+}
+
+QString StringPool::intern(QStringView text)
+{
+    const Key key {text, qHash(text)};
+    // The low bits are used by the buckets of the map, the shard uses the high ones
+    auto &shard = m_shards[(key.hash >> (sizeof(size_t) * 8 - 4)) % ShardCount];
+
+    QMutexLocker locker(&shard.mutex);
+    if (auto it = shard.strings.find(key); it != shard.strings.end())
+        return it->second;
+
+    QString result = text.toString();
+    shard.strings.emplace(Key {QStringView(result), key.hash}, result);
+    return result;
+}
+
+qsizetype StringPool::size() const
+{
+    qsizetype result = 0;
+    for (const auto &shard : m_shards) {
+        QMutexLocker locker(&shard.mutex);
+        result += static_cast<qsizetype>(shard.strings.size());
+    }
+    return result;
+}
+
+} // namespace Utils
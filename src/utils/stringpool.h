@@ -0,0 +1,73 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QMutex>
+#include <QString>
+#include <QStringView>
+#include <array>
+#include <unordered_map>
+
+namespace Utils {
+
+// Pool of interned strings.
+//
+// Identifiers are repeated over and over: symbol names, query capture names, predicate arguments, RC ids and the
+// macros of resource.h. Interning them means there's only one allocation for each of them, all the copies sharing
+// the same data (QString is implicitly shared).
+//
+// The pool is split in shards, each with its own lock, so threads interning different strings don't wait for each
+// other. The hash of a string is computed once per call, and used for both the shard and the lookup.
+//
+// This class is thread-safe.
+class StringPool
+{
+public:
+    StringPool() = default;
+
+    // Process-wide pool of the identifiers, kept until the end of the process
+    static StringPool &instance();
+
+    QString intern(QStringView text);
+
+    qsizetype size() const;
+
+private:
+    static constexpr size_t ShardCount = 16;
+
+    struct Key
+    {
+        // A view on the value, which is never modified
+        QStringView text;
+        size_t hash;
+
+        bool operator==(const Key &other) const { return hash == other.hash && text == other.text; }
+    };
+    struct KeyHash
+    {
+        size_t operator()(const Key &key) const { return key.hash; }
+    };
+    struct Shard
+    {
+        mutable QMutex mutex;
+        std::unordered_map<Key, QString, KeyHash> strings;
+    };
+
+    std::array<Shard, ShardCount> m_shards;
+};
+
+// Returns `text` from the process-wide pool, see StringPool
+inline QString intern(QStringView text)
+{
+    return StringPool::instance().intern(text);
+}
+
+} // namespace Utils
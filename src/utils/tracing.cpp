@@ -0,0 +1,156 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "tracing.h"
+
+#ifdef KNUT_TRACING_TRACY
+
+#include <cstring>
+
+namespace Utils {
+
+TraceScope::TraceScope(std::string_view name, const std::source_location &location)
+{
+    // Zones with a dynamic name need an allocated source location
+    const auto sourceLocation = ___tracy_alloc_srcloc_name(
+        location.line(), location.file_name(), std::strlen(location.file_name()), location.function_name(),
+        std::strlen(location.function_name()), name.data(), name.size(), 0);
+    m_zone = ___tracy_emit_zone_begin_alloc(sourceLocation, 1);
+}
+
+TraceScope::~TraceScope()
+{
+    ___tracy_emit_zone_end(m_zone);
+}
+
+} // namespace Utils
+
+#else
+
+#include <QCoreApplication>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <vector>
+
+namespace Utils {
+
+namespace {
+
+struct TraceEvent
+{
+    std::string name;
+    int64_t start;
+    int64_t duration;
+};
+
+// Each thread has its own buffer, the lock is only contended when the trace is saved
+struct ThreadBuffer
+{
+    int tid;
+    std::mutex mutex;
+    std::vector<TraceEvent> events;
+};
+
+struct TraceData
+{
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+};
+
+void saveTrace();
+
+// Never destroyed, so the buffers are still there when the trace is saved on exit
+TraceData &traceData()
+{
+    static TraceData *data = []() {
+        auto result = new TraceData;
+        std::atexit(saveTrace);
+        return result;
+    }();
+    return *data;
+}
+
+ThreadBuffer &threadBuffer()
+{
+    thread_local ThreadBuffer *buffer = nullptr;
+    if (!buffer) {
+        auto &data = traceData();
+        std::lock_guard lock(data.mutex);
+        data.buffers.push_back(std::make_unique<ThreadBuffer>());
+        buffer = data.buffers.back().get();
+        buffer->tid = static_cast<int>(data.buffers.size());
+        buffer->events.reserve(16 * 1024);
+    }
+    return *buffer;
+}
+
+// Nanoseconds since the first zone
+int64_t now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - traceData().start)
+        .count();
+}
+
+void saveTrace()
+{
+    auto &data = traceData();
+    std::lock_guard lock(data.mutex);
+
+    // Chrome trace event format, using complete events (ph: X), with timestamps in microseconds
+    nlohmann::json events = nlohmann::json::array();
+    const auto pid = QCoreApplication::applicationPid();
+    for (const auto &buffer : data.buffers) {
+        std::lock_guard bufferLock(buffer->mutex);
+        events.push_back({{"name", "thread_name"},
+                          {"ph", "M"},
+                          {"pid", pid},
+                          {"tid", buffer->tid},
+                          {"args", {{"name", "Thread " + std::to_string(buffer->tid)}}}});
+        for (const auto &event : buffer->events) {
+            events.push_back({{"name", event.name},
+                              {"ph", "X"},
+                              {"ts", event.start / 1000.0},
+                              {"dur", event.duration / 1000.0},
+                              {"pid", pid},
+                              {"tid", buffer->tid}});
+        }
+    }
+    const nlohmann::json trace = {{"traceEvents", std::move(events)}, {"displayTimeUnit", "ms"}};
+
+    const auto fileName = qEnvironmentVariable("KNUT_TRACE_FILE", "knut-trace.json").toStdString();
+    std::ofstream file(fileName);
+    file << trace.dump();
+}
+
+} // namespace
+
+TraceScope::TraceScope(std::string_view name, const std::source_location &location)
+    : m_name(name)
+    , m_start(now())
+{
+    Q_UNUSED(location)
+}
+
+TraceScope::~TraceScope()
+{
+    const auto end = now();
+    auto &buffer = threadBuffer();
+    std::lock_guard lock(buffer.mutex);
+    buffer.events.push_back({std::move(m_name), m_start, end - m_start});
+}
+
+} // namespace Utils
+
+#endif
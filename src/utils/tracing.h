@@ -0,0 +1,73 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+// Tracing zones, only compiled with the KNUT_TRACING CMake option: without it, KNUT_TRACE_SCOPE expands to nothing.
+//
+// Unlike Core::Profiler, which only records the API calls done from the main thread, the zones are recorded on all
+// threads. With Tracy available, the zones are sent to the Tracy profiler, otherwise they are saved on exit as a
+// Chrome trace in the file given by KNUT_TRACE_FILE (knut-trace.json by default), which can be opened in Perfetto.
+//
+// Usage, at the beginning of the scope to trace:
+//     KNUT_TRACE_SCOPE("Parser::parseString");
+
+#ifdef KNUT_TRACING
+
+#include <QString>
+#include <cstdint>
+#include <source_location>
+#include <string>
+#include <string_view>
+
+#ifdef KNUT_TRACING_TRACY
+#include <tracy/TracyC.h>
+#endif
+
+namespace Utils {
+
+// RAII zone, use the KNUT_TRACE_SCOPE macro for a local zone
+class TraceScope
+{
+public:
+    explicit TraceScope(std::string_view name, const std::source_location &location = std::source_location::current());
+    explicit TraceScope(const char *name, const std::source_location &location = std::source_location::current())
+        : TraceScope(std::string_view(name), location)
+    {
+    }
+    explicit TraceScope(const QString &name, const std::source_location &location = std::source_location::current())
+        : TraceScope(std::string_view(name.toStdString()), location)
+    {
+    }
+    ~TraceScope();
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+#ifdef KNUT_TRACING_TRACY
+    TracyCZoneCtx m_zone;
+#else
+    std::string m_name;
+    int64_t m_start;
+#endif
+};
+
+} // namespace Utils
+
+#define KNUT_TRACE_CONCAT_IMPL(a, b) a##b
+#define KNUT_TRACE_CONCAT(a, b) KNUT_TRACE_CONCAT_IMPL(a, b)
+#define KNUT_TRACE_SCOPE(name) const Utils::TraceScope KNUT_TRACE_CONCAT(knutTraceScope, __LINE__)(name)
+
+#else
+
+#define KNUT_TRACE_SCOPE(name) static_cast<void>(0)
+
+#endif
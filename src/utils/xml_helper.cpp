@@ -0,0 +1,46 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "xml_helper.h"
+
+#include <QFile>
+#include <algorithm>
+
+namespace Utils {
+
+static pugi::xml_parse_result errorResult(pugi::xml_parse_status status)
+{
+    pugi::xml_parse_result result;
+    result.status = status;
+    return result;
+}
+
+pugi::xml_parse_result loadXmlFile(pugi::xml_document &document, const QString &fileName, unsigned int options)
+{
+    document.reset();
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return errorResult(pugi::status_file_not_found);
+
+    // The buffer is allocated with pugixml allocator, so the document can free it
+    const auto size = static_cast<size_t>(file.size());
+    auto buffer = static_cast<char *>(pugi::get_memory_allocation_function()(std::max<size_t>(size, 1)));
+    if (!buffer)
+        return errorResult(pugi::status_out_of_memory);
+    if (file.read(buffer, static_cast<qint64>(size)) != static_cast<qint64>(size)) {
+        pugi::get_memory_deallocation_function()(buffer);
+        return errorResult(pugi::status_io_error);
+    }
+    // The buffer is owned by the document, even on failure
+    return document.load_buffer_inplace_own(buffer, size, options);
+}
+
+} // namespace Utils
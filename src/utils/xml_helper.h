@@ -0,0 +1,25 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QString>
+#include <pugixml.hpp>
+
+namespace Utils {
+
+// Loads the xml file `fileName` in `document`, replacing its content.
+// The file is read once in a buffer owned by the document, and parsed in place: the names and values of the nodes
+// point into the buffer instead of being copied. Unlike pugi::xml_document::load_file, `fileName` can be any path
+// readable by QFile, including non-Latin-1 paths and Qt resources.
+pugi::xml_parse_result loadXmlFile(pugi::xml_document &document, const QString &fileName,
+                                   unsigned int options = pugi::parse_default);
+
+} // namespace Utils
@@ -0,0 +1,55 @@
+// Migrates the dialog classes of a project generated by projectgen, the workload of the bench_migration benchmark
+//
+// For each class: converts its dialog to a ui file, replaces its message map by connections in OnInitDialog, declares
+// the ui in the header, then saves the header and the source. With --each, only the current document is migrated,
+// otherwise all the sources of the project, one after the other.
+
+let rcDocument = null
+
+function connection(className, entry) {
+    // Only the command handlers have a control id, like ON_BN_CLICKED(IDC_APPLY, OnBnClickedApply)
+    if (entry.parameters.length != 2)
+        return "// " + entry.name + " is not migrated"
+    let control = entry.parameters[0].text.replace(/^IDC_/, "").toLowerCase()
+    let handler = entry.parameters[1].text
+    return "connect(ui->" + control + ", &QAbstractButton::clicked, this, &" + className + "::" + handler + ");"
+}
+
+function migrate(fileName) {
+    let source = Project.open(fileName)
+    let messageMap = source.mfcExtractMessageMap()
+    if (!messageMap.isValid)
+        return
+    let className = messageMap.className
+    let header = source.openHeaderSource()
+
+    let id = header.text.match(/IDD = (\w+)/)
+    if (id) {
+        if (!rcDocument)
+            rcDocument = Project.get("Project.rc")
+        let dialog = rcDocument.dialog(id[1])
+        rcDocument.writeDialogToUi(dialog, source.fileName.replace(/\.cpp$/, ".ui"))
+    }
+
+    let code = ["ui->setupUi(this);"]
+    for (let entry of messageMap.entries)
+        code.push(connection(className, entry))
+    source.insertCodeInMethod("OnInitDialog", code.join("\n"), CppDocument.StartOfMethod)
+    messageMap.range.remove()
+    source.insertInclude("\"ui_" + className + ".h\"")
+    source.save()
+
+    header.insertForwardDeclaration("class Ui::" + className)
+    header.addMember("Ui::" + className + " *ui = nullptr", className, CppDocument.Private)
+    header.save()
+}
+
+function main() {
+    let current = Project.currentDocument
+    if (current) {
+        migrate(current.fileName)
+        return
+    }
+    for (let fileName of Project.allFilesWithExtension("cpp"))
+        migrate(fileName)
+}
@@ -0,0 +1,38 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+import QtQuick 2.12
+import Script 1.0
+import Script.Test 1.0
+
+TestCase {
+    name: "CodeDocument"
+
+    function test_astWalk() {
+        Project.root = Dir.currentScriptPath + "/projects/cpp-project"
+        var document = Project.open("main.cpp")
+
+        var main = document.astNodeAt(document.text.indexOf("main(")).parentNode().parentNode()
+        compare(main.type, "function_definition")
+
+        var calls = []
+        main.walk(function(node) { calls.push(node.text) }, ["call_expression"])
+        compare(calls, ["object.sayMessage()", "object.sayMessage(\"Another message\" /*a comment*/)",
+                        "freeFunction(1, 1)"])
+
+        // Returning false skips the descendants of the node
+        var types = []
+        main.walk(function(node) {
+            types.push(node.type)
+            return node.type !== "compound_statement"
+        }, ["compound_statement", "call_expression"])
+        compare(types, ["compound_statement"])
+    }
+}
@@ -91,6 +91,29 @@ TestCase {
         compare(files,["abc.txt","def.txt","hij.data","klm.data"])
     }
 
+    function test_walk() {
+        var testcase = Dir.create(Dir.currentScriptPath + "/tst_dir")
+
+        compare(testcase.walk(Dir.Files), ["a", "b", "c", "x/abc.txt", "x/data", "x/def.txt", "x/hij.data",
+                                           "x/klm.data", "y/foo"])
+        compare(testcase.walk(Dir.Dirs), ["x", "y"])
+        compare(testcase.walk(["*.txt", "foo"], Dir.Files), ["x/abc.txt", "x/def.txt", "y/foo"])
+    }
+
+    function test_glob() {
+        var testcase = Dir.create(Dir.currentScriptPath + "/tst_dir")
+
+        compare(testcase.glob("**/*.{txt,data}"), ["x/abc.txt", "x/def.txt", "x/hij.data", "x/klm.data"])
+        compare(testcase.glob("x/*.txt"), ["x/abc.txt", "x/def.txt"])
+        compare(testcase.glob("*/foo"), ["y/foo"])
+        compare(testcase.glob("?"), ["a", "b", "c", "x", "y"])
+        compare(testcase.glob("x/data"), ["x/data"])
+        compare(testcase.glob("x/none"), [])
+
+        Dir.currentPath = Dir.currentScriptPath
+        compare(Dir.glob("tst_dir/y/*"), ["tst_dir/y/foo"])
+    }
+
     function test_cd() {
         var dir = Dir.currentScript()
         var filesHere = dir.entryList()
@@ -0,0 +1,57 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+import QtQuick 2.12
+import Script 1.0
+import Script.Test 1.0
+
+TestCase {
+    name: "File"
+
+    property string one: Dir.currentScriptPath + "/tst_file/one.h"
+    property string two: Dir.currentScriptPath + "/tst_file/two.cpp"
+
+    function test_readAllBatch() {
+        var contents = File.readAllBatch([two, one, "bogus"])
+        compare(contents.length, 3)
+        compare(contents[0], "no match here\nCString\n")
+        compare(contents[1], File.readAll(one))
+        compare(contents[2], "")
+    }
+
+    function test_readLines() {
+        var it = File.readLines(one)
+        verify(it.hasNext())
+        compare(it.next(), "first line")
+        compare(it.nextLines(2), ["CString name;", "int value;"])
+        compare(it.nextLines(10), ["  CString other; CString third;"])
+        verify(!it.hasNext())
+        compare(it.next(), "")
+
+        it = File.readLines(two)
+        compare(it.nextLines(10), ["no match here", "CString"])
+    }
+
+    function test_grep() {
+        var hits = File.grep([one, two], "\\bCString\\b")
+        compare(hits.length, 3)
+        compare(hits[0].file, one)
+        compare(hits[0].line, 2)
+        compare(hits[0].column, 1)
+        compare(hits[0].text, "CString name;")
+        compare(hits[1].line, 4)
+        compare(hits[1].column, 3)
+        compare(hits[1].text, "  CString other; CString third;")
+        compare(hits[2].file, two)
+        compare(hits[2].line, 2)
+
+        compare(File.grep([one], "notfound").length, 0)
+    }
+}
@@ -0,0 +1,4 @@
+first line
+CString name;
+int value;
+  CString other; CString third;
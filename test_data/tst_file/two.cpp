@@ -0,0 +1,2 @@
+no match here
+CString
@@ -27,6 +27,21 @@ TestCase {
         compare(rcFiles[0], "MFC_UpdateGUI.rc")
     }
 
+    function test_allFilesUpdated() {
+        Project.root = Dir.currentScriptPath + "/projects/mfc-tutorial"
+        compare(Project.allFilesWithExtension("txt").length, 0)
+
+        // The list of files is updated when files are added or removed
+        var fileName = Project.root + "/res/newfile.txt"
+        verify(File.touch(fileName))
+        compare(Project.allFilesWithExtension("txt"), ["res/newfile.txt"])
+        compare(Project.allFiles().length, 11)
+
+        verify(File.remove(fileName))
+        compare(Project.allFilesWithExtension("txt").length, 0)
+        compare(Project.allFiles().length, 10)
+    }
+
     function test_open() {
         Project.root = Dir.currentScriptPath + "/projects/mfc-tutorial"
 
@@ -37,4 +52,20 @@ TestCase {
         compare(rcdoc.type, Document.Rc)
     }
 
+    function test_openPrevious() {
+        Project.root = Dir.currentScriptPath + "/projects/mfc-tutorial"
+
+        var cppdoc = Project.open("TutorialApp.cpp")
+        var headerdoc = Project.open("TutorialApp.h")
+        compare(Project.get(Project.root + "/TutorialApp.cpp"), cppdoc)
+        compare(Project.get("TutorialApp.h"), headerdoc)
+
+        // get doesn't change the order of the documents, open does
+        compare(Project.openPrevious(), cppdoc)
+        compare(Project.openPrevious(), headerdoc)
+        var documents = Project.documents
+        compare(documents[documents.length - 1], headerdoc)
+        compare(documents[documents.length - 2], cppdoc)
+    }
+
 }
@@ -0,0 +1,218 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "common/benchmark_utils.h"
+#include "common/test_utils.h"
+#include "core/codedocument.h"
+#include "core/knutcore.h"
+#include "core/mark.h"
+#include "core/project.h"
+#include "core/textdocument.h"
+#include "lsp/responseparser.h"
+#include "treesitter/languages.h"
+#include "treesitter/parser.h"
+
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <memory>
+#include <pugixml.hpp>
+
+// Benchmarks for the core hot paths, on a synthetic project: a big C++ file made of a sample file repeated
+// multiple times, and many small files.
+// The number of repetitions can be changed with the KNUT_BENCH_SCALE environment variable (default 50).
+class BenchCore : public QObject
+{
+    Q_OBJECT
+
+    static constexpr int FileCount = 2000;
+    static constexpr int LocationCount = 10000;
+
+    void createProject()
+    {
+        QVERIFY(m_dir.isValid());
+
+        QFile sample(Test::testDataPath() + "/projects/mfc-tutorial/TutorialDlg.cpp");
+        QVERIFY(sample.open(QIODevice::ReadOnly));
+        const QString content = QString::fromUtf8(sample.readAll());
+        bool ok = false;
+        int scale = qEnvironmentVariableIntValue("KNUT_BENCH_SCALE", &ok);
+        if (!ok)
+            scale = 50;
+        // The benchmarks may be run multiple times by the same process, see Test::runBenchmark
+        m_source.clear();
+        m_source.reserve(content.size() * scale);
+        for (int i = 0; i < scale; ++i)
+            m_source += content;
+
+        QFile file(m_dir.filePath("big.cpp"));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(m_source.toUtf8());
+        file.close();
+
+        QDir root(m_dir.path());
+        for (int i = 0; i < FileCount; ++i) {
+            const QString subDir = QString("dir%1").arg(i % 20);
+            root.mkpath(subDir);
+            QFile small(root.filePath(QString("%1/file%2.cpp").arg(subDir).arg(i)));
+            QVERIFY(small.open(QIODevice::WriteOnly));
+        }
+    }
+
+    QTemporaryDir m_dir;
+    QString m_source;
+    std::unique_ptr<Core::KnutCore> m_core;
+    Core::CodeDocument *m_document = nullptr;
+
+private slots:
+    void initTestCase()
+    {
+        Q_INIT_RESOURCE(core);
+        createProject();
+        m_core = std::make_unique<Core::KnutCore>();
+        QVERIFY(Core::Project::instance()->setRoot(m_dir.path()));
+        m_document = qobject_cast<Core::CodeDocument *>(Core::Project::instance()->open("big.cpp"));
+        QVERIFY(m_document);
+    }
+
+    void parseString()
+    {
+        treesitter::Parser parser(tree_sitter_cpp());
+        QBENCHMARK {
+            const auto tree = parser.parseString(m_source);
+            QVERIFY(tree.has_value());
+        }
+    }
+
+    // Many small allocations, like the DOM of a big .ui or .ts file
+    void buildXmlDocument()
+    {
+        std::string xml = "<ui><widget class=\"QDialog\">";
+        for (int i = 0; i < LocationCount; ++i) {
+            xml += R"(<widget class="QPushButton" name="button)" + std::to_string(i)
+                + R"("><property name="text"><string>Button</string></property></widget>)";
+        }
+        xml += "</widget></ui>";
+
+        QBENCHMARK {
+            pugi::xml_document document;
+            QVERIFY(document.load_string(xml.c_str()));
+        }
+    }
+
+    void query_data()
+    {
+        QTest::addColumn<QString>("query");
+
+        QTest::newRow("functions") << "(function_definition) @function";
+        QTest::newRow("calls") << "(call_expression function: (_) @name)";
+        QTest::newRow("identifiers") << "(identifier) @id";
+    }
+
+    void query()
+    {
+        QFETCH(QString, query);
+        // Parse the document first, only the query is measured
+        QVERIFY(!m_document->query(query, 1).isEmpty());
+        QBENCHMARK {
+            QVERIFY(!m_document->query(query).isEmpty());
+        }
+    }
+
+    void predicates_data()
+    {
+        QTest::addColumn<QString>("query");
+
+        QTest::newRow("eq") << R"(((identifier) @id (#eq? @id "CTutorialDlg")))";
+        QTest::newRow("match") << R"(((identifier) @id (#match? "^On" @id)))";
+        QTest::newRow("like") << R"(((identifier) @id (#like? "CTutorialDlg" @id)))";
+    }
+
+    void predicates()
+    {
+        QFETCH(QString, query);
+        QVERIFY(!m_document->query(query, 1).isEmpty());
+        QBENCHMARK {
+            QVERIFY(!m_document->query(query).isEmpty());
+        }
+    }
+
+    // The text is set in each iteration, so the replacements always happen
+    void replaceAll()
+    {
+        Core::TextDocument document;
+        QBENCHMARK {
+            document.setText(m_source);
+            QVERIFY(document.replaceAll("CTutorialDlg", "CBenchmarkDialog") > 0);
+        }
+    }
+
+    void replaceAllRegexp()
+    {
+        Core::TextDocument document;
+        QBENCHMARK {
+            document.setText(m_source);
+            QVERIFY(document.replaceAllRegexp(R"(m_(\w+))", "m_\\1Bench") > 0);
+        }
+    }
+
+    void marksUnderEdits()
+    {
+        Core::TextDocument document;
+        document.setText(m_source);
+        const int length = static_cast<int>(m_source.size());
+        QVector<Core::Mark> marks;
+        for (int i = 0; i < 1000; ++i)
+            marks.push_back(document.createMark(static_cast<int>(static_cast<qint64>(length) * i / 1000)));
+
+        QBENCHMARK {
+            for (int i = 0; i < 100; ++i) {
+                document.setPosition(static_cast<int>(static_cast<qint64>(length) * i / 100));
+                document.insert("x");
+            }
+        }
+    }
+
+    void allFiles()
+    {
+        QBENCHMARK {
+            QVERIFY(Core::Project::instance()->allFiles().size() > FileCount);
+        }
+    }
+
+    void lspLocationsResponse()
+    {
+        std::string content = R"({"jsonrpc":"2.0","id":42,"result":[)";
+        for (int i = 0; i < LocationCount; ++i) {
+            if (i > 0)
+                content += ',';
+            content += R"({"uri":"file:///project/src/file)" + std::to_string(i % 100)
+                + R"(.cpp","range":{"start":{"line":)" + std::to_string(i) + R"(,"character":4},"end":{"line":)"
+                + std::to_string(i) + R"(,"character":12}}})";
+        }
+        content += "]}";
+        const QByteArrayView view(content.data(), static_cast<qsizetype>(content.size()));
+
+        QBENCHMARK {
+            QVERIFY(Lsp::peekMessageId(view).has_value());
+            Lsp::LocationsResponse response;
+            QVERIFY(Lsp::parseLocationsResponse(view, response));
+        }
+    }
+
+    void cleanupTestCase()
+    {
+        m_document = nullptr;
+        m_core.reset();
+    }
+};
+
+KNUT_BENCHMARK_MAIN(BenchCore)
+#include "bench_core.moc"
@@ -0,0 +1,138 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "common/benchmark_utils.h"
+#include "common/test_utils.h"
+
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QProcess>
+#include <QTemporaryDir>
+#include <QTest>
+#include <algorithm>
+#include <nlohmann/json.hpp>
+
+// End-to-end benchmark of a migration run, on a synthetic project generated by projectgen: the script
+// test_data/bench_migration/migration.js converts the dialog of each class to a ui file, replaces its message map and
+// edits its header and source. The project is migrated by one knut process, then with --each at 1 to 16 jobs, with
+// and without the LSP server (knut-cli never starts one, knut does).
+//
+// Besides the wall time, each run reports the throughput (sources migrated per second), the peak resident memory of
+// the largest process, and the scaling efficiency: the speedup over the single process run, divided by the jobs.
+// The number of classes can be changed with the KNUT_BENCH_SCALE environment variable (default 200).
+class BenchMigration : public QObject
+{
+    Q_OBJECT
+
+    int classCount() const
+    {
+        bool ok = false;
+        const int scale = qEnvironmentVariableIntValue("KNUT_BENCH_SCALE", &ok);
+        return ok ? scale : 200;
+    }
+
+    void generateProject(const QString &path)
+    {
+        QProcess process;
+        process.start(PROJECTGEN_EXECUTABLE, {"--classes", QString::number(classCount()), path});
+        QVERIFY(process.waitForFinished(-1));
+        QCOMPARE(process.exitCode(), 0);
+    }
+
+    // Runs the migration on the project in `path`, `jobs` at 0 runs it in one process
+    void runMigration(const QString &path, int jobs, bool lsp)
+    {
+        const QString metricsFile = path + "/knut-metrics.json";
+        QStringList arguments {path, "--run", Test::testDataPath() + "/bench_migration/migration.js", "--metrics",
+                               metricsFile};
+        if (jobs > 0)
+            arguments << "--each" << "**/*.cpp" << "--jobs" << QString::number(jobs);
+
+        QProcess process;
+        // knut needs a platform to run, even without windows
+        auto environment = QProcessEnvironment::systemEnvironment();
+        environment.insert("QT_QPA_PLATFORM", "offscreen");
+        process.setProcessEnvironment(environment);
+        process.setWorkingDirectory(path);
+        process.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+        process.setStandardOutputFile(QProcess::nullDevice());
+
+        QElapsedTimer timer;
+        timer.start();
+        process.start(lsp ? KNUT_EXECUTABLE : KNUT_CLI_EXECUTABLE, arguments);
+        QVERIFY(process.waitForFinished(-1));
+        m_msecs = static_cast<double>(timer.nsecsElapsed()) / 1e6;
+        QCOMPARE(process.exitStatus(), QProcess::NormalExit);
+        QCOMPARE(process.exitCode(), 0);
+
+        // All the dialogs are converted
+        int uiCount = 0;
+        for (QDirIterator it(path, {"*.ui"}, QDir::Files, QDirIterator::Subdirectories); it.hasNext(); it.next())
+            ++uiCount;
+        QCOMPARE(uiCount, classCount());
+
+        QFile file(metricsFile);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        const auto metrics = nlohmann::json::parse(file.readAll().toStdString());
+        const auto &memory = metrics["process"];
+        m_peakMemory = std::max(memory["peak_rss"].get<int64_t>(), memory["children_peak_rss"].get<int64_t>());
+    }
+
+    double m_msecs = 0;
+    int64_t m_peakMemory = 0;
+    // Wall time of the single process runs, with and without LSP
+    QHash<bool, double> m_singleProcessMsecs;
+
+private slots:
+    void migration_data()
+    {
+        QTest::addColumn<int>("jobs");
+        QTest::addColumn<bool>("lsp");
+
+        // The single process run is first, for the scaling efficiency of the other ones
+        for (const bool lsp : {false, true}) {
+            const char *server = lsp ? "lsp" : "nolsp";
+            QTest::addRow("single-%s", server) << 0 << lsp;
+            for (const int jobs : {1, 2, 4, 8, 16})
+                QTest::addRow("jobs%d-%s", jobs, server) << jobs << lsp;
+        }
+    }
+
+    void migration()
+    {
+        QFETCH(int, jobs);
+        QFETCH(bool, lsp);
+        if (lsp)
+            CHECK_CLANGD;
+
+        // The project is generated for each run, as the migration changes it
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        generateProject(dir.path());
+        if (QTest::currentTestFailed())
+            return;
+        runMigration(dir.path(), jobs, lsp);
+        if (QTest::currentTestFailed())
+            return;
+
+        QTest::setBenchmarkResult(m_msecs, QTest::WalltimeMilliseconds);
+        Test::addBenchmarkResult("FilesPerSecond", classCount() * 1000.0 / m_msecs);
+        Test::addBenchmarkResult("PeakResidentBytes", static_cast<double>(m_peakMemory));
+        if (jobs == 0)
+            m_singleProcessMsecs[lsp] = m_msecs;
+        else if (m_singleProcessMsecs.contains(lsp))
+            Test::addBenchmarkResult("ScalingEfficiency", m_singleProcessMsecs.value(lsp) / m_msecs / jobs);
+    }
+};
+
+KNUT_BENCHMARK_MAIN(BenchMigration)
+#include "bench_migration.moc"
@@ -0,0 +1,144 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "common/benchmark_utils.h"
+#include "common/test_utils.h"
+#include "rccore/lexer.h"
+#include "rccore/rcfile.h"
+
+#include <QBuffer>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+
+using namespace RcCore;
+
+// Benchmarks for the RC pipeline, on a synthetic big RC file: the sample files are repeated multiple times.
+// The number of repetitions can be changed with the KNUT_BENCH_SCALE environment variable (default 20).
+class BenchRc : public QObject
+{
+    Q_OBJECT
+
+    static inline QString en_US = "LANG_ENGLISH;SUBLANG_ENGLISH_US";
+
+    QString sampleDir() const { return Test::testDataPath() + "/rcfiles/cryEdit"; }
+
+    // Create the big RC file in the same directory as the sample, so the includes are still found
+    void createScaledFile()
+    {
+        QFile sample(sampleDir() + "/CryEdit.rc");
+        QVERIFY(sample.open(QIODevice::ReadOnly));
+        const QByteArray content = sample.readAll();
+        bool ok = false;
+        int scale = qEnvironmentVariableIntValue("KNUT_BENCH_SCALE", &ok);
+        if (!ok)
+            scale = 20;
+
+        m_fileName = sampleDir() + "/bench_scaled.rc";
+        QFile file(m_fileName);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        for (int i = 0; i < scale; ++i)
+            file.write(content);
+        file.close();
+
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        m_content = Stream(&file).content();
+    }
+
+    RcFile m_rcFile;
+    QString m_fileName;
+    QString m_content;
+
+private slots:
+    void initTestCase()
+    {
+        createScaledFile();
+        m_rcFile = parse(m_fileName);
+        QVERIFY(m_rcFile.isValid);
+        QVERIFY(m_rcFile.data.contains(en_US));
+    }
+
+    void cleanupTestCase() { QFile::remove(m_fileName); }
+
+    void lexer()
+    {
+        QBENCHMARK {
+            Lexer lexer(Stream {m_content});
+            while (lexer.next()) { }
+        }
+    }
+
+    void parse()
+    {
+        QBENCHMARK {
+            const auto rcFile = RcCore::parse(m_fileName);
+            QVERIFY(rcFile.isValid);
+        }
+    }
+
+    void reparseUnchanged()
+    {
+        QBENCHMARK {
+            const auto rcFile = RcCore::parse(m_fileName, m_rcFile);
+            QVERIFY(rcFile.isValid);
+        }
+    }
+
+    void convertDialog()
+    {
+        const auto &data = m_rcFile.data[en_US];
+        QBENCHMARK {
+            for (const auto &dialog : data.dialogs)
+                RcCore::convertDialog(data, dialog, RcCore::Widget::AllFlags);
+        }
+    }
+
+    void convertActions()
+    {
+        const auto &data = m_rcFile.data[en_US];
+        QBENCHMARK {
+            RcCore::convertActions(data);
+        }
+    }
+
+    void writeDialogToUi()
+    {
+        const auto &data = m_rcFile.data[en_US];
+        QList<Widget> widgets;
+        for (const auto &dialog : data.dialogs)
+            widgets.push_back(RcCore::convertDialog(data, dialog, RcCore::Widget::AllFlags));
+
+        QBENCHMARK {
+            for (const auto &widget : std::as_const(widgets)) {
+                QBuffer buffer;
+                buffer.open(QIODevice::WriteOnly);
+                RcCore::writeDialogToUi(widget, &buffer);
+            }
+        }
+    }
+
+    void writeAssetsToImage()
+    {
+        // Write the images in a temporary directory, not next to the sample ones
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        auto assets = RcCore::convertAssets(m_rcFile.data[en_US]);
+        for (int i = 0; i < assets.size(); ++i)
+            assets[i].fileName = dir.filePath(QString::number(i) + ".png");
+
+        QBENCHMARK {
+            RcCore::writeAssetsToImage(assets);
+        }
+    }
+};
+
+KNUT_BENCHMARK_MAIN(BenchRc)
+
+#include "bench_rc.moc"
@@ -0,0 +1,48 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "common/benchmark_utils.h"
+#include "core/knutcore.h"
+#include "gui/mainwindow.h"
+
+#include <QPointer>
+#include <QTest>
+
+// Benchmark for the startup of the GUI: time from the construction of the main window to its first paint.
+// The window is painted synchronously when it's exposed.
+class BenchStartup : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase()
+    {
+        Q_INIT_RESOURCE(core);
+        Q_INIT_RESOURCE(gui);
+    }
+
+    void timeToFirstPaint()
+    {
+        Core::KnutCore core;
+        QBENCHMARK {
+            QPointer<Gui::MainWindow> window = new Gui::MainWindow;
+            window->show();
+            QVERIFY(QTest::qWaitForWindowExposed(window));
+
+            // The window is deleted on close
+            window->close();
+            QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+            QVERIFY(window.isNull());
+        }
+    }
+};
+
+KNUT_BENCHMARK_MAIN(BenchStartup)
+#include "bench_startup.moc"
@@ -0,0 +1,155 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QApplication>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QTest>
+#include <QXmlStreamReader>
+#include <algorithm>
+#include <map>
+#include <nlohmann/json.hpp>
+#include <ranges>
+#include <tuple>
+#include <vector>
+
+namespace Test {
+
+// Json results of the benchmarks, keyed by function, tag and metric
+using BenchmarkResults = std::map<std::tuple<QString, QString, QString>, nlohmann::json>;
+
+// Returns the result for `function`, `tag` and `metric` in `results`, creating it if needed
+inline nlohmann::json &benchmarkResult(BenchmarkResults &results, const QString &function, const QString &tag,
+                                       const QString &metric, int iterations = 1)
+{
+    auto &result = results[{function, tag, metric}];
+    if (result.is_null()) {
+        result = {
+            {"function", function.toStdString()},
+            {"tag", tag.toStdString()},
+            {"metric", metric.toStdString()},
+            {"iterations", iterations},
+            {"values", nlohmann::json::array()},
+        };
+    }
+    return result;
+}
+
+// Results added with addBenchmarkResult
+inline BenchmarkResults &customBenchmarkResults()
+{
+    static BenchmarkResults results;
+    return results;
+}
+
+/**
+ * Adds a result for the current test function and data tag, for the metrics QtTest doesn't measure, like a throughput
+ * or a memory peak. It can be called multiple times per function, once per metric.
+ *
+ * The results are saved with the ones of QtTest by runBenchmark. The metric names ending with `PerSecond`, and
+ * `ScalingEfficiency`, are better when higher for benchcompare.
+ */
+inline void addBenchmarkResult(const QString &metric, double value)
+{
+    const QString function = QString::fromLatin1(QTest::currentTestFunction());
+    const QString tag = QString::fromLatin1(QTest::currentDataTag());
+    benchmarkResult(customBenchmarkResults(), function, tag, metric)["values"].push_back(value);
+    qInfo("RESULT : %s():\"%s\": %g %s", qPrintable(function), qPrintable(tag), value, qPrintable(metric));
+}
+
+// Adds the benchmark results of a QtTest xml report to `results`
+inline void readBenchmarkResults(QIODevice *device, BenchmarkResults &results)
+{
+    QString function;
+    QXmlStreamReader xml(device);
+    while (!xml.atEnd()) {
+        if (xml.readNext() != QXmlStreamReader::StartElement)
+            continue;
+        const auto attributes = xml.attributes();
+        if (xml.name() == u"TestFunction") {
+            function = attributes.value("name").toString();
+        } else if (xml.name() == u"BenchmarkResult") {
+            auto &result = benchmarkResult(results, function, attributes.value("tag").toString(),
+                                           attributes.value("metric").toString(),
+                                           attributes.value("iterations").toInt());
+            result["values"].push_back(attributes.value("value").toDouble());
+        }
+    }
+}
+
+/**
+ * Runs the benchmarks of `object`, like QTest::qExec.
+ *
+ * If the KNUT_BENCH_JSON environment variable is set, the results are also saved as json in the file it contains,
+ * so they can be compared between releases with the benchcompare tool. The benchmarks are then run
+ * KNUT_BENCH_RUNS times (1 by default): each result has the values of all runs, and their median as its value.
+ */
+inline int runBenchmark(QObject *object, int argc, char *argv[])
+{
+    const QString jsonFile = qEnvironmentVariable("KNUT_BENCH_JSON");
+    if (jsonFile.isEmpty())
+        return QTest::qExec(object, argc, argv);
+
+    const int runs = std::max(1, qEnvironmentVariableIntValue("KNUT_BENCH_RUNS"));
+    QTemporaryDir dir;
+    const QString xmlFile = dir.filePath("results.xml");
+    QStringList arguments;
+    for (int i = 0; i < argc; ++i)
+        arguments.push_back(QString::fromLocal8Bit(argv[i]));
+    arguments << "-o" << xmlFile + ",xml" << "-o" << "-,txt";
+
+    BenchmarkResults results;
+    int result = 0;
+    for (int run = 0; run < runs && result == 0; ++run) {
+        result = QTest::qExec(object, arguments);
+        QFile xml(xmlFile);
+        if (!xml.open(QIODevice::ReadOnly)) {
+            qWarning("Can't read the benchmark results in %s", qPrintable(xmlFile));
+            return result == 0 ? 1 : result;
+        }
+        readBenchmarkResults(&xml, results);
+    }
+    results.merge(customBenchmarkResults());
+
+    QFile json(jsonFile);
+    if (!json.open(QIODevice::WriteOnly)) {
+        qWarning("Can't save the benchmark results in %s", qPrintable(jsonFile));
+        return result == 0 ? 1 : result;
+    }
+    auto array = nlohmann::json::array();
+    for (auto &value : results | std::views::values) {
+        auto values = value["values"].get<std::vector<double>>();
+        std::ranges::sort(values);
+        const auto middle = values.size() / 2;
+        value["value"] = values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+        array.push_back(std::move(value));
+    }
+    const nlohmann::json output = {{"benchmark", QFileInfo(arguments.first()).baseName().toStdString()},
+                                   {"runs", runs},
+                                   {"results", array}};
+    json.write(QByteArray::fromStdString(output.dump(4)));
+    return result;
+}
+
+} // namespace Test
+
+// Same as QTEST_MAIN, using Test::runBenchmark to run the benchmarks
+#define KNUT_BENCHMARK_MAIN(TestObject)                                                                                \
+    int main(int argc, char *argv[])                                                                                   \
+    {                                                                                                                  \
+        QApplication app(argc, argv);                                                                                  \
+        app.setAttribute(Qt::AA_Use96Dpi, true);                                                                       \
+        TestObject tc;                                                                                                 \
+        QTEST_SET_MAIN_SOURCE_PATH                                                                                     \
+        return Test::runBenchmark(&tc, argc, argv);                                                                    \
+    }
@@ -14,6 +14,7 @@
 #include "lsp/notifications.h"
 #include "lsp/requestmessage_json.h"
 #include "lsp/requests.h"
+#include "lsp/responseparser.h"
 #include "lsp/types_json.h"
 
 #include <QSignalSpy>
@@ -84,6 +85,32 @@ private slots:
         finished.wait();
         QVERIFY(finished.count());
     }
+
+    void parseLocationsResponse()
+    {
+        const QByteArray content = R"({"id":12,"jsonrpc":"2.0","result":[
+            {"range":{"end":{"character":9,"line":3},"start":{"character":4,"line":3}},"uri":"file:///main.cpp"},
+            {"uri":"file:///object.h","extra":{"ignored":[1,2]},"range":{"start":{"line":10,"character":0},
+             "end":{"line":10,"character":6}}}]})";
+
+        QCOMPARE(Lsp::peekMessageId(content), Lsp::MessageId(12));
+
+        Lsp::LocationsResponse response;
+        QVERIFY(Lsp::parseLocationsResponse(content, response));
+        const auto expected = nlohmann::json::parse(content).get<Lsp::LocationsResponse>();
+        QCOMPARE(nlohmann::json(response), nlohmann::json(expected));
+        QCOMPARE(std::get<std::vector<Lsp::Location>>(response.result.value()).size(), 2);
+
+        Lsp::LocationsResponse nullResponse;
+        QVERIFY(Lsp::parseLocationsResponse(R"({"jsonrpc":"2.0","result":null,"id":"13"})", nullResponse));
+        QVERIFY(std::holds_alternative<std::nullptr_t>(nullResponse.result.value()));
+        QVERIFY(std::holds_alternative<std::string>(nullResponse.id));
+
+        // Errors are left to the generic json parsing
+        Lsp::LocationsResponse errorResponse;
+        QVERIFY(!Lsp::parseLocationsResponse(R"({"jsonrpc":"2.0","id":14,"error":{"code":-32601,"message":"no"}})",
+                                             errorResponse));
+    }
 };
 
 QTEST_MAIN(TestClientBackend)
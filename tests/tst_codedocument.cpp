@@ -12,13 +12,24 @@
 #include "core/codedocument.h"
 #include "core/knutcore.h"
 #include "core/project.h"
+#include "core/qmldocument.h"
 #include "core/querymatch.h"
+#include "core/querymatchiterator.h"
+#include "core/settings.h"
+#include "treesitter/languages.h"
+#include "treesitter/parser.h"
+#include "treesitter/predicates.h"
+#include "treesitter/query.h"
+#include "treesitter/tree.h"
 
 #include <QAction>
+#include <QDir>
 #include <QPlainTextEdit>
 #include <QSignalSpy>
+#include <QTemporaryDir>
 #include <QTemporaryFile>
 #include <QTest>
+#include <QtConcurrent>
 #include <kdalgorithms.h>
 
 class TestCodeDocument : public QObject
@@ -103,6 +114,149 @@ private slots:
         verifySymbol(headerDocument, headerSymbols.at(10), "MyObject::m_enum", Core::Symbol::Kind::Field, "m_enum");
     }
 
+    void symbolCache()
+    {
+        QTemporaryDir cacheDir;
+        QVERIFY(cacheDir.isValid());
+
+        auto symbolNames = [&cacheDir]() {
+            Core::KnutCore core;
+            Core::Settings::instance()->setValue(Core::Settings::SymbolCache, cacheDir.path());
+            auto project = Core::Project::instance();
+            project->setRoot(Test::testDataPath() + "/projects/cpp-project");
+
+            auto document = qobject_cast<Core::CodeDocument *>(project->open("myobject.h"));
+            return kdalgorithms::transformed<QStringList>(document->symbols(), [](const Core::Symbol *symbol) {
+                return QString("%1 %2").arg(symbol->name()).arg(static_cast<int>(symbol->kind()));
+            });
+        };
+
+        // First run fills the cache, second run reads from it
+        const auto parsedSymbols = symbolNames();
+        QCOMPARE(parsedSymbols.size(), 11);
+        QCOMPARE(QDir(cacheDir.path()).entryList(QDir::Files).size(), 1);
+
+        const auto cachedSymbols = symbolNames();
+        QCOMPARE(cachedSymbols, parsedSymbols);
+    }
+
+    void incrementalSymbols()
+    {
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(Test::testDataPath() + "/projects/cpp-project");
+
+        auto document = qobject_cast<Core::CodeDocument *>(project->open("myobject.cpp"));
+        QVERIFY(document);
+        auto describe = [](Core::CodeDocument *document) {
+            return kdalgorithms::transformed<QStringList>(document->symbols(), [](const Core::Symbol *symbol) {
+                return QString("%1 %2 %3")
+                    .arg(symbol->name())
+                    .arg(static_cast<int>(symbol->kind()))
+                    .arg(symbol->range().toString());
+            });
+        };
+        const auto symbols = document->symbols();
+        QCOMPARE(symbols.size(), 4);
+
+        // Rename the last function, and add a new one after it, without querying the symbols in between
+        QVERIFY(document->find("sayMessage(const"));
+        document->insert("sayHello(const");
+        document->gotoEndOfDocument();
+        document->insert("\nvoid newFunction()\n{\n}\n");
+
+        const auto newSymbols = document->symbols();
+        QCOMPARE(newSymbols.size(), 5);
+        // Symbols before the changes are kept as is
+        QCOMPARE(newSymbols.at(0), symbols.at(0));
+        QCOMPARE(newSymbols.at(2), symbols.at(2));
+        QCOMPARE(newSymbols.at(3)->name(), "MyObject::sayHello");
+        QCOMPARE(newSymbols.at(4)->name(), "newFunction");
+
+        // Removing text before the symbols moves them
+        document->gotoStartOfDocument();
+        document->selectNextLine(3);
+        document->deleteSelection();
+        QCOMPARE(document->symbols().at(0), symbols.at(0));
+
+        // Same symbols as a full parse of the text
+        QTemporaryDir dir;
+        QFile file(dir.filePath("myobject.cpp"));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(document->text().toUtf8());
+        file.close();
+        auto fullDocument = qobject_cast<Core::CodeDocument *>(project->open(file.fileName()));
+        QVERIFY(fullDocument);
+        QCOMPARE(describe(document), describe(fullDocument));
+    }
+
+    void asyncSymbols()
+    {
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(Test::testDataPath() + "/projects/cpp-project");
+
+        auto document = qobject_cast<Core::CodeDocument *>(project->open("myobject.cpp"));
+        QVERIFY(document);
+        auto describe = [](const Core::SymbolList &symbols) {
+            return kdalgorithms::transformed<QStringList>(symbols, [](const Core::Symbol *symbol) {
+                return QString("%1 %2 %3")
+                    .arg(symbol->name())
+                    .arg(static_cast<int>(symbol->kind()))
+                    .arg(symbol->range().toString());
+            });
+        };
+        int updates = 0;
+        auto update = [&]() {
+            const int previous = updates;
+            document->updateSymbolsAsync([&updates]() {
+                ++updates;
+            });
+            QTRY_COMPARE(updates, previous + 1);
+        };
+
+        update();
+        const auto symbols = document->symbols();
+        QCOMPARE(symbols.size(), 4);
+
+        // Up to date: done right away, with the same symbols
+        document->updateSymbolsAsync([&updates]() {
+            ++updates;
+        });
+        QCOMPARE(updates, 2);
+        QCOMPARE(document->symbols(), symbols);
+
+        // Only the changed symbols are built again
+        QVERIFY(document->find("sayMessage(const"));
+        document->insert("sayHello(const");
+        update();
+        const auto newSymbols = document->symbols();
+        QCOMPARE(newSymbols.at(0), symbols.at(0));
+        QCOMPARE(newSymbols.at(3)->name(), "MyObject::sayHello");
+
+        // A change during the update is taken into account before the callback
+        document->gotoEndOfDocument();
+        document->insert("\nvoid newFunction()\n{\n}\n");
+        document->updateSymbolsAsync([&updates]() {
+            ++updates;
+        });
+        document->insert("\nvoid otherFunction()\n{\n}\n");
+        QTRY_COMPARE(updates, 4);
+        const auto lastSymbols = document->symbols();
+        QCOMPARE(lastSymbols.size(), 6);
+        QCOMPARE(lastSymbols.last()->name(), "otherFunction");
+
+        // Same symbols as a synchronous build of the whole text
+        QTemporaryDir dir;
+        QFile file(dir.filePath("myobject.cpp"));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(document->text().toUtf8());
+        file.close();
+        auto fullDocument = qobject_cast<Core::CodeDocument *>(project->open(file.fileName()));
+        QVERIFY(fullDocument);
+        QCOMPARE(describe(lastSymbols), describe(fullDocument->symbols()));
+    }
+
     void symbolUnderCursor_data()
     {
         QTest::addColumn<QString>("fileName");
@@ -193,6 +347,13 @@ private slots:
         symbol = headerDocument->findSymbol("m_message", Core::TextDocument::FindWholeWords);
         QVERIFY(symbol == nullptr);
 
+        symbol = headerDocument->findSymbol("myobject::m_message", Core::TextDocument::FindWholeWords);
+        verifySymbol(headerDocument, symbol, "MyObject::m_message", Core::Symbol::Kind::Field, "m_message");
+
+        symbol = headerDocument->findSymbol("myobject::m_message",
+                                            Core::TextDocument::FindWholeWords | Core::TextDocument::FindCaseSensitively);
+        QVERIFY(symbol == nullptr);
+
         symbol = headerDocument->findSymbol("m_message");
         verifySymbol(headerDocument, symbol, "MyObject::m_message", Core::Symbol::Kind::Field, "m_message");
 
@@ -355,6 +516,76 @@ private slots:
         QVERIFY(spy.wait());
     }
 
+    void hoverAll()
+    {
+        CHECK_CLANGD;
+
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(Test::testDataPath() + "/projects/cpp-project");
+
+        auto codedocument = qobject_cast<Core::CodeDocument *>(Core::Project::instance()->get("myobject.h"));
+
+        auto symbol = codedocument->findSymbol("MyObject");
+        QVERIFY(symbol);
+
+        const int position = symbol->selectionRange().start + 1;
+        const auto results = codedocument->hoverAll({position, position, position});
+        QCOMPARE(results.size(), 3);
+        const auto expected = codedocument->hover(position);
+        QVERIFY(!expected.isEmpty());
+        for (const auto &result : results)
+            QCOMPARE(result, expected);
+    }
+
+    void hoverCache()
+    {
+        CHECK_CLANGD;
+
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(Test::testDataPath() + "/projects/cpp-project");
+
+        auto codedocument = qobject_cast<Core::CodeDocument *>(Core::Project::instance()->get("myobject.h"));
+
+        auto symbol = codedocument->findSymbol("MyObject");
+        QVERIFY(symbol);
+        const int position = symbol->selectionRange().start + 1;
+
+        const auto hover = codedocument->hover(position);
+        QVERIFY(!hover.isEmpty());
+        QCOMPARE(codedocument->hover(position), hover);
+
+        // The cached result is dropped once the document changes
+        codedocument->gotoStartOfDocument();
+        codedocument->insert("\n");
+        QCOMPARE(codedocument->hover(position + 1), hover);
+        codedocument->undo();
+    }
+
+    void diagnostics()
+    {
+        CHECK_CLANGD;
+
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(Test::testDataPath() + "/projects/cpp-project");
+
+        auto codedocument = qobject_cast<Core::CodeDocument *>(Core::Project::instance()->get("main.cpp"));
+        QVERIFY(codedocument);
+
+        const auto before = codedocument->diagnostics();
+        QVERIFY(!before.join('\n').contains(": error: "));
+
+        codedocument->gotoEndOfDocument();
+        codedocument->insert("\nint broken() { return undeclaredVariable; }\n");
+        const auto after = codedocument->diagnostics();
+        QVERIFY(after.join('\n').contains(": error: "));
+
+        codedocument->undo();
+        QVERIFY(!codedocument->diagnostics().join('\n').contains(": error: "));
+    }
+
     void query()
     {
         Core::KnutCore core;
@@ -386,6 +617,49 @@ private slots:
         QCOMPARE(match.getAll("return-type").at(0).text(), "int");
         QCOMPARE(match.getAll("param").at(0).text(), "int argc");
         QCOMPARE(match.getAll("param").at(1).text(), "char *argv[]");
+
+        // Id-based access
+        const int paramId = match.captureId("param");
+        QVERIFY(paramId >= 0);
+        QCOMPARE(match.captureId("unknown"), -1);
+        QCOMPARE(match.getAllById(paramId).size(), 2);
+        QCOMPARE(match.getById(paramId).text(), "int argc");
+        QVERIFY(!match.getById(-1).isValid());
+    }
+
+    void treeSnapshot()
+    {
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(Test::testDataPath() + "/projects/cpp-project");
+
+        auto codedocument = qobject_cast<Core::CodeDocument *>(Core::Project::instance()->get("main.cpp"));
+        const auto snapshot = codedocument->treeSnapshot();
+        QVERIFY(snapshot);
+        QCOMPARE(snapshot->text, codedocument->text());
+        QCOMPARE(codedocument->treeSnapshot(), snapshot);
+
+        // Several queries can run in parallel on the same snapshot
+        const auto language = codedocument->treeSitterLanguage();
+        const auto functions = std::make_shared<treesitter::Query>(language, "(function_definition) @function");
+        const auto calls = std::make_shared<treesitter::Query>(language, "(call_expression) @call");
+        const auto countMatches = [&snapshot](const std::shared_ptr<treesitter::Query> &query) {
+            treesitter::QueryCursor cursor;
+            cursor.execute(query, snapshot->tree.rootNode(),
+                           std::make_unique<treesitter::Predicates>(snapshot->text));
+            return static_cast<qsizetype>(cursor.allRemainingMatches().size());
+        };
+        auto functionCount = QtConcurrent::run(countMatches, functions);
+        auto callCount = QtConcurrent::run(countMatches, calls);
+        QCOMPARE(functionCount.result(), codedocument->query(functions).size());
+        QCOMPARE(callCount.result(), codedocument->query(calls).size());
+        QVERIFY(functionCount.result() > 0);
+
+        // The snapshot isn't affected by changes in the document
+        codedocument->insertAtPosition("// comment\n", 0);
+        QVERIFY(codedocument->treeSnapshot() != snapshot);
+        QVERIFY(!snapshot->text.startsWith("// comment"));
+        QCOMPARE(countMatches(functions), functionCount.result());
     }
 
     void failedQuery()
@@ -413,6 +687,237 @@ private slots:
         QCOMPARE(counter.count(), 1);
     }
 
+    void queryLimits()
+    {
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(Test::testDataPath() + "/projects/cpp-project");
+
+        auto codedocument = qobject_cast<Core::CodeDocument *>(Core::Project::instance()->get("main.cpp"));
+
+        const auto query = QString("(identifier) @id");
+        const auto allMatches = codedocument->query(query);
+        QVERIFY(allMatches.size() > 2);
+
+        Test::LogCounter counter;
+        const auto firstMatches = codedocument->query(query, 2);
+        QCOMPARE(firstMatches.size(), 2);
+        QCOMPARE(firstMatches.at(0).get("id").text(), allMatches.at(0).get("id").text());
+        QCOMPARE(firstMatches.at(1).get("id").text(), allMatches.at(1).get("id").text());
+        // Reaching the maximum number of matches is expected, no need to warn about it
+        QCOMPARE(counter.count(), 0);
+
+        // The deadline is already expired
+        QVERIFY(codedocument->query(query, -1, 0).isEmpty());
+        QCOMPARE(counter.count(), 1);
+    }
+
+    void queryMemoization()
+    {
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(Test::testDataPath() + "/projects/cpp-project");
+
+        auto codedocument = qobject_cast<Core::CodeDocument *>(Core::Project::instance()->get("main.cpp"));
+
+        const auto query = QString("(function_definition declarator: (function_declarator declarator: (_) @name))");
+        const auto matches = codedocument->query(query);
+        QVERIFY(!matches.isEmpty());
+
+        // Same query on the unchanged document: same matches, sharing the same ranges
+        const auto memoized = codedocument->query(query);
+        QCOMPARE(memoized.size(), matches.size());
+        QCOMPARE(memoized.first().get("name"), matches.first().get("name"));
+        QCOMPARE(codedocument->queryFirst(query).get("name"), matches.first().get("name"));
+        QCOMPARE(codedocument->query(query, 1).size(), 1);
+
+        // Changing the document invalidates the results
+        codedocument->gotoEndOfDocument();
+        codedocument->insert("\nvoid memoizedFunction()\n{\n}\n");
+        const auto newMatches = codedocument->query(query);
+        QCOMPARE(newMatches.size(), matches.size() + 1);
+        QCOMPARE(newMatches.last().get("name").text(), "memoizedFunction");
+
+        codedocument->undo();
+        QCOMPARE(codedocument->query(query).size(), matches.size());
+    }
+
+    void queryRanges()
+    {
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(Test::testDataPath() + "/projects/cpp-project");
+
+        auto codedocument = qobject_cast<Core::CodeDocument *>(Core::Project::instance()->get("main.cpp"));
+
+        const auto query = QString("(identifier) @id");
+        const auto matches = codedocument->query(query);
+        const auto ranges = codedocument->queryRanges(query, "id");
+        QCOMPARE(ranges.size(), matches.size() * 2);
+
+        const auto texts = codedocument->textRegions(ranges);
+        QCOMPARE(texts.size(), matches.size());
+        for (int i = 0; i < matches.size(); ++i) {
+            QCOMPARE(matches.at(i).ranges("id"), ranges.mid(i * 2, 2));
+            QCOMPARE(texts.at(i), matches.at(i).get("id").text());
+        }
+
+        QCOMPARE(codedocument->queryRanges(query, "id", 2), ranges.first(4));
+        QVERIFY(codedocument->queryRanges(query, "unknown").isEmpty());
+    }
+
+    void incrementalParsing()
+    {
+        Test::FileTester file(Test::testDataPath() + "/tst_codedocument/incrementalParsing/main.cpp");
+
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(Test::testDataPath() + "/tst_codedocument/incrementalParsing");
+
+        auto codedocument = qobject_cast<Core::CodeDocument *>(Core::Project::instance()->get(file.fileName()));
+        QVERIFY(codedocument);
+        const auto functionQuery = QString("(function_definition declarator: (_ declarator: (_) @name))");
+
+        auto functionNames = [&]() {
+            return kdalgorithms::transformed<QStringList>(codedocument->query(functionQuery),
+                                                          [](const Core::QueryMatch &match) {
+                                                              return match.get("name").text();
+                                                          });
+        };
+        const auto initialNames = functionNames();
+        QVERIFY(!initialNames.isEmpty());
+
+        // Insert a new function at the start of the document, and rename an existing one, without reparsing
+        // in between.
+        codedocument->gotoStartOfDocument();
+        codedocument->insert("void incrementalFunction()\n{\n}\n\n");
+        QVERIFY(codedocument->find("main"));
+        codedocument->insert("renamedMain");
+
+        auto expectedNames = initialNames;
+        expectedNames.prepend("incrementalFunction");
+        expectedNames.replace(expectedNames.indexOf("main"), "renamedMain");
+        QCOMPARE(functionNames(), expectedNames);
+
+        // Removing parts of the document must work as well
+        codedocument->gotoStartOfDocument();
+        codedocument->selectNextLine(4);
+        codedocument->deleteSelection();
+        expectedNames.removeFirst();
+        QCOMPARE(functionNames(), expectedNames);
+
+        // The incrementally parsed tree must match a full parse of the text
+        const auto text = codedocument->text();
+        treesitter::Parser parser(tree_sitter_cpp());
+        auto tree = parser.parseString(text);
+        QVERIFY(tree.has_value());
+        treesitter::QueryCursor cursor;
+        cursor.execute(std::make_shared<treesitter::Query>(parser.language(), functionQuery), tree->rootNode(),
+                       nullptr);
+        const auto fullParseNames = kdalgorithms::transformed<QStringList>(
+            cursor.allRemainingMatches(), [&text](const treesitter::QueryMatch &match) {
+                return match.capturesNamed("name").first().node.textIn(text);
+            });
+        QCOMPARE(functionNames(), fullParseNames);
+    }
+
+    void queryAll()
+    {
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(Test::testDataPath() + "/projects/cpp-project");
+
+        const auto functionQuery = QString("(function_definition declarator: (_ declarator: (_) @name))");
+        const auto matches = project->queryAll({"cpp", "h"}, functionQuery);
+        QVERIFY(!matches.isEmpty());
+
+        // Results must be the same as querying each document once opened
+        const auto files = project->allFilesWithExtensions({"cpp", "h"}, Core::Project::FullPath);
+        for (const auto &fileName : files) {
+            auto codedocument = qobject_cast<Core::CodeDocument *>(project->get(fileName));
+            QVERIFY(codedocument);
+            const auto expected = codedocument->query(functionQuery);
+            const auto actual = kdalgorithms::filtered(matches, [&fileName](const Core::FileQueryMatch &match) {
+                return match.fileName() == fileName;
+            });
+            QCOMPARE(actual.size(), expected.size());
+            for (int i = 0; i < actual.size(); ++i) {
+                const auto capture = actual.at(i).get("name");
+                QCOMPARE(capture.text, expected.at(i).get("name").text());
+                QCOMPARE(capture.range.start, expected.at(i).get("name").start());
+                QCOMPARE(capture.range.end, expected.at(i).get("name").end());
+            }
+        }
+
+        // Invalid queries don't return anything
+        QVERIFY(project->queryAll({"cpp"}, "(function_definition").isEmpty());
+    }
+
+    void queryIterator()
+    {
+        Test::FileTester file(Test::testDataPath() + "/projects/cpp-project/main.cpp");
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(Test::testDataPath() + "/projects/cpp-project");
+
+        auto codedocument = qobject_cast<Core::CodeDocument *>(project->open(file.fileName()));
+        const auto query = "(function_definition declarator: (_ declarator: (_) @name))";
+        const auto matches = codedocument->query(query);
+        QVERIFY(matches.size() > 1);
+
+        std::unique_ptr<Core::QueryMatchIterator> iterator(codedocument->queryIterator(query));
+        for (const auto &match : matches) {
+            QVERIFY(iterator->hasNext());
+            QCOMPARE(iterator->next().get("name").text(), match.get("name").text());
+        }
+        QVERIFY(!iterator->hasNext());
+        QVERIFY(iterator->next().isEmpty());
+
+        // The iteration stops when the document changes
+        iterator.reset(codedocument->queryIterator(query));
+        QVERIFY(!iterator->next().isEmpty());
+        codedocument->insertAtPosition("// comment\n", 0);
+        QVERIFY(!iterator->hasNext());
+    }
+
+    void qmlQuery()
+    {
+        Core::KnutCore core;
+        Core::QmlDocument document;
+        document.setText("import QtQuick\n\nItem {\n    Rectangle {\n        color: \"red\"\n    }\n}\n");
+
+        // QML documents are parsed with the QML grammar
+        auto matches = document.query("(ui_object_definition type_name: (_) @type)");
+        QCOMPARE(matches.size(), 2);
+        QCOMPARE(matches.first().get("type").text(), "Item");
+        QCOMPARE(matches.last().get("type").text(), "Rectangle");
+
+        // C++ node types are not part of the QML grammar
+        QVERIFY(document.query("(function_definition) @function").isEmpty());
+    }
+
+    void qmlSymbols()
+    {
+        Core::KnutCore core;
+        Core::QmlDocument document;
+        document.setText("import QtQuick\n\nItem {\n    property int count: 0\n    signal clicked()\n"
+                         "    function reset() { count = 0; }\n    Rectangle {\n        color: \"red\"\n    }\n}\n");
+
+        const auto symbols = document.symbols();
+        QCOMPARE(symbols.size(), 5);
+        QCOMPARE(symbols.at(0)->name(), "Item");
+        QCOMPARE(symbols.at(0)->kind(), Core::Symbol::Object);
+        QCOMPARE(symbols.at(1)->name(), "Item::count");
+        QCOMPARE(symbols.at(1)->kind(), Core::Symbol::Property);
+        QCOMPARE(symbols.at(2)->name(), "Item::clicked");
+        QCOMPARE(symbols.at(2)->kind(), Core::Symbol::Event);
+        QCOMPARE(symbols.at(3)->name(), "Item::reset");
+        QCOMPARE(symbols.at(3)->kind(), Core::Symbol::Function);
+        QCOMPARE(symbols.at(4)->name(), "Item::Rectangle");
+
+        QCOMPARE(document.findSymbol("Item::reset")->kind(), Core::Symbol::Function);
+    }
+
     void queryInRange()
     {
         Core::KnutCore core;
@@ -433,6 +938,17 @@ private slots:
                       )EOF");
 
         QCOMPARE(matches.size(), 2);
+
+        // Only the matches fully inside the range are returned
+        codedocument->gotoLine(21);
+        codedocument->selectNextLine(1);
+        codedocument->selectEndOfLine();
+        range = codedocument->createRangeMark();
+
+        matches = codedocument->queryInRange(range, "(function_definition) @function");
+        QCOMPARE(matches.size(), 0);
+        matches = codedocument->queryInRange(range, "(parameter_declaration) @parameter");
+        QCOMPARE(matches.size(), 2);
     }
 
     void ast()
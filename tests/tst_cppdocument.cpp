@@ -287,6 +287,34 @@ private slots:
         });
     }
 
+    void queryMultipleNames()
+    {
+        Test::testCppDocument("projects/cpp-project", "myobject.cpp", [](auto *document) {
+            const auto methods = document->queryMethodDefinitions("MyObject", {"MyObject", "sayMessage", "unknown"});
+            QCOMPARE(methods.size(), 3);
+            QCOMPARE(methods[0].get("name").text(), "MyObject");
+            QCOMPARE(methods[1].get("name").text(), "sayMessage");
+            QCOMPARE(methods[2].get("name").text(), "sayMessage");
+
+            QVERIFY(document->queryMethodDefinitions("OtherObject", {"sayMessage"}).isEmpty());
+        });
+
+        Test::testCppDocument("projects/cpp-project", "main.cpp", [](auto *document) {
+            const auto functions = document->queryMethodDefinitions("", {"main", "freeFunction"});
+            QCOMPARE(functions.size(), 2);
+            QCOMPARE(functions[0].get("name").text(), "main");
+            QCOMPARE(functions[1].get("name").text(), "freeFunction");
+
+            const auto calls = document->queryFunctionCalls({"freeFunction", "object.sayMessage"});
+            QCOMPARE(calls.size(), 3);
+            QCOMPARE(calls[0].get("name").text(), "object.sayMessage");
+            QCOMPARE(calls[1].get("name").text(), "object.sayMessage");
+            QCOMPARE(calls[1].getAll("arguments").size(), 1);
+            QCOMPARE(calls[2].get("name").text(), "freeFunction");
+            QCOMPARE(calls[2].getAll("arguments").size(), 2);
+        });
+    }
+
     // Regression test:
     // Putting the cursor before the last character made `moveBlock` run into an infinite loop.
     void selectBlockUpAtEndOfFile()
@@ -14,6 +14,7 @@
 #include "core/project.h"
 
 #include <QTest>
+#include <algorithm>
 
 class TestCppDocumentClangd : public QObject
 {
@@ -117,6 +118,62 @@ private slots:
             QVERIFY(headerfile.compare());
         }
     }
+
+    void findSymbols()
+    {
+        CHECK_CLANGD_VERSION;
+
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(Test::testDataPath() + "/tst_cppdocument/insertCodeInMethod");
+
+        // Without a compilation database, only the opened files are indexed by clangd
+        auto header = qobject_cast<Core::CppDocument *>(project->open("myobject.h"));
+        QVERIFY(header);
+        header->diagnostics();
+
+        QVector<Core::IndexedSymbol> symbols;
+        QTRY_VERIFY((symbols = project->findSymbols("MyObject")).size() > 0);
+        const auto it = std::ranges::find(symbols, Core::IndexedSymbol::Class, &Core::IndexedSymbol::kind);
+        QVERIFY(it != symbols.cend());
+        QCOMPARE(it->name, "MyObject");
+        QCOMPARE(it->fileName, header->fileName());
+        QCOMPARE(header->text().mid(it->range.start, 14), "class MyObject");
+
+        symbols = project->findSymbols("sayMessage");
+        QVERIFY(symbols.size() > 0);
+        for (const auto &symbol : std::as_const(symbols)) {
+            QCOMPARE(symbol.kind, Core::IndexedSymbol::Function);
+            QCOMPARE(symbol.name, "sayMessage");
+            QCOMPARE(symbol.scope, "MyObject");
+        }
+    }
+
+    void prefetchLsp()
+    {
+        CHECK_CLANGD_VERSION;
+
+        Test::FileTester file(Test::testDataPath() + "/tst_cppdocument/insertCodeInMethod/myobject.cpp");
+        {
+            Core::KnutCore core;
+            auto project = Core::Project::instance();
+            project->setRoot(Test::testDataPath() + "/tst_cppdocument/insertCodeInMethod");
+            project->prefetch({"myobject.h", file.fileName()}, {{"lsp", true}});
+
+            // The source is opened on the server with the header, before its document is opened
+            auto header = qobject_cast<Core::CppDocument *>(project->open("myobject.h"));
+            QVERIFY(header);
+            header->diagnostics();
+            QVector<Core::IndexedSymbol> symbols;
+            QTRY_VERIFY((symbols = project->findSymbols("displayString")).size() > 0);
+            QCOMPARE(symbols.first().fileName, file.fileName());
+
+            // The document uses the file already opened on the server
+            auto source = qobject_cast<Core::CppDocument *>(project->open(file.fileName()));
+            QVERIFY(source);
+            QVERIFY(source->hover(source->text().indexOf("m_message <<")).contains("m_message"));
+        }
+    }
 };
 
 QTEST_MAIN(TestCppDocumentClangd)
@@ -10,11 +10,17 @@
 
 #include "common/test_cpputils.h"
 #include "common/test_utils.h"
+#include "core/classeditor.h"
 #include "core/cppdocument.h"
 #include "core/knutcore.h"
 #include "core/project.h"
+#include "core/settings.h"
+#include "core/textlocation.h"
 
+#include <QTemporaryDir>
+#include <QUrl>
 #include <kdalgorithms.h>
+#include <memory>
 
 class TestCppDocumentTreeSitter : public QObject
 {
@@ -54,6 +60,84 @@ private slots:
         });
     }
 
+    void mfcExtractAll()
+    {
+        QTemporaryDir cacheDir;
+        const auto cacheFile = cacheDir.filePath("mfc.json");
+
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(Test::testDataPath() + "/projects/mfc-tutorial");
+
+        auto checkInfos = [](const QVector<Core::MfcFileInfo> &infos) {
+            auto dialog = kdalgorithms::find_if(infos, [](const auto &info) {
+                return info.fileName.endsWith("/TutorialDlg.cpp");
+            });
+            QVERIFY(dialog);
+            QCOMPARE(dialog->messageMaps.size(), 1);
+            const auto &messageMap = dialog->messageMaps.first();
+            QCOMPARE(messageMap.className, "CTutorialDlg");
+            QCOMPARE(messageMap.superClass, "CDialog");
+            QCOMPARE(messageMap.entries.size(), 9);
+            QCOMPARE(messageMap.entries.first().name, "ON_WM_PAINT");
+            QCOMPARE(messageMap.entries.last().name, "ON_BN_CLICKED");
+            QCOMPARE(messageMap.entries.last().parameters,
+                     QStringList({"IDC_TIMER_CONTROL_SLIDERS", "OnBnClickedTimerControlSliders"}));
+
+            QCOMPARE(dialog->dataExchanges.size(), 1);
+            const auto &ddx = dialog->dataExchanges.first();
+            QCOMPARE(ddx.className, "CTutorialDlg");
+            QCOMPARE(ddx.entries.size(), 8);
+            QCOMPARE(ddx.entries.first().idc, "IDC_ECHO_AREA");
+            QCOMPARE(ddx.validators.size(), 1);
+            QCOMPARE(ddx.validators.first().arguments, QStringList({"3"}));
+
+            auto header = kdalgorithms::find_if(infos, [](const auto &info) {
+                return info.fileName.endsWith("/TutorialDlg.h");
+            });
+            QVERIFY(header);
+            QCOMPARE(header->classes.size(), 1);
+            QCOMPARE(header->classes.first().name, "CTutorialDlg");
+            QCOMPARE(header->classes.first().bases, QStringList({"CDialog"}));
+        };
+
+        const auto infos = project->mfcExtractAll(cacheFile);
+        checkInfos(infos);
+        QVERIFY(QFile::exists(cacheFile));
+
+        // Second run is using the cache
+        const auto cachedInfos = project->mfcExtractAll(cacheFile);
+        QCOMPARE(cachedInfos.size(), infos.size());
+        checkInfos(cachedInfos);
+    }
+
+    void symbolIndex()
+    {
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(Test::testDataPath() + "/projects/cpp-project");
+
+        const auto classes = project->findClass("MyObject");
+        QCOMPARE(classes.size(), 1);
+        QVERIFY(classes.first().fileName.endsWith("/myobject.h"));
+        QCOMPARE(classes.first().kind, Core::IndexedSymbol::Class);
+
+        const auto methods = project->findFunction("MyObject::sayMessage");
+        QCOMPARE(methods.size(), 2);
+        QCOMPARE(methods.first().scope, "MyObject");
+        QVERIFY(methods.first().fileName.endsWith("/myobject.cpp"));
+        QCOMPARE(project->findFunction("Other::sayMessage").size(), 0);
+
+        const auto callers = project->findCallers("sayMessage");
+        QCOMPARE(callers.size(), 2);
+        QVERIFY(callers.first().fileName.endsWith("/main.cpp"));
+        QCOMPARE(callers.first().function, "main");
+
+        const auto freeFunctionCallers = project->findCallers("freeFunction");
+        QCOMPARE(freeFunctionCallers.size(), 1);
+        QCOMPARE(freeFunctionCallers.first().function, "main");
+    }
+
 private:
     void tryInsertingBar(const QString &fileName)
     {
@@ -105,6 +189,31 @@ private slots:
         tryInsertingBar(Test::testDataPath() + "/tst_cppdocument/insertRemoveInclude/guards.h");
     }
 
+    void insertIncludes()
+    {
+        Core::KnutCore core;
+        Core::Project::instance()->setRoot(Test::testDataPath() + "/tst_cppdocument/insertRemoveInclude");
+
+        Test::FileTester sourceFile(Test::testDataPath() + "/tst_cppdocument/insertRemoveInclude/include.cpp");
+        auto cppFile = qobject_cast<Core::CppDocument *>(Core::Project::instance()->open(sourceFile.fileName()));
+
+        QVERIFY(cppFile->insertIncludes({R"("folder/foobar.h")", "<QPushButton>", "<QString>"}));
+        QVERIFY(cppFile->text().contains("#include \"folder/bar.h\"\n#include \"folder/foobar.h\"\n"));
+        QVERIFY(cppFile->text().contains("#include <QComboBox>\n#include <QPushButton>\n\n"));
+        QCOMPARE(cppFile->text().count("#include <QString>"), 1);
+
+        QVERIFY(cppFile->insertIncludes({"<memory>", "<vector>"}, true));
+        QVERIFY(cppFile->text().contains("#include <nlohmann/json.hpp>\n\n#include <memory>\n#include <vector>\n"));
+
+        // External edits invalidate the includes computed previously
+        cppFile->insertAtLine("#include \"baz.h\"\n", 1);
+        QVERIFY(cppFile->removeInclude(R"("include.h")"));
+        QVERIFY(cppFile->text().startsWith("#include \"baz.h\"\n\n#include \"foo.h\""));
+
+        QVERIFY(!cppFile->insertIncludes({"<array>", "malformed.h"}));
+        QVERIFY(cppFile->text().contains("#include <array>\n"));
+    }
+
     void addMember()
     {
         Core::KnutCore core;
@@ -121,6 +230,29 @@ private slots:
         }
     }
 
+    void editClass()
+    {
+        Core::KnutCore core;
+        Core::Project::instance()->setRoot(Test::testDataPath() + "/tst_cppdocument/addMember");
+
+        // Same result as addMember, in one edit
+        Test::FileTester sourceFile(Test::testDataPath() + "/tst_cppdocument/addMember/addmember.cpp");
+        {
+            auto cppFile = qobject_cast<Core::CppDocument *>(Core::Project::instance()->open(sourceFile.fileName()));
+            std::unique_ptr<Core::ClassEditor> editor(cppFile->editClass("Student"));
+            editor->addMember("QString foo", Core::CppDocument::AccessSpecifier::Public);
+            editor->addMember("int bar", Core::CppDocument::AccessSpecifier::Protected);
+            QVERIFY(editor->apply());
+
+            cppFile->save();
+            QVERIFY(sourceFile.compare());
+
+            std::unique_ptr<Core::ClassEditor> unknownEditor(cppFile->editClass("Teacher"));
+            unknownEditor->addMember("int age", Core::CppDocument::AccessSpecifier::Public);
+            QVERIFY(!unknownEditor->apply());
+        }
+    }
+
 private:
     void messageMapForNonExistingClass(Core::CppDocument *cppdocument)
     {
@@ -358,6 +490,131 @@ private slots:
             QVERIFY(headerFile.compare());
         }
     }
+
+    void changeBaseClasses()
+    {
+        // Same result as changeBaseClass, the files need to exist before setting the root to be indexed
+        Test::FileTester sourceFile(Test::testDataPath() + "/tst_cppdocument/changeBaseClass/myobject.cpp");
+        Test::FileTester headerFile(Test::testDataPath() + "/tst_cppdocument/changeBaseClass/myobject.h");
+        {
+            Core::KnutCore core;
+            auto project = Core::Project::instance();
+            project->setRoot(Test::testDataPath() + "/tst_cppdocument/changeBaseClass");
+
+            QCOMPARE(project->changeBaseClasses(QVariantMap {{"CPropertyPage", "KPropertyPage"}}), 1);
+            QCOMPARE(project->changeBaseClasses(QVariantMap {{"CDialog", "QDialog"}}), 0);
+            project->saveAllDocuments();
+
+            QVERIFY(sourceFile.compare());
+            QVERIFY(headerFile.compare());
+        }
+    }
+
+    void evictDocuments()
+    {
+        Core::KnutCore core;
+        Core::Settings::instance()->setValue(Core::Settings::MaxLoadedDocuments, 1);
+        auto project = Core::Project::instance();
+        project->setRoot(Test::testDataPath() + "/projects/cpp-project");
+
+        const auto query = QString("(function_definition) @function");
+        auto source = qobject_cast<Core::CodeDocument *>(project->get("myobject.cpp"));
+        const auto matchCount = source->query(query).size();
+        QVERIFY(matchCount > 0);
+        QVERIFY(source->memoryUsage().value("treesitter").toLongLong() > 0);
+
+        // The least recently used document is evicted, but stays usable
+        auto header = qobject_cast<Core::CodeDocument *>(project->get("myobject.h"));
+        QVERIFY(header);
+        QCOMPARE(source->memoryUsage().value("treesitter").toLongLong(), 0);
+        QCOMPARE(source->query(query).size(), matchCount);
+        QCOMPARE(project->get("myobject.cpp"), source);
+
+        // The current document is never evicted
+        QVERIFY(header->query(query).size() > 0);
+        QCOMPARE(project->open("myobject.h"), header);
+        project->get("main.cpp");
+        QVERIFY(header->memoryUsage().value("treesitter").toLongLong() > 0);
+    }
+
+    void prefetch()
+    {
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(Test::testDataPath() + "/projects/cpp-project");
+
+        // The syntax tree of a prefetched document is ready before any query
+        project->prefetch({"myobject.h"});
+        auto header = qobject_cast<Core::CodeDocument *>(project->get("myobject.h"));
+        QVERIFY(header);
+        QVERIFY(header->memoryUsage().value("treesitter").toLongLong() > 0);
+        QVERIFY(header->text().contains("class MyObject"));
+        QVERIFY(header->query("(class_specifier) @class").size() > 0);
+
+        // Opening a file from the last list returned prefetches the next ones
+        const auto files = project->allFilesWithExtension("cpp");
+        QCOMPARE(files, QStringList({"main.cpp", "myobject.cpp"}));
+        QVERIFY(project->get("main.cpp"));
+        auto source = qobject_cast<Core::CodeDocument *>(project->get("myobject.cpp"));
+        QVERIFY(source->memoryUsage().value("treesitter").toLongLong() > 0);
+    }
+
+    void largeFile()
+    {
+        Core::KnutCore core;
+        Core::Settings::instance()->setValue(Core::Settings::LargeFileLines, 10);
+        auto project = Core::Project::instance();
+        project->setRoot(Test::testDataPath() + "/projects/cpp-project");
+
+        // Large files are not parsed in advance, and don't use the LSP
+        project->prefetch({"myobject.cpp"});
+        auto source = qobject_cast<Core::CodeDocument *>(project->get("myobject.cpp"));
+        QVERIFY(source->isLargeFile());
+        QCOMPARE(source->memoryUsage().value("treesitter").toLongLong(), 0);
+        QVERIFY(!source->hasLspClient());
+        QCOMPARE(source->degradedFeatures(), QStringList({"highlighting", "lsp", "background_parsing"}));
+
+        // Everything else works as usual
+        QVERIFY(source->query("(function_definition) @function").size() > 0);
+        source->enableLsp();
+        QVERIFY(source->hasLspClient());
+        QCOMPARE(source->degradedFeatures(), QStringList({"highlighting", "background_parsing"}));
+
+        Core::Settings::instance()->setValue(Core::Settings::LargeFileLines, 0);
+        auto header = qobject_cast<Core::CodeDocument *>(project->get("myobject.h"));
+        QVERIFY(!header->isLargeFile());
+        QVERIFY(header->degradedFeatures().isEmpty());
+    }
+
+    void textLocationFromLsp()
+    {
+        QTemporaryDir dir;
+        const QString fileName = dir.filePath("lines.cpp");
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write("a\r\nbb\r\nccc");
+        file.close();
+
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(dir.path());
+
+        Lsp::Location location;
+        location.uri = QUrl::fromLocalFile(fileName).toEncoded().toStdString();
+        location.range.start = {.line = 2, .character = 1};
+        location.range.end = {.line = 2, .character = 10};
+        const auto locations = Core::TextLocation::fromLsp({location});
+        QCOMPARE(locations.size(), 1);
+        QCOMPARE(locations.first().fileName, fileName);
+        QCOMPARE(locations.first().range, Core::TextRange({6, 8}));
+        // The document is only opened when it's accessed
+        QVERIFY(project->documents().isEmpty());
+
+        auto document = locations.first().document();
+        QVERIFY(document);
+        QCOMPARE(document->toRange(location.range), locations.first().range);
+        QCOMPARE(Core::TextLocation::fromLsp({location}), locations);
+    }
 };
 
 QTEST_MAIN(TestCppDocumentTreeSitter)
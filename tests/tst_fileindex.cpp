@@ -0,0 +1,93 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "core/fileindex.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QProcess>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTest>
+
+static void createFiles(const QString &root, const QStringList &files)
+{
+    for (const auto &file : files) {
+        const QString path = root + '/' + file;
+        QDir().mkpath(QFileInfo(path).absolutePath());
+        QFile f(path);
+        QVERIFY(f.open(QIODevice::WriteOnly));
+        f.write(file.toUtf8());
+    }
+}
+
+static QStringList relativeFiles(Core::FileIndex &index)
+{
+    QStringList result;
+    for (const auto &file : index.files())
+        result.push_back(file.mid(index.root().size() + 1));
+    return result;
+}
+
+class TestFileIndex : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void excludes()
+    {
+        QTemporaryDir dir;
+        createFiles(dir.path(),
+                    {"main.cpp", "build/main.o", "src/build/generated.cpp", "src/object.obj", "src/object.cpp",
+                     "3rdparty/lib/lib.h", "src/3rdparty/lib.h", "doc/build"});
+
+        Core::FileIndex index;
+        index.setRoot(dir.path());
+        QCOMPARE(index.files().size(), 8);
+
+        index.setExcludes({"build/", "/3rdparty", "*.obj"});
+        QCOMPARE(relativeFiles(index),
+                 QStringList({"doc/build", "main.cpp", "src/3rdparty/lib.h", "src/object.cpp"}));
+
+        // Files added in an excluded directory are not indexed
+        createFiles(dir.path(), {"build/other.o", "src/new.obj", "src/new.cpp"});
+        QCOMPARE(relativeFiles(index),
+                 QStringList({"doc/build", "main.cpp", "src/3rdparty/lib.h", "src/new.cpp", "src/object.cpp"}));
+
+        index.setExcludes({});
+        QCOMPARE(index.files().size(), 11);
+    }
+
+    void gitIgnore()
+    {
+        if (QStandardPaths::findExecutable("git").isEmpty())
+            QSKIP("git is not available");
+
+        QTemporaryDir dir;
+        QCOMPARE(QProcess::execute("git", {"init", "-q", dir.path()}), 0);
+        createFiles(dir.path(), {"main.cpp", "build/main.o", "src/object.cpp", "src/object.obj"});
+        QFile gitIgnore(dir.filePath(".gitignore"));
+        QVERIFY(gitIgnore.open(QIODevice::WriteOnly));
+        gitIgnore.write("/build\n*.obj\n");
+        gitIgnore.close();
+
+        Core::FileIndex index;
+        index.setRoot(dir.path());
+        index.setUseGitIgnore(true);
+        QCOMPARE(relativeFiles(index), QStringList({"main.cpp", "src/object.cpp"}));
+
+        createFiles(dir.path(), {"src/new.obj", "src/new.cpp"});
+        QCOMPARE(relativeFiles(index), QStringList({"main.cpp", "src/new.cpp", "src/object.cpp"}));
+    }
+};
+
+QTEST_MAIN(TestFileIndex)
+#include "tst_fileindex.moc"
@@ -0,0 +1,84 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "common/test_utils.h"
+#include "core/jsondocument.h"
+
+#include <QTest>
+
+static const char JsonText[] = R"({
+    "name": "knut",
+    "version": 1,
+    "files": [
+        "main.cpp",
+        "main.h"
+    ],
+    "options": {}
+}
+)";
+
+class TestJsonDocument : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase() { Q_INIT_RESOURCE(core); }
+
+    void value()
+    {
+        Core::JsonDocument document;
+        document.setText(JsonText);
+
+        QCOMPARE(document.value("/name").toString(), "knut");
+        QCOMPARE(document.value("/version").toInt(), 1);
+        QCOMPARE(document.value("/files/1").toString(), "main.h");
+        QCOMPARE(document.value("/files").toList().size(), 2);
+        QVERIFY(document.hasValue("/options"));
+        QVERIFY(!document.hasValue("/missing"));
+        QVERIFY(!document.value("/missing").isValid());
+    }
+
+    void patch()
+    {
+        Core::JsonDocument document;
+        document.setText(JsonText);
+
+        QVERIFY(document.setValue("/version", 2));
+        QVERIFY(document.text().contains(R"("version": 2,)"));
+
+        QVERIFY(document.patch({
+            QVariantMap {{"op", "add"}, {"path", "/files/-"}, {"value", "utils.cpp"}},
+            QVariantMap {{"op", "remove"}, {"path", "/name"}},
+            QVariantMap {{"op", "add"}, {"path", "/options/debug"}, {"value", true}},
+        }));
+        const QString expected = R"({
+    "version": 2,
+    "files": [
+        "main.cpp",
+        "main.h",
+        "utils.cpp"
+    ],
+    "options": {"debug": true}
+}
+)";
+        QCOMPARE(document.text(), expected);
+        QCOMPARE(document.value("/files/2").toString(), "utils.cpp");
+
+        // A failing test leaves the document unchanged
+        QVERIFY(!document.patch({
+            QVariantMap {{"op", "replace"}, {"path", "/version"}, {"value", 3}},
+            QVariantMap {{"op", "test"}, {"path", "/version"}, {"value", 1}},
+        }));
+        QCOMPARE(document.text(), expected);
+    }
+};
+
+QTEST_MAIN(TestJsonDocument)
+#include "tst_jsondocument.moc"
@@ -156,6 +156,24 @@ private slots:
         QCOMPARE(j.get<EmptyStruct>(), empty);
     }
 
+    void unicodeStrings()
+    {
+        const QStringList strings {"", "ascii", "café", "100 €", QString::fromUtf8("smile \xf0\x9f\x98\x80")};
+        for (const auto &string : strings) {
+            QCOMPARE(Utils::toStdString(string), string.toStdString());
+            json j = string;
+            QCOMPARE(j.get<QString>(), string);
+        }
+
+        json j = strings;
+        QCOMPARE(j.size(), 5);
+        QCOMPARE(j.get<QStringList>(), strings);
+
+        // Invalid surrogates are replaced, the same way as toStdString
+        const QString invalid = QString("a") + QChar(0xd800) + "b";
+        QCOMPARE(Utils::toStdString(invalid), invalid.toStdString());
+    }
+
     void throwError()
     {
         json j = json::parse(R"({"string":1,"stringList":[]})");
@@ -9,12 +9,16 @@
 */
 
 #include "common/test_utils.h"
+#include "core/parallelscriptrunner.h"
+#include "core/testscriptrunner.h"
 
 #include <QDir>
+#include <QFile>
 #include <QFileInfo>
 #include <QProcess>
 #include <QQmlEngine>
 #include <QSignalSpy>
+#include <QTemporaryDir>
 #include <QTest>
 
 #define KNUT_TEST(name)                                                                                                \
@@ -71,12 +75,72 @@ private:
     }
 
 private slots:
+    void globToRegularExpression()
+    {
+        const auto regexp = Core::ParallelScriptRunner::globToRegularExpression("src/**/*.cpp");
+        QVERIFY(regexp.match("src/main.cpp").hasMatch());
+        QVERIFY(regexp.match("src/core/sub/file.cpp").hasMatch());
+        QVERIFY(!regexp.match("src/main.h").hasMatch());
+        QVERIFY(!regexp.match("tests/src/main.cpp").hasMatch());
+
+        const auto single = Core::ParallelScriptRunner::globToRegularExpression("*.rc");
+        QVERIFY(single.match("app.rc").hasMatch());
+        QVERIFY(!single.match("res/app.rc").hasMatch());
+        QVERIFY(Core::ParallelScriptRunner::globToRegularExpression("file?.h").match("file1.h").hasMatch());
+
+        const auto alternatives = Core::ParallelScriptRunner::globToRegularExpression("src/**/*.{h,cpp}");
+        QVERIFY(alternatives.match("src/core/file.h").hasMatch());
+        QVERIFY(alternatives.match("src/file.cpp").hasMatch());
+        QVERIFY(!alternatives.match("src/file.c").hasMatch());
+        QVERIFY(Core::ParallelScriptRunner::globToRegularExpression("{a,b").match("{a,b").hasMatch());
+    }
+
+    void testScriptOutput()
+    {
+        using Core::TestScriptRunner;
+        const QStringList output {
+            "[info] ********* Start testing of Dir *********",
+            "[info] PASS   : Dir::test_exists()",
+            "[error] FAIL!  : Dir::test_mkdir() Verification failed",
+            "[debug]    tst_dir.qml(12)",
+            "[error] FAIL!  : Dir::test_mkdir() Compared values are not the same",
+            "[info] Totals: 1 passed, 1 failed",
+        };
+        const auto result = TestScriptRunner::parseOutput("/tests/tst_dir.qml", output, 1, false);
+        QCOMPARE(result.name, "Dir");
+        QVERIFY(!result.passed());
+        QCOMPARE(result.functions.size(), 2);
+        QVERIFY(result.functions.at(0).passed);
+        QCOMPARE(result.functions.at(1).name, "test_mkdir");
+        QVERIFY(!result.functions.at(1).passed);
+        QCOMPARE(result.functions.at(1).message, "Verification failed");
+        QCOMPARE(result.functions.at(1).details, QStringList {"[debug]    tst_dir.qml(12)"});
+
+        // A script failing before running its functions is an error
+        const auto broken = TestScriptRunner::parseOutput("/tests/tst_broken.qml", {}, 255, false);
+        QCOMPARE(broken.name, "tst_broken");
+        QVERIFY(broken.functions.isEmpty());
+
+        QTemporaryDir dir;
+        const QString fileName = dir.filePath("results.xml");
+        QVERIFY(TestScriptRunner::saveJUnit(fileName, {result, broken}));
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        const QString xml = QString::fromUtf8(file.readAll());
+        QVERIFY(xml.contains(R"(<testsuites name="knut" tests="3" failures="1" errors="1")"));
+        QVERIFY(xml.contains(R"(<testcase name="test_exists" classname="Dir"/>)"));
+        QVERIFY(xml.contains(R"(<failure message="Verification failed">)"));
+        QVERIFY(xml.contains(R"(<error message="exit code 255"/>)"));
+    }
+
     KNUT_TEST(settings)
     KNUT_TEST(dir)
     KNUT_TEST(fileinfo)
+    KNUT_TEST(file)
     KNUT_TEST(utils)
     KNUT_TEST(rcdocument)
     KNUT_TEST(project)
+    KNUT_TEST(codedocument)
 
     KNUT_EXAMPLE(ex_gui_interactive)
     KNUT_EXAMPLE(ex_gui_progressbar)
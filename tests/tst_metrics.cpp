@@ -0,0 +1,129 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "utils/metrics.h"
+#include "utils/resultwriter.h"
+
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+#include <thread>
+#include <vector>
+
+using namespace Utils;
+
+class TestMetrics : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init() { Metrics::reset(); }
+
+    void test_counter()
+    {
+        auto &counter = Metrics::counter("test.counter");
+        QCOMPARE(counter.value(), 0);
+        counter.add();
+        counter.add(10);
+        counter.add(-2);
+        QCOMPARE(counter.value(), 9);
+        // Same name, same counter
+        QCOMPARE(&Metrics::counter("test.counter"), &counter);
+        QCOMPARE(Metrics::toJson()["counters"]["test.counter"], 9);
+    }
+
+    void test_histogram()
+    {
+        auto &histogram = Metrics::histogram("test.histogram");
+        QCOMPARE(histogram.count(), 0);
+        QCOMPARE(histogram.min(), 0);
+        QCOMPARE(histogram.percentile(50), 0);
+
+        // Small values are exact
+        histogram.record(3);
+        QCOMPARE(histogram.percentile(50), 3);
+        QCOMPARE(histogram.percentile(100), 3);
+
+        histogram.reset();
+        for (int i = 1; i <= 1000; ++i)
+            histogram.record(i);
+        QCOMPARE(histogram.count(), 1000);
+        QCOMPARE(histogram.sum(), 500500);
+        QCOMPARE(histogram.min(), 1);
+        QCOMPARE(histogram.max(), 1000);
+        // 500 is in the [480, 511] bucket
+        QCOMPARE(histogram.percentile(50), 511);
+        // Never more than the maximum recorded
+        QCOMPARE(histogram.percentile(99), 1000);
+
+        const auto json = Metrics::toJson()["histograms"]["test.histogram"];
+        QCOMPARE(json["count"], 1000);
+        QCOMPARE(json["p50"], 511);
+    }
+
+    void test_peakResidentMemory()
+    {
+        // A test process uses at least a megabyte, and the peak never decreases
+        const auto peak = Metrics::peakResidentMemory();
+        QVERIFY(peak > 1024 * 1024);
+        QVERIFY(Metrics::childrenPeakResidentMemory() >= 0);
+        const auto json = Metrics::toJson()["process"];
+        QVERIFY(json["peak_rss"].get<int64_t>() >= peak);
+        QVERIFY(json.contains("children_peak_rss"));
+    }
+
+    void test_resultWriter()
+    {
+        QTemporaryDir dir;
+        const QString fileName = dir.filePath("results.jsonl");
+        const QString mergedFileName = dir.filePath("merged.jsonl");
+
+        // Nothing is written without a file
+        ResultWriter::write({{"ignored", true}});
+        QVERIFY(!ResultWriter::isOpen());
+
+        QVERIFY(ResultWriter::open(fileName));
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; ++i) {
+            threads.emplace_back([i]() {
+                for (int j = 0; j < 1000; ++j)
+                    ResultWriter::write({{"thread", i}, {"index", j}, {"text", "some \"quoted\"\ntext"}});
+            });
+        }
+        for (auto &thread : threads)
+            thread.join();
+        ResultWriter::close();
+        QVERIFY(!ResultWriter::isOpen());
+
+        // Every line is a whole record
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        const auto lines = file.readAll().split('\n');
+        QCOMPARE(lines.size(), 4001);
+        QVERIFY(lines.last().isEmpty());
+        for (int i = 0; i < 4000; ++i) {
+            const auto record = nlohmann::json::parse(lines.at(i).toStdString());
+            QCOMPARE(record["text"], "some \"quoted\"\ntext");
+        }
+
+        // The results of other processes are appended as is
+        QVERIFY(ResultWriter::open(mergedFileName));
+        ResultWriter::write({{"first", 1}});
+        QVERIFY(ResultWriter::append(fileName));
+        ResultWriter::close();
+        QFile merged(mergedFileName);
+        QVERIFY(merged.open(QIODevice::ReadOnly));
+        QCOMPARE(merged.size(), file.size() + QByteArray("{\"first\":1}\n").size());
+    }
+};
+
+QTEST_APPLESS_MAIN(TestMetrics)
+
+#include "tst_metrics.moc"
@@ -153,6 +153,33 @@ private slots:
             }
         }
     }
+
+    void addMessagesInBulk()
+    {
+        Core::QtTsDocument document;
+        document.setLanguage("FR_fr");
+
+        document.addMessages({
+            QVariantMap {{"context", "first"}, {"fileName", "a.cpp"}, {"source", "Open"}, {"translation", "Ouvrir"}},
+            QVariantMap {{"context", "second"}, {"fileName", "b.cpp"}, {"source", "Open"}, {"translation", "Ouvre"}},
+            QVariantMap {{"context", "first"}, {"fileName", "a.cpp"}, {"source", "Close"}, {"translation", "Fermer"}},
+            QVariantMap {{"context", "first"},
+                         {"fileName", "a.cpp"},
+                         {"source", "Open"},
+                         {"translation", "Ouvrir"},
+                         {"comment", "menu"}},
+        });
+        const auto messages = document.messages();
+        QCOMPARE(messages.count(), 4);
+        QCOMPARE(messages.at(2)->context(), "first");
+        QCOMPARE(messages.at(2)->source(), "Close");
+
+        // The same message is only added once, its translation is updated
+        document.addMessage("first", "a.cpp", "Open", "Ouvrir le fichier");
+        QCOMPARE(document.messages().count(), 4);
+        QCOMPARE(messages.at(0)->translation(), "Ouvrir le fichier");
+        QCOMPARE(messages.at(3)->translation(), "Ouvrir");
+    }
 };
 
 QTEST_MAIN(TestQtTsDocument)
@@ -9,10 +9,16 @@
 */
 
 #include "common/test_utils.h"
+#include "core/knutcore.h"
+#include "core/project.h"
 #include "core/qtuidocument.h"
 #include "core/utils.h"
+#include "rccore/rcfile.h"
 
+#include <QSignalSpy>
+#include <QTemporaryDir>
 #include <QTest>
+#include <pugixml.hpp>
 
 class TestQtUiDocument : public QObject
 {
@@ -42,6 +48,65 @@ private slots:
         QCOMPARE(widget, nullptr);
     }
 
+    void loadUnicodePath()
+    {
+        QTemporaryDir dir;
+        const QString fileName = dir.filePath(QStringLiteral("dialogue_\u00e9t\u00e9_\u4e2d\u6587.ui"));
+        QVERIFY(QFile::copy(Test::testDataPath() + QStringLiteral("/tst_qtuidocument/IDD_ABCCOMPILE.ui"), fileName));
+
+        Core::QtUiDocument document;
+        document.load(fileName);
+        QCOMPARE(document.widgets().count(), 21);
+        QVERIFY(document.findWidget("IDC_RADIO_YUP"));
+    }
+
+    void findRenamedWidget()
+    {
+        Core::QtUiDocument document;
+        document.load(Test::testDataPath() + QStringLiteral("/tst_qtuidocument/IDD_ABCCOMPILE.ui"));
+
+        auto widget = document.findWidget("IDC_RADIO_YUP");
+        QVERIFY(widget);
+        QCOMPARE(document.findWidget("IDC_RADIO_YUP"), widget);
+
+        widget->setName("radioYup");
+        QCOMPARE(document.findWidget("IDC_RADIO_YUP"), nullptr);
+        QCOMPARE(document.findWidget("radioYup"), widget);
+        QVERIFY(document.widgets().contains(widget));
+    }
+
+    void changeSignals()
+    {
+        Core::QtUiDocument document;
+        document.load(Test::testDataPath() + QStringLiteral("/tst_qtuidocument/IDD_ABCCOMPILE.ui"));
+
+        QSignalSpy addedSpy(&document, &Core::QtUiDocument::widgetAdded);
+        QSignalSpy changedSpy(&document, &Core::QtUiDocument::widgetChanged);
+        QSignalSpy propertySpy(&document, &Core::QtUiDocument::widgetPropertyChanged);
+        QSignalSpy resetSpy(&document, &Core::QtUiDocument::widgetsChanged);
+
+        auto widget = document.findWidget("IDC_RADIO_YUP");
+        widget->setName("radioYup");
+        widget->setClassName("QCheckBox");
+        QCOMPARE(changedSpy.count(), 2);
+        QCOMPARE(changedSpy.at(0).at(0).value<Core::QtUiWidget *>(), widget);
+
+        // Nothing changes, nothing is emitted
+        widget->setName("radioYup");
+        QCOMPARE(changedSpy.count(), 2);
+
+        widget->addProperty("text", "Yup");
+        QCOMPARE(propertySpy.count(), 1);
+        QCOMPARE(propertySpy.at(0).at(0).value<Core::QtUiWidget *>(), widget);
+        QCOMPARE(propertySpy.at(0).at(1).toString(), "text");
+        QCOMPARE(resetSpy.count(), 0);
+
+        auto button = document.addWidget("QPushButton", "newButton", document.widgets().first());
+        QCOMPARE(addedSpy.count(), 1);
+        QCOMPARE(addedSpy.at(0).at(0).value<Core::QtUiWidget *>(), button);
+        QCOMPARE(document.widgets().last(), button);
+    }
+
     void save()
     {
         Test::FileTester file(Test::testDataPath() + "/tst_qtuidocument/IDD_LIGHTING.ui");
@@ -145,6 +210,58 @@ private slots:
             QVERIFY(widget->getProperty("idString").isNull());
         }
     }
+
+    void fromXmlDocument()
+    {
+        const auto rcFile = RcCore::parse(Test::testDataPath() + "/rcfiles/cryEdit/CryEdit.rc");
+        const auto data = rcFile.data.value("LANG_ENGLISH;SUBLANG_ENGLISH_US");
+        const auto it = std::ranges::find(data.dialogs, QString("IDD_ABCCOMPILE"), &RcCore::Data::Dialog::id);
+        QVERIFY(it != data.dialogs.end());
+
+        pugi::xml_document xmlDocument;
+        RcCore::writeDialogToUi(RcCore::convertDialog(data, *it, RcCore::Widget::AllFlags), xmlDocument);
+
+        // The document is only written on save
+        Core::QtUiDocument document;
+        document.setXmlDocument(std::move(xmlDocument));
+        QVERIFY(document.fileName().isEmpty());
+        QVERIFY(document.hasChanged());
+        QCOMPARE(document.widgets().count(), 21);
+        QCOMPARE(document.widgets().first()->name(), "IDD_ABCCOMPILE");
+        QCOMPARE(document.findWidget("IDC_RADIO_YUP")->className(), "QRadioButton");
+
+        const QString fileName = Test::testDataPath() + "/tst_qtuidocument/IDD_ABCCOMPILE_fromXml.ui";
+        QVERIFY(document.saveAs(fileName));
+        QVERIFY(!document.hasChanged());
+        QVERIFY(Test::compareFiles(fileName, Test::testDataPath() + "/tst_rcwriter/IDD_ABCCOMPILE.ui"));
+        QFile::remove(fileName);
+    }
+
+    void transformUiFiles()
+    {
+        // The file needs to exist before setting the root to be in the project
+        Test::FileTester file(Test::testDataPath() + "/tst_qtuidocument/transformUiFiles/dialog.ui");
+        {
+            Core::KnutCore core;
+            auto project = Core::Project::instance();
+            project->setRoot(Test::testDataPath() + "/tst_qtuidocument/transformUiFiles");
+
+            const QVariantMap transform {
+                {"classNames", QVariantMap {{"CButton", "MyPushButton"}}},
+                {"properties", QVariantMap {{"MyPushButton", QVariantMap {{"flat", true}}}}},
+                {"customWidgets",
+                 QVariantList {QVariantMap {
+                     {"className", "MyPushButton"}, {"baseClassName", "QPushButton"}, {"header", "<MyPushButton.h>"}}}},
+            };
+            QCOMPARE(project->transformUiFiles("*.ui", transform), 1);
+            QVERIFY(file.compare());
+
+            // Nothing left to change
+            QCOMPARE(project->transformUiFiles("*.ui", transform), 0);
+            QCOMPARE(project->transformUiFiles("other/*.ui", {{"classNames", QVariantMap {{"QDialog", "QWidget"}}}}),
+                     0);
+        }
+    }
 };
 
 QTEST_MAIN(TestQtUiDocument)
@@ -120,6 +120,8 @@ private slots:
         Stream stream(R"(#include "inc\\resource.h" //Comment)");
         Lexer lexer(stream);
         QCOMPARE(lexer.peek()->toString(), "include");
+        // Peeking again returns the same token, without reading it again
+        QCOMPARE(&lexer.peek(), &lexer.peek());
         QCOMPARE(lexer.next()->toString(), "include");
         QCOMPARE(lexer.next()->toString(), "inc\\\\resource.h");
         QCOMPARE(lexer.peek().has_value(), false);
@@ -144,6 +146,36 @@ private slots:
         QCOMPARE(lexer.next()->type, Token::Operator_Comma);
         QCOMPARE(lexer.next().has_value(), false);
     }
+
+    void testKeywords()
+    {
+        const auto keywords = Lexer::keywords();
+        for (const auto &keyword : keywords) {
+            Stream stream(keyword);
+            Lexer lexer(stream);
+            QCOMPARE(lexer.next()->type, Token::Keyword);
+        }
+
+        Stream stream("MFT_SEPARATOR SEPARATORS");
+        Lexer lexer(stream);
+        QCOMPARE(lexer.peek()->toKeyword(), Keywords::SEPARATOR);
+        QCOMPARE(lexer.next()->toString(), "SEPARATOR");
+        QCOMPARE(lexer.next()->type, Token::Word);
+    }
+
+    void testStringPool()
+    {
+        Utils::StringPool pool;
+        Stream stream("IDC_BUTTON WS_VISIBLE IDC_BUTTON");
+        Lexer lexer(stream);
+        lexer.setStringPool(&pool);
+        const QString first = lexer.next()->toString();
+        QCOMPARE(lexer.next()->toString(), "WS_VISIBLE");
+        const QString second = lexer.next()->toString();
+        QCOMPARE(second, "IDC_BUTTON");
+        QCOMPARE(second.constData(), first.constData());
+        QCOMPARE(pool.size(), 2);
+    }
 };
 
 QTEST_APPLESS_MAIN(TestRcLexer)
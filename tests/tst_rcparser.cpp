@@ -11,6 +11,7 @@
 #include "common/test_utils.h"
 #include "rccore/rcfile.h"
 
+#include <QTemporaryFile>
 #include <QTest>
 
 using namespace RcCore;
@@ -134,6 +135,117 @@ private slots:
     {
         RcFile rcFile = parse(Test::testDataPath() + "/rcfiles/2048Game/2048Game.rc");
         QCOMPARE(rcFile.isValid, true);
+
+        // Languages are parsed separately, check the data and lines are still right
+        const auto ukrainian = rcFile.data.value("LANG_UKRAINIAN;SUBLANG_DEFAULT");
+        QCOMPARE(ukrainian.dialogs.size(), 1);
+        QCOMPARE(ukrainian.dialogs.first().id, "IDD_DIALOG1");
+        QCOMPARE(ukrainian.dialogs.first().line, 73);
+        const auto english = rcFile.data.value(en_US);
+        QVERIFY(english.dialog("IDD_ABOUTBOX"));
+        QCOMPARE(english.dialog("IDD_ABOUTBOX")->line, 151);
+    }
+
+    void testIncrementalParse()
+    {
+        const QString path = Test::testDataPath() + "/rcfiles/2048Game";
+        QFile original(path + "/2048Game.rc");
+        QVERIFY(original.open(QIODevice::ReadOnly));
+        QByteArray content = original.readAll();
+
+        // Keep the file in the same directory, for the includes
+        QTemporaryFile file(path + "/XXXXXX.rc");
+        QVERIFY(file.open());
+        file.write(content);
+        file.flush();
+
+        const RcFile rcFile = parse(file.fileName());
+        QCOMPARE(rcFile.isValid, true);
+        QCOMPARE(rcFile.sections.size(), 4);
+
+        // Nothing changed, only the first section is parsed again
+        const RcFile sameFile = parse(file.fileName(), rcFile);
+        QCOMPARE(sameFile.isValid, true);
+        QVERIFY(sameFile.sections.at(0).result != rcFile.sections.at(0).result);
+        QCOMPARE(sameFile.sections.at(1).result, rcFile.sections.at(1).result);
+        QCOMPARE(sameFile.sections.at(2).result, rcFile.sections.at(2).result);
+
+        // Rename a dialog in the english section, the ukrainian section is reused
+        content.replace("IDD_ABOUTBOX DIALOGEX", "IDD_RENAMED DIALOGEX");
+        file.resize(0);
+        file.write(content);
+        file.flush();
+
+        const RcFile newFile = parse(file.fileName(), sameFile);
+        QCOMPARE(newFile.isValid, true);
+        QCOMPARE(newFile.sections.at(1).result, rcFile.sections.at(1).result);
+        QVERIFY(newFile.sections.at(2).result != rcFile.sections.at(2).result);
+        const auto english = newFile.data.value(en_US);
+        QVERIFY(english.dialog("IDD_RENAMED"));
+        QVERIFY(!english.dialog("IDD_ABOUTBOX"));
+        QCOMPARE(english.dialog("IDD_RENAMED")->line, 151);
+    }
+
+    void testLazyParse_data()
+    {
+        QTest::addColumn<QString>("fileName");
+        QTest::newRow("2048Game") << "/rcfiles/2048Game/2048Game.rc";
+        QTest::newRow("dialog") << "/rcfiles/dialog/dialog.rc";
+        QTest::newRow("cryEdit") << "/rcfiles/cryEdit/CryEdit.rc";
+        QTest::newRow("luaDebugger") << "/rcfiles/luaDebugger/LuaDebugger.rc";
+    }
+
+    void testLazyParse()
+    {
+        QFETCH(QString, fileName);
+        const RcFile rcFile = parse(Test::testDataPath() + fileName);
+        const RcFile index = parseIndex(Test::testDataPath() + fileName);
+        QCOMPARE(index.isValid, true);
+        QCOMPARE(index.includes.size(), rcFile.includes.size());
+        QCOMPARE(index.resourceMap, rcFile.resourceMap);
+
+        // The languages are known, but nothing is parsed yet
+        auto languages = index.data.keys();
+        std::ranges::sort(languages);
+        auto expectedLanguages = rcFile.data.keys();
+        std::ranges::sort(expectedLanguages);
+        QCOMPARE(languages, expectedLanguages);
+        QVERIFY(std::ranges::all_of(index.data, [](const Data &data) {
+            return data.dialogs.isEmpty() && data.strings.isEmpty();
+        }));
+
+        // Parsing all the resources gives the same data as the full parse, with the same lines
+        const auto data = parseResources(index, [](const RcFile::Resource &) {
+            return true;
+        });
+        for (const auto &expected : rcFile.data) {
+            const auto &actual = data.value(expected.language);
+            QCOMPARE(actual.strings, expected.strings);
+            QCOMPARE(actual.assets.size(), expected.assets.size());
+            QCOMPARE(actual.icons.size(), expected.icons.size());
+            QCOMPARE(actual.acceleratorTables.size(), expected.acceleratorTables.size());
+            QCOMPARE(actual.dialogDataList.size(), expected.dialogDataList.size());
+            QCOMPARE(actual.toolBars.size(), expected.toolBars.size());
+            QCOMPARE(actual.ribbons.size(), expected.ribbons.size());
+            QCOMPARE(actual.menus.size(), expected.menus.size());
+            for (int i = 0; i < expected.menus.size(); ++i)
+                QCOMPARE(actual.menus.at(i).children, expected.menus.at(i).children);
+            QCOMPARE(actual.dialogs.size(), expected.dialogs.size());
+            for (int i = 0; i < expected.dialogs.size(); ++i) {
+                QCOMPARE(actual.dialogs.at(i).id, expected.dialogs.at(i).id);
+                QCOMPARE(actual.dialogs.at(i).line, expected.dialogs.at(i).line);
+                QCOMPARE(actual.dialogs.at(i).controls.size(), expected.dialogs.at(i).controls.size());
+            }
+        }
+
+        // Only the resources accepted are parsed
+        const auto dialogs = parseResources(index, [](const RcFile::Resource &resource) {
+            return resource.type == "DIALOGEX" || resource.type == "DIALOG";
+        });
+        for (const auto &expected : rcFile.data) {
+            QCOMPARE(dialogs.value(expected.language).dialogs.size(), expected.dialogs.size());
+            QVERIFY(dialogs.value(expected.language).strings.isEmpty());
+        }
     }
 
     void testCryEdit()
@@ -9,11 +9,13 @@
 */
 
 #include "common/test_utils.h"
+#include "rccore/lexer.h"
 #include "rccore/rcfile.h"
 
 #include <QBuffer>
 #include <QFile>
 #include <QSet>
+#include <QTemporaryDir>
 #include <QTest>
 #include <QUiLoader>
 
@@ -84,6 +86,80 @@ private slots:
         QCOMPARE(item.properties.value("text").toStringList(), values);
     }
 
+    void testDuplicatedAssets()
+    {
+        QTemporaryDir dir;
+        const QString source = Test::testDataPath() + "/rcfiles/2048Game/res/Toolbar.bmp";
+        QVERIFY(QFile::copy(source, dir.filePath("first.bmp")));
+        QVERIFY(QFile::copy(source, dir.filePath("second.bmp")));
+        QVERIFY(QFile::copy(Test::testDataPath() + "/rcfiles/2048Game/res/fileview.bmp", dir.filePath("other.bmp")));
+
+        QVector<Asset> assets;
+        for (const auto &name : {"first", "second", "other"}) {
+            Asset asset;
+            asset.id = name;
+            asset.fileName = dir.filePath(QString(name) + ".png");
+            asset.exist = true;
+            asset.originalFileName = dir.filePath(QString(name) + ".bmp");
+            assets.push_back(asset);
+        }
+        writeAssetsToImage(assets);
+        for (const auto &asset : std::as_const(assets))
+            QVERIFY(QFile::exists(asset.fileName));
+        auto readFile = [](const QString &fileName) {
+            QFile file(fileName);
+            return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+        };
+        QCOMPARE(readFile(dir.filePath("first.png")), readFile(dir.filePath("second.png")));
+
+        // The duplicates share the same file in the qrc file
+        QBuffer buffer;
+        QVERIFY(buffer.open(QIODevice::WriteOnly));
+        writeAssetsToQrc(assets, &buffer, dir.filePath("assets.qrc"), true);
+        const QString qrc = QString::fromUtf8(buffer.data());
+        QVERIFY(qrc.contains("<file alias=\"first\">first.png</file>"));
+        QVERIFY(qrc.contains("<file alias=\"second\">first.png</file>"));
+        QVERIFY(qrc.contains("<file alias=\"other\">other.png</file>"));
+    }
+
+    void testConvertDialogHierarchy()
+    {
+        Data data;
+        Data::Dialog dialog;
+        dialog.id = "IDD_HIERARCHY";
+        dialog.geometry = QRect(0, 0, 1000, 1000);
+        auto addControl = [&dialog](Keywords type, const QString &id, const QRect &geometry) {
+            dialog.controls.push_back({.type = static_cast<int>(type), .id = id, .geometry = geometry});
+        };
+
+        addControl(Keywords::GROUPBOX, "IDC_OUTER", {10, 10, 500, 500});
+        addControl(Keywords::GROUPBOX, "IDC_INNER", {20, 20, 200, 200});
+        for (int i = 0; i < 5; ++i) {
+            addControl(Keywords::LTEXT, QString("IDC_INNER_%1").arg(i), {30 + 30 * i, 50, 20, 10});
+            addControl(Keywords::LTEXT, QString("IDC_OUTER_%1").arg(i), {300, 40 + 30 * i, 20, 10});
+        }
+        // Lots of controls outside of the group boxes
+        for (int i = 0; i < 1000; ++i) {
+            const QRect geometry(600 + (i % 20) * 18, 20 + (i / 20) * 18, 10, 10);
+            addControl(Keywords::LTEXT, QString("IDC_LABEL_%1").arg(i), geometry);
+        }
+
+        const auto result = convertDialog(data, dialog, Widget::UpdateHierarchy);
+        QCOMPARE(result.children.size(), 1001);
+        const auto outer = std::ranges::find(result.children, QString("IDC_OUTER"), &Widget::id);
+        QVERIFY(outer != result.children.cend());
+        QCOMPARE(outer->children.size(), 6);
+        // Children are sorted by area, the smallest first
+        QCOMPARE(outer->children.first().id, "IDC_OUTER_0");
+        QCOMPARE(outer->children.first().geometry, QRect(290, 30, 20, 10));
+        const auto &inner = outer->children.last();
+        QCOMPARE(inner.id, "IDC_INNER");
+        QCOMPARE(inner.geometry, QRect(10, 10, 200, 200));
+        QCOMPARE(inner.children.size(), 5);
+        QCOMPARE(inner.children.first().id, "IDC_INNER_0");
+        QCOMPARE(inner.children.first().geometry, QRect(10, 30, 20, 10));
+    }
+
     void testWriteDialog()
     {
         RcFile rcFile = parse(Test::testDataPath() + "/rcfiles/cryEdit/CryEdit.rc");
@@ -124,6 +200,65 @@ private slots:
         }
     }
 
+    void testWriteSlint()
+    {
+        RcFile rcFile = parse(Test::testDataPath() + "/rcfiles/2048Game/2048Game.rc");
+        auto usData = rcFile.data.value("LANG_ENGLISH;SUBLANG_ENGLISH_US");
+        auto dialog = convertDialog(usData, usData.dialogs.first(), RcCore::Widget::AllFlags);
+
+        const auto slint = convertDialogToSlint(dialog);
+        QVERIFY(slint.startsWith(R"(import { Button } from "std-widgets.slint";)"));
+        QVERIFY(slint.contains("export component IDD_ABOUTBOX inherits Window {"));
+        QVERIFY(slint.contains(R"(title: "About 2048Game";)"));
+        QVERIFY(slint.contains("IDOK := Button {"));
+        QVERIFY(slint.contains(R"(text: "OK";)"));
+        QVERIFY(slint.contains("primary: true;"));
+        QVERIFY(slint.contains(R"(text: "Copyright (C) 2016";)"));
+        // IDC_STATIC is used several times, it can't be an element id
+        QVERIFY(!slint.contains("IDC_STATIC"));
+
+        QBuffer buffer;
+        buffer.open(QIODevice::WriteOnly);
+        writeDialogToSlint(dialog, &buffer);
+        QCOMPARE(QString::fromUtf8(buffer.data()), slint);
+    }
+
+    void testWriteTs()
+    {
+        RcFile rcFile = parse(Test::testDataPath() + "/rcfiles/2048Game/2048Game.rc");
+        const auto usData = rcFile.data.value("LANG_ENGLISH;SUBLANG_ENGLISH_US");
+        const auto ukData = rcFile.data.value("LANG_UKRAINIAN;SUBLANG_DEFAULT");
+
+        // Source language: the translations are the source texts
+        {
+            QBuffer buffer;
+            buffer.open(QIODevice::WriteOnly);
+            writeDataToTs(usData, usData, &buffer, "2048Game.rc");
+            const auto ts = QString::fromUtf8(buffer.data());
+            QVERIFY(ts.contains(R"(<TS version="2.1" language="en_US" sourcelanguage="en_US">)"));
+            QVERIFY(ts.contains("<name>strings</name>"));
+            QVERIFY(ts.contains("<source>You lose</source>"));
+            QVERIFY(ts.contains("<comment>IDS_LOSE</comment>"));
+            QVERIFY(ts.contains("<translation>You lose</translation>"));
+            QVERIFY(ts.contains("<name>IDR_MAINFRAME</name>"));
+            QVERIFY(ts.contains("<name>IDD_ABOUTBOX</name>"));
+            QVERIFY(ts.contains("<translation>About 2048Game</translation>"));
+            QVERIFY(ts.contains(R"(<location filename="2048Game.rc" line=")"));
+        }
+
+        // Missing translations are written as unfinished
+        {
+            QBuffer buffer;
+            buffer.open(QIODevice::WriteOnly);
+            writeDataToTs(usData, ukData, &buffer, "2048Game.rc");
+            const auto ts = QString::fromUtf8(buffer.data());
+            QVERIFY(ts.contains(R"(sourcelanguage="en_US")"));
+            QVERIFY(ts.contains("<source>You lose</source>"));
+            QVERIFY(!ts.contains("<translation>You lose</translation>"));
+            QVERIFY(ts.contains(R"(<translation type="unfinished" />)"));
+        }
+    }
+
     void testConvertAction()
     {
         RcFile rcFile = parse(Test::testDataPath() + "/rcfiles/2048Game/2048Game.rc");
@@ -158,6 +293,45 @@ private slots:
         QCOMPARE(action.shortcuts.size(), 1);
         QCOMPARE(action.shortcuts.first().event, "Shift+F6");
     }
+
+    void testOutputManifest()
+    {
+        RcFile rcFile = parse(Test::testDataPath() + "/rcfiles/cryEdit/CryEdit.rc");
+        const auto data = rcFile.data.value("LANG_ENGLISH;SUBLANG_ENGLISH_US");
+        const auto dialog = data.dialog("IDD_ABOUTBOX");
+        QVERIFY(dialog);
+        const auto fingerprint = dialogFingerprint(data, *dialog, Widget::AllFlags, 1.5, 1.65, ".ui");
+        QCOMPARE(dialogFingerprint(data, *dialog, Widget::AllFlags, 1.5, 1.65, ".ui"), fingerprint);
+        QVERIFY(dialogFingerprint(data, *dialog, Widget::UpdateGeometry, 1.5, 1.65, ".ui") != fingerprint);
+        QVERIFY(dialogFingerprint(data, *dialog, Widget::AllFlags, 2, 1.65, ".ui") != fingerprint);
+        Data::Dialog changedDialog = *dialog;
+        changedDialog.controls.first().text = "Changed";
+        QVERIFY(dialogFingerprint(data, changedDialog, Widget::AllFlags, 1.5, 1.65, ".ui") != fingerprint);
+
+        QTemporaryDir dir;
+        const QString manifestFile = dir.filePath(".knut-manifest.json");
+        const QString output = dir.filePath("IDD_ABOUTBOX.ui");
+        {
+            OutputManifest manifest(manifestFile, "1.0");
+            QVERIFY(!manifest.isUpToDate(output, fingerprint));
+            QFile file(output);
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            writeDialogToUi(convertDialog(data, *dialog, Widget::AllFlags), &file);
+            file.close();
+            manifest.update(output, fingerprint);
+            QVERIFY(manifest.isUpToDate(output, fingerprint));
+            QVERIFY(manifest.save());
+        }
+
+        // Reloaded from disk
+        QVERIFY(OutputManifest(manifestFile, "1.0").isUpToDate(output, fingerprint));
+        QVERIFY(!OutputManifest(manifestFile, "1.0").isUpToDate(output, "other"));
+        QVERIFY(!OutputManifest(manifestFile, "2.0").isUpToDate(output, fingerprint));
+
+        // Removed output
+        QFile::remove(output);
+        QVERIFY(!OutputManifest(manifestFile, "1.0").isUpToDate(output, fingerprint));
+    }
 };
 
 QTEST_MAIN(TestRcwriter)
@@ -12,7 +12,9 @@
 #include "core/project_p.h"
 #include "core/settings.h"
 
+#include <QFile>
 #include <QSignalSpy>
+#include <QTemporaryDir>
 #include <QTest>
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -90,9 +92,12 @@ private slots:
 
         settings.loadProjectSettings(Test::testDataPath() + "/tst_settings/setValue");
         QCOMPARE(settings.value("/rc/dialog_scalex").toDouble(), 1.5);
+        QCOMPARE(settings.value<double>("/rc/dialog_scalex"), 1.5);
 
+        // Cached values are updated
         settings.setValue("/rc/dialog_scalex", 2.0);
         QCOMPARE(settings.value("/rc/dialog_scalex").toDouble(), 2.0);
+        QCOMPARE(settings.value<double>("/rc/dialog_scalex"), 2.0);
 
         QStringList test = {"This", "is", "a", "test."};
         settings.setValue("/thisisatest", test);
@@ -114,6 +119,68 @@ private slots:
 
         QVERIFY(file.compare());
     }
+
+    void reloadChangedFile()
+    {
+        QTemporaryDir dir;
+        const auto writeSettings = [&dir](const QByteArray &data) {
+            QFile file(dir.filePath("knut.json"));
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            file.write(data);
+        };
+        writeSettings(R"({"answer": 42})");
+
+        SettingsFixture settings;
+        settings.loadProjectSettings(dir.path());
+        QCOMPARE(settings.value<int>("/answer"), 42);
+        const auto ptr = settings.valuePtr<int>("/answer");
+        QCOMPARE(settings.valuePtr<int>("/answer"), ptr);
+        const int revision = settings.revision();
+
+        QSignalSpy settingsLoaded(&settings, &Core::Settings::settingsLoaded);
+        writeSettings(R"({"answer": 43})");
+        QVERIFY(settingsLoaded.wait());
+        QCOMPARE(settings.value<int>("/answer"), 43);
+        QVERIFY(settings.revision() > revision);
+        // Default values are still there
+        QCOMPARE(settings.value<double>("/rc/dialog_scalex"), 1.5);
+
+        // Invalid content is ignored
+        writeSettings(R"({"answer": )");
+        QVERIFY(!settingsLoaded.wait(500));
+        QCOMPARE(settings.value<int>("/answer"), 43);
+    }
+
+    void lspServerSharding()
+    {
+        SettingsFixture settings;
+        QTemporaryDir dir;
+        QFile file(dir.filePath("knut.json"));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(R"({"lsp": {"servers": [
+            {"type": "cpp_type", "program": "clangd"},
+            {"type": "cpp_type", "program": "clangd", "path": "libs"},
+            {"type": "cpp_type", "program": "clangd", "path": "libs/core/"},
+            {"type": "qml_type", "program": "qmlls", "path": "libs"}
+        ]}})");
+        file.close();
+        settings.loadProjectSettings(dir.path());
+        const auto servers = settings.value<std::vector<Core::LspServer>>("/lsp/servers");
+        QCOMPARE(servers.size(), 4);
+        const QString root = dir.path();
+        auto serverPath = [&](Core::Document::Type type, const QString &fileName) {
+            const auto server = Core::findLspServer(servers, type, root + '/' + fileName, root);
+            return server ? Core::lspServerPath(*server, root).mid(root.size()) : QString("none");
+        };
+
+        // The longest path containing the file is used, or else the server for the whole project
+        QCOMPARE(serverPath(Core::Document::Type::Cpp, "main.cpp"), "");
+        QCOMPARE(serverPath(Core::Document::Type::Cpp, "libs/gui/window.cpp"), "/libs");
+        QCOMPARE(serverPath(Core::Document::Type::Cpp, "libs/core/object.cpp"), "/libs/core");
+        QCOMPARE(serverPath(Core::Document::Type::Cpp, "libs/corelib/object.cpp"), "/libs");
+        QCOMPARE(serverPath(Core::Document::Type::Qml, "libs/main.qml"), "/libs");
+        QCOMPARE(serverPath(Core::Document::Type::Qml, "main.qml"), "none");
+    }
 };
 
 QTEST_MAIN(TestSettings)
@@ -0,0 +1,109 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "common/test_utils.h"
+#include "core/knutcore.h"
+#include "core/project.h"
+#include "core/shardedscriptrunner.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QTest>
+#include <nlohmann/json.hpp>
+
+class TestShardedScriptRunner : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase() { Q_INIT_RESOURCE(core); }
+
+    void retryOnAnotherNode()
+    {
+        Core::KnutCore core;
+        QTemporaryDir dir;
+        Core::Project::instance()->setRoot(dir.path());
+        QFile script(dir.filePath("script.js"));
+        QVERIFY(script.open(QIODevice::WriteOnly));
+        script.write("function main() {}");
+        script.close();
+
+        // The first node fails as soon as it gets a job, the second one runs all of them
+        const auto prefix = QString("knut-test-%1-").arg(QCoreApplication::applicationPid());
+        QLocalServer failing;
+        QLocalServer working;
+        QVERIFY(failing.listen(prefix + "failing"));
+        QVERIFY(working.listen(prefix + "working"));
+        connect(&failing, &QLocalServer::newConnection, this, [&failing]() {
+            auto socket = failing.nextPendingConnection();
+            connect(socket, &QLocalSocket::readyRead, socket, &QLocalSocket::disconnectFromServer);
+        });
+        QStringList inputs;
+        connect(&working, &QLocalServer::newConnection, this, [&working, &inputs]() {
+            auto socket = working.nextPendingConnection();
+            connect(socket, &QLocalSocket::readyRead, socket, [socket, &inputs]() {
+                while (socket->canReadLine()) {
+                    const auto job = nlohmann::json::parse(socket->readLine().toStdString());
+                    QCOMPARE(job["source"].get<std::string>(), "function main() {}");
+                    const auto input = job["input"].get<std::string>();
+                    inputs.push_back(QString::fromStdString(input));
+                    const nlohmann::json response {{"id", job["id"]},
+                                                   {"exitCode", input == "c.cpp" ? 2 : 0},
+                                                   {"files", {{input, QByteArray("saved").toBase64().toStdString()}}}};
+                    socket->write(response.dump().c_str());
+                    socket->write("\n");
+                }
+            });
+        });
+
+        Core::ShardedScriptRunner runner;
+        runner.setNodes({failing.fullServerName(), working.fullServerName()});
+        runner.setShardSize(1);
+        QSignalSpy finished(&runner, &Core::ShardedScriptRunner::finished);
+        runner.run(script.fileName(), {"a.cpp", "b.cpp", "c.cpp"});
+        QVERIFY(finished.wait());
+        QCOMPARE(finished.at(0).at(0).toInt(), 2);
+
+        // All files are run once on the working node, and the failure of the script isn't retried
+        inputs.sort();
+        QCOMPARE(inputs, QStringList({"a.cpp", "b.cpp", "c.cpp"}));
+        QCOMPARE(runner.failedFiles(), QStringList {"c.cpp"});
+        QCOMPARE(runner.savedFiles().size(), 3);
+        QFile saved(dir.filePath("a.cpp"));
+        QVERIFY(saved.open(QIODevice::ReadOnly));
+        QCOMPARE(saved.readAll(), QByteArray("saved"));
+    }
+
+    void noNodeLeft()
+    {
+        Core::KnutCore core;
+        QTemporaryDir dir;
+        Core::Project::instance()->setRoot(dir.path());
+        QFile script(dir.filePath("script.js"));
+        QVERIFY(script.open(QIODevice::WriteOnly));
+        script.write("function main() {}");
+        script.close();
+
+        Core::ShardedScriptRunner runner;
+        runner.setNodes({QString("knut-test-%1-missing").arg(QCoreApplication::applicationPid())});
+        QSignalSpy finished(&runner, &Core::ShardedScriptRunner::finished);
+        runner.run(script.fileName(), {"a.cpp", "b.cpp"});
+        QVERIFY(finished.count() == 1 || finished.wait());
+        QCOMPARE(finished.at(0).at(0).toInt(), 1);
+        QCOMPARE(runner.failedFiles(), QStringList({"a.cpp", "b.cpp"}));
+    }
+};
+
+QTEST_MAIN(TestShardedScriptRunner)
+#include "tst_shardedscriptrunner.moc"
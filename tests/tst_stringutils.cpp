@@ -8,9 +8,13 @@
   Contact KDAB at <info@kdab.com> for commercial licensing options.
 */
 
+#include "utils/regularexpressioncache.h"
 #include "utils/string_helper.h"
+#include "utils/stringpool.h"
 
 #include <QTest>
+#include <thread>
+#include <vector>
 
 using namespace Utils;
 
@@ -75,6 +79,13 @@ private slots:
                  "To Title Case With an Exception");
         QCOMPARE(convertCase("To Title Case With an Exception", Utils::Case::TitleCase, Utils::Case::TitleCase),
                  "To Title Case With an Exception");
+
+        // Non-ASCII words use the full Unicode case mapping
+        QCOMPARE(convertCase("größeÄnderung", Utils::Case::CamelCase, Utils::Case::UpperCase), "GRÖSSE_ÄNDERUNG");
+        QCOMPARE(convertCase("ÉTÉ_CHAUD", Utils::Case::UpperCase, Utils::Case::PascalCase), "ÉtéChaud");
+
+        QCOMPARE(convertCase(QStringList({"firstName", "lastName"}), Utils::Case::CamelCase, Utils::Case::SnakeCase),
+                 QStringList({"first_name", "last_name"}));
     }
 
     // This function is copied from from Qt Creator.
@@ -134,6 +145,124 @@ private slots:
         QCOMPARE(matchCaseReplacement("pReFiXTeStPaDSuFfIx", "prefixfoobarsuffix"),
                  QString("pReFiXfoobarSuFfIx")); // mixed case, use replacement as specified
     }
+
+    void test_regularExpressionCache()
+    {
+        auto &cache = Utils::RegularExpressionCache::instance();
+        cache.clear();
+
+        const auto regexp = cache.regularExpression("fo+", QRegularExpression::CaseInsensitiveOption);
+        QVERIFY(regexp.match("FOO").hasMatch());
+        QCOMPARE(cache.misses(), 1);
+        QCOMPARE(cache.hits(), 0);
+
+        // Same pattern and options, the expression comes from the cache
+        QCOMPARE(cache.regularExpression("fo+", QRegularExpression::CaseInsensitiveOption), regexp);
+        QCOMPARE(cache.hits(), 1);
+
+        // Different options are a different expression
+        QVERIFY(!cache.regularExpression("fo+").match("FOO").hasMatch());
+        QCOMPARE(cache.misses(), 2);
+
+        // createRegularExpression goes through the cache
+        QVERIFY(Utils::createRegularExpression("fo+", 0).match("FOO").hasMatch());
+        QCOMPARE(cache.hits(), 2);
+
+        // Invalid expressions are cached too
+        QVERIFY(!cache.regularExpression("(").isValid());
+        QVERIFY(!cache.regularExpression("(").isValid());
+        QCOMPARE(cache.hits(), 3);
+
+        // The least recently used expressions are removed first
+        cache.setMaxSize(1);
+        cache.regularExpression("(");
+        QCOMPARE(cache.hits(), 4);
+        cache.regularExpression("fo+");
+        QCOMPARE(cache.misses(), 4);
+        cache.regularExpression("(");
+        QCOMPARE(cache.misses(), 5);
+
+        cache.setMaxSize(256);
+        cache.clear();
+    }
+
+    void test_stringPool()
+    {
+        Utils::StringPool pool;
+        const QString text = "MyObject::sayMessage";
+        const auto interned = pool.intern(text);
+        QCOMPARE(interned, text);
+        QVERIFY(interned.constData() != text.constData());
+        // Equal strings share the same data, whatever the source
+        QCOMPARE(pool.intern(QStringView(u"MyObject::sayMessage")).constData(), interned.constData());
+        QCOMPARE(pool.intern(text.left(8)), "MyObject");
+        QCOMPARE(pool.size(), 2);
+
+        // The same strings interned from several threads end up as one string each
+        constexpr int ThreadCount = 8;
+        std::vector<QList<QString>> results(ThreadCount);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < ThreadCount; ++i) {
+            threads.emplace_back([&pool, &results, i]() {
+                for (int j = 0; j < 1000; ++j)
+                    results[i].push_back(pool.intern(QString("IDC_BUTTON%1").arg(j)));
+            });
+        }
+        for (auto &thread : threads)
+            thread.join();
+        QCOMPARE(pool.size(), 1002);
+        for (int j = 0; j < 1000; ++j) {
+            for (int i = 1; i < ThreadCount; ++i)
+                QCOMPARE(results[i].at(j).constData(), results[0].at(j).constData());
+        }
+
+        // The process-wide pool is used by intern
+        QCOMPARE(Utils::intern(text).constData(), Utils::StringPool::instance().intern(text).constData());
+    }
+
+    void test_fuzzyMatchScore()
+    {
+        QCOMPARE(fuzzyMatchScore(u"", u"anything"), 0);
+        QCOMPARE(fuzzyMatchScore(u"abc", u"ab"), -1);
+        QCOMPARE(fuzzyMatchScore(u"ba", u"abc"), -1);
+        QVERIFY(fuzzyMatchScore(u"ABC", u"abc") > 0);
+
+        // Consecutive characters are better than scattered ones
+        QVERIFY(fuzzyMatchScore(u"doc", u"document.cpp") > fuzzyMatchScore(u"doc", u"d_o_c.cpp"));
+        // Word boundaries and camel case humps are better than characters in the middle of a word
+        QVERIFY(fuzzyMatchScore(u"td", u"textdocument.cpp") < fuzzyMatchScore(u"td", u"TextDocument.cpp"));
+        QVERIFY(fuzzyMatchScore(u"td", u"textdocument.cpp") < fuzzyMatchScore(u"td", u"text_document.cpp"));
+        // The shortest match is used
+        QCOMPARE(fuzzyMatchScore(u"ab", u"a___ab"), fuzzyMatchScore(u"ab", u"_ab"));
+    }
+
+    void test_unifiedDiff()
+    {
+        QCOMPARE(unifiedDiff("a\nb\n", "a\nb\n"), QString());
+        QCOMPARE(unifiedDiff("a\nb\nc\n", "a\nB\nc\n"), "@@ -1,3 +1,3 @@\n a\n-b\n+B\n c\n");
+        QCOMPARE(unifiedDiff("a\nb\n", "a\nb\nc\n"), "@@ -1,2 +1,3 @@\n a\n b\n+c\n");
+        QCOMPARE(unifiedDiff("a\nb\nc\n", "a\nc\n"), "@@ -1,3 +1,2 @@\n a\n-b\n c\n");
+
+        // Changes far from each other are in different hunks, with their own context
+        QCOMPARE(unifiedDiff("1\n2\n3\n4\n5\n6\n7\n", "x\n2\n3\n4\n5\n6\ny\n", 1),
+                 "@@ -1,2 +1,2 @@\n-1\n+x\n 2\n@@ -6,2 +6,2 @@\n 6\n-7\n+y\n");
+        QCOMPARE(unifiedDiff("1\n2\n3\n4\n", "x\n2\n3\ny\n", 1), "@@ -1,4 +1,4 @@\n-1\n+x\n 2\n 3\n-4\n+y\n");
+
+        // A missing final newline is a change, marked like in GNU diff
+        QCOMPARE(unifiedDiff("a\nb", "a\nb\n"), "@@ -1,2 +1,2 @@\n a\n-b\n\\ No newline at end of file\n+b\n");
+        QCOMPARE(unifiedDiff("a\nb", "a\nc"),
+                 "@@ -1,2 +1,2 @@\n a\n-b\n\\ No newline at end of file\n+c\n\\ No newline at end of file\n");
+    }
+
+    void test_gitPatch()
+    {
+        QCOMPARE(gitPatch("src/main.cpp", QString("a\n"), "a\n"), QString());
+        QCOMPARE(gitPatch("src/main.cpp", QString("a\n"), "b\n"),
+                 "diff --git a/src/main.cpp b/src/main.cpp\n--- a/src/main.cpp\n+++ b/src/main.cpp\n"
+                 "@@ -1,1 +1,1 @@\n-a\n+b\n");
+        QCOMPARE(gitPatch("new.h", {}, "a\n"),
+                 "diff --git a/new.h b/new.h\nnew file mode 100644\n--- /dev/null\n+++ b/new.h\n@@ -0,0 +1,1 @@\n+a\n");
+    }
 };
 
 QTEST_APPLESS_MAIN(TestStringUtils)
@@ -203,25 +203,25 @@ private slots:
 
         spdlog::warn("Verifying document existence");
         for (const auto &reference : references) {
-            QVERIFY(reference.document);
+            QVERIFY(reference.document());
         }
 
         spdlog::warn("Counting documents");
         QCOMPARE(std::ranges::count_if(references,
                                        [](const auto &location) {
-                                           return location.document->fileName().endsWith("main.cpp");
+                                           return location.fileName.endsWith("main.cpp");
                                        }),
                  1);
 
         QCOMPARE(std::ranges::count_if(references,
                                        [](const auto &location) {
-                                           return location.document->fileName().endsWith("myobject.h");
+                                           return location.fileName.endsWith("myobject.h");
                                        }),
                  2);
 
         QCOMPARE(std::ranges::count_if(references,
                                        [](const auto &location) {
-                                           return location.document->fileName().endsWith("myobject.cpp");
+                                           return location.fileName.endsWith("myobject.cpp");
                                        }),
                  6);
     }
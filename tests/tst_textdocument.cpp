@@ -10,15 +10,25 @@
 
 #include "common/test_utils.h"
 #include "core/knutcore.h"
+#include "core/logger.h"
 #include "core/mark.h"
+#include "core/profiler.h"
+#include "core/project.h"
 #include "core/rangemark.h"
+#include "core/settings.h"
 #include "core/textdocument.h"
 #include "core/utils.h"
 
+#include <QDateTime>
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
+#include <QJSEngine>
+#include <QSignalSpy>
+#include <QTemporaryDir>
 #include <QTest>
 #include <QTextStream>
+#include <nlohmann/json.hpp>
 
 static const char *LoremIpsumText = R"(
 Lorem ipsum dolor sit amet, consectetur adipiscing elit.
@@ -104,6 +114,71 @@ private slots:
         QFile::remove(tempFile);
     }
 
+    void mixedLineEndings()
+    {
+        const QString fileName = Core::Utils::mktemp("TestTextDocument");
+        {
+            QFile file(fileName);
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            file.write("first\nsecond\r\nthird\r\nfourth\n\r\n");
+        }
+
+        // The most common line ending is used, and all lines use it when saving
+        Core::TextDocument document;
+        document.load(fileName);
+        QCOMPARE(document.lineEnding(), Core::TextDocument::CRLFLineEnding);
+        QCOMPARE(document.text(), "first\nsecond\nthird\nfourth\n\n");
+        document.save();
+        {
+            QFile file(fileName);
+            QVERIFY(file.open(QIODevice::ReadOnly));
+            QCOMPARE(file.readAll(), "first\r\nsecond\r\nthird\r\nfourth\r\n\r\n");
+        }
+
+        document.setLineEnding(Core::TextDocument::LFLineEnding);
+        document.save();
+        {
+            QFile file(fileName);
+            QVERIFY(file.open(QIODevice::ReadOnly));
+            QCOMPARE(file.readAll(), "first\nsecond\nthird\nfourth\n\n");
+        }
+
+        // Cleanup
+        QFile::remove(fileName);
+    }
+
+    void saveUnchanged()
+    {
+        const QString fileName = Core::Utils::mktemp("TestTextDocument");
+        QFile::remove(fileName);
+        QVERIFY(QFile::copy(Test::testDataPath() + "/tst_textdocument/loremipsum_crlf_utf8bom.txt", fileName));
+        const QDateTime lastModified(QDate::currentDate().addDays(-1), QTime(12, 0));
+        {
+            QFile file(fileName);
+            QVERIFY(file.open(QIODevice::ReadWrite));
+            QVERIFY(file.setFileTime(lastModified, QFileDevice::FileModificationTime));
+        }
+
+        Core::TextDocument document;
+        document.load(fileName);
+
+        // Same content, the file is not written
+        document.setText(document.text());
+        QVERIFY(document.hasChanged());
+        QVERIFY(document.save());
+        QVERIFY(!document.hasChanged());
+        QCOMPARE(QFileInfo(fileName).lastModified(), lastModified);
+
+        document.insert("foo");
+        QVERIFY(document.save());
+        QVERIFY(QFileInfo(fileName).lastModified() != lastModified);
+        QVERIFY(!Test::compareFiles(fileName, Test::testDataPath() + "/tst_textdocument/loremipsum_crlf_utf8bom.txt",
+                                    false));
+
+        // Cleanup
+        QFile::remove(fileName);
+    }
+
     void save()
     {
         Core::TextDocument document;
@@ -135,6 +210,161 @@ private slots:
         QFile::remove(saveAsFileName);
     }
 
+    void savePatch()
+    {
+        Core::KnutCore core;
+        QTemporaryDir dir;
+        auto project = Core::Project::instance();
+        project->setRoot(dir.path());
+        {
+            QFile file(dir.filePath("file.txt"));
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            file.write("a\nb\n");
+        }
+        project->setPatchOutput(true);
+
+        // The file isn't written, its change is in the patch
+        auto document = qobject_cast<Core::TextDocument *>(project->open("file.txt"));
+        QVERIFY(document);
+        document->setText("a\nc\n");
+        QVERIFY(document->save());
+        QVERIFY(!document->hasChanged());
+        QFile file(dir.filePath("file.txt"));
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        QCOMPARE(file.readAll(), QByteArray("a\nb\n"));
+        QCOMPARE(project->patch(),
+                 "diff --git a/file.txt b/file.txt\n--- a/file.txt\n+++ b/file.txt\n@@ -1,2 +1,2 @@\n a\n-b\n+c\n");
+
+        // Going back to the content on disk removes the patch
+        document->setText("a\nb\n");
+        QVERIFY(document->save());
+        QVERIFY(project->patch().isEmpty());
+
+        // A new file is only in the patch too
+        Core::TextDocument newDocument;
+        newDocument.setText("new\n");
+        QVERIFY(newDocument.saveAs(dir.filePath("new.txt")));
+        QVERIFY(!QFile::exists(dir.filePath("new.txt")));
+        QVERIFY(project->filePatches().value("new.txt").startsWith("diff --git a/new.txt b/new.txt\nnew file mode"));
+    }
+
+    void refreshChanged()
+    {
+        Core::KnutCore core;
+        QTemporaryDir dir;
+        auto project = Core::Project::instance();
+        project->setRoot(dir.path());
+        const auto writeFile = [&dir](const QByteArray &data) {
+            QFile file(dir.filePath("file.txt"));
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            file.write(data);
+        };
+        writeFile("first line\nsecond line\nthird line\n");
+
+        auto document = qobject_cast<Core::TextDocument *>(project->open("file.txt"));
+        QVERIFY(document);
+        const auto mark = document->createMark(30);
+        QVERIFY(project->refreshChanged().isEmpty());
+
+        // Same content with a new modification time: nothing is reloaded
+        QFile file(dir.filePath("file.txt"));
+        QVERIFY(file.open(QIODevice::ReadWrite));
+        QVERIFY(file.setFileTime(QDateTime::currentDateTime().addSecs(10), QFileDevice::FileModificationTime));
+        file.close();
+        QVERIFY(document->hasChangedOnDisk());
+        QVERIFY(project->refreshChanged().isEmpty());
+        QVERIFY(!document->hasChangedOnDisk());
+
+        // Small change: only the changed part is replaced, so the mark after it is kept
+        writeFile("first line\n2nd line\nthird line\n");
+        QCOMPARE(project->refreshChanged(), QStringList {document->fileName()});
+        QCOMPARE(document->text(), "first line\n2nd line\nthird line\n");
+        QVERIFY(!document->hasChanged());
+        QCOMPARE(mark.position(), 27);
+
+        // Documents with unsaved changes are kept
+        document->setText("changed");
+        writeFile("new content\n");
+        QVERIFY(project->refreshChanged().isEmpty());
+        QCOMPARE(document->text(), "changed");
+    }
+
+    void batchSignals()
+    {
+        Core::KnutCore core;
+        QTemporaryDir dir;
+        auto project = Core::Project::instance();
+        project->setRoot(dir.path());
+        for (const auto &fileName : {"first.txt", "second.txt"}) {
+            QFile file(dir.filePath(fileName));
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            file.write("text\n");
+        }
+
+        QSignalSpy documentsChanged(project, &Core::Project::documentsChanged);
+        QSignalSpy currentDocumentChanged(project, &Core::Project::currentDocumentChanged);
+        project->beginBatch();
+        project->open("first.txt");
+        project->beginBatch();
+        auto document = project->open("second.txt");
+        project->endBatch();
+        QCOMPARE(documentsChanged.count(), 0);
+        QCOMPARE(currentDocumentChanged.count(), 0);
+        QCOMPARE(project->currentDocument(), document);
+
+        // The signals are only emitted once, for the last document opened
+        project->endBatch();
+        QCOMPARE(documentsChanged.count(), 1);
+        QCOMPARE(currentDocumentChanged.count(), 1);
+        QCOMPARE(currentDocumentChanged.at(0).at(0).value<Core::Document *>(), document);
+
+        // Nothing is emitted if the current document is the same at the end
+        project->beginBatch();
+        project->open("first.txt");
+        project->open("second.txt");
+        project->endBatch();
+        QCOMPARE(documentsChanged.count(), 1);
+        QCOMPARE(currentDocumentChanged.count(), 1);
+    }
+
+    void scriptCache()
+    {
+        QTemporaryDir dir;
+        const auto writeFile = [&dir](const QByteArray &data) {
+            QFile file(dir.filePath("file.txt"));
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            file.write(data);
+        };
+        writeFile("first version\n");
+
+        {
+            Core::KnutCore core;
+            Core::Settings::instance()->setValue(Core::Settings::ScriptCache, "cache/script.cbor");
+            auto project = Core::Project::instance();
+            project->setRoot(dir.path());
+            QVERIFY(!project->cacheValue("missing").isValid());
+            project->setCacheValue("classes", QVariantMap {{"CMainFrame", QStringList {"CFrameWnd"}}});
+            project->setCacheValue("lines", 1, "file.txt");
+            QCOMPARE(project->cacheValue("lines", "file.txt").toInt(), 1);
+            // Same key, different file
+            QVERIFY(!project->cacheValue("lines").isValid());
+        }
+        QVERIFY(QFile::exists(dir.filePath("cache/script.cbor")));
+
+        // Kept between runs, the values attached to a file are removed when its content changes
+        Core::KnutCore core;
+        Core::Settings::instance()->setValue(Core::Settings::ScriptCache, "cache/script.cbor");
+        auto project = Core::Project::instance();
+        project->setRoot(dir.path());
+        QCOMPARE(project->cacheValue("classes").toMap().value("CMainFrame").toStringList(), QStringList {"CFrameWnd"});
+        QCOMPARE(project->cacheValue("lines", dir.filePath("file.txt")).toInt(), 1);
+        writeFile("second version\n");
+        QVERIFY(!project->cacheValue("lines", "file.txt").isValid());
+
+        project->clearCache();
+        QVERIFY(!project->cacheValue("classes").isValid());
+    }
+
     void navigation()
     {
         Core::TextDocument document;
@@ -197,6 +427,38 @@ private slots:
         QCOMPARE(document.column(), 10);
     }
 
+    void cursorSignals()
+    {
+        Core::TextDocument document;
+        document.load(Test::testDataPath() + "/tst_textdocument/loremipsum_lf_utf8.txt");
+
+        QSignalSpy positionSpy(&document, &Core::TextDocument::positionChanged);
+        QSignalSpy selectionSpy(&document, &Core::TextDocument::selectionChanged);
+
+        auto checkSignals = [&]() {
+            positionSpy.clear();
+            selectionSpy.clear();
+            document.gotoNextLine();
+            QCOMPARE(positionSpy.count(), 1);
+            QCOMPARE(selectionSpy.count(), 0);
+            document.selectNextChar(2);
+            QCOMPARE(positionSpy.count(), 2);
+            QCOMPARE(selectionSpy.count(), 1);
+            document.unselect();
+            QCOMPARE(positionSpy.count(), 2);
+            QCOMPARE(selectionSpy.count(), 2);
+        };
+
+        // No editor is created until it's needed
+        checkSignals();
+        const int position = document.position();
+
+        // The editor takes over the cursor of the document
+        QVERIFY(document.textEdit());
+        QCOMPARE(document.position(), position);
+        checkSignals();
+    }
+
     void edition()
     {
         Test::FileTester file(Test::testDataPath() + "/tst_textdocument/edition/loremipsum.txt");
@@ -347,6 +609,367 @@ private slots:
         QVERIFY(mark == 10);
     }
 
+    void markLifetime()
+    {
+        auto document = std::make_unique<Core::TextDocument>();
+        document->setText("0123456789");
+
+        QVector<Core::Mark> marks;
+        QVector<Core::RangeMark> rangeMarks;
+        for (int i = 0; i < 10; ++i) {
+            marks.push_back(document->createMark(i));
+            rangeMarks.push_back(document->createRangeMark(i, 10));
+        }
+        // Remove marks in any order, the remaining ones are still updated
+        marks.removeAt(5);
+        marks.removeFirst();
+        rangeMarks.removeAt(3);
+        rangeMarks.removeLast();
+
+        document->setPosition(0);
+        document->insert("ab");
+        QVector<int> positions;
+        for (const auto &mark : std::as_const(marks))
+            positions.push_back(mark.position());
+        QCOMPARE(positions, QVector<int>({3, 4, 5, 6, 8, 9, 10, 11}));
+        QCOMPARE(rangeMarks.first().text(), "0123456789");
+        QCOMPARE(rangeMarks.last().text(), "89");
+
+        // Marks outlive their document, and keep their last position
+        document.reset();
+        QVERIFY(!marks.first().isValid());
+        QCOMPARE(marks.first().position(), 3);
+        QCOMPARE(rangeMarks.last().start(), 10);
+    }
+
+    void applyEdits()
+    {
+        Core::TextDocument document;
+        document.setText("one two three four");
+        auto twoMark = document.createRangeMark(4, 7);
+        auto fourMark = document.createMark(14);
+
+        QSignalSpy spy(document.qTextDocument(), &QTextDocument::contentsChange);
+        QVERIFY(document.applyEdits(QVector<Core::TextEdit> {
+            {{8, 13}, "3"},
+            {{0, 3}, "1"},
+            {{4, 4}, "("},
+            {{4, 4}, "["},
+        }));
+        QCOMPARE(document.text(), "1 ([two 3 four");
+        // Only one notification for all edits
+        QCOMPARE(spy.count(), 1);
+        // Marks between the edits are kept
+        QCOMPARE(twoMark.text(), "two");
+        QCOMPARE(fourMark.position(), 10);
+
+        // Overlapping or invalid edits are rejected, without changing the document
+        QVERIFY(!document.applyEdits(QVariantList {QVariantMap {{"start", 0}, {"end", 5}, {"text", "a"}},
+                                                   QVariantMap {{"start", 3}, {"end", 6}, {"text", "b"}}}));
+        QVERIFY(!document.applyEdits(QVariantList {QVariantMap {{"start", 0}, {"end", 100}, {"text", "a"}}}));
+        QCOMPARE(document.text(), "1 ([two 3 four");
+
+        QVERIFY(document.applyEdits(QVariantList {QVariantMap {{"start", 0}, {"end", 1}, {"text", "one"}}}));
+        QCOMPARE(document.text(), "one ([two 3 four");
+
+        // All the edits are undone at once
+        document.undo();
+        document.undo();
+        QCOMPARE(document.text(), "one two three four");
+    }
+
+    void lines()
+    {
+        Core::TextDocument document;
+        document.setText("one\ntwo\nthree\nfour");
+
+        QCOMPARE(document.lines(), QStringList({"one", "two", "three", "four"}));
+        QCOMPARE(document.lines(2, 3), QStringList({"two", "three"}));
+        QCOMPARE(document.lines(3, 2), QStringList());
+        QCOMPARE(document.lines(1, 10), QStringList());
+
+        QSignalSpy spy(document.qTextDocument(), &QTextDocument::contentsChange);
+        QVERIFY(document.setLines(2, 3, {"2", "2.5", "3"}));
+        QCOMPARE(document.text(), "one\n2\n2.5\n3\nfour");
+        QCOMPARE(spy.count(), 1);
+
+        // Removal and insertion
+        QVERIFY(document.setLines(4, 5, {}));
+        QCOMPARE(document.text(), "one\n2\n2.5");
+        QVERIFY(document.setLines(1, 1, {}));
+        QCOMPARE(document.text(), "2\n2.5");
+        QVERIFY(document.setLines(1, 0, {"1"}));
+        QCOMPARE(document.text(), "1\n2\n2.5");
+        QVERIFY(document.setLines(4, 3, {"3"}));
+        QCOMPARE(document.text(), "1\n2\n2.5\n3");
+        QVERIFY(!document.setLines(6, 6, {"x"}));
+        QCOMPARE(document.text(), "1\n2\n2.5\n3");
+    }
+
+    void lineColumns()
+    {
+        Core::TextDocument document;
+        document.setText("one\ntwo\nthree\nfour");
+
+        // Unsorted ranges, one of them invalid
+        const Core::RangeMarkList ranges {document.createRangeMark(14, 18), document.createRangeMark(0, 3),
+                                          Core::RangeMark(), document.createRangeMark(5, 10)};
+        QCOMPARE(document.lineColumns(ranges), QList<int>({4, 1, 4, 5, 1, 1, 1, 4, -1, -1, -1, -1, 2, 2, 3, 3}));
+
+        Core::TextDocument other;
+        other.setText("other");
+        QCOMPARE(document.lineColumns({other.createRangeMark(0, 1)}), QList<int>({-1, -1, -1, -1}));
+
+        // The line and column of a mark follow the changes of the document
+        auto mark = document.createMark(9);
+        QCOMPARE(mark.line(), 3);
+        QCOMPARE(mark.column(), 2);
+        document.setPosition(0);
+        document.insert("zero\n");
+        QCOMPARE(mark.line(), 4);
+        QCOMPARE(mark.column(), 2);
+        document.setPosition(mark.position() - 1);
+        document.insert("-");
+        QCOMPARE(mark.line(), 4);
+        QCOMPARE(mark.column(), 3);
+    }
+
+    void editLines()
+    {
+        Core::TextDocument document;
+        document.setText("one  \ntwo\n// three\n// four\nfive");
+        auto fiveMark = document.createMark(document.positionAt(5, 1));
+
+        QJSEngine engine;
+        const auto callback = engine.evaluate(R"((function(line, number) {
+            if (line.startsWith("//"))
+                return [];
+            if (number === 2)
+                return ["two", "2"];
+            if (number === 5)
+                return undefined;
+            return line.trim();
+        }))");
+
+        QSignalSpy spy(document.qTextDocument(), &QTextDocument::contentsChange);
+        QVERIFY(document.editLines(callback));
+        QCOMPARE(document.text(), "one\ntwo\n2\nfive");
+        QCOMPARE(spy.count(), 1);
+        QCOMPARE(fiveMark.position(), document.positionAt(4, 1));
+
+        // Errors in the callback don't change the document
+        QVERIFY(!document.editLines(engine.evaluate("(function(line) { throw new Error('oops'); })")));
+        QVERIFY(!document.editLines(QJSValue("not a function")));
+        QCOMPARE(document.text(), "one\ntwo\n2\nfive");
+
+        document.undo();
+        QCOMPARE(document.text(), "one  \ntwo\n// three\n// four\nfive");
+    }
+
+    void loggerToggle()
+    {
+        Core::HistoryModel model;
+        Core::TextDocument document;
+
+        document.setText("one two three");
+        model.flush();
+        QCOMPARE(model.rowCount(), 1);
+
+        Core::LoggerObject::setEnabled(false);
+        document.setText("one");
+        document.replaceAll("one", "1");
+        model.flush();
+        QCOMPARE(model.rowCount(), 1);
+
+        Core::LoggerObject::setEnabled(true);
+        document.replaceAll("1", "one");
+        model.flush();
+        QCOMPARE(model.rowCount(), 2);
+        QCOMPARE(model.data(model.index(1, Core::HistoryModel::NameCol)).toString(), "TextDocument::replaceAll");
+    }
+
+    void typedKeysHistory()
+    {
+        Core::HistoryModel model;
+        Core::TextDocument document;
+        document.setText("one");
+        document.gotoEndOfDocument();
+        model.flush();
+        const int rowCount = model.rowCount();
+
+        auto textEdit = document.textEdit();
+        QTest::keyClick(textEdit, Qt::Key_Backspace);
+        QTest::keyClicks(textEdit, "ly tw");
+        QTest::keyClick(textEdit, Qt::Key_Backspace);
+        QTest::keyClick(textEdit, Qt::Key_O);
+        QCOMPARE(document.text(), "only to");
+
+        // The keys are only recorded once the user stops typing, in one call per kind of key
+        model.flush();
+        QCOMPARE(model.rowCount(), rowCount);
+        QTRY_COMPARE(model.rowCount(), rowCount + 2);
+        QCOMPARE(model.data(model.index(rowCount, Core::HistoryModel::NameCol)).toString(),
+                 "TextDocument::deletePreviousCharacter");
+        QCOMPARE(model.data(model.index(rowCount + 1, Core::HistoryModel::NameCol)).toString(),
+                 "TextDocument::insert");
+        QCOMPARE(model.data(model.index(rowCount + 1, Core::HistoryModel::ParamCol)).toString(), "text: ly to");
+
+        // Other keys still go through the API, after recording the keys typed before
+        QTest::keyClicks(textEdit, "!");
+        QTest::keyClick(textEdit, Qt::Key_Home);
+        model.flush();
+        QCOMPARE(model.rowCount(), rowCount + 3);
+        QCOMPARE(model.data(model.index(rowCount + 1, Core::HistoryModel::ParamCol)).toString(), "text: ly to!");
+        QCOMPARE(model.data(model.index(rowCount + 2, Core::HistoryModel::NameCol)).toString(),
+                 "TextDocument::gotoStartOfLine");
+        QCOMPARE(document.text(), "only to!");
+        QCOMPARE(document.position(), 0);
+    }
+
+    void historyCapacity()
+    {
+        Core::HistoryModel model;
+        model.setCapacity(10);
+        Core::TextDocument document;
+
+        QSignalSpy insertSpy(&model, &QAbstractItemModel::rowsInserted);
+        for (int i = 0; i < 15; ++i)
+            document.setPosition(0);
+        // The calls are inserted in one batch
+        QCOMPARE(model.rowCount(), 0);
+        QTRY_COMPARE(model.rowCount(), 10);
+        QCOMPARE(insertSpy.count(), 1);
+
+        QSignalSpy removeSpy(&model, &QAbstractItemModel::rowsRemoved);
+        document.setText("text");
+        model.flush();
+        QCOMPARE(model.rowCount(), 10);
+        QCOMPARE(removeSpy.count(), 1);
+        QCOMPARE(model.data(model.index(9, Core::HistoryModel::NameCol)).toString(), "TextDocument::setText");
+    }
+
+    void profiler()
+    {
+        QTemporaryDir dir;
+        const QString fileName = dir.filePath("profile.json");
+
+        Core::TextDocument document;
+        Core::Profiler::start(fileName);
+        document.setText("one two three");
+        // Nested calls are recorded too
+        document.replaceAll("two", "2");
+        QVERIFY(Core::Profiler::stop());
+        QVERIFY(!Core::Profiler::isActive());
+
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        const auto trace = nlohmann::json::parse(file.readAll().toStdString());
+        QStringList names;
+        for (const auto &event : trace["traceEvents"]) {
+            names.push_back(QString::fromStdString(event["name"].get<std::string>()));
+            QCOMPARE(event["ph"], "X");
+            QVERIFY(event["dur"].get<double>() >= 0);
+        }
+        QVERIFY(names.contains("TextDocument::setText"));
+        QVERIFY(names.contains("TextDocument::replaceAll"));
+    }
+
+    void lineConversions()
+    {
+        Core::TextDocument document;
+
+        // Check all positions against the lines and columns computed from the text
+        auto checkConversions = [&document]() {
+            const QString text = document.text();
+            int line = 1;
+            int column = 1;
+            for (int pos = 0; pos <= text.size(); ++pos) {
+                QCOMPARE(document.lineAtPosition(pos), line);
+                QCOMPARE(document.columnAtPosition(pos), column);
+                QCOMPARE(document.positionAt(line, column), pos);
+                if (pos < text.size() && text.at(pos) == '\n') {
+                    ++line;
+                    column = 1;
+                } else {
+                    ++column;
+                }
+            }
+            QCOMPARE(document.lineCount(), line);
+            QCOMPARE(document.lineAtPosition(-1), -1);
+            QCOMPARE(document.lineAtPosition(text.size() + 1), -1);
+            QCOMPARE(document.positionAt(line + 1, 1), -1);
+        };
+
+        document.setText("first\nsecond\n\nfourth");
+        checkConversions();
+
+        document.setPosition(2);
+        document.insert("a\nb\nc");
+        checkConversions();
+
+        document.selectRegion(4, 12);
+        document.deleteSelection();
+        checkConversions();
+
+        document.gotoEndOfDocument();
+        document.insert("\nlast\n");
+        checkConversions();
+
+        QVERIFY(document.applyEdits(QVector<Core::TextEdit> {{{0, 1}, "x\ny"}, {{7, 9}, ""}, {{10, 10}, "\n\n"}}));
+        checkConversions();
+
+        document.undo();
+        checkConversions();
+    }
+
+    void undoGroups()
+    {
+        Core::TextDocument document;
+        Core::TextDocument otherDocument;
+        // Edits are done at different places, otherwise QTextDocument merges them in one undo step
+        auto insertAt = [](Core::TextDocument &document, int position, const QString &text) {
+            document.setPosition(position);
+            document.insert(text);
+        };
+
+        document.setText("abc");
+        otherDocument.setText("x");
+        insertAt(document, 0, "1");
+
+        Core::TextDocument::beginUndoGroup();
+        insertAt(document, 2, "2");
+        insertAt(document, 5, "3");
+        insertAt(otherDocument, 0, "y");
+        insertAt(otherDocument, 2, "z");
+        Core::TextDocument::endUndoGroup();
+
+        insertAt(document, 0, "4");
+        QCOMPARE(document.text(), "41a2bc3");
+        QCOMPARE(otherDocument.text(), "yxz");
+
+        document.undo();
+        QCOMPARE(document.text(), "1a2bc3");
+        document.undo();
+        QCOMPARE(document.text(), "1abc");
+        document.undo();
+        QCOMPARE(document.text(), "abc");
+        document.redo(2);
+        QCOMPARE(document.text(), "1a2bc3");
+        otherDocument.undo();
+        QCOMPARE(otherDocument.text(), "x");
+
+        // Undoing inside a group undoes the steps one by one
+        Core::TextDocument::beginUndoGroup();
+        insertAt(document, 0, "5");
+        insertAt(document, 3, "6");
+        QCOMPARE(document.text(), "51a62bc3");
+        document.undo();
+        QCOMPARE(document.text(), "51a2bc3");
+        Core::TextDocument::endUndoGroup();
+        document.undo();
+        QCOMPARE(document.text(), "1a2bc3");
+    }
+
     void indent()
     {
         Test::FileTester file(Test::testDataPath() + "/tst_textdocument/indent/indent.txt");
@@ -371,6 +994,29 @@ private slots:
         }
     }
 
+    void indentSelection()
+    {
+        Core::KnutCore core;
+        Core::TextDocument document;
+        document.setText("one\n  two\n\tthree\nfour");
+        document.gotoLine(1, 2);
+        document.selectNextLine(2);
+
+        QSignalSpy spy(document.qTextDocument(), &QTextDocument::contentsChange);
+        document.indent(2);
+        QCOMPARE(document.text(), "        one\n        two\n            three\nfour");
+        // All the lines are changed at once, and stay selected
+        QCOMPARE(spy.count(), 1);
+        QCOMPARE(document.selectedText(), "ne\u2029        two\u2029            three");
+
+        document.removeIndent(3);
+        QCOMPARE(document.text(), "one\ntwo\nthree\nfour");
+        QCOMPARE(spy.count(), 2);
+
+        document.undo();
+        QCOMPARE(document.text(), "        one\n        two\n            three\nfour");
+    }
+
     void findReplace()
     {
         Test::FileTester file(Test::testDataPath() + "/tst_textdocument/findReplace/findreplace.txt");
@@ -463,6 +1109,37 @@ private slots:
         }
     }
 
+    void replaceAllMatches()
+    {
+        Core::TextDocument document;
+        document.setText("foo bar foo\nbar foo");
+        auto barMark = document.createRangeMark(4, 7);
+
+        QCOMPARE(document.replaceAll("FOO", "baz"), 3);
+        QCOMPARE(document.text(), "baz bar baz\nbar baz");
+        // Text between the replacements is untouched, and so are its marks
+        QCOMPARE(barMark.text(), "bar");
+        QCOMPARE(document.position(), document.text().size());
+
+        // Empty matches don't stop the search
+        document.setText("ab\ncd");
+        QCOMPARE(document.replaceAllRegexp("x*", "-"), 6);
+        QCOMPARE(document.text(), "-a-b-\n-c-d-");
+
+        // Matching is done line by line
+        document.setText("ab\ncd");
+        QCOMPARE(document.replaceAllRegexp("b\\s*c", "-"), 0);
+        QCOMPARE(document.replaceAllRegexp("^(\\w)", "<\\1>"), 2);
+        QCOMPARE(document.text(), "<a>b\n<c>d");
+
+        // Or on the whole text, with `^` and `$` still matching each line
+        document.setText("ab\ncd\nef");
+        QCOMPARE(document.replaceAllRegexp("b\\s*c", "-", Core::TextDocument::FindMultiline), 1);
+        QCOMPARE(document.text(), "a-d\nef");
+        QCOMPARE(document.replaceAllRegexp("^(\\w)", "<\\1>", Core::TextDocument::FindMultiline), 2);
+        QCOMPARE(document.text(), "<a>-d\n<e>f");
+    }
+
     void findReplaceRegexInRange()
     {
         Test::FileTester file(Test::testDataPath() + "/tst_textdocument/findReplaceRegexInRange/loremipsum.txt");
@@ -626,6 +1303,14 @@ private slots:
         QVERIFY(document.findRegexp("Lorem.*Quisque"));
         QCOMPARE(document.selectedText(), "");
 
+        // Unless FindMultiline is used
+        document.gotoStartOfDocument();
+        QVERIFY(document.findRegexp(R"(elit\.\s+Quisque)", Core::TextDocument::FindMultiline));
+        QCOMPARE(document.selectedText(), "elit.\nQuisque");
+        QVERIFY(document.findRegexp(R"(^Lorem\s+\w+)",
+                                    Core::TextDocument::FindMultiline | Core::TextDocument::FindBackward));
+        QCOMPARE(document.selectedText(), "Lorem ipsum");
+
         // FindWholeWords is supported
         document.gotoStartOfDocument();
         QVERIFY(!document.findRegexp("Lor", Core::TextDocument::FindWholeWords));
@@ -9,14 +9,22 @@
 */
 
 #include "common/test_utils.h"
+#include "treesitter/builtinqueries.h"
 #include "treesitter/languages.h"
 #include "treesitter/parser.h"
+#include "treesitter/parserpool.h"
 #include "treesitter/predicates.h"
 #include "treesitter/query.h"
+#include "treesitter/querycache.h"
+#include "treesitter/queryprofile.h"
 #include "treesitter/transformation.h"
 #include "treesitter/tree.h"
+#include "treesitter/treecursor.h"
+#include "utils/memoryaccounting.h"
 
 #include <QTest>
+#include <functional>
+#include <unordered_set>
 
 class TestTreeSitter : public QObject
 {
@@ -54,6 +62,178 @@ private slots:
         QCOMPARE(root.namedChildren().size(), 9);
     }
 
+    void childIteration()
+    {
+        auto source = readTestFile("/tst_treesitter/main.cpp");
+
+        treesitter::Parser parser(tree_sitter_cpp());
+        auto tree = parser.parseString(source);
+        QVERIFY(tree.has_value());
+        auto root = tree->rootNode();
+
+        QVector<treesitter::Node> namedChildren;
+        for (const auto &child : root.namedChildRange())
+            namedChildren.push_back(child);
+        QCOMPARE(namedChildren.size(), 9);
+        for (uint32_t i = 0; i < root.namedChildCount(); ++i)
+            QVERIFY(namedChildren.at(i) == root.namedChild(i));
+
+        QCOMPARE(root.children().size(), static_cast<qsizetype>(root.childCount()));
+
+        // Descendants are visited in pre-order, the same way as a recursive walk of the children
+        std::function<void(const treesitter::Node &, QVector<treesitter::Node> &)> walk =
+            [&walk](const treesitter::Node &node, QVector<treesitter::Node> &result) {
+                for (const auto &child : node.children()) {
+                    result.push_back(child);
+                    walk(child, result);
+                }
+            };
+        QVector<treesitter::Node> expected;
+        walk(root, expected);
+        QVector<treesitter::Node> descendants;
+        for (const auto &node : root.descendants())
+            descendants.push_back(node);
+        QVERIFY(descendants == expected);
+
+        // The walk stays inside the subtree of the starting node
+        const auto function = namedChildren.last();
+        for (const auto &node : function.descendants()) {
+            QVERIFY(node.startPosition() >= function.startPosition());
+            QVERIFY(node.endPosition() <= function.endPosition());
+        }
+
+        // Nodes can be used as keys, with no hash collision between the nodes of a tree
+        std::unordered_set<treesitter::Node> nodes(descendants.cbegin(), descendants.cend());
+        QCOMPARE(static_cast<qsizetype>(nodes.size()), descendants.size());
+        std::unordered_set<std::size_t> hashes;
+        for (const auto &node : descendants)
+            hashes.insert(std::hash<treesitter::Node> {}(node));
+        QCOMPARE(hashes.size(), nodes.size());
+        QVERIFY(nodes.contains(root.namedChild(0)));
+    }
+
+    void textExcept()
+    {
+        const QString source = "int foo(int a, const char *b) { return a + bar(b); }";
+
+        treesitter::Parser parser(tree_sitter_cpp());
+        auto tree = parser.parseString(source);
+        QVERIFY(tree.has_value());
+        const auto function = tree->rootNode().namedChild(0);
+        QCOMPARE(function.type(), "function_definition");
+
+        QCOMPARE(function.textExcept(source, QVector<QString> {}), source);
+        QCOMPARE(function.textExcept(source, {"identifier"}), "int (int , const char *) { return  + (); }");
+        // Nodes inside a removed node are not removed again
+        QCOMPARE(function.textExcept(source, {"compound_statement", "identifier"}), "int (int , const char *) ");
+        QCOMPARE(function.textExcept(source, {"parameter_list", ";"}), "int foo { return a + bar(b) }");
+
+        const auto symbols = treesitter::Node::symbolsForTypes(tree_sitter_cpp(), {"identifier", "unknown_type"});
+        QVERIFY(!symbols.isEmpty());
+        QCOMPARE(function.textExcept(source, symbols), function.textExcept(source, {"identifier"}));
+        QVERIFY(treesitter::Node::symbolsForTypes(tree_sitter_cpp(), {"unknown_type"}).isEmpty());
+    }
+
+    void queryCursorLimits()
+    {
+        auto source = readTestFile("/tst_treesitter/main.cpp");
+
+        treesitter::Parser parser(tree_sitter_cpp());
+        auto tree = parser.parseString(source);
+        QVERIFY(tree.has_value());
+
+        auto query = std::make_shared<treesitter::Query>(tree_sitter_cpp(), "(identifier) @id");
+
+        treesitter::QueryCursor cursor;
+        QCOMPARE(cursor.matchLimit(), 0u);
+        cursor.setMatchLimit(64);
+        QCOMPARE(cursor.matchLimit(), 64u);
+        cursor.execute(query, tree->rootNode(), std::make_unique<treesitter::Predicates>(source));
+        QVERIFY(!cursor.allRemainingMatches().isEmpty());
+        QVERIFY(!cursor.didExceedMatchLimit());
+        QVERIFY(!cursor.hasExpired());
+
+        treesitter::QueryCursor expiredCursor;
+        expiredCursor.setDeadline(QDeadlineTimer(0));
+        expiredCursor.execute(query, tree->rootNode(), std::make_unique<treesitter::Predicates>(source));
+        QVERIFY(!expiredCursor.nextMatch().has_value());
+        QVERIFY(expiredCursor.hasExpired());
+    }
+
+    void queryProfile()
+    {
+        auto source = readTestFile("/tst_treesitter/main.cpp");
+
+        treesitter::Parser parser(tree_sitter_cpp());
+        auto tree = parser.parseString(source);
+        QVERIFY(tree.has_value());
+
+        auto query = std::make_shared<treesitter::Query>(tree_sitter_cpp(), R"EOF(
+            ((identifier) @id (#eq? @id "main"))
+            ((comment) (function_definition))
+        )EOF");
+        QVERIFY(query->isPatternRooted(0));
+        QVERIFY(!query->isPatternRooted(1));
+        const auto warnings = query->patternWarnings();
+        QVERIFY(!warnings.isEmpty());
+        QVERIFY(warnings.first().startsWith("Pattern 1 (line 3) is not rooted"));
+
+        treesitter::QueryProfiler::reset();
+        treesitter::QueryProfiler::setEnabled(true);
+        {
+            treesitter::QueryCursor cursor;
+            cursor.execute(query, tree->rootNode(), std::make_unique<treesitter::Predicates>(source));
+            const auto matches = cursor.allRemainingMatches();
+
+            const auto &profile = cursor.profile();
+            QVERIFY(profile.has_value());
+            QCOMPARE(profile->executions, 1);
+            QCOMPARE(profile->patterns.size(), 2);
+            const auto &patterns = profile->patterns;
+            QCOMPARE(patterns.at(0).matches + patterns.at(1).matches, static_cast<int>(matches.size()));
+            // All the other identifiers are rejected by the predicate
+            QVERIFY(patterns.at(0).matches > 0);
+            QVERIFY(patterns.at(0).rejectedMatches > 0);
+            QCOMPARE(patterns.at(1).rejectedMatches, 0);
+        }
+        treesitter::QueryProfiler::setEnabled(false);
+
+        // The profile is recorded once the cursor is done
+        const auto json = treesitter::QueryProfiler::toJson();
+        QCOMPARE(json["queries"].size(), size_t(1));
+        const auto &queryProfile = json["queries"][0];
+        QCOMPARE(queryProfile["executions"].get<int>(), 1);
+        QCOMPARE(queryProfile["patterns"].size(), size_t(2));
+        QCOMPARE(queryProfile["warnings"].size(), static_cast<size_t>(warnings.size()));
+        treesitter::QueryProfiler::reset();
+
+        // Without the profiler, profiling is opt-in
+        treesitter::QueryCursor cursor;
+        cursor.execute(query, tree->rootNode(), std::make_unique<treesitter::Predicates>(source));
+        QVERIFY(!cursor.profile().has_value());
+    }
+
+    void parseCancellation()
+    {
+        auto source = readTestFile("/tst_treesitter/main.cpp");
+
+        treesitter::Parser parser(tree_sitter_cpp());
+        std::atomic<size_t> cancelled = 1;
+        parser.setCancellationFlag(&cancelled);
+        QVERIFY(!parser.parseString(source).has_value());
+
+        // The parser is reset after a cancelled parse, the next one starts from scratch
+        cancelled = 0;
+        auto tree = parser.parseString(source);
+        QVERIFY(tree.has_value());
+        QCOMPARE(tree->rootNode().namedChildren().size(), 9);
+
+        parser.setCancellationFlag(nullptr);
+        parser.setTimeout(std::chrono::milliseconds(100));
+        QCOMPARE(parser.timeout(), std::chrono::microseconds(100000));
+        QVERIFY(parser.parseString(source).has_value());
+    }
+
 #define VERIFY_PREDICATE_ERROR(queryString)                                                                            \
     QVERIFY_THROWS_EXCEPTION(Error, treesitter::Query(tree_sitter_cpp(), queryString))
 
@@ -103,6 +283,9 @@ private slots:
         const auto &pattern = patterns.first();
         QCOMPARE(pattern.predicates.size(), 1);
         QCOMPARE(pattern.predicates.first().name, "eq?");
+        // The predicate function is resolved when the query is constructed
+        QVERIFY(pattern.predicates.first().filter != nullptr);
+        QVERIFY(pattern.predicates.first().command == nullptr);
 
         const auto &arguments = pattern.predicates.first().arguments;
         QCOMPARE(arguments.size(), 2);
@@ -171,6 +354,39 @@ private slots:
         QCOMPARE(result, readTestFile("/tst_treesitter/main-arrow.cpp"));
     }
 
+    void transformRuleSet()
+    {
+        auto source = readTestFile("/tst_treesitter/main.cpp");
+
+        treesitter::Parser parser(tree_sitter_cpp());
+        auto tree = parser.parseString(source);
+        QVERIFY(tree.has_value());
+
+        const treesitter::RuleSetTransformation transformation(
+            tree_sitter_cpp(),
+            {{R"EOF((field_expression argument: (_) @arg "." field: (_) @field) @from)EOF", "@arg->@field"},
+             {R"EOF(((number_literal) @from (#eq? @from "42")))EOF", "43"},
+             // Also matches the argument of the field expression, which is already replaced by the first rule
+             {R"EOF(((identifier) @from (#eq? @from "object")))EOF", "obj"}});
+        QCOMPARE(transformation.query()->patterns().size(), 3);
+
+        const auto result = transformation.findReplacements(source, tree.value());
+        QCOMPARE(result.replacements.size(), 3);
+        QCOMPARE(result.conflicts.size(), 1);
+        QCOMPARE(result.conflicts.first().rule, 2);
+        QCOMPARE(result.conflicts.first().otherRule, 0);
+        QCOMPARE(source.mid(result.conflicts.first().start, 6), "object");
+
+        auto expected = readTestFile("/tst_treesitter/main-arrow.cpp");
+        expected.replace("return 42;", "return 43;").replace("MyObject object(", "MyObject obj(");
+        QCOMPARE(treesitter::RuleSetTransformation::apply(source, result.replacements), expected);
+
+        // Each rule needs a @from capture
+        const QVector<treesitter::RuleSetTransformation::Rule> missingFrom {{"(number_literal) @to", ""}};
+        QVERIFY_THROWS_EXCEPTION(treesitter::Query::Error,
+                                 treesitter::RuleSetTransformation(tree_sitter_cpp(), missingFrom));
+    }
+
     void transformationErrors()
     {
         auto source = readTestFile("/tst_treesitter/main.cpp");
@@ -352,6 +568,22 @@ private slots:
 
         auto matches = cursor.allRemainingMatches();
         QCOMPARE(matches.size(), 2);
+
+        // The message map is searched once, and can be shared between queries
+        const auto messageMap = treesitter::Predicates::findMessageMap(tree->rootNode(), source);
+        QVERIFY(messageMap.has_value());
+        QVERIFY(messageMap->start < messageMap->end);
+
+        int providerCalls = 0;
+        auto predicates = std::make_unique<treesitter::Predicates>(source);
+        predicates->setMessageMapProvider([&]() {
+            ++providerCalls;
+            return messageMap;
+        });
+        treesitter::QueryCursor sharedCursor;
+        sharedCursor.execute(query, tree->rootNode(), std::move(predicates));
+        QCOMPARE(sharedCursor.allRemainingMatches().size(), 2);
+        QCOMPARE(providerCalls, 1);
     }
 
     void eq_except_predicate_errors()
@@ -521,6 +753,122 @@ private slots:
         auto matches = cursor.allRemainingMatches();
         QCOMPARE(matches.size(), 1); // Only one function that returns a string, and not an int.
     }
+
+    void parserPool()
+    {
+        auto &pool = treesitter::ParserPool::instance();
+        pool.clear();
+
+        {
+            auto parser = pool.acquire(tree_sitter_cpp());
+            auto otherParser = pool.acquire(tree_sitter_cpp());
+            QVERIFY(&*parser != &*otherParser);
+            QVERIFY(parser->language() == tree_sitter_cpp());
+            QVERIFY(parser->parseString("int main() {}").has_value());
+            QCOMPARE(pool.idleCount(tree_sitter_cpp()), 0);
+        }
+        // Parsers are given back to the pool, and reused
+        QCOMPARE(pool.idleCount(tree_sitter_cpp()), 2);
+        {
+            auto parser = pool.acquire(tree_sitter_cpp());
+            QCOMPARE(pool.idleCount(tree_sitter_cpp()), 1);
+        }
+        QCOMPARE(pool.idleCount(tree_sitter_cpp()), 2);
+        QCOMPARE(pool.idleCount(tree_sitter_qmljs()), 0);
+
+        // Limits don't outlive the lease
+        {
+            auto parser = pool.acquire(tree_sitter_cpp());
+            parser->setTimeout(std::chrono::milliseconds(10));
+        }
+        QCOMPARE(pool.acquire(tree_sitter_cpp())->timeout().count(), 0);
+
+        pool.clear();
+        QCOMPARE(pool.idleCount(tree_sitter_cpp()), 0);
+    }
+
+    void queryCache()
+    {
+        auto &cache = treesitter::QueryCache::instance();
+        cache.clear();
+
+        const auto queryText = QString("(function_definition) @function");
+        auto first = cache.query(tree_sitter_cpp(), queryText);
+        QVERIFY(first);
+        QCOMPARE(cache.misses(), 1);
+        QCOMPARE(cache.hits(), 0);
+
+        // Same language and query text, the compiled query is shared
+        auto second = cache.query(tree_sitter_cpp(), queryText);
+        QCOMPARE(second, first);
+        QCOMPARE(cache.hits(), 1);
+
+        // Different language, different query
+        auto qmlQuery = cache.query(tree_sitter_qmljs(), "(comment) @comment");
+        QVERIFY(qmlQuery != first);
+        QCOMPARE(cache.misses(), 2);
+
+        // Ill-formed queries still throw, and are not cached
+        QVERIFY_THROWS_EXCEPTION(treesitter::Query::Error, cache.query(tree_sitter_cpp(), "(field_expr)"));
+        QVERIFY_THROWS_EXCEPTION(treesitter::Query::Error, cache.query(tree_sitter_cpp(), "(field_expr)"));
+        QCOMPARE(cache.hits(), 1);
+        QCOMPARE(cache.misses(), 4);
+
+        // Least recently used queries are evicted
+        const auto maxSize = cache.maxSize();
+        cache.setMaxSize(1);
+        cache.query(tree_sitter_cpp(), queryText);
+        QCOMPARE(cache.misses(), 5);
+        cache.query(tree_sitter_cpp(), queryText);
+        QCOMPARE(cache.hits(), 2);
+        cache.query(tree_sitter_qmljs(), "(comment) @comment");
+        cache.query(tree_sitter_cpp(), queryText);
+        QCOMPARE(cache.hits(), 2);
+        QCOMPARE(cache.misses(), 7);
+        cache.setMaxSize(maxSize);
+        cache.clear();
+    }
+
+    void builtinQueries()
+    {
+        const auto names = treesitter::builtinQueryNames();
+        QVERIFY(names.contains("cpp/find_include"));
+        QVERIFY(names.contains("cpp/message_map_range"));
+        for (const auto &name : names) {
+            const auto query = treesitter::builtinQuery(name);
+            QVERIFY2(query, qPrintable(name));
+            // Compiled once, then shared
+            QCOMPARE(treesitter::builtinQuery(name), query);
+            QCOMPARE(query->utf8Text(), treesitter::builtinQueryText(name).toUtf8());
+        }
+        QVERIFY(!treesitter::builtinQuery("cpp/does_not_exist"));
+        QVERIFY(treesitter::builtinQueryText("cpp/does_not_exist").isEmpty());
+    }
+
+    void memoryAccounting()
+    {
+        using Utils::MemoryAccounting;
+        treesitter::installAllocator();
+
+        treesitter::Parser parser(tree_sitter_cpp());
+        const Utils::AllocationScope allocations(MemoryAccounting::TreeSitter);
+        {
+            auto tree = parser.parseString(readTestFile("/tst_treesitter/main.cpp"));
+            QVERIFY(tree.has_value());
+            // The tree is kept alive
+            QVERIFY(allocations.bytes() > 0);
+            QVERIFY(MemoryAccounting::allocatedBytes(MemoryAccounting::TreeSitter) >= allocations.bytes());
+            QVERIFY(MemoryAccounting::peakBytes(MemoryAccounting::TreeSitter)
+                    >= MemoryAccounting::allocatedBytes(MemoryAccounting::TreeSitter));
+        }
+        // The tree is freed, only the parser internal buffers are left
+        int64_t withTree = 0;
+        {
+            auto tree = parser.parseString(readTestFile("/tst_treesitter/main.cpp"));
+            withTree = allocations.bytes();
+        }
+        QVERIFY(allocations.bytes() < withTree);
+    }
 };
 
 QTEST_MAIN(TestTreeSitter)
@@ -0,0 +1,273 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+// Compares two sets of benchmark results saved by the knut-bench target, and reports the regressions.
+//
+// Each set is a json file, or a directory containing the json files of all benchmarks. With several runs of each
+// benchmark (KNUT_BENCH_RUNS), the difference is checked with a 95% confidence interval (Welch's t-test): a change is
+// only reported if the whole interval is above the threshold. Throughputs (`*PerSecond` metrics) and scaling
+// efficiencies are regressions when they decrease. The exit code is 1 if there is a regression:
+//     benchcompare --threshold 5 tests/bench_baseline build/bench
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <nlohmann/json.hpp>
+#include <numeric>
+#include <optional>
+#include <ranges>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+// Benchmark, function, tag and metric of a result
+using Key = std::tuple<std::string, std::string, std::string, std::string>;
+// All the values measured for one result, one per run
+using Results = std::map<Key, std::vector<double>>;
+
+bool loadFile(const QString &fileName, Results &results)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        std::cerr << "Can't read " << fileName.toStdString() << ": " << file.errorString().toStdString() << '\n';
+        return false;
+    }
+    const auto json = nlohmann::json::parse(file.readAll().toStdString(), nullptr, false);
+    if (json.is_discarded() || !json.contains("results")) {
+        std::cerr << "Invalid benchmark results in " << fileName.toStdString() << '\n';
+        return false;
+    }
+
+    const auto benchmark = json.value("benchmark", QFileInfo(fileName).baseName().toStdString());
+    for (const auto &result : json["results"]) {
+        const Key key {benchmark, result.value("function", ""), result.value("tag", ""), result.value("metric", "")};
+        auto &values = results[key];
+        // Files saved before the repeated runs only have one value
+        if (result.contains("values")) {
+            for (const auto &value : result["values"])
+                values.push_back(value.get<double>());
+        } else {
+            values.push_back(result.value("value", 0.0));
+        }
+    }
+    return true;
+}
+
+std::optional<Results> loadResults(const QString &path)
+{
+    Results results;
+    const QFileInfo info(path);
+    if (!info.isDir())
+        return loadFile(path, results) ? std::optional(results) : std::nullopt;
+
+    const auto files = QDir(path).entryInfoList({"*.json"}, QDir::Files, QDir::Name);
+    if (files.isEmpty()) {
+        std::cerr << "No benchmark results in " << path.toStdString() << '\n';
+        return {};
+    }
+    for (const auto &file : files) {
+        if (!loadFile(file.filePath(), results))
+            return {};
+    }
+    return results;
+}
+
+struct Statistics
+{
+    double mean = 0;
+    // Sample variance, 0 with a single value
+    double variance = 0;
+    int count = 0;
+};
+
+Statistics statistics(const std::vector<double> &values)
+{
+    Statistics result;
+    result.count = static_cast<int>(values.size());
+    if (values.empty())
+        return result;
+    result.mean = std::accumulate(values.cbegin(), values.cend(), 0.0) / result.count;
+    if (result.count > 1) {
+        const double squares = std::accumulate(values.cbegin(), values.cend(), 0.0, [&](double sum, double value) {
+            return sum + (value - result.mean) * (value - result.mean);
+        });
+        result.variance = squares / (result.count - 1);
+    }
+    return result;
+}
+
+// Two-sided 95% quantile of the Student's t-distribution with `df` degrees of freedom
+double studentQuantile(double df)
+{
+    static constexpr double Quantiles[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                                           2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                                           2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+    constexpr int TableSize = static_cast<int>(std::size(Quantiles));
+    // Rounding down is conservative: the quantile decreases with the degrees of freedom
+    const int index = static_cast<int>(std::floor(df));
+    if (index < 1)
+        return Quantiles[0];
+    if (index <= TableSize)
+        return Quantiles[index - 1];
+    // First terms of the Cornish-Fisher expansion, accurate to 0.01 above 30 degrees of freedom
+    constexpr double z = 1.959964;
+    return z + (z * z * z + z) / (4 * df);
+}
+
+struct Comparison
+{
+    Statistics baseline;
+    Statistics current;
+    // Relative change of the mean, and its confidence interval
+    double change = 0;
+    double low = 0;
+    double high = 0;
+    // False if there are not enough runs to compute a confidence interval
+    bool significant = false;
+};
+
+Comparison compare(const std::vector<double> &baseline, const std::vector<double> &current)
+{
+    Comparison result {statistics(baseline), statistics(current)};
+    if (result.baseline.mean == 0)
+        return result;
+
+    const double difference = result.current.mean - result.baseline.mean;
+    result.change = result.low = result.high = difference / result.baseline.mean;
+    if (result.baseline.count < 2 || result.current.count < 2)
+        return result;
+
+    result.significant = true;
+    const double baselineError = result.baseline.variance / result.baseline.count;
+    const double currentError = result.current.variance / result.current.count;
+    const double standardError = std::sqrt(baselineError + currentError);
+    if (standardError == 0)
+        return result;
+    // Welch-Satterthwaite approximation of the degrees of freedom
+    const double df = std::pow(baselineError + currentError, 2)
+        / (baselineError * baselineError / (result.baseline.count - 1)
+           + currentError * currentError / (result.current.count - 1));
+    const double margin = studentQuantile(df) * standardError / result.baseline.mean;
+    result.low = result.change - margin;
+    result.high = result.change + margin;
+    return result;
+}
+
+// Throughputs and efficiencies are better when higher, the other metrics (time, memory, events...) when lower
+bool higherIsBetter(const std::string &metric)
+{
+    return metric.ends_with("PerSecond") || metric == "ScalingEfficiency";
+}
+
+std::string keyName(const Key &key)
+{
+    const auto &[benchmark, function, tag, metric] = key;
+    std::string name = benchmark + "::" + function;
+    if (!tag.empty())
+        name += '[' + tag + ']';
+    return name;
+}
+
+std::string percent(double value)
+{
+    std::ostringstream stream;
+    stream << std::showpos << std::fixed << std::setprecision(1) << value * 100 << '%';
+    return stream.str();
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("benchcompare");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Compares two sets of Knut benchmark results, and reports the regressions");
+    parser.addHelpOption();
+    parser.addPositionalArgument("baseline", "Json file or directory of the reference results.");
+    parser.addPositionalArgument("current", "Json file or directory of the results to check.");
+    parser.addOptions({
+        {"threshold", "Minimal slowdown reported as a regression, in percent (default 5).", "percent"},
+        {"all", "Show all results, not only the changed ones."},
+    });
+    parser.process(app);
+
+    if (parser.positionalArguments().size() != 2)
+        parser.showHelp(2);
+
+    double threshold = 0.05;
+    if (parser.isSet("threshold")) {
+        bool ok = false;
+        threshold = parser.value("threshold").toDouble(&ok) / 100;
+        if (!ok || threshold < 0) {
+            std::cerr << "Invalid value for --threshold, expecting a positive number\n";
+            return 2;
+        }
+    }
+
+    const auto baseline = loadResults(parser.positionalArguments().at(0));
+    const auto current = loadResults(parser.positionalArguments().at(1));
+    if (!baseline || !current)
+        return 2;
+
+    int regressions = 0;
+    int improvements = 0;
+    for (const auto &[key, values] : *current) {
+        auto it = baseline->find(key);
+        if (it == baseline->end()) {
+            std::cout << "NEW         " << keyName(key) << '\n';
+            continue;
+        }
+
+        const auto comparison = compare(it->second, values);
+        // Interval of the relative change, positive when worse
+        const bool inverted = higherIsBetter(std::get<3>(key));
+        const double worseLow = inverted ? -comparison.high : comparison.low;
+        const double worseHigh = inverted ? -comparison.low : comparison.high;
+        std::string status;
+        if (worseLow > threshold) {
+            status = comparison.significant ? "REGRESSION" : "SLOWER?";
+            regressions += comparison.significant;
+        } else if (worseHigh < -threshold) {
+            status = comparison.significant ? "IMPROVED" : "FASTER?";
+            improvements += comparison.significant;
+        } else if (parser.isSet("all")) {
+            status = "unchanged";
+        } else {
+            continue;
+        }
+
+        std::cout << std::left << std::setw(12) << status << keyName(key) << ": " << comparison.baseline.mean << " -> "
+                  << comparison.current.mean << ' ' << std::get<3>(key) << ", " << percent(comparison.change);
+        if (comparison.significant)
+            std::cout << " [" << percent(comparison.low) << ", " << percent(comparison.high) << ']';
+        std::cout << " (" << comparison.baseline.count << " vs " << comparison.current.count << " runs)\n";
+    }
+    for (const auto &key : *baseline | std::views::keys) {
+        if (!current->contains(key))
+            std::cout << "REMOVED     " << keyName(key) << '\n';
+    }
+
+    std::cout << regressions << " regression(s), " << improvements << " improvement(s) above "
+              << threshold * 100 << "%\n";
+    return regressions > 0 ? 1 : 0;
+}
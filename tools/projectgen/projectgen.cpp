@@ -0,0 +1,330 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+// Generates a synthetic MFC project, to test and benchmark Knut on big projects.
+//
+// Each class is a dialog, with a header/source pair, a message map, a DoDataExchange method and some functions
+// calling the other classes. The RC file contains the dialogs and a string table, for each language.
+// For example, 5000 classes with the default options give 10k C++ files and about 2M lines of code:
+//     projectgen --classes 5000 /tmp/bigproject
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QTextStream>
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <iterator>
+
+namespace {
+
+struct Language
+{
+    const char *statement;
+    const char *suffix;
+    const char *ok;
+    const char *cancel;
+    const char *apply;
+};
+
+const Language Languages[] = {
+    {"LANG_ENGLISH, SUBLANG_ENGLISH_US", "", "OK", "Cancel", "Apply"},
+    {"LANG_FRENCH, SUBLANG_FRENCH", " (fr)", "OK", "Annuler", "Appliquer"},
+    {"LANG_GERMAN, SUBLANG_GERMAN", " (de)", "OK", "Abbrechen", "Anwenden"},
+    {"LANG_SPANISH, SUBLANG_SPANISH_MODERN", " (es)", "Aceptar", "Cancelar", "Aplicar"},
+    {"LANG_ITALIAN, SUBLANG_ITALIAN", " (it)", "OK", "Annulla", "Applica"},
+    {"LANG_PORTUGUESE, SUBLANG_PORTUGUESE_BRAZILIAN", " (pt)", "OK", "Cancelar", "Aplicar"},
+    {"LANG_DUTCH, SUBLANG_DUTCH", " (nl)", "OK", "Annuleren", "Toepassen"},
+    {"LANG_POLISH, SUBLANG_DEFAULT", " (pl)", "OK", "Anuluj", "Zastosuj"},
+};
+constexpr int LanguageCount = static_cast<int>(std::size(Languages));
+
+struct Options
+{
+    QDir root;
+    int classes = 100;
+    int functions = 20;
+    int dialogs = -1;
+    int languages = 1;
+    int classesPerDirectory = 100;
+};
+
+class Generator
+{
+public:
+    explicit Generator(Options options)
+        : m_options(std::move(options))
+    {
+    }
+
+    bool generate()
+    {
+        if (!m_options.root.mkpath(".")) {
+            std::cerr << "Can't create " << m_options.root.path().toStdString() << '\n';
+            return false;
+        }
+        bool ok = write("stdafx.h", [](QTextStream &stream) {
+            stream << "#pragma once\n\n#include <afxwin.h>\n#include <afxext.h>\n#include <afxcmn.h>\n\n"
+                   << "#include \"Resource.h\"\n";
+        });
+        ok = ok && write("Resource.h", [this](QTextStream &stream) {
+            writeResourceHeader(stream);
+        });
+        ok = ok && write("Project.rc", [this](QTextStream &stream) {
+            writeRcFile(stream);
+        });
+        for (int i = 0; ok && i < m_options.classes; ++i) {
+            const QString baseName = QString("module%1/Dialog%2").arg(i / m_options.classesPerDirectory).arg(i);
+            ok = write(baseName + ".h", [this, i](QTextStream &stream) {
+                writeHeader(stream, i);
+            });
+            ok = ok && write(baseName + ".cpp", [this, i](QTextStream &stream) {
+                writeSource(stream, i);
+            });
+        }
+        if (ok) {
+            std::cout << "Generated " << m_fileCount << " files, " << m_lineCount << " lines, in "
+                      << m_options.root.absolutePath().toStdString() << '\n';
+        }
+        return ok;
+    }
+
+private:
+    int dialogCount() const { return m_options.dialogs; }
+    // Classes share the same dialogs if there are fewer dialogs than classes
+    int dialogOf(int index) const { return dialogCount() == 0 ? -1 : index % dialogCount(); }
+    static QString className(int index) { return QString("CDialog%1").arg(index); }
+
+    bool write(const QString &fileName, const std::function<void(QTextStream &)> &writeContent)
+    {
+        const QString filePath = m_options.root.filePath(fileName);
+        m_options.root.mkpath(QFileInfo(filePath).path());
+        QFile file(filePath);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+            std::cerr << "Can't write " << filePath.toStdString() << '\n';
+            return false;
+        }
+        QString content;
+        QTextStream stream(&content);
+        writeContent(stream);
+        stream.flush();
+        m_lineCount += content.count('\n');
+        ++m_fileCount;
+        file.write(content.toUtf8());
+        return true;
+    }
+
+    void writeResourceHeader(QTextStream &stream) const
+    {
+        stream << "//{{NO_DEPENDENCIES}}\n// Microsoft Visual C++ generated include file.\n// Used by Project.rc\n//\n";
+        for (int i = 0; i < dialogCount(); ++i) {
+            stream << "#define IDD_DIALOG" << i << " " << 1000 + i << '\n';
+            stream << "#define IDS_DIALOG" << i << "_TITLE " << 1000 + i << '\n';
+        }
+        // Control ids are shared by all dialogs, like in most MFC projects
+        stream << "#define IDC_EDIT 2000\n#define IDC_APPLY 2001\n#define IDC_ENABLED 2002\n#define IDC_SLIDER 2003\n";
+    }
+
+    void writeRcFile(QTextStream &stream) const
+    {
+        stream << "// Microsoft Visual C++ generated resource script.\n//\n#include \"Resource.h\"\n\n"
+               << "#define APSTUDIO_READONLY_SYMBOLS\n#include \"afxres.h\"\n#undef APSTUDIO_READONLY_SYMBOLS\n\n";
+        for (int l = 0; l < m_options.languages; ++l) {
+            const auto &language = Languages[l];
+            stream << "/////////////////////////////////////////////////////////////////////////////\n"
+                   << "LANGUAGE " << language.statement << "\n\n";
+            for (int i = 0; i < dialogCount(); ++i)
+                writeDialog(stream, i, language);
+            stream << "STRINGTABLE\nBEGIN\n";
+            for (int i = 0; i < dialogCount(); ++i)
+                stream << "    IDS_DIALOG" << i << "_TITLE \"Dialog " << i << language.suffix << "\"\n";
+            stream << "END\n\n";
+        }
+    }
+
+    static void writeDialog(QTextStream &stream, int index, const Language &language)
+    {
+        stream << "IDD_DIALOG" << index << " DIALOGEX 0, 0, 320, 200\n"
+               << "STYLE DS_SETFONT | DS_MODALFRAME | DS_FIXEDSYS | WS_POPUP | WS_CAPTION | WS_SYSMENU\n"
+               << "CAPTION \"Dialog " << index << language.suffix << "\"\n"
+               << "FONT 8, \"MS Shell Dlg\", 0, 0, 0x1\n"
+               << "BEGIN\n"
+               << "    EDITTEXT        IDC_EDIT,7,7,150,14,ES_AUTOHSCROLL\n"
+               << "    PUSHBUTTON      \"" << language.apply << "\",IDC_APPLY,163,7,50,14\n"
+               << "    CONTROL         \"Enabled\",IDC_ENABLED,\"Button\",BS_AUTOCHECKBOX | WS_TABSTOP,7,28,80,10\n"
+               << "    CONTROL         \"\",IDC_SLIDER,\"msctls_trackbar32\",TBS_BOTH | TBS_NOTICKS | WS_TABSTOP,"
+                  "7,44,150,15\n"
+               << "    DEFPUSHBUTTON   \"" << language.ok << "\",IDOK,209,179,50,14\n"
+               << "    PUSHBUTTON      \"" << language.cancel << "\",IDCANCEL,263,179,50,14\n"
+               << "END\n\n";
+    }
+
+    void writeHeader(QTextStream &stream, int index) const
+    {
+        const auto name = className(index);
+        const int dialog = dialogOf(index);
+        stream << "#pragma once\n\n"
+               << "/// Dialog " << index << " of the generated project\n"
+               << "class " << name << " : public CDialog\n{\npublic:\n"
+               << "    " << name << "(CWnd* pParent = NULL);\n\n";
+        if (dialog >= 0)
+            stream << "    enum { IDD = IDD_DIALOG" << dialog << " };\n\n";
+        stream << "    static int Compute(int value);\n\n"
+               << "protected:\n"
+               << "    virtual void DoDataExchange(CDataExchange* pDX);\n"
+               << "    virtual BOOL OnInitDialog();\n\n"
+               << "    afx_msg void OnBnClickedApply();\n"
+               << "    afx_msg void OnEnChangeEdit();\n"
+               << "    afx_msg void OnHScroll(UINT nSBCode, UINT nPos, CScrollBar* pScrollBar);\n"
+               << "    DECLARE_MESSAGE_MAP()\n\n";
+        for (int f = 0; f < m_options.functions; ++f)
+            stream << "    void Update" << f << "(int value);\n";
+        stream << "\nprivate:\n"
+               << "    CString m_Text;\n"
+               << "    BOOL m_Enabled;\n"
+               << "    CSliderCtrl m_Slider;\n"
+               << "    int m_Count;\n"
+               << "};\n";
+    }
+
+    void writeSource(QTextStream &stream, int index) const
+    {
+        const auto name = className(index);
+        // The next class is called from this one, so the classes reference each other
+        const int next = (index + 1) % m_options.classes;
+        stream << "#include \"stdafx.h\"\n"
+               << "#include \"Dialog" << index << ".h\"\n"
+               << "#include \"../module" << next / m_options.classesPerDirectory << "/Dialog" << next << ".h\"\n\n"
+               << "#ifdef _DEBUG\n#define new DEBUG_NEW\n#endif\n\n";
+
+        stream << name << "::" << name << "(CWnd* pParent)\n";
+        if (dialogOf(index) >= 0)
+            stream << "    : CDialog(" << name << "::IDD, pParent)\n";
+        else
+            stream << "    : CDialog(0, pParent)\n";
+        stream << "    , m_Text(L\"\")\n    , m_Enabled(TRUE)\n    , m_Count(0)\n{\n}\n\n";
+
+        stream << "void " << name << "::DoDataExchange(CDataExchange* pDX)\n{\n"
+               << "    CDialog::DoDataExchange(pDX);\n"
+               << "    DDX_Text(pDX, IDC_EDIT, m_Text);\n"
+               << "    DDV_MaxChars(pDX, m_Text, 64);\n"
+               << "    DDX_Check(pDX, IDC_ENABLED, m_Enabled);\n"
+               << "    DDX_Control(pDX, IDC_SLIDER, m_Slider);\n"
+               << "}\n\n";
+
+        stream << "BEGIN_MESSAGE_MAP(" << name << ", CDialog)\n"
+               << "    ON_WM_HSCROLL()\n"
+               << "    ON_BN_CLICKED(IDC_APPLY, OnBnClickedApply)\n"
+               << "    ON_EN_CHANGE(IDC_EDIT, OnEnChangeEdit)\n"
+               << "END_MESSAGE_MAP()\n\n";
+
+        stream << "BOOL " << name << "::OnInitDialog()\n{\n"
+               << "    CDialog::OnInitDialog();\n\n"
+               << "    m_Slider.SetRange(0, 100, TRUE);\n"
+               << "    m_Slider.SetPos(50);\n"
+               << "    UpdateData(FALSE);\n"
+               << "    return TRUE;\n}\n\n";
+
+        stream << "int " << name << "::Compute(int value)\n{\n"
+               << "    return value * " << index % 7 + 2 << " + " << index << ";\n}\n\n";
+
+        stream << "void " << name << "::OnBnClickedApply()\n{\n"
+               << "    UpdateData(TRUE);\n"
+               << "    ++m_Count;\n"
+               << "    m_Text.Format(L\"%d\", " << className(next) << "::Compute(m_Count));\n"
+               << "    UpdateData(FALSE);\n}\n\n";
+
+        stream << "void " << name << "::OnEnChangeEdit()\n{\n"
+               << "    UpdateData(TRUE);\n"
+               << "    GetDlgItem(IDC_APPLY)->EnableWindow(!m_Text.IsEmpty());\n}\n\n";
+
+        stream << "void " << name << "::OnHScroll(UINT nSBCode, UINT nPos, CScrollBar* pScrollBar)\n{\n"
+               << "    if (pScrollBar == (CScrollBar*)&m_Slider)\n"
+               << "        Update0(m_Slider.GetPos());\n"
+               << "    CDialog::OnHScroll(nSBCode, nPos, pScrollBar);\n}\n";
+
+        for (int f = 0; f < m_options.functions; ++f) {
+            stream << "\nvoid " << name << "::Update" << f << "(int value)\n{\n"
+                   << "    // Generated function " << f << '\n'
+                   << "    if (!m_Enabled)\n"
+                   << "        return;\n\n"
+                   << "    int total = 0;\n"
+                   << "    for (int i = 0; i < value; ++i) {\n"
+                   << "        if (i % " << f + 2 << " == 0)\n"
+                   << "            total += " << className(next) << "::Compute(i);\n"
+                   << "        else\n"
+                   << "            total -= i;\n"
+                   << "    }\n"
+                   << "    m_Count = total;\n";
+            if (f + 1 < m_options.functions)
+                stream << "    Update" << f + 1 << "(value / 2);\n";
+            stream << "}\n";
+        }
+    }
+
+    Options m_options;
+    int m_fileCount = 0;
+    qsizetype m_lineCount = 0;
+};
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("projectgen");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Generates a synthetic MFC project, to test Knut on big projects");
+    parser.addHelpOption();
+    parser.addPositionalArgument("output", "Directory of the generated project.");
+    parser.addOptions({
+        {"classes", "Number of dialog classes, each one is a header/source pair (default 100).", "count"},
+        {"functions", "Number of generated functions in each class (default 20).", "count"},
+        {"dialogs", "Number of dialogs in the RC file (default: one per class).", "count"},
+        {"languages", QString("Number of languages in the RC file, up to %1 (default 1).").arg(LanguageCount),
+         "count"},
+        {"classes-per-directory", "Number of classes in each directory (default 100).", "count"},
+    });
+    parser.process(app);
+
+    if (parser.positionalArguments().size() != 1)
+        parser.showHelp(1);
+
+    Options options;
+    options.root.setPath(parser.positionalArguments().first());
+    auto readOption = [&parser](const QString &name, int &value, int min, int max) {
+        if (!parser.isSet(name))
+            return true;
+        bool ok = false;
+        const int number = parser.value(name).toInt(&ok);
+        if (!ok || number < min || number > max) {
+            std::cerr << "Invalid value for --" << name.toStdString() << ", expecting a number between " << min
+                      << " and " << max << '\n';
+            return false;
+        }
+        value = number;
+        return true;
+    };
+    // The ids of the dialogs and of their strings are between 1000 and 2000 in Resource.h
+    const bool ok = readOption("classes", options.classes, 1, 1000000)
+        && readOption("functions", options.functions, 0, 1000) && readOption("dialogs", options.dialogs, 0, 999)
+        && readOption("languages", options.languages, 1, LanguageCount)
+        && readOption("classes-per-directory", options.classesPerDirectory, 1, 1000000);
+    if (!ok)
+        return 1;
+    if (options.dialogs < 0)
+        options.dialogs = std::min(options.classes, 999);
+
+    Generator generator(std::move(options));
+    return generator.generate() ? 0 : 1;
+}
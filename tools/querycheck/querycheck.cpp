@@ -0,0 +1,79 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+// Compiles Tree-sitter query files, and reports the invalid ones. Used when building to check the built-in queries.
+// The language is the name of the directory of each file (cpp or qml). The exit code is 1 if a query is invalid:
+//     querycheck queries/cpp/find_include.scm queries/cpp/message_map.scm
+
+#include "treesitter/languages.h"
+#include "treesitter/query.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStringList>
+#include <iostream>
+
+namespace {
+
+const TSLanguage *languageForFile(const QString &fileName)
+{
+    const auto language = QFileInfo(fileName).dir().dirName();
+    if (language == "cpp")
+        return tree_sitter_cpp();
+    if (language == "qml")
+        return tree_sitter_qmljs();
+    return nullptr;
+}
+
+bool checkQuery(const QString &fileName)
+{
+    const auto *language = languageForFile(fileName);
+    if (!language) {
+        std::cerr << fileName.toStdString() << ": unknown language, the directory must be cpp or qml\n";
+        return false;
+    }
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        std::cerr << fileName.toStdString() << ": " << file.errorString().toStdString() << '\n';
+        return false;
+    }
+    const QByteArray text = file.readAll();
+    try {
+        treesitter::Query query(language, QString::fromUtf8(text));
+    } catch (const treesitter::Query::Error &error) {
+        // The offset is in bytes, like the text read
+        const auto before = text.left(error.utf8_offset);
+        const auto line = before.count('\n') + 1;
+        const auto column = error.utf8_offset - (before.lastIndexOf('\n') + 1) + 1;
+        std::cerr << fileName.toStdString() << ':' << line << ':' << column
+                  << ": error: " << error.description.toStdString() << '\n';
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    const auto fileNames = app.arguments().mid(1);
+    if (fileNames.isEmpty()) {
+        std::cerr << "Usage: querycheck <file>...\n";
+        return 1;
+    }
+    bool valid = true;
+    for (const auto &fileName : fileNames)
+        valid = checkQuery(fileName) && valid;
+    return valid ? 0 : 1;
+}